@@ -24,6 +24,7 @@
 #include <stdint.h>
 #include <assert.h>
 #include <string>
+#include <vector>
 #include <stdio.h>
 #include <string.h>
 #include <openssl/crypto.h>
@@ -38,6 +39,16 @@
 #include "util/rsrandom.h"
 #include "util/rstime.h"
 
+#if defined(__SSE2__)
+    #include <emmintrin.h>
+    #define CHACHA20_SSE2
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    #include <immintrin.h>
+    #define CHACHA20_AVX2
+#endif
+
 #define rotl(x,n) { x = (x << n) | (x >> (-n & 31)) ;}
 
 //#define DEBUG_CHACHA20
@@ -361,9 +372,12 @@ static void print(const chacha20_state& s)
 }
 #endif
 
-void chacha20_encrypt_rs(uint8_t key[32], uint32_t block_counter, uint8_t nonce[12], uint8_t *data, uint32_t size)
+// Scalar reference, one block at a time. It also handles the tail of the SIMD
+// kernels below, which only work on whole groups of blocks.
+//
+static void chacha20_encrypt_scalar(uint8_t key[32], uint32_t block_counter, uint8_t nonce[12], uint8_t *data, uint32_t size)
 {
-    for(uint32_t i=0;i<size/64 + 1;++i)
+    for(uint32_t i=0;i<(size+63)/64;++i)
     {
         chacha20_state s(key,block_counter+i,nonce) ;
 
@@ -384,6 +398,242 @@ void chacha20_encrypt_rs(uint8_t key[32], uint32_t block_counter, uint8_t nonce[
     }
 }
 
+// The SIMD kernels compute several consecutive blocks at once: vector register i
+// holds word i of each block, so that the quarter rounds are the scalar ones
+// applied lane-wise, and the blocks are transposed back to bytes before being
+// xored to the data. x86 is little endian, so words are stored as they are.
+
+#ifdef CHACHA20_SSE2
+
+#define CHACHA20_ROTL_128(v,n) _mm_or_si128(_mm_slli_epi32(v,n),_mm_srli_epi32(v,32-n))
+
+#define CHACHA20_QR_128(a,b,c,d) \
+    a = _mm_add_epi32(a,b) ; d = _mm_xor_si128(d,a) ; d = CHACHA20_ROTL_128(d,16) ; \
+    c = _mm_add_epi32(c,d) ; b = _mm_xor_si128(b,c) ; b = CHACHA20_ROTL_128(b,12) ; \
+    a = _mm_add_epi32(a,b) ; d = _mm_xor_si128(d,a) ; d = CHACHA20_ROTL_128(d, 8) ; \
+    c = _mm_add_epi32(c,d) ; b = _mm_xor_si128(b,c) ; b = CHACHA20_ROTL_128(b, 7) ;
+
+// 4 blocks per iteration. Returns the number of bytes processed, a multiple of 256.
+//
+static uint32_t chacha20_blocks_sse2(const chacha20_state& init, uint8_t *data, uint32_t size)
+{
+    __m128i in[16] ;
+
+    for(uint32_t i=0;i<16;++i)
+        in[i] = _mm_set1_epi32(init.c[i]) ;
+
+    in[12] = _mm_add_epi32(in[12],_mm_set_epi32(3,2,1,0)) ;
+
+    uint32_t done = 0 ;
+
+    for(;done + 256 <= size;done += 256)
+    {
+        __m128i x[16] ;
+
+        for(uint32_t i=0;i<16;++i)
+            x[i] = in[i] ;
+
+        for(uint32_t i=0;i<10;++i)
+        {
+            CHACHA20_QR_128(x[ 0],x[ 4],x[ 8],x[12]) ;
+            CHACHA20_QR_128(x[ 1],x[ 5],x[ 9],x[13]) ;
+            CHACHA20_QR_128(x[ 2],x[ 6],x[10],x[14]) ;
+            CHACHA20_QR_128(x[ 3],x[ 7],x[11],x[15]) ;
+            CHACHA20_QR_128(x[ 0],x[ 5],x[10],x[15]) ;
+            CHACHA20_QR_128(x[ 1],x[ 6],x[11],x[12]) ;
+            CHACHA20_QR_128(x[ 2],x[ 7],x[ 8],x[13]) ;
+            CHACHA20_QR_128(x[ 3],x[ 4],x[ 9],x[14]) ;
+        }
+
+        for(uint32_t i=0;i<16;++i)
+            x[i] = _mm_add_epi32(x[i],in[i]) ;
+
+        // Each group of 4 words is transposed, giving 16 bytes of each block.
+
+        for(uint32_t g=0;g<4;++g)
+        {
+            __m128i t0 = _mm_unpacklo_epi32(x[4*g+0],x[4*g+1]) ;
+            __m128i t1 = _mm_unpacklo_epi32(x[4*g+2],x[4*g+3]) ;
+            __m128i t2 = _mm_unpackhi_epi32(x[4*g+0],x[4*g+1]) ;
+            __m128i t3 = _mm_unpackhi_epi32(x[4*g+2],x[4*g+3]) ;
+
+            __m128i k[4] = { _mm_unpacklo_epi64(t0,t1), _mm_unpackhi_epi64(t0,t1),
+                             _mm_unpacklo_epi64(t2,t3), _mm_unpackhi_epi64(t2,t3) } ;
+
+            for(uint32_t b=0;b<4;++b)
+            {
+                __m128i *p = (__m128i*)(data + done + 64*b + 16*g) ;
+                _mm_storeu_si128(p,_mm_xor_si128(_mm_loadu_si128(p),k[b])) ;
+            }
+        }
+
+        in[12] = _mm_add_epi32(in[12],_mm_set1_epi32(4)) ;
+    }
+
+    return done ;
+}
+
+#undef CHACHA20_QR_128
+#undef CHACHA20_ROTL_128
+
+#endif // CHACHA20_SSE2
+
+#ifdef CHACHA20_AVX2
+
+#define CHACHA20_ROTL_256(v,n) _mm256_or_si256(_mm256_slli_epi32(v,n),_mm256_srli_epi32(v,32-n))
+
+// Rotations by 16 and 8 bits move whole bytes, which a single shuffle does.
+#define CHACHA20_ROTL16_256(v) _mm256_shuffle_epi8(v,rot16)
+#define CHACHA20_ROTL8_256(v)  _mm256_shuffle_epi8(v,rot8)
+
+#define CHACHA20_QR_256(a,b,c,d) \
+    a = _mm256_add_epi32(a,b) ; d = _mm256_xor_si256(d,a) ; d = CHACHA20_ROTL16_256(d) ; \
+    c = _mm256_add_epi32(c,d) ; b = _mm256_xor_si256(b,c) ; b = CHACHA20_ROTL_256(b,12) ; \
+    a = _mm256_add_epi32(a,b) ; d = _mm256_xor_si256(d,a) ; d = CHACHA20_ROTL8_256(d) ; \
+    c = _mm256_add_epi32(c,d) ; b = _mm256_xor_si256(b,c) ; b = CHACHA20_ROTL_256(b, 7) ;
+
+// 8 blocks per iteration. Returns the number of bytes processed, a multiple of 512.
+// Only called when the CPU supports AVX2, see chacha20_encrypt_rs().
+//
+__attribute__((target("avx2")))
+static uint32_t chacha20_blocks_avx2(const chacha20_state& init, uint8_t *data, uint32_t size)
+{
+    const __m256i rot16 = _mm256_set_epi8(13,12,15,14, 9, 8,11,10, 5, 4, 7, 6, 1, 0, 3, 2,
+                                          13,12,15,14, 9, 8,11,10, 5, 4, 7, 6, 1, 0, 3, 2) ;
+    const __m256i rot8  = _mm256_set_epi8(14,13,12,15,10, 9, 8,11, 6, 5, 4, 7, 2, 1, 0, 3,
+                                          14,13,12,15,10, 9, 8,11, 6, 5, 4, 7, 2, 1, 0, 3) ;
+    __m256i in[16] ;
+
+    for(uint32_t i=0;i<16;++i)
+        in[i] = _mm256_set1_epi32(init.c[i]) ;
+
+    in[12] = _mm256_add_epi32(in[12],_mm256_set_epi32(7,6,5,4,3,2,1,0)) ;
+
+    uint32_t done = 0 ;
+
+    for(;done + 512 <= size;done += 512)
+    {
+        __m256i x[16] ;
+
+        for(uint32_t i=0;i<16;++i)
+            x[i] = in[i] ;
+
+        for(uint32_t i=0;i<10;++i)
+        {
+            CHACHA20_QR_256(x[ 0],x[ 4],x[ 8],x[12]) ;
+            CHACHA20_QR_256(x[ 1],x[ 5],x[ 9],x[13]) ;
+            CHACHA20_QR_256(x[ 2],x[ 6],x[10],x[14]) ;
+            CHACHA20_QR_256(x[ 3],x[ 7],x[11],x[15]) ;
+            CHACHA20_QR_256(x[ 0],x[ 5],x[10],x[15]) ;
+            CHACHA20_QR_256(x[ 1],x[ 6],x[11],x[12]) ;
+            CHACHA20_QR_256(x[ 2],x[ 7],x[ 8],x[13]) ;
+            CHACHA20_QR_256(x[ 3],x[ 4],x[ 9],x[14]) ;
+        }
+
+        for(uint32_t i=0;i<16;++i)
+            x[i] = _mm256_add_epi32(x[i],in[i]) ;
+
+        // Unpacks work within 128 bits halves, so transposing a group of 4 words
+        // gives 16 bytes of block b in the low half and of block b+4 in the high
+        // half. Two consecutive groups are then merged into 32 bytes per block.
+
+        for(uint32_t g=0;g<4;g+=2)
+        {
+            __m256i k[2][4] ;
+
+            for(uint32_t h=0;h<2;++h)
+            {
+                const __m256i *y = x + 4*(g+h) ;
+
+                __m256i t0 = _mm256_unpacklo_epi32(y[0],y[1]) ;
+                __m256i t1 = _mm256_unpacklo_epi32(y[2],y[3]) ;
+                __m256i t2 = _mm256_unpackhi_epi32(y[0],y[1]) ;
+                __m256i t3 = _mm256_unpackhi_epi32(y[2],y[3]) ;
+
+                k[h][0] = _mm256_unpacklo_epi64(t0,t1) ;
+                k[h][1] = _mm256_unpackhi_epi64(t0,t1) ;
+                k[h][2] = _mm256_unpacklo_epi64(t2,t3) ;
+                k[h][3] = _mm256_unpackhi_epi64(t2,t3) ;
+            }
+
+            for(uint32_t b=0;b<4;++b)
+            {
+                __m256i *p = (__m256i*)(data + done + 64*b + 16*g) ;
+                __m256i *q = (__m256i*)(data + done + 64*(b+4) + 16*g) ;
+
+                _mm256_storeu_si256(p,_mm256_xor_si256(_mm256_loadu_si256(p),_mm256_permute2x128_si256(k[0][b],k[1][b],0x20))) ;
+                _mm256_storeu_si256(q,_mm256_xor_si256(_mm256_loadu_si256(q),_mm256_permute2x128_si256(k[0][b],k[1][b],0x31))) ;
+            }
+        }
+
+        in[12] = _mm256_add_epi32(in[12],_mm256_set1_epi32(8)) ;
+    }
+
+    return done ;
+}
+
+#undef CHACHA20_QR_256
+#undef CHACHA20_ROTL8_256
+#undef CHACHA20_ROTL16_256
+#undef CHACHA20_ROTL_256
+
+#endif // CHACHA20_AVX2
+
+enum chacha20_kernel { CHACHA20_KERNEL_SCALAR, CHACHA20_KERNEL_SSE2, CHACHA20_KERNEL_AVX2 } ;
+
+static bool chacha20_kernel_available(chacha20_kernel kernel)
+{
+    switch(kernel)
+    {
+#ifdef CHACHA20_SSE2
+    case CHACHA20_KERNEL_SSE2: return true ;
+#endif
+#ifdef CHACHA20_AVX2
+    case CHACHA20_KERNEL_AVX2: return __builtin_cpu_supports("avx2") ;
+#endif
+    case CHACHA20_KERNEL_SCALAR: return true ;
+    default: return false ;
+    }
+}
+
+static void chacha20_encrypt_kernel(chacha20_kernel kernel,uint8_t key[32], uint32_t block_counter, uint8_t nonce[12], uint8_t *data, uint32_t size)
+{
+    uint32_t done = 0 ;
+
+#if defined(CHACHA20_SSE2) || defined(CHACHA20_AVX2)
+    if(kernel != CHACHA20_KERNEL_SCALAR && size >= 256)
+    {
+        chacha20_state init(key,block_counter,nonce) ;
+
+#ifdef CHACHA20_AVX2
+        if(kernel == CHACHA20_KERNEL_AVX2)
+        {
+            done = chacha20_blocks_avx2(init,data,size) ;
+            init.c[12] += done/64 ;
+        }
+#endif
+#ifdef CHACHA20_SSE2
+        done += chacha20_blocks_sse2(init,data + done,size - done) ;
+#endif
+    }
+#else
+    (void)kernel ;
+#endif
+
+    chacha20_encrypt_scalar(key,block_counter + done/64,nonce,data + done,size - done) ;
+}
+
+void chacha20_encrypt_rs(uint8_t key[32], uint32_t block_counter, uint8_t nonce[12], uint8_t *data, uint32_t size)
+{
+    // The best kernel is selected once, from what the CPU supports at run time.
+
+    static const chacha20_kernel kernel = chacha20_kernel_available(CHACHA20_KERNEL_AVX2) ? CHACHA20_KERNEL_AVX2
+                                        : chacha20_kernel_available(CHACHA20_KERNEL_SSE2) ? CHACHA20_KERNEL_SSE2
+                                                                                          : CHACHA20_KERNEL_SCALAR ;
+
+    chacha20_encrypt_kernel(kernel,key,block_counter,nonce,data,size) ;
+}
+
 #if OPENSSL_VERSION_NUMBER >= 0x010100000L && !defined(LIBRESSL_VERSION_NUMBER)
 void chacha20_encrypt_openssl(uint8_t key[32], uint32_t block_counter, uint8_t nonce[12], uint8_t *data, uint32_t size)
 {
@@ -428,36 +678,230 @@ out:
 }
 #endif
 
+void chacha20_encrypt(uint8_t key[32], uint32_t block_counter, uint8_t nonce[12], uint8_t *data, uint32_t size)
+{
+#if OPENSSL_VERSION_NUMBER < 0x10100000L || defined(LIBRESSL_VERSION_NUMBER)
+    chacha20_encrypt_rs(key, block_counter, nonce, data, size);
+#else
+    chacha20_encrypt_openssl(key, block_counter, nonce, data, size);
+#endif
+}
+
+// Poly1305 works modulo p = 2^130-5 on limbs small enough for the products to
+// fit machine words, so that reductions are a few shifts and multiplications by
+// 5 instead of a division: 3 limbs of 44 bits when the compiler has 128 bits
+// integers, 5 limbs of 26 bits otherwise. Reductions are only partial between
+// blocks, the accumulator is fully reduced in poly1305_finish(). The uint256_32
+// arithmetic above is kept as a reference for the tests.
+
+static uint32_t poly1305_u8to32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24) ;
+}
+
+static void poly1305_u32to8(uint8_t *p,uint32_t v)
+{
+    p[0] = v & 0xff ; p[1] = (v >> 8) & 0xff ; p[2] = (v >> 16) & 0xff ; p[3] = (v >> 24) & 0xff ;
+}
+
+#ifdef __SIZEOF_INT128__
+
+typedef unsigned __int128 poly1305_u128 ;
+
+static uint64_t poly1305_u8to64(const uint8_t *p)
+{
+    return (uint64_t)poly1305_u8to32(p) | ((uint64_t)poly1305_u8to32(p+4) << 32) ;
+}
+
+struct poly1305_state
+{
+    uint64_t r[3] ;
+    uint64_t h[3] ;
+    uint64_t pad[2] ;
+};
+
+static void poly1305_init(poly1305_state& s,uint8_t key[32])
+{
+    uint64_t t0 = poly1305_u8to64(key) ;
+    uint64_t t1 = poly1305_u8to64(key+8) ;
+
+    // clamped r, see RFC7539-2.5
+
+    s.r[0] = ( t0                    ) & 0xffc0fffffffULL ;
+    s.r[1] = ((t0 >> 44) | (t1 << 20)) & 0xfffffc0ffffULL ;
+    s.r[2] = ( t1 >> 24              ) & 0x00ffffffc0fULL ;
+
+    s.h[0] = s.h[1] = s.h[2] = 0 ;
+
+    s.pad[0] = poly1305_u8to64(key+16) ;
+    s.pad[1] = poly1305_u8to64(key+24) ;
+}
+
+// hibit is the bit set just past the 16 bytes of a full block.
+//
+static void poly1305_block(poly1305_state& s,const uint8_t m[16],uint64_t hibit)
+{
+    const uint64_t r0 = s.r[0], r1 = s.r[1], r2 = s.r[2] ;
+    const uint64_t s1 = r1 * (5 << 2), s2 = r2 * (5 << 2) ;
+
+    uint64_t t0 = poly1305_u8to64(m) ;
+    uint64_t t1 = poly1305_u8to64(m+8) ;
+
+    uint64_t h0 = s.h[0] + ( t0                     & 0xfffffffffffULL) ;
+    uint64_t h1 = s.h[1] + (((t0 >> 44) | (t1 << 20)) & 0xfffffffffffULL) ;
+    uint64_t h2 = s.h[2] + (((t1 >> 24)             & 0x3ffffffffffULL) | (hibit << 40)) ;
+
+    poly1305_u128 d0 = (poly1305_u128)h0*r0 + (poly1305_u128)h1*s2 + (poly1305_u128)h2*s1 ;
+    poly1305_u128 d1 = (poly1305_u128)h0*r1 + (poly1305_u128)h1*r0 + (poly1305_u128)h2*s2 ;
+    poly1305_u128 d2 = (poly1305_u128)h0*r2 + (poly1305_u128)h1*r1 + (poly1305_u128)h2*r0 ;
+
+    uint64_t c ;
+             c = (uint64_t)(d0 >> 44) ; h0 = (uint64_t)d0 & 0xfffffffffffULL ;
+    d1 += c; c = (uint64_t)(d1 >> 44) ; h1 = (uint64_t)d1 & 0xfffffffffffULL ;
+    d2 += c; c = (uint64_t)(d2 >> 42) ; h2 = (uint64_t)d2 & 0x3ffffffffffULL ;
+    h0 += c * 5 ; c = h0 >> 44 ; h0 &= 0xfffffffffffULL ;
+    h1 += c ;
+
+    s.h[0] = h0 ; s.h[1] = h1 ; s.h[2] = h2 ;
+}
+
+static void poly1305_finish(poly1305_state& s,uint8_t tag[16])
+{
+    uint64_t h0 = s.h[0], h1 = s.h[1], h2 = s.h[2] ;
+    uint64_t c ;
+
+                 c = h1 >> 44 ; h1 &= 0xfffffffffffULL ;
+    h2 += c    ; c = h2 >> 42 ; h2 &= 0x3ffffffffffULL ;
+    h0 += c * 5; c = h0 >> 44 ; h0 &= 0xfffffffffffULL ;
+    h1 += c    ; c = h1 >> 44 ; h1 &= 0xfffffffffffULL ;
+    h2 += c    ; c = h2 >> 42 ; h2 &= 0x3ffffffffffULL ;
+    h0 += c * 5; c = h0 >> 44 ; h0 &= 0xfffffffffffULL ;
+    h1 += c ;
+
+    // g = h - p, kept instead of h when it does not underflow, in constant time.
+
+    uint64_t g0 = h0 + 5 ; c = g0 >> 44 ; g0 &= 0xfffffffffffULL ;
+    uint64_t g1 = h1 + c ; c = g1 >> 44 ; g1 &= 0xfffffffffffULL ;
+    uint64_t g2 = h2 + c - ((uint64_t)1 << 42) ;
+
+    uint64_t mask = (g2 >> 63) - 1 ;
+    h0 = (h0 & ~mask) | (g0 & mask) ;
+    h1 = (h1 & ~mask) | (g1 & mask) ;
+    h2 = (h2 & ~mask) | (g2 & mask) ;
+
+    // h + pad, modulo 2^128
+
+    uint64_t t0 = s.pad[0], t1 = s.pad[1] ;
+
+    h0 += ( t0                     & 0xfffffffffffULL)     ; c = h0 >> 44 ; h0 &= 0xfffffffffffULL ;
+    h1 += (((t0 >> 44) | (t1 << 20)) & 0xfffffffffffULL) + c ; c = h1 >> 44 ; h1 &= 0xfffffffffffULL ;
+    h2 += ( (t1 >> 24)             & 0x3ffffffffffULL) + c ;
+
+    h0 = h0 | (h1 << 44) ;
+    h1 = (h1 >> 20) | (h2 << 24) ;
+
+    poly1305_u32to8(tag   ,(uint32_t)h0) ; poly1305_u32to8(tag+ 4,(uint32_t)(h0 >> 32)) ;
+    poly1305_u32to8(tag+ 8,(uint32_t)h1) ; poly1305_u32to8(tag+12,(uint32_t)(h1 >> 32)) ;
+}
+
+#else // __SIZEOF_INT128__
+
 struct poly1305_state
 {
-    uint256_32 r ;
-    uint256_32 s ;
-    uint256_32 p ;
-    uint256_32 a ;
+    uint32_t r[5] ;
+    uint32_t h[5] ;
+    uint32_t pad[4] ;
 };
 
 static void poly1305_init(poly1305_state& s,uint8_t key[32])
 {
-    s.r =   uint256_32( 0,0,0,0,
-            ((uint32_t)key[12] << 0) + ((uint32_t)key[13] << 8) + ((uint32_t)key[14] << 16) + ((uint32_t)key[15] << 24),
-            ((uint32_t)key[ 8] << 0) + ((uint32_t)key[ 9] << 8) + ((uint32_t)key[10] << 16) + ((uint32_t)key[11] << 24),
-            ((uint32_t)key[ 4] << 0) + ((uint32_t)key[ 5] << 8) + ((uint32_t)key[ 6] << 16) + ((uint32_t)key[ 7] << 24),
-            ((uint32_t)key[ 0] << 0) + ((uint32_t)key[ 1] << 8) + ((uint32_t)key[ 2] << 16) + ((uint32_t)key[ 3] << 24)
-            );
-
-    s.r.poly1305clamp();
-
-    s.s = uint256_32( 0,0,0,0,
-            ((uint32_t)key[28] << 0) + ((uint32_t)key[29] << 8) + ((uint32_t)key[30] << 16) + ((uint32_t)key[31] << 24),
-            ((uint32_t)key[24] << 0) + ((uint32_t)key[25] << 8) + ((uint32_t)key[26] << 16) + ((uint32_t)key[27] << 24),
-            ((uint32_t)key[20] << 0) + ((uint32_t)key[21] << 8) + ((uint32_t)key[22] << 16) + ((uint32_t)key[23] << 24),
-            ((uint32_t)key[16] << 0) + ((uint32_t)key[17] << 8) + ((uint32_t)key[18] << 16) + ((uint32_t)key[19] << 24)
-            );
-
-    s.p = uint256_32(0,0,0,0x3,0xffffffff,0xffffffff,0xffffffff,0xfffffffb) ;
-    s.a = uint256_32(0,0,0,  0,         0,         0,         0,         0) ;
+    // clamped r, see RFC7539-2.5
+
+    s.r[0] = (poly1305_u8to32(key+ 0)     ) & 0x3ffffff ;
+    s.r[1] = (poly1305_u8to32(key+ 3) >> 2) & 0x3ffff03 ;
+    s.r[2] = (poly1305_u8to32(key+ 6) >> 4) & 0x3ffc0ff ;
+    s.r[3] = (poly1305_u8to32(key+ 9) >> 6) & 0x3f03fff ;
+    s.r[4] = (poly1305_u8to32(key+12) >> 8) & 0x00fffff ;
+
+    memset(s.h,0,sizeof(s.h)) ;
+
+    for(uint32_t i=0;i<4;++i)
+        s.pad[i] = poly1305_u8to32(key+16+4*i) ;
+}
+
+// hibit is the bit set just past the 16 bytes of a full block.
+//
+static void poly1305_block(poly1305_state& s,const uint8_t m[16],uint32_t hibit)
+{
+    const uint32_t r0 = s.r[0], r1 = s.r[1], r2 = s.r[2], r3 = s.r[3], r4 = s.r[4] ;
+    const uint32_t s1 = r1 * 5, s2 = r2 * 5, s3 = r3 * 5, s4 = r4 * 5 ;
+
+    uint32_t h0 = s.h[0] + ((poly1305_u8to32(m+ 0)     ) & 0x3ffffff) ;
+    uint32_t h1 = s.h[1] + ((poly1305_u8to32(m+ 3) >> 2) & 0x3ffffff) ;
+    uint32_t h2 = s.h[2] + ((poly1305_u8to32(m+ 6) >> 4) & 0x3ffffff) ;
+    uint32_t h3 = s.h[3] + ((poly1305_u8to32(m+ 9) >> 6) & 0x3ffffff) ;
+    uint32_t h4 = s.h[4] + ((poly1305_u8to32(m+12) >> 8) | (hibit << 24)) ;
+
+    uint64_t d0 = (uint64_t)h0*r0 + (uint64_t)h1*s4 + (uint64_t)h2*s3 + (uint64_t)h3*s2 + (uint64_t)h4*s1 ;
+    uint64_t d1 = (uint64_t)h0*r1 + (uint64_t)h1*r0 + (uint64_t)h2*s4 + (uint64_t)h3*s3 + (uint64_t)h4*s2 ;
+    uint64_t d2 = (uint64_t)h0*r2 + (uint64_t)h1*r1 + (uint64_t)h2*r0 + (uint64_t)h3*s4 + (uint64_t)h4*s3 ;
+    uint64_t d3 = (uint64_t)h0*r3 + (uint64_t)h1*r2 + (uint64_t)h2*r1 + (uint64_t)h3*r0 + (uint64_t)h4*s4 ;
+    uint64_t d4 = (uint64_t)h0*r4 + (uint64_t)h1*r3 + (uint64_t)h2*r2 + (uint64_t)h3*r1 + (uint64_t)h4*r0 ;
+
+    uint32_t c ;
+             c = (uint32_t)(d0 >> 26) ; h0 = (uint32_t)d0 & 0x3ffffff ;
+    d1 += c; c = (uint32_t)(d1 >> 26) ; h1 = (uint32_t)d1 & 0x3ffffff ;
+    d2 += c; c = (uint32_t)(d2 >> 26) ; h2 = (uint32_t)d2 & 0x3ffffff ;
+    d3 += c; c = (uint32_t)(d3 >> 26) ; h3 = (uint32_t)d3 & 0x3ffffff ;
+    d4 += c; c = (uint32_t)(d4 >> 26) ; h4 = (uint32_t)d4 & 0x3ffffff ;
+    h0 += c * 5 ; c = h0 >> 26 ; h0 &= 0x3ffffff ;
+    h1 += c ;
+
+    s.h[0] = h0 ; s.h[1] = h1 ; s.h[2] = h2 ; s.h[3] = h3 ; s.h[4] = h4 ;
 }
 
+static void poly1305_finish(poly1305_state& s,uint8_t tag[16])
+{
+    uint32_t h0 = s.h[0], h1 = s.h[1], h2 = s.h[2], h3 = s.h[3], h4 = s.h[4] ;
+    uint32_t c ;
+
+                 c = h1 >> 26 ; h1 &= 0x3ffffff ;
+    h2 += c    ; c = h2 >> 26 ; h2 &= 0x3ffffff ;
+    h3 += c    ; c = h3 >> 26 ; h3 &= 0x3ffffff ;
+    h4 += c    ; c = h4 >> 26 ; h4 &= 0x3ffffff ;
+    h0 += c * 5; c = h0 >> 26 ; h0 &= 0x3ffffff ;
+    h1 += c ;
+
+    // g = h - p, kept instead of h when it does not underflow, in constant time.
+
+    uint32_t g0 = h0 + 5 ; c = g0 >> 26 ; g0 &= 0x3ffffff ;
+    uint32_t g1 = h1 + c ; c = g1 >> 26 ; g1 &= 0x3ffffff ;
+    uint32_t g2 = h2 + c ; c = g2 >> 26 ; g2 &= 0x3ffffff ;
+    uint32_t g3 = h3 + c ; c = g3 >> 26 ; g3 &= 0x3ffffff ;
+    uint32_t g4 = h4 + c - (1 << 26) ;
+
+    uint32_t mask = (g4 >> 31) - 1 ;
+    h0 = (h0 & ~mask) | (g0 & mask) ;
+    h1 = (h1 & ~mask) | (g1 & mask) ;
+    h2 = (h2 & ~mask) | (g2 & mask) ;
+    h3 = (h3 & ~mask) | (g3 & mask) ;
+    h4 = (h4 & ~mask) | (g4 & mask) ;
+
+    // h + pad, modulo 2^128
+
+    uint32_t w[4] = { h0 | (h1 << 26), (h1 >> 6) | (h2 << 20), (h2 >> 12) | (h3 << 14), (h3 >> 18) | (h4 << 8) } ;
+    uint64_t f = 0 ;
+
+    for(uint32_t i=0;i<4;++i)
+    {
+        f += (uint64_t)w[i] + s.pad[i] ;
+        poly1305_u32to8(tag+4*i,(uint32_t)f) ;
+        f >>= 32 ;
+    }
+}
+
+#endif // __SIZEOF_INT128__
+
 // Warning: each call will automatically *pad* the data to a multiple of 16 bytes.
 //
 static void poly1305_add(poly1305_state& s,uint8_t *message,uint32_t size,bool pad_to_16_bytes=false)
@@ -466,36 +910,28 @@ static void poly1305_add(poly1305_state& s,uint8_t *message,uint32_t size,bool p
     std::cerr << "Poly1305: digesting " << RsUtil::BinToHex(message,size) << std::endl;
 #endif
 
-    for(uint32_t i=0;i<(size+15)/16;++i)
-    {
-        uint256_32 block ;
-        uint32_t j;
+    uint32_t i=0 ;
 
-        for(j=0;j<16 && i*16+j < size;++j)
-            block.b[j/4] += ((uint64_t)message[i*16+j]) << (8*(j & 0x3)) ;
+    for(;i+16 <= size;i+=16)
+        poly1305_block(s,message+i,1) ;
 
-        if(pad_to_16_bytes)
-            block.b[4] += 0x01 ;
-        else
-            block.b[j/4] += 0x01 << (8*(j& 0x3));
+    if(i == size)
+        return ;
 
-        s.a += block ;
-        s.a *= s.r ;
+    // The last partial block is either zero padded, as a full block, or ends
+    // with a 0x01 byte in place of the high bit.
 
-        uint256_32 q,rst;
-        remainder(s.a,s.p,rst) ;
-        s.a = rst ;
-    }
-}
+    uint8_t block[16] ;
+    memset(block,0,16) ;
+    memcpy(block,message+i,size-i) ;
 
-static void poly1305_finish(poly1305_state& s,uint8_t tag[16])
-{
-    s.a += s.s ;
-
-    tag[ 0] = (s.a.b[0] >> 0) & 0xff ; tag[ 1] = (s.a.b[0] >> 8) & 0xff ; tag[ 2] = (s.a.b[0] >>16) & 0xff ; tag[ 3] = (s.a.b[0] >>24) & 0xff ;
-    tag[ 4] = (s.a.b[1] >> 0) & 0xff ; tag[ 5] = (s.a.b[1] >> 8) & 0xff ; tag[ 6] = (s.a.b[1] >>16) & 0xff ; tag[ 7] = (s.a.b[1] >>24) & 0xff ;
-    tag[ 8] = (s.a.b[2] >> 0) & 0xff ; tag[ 9] = (s.a.b[2] >> 8) & 0xff ; tag[10] = (s.a.b[2] >>16) & 0xff ; tag[11] = (s.a.b[2] >>24) & 0xff ;
-    tag[12] = (s.a.b[3] >> 0) & 0xff ; tag[13] = (s.a.b[3] >> 8) & 0xff ; tag[14] = (s.a.b[3] >>16) & 0xff ; tag[15] = (s.a.b[3] >>24) & 0xff ;
+    if(pad_to_16_bytes)
+        poly1305_block(s,block,1) ;
+    else
+    {
+        block[size-i] = 0x01 ;
+        poly1305_block(s,block,0) ;
+    }
 }
 
 void poly1305_tag(uint8_t key[32],uint8_t *message,uint32_t size,uint8_t tag[16])
@@ -1365,6 +1801,40 @@ bool perform_tests()
     }
     std::cerr << "  RFC7539 AEAD test vector #1           OK" << std::endl;
 
+    // SIMD kernels against the scalar one, with sizes covering their tails
+
+    std::cerr << "  Chacha20 kernels                     " ;
+    {
+        const chacha20_kernel kernels[2] = { CHACHA20_KERNEL_SSE2, CHACHA20_KERNEL_AVX2 } ;
+        const uint32_t sizes[6] = { 63, 256, 511, 512, 1000, 4096+300 } ;
+
+        uint8_t key[32], nonce[12] ;
+        RSRandom::random_bytes(key,32) ;
+        RSRandom::random_bytes(nonce,12) ;
+
+        for(uint32_t k=0;k<2;++k)
+        {
+            if(!chacha20_kernel_available(kernels[k]))
+                continue ;
+
+            for(uint32_t i=0;i<6;++i)
+            {
+                std::vector<uint8_t> ref(sizes[i]) ;
+                RSRandom::random_bytes(ref.data(),sizes[i]) ;
+                std::vector<uint8_t> out(ref) ;
+
+                // 0xfffffffe makes the block counter wrap within the SIMD blocks.
+
+                chacha20_encrypt_kernel(CHACHA20_KERNEL_SCALAR,key,0xfffffffe,nonce,ref.data(),sizes[i]) ;
+                chacha20_encrypt_kernel(kernels[k],key,0xfffffffe,nonce,out.data(),sizes[i]) ;
+
+                if(ref != out)
+                    return false ;
+            }
+        }
+    }
+    std::cerr << " OK" << std::endl;
+
     // bandwidth test
     //
 
@@ -1382,11 +1852,32 @@ bool perform_tests()
 
         uint8_t received_tag[16] ;
 
+        {
+            const chacha20_kernel kernels[3] = { CHACHA20_KERNEL_SCALAR, CHACHA20_KERNEL_SSE2, CHACHA20_KERNEL_AVX2 } ;
+            const char *names[3] = { "scalar", "SSE2  ", "AVX2  " } ;
+
+            for(uint32_t k=0;k<3;++k)
+                if(chacha20_kernel_available(kernels[k]))
+                {
+                    rstime::RsScopeTimer s("AEAD1") ;
+                    chacha20_encrypt_kernel(kernels[k],key, 1, nonce, ten_megabyte_data,SIZE) ;
+
+                    std::cerr << "  Chacha20 " << names[k] << " encryption speed      : " << SIZE / (1024.0*1024.0) / s.duration() << " MB/s" << std::endl;
+                }
+        }
+#if OPENSSL_VERSION_NUMBER >= 0x010100000L && !defined(LIBRESSL_VERSION_NUMBER)
+        {
+            rstime::RsScopeTimer s("AEAD1") ;
+            chacha20_encrypt_openssl(key, 1, nonce, ten_megabyte_data,SIZE) ;
+
+            std::cerr << "  Chacha20 openssl encryption speed     : " << SIZE / (1024.0*1024.0) / s.duration() << " MB/s" << std::endl;
+        }
+#endif
         {
             rstime::RsScopeTimer s("AEAD1") ;
-            chacha20_encrypt_rs(key, 1, nonce, ten_megabyte_data,SIZE) ;
+            poly1305_tag(key, ten_megabyte_data,SIZE,received_tag) ;
 
-            std::cerr << "  Chacha20 encryption speed             : " << SIZE / (1024.0*1024.0) / s.duration() << " MB/s" << std::endl;
+            std::cerr << "  Poly1305 own speed                    : " << SIZE / (1024.0*1024.0) / s.duration() << " MB/s" << std::endl;
         }
         {
             rstime::RsScopeTimer s("AEAD2") ;
@@ -19,11 +19,18 @@
  * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
  *                                                                             *
  *******************************************************************************/
+#include <algorithm>
 #include <iostream>
+#include <vector>
+#include <string.h>
 #include <openssl/evp.h>
 #include <openssl/aes.h>
+#include <openssl/sha.h>
+#include <openssl/hmac.h>
 
 #include "rsaes.h"
+#include "crypto/chacha20.h"
+#include "util/rsrandom.h"
 
 uint32_t RsAES::get_buffer_size(uint32_t n)
 {
@@ -142,3 +149,247 @@ bool RsAES::aes_decrypt_8_16(const uint8_t *input_data,uint32_t input_data_lengt
 	return true;
 }
 
+RsAESSession::RsAESSession(const uint8_t key[16])
+    : mEncryptCtx(EVP_CIPHER_CTX_new()), mDecryptCtx(EVP_CIPHER_CTX_new()),
+      mHmacInner(EVP_MD_CTX_create()), mHmacOuter(EVP_MD_CTX_create()), mHmacCtx(EVP_MD_CTX_create())
+{
+	memcpy(mKey,key,16) ;
+
+	// The cipher is set once. Each packet only sets its own key and IV.
+
+	EVP_EncryptInit_ex(mEncryptCtx, EVP_aes_256_cbc(), NULL, NULL, NULL);
+	EVP_DecryptInit_ex(mDecryptCtx, EVP_aes_256_cbc(), NULL, NULL, NULL);
+
+	// HMAC(K,m) = H((K^opad) | H((K^ipad) | m)). The key is shorter than the SHA1 block, so it is just
+	// padded with zeros, and both prefixes can be hashed here once for all.
+
+	uint8_t pad[SHA_CBLOCK] ;
+
+	memset(pad,0x36,SHA_CBLOCK) ;
+	for(int i=0;i<16;++i) pad[i] ^= mKey[i] ;
+
+	EVP_DigestInit_ex(mHmacInner, EVP_sha1(), NULL) ;
+	EVP_DigestUpdate(mHmacInner, pad, SHA_CBLOCK) ;
+
+	memset(pad,0x5c,SHA_CBLOCK) ;
+	for(int i=0;i<16;++i) pad[i] ^= mKey[i] ;
+
+	EVP_DigestInit_ex(mHmacOuter, EVP_sha1(), NULL) ;
+	EVP_DigestUpdate(mHmacOuter, pad, SHA_CBLOCK) ;
+
+	memset(pad,0,SHA_CBLOCK) ;
+}
+
+RsAESSession::~RsAESSession()
+{
+	EVP_CIPHER_CTX_free(mEncryptCtx) ;
+	EVP_CIPHER_CTX_free(mDecryptCtx) ;
+
+	EVP_MD_CTX_destroy(mHmacInner) ;
+	EVP_MD_CTX_destroy(mHmacOuter) ;
+	EVP_MD_CTX_destroy(mHmacCtx) ;
+
+	memset(mKey,0,16) ;
+}
+
+bool RsAESSession::deriveKeyAndIV(const uint8_t salt[8],uint8_t key[32],uint8_t iv[32]) const
+{
+	// Same derivation as RsAES::aes_crypt_8_16(), so that packets can be read by either side.
+
+	int i = EVP_BytesToKey(EVP_aes_256_cbc(), EVP_sha1(), salt, mKey, 16, 5, key, iv);
+
+	if (i != 32)
+	{
+		std::cerr << "RsAESSession: key size is " << i << " bits - should be 256 bits" << std::endl;
+		return false ;
+	}
+	return true ;
+}
+
+bool RsAESSession::encrypt(const uint8_t *input_data,uint32_t input_data_length,const uint8_t salt[8],uint8_t *output_data,uint32_t& output_data_length)
+{
+	int c_len = input_data_length + AES_BLOCK_SIZE ;
+	int f_len = 0;
+
+	if(output_data_length < (uint32_t)c_len)
+		return false ;
+
+	uint8_t key[32], iv[32];
+
+	if(!deriveKeyAndIV(salt,key,iv) || !EVP_EncryptInit_ex(mEncryptCtx, NULL, NULL, key, iv))
+		return false ;
+
+	if(!EVP_EncryptUpdate(mEncryptCtx, output_data, &c_len, input_data, input_data_length))
+	{
+		std::cerr << "RsAESSession: encryption failed." << std::endl;
+		return false ;
+	}
+
+	if(!EVP_EncryptFinal_ex(mEncryptCtx, output_data+c_len, &f_len))
+	{
+		std::cerr << "RsAESSession: encryption failed at end. Check padding." << std::endl;
+		return false ;
+	}
+
+	output_data_length = c_len + f_len;
+	return true;
+}
+
+bool RsAESSession::decrypt(const uint8_t *input_data,uint32_t input_data_length,const uint8_t salt[8],uint8_t *output_data,uint32_t& output_data_length)
+{
+	int c_len = input_data_length + AES_BLOCK_SIZE ;
+	int f_len = 0;
+
+	if(output_data_length < (uint32_t)c_len)
+		return false ;
+
+	uint8_t key[32], iv[32];
+
+	if(!deriveKeyAndIV(salt,key,iv) || !EVP_DecryptInit_ex(mDecryptCtx, NULL, NULL, key, iv))
+		return false ;
+
+	if(!EVP_DecryptUpdate(mDecryptCtx, output_data, &c_len, input_data, input_data_length))
+	{
+		std::cerr << "RsAESSession: decryption failed." << std::endl;
+		return false ;
+	}
+
+	if(!EVP_DecryptFinal_ex(mDecryptCtx, output_data+c_len, &f_len))
+	{
+		std::cerr << "RsAESSession: decryption failed at end. Check padding." << std::endl;
+		return false ;
+	}
+
+	output_data_length = c_len + f_len;
+	return true;
+}
+
+bool RsAESSession::hmac(const uint8_t *data,uint32_t data_length,uint8_t md[20])
+{
+	uint8_t inner[SHA_DIGEST_LENGTH] ;
+	unsigned int len = 0 ;
+
+	return EVP_MD_CTX_copy_ex(mHmacCtx, mHmacInner)
+	        && EVP_DigestUpdate(mHmacCtx, data, data_length)
+	        && EVP_DigestFinal_ex(mHmacCtx, inner, &len)
+	        && EVP_MD_CTX_copy_ex(mHmacCtx, mHmacOuter)
+	        && EVP_DigestUpdate(mHmacCtx, inner, SHA_DIGEST_LENGTH)
+	        && EVP_DigestFinal_ex(mHmacCtx, md, &len) ;
+}
+
+const uint32_t RsAEADSession::TAG_SIZE ;
+
+RsAEADSession::RsAEADSession(const uint8_t *secret,uint32_t secret_length,const uint8_t *salt,uint32_t salt_length,const char *info,bool initiator)
+    : mSendCounter(0)
+{
+	uint8_t keys[64] ;
+
+	if(!hkdf_sha256(secret,secret_length,salt,salt_length,(const uint8_t*)info,strlen(info),keys,64))
+	{
+		// Random keys: nothing will authenticate, so the owner falls back to re-negotiating.
+
+		std::cerr << "RsAEADSession: key derivation failed." << std::endl;
+		RsRandom::random_bytes(keys,64) ;
+	}
+
+	memcpy(mSendKey,initiator ? keys : keys+32,32) ;
+	memcpy(mRecvKey,initiator ? keys+32 : keys,32) ;
+
+	memset(keys,0,64) ;
+}
+
+RsAEADSession::~RsAEADSession()
+{
+	memset(mSendKey,0,32) ;
+	memset(mRecvKey,0,32) ;
+}
+
+void RsAEADSession::counterNonce(uint64_t counter,uint8_t nonce[12],uint8_t aad[8])
+{
+	memset(nonce,0,12) ;
+
+	for(uint32_t i=0;i<8;++i)
+		aad[i] = nonce[4+i] = (counter >> (8*i)) & 0xff ;
+}
+
+bool RsAEADSession::encrypt(uint8_t *data,uint32_t data_length,uint64_t& counter,uint8_t tag[TAG_SIZE])
+{
+	// A nonce must never be used twice under the same key. The counter does not wrap in practice.
+
+	if(mSendCounter == UINT64_MAX)
+		return false ;
+
+	counter = mSendCounter++ ;
+
+	uint8_t nonce[12], aad[8] ;
+	counterNonce(counter,nonce,aad) ;
+
+	return librs::crypto::AEAD_chacha20_poly1305(mSendKey,nonce,data,data_length,aad,8,tag,true) ;
+}
+
+bool RsAEADSession::decrypt(uint8_t *data,uint32_t data_length,uint64_t counter,const uint8_t tag[TAG_SIZE])
+{
+	uint8_t nonce[12], aad[8], t[TAG_SIZE] ;
+	counterNonce(counter,nonce,aad) ;
+	memcpy(t,tag,TAG_SIZE) ;
+
+	return librs::crypto::AEAD_chacha20_poly1305(mRecvKey,nonce,data,data_length,aad,8,t,false) ;
+}
+
+bool RsAEADSession::hkdf_sha256(const uint8_t *secret,uint32_t secret_length,const uint8_t *salt,uint32_t salt_length,
+                                const uint8_t *info,uint32_t info_length,uint8_t *output,uint32_t output_length)
+{
+	if(output_length > 255*SHA256_DIGEST_LENGTH)
+		return false ;
+
+	// Extract: PRK = HMAC(salt,secret). An empty salt is a string of zeros of the hash size.
+
+	uint8_t zeros[SHA256_DIGEST_LENGTH] ;
+	memset(zeros,0,SHA256_DIGEST_LENGTH) ;
+
+	uint8_t prk[SHA256_DIGEST_LENGTH] ;
+	unsigned int len = 0 ;
+
+	if(salt_length == 0)
+	{
+		salt = zeros ;
+		salt_length = SHA256_DIGEST_LENGTH ;
+	}
+
+	if(!HMAC(EVP_sha256(),salt,salt_length,secret,secret_length,prk,&len))
+		return false ;
+
+	// Expand: T(i) = HMAC(PRK, T(i-1) | info | i), output = T(1) | T(2) | ...
+
+	std::vector<uint8_t> block(SHA256_DIGEST_LENGTH + info_length + 1) ;
+	uint8_t t[SHA256_DIGEST_LENGTH] ;
+	uint32_t t_len = 0 ;
+	bool ok = true ;
+
+	if(info_length > 0)
+		memcpy(&block[SHA256_DIGEST_LENGTH],info,info_length) ;
+
+	for(uint8_t i=1;ok && output_length > 0;++i)
+	{
+		block[SHA256_DIGEST_LENGTH + info_length] = i ;
+
+		// T(0) is empty, so the first block starts after the room left for it.
+
+		uint32_t offset = SHA256_DIGEST_LENGTH - t_len ;
+		ok = HMAC(EVP_sha256(),prk,SHA256_DIGEST_LENGTH,&block[offset],block.size()-offset,t,&len) != NULL ;
+
+		t_len = SHA256_DIGEST_LENGTH ;
+		memcpy(&block[0],t,t_len) ;
+
+		uint32_t n = std::min(output_length,t_len) ;
+		memcpy(output,t,n) ;
+		output += n ;
+		output_length -= n ;
+	}
+
+	memset(prk,0,SHA256_DIGEST_LENGTH) ;
+	memset(t,0,SHA256_DIGEST_LENGTH) ;
+	memset(block.data(),0,SHA256_DIGEST_LENGTH) ;
+
+	return ok ;
+}
@@ -19,7 +19,10 @@
  * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
  *                                                                             *
  *******************************************************************************/
+#pragma once
+
 #include <stdint.h>
+#include <openssl/evp.h>
 
 class RsAES
 {
@@ -41,3 +44,82 @@ class RsAES
 		static uint32_t get_buffer_size(uint32_t size) ;
 };
 
+// Encryption state for a stream of packets sharing the same 16 bytes key, such as the packets of a tunnel.
+//
+//		The output is the same as RsAES::aes_crypt_8_16()/aes_decrypt_8_16(), so both ends do not need to use this
+//		class. Each packet still has its own salt, hence its own AES key and IV, but the cipher contexts are allocated
+//		once, and the HMAC-SHA1 key schedule under the stream key is computed once instead of for every packet.
+//
+//		Not thread safe: the owner is expected to protect it with its own mutex.
+//
+class RsAESSession
+{
+	public:
+		explicit RsAESSession(const uint8_t key[16]) ;
+		~RsAESSession() ;
+
+		// Same semantics and buffer sizes as RsAES::aes_crypt_8_16()/aes_decrypt_8_16().
+		//
+		bool encrypt(const uint8_t *input_data,uint32_t input_data_length,const uint8_t salt[8],uint8_t *output_data,uint32_t& output_data_length) ;
+		bool decrypt(const uint8_t *input_data,uint32_t input_data_length,const uint8_t salt[8],uint8_t *output_data,uint32_t& output_data_length) ;
+
+		// HMAC-SHA1 of the data under the session key. Same result as HMAC(EVP_sha1(),key,16,...).
+		//
+		bool hmac(const uint8_t *data,uint32_t data_length,uint8_t md[20]) ;
+
+	private:
+		RsAESSession(const RsAESSession&) ;
+		RsAESSession& operator=(const RsAESSession&) ;
+
+		bool deriveKeyAndIV(const uint8_t salt[8],uint8_t key[32],uint8_t iv[32]) const ;
+
+		uint8_t mKey[16] ;
+
+		EVP_CIPHER_CTX *mEncryptCtx ;
+		EVP_CIPHER_CTX *mDecryptCtx ;
+
+		EVP_MD_CTX *mHmacInner ;	// SHA1 state after hashing key^ipad
+		EVP_MD_CTX *mHmacOuter ;	// SHA1 state after hashing key^opad
+		EVP_MD_CTX *mHmacCtx ;		// working copy
+};
+
+// Authenticated encryption state for a stream of packets, such as the packets of a tunnel, using chacha20-poly1305
+// under keys derived once from a shared secret.
+//
+//		HKDF-SHA256 (RFC 5869) expands the secret into one key per direction, so that both ends never encrypt under
+//		the same key. The initiator sends with the first key and the responder with the second one. Each packet
+//		carries the counter it was encrypted with, which gives the nonce, and is authenticated together with it.
+//
+//		Not thread safe: the owner is expected to protect it with its own mutex.
+//
+class RsAEADSession
+{
+	public:
+		static const uint32_t TAG_SIZE = 16 ;
+
+		RsAEADSession(const uint8_t *secret,uint32_t secret_length,const uint8_t *salt,uint32_t salt_length,const char *info,bool initiator) ;
+		~RsAEADSession() ;
+
+		// Encrypts in place, and returns the counter to send along with the data and the tag.
+		//
+		bool encrypt(uint8_t *data,uint32_t data_length,uint64_t& counter,uint8_t tag[TAG_SIZE]) ;
+
+		// Decrypts in place. Returns false if the data, the counter or the tag was modified.
+		//
+		bool decrypt(uint8_t *data,uint32_t data_length,uint64_t counter,const uint8_t tag[TAG_SIZE]) ;
+
+		// HKDF-SHA256 of the given secret, salt and info, into output_length bytes (at most 255*32).
+		//
+		static bool hkdf_sha256(const uint8_t *secret,uint32_t secret_length,const uint8_t *salt,uint32_t salt_length,
+		                        const uint8_t *info,uint32_t info_length,uint8_t *output,uint32_t output_length) ;
+
+	private:
+		RsAEADSession(const RsAEADSession&) ;
+		RsAEADSession& operator=(const RsAEADSession&) ;
+
+		static void counterNonce(uint64_t counter,uint8_t nonce[12],uint8_t aad[8]) ;
+
+		uint8_t mSendKey[32] ;
+		uint8_t mRecvKey[32] ;
+		uint64_t mSendCounter ;
+};
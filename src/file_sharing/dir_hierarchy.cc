@@ -57,17 +57,25 @@ template<class T> typename std::set<T>::iterator erase_from_set(typename std::se
 // A Mutex is used to ensure total coherence at this level. So only abstracted operations are allowed,
 // so that the hierarchy stays completely coherent between calls.
 
-InternalFileHierarchyStorage::InternalFileHierarchyStorage() : mRoot(0)
+// Garbage left in the file name arena and in the children array is reclaimed when it exceeds half of the
+// array and this many bytes (resp. entries).
+
+static const size_t FILE_NAME_ARENA_MIN_GARBAGE = 64*1024 ;
+static const size_t CHILDREN_MIN_GARBAGE        = 16*1024 ;
+
+InternalFileHierarchyStorage::InternalFileHierarchyStorage() : mRoot(0), mFileNameGarbage(0), mChildrenGarbage(0)
 {
-    DirEntry *de = new DirEntry("") ;
+    DirectoryStorage::EntryIndex root = allocateNewIndex() ;
+    setDirNode(root,"") ;
 
-    de->row=0;
-    de->parent_index=0;
-    de->dir_modtime=0;
-    de->dir_hash=RsFileHash() ; // null hash is root by convention.
+    DirEntry& de(dirEntry(root)) ;
 
-    mNodes.push_back(de) ;
-    mDirHashes[de->dir_hash] = 0 ;
+    de.row=0;
+    de.parent_index=0;
+    de.dir_modtime=0;
+    de.dir_hash=RsFileHash() ; // null hash is root by convention.
+
+    mDirHashes[de.dir_hash] = root ;
 
     mTotalSize = 0 ;
     mTotalFiles = 0 ;
@@ -79,14 +87,14 @@ bool InternalFileHierarchyStorage::getDirHashFromIndex(
     if(!checkIndex(index,FileStorageNode::TYPE_DIR))
         return false ;
 
-    hash = static_cast<DirEntry*>(mNodes[index])->dir_hash ;
+    hash = dirEntry(index).dir_hash ;
 
     return true;
 }
 
 bool InternalFileHierarchyStorage::getIndexFromDirHash(const RsFileHash& hash,DirectoryStorage::EntryIndex& index)
 {
-    std::map<RsFileHash,DirectoryStorage::EntryIndex>::iterator it = mDirHashes.find(hash) ;
+    auto it = mDirHashes.find(hash) ;
 
     if(it == mDirHashes.end())
         return false;
@@ -97,7 +105,7 @@ bool InternalFileHierarchyStorage::getIndexFromDirHash(const RsFileHash& hash,Di
 	 * remove it. This is an opportunistic update of dir hashes: when we need
 	 * them, we check them. */
 	if( !checkIndex(index, FileStorageNode::TYPE_DIR) ||
-	        static_cast<DirEntry*>(mNodes[index])->dir_hash != hash )
+	        dirEntry(index).dir_hash != hash )
 	{
 		RS_INFO("removing non existing dir hash: ", hash, " from dir hash list");
 		mDirHashes.erase(it);
@@ -118,7 +126,7 @@ bool InternalFileHierarchyStorage::getIndexFromFileHash(
 	 * it. This is an opportunistic update of file hashes: when we need them,
 	 * we check them. */
 	if( !checkIndex(it->second, FileStorageNode::TYPE_FILE) ||
-	        static_cast<FileEntry*>(mNodes[index])->file_hash != hash )
+	        mFileHashList[mNodeSlots[index]] != hash )
 	{
 		RS_INFO("removing non existing file hash: ", hash, " from file hash list");
 		mFileHashes.erase(it);
@@ -133,17 +141,13 @@ bool InternalFileHierarchyStorage::getChildIndex(DirectoryStorage::EntryIndex e,
     if(!checkIndex(e,FileStorageNode::TYPE_DIR))
         return false ;
 
-    const DirEntry& d = *static_cast<DirEntry*>(mNodes[e]) ;
+    const DirEntry& d(dirEntry(e)) ;
 
-    if((uint32_t)row < d.subdirs.size())
-    {
-       c = d.subdirs[row] ;
-       return true ;
-    }
+    // subdirs and subfiles are contiguous, subdirs first.
 
-    if((uint32_t)row < d.subdirs.size() + d.subfiles.size())
+    if((uint32_t)row < d.subdirs_count + d.subfiles_count)
     {
-       c = d.subfiles[row - (int)d.subdirs.size()] ;
+       c = mChildren[d.children_offset + row] ;
        return true ;
     }
     return false;
@@ -154,14 +158,19 @@ int InternalFileHierarchyStorage::parentRow(DirectoryStorage::EntryIndex e)
     if(!checkIndex(e,FileStorageNode::TYPE_DIR | FileStorageNode::TYPE_FILE) || e==0)
         return -1 ;
 
-    return mNodes[mNodes[e]->parent_index]->row;
+    DirectoryStorage::EntryIndex p = getParentIndex(e) ;
+
+    if(!checkIndex(p,FileStorageNode::TYPE_DIR))
+        return -1 ;
+
+    return dirEntry(p).row;
 }
 
 // high level modification routines
 
 bool InternalFileHierarchyStorage::isIndexValid(DirectoryStorage::EntryIndex e) const
 {
-    return e < mNodes.size() && mNodes[e] != NULL ;
+    return e < mNodeTypes.size() && mNodeTypes[e] != FileStorageNode::TYPE_UNKNOWN ;
 }
 
 bool InternalFileHierarchyStorage::updateSubDirectoryList(
@@ -172,50 +181,62 @@ bool InternalFileHierarchyStorage::updateSubDirectoryList(
 	if(!checkIndex(indx,FileStorageNode::TYPE_DIR))
 		return false;
 
-    DirEntry& d(*static_cast<DirEntry*>(mNodes[indx])) ;
-
     std::set<std::string> should_create(subdirs);
 
-    for(uint32_t i=0;i<d.subdirs.size();)
-        if(subdirs.find(static_cast<DirEntry*>(mNodes[d.subdirs[i]])->dir_name) == subdirs.end())
+    std::vector<DirectoryStorage::EntryIndex> old_subdirs(subDirs(dirEntry(indx)).begin(),subDirs(dirEntry(indx)).end()) ;
+    std::vector<DirectoryStorage::EntryIndex> new_subdirs ;
+    std::vector<DirectoryStorage::EntryIndex> subfiles(subFiles(dirEntry(indx)).begin(),subFiles(dirEntry(indx)).end()) ;
+
+    for(uint32_t i=0;i<old_subdirs.size();++i)
+        if(mNodeTypes[old_subdirs[i]] != FileStorageNode::TYPE_DIR)
+            continue ;
+        else if(subdirs.find(dirEntry(old_subdirs[i]).dir_name) == subdirs.end())
         {
 #ifdef DEBUG_DIRECTORY_STORAGE
-            std::cerr << "[directory storage] Removing subdirectory " << static_cast<DirEntry*>(mNodes[d.subdirs[i]])->dir_name << " with index " << d.subdirs[i] << std::endl;
+            std::cerr << "[directory storage] Removing subdirectory " << dirEntry(old_subdirs[i]).dir_name << " with index " << old_subdirs[i] << std::endl;
 #endif
 
-            if( !removeDirectory(d.subdirs[i]))
-                i++ ;
+            recursRemoveDirectory(old_subdirs[i]) ;
         }
         else
         {
 #ifdef DEBUG_DIRECTORY_STORAGE
-            std::cerr << "[directory storage] Keeping existing subdirectory " << static_cast<DirEntry*>(mNodes[d.subdirs[i]])->dir_name << " with index " << d.subdirs[i] << std::endl;
+            std::cerr << "[directory storage] Keeping existing subdirectory " << dirEntry(old_subdirs[i]).dir_name << " with index " << old_subdirs[i] << std::endl;
 #endif
 
-            should_create.erase(static_cast<DirEntry*>(mNodes[d.subdirs[i]])->dir_name) ;
-            ++i;
+            should_create.erase(dirEntry(old_subdirs[i]).dir_name) ;
+            new_subdirs.push_back(old_subdirs[i]) ;
         }
 
+    // copy what we need from the parent, since creating new dirs invalidates references to it.
+
+    const std::string parent_path = RsDirUtil::makePath(dirEntry(indx).dir_parent_path, dirEntry(indx).dir_name) ;
+    const RsFileHash parent_hash = dirEntry(indx).dir_hash ;
+
     for(std::set<std::string>::const_iterator it(should_create.begin());it!=should_create.end();++it)
     {
+        DirectoryStorage::EntryIndex new_index = allocateNewIndex() ;
+
 #ifdef DEBUG_DIRECTORY_STORAGE
-        std::cerr << "[directory storage] adding new subdirectory " << it->first << " at index " << mNodes.size() << std::endl;
+        std::cerr << "[directory storage] adding new subdirectory " << *it << " at index " << new_index << std::endl;
 #endif
+        setDirNode(new_index,*it) ;
 
-        DirEntry *de = new DirEntry(*it) ;
+        DirEntry& de(dirEntry(new_index)) ;
 
-        de->row = mNodes.size();
-        de->parent_index = indx;
-        de->dir_modtime = 0;// forces parsing.it->second;
-		de->dir_parent_path = RsDirUtil::makePath(d.dir_parent_path, d.dir_name) ;
-        de->dir_hash = createDirHash(de->dir_name,d.dir_hash,random_hash_seed) ;
+        de.row = new_index;
+        de.parent_index = indx;
+        de.dir_modtime = 0;// forces parsing.it->second;
+        de.dir_parent_path = parent_path ;
+        de.dir_hash = createDirHash(de.dir_name,parent_hash,random_hash_seed) ;
 
-        mDirHashes[de->dir_hash] = mNodes.size() ;
+        mDirHashes[de.dir_hash] = new_index ;
 
-        d.subdirs.push_back(mNodes.size()) ;
-        mNodes.push_back(de) ;
+        new_subdirs.push_back(new_index) ;
     }
 
+    setChildren(dirEntry(indx),new_subdirs,subfiles) ;
+
     return true;
 }
 
@@ -264,15 +285,23 @@ bool InternalFileHierarchyStorage::removeDirectory(DirectoryStorage::EntryIndex
 #endif
     // remove from parent
 
-    DirEntry& d(*static_cast<DirEntry*>(mNodes[indx])) ;
-    DirEntry& parent_dir(*static_cast<DirEntry*>(mNodes[d.parent_index]));
+    DirectoryStorage::EntryIndex parent_index = dirEntry(indx).parent_index ;
+
+    if(!checkIndex(parent_index,FileStorageNode::TYPE_DIR))
+        return nodeAccessError("removeDirectory(): inconsistency!!") ;
+
+    DirEntry& parent_dir(dirEntry(parent_index));
 
-    for(uint32_t i=0;i<parent_dir.subdirs.size();++i)
-        if(parent_dir.subdirs[i] == indx)
+    std::vector<DirectoryStorage::EntryIndex> subdirs(subDirs(parent_dir).begin(),subDirs(parent_dir).end()) ;
+    std::vector<DirectoryStorage::EntryIndex> subfiles(subFiles(parent_dir).begin(),subFiles(parent_dir).end()) ;
+
+    for(uint32_t i=0;i<subdirs.size();++i)
+        if(subdirs[i] == indx)
         {
-            parent_dir.subdirs[i] = parent_dir.subdirs.back() ;
-            parent_dir.subdirs.pop_back();
+            subdirs[i] = subdirs.back() ;
+            subdirs.pop_back();
 
+            setChildren(parent_dir,subdirs,subfiles) ;
             recursRemoveDirectory(indx) ;
 #ifdef DEBUG_DIRECTORY_STORAGE
             print();
@@ -287,10 +316,10 @@ bool InternalFileHierarchyStorage::removeDirectory(DirectoryStorage::EntryIndex
 
 bool InternalFileHierarchyStorage::checkIndex(DirectoryStorage::EntryIndex indx,uint8_t type) const
 {
-    if(mNodes.empty() || indx==DirectoryStorage::NO_INDEX || indx >= mNodes.size() || mNodes[indx] == NULL)
+    if(mNodeTypes.empty() || indx==DirectoryStorage::NO_INDEX || indx >= mNodeTypes.size() || mNodeTypes[indx] == FileStorageNode::TYPE_UNKNOWN)
         return nodeAccessError("checkIndex(): Node does not exist") ;
 
-    if(! (mNodes[indx]->type() & type))
+    if(! (mNodeTypes[indx] & type))
         return nodeAccessError("checkIndex(): Node is of wrong type") ;
 
     return true;
@@ -308,59 +337,70 @@ bool InternalFileHierarchyStorage::updateSubFilesList(
 		return false;
 	}
 
-    DirEntry& d(*static_cast<DirEntry*>(mNodes[indx])) ;
     new_files = subfiles ;
 
+    std::vector<DirectoryStorage::EntryIndex> subdirs(subDirs(dirEntry(indx)).begin(),subDirs(dirEntry(indx)).end()) ;
+    std::vector<DirectoryStorage::EntryIndex> old_subfiles(subFiles(dirEntry(indx)).begin(),subFiles(dirEntry(indx)).end()) ;
+    std::vector<DirectoryStorage::EntryIndex> new_subfiles ;
+
     // remove from new_files the ones that already exist and have a modf time that is not older.
 
-    for(uint32_t i=0;i<d.subfiles.size();)
+    for(uint32_t i=0;i<old_subfiles.size();++i)
     {
-        FileEntry& f(*static_cast<FileEntry*>(mNodes[d.subfiles[i]])) ;
-        std::map<std::string,DirectoryStorage::FileTS>::const_iterator it = subfiles.find(f.file_name) ;
+        if(mNodeTypes[old_subfiles[i]] != FileStorageNode::TYPE_FILE)
+            continue ;
+
+        uint32_t slot = mNodeSlots[old_subfiles[i]] ;
+        std::string file_name = fileName(slot) ;
+
+        std::map<std::string,DirectoryStorage::FileTS>::const_iterator it = subfiles.find(file_name) ;
 
         if(it == subfiles.end())				// file does not exist anymore => delete
         {
 #ifdef DEBUG_DIRECTORY_STORAGE
-            std::cerr << "[directory storage] removing non existing file " << f.file_name << " at index " << d.subfiles[i] << std::endl;
+            std::cerr << "[directory storage] removing non existing file " << file_name << " at index " << old_subfiles[i] << std::endl;
 #endif
 
-            deleteFileNode(d.subfiles[i]) ;
-
-            d.subfiles[i] = d.subfiles[d.subfiles.size()-1] ;
-            d.subfiles.pop_back();
+            deleteFileNode(old_subfiles[i]) ;
             continue;
         }
 
 		// file is newer and/or has different size
-		if(it->second.modtime != f.file_modtime || it->second.size != f.file_size)
+		if(it->second.modtime != mFileModTimes[slot] || it->second.size != mFileSizes[slot])
         {
 			// hash needs recomputing
-			f.file_hash.clear();
-            f.file_modtime = it->second.modtime;
-            f.file_size = it->second.size;
+			mFileHashList[slot].clear();
 
-            mTotalSize -= f.file_size ;
+            mTotalSize -= mFileSizes[slot] ;
             mTotalSize += it->second.size ;
-        }
-        new_files.erase(f.file_name) ;
 
-        ++i;
+            mFileModTimes[slot] = it->second.modtime;
+            mFileSizes[slot] = it->second.size;
+        }
+        new_files.erase(file_name) ;
+        new_subfiles.push_back(old_subfiles[i]) ;
     }
 
     for(std::map<std::string,DirectoryStorage::FileTS>::const_iterator it(new_files.begin());it!=new_files.end();++it)
     {
+        DirectoryStorage::EntryIndex file_index = allocateNewIndex() ;
+
 #ifdef DEBUG_DIRECTORY_STORAGE
-        std::cerr << "[directory storage] adding new file " << it->first << " at index " << mNodes.size() << std::endl;
+        std::cerr << "[directory storage] adding new file " << it->first << " at index " << file_index << std::endl;
 #endif
 
-        d.subfiles.push_back(mNodes.size()) ;
-        mNodes.push_back(new FileEntry(it->first,it->second.size,it->second.modtime));
-        mNodes.back()->row = mNodes.size()-1;
-        mNodes.back()->parent_index = indx;
+        setFileNode(file_index,it->first,it->second.size,it->second.modtime,RsFileHash()) ;
+        mFileRows[mNodeSlots[file_index]] = file_index;
+        mFileParents[mNodeSlots[file_index]] = indx;
+
+        new_subfiles.push_back(file_index) ;
 
         mTotalSize  += it->second.size;
         mTotalFiles += 1;
     }
+
+    setChildren(dirEntry(indx),subdirs,new_subfiles) ;
+
     return true;
 }
 bool InternalFileHierarchyStorage::updateHash(
@@ -377,10 +417,8 @@ bool InternalFileHierarchyStorage::updateHash(
     std::cerr << "[directory storage] updating hash at index " << file_index << ", hash=" << hash << std::endl;
 #endif
 
-    RsFileHash& old_hash (static_cast<FileEntry*>(mNodes[file_index])->file_hash) ;
     mFileHashes[hash] = file_index ;
-
-    old_hash = hash ;
+    mFileHashList[mNodeSlots[file_index]] = hash ;
 
     return true;
 }
@@ -392,20 +430,20 @@ bool InternalFileHierarchyStorage::updateFile(const DirectoryStorage::EntryIndex
         return false;
     }
 
-    FileEntry& fe(*static_cast<FileEntry*>(mNodes[file_index])) ;
+    uint32_t slot = mNodeSlots[file_index] ;
 
 #ifdef DEBUG_DIRECTORY_STORAGE
-    std::cerr << "[directory storage] updating file entry at index " << file_index << ", name=" << fe.file_name << " size=" << fe.file_size << ", hash=" << fe.file_hash << std::endl;
+    std::cerr << "[directory storage] updating file entry at index " << file_index << ", name=" << fileName(slot) << " size=" << mFileSizes[slot] << ", hash=" << mFileHashList[slot] << std::endl;
 #endif
-    if(mTotalSize >= fe.file_size)
-		mTotalSize -= fe.file_size;
+    if(mTotalSize >= mFileSizes[slot])
+		mTotalSize -= mFileSizes[slot];
 
 	mTotalSize += size ;
 
-    fe.file_hash = hash;
-    fe.file_size = size;
-    fe.file_modtime = modf_time;
-    fe.file_name = fname;
+    mFileHashList[slot] = hash;
+    mFileSizes[slot] = size;
+    mFileModTimes[slot] = modf_time;
+    setFileName(file_index,fname) ;
 
     if(!hash.isNull())
         mFileHashes[hash] = file_index ;
@@ -415,34 +453,58 @@ bool InternalFileHierarchyStorage::updateFile(const DirectoryStorage::EntryIndex
 
 void InternalFileHierarchyStorage::deleteFileNode(uint32_t index)
 {
-	if(mNodes[index] != NULL)
+	if(index < mNodeTypes.size() && mNodeTypes[index] == FileStorageNode::TYPE_FILE)
 	{
-		FileEntry& fe(*static_cast<FileEntry*>(mNodes[index])) ;
+		uint32_t slot = mNodeSlots[index] ;
 
 #ifdef RS_DEEP_FILES_INDEX
 		DeepFilesIndex tfi(DeepFilesIndex::dbDefaultPath());
-		tfi.removeFileFromIndex(fe.file_hash);
+		tfi.removeFileFromIndex(mFileHashList[slot]);
 #endif
 
-        if(mTotalSize >= fe.file_size)
-			mTotalSize -= fe.file_size ;
+        if(mTotalSize >= mFileSizes[slot])
+			mTotalSize -= mFileSizes[slot] ;
 
         if(mTotalFiles > 0)
 			mTotalFiles -= 1;
 
-		delete mNodes[index] ;
-		mFreeNodes.push_back(index) ;
-		mNodes[index] = NULL ;
+		deleteNode(index) ;
 	}
 }
 void InternalFileHierarchyStorage::deleteNode(uint32_t index)
 {
-    if(mNodes[index] != NULL)
+    if(index >= mNodeTypes.size())
+        return ;
+
+    uint32_t slot = mNodeSlots[index] ;
+
+    switch(mNodeTypes[index])
     {
-        delete mNodes[index] ;
-        mFreeNodes.push_back(index) ;
-        mNodes[index] = NULL ;
+    case FileStorageNode::TYPE_FILE:
+        mNameIndex.remove(mFileNameArena.data()+mFileNameOffsets[slot],mFileNameSizes[slot]) ;
+        mFileNameGarbage += mFileNameSizes[slot] ;
+        mFileNameSizes[slot] = 0 ;
+        mFileParents[slot] = DirectoryStorage::NO_INDEX ;
+        mFileHashList[slot].clear() ;
+        mFreeFileSlots.push_back(slot) ;
+        break ;
+
+    case FileStorageNode::TYPE_DIR:
+        releaseChildren(mDirs[slot]) ;
+        mDirs[slot] = DirEntry("") ;
+        mDirs[slot].parent_index = DirectoryStorage::NO_INDEX ;
+        mFreeDirSlots.push_back(slot) ;
+        break ;
+
+    default:
+        return ;
     }
+
+    mNodeTypes[index] = FileStorageNode::TYPE_UNKNOWN ;
+    mFreeNodes.push_back(index) ;
+
+    if(mNameIndex.needsRebuild())
+        rebuildNameIndex() ;
 }
 
 DirectoryStorage::EntryIndex InternalFileHierarchyStorage::allocateNewIndex()
@@ -452,12 +514,181 @@ DirectoryStorage::EntryIndex InternalFileHierarchyStorage::allocateNewIndex()
         uint32_t index = mFreeNodes.front();
         mFreeNodes.pop_front();
 
-        if(mNodes[index] == NULL)
+        if(index < mNodeTypes.size() && mNodeTypes[index] == FileStorageNode::TYPE_UNKNOWN)
             return DirectoryStorage::EntryIndex(index) ;
     }
 
-	mNodes.push_back(NULL) ;
-	return mNodes.size()-1 ;
+	mNodeTypes.push_back(FileStorageNode::TYPE_UNKNOWN) ;
+	mNodeSlots.push_back(0) ;
+	return mNodeTypes.size()-1 ;
+}
+
+void InternalFileHierarchyStorage::setFileNode(DirectoryStorage::EntryIndex indx,const std::string& name,uint64_t size,rstime_t modtime,const RsFileHash& hash)
+{
+    uint32_t slot ;
+
+    if(!mFreeFileSlots.empty())
+    {
+        slot = mFreeFileSlots.back() ;
+        mFreeFileSlots.pop_back() ;
+    }
+    else
+    {
+        slot = mFileParents.size() ;
+
+        mFileParents.push_back(DirectoryStorage::EntryIndex(DirectoryStorage::NO_INDEX)) ;
+        mFileRows.push_back(0) ;
+        mFileNameOffsets.push_back(0) ;
+        mFileNameSizes.push_back(0) ;
+        mFileSizes.push_back(0) ;
+        mFileModTimes.push_back(0) ;
+        mFileHashList.push_back(RsFileHash()) ;
+    }
+
+    mNodeTypes[indx] = FileStorageNode::TYPE_FILE ;
+    mNodeSlots[indx] = slot ;
+
+    mFileParents[slot] = 0 ;
+    mFileRows[slot] = 0 ;
+    mFileSizes[slot] = size ;
+    mFileModTimes[slot] = modtime ;
+    mFileHashList[slot] = hash ;
+
+    setFileName(indx,name) ;
+}
+
+void InternalFileHierarchyStorage::setDirNode(DirectoryStorage::EntryIndex indx,const std::string& name)
+{
+    uint32_t slot ;
+
+    if(!mFreeDirSlots.empty())
+    {
+        slot = mFreeDirSlots.back() ;
+        mFreeDirSlots.pop_back() ;
+        mDirs[slot] = DirEntry(name) ;
+    }
+    else
+    {
+        slot = mDirs.size() ;
+        mDirs.push_back(DirEntry(name)) ;
+    }
+
+    mNodeTypes[indx] = FileStorageNode::TYPE_DIR ;
+    mNodeSlots[indx] = slot ;
+}
+
+void InternalFileHierarchyStorage::setFileName(DirectoryStorage::EntryIndex indx,const std::string& name)
+{
+    uint32_t slot = mNodeSlots[indx] ;
+
+    if(mFileNameSizes[slot] == name.size() && !memcmp(mFileNameArena.data()+mFileNameOffsets[slot],name.data(),name.size()))
+        return ;
+
+    mNameIndex.remove(mFileNameArena.data()+mFileNameOffsets[slot],mFileNameSizes[slot]) ;
+    mFileNameGarbage += mFileNameSizes[slot] ;
+
+    mFileNameOffsets[slot] = mFileNameArena.size() ;
+    mFileNameSizes[slot] = name.size() ;
+    mFileNameArena.insert(mFileNameArena.end(),name.begin(),name.end()) ;
+
+    mNameIndex.insert(indx,name.data(),name.size()) ;
+
+    if(mFileNameGarbage > FILE_NAME_ARENA_MIN_GARBAGE && 2*mFileNameGarbage > mFileNameArena.size())
+        compactFileNames() ;
+
+    if(mNameIndex.needsRebuild())
+        rebuildNameIndex() ;
+}
+
+void InternalFileHierarchyStorage::rebuildNameIndex()
+{
+    mNameIndex.clear() ;
+
+    for(uint32_t i=0;i<mNodeTypes.size();++i)
+        if(mNodeTypes[i] == FileStorageNode::TYPE_FILE)
+        {
+            uint32_t slot = mNodeSlots[i] ;
+            mNameIndex.insert(i,mFileNameArena.data()+mFileNameOffsets[slot],mFileNameSizes[slot]) ;
+        }
+}
+
+void InternalFileHierarchyStorage::compactFileNames()
+{
+    std::vector<char> arena ;
+    arena.reserve(mFileNameArena.size() - mFileNameGarbage) ;
+
+    for(uint32_t i=0;i<mFileParents.size();++i)
+    {
+        if(mFileParents[i] == DirectoryStorage::NO_INDEX)	// free slot
+        {
+            mFileNameOffsets[i] = 0 ;
+            mFileNameSizes[i] = 0 ;
+            continue ;
+        }
+        uint32_t offset = arena.size() ;
+
+        arena.insert(arena.end(),mFileNameArena.begin()+mFileNameOffsets[i],mFileNameArena.begin()+mFileNameOffsets[i]+mFileNameSizes[i]) ;
+        mFileNameOffsets[i] = offset ;
+    }
+
+    mFileNameArena.swap(arena) ;
+    mFileNameGarbage = 0 ;
+}
+
+void InternalFileHierarchyStorage::setChildren(DirEntry& d,const std::vector<DirectoryStorage::EntryIndex>& subdirs,const std::vector<DirectoryStorage::EntryIndex>& subfiles)
+{
+    uint32_t n = subdirs.size() + subfiles.size() ;
+
+    if(n > d.children_capacity)
+    {
+        // The range is too small. Move it to the end of the array and leave the old one as garbage.
+
+        releaseChildren(d) ;
+
+        if(mChildrenGarbage > CHILDREN_MIN_GARBAGE && 2*mChildrenGarbage > mChildren.size())
+            compactChildren() ;
+
+        d.children_offset = mChildren.size() ;
+        d.children_capacity = n ;
+        mChildren.resize(mChildren.size() + n) ;
+    }
+
+    std::copy(subdirs.begin(),subdirs.end(),mChildren.begin() + d.children_offset) ;
+    std::copy(subfiles.begin(),subfiles.end(),mChildren.begin() + d.children_offset + subdirs.size()) ;
+
+    d.subdirs_count = subdirs.size() ;
+    d.subfiles_count = subfiles.size() ;
+}
+
+void InternalFileHierarchyStorage::releaseChildren(DirEntry& d)
+{
+    mChildrenGarbage += d.children_capacity ;
+
+    d.children_offset = 0 ;
+    d.children_capacity = 0 ;
+    d.subdirs_count = 0 ;
+    d.subfiles_count = 0 ;
+}
+
+void InternalFileHierarchyStorage::compactChildren()
+{
+    std::vector<DirectoryStorage::EntryIndex> children ;
+    children.reserve(mChildren.size() - mChildrenGarbage) ;
+
+    for(uint32_t i=0;i<mDirs.size();++i)
+    {
+        DirEntry& d(mDirs[i]) ;
+        uint32_t n = d.subdirs_count + d.subfiles_count ;
+        uint32_t offset = children.size() ;
+
+        children.insert(children.end(),mChildren.begin()+d.children_offset,mChildren.begin()+d.children_offset+n) ;
+
+        d.children_offset = offset ;
+        d.children_capacity = n ;
+    }
+
+    mChildren.swap(children) ;
+    mChildrenGarbage = 0 ;
 }
 
 bool InternalFileHierarchyStorage::updateDirEntry(
@@ -473,23 +704,27 @@ bool InternalFileHierarchyStorage::updateDirEntry(
 		return false;
 	}
 
-	DirEntry& d(*static_cast<DirEntry*>(mNodes[indx]));
-
 #ifdef DEBUG_DIRECTORY_STORAGE
     std::cerr << "Updating dir entry: name=\"" << dir_name << "\", most_recent_time=" << most_recent_time << ", modtime=" << dir_modtime << std::endl;
 #endif
 
-    d.dir_most_recent_time = most_recent_time;
-    d.dir_modtime      = dir_modtime;
-    d.dir_update_time  = time(NULL);
-    d.dir_name         = dir_name;
+    {
+        DirEntry& d(dirEntry(indx));
+
+        d.dir_most_recent_time = most_recent_time;
+        d.dir_modtime      = dir_modtime;
+        d.dir_update_time  = time(NULL);
+        d.dir_name         = dir_name;
+    }
 
     std::map<RsFileHash,DirectoryStorage::EntryIndex> existing_subdirs ;
 
-    for(uint32_t i=0;i<d.subdirs.size();++i)
-        existing_subdirs[static_cast<DirEntry*>(mNodes[d.subdirs[i]])->dir_hash] = d.subdirs[i] ;
+    for(DirectoryStorage::EntryIndex e : subDirs(dirEntry(indx)))
+        if(mNodeTypes[e] == FileStorageNode::TYPE_DIR)
+            existing_subdirs[dirEntry(e).dir_hash] = e ;
 
-    d.subdirs.clear();
+    std::vector<DirectoryStorage::EntryIndex> new_subdirs ;
+    const std::string subdirs_parent_path = RsDirUtil::makePath(dirEntry(indx).dir_parent_path, dir_name) ;
 
     // check that all subdirs already exist. If not, create.
     for(uint32_t i=0;i<subdirs_hash.size();++i)
@@ -501,7 +736,7 @@ bool InternalFileHierarchyStorage::updateDirEntry(
         std::map<RsFileHash,DirectoryStorage::EntryIndex>::iterator it = existing_subdirs.find(subdirs_hash[i]) ;
         DirectoryStorage::EntryIndex dir_index = 0;
 
-        if(it != existing_subdirs.end() && mNodes[it->second] != NULL && mNodes[it->second]->type() == FileStorageNode::TYPE_DIR)
+        if(it != existing_subdirs.end() && mNodeTypes[it->second] == FileStorageNode::TYPE_DIR)
         {
             dir_index = it->second ;
 
@@ -514,13 +749,12 @@ bool InternalFileHierarchyStorage::updateDirEntry(
         else
         {
             dir_index = allocateNewIndex() ;
+            setDirNode(dir_index,"") ;
 
-            DirEntry *de = new DirEntry("") ;
-
-            mNodes[dir_index] = de ;
+            DirEntry& de(dirEntry(dir_index)) ;
 
-			de->dir_parent_path = RsDirUtil::makePath(d.dir_parent_path, dir_name) ;
-            de->dir_hash        = subdirs_hash[i];
+            de.dir_parent_path = subdirs_parent_path ;
+            de.dir_hash        = subdirs_hash[i];
 
             mDirHashes[subdirs_hash[i]] = dir_index ;
 
@@ -529,7 +763,7 @@ bool InternalFileHierarchyStorage::updateDirEntry(
 #endif
         }
 
-        d.subdirs.push_back(dir_index) ;
+        new_subdirs.push_back(dir_index) ;
         mDirHashes[subdirs_hash[i]] = dir_index ;
     }
     // remove subdirs that do not exist anymore
@@ -552,10 +786,11 @@ bool InternalFileHierarchyStorage::updateDirEntry(
 
     std::map<std::string,DirectoryStorage::EntryIndex> existing_subfiles ;
 
-    for(uint32_t i=0;i<d.subfiles.size();++i)
-        existing_subfiles[static_cast<FileEntry*>(mNodes[d.subfiles[i]])->file_name] = d.subfiles[i] ;
+    for(DirectoryStorage::EntryIndex e : subFiles(dirEntry(indx)))
+        if(mNodeTypes[e] == FileStorageNode::TYPE_FILE)
+            existing_subfiles[fileName(mNodeSlots[e])] = e ;
 
-    d.subfiles.clear();
+    std::vector<DirectoryStorage::EntryIndex> new_subfiles ;
 
     for(uint32_t i=0;i<subfiles_array.size();++i)
     {
@@ -567,7 +802,7 @@ bool InternalFileHierarchyStorage::updateDirEntry(
         std::cerr << "  subfile name = " << subfiles_array[i].file_name << ": " ;
 #endif
 
-        if(it != existing_subfiles.end() && mNodes[it->second] != NULL && mNodes[it->second]->type() == FileStorageNode::TYPE_FILE)
+        if(it != existing_subfiles.end() && mNodeTypes[it->second] == FileStorageNode::TYPE_FILE)
         {
             file_index = it->second ;
 
@@ -584,7 +819,7 @@ bool InternalFileHierarchyStorage::updateDirEntry(
         {
             file_index = allocateNewIndex() ;
 
-            mNodes[file_index] = new FileEntry(f.file_name,f.file_size,f.file_modtime,f.file_hash) ;
+            setFileNode(file_index,f.file_name,f.file_size,f.file_modtime,f.file_hash) ;
             mFileHashes[f.file_hash] = file_index ;
             mTotalSize += f.file_size ;
             mTotalFiles++;
@@ -594,7 +829,7 @@ bool InternalFileHierarchyStorage::updateDirEntry(
 #endif
         }
 
-        d.subfiles.push_back(file_index) ;
+        new_subfiles.push_back(file_index) ;
     }
     // remove subfiles that do not exist anymore
 
@@ -612,23 +847,25 @@ bool InternalFileHierarchyStorage::updateDirEntry(
         deleteFileNode(it->second) ;
     }
 
+    setChildren(dirEntry(indx),new_subdirs,new_subfiles) ;
+
     // now update row and parent index for all subnodes
 
     uint32_t n=0;
-    for(uint32_t i=0;i<d.subdirs.size();++i)
+    for(uint32_t i=0;i<new_subdirs.size();++i)
     {
-        static_cast<DirEntry*>(mNodes[d.subdirs[i]])->dir_update_time = 0 ;	// force the update of the subdir.
+        DirEntry& de(dirEntry(new_subdirs[i])) ;
 
-        mNodes[d.subdirs[i]]->parent_index = indx ;
-        mNodes[d.subdirs[i]]->row = n++ ;
+        de.dir_update_time = 0 ;	// force the update of the subdir.
+        de.parent_index = indx ;
+        de.row = n++ ;
     }
-    for(uint32_t i=0;i<d.subfiles.size();++i)
+    for(uint32_t i=0;i<new_subfiles.size();++i)
     {
-        mNodes[d.subfiles[i]]->parent_index = indx ;
-        mNodes[d.subfiles[i]]->row = n++ ;
+        mFileParents[mNodeSlots[new_subfiles[i]]] = indx ;
+        mFileRows[mNodeSlots[new_subfiles[i]]] = n++ ;
     }
 
-
     return true;
 }
 
@@ -636,6 +873,39 @@ void InternalFileHierarchyStorage::getStatistics(SharedDirStats& stats) const
 {
     stats.total_number_of_files = mTotalFiles ;
     stats.total_shared_size = mTotalSize ;
+    stats.total_memory_usage = memoryUsage() ;
+}
+
+size_t InternalFileHierarchyStorage::memoryUsage() const
+{
+    size_t res = mNodeTypes.capacity() * sizeof(uint8_t)
+            + mNodeSlots.capacity() * sizeof(uint32_t)
+            + mFreeNodes.size() * (sizeof(uint32_t) + 2*sizeof(void*))
+            + mFileParents.capacity() * sizeof(DirectoryStorage::EntryIndex)
+            + mFileRows.capacity() * sizeof(uint32_t)
+            + mFileNameOffsets.capacity() * sizeof(uint32_t)
+            + mFileNameSizes.capacity() * sizeof(uint32_t)
+            + mFileSizes.capacity() * sizeof(uint64_t)
+            + mFileModTimes.capacity() * sizeof(rstime_t)
+            + mFileHashList.capacity() * sizeof(RsFileHash)
+            + mFreeFileSlots.capacity() * sizeof(uint32_t)
+            + mFileNameArena.capacity()
+            + mDirs.capacity() * sizeof(DirEntry)
+            + mFreeDirSlots.capacity() * sizeof(uint32_t)
+            + mChildren.capacity() * sizeof(DirectoryStorage::EntryIndex)
+            + mFileHashes.memoryUsage()
+            + mDirHashes.memoryUsage()
+            + mNameIndex.memoryUsage() ;
+
+    // dir names and paths that do not fit in the string itself
+
+    for(uint32_t i=0;i<mDirs.size();++i)
+    {
+        if(mDirs[i].dir_name.capacity() >= sizeof(std::string)) res += mDirs[i].dir_name.capacity() + 1 ;
+        if(mDirs[i].dir_parent_path.capacity() >= sizeof(std::string)) res += mDirs[i].dir_parent_path.capacity() + 1 ;
+    }
+
+    return res ;
 }
 
 bool InternalFileHierarchyStorage::getTS(const DirectoryStorage::EntryIndex& index,rstime_t& TS,rstime_t DirEntry::* m) const
@@ -646,9 +916,7 @@ bool InternalFileHierarchyStorage::getTS(const DirectoryStorage::EntryIndex& ind
         return false;
     }
 
-    DirEntry& d(*static_cast<DirEntry*>(mNodes[index])) ;
-
-    TS = d.*m ;
+    TS = dirEntry(index).*m ;
 
     return true;
 }
@@ -661,9 +929,7 @@ bool InternalFileHierarchyStorage::setTS(const DirectoryStorage::EntryIndex& ind
         return false;
     }
 
-    DirEntry& d(*static_cast<DirEntry*>(mNodes[index])) ;
-
-    d.*m = TS;
+    dirEntry(index).*m = TS;
 
     return true;
 }
@@ -672,43 +938,46 @@ bool InternalFileHierarchyStorage::setTS(const DirectoryStorage::EntryIndex& ind
 
 uint64_t InternalFileHierarchyStorage::recursUpdateCumulatedSize(const DirectoryStorage::EntryIndex& dir_index)
 {
-    DirEntry& d(*static_cast<DirEntry*>(mNodes[dir_index])) ;
-
     uint64_t local_cumulative_size = 0;
 
-    for(uint32_t i=0;i<d.subfiles.size();++i)
-        if(mNodes[d.subfiles[i]])		// normally not needed, but an extra-security
-            local_cumulative_size += static_cast<FileEntry*>(mNodes[d.subfiles[i]])->file_size;
+    for(DirectoryStorage::EntryIndex f : subFiles(dirEntry(dir_index)))
+        if(mNodeTypes[f] == FileStorageNode::TYPE_FILE)		// normally not needed, but an extra-security
+            local_cumulative_size += mFileSizes[mNodeSlots[f]];
 
-    for(uint32_t i=0;i<d.subdirs.size();++i)
-        local_cumulative_size += recursUpdateCumulatedSize(d.subdirs[i]);
+    for(DirectoryStorage::EntryIndex d : subDirs(dirEntry(dir_index)))
+        if(mNodeTypes[d] == FileStorageNode::TYPE_DIR)
+            local_cumulative_size += recursUpdateCumulatedSize(d);
 
-    d.dir_cumulated_size = local_cumulative_size;
+    dirEntry(dir_index).dir_cumulated_size = local_cumulative_size;
     return local_cumulative_size;
 }
 // Do a complete recursive sweep over sub-directories and files, and update the lst modf TS. This could be also performed by a cleanup method.
 
 rstime_t InternalFileHierarchyStorage::recursUpdateLastModfTime(const DirectoryStorage::EntryIndex& dir_index,bool& unfinished_files_present)
 {
-    DirEntry& d(*static_cast<DirEntry*>(mNodes[dir_index])) ;
-
-    rstime_t largest_modf_time = d.dir_modtime ;
+    rstime_t largest_modf_time = dirEntry(dir_index).dir_modtime ;
     unfinished_files_present = false ;
 
-    for(uint32_t i=0;i<d.subfiles.size();++i)
+    for(DirectoryStorage::EntryIndex f : subFiles(dirEntry(dir_index)))
     {
-        FileEntry *f = static_cast<FileEntry*>(mNodes[d.subfiles[i]]) ;
+        if(mNodeTypes[f] != FileStorageNode::TYPE_FILE)
+            continue ;
+
+        uint32_t slot = mNodeSlots[f] ;
 
-        if(!f->file_hash.isNull())
-            largest_modf_time = std::max(largest_modf_time, f->file_modtime) ;	// only account for hashed files, since we never send unhashed files to friends.
+        if(!mFileHashList[slot].isNull())
+            largest_modf_time = std::max(largest_modf_time, mFileModTimes[slot]) ;	// only account for hashed files, since we never send unhashed files to friends.
         else
             unfinished_files_present = true ;
     }
 
-    for(uint32_t i=0;i<d.subdirs.size();++i)
+    for(DirectoryStorage::EntryIndex d : subDirs(dirEntry(dir_index)))
     {
+        if(mNodeTypes[d] != FileStorageNode::TYPE_DIR)
+            continue ;
+
         bool unfinished_files_below = false ;
-        largest_modf_time = std::max(largest_modf_time,recursUpdateLastModfTime(d.subdirs[i],unfinished_files_below)) ;
+        largest_modf_time = std::max(largest_modf_time,recursUpdateLastModfTime(d,unfinished_files_below)) ;
 
         unfinished_files_present = unfinished_files_present || unfinished_files_below ;
     }
@@ -718,62 +987,76 @@ rstime_t InternalFileHierarchyStorage::recursUpdateLastModfTime(const DirectoryS
     if(unfinished_files_present && largest_modf_time > 0)
         largest_modf_time-- ;
 
-    d.dir_most_recent_time = largest_modf_time ;
+    dirEntry(dir_index).dir_most_recent_time = largest_modf_time ;
 
     return largest_modf_time ;
 }
 
 // Low level stuff. Should normally not be used externally.
 
-const InternalFileHierarchyStorage::FileStorageNode *InternalFileHierarchyStorage::getNode(DirectoryStorage::EntryIndex indx) const
-{
-    if(checkIndex(indx,FileStorageNode::TYPE_FILE | FileStorageNode::TYPE_DIR))
-        return mNodes[indx] ;
-    else
-        return NULL ;
-}
-
 const InternalFileHierarchyStorage::DirEntry*
 InternalFileHierarchyStorage::getDirEntry(DirectoryStorage::EntryIndex indx) const
 {
 	if(!checkIndex(indx,FileStorageNode::TYPE_DIR)) return nullptr;
-	return static_cast<DirEntry*>(mNodes[indx]);
+	return &dirEntry(indx);
 }
-const InternalFileHierarchyStorage::FileEntry*
-InternalFileHierarchyStorage::getFileEntry(DirectoryStorage::EntryIndex indx) const
+bool InternalFileHierarchyStorage::getFileEntry(DirectoryStorage::EntryIndex indx,FileEntry& fe) const
 {
     if(!checkIndex(indx,FileStorageNode::TYPE_FILE))
-        return NULL ;
+        return false ;
+
+    uint32_t slot = mNodeSlots[indx] ;
+
+    fe.parent_index = mFileParents[slot] ;
+    fe.row          = mFileRows[slot] ;
+    fe.file_name    = fileName(slot) ;
+    fe.file_size    = mFileSizes[slot] ;
+    fe.file_modtime = mFileModTimes[slot] ;
+    fe.file_hash    = mFileHashList[slot] ;
+
+    return true ;
+}
+DirectoryStorage::EntryIndex InternalFileHierarchyStorage::getParentIndex(DirectoryStorage::EntryIndex indx) const
+{
+    if(!checkIndex(indx,FileStorageNode::TYPE_FILE | FileStorageNode::TYPE_DIR))
+        return DirectoryStorage::NO_INDEX ;
 
-    return static_cast<FileEntry*>(mNodes[indx]) ;
+    if(mNodeTypes[indx] == FileStorageNode::TYPE_FILE)
+        return mFileParents[mNodeSlots[indx]] ;
+    else
+        return dirEntry(indx).parent_index ;
 }
 uint32_t InternalFileHierarchyStorage::getType(DirectoryStorage::EntryIndex indx) const
 {
     if(checkIndex(indx,FileStorageNode::TYPE_FILE | FileStorageNode::TYPE_DIR))
-        return mNodes[indx]->type() ;
+        return mNodeTypes[indx] ;
     else
         return FileStorageNode::TYPE_UNKNOWN;
 }
 
-DirectoryStorage::EntryIndex InternalFileHierarchyStorage::getSubFileIndex(DirectoryStorage::EntryIndex parent_index,uint32_t file_tab_index)
+DirectoryStorage::EntryIndex InternalFileHierarchyStorage::getSubFileIndex(DirectoryStorage::EntryIndex parent_index,uint32_t file_tab_index) const
 {
     if(!checkIndex(parent_index,FileStorageNode::TYPE_DIR))
         return DirectoryStorage::NO_INDEX;
 
-    if(static_cast<DirEntry*>(mNodes[parent_index])->subfiles.size() <= file_tab_index)
+    const DirEntry& d(dirEntry(parent_index)) ;
+
+    if(d.subfiles_count <= file_tab_index)
         return DirectoryStorage::NO_INDEX;
 
-    return static_cast<DirEntry*>(mNodes[parent_index])->subfiles[file_tab_index];
+    return subFiles(d)[file_tab_index];
 }
-DirectoryStorage::EntryIndex InternalFileHierarchyStorage::getSubDirIndex(DirectoryStorage::EntryIndex parent_index,uint32_t dir_tab_index)
+DirectoryStorage::EntryIndex InternalFileHierarchyStorage::getSubDirIndex(DirectoryStorage::EntryIndex parent_index,uint32_t dir_tab_index) const
 {
     if(!checkIndex(parent_index,FileStorageNode::TYPE_DIR))
         return DirectoryStorage::NO_INDEX;
 
-    if(static_cast<DirEntry*>(mNodes[parent_index])->subdirs.size() <= dir_tab_index)
+    const DirEntry& d(dirEntry(parent_index)) ;
+
+    if(d.subdirs_count <= dir_tab_index)
         return DirectoryStorage::NO_INDEX;
 
-    return static_cast<DirEntry*>(mNodes[parent_index])->subdirs[dir_tab_index];
+    return subDirs(d)[dir_tab_index];
 }
 
 bool InternalFileHierarchyStorage::searchHash(const RsFileHash& hash,DirectoryStorage::EntryIndex& result)
@@ -781,37 +1064,125 @@ bool InternalFileHierarchyStorage::searchHash(const RsFileHash& hash,DirectorySt
     return getIndexFromFileHash(hash,result);
 }
 
+void InternalFileHierarchyStorage::getFileHashes(std::vector<RsFileHash>& hashes) const
+{
+    hashes.reserve(hashes.size() + mFileHashes.size());
+
+    for(auto& it: mFileHashes)
+        hashes.push_back(it.first);
+}
+
 class DirectoryStorageExprFileEntry: public RsRegularExpression::ExpFileEntry
 {
 public:
 	DirectoryStorageExprFileEntry(
-	        const InternalFileHierarchyStorage::FileEntry& fe,
+	        const char *name, uint32_t name_size, uint64_t size,
+	        rstime_t modtime, const RsFileHash& hash,
 	        const InternalFileHierarchyStorage::DirEntry& parent ) :
-	    mFe(fe), mDe(parent) {}
+	    mName(name), mNameSize(name_size), mSize(size), mModTime(modtime),
+	    mHash(hash), mNameSet(false), mDe(parent) {}
 
-    inline virtual const std::string& file_name()       const { return mFe.file_name ; }
-    inline virtual uint64_t           file_size()       const { return mFe.file_size ; }
-    inline virtual const RsFileHash&  file_hash()       const { return mFe.file_hash ; }
-    inline virtual rstime_t             file_modtime()    const { return mFe.file_modtime ; }
+	// The name is only copied out of the names arena when the expression needs it.
+	inline virtual const std::string& file_name() const
+	{
+		if(!mNameSet) { mNameStr.assign(mName,mNameSize); mNameSet = true; }
+		return mNameStr;
+	}
+    inline virtual uint64_t           file_size()       const { return mSize ; }
+    inline virtual const RsFileHash&  file_hash()       const { return mHash ; }
+    inline virtual rstime_t             file_modtime()    const { return mModTime ; }
 	inline virtual std::string        file_parent_path()const { return RsDirUtil::makePath(mDe.dir_parent_path, mDe.dir_name) ; }
     inline virtual uint32_t           file_popularity() const { NOT_IMPLEMENTED() ; return 0; }
 
 private:
-    const InternalFileHierarchyStorage::FileEntry& mFe ;
+    const char *mName ;
+    uint32_t mNameSize ;
+    uint64_t mSize ;
+    rstime_t mModTime ;
+    const RsFileHash& mHash ;
+    mutable std::string mNameStr ;
+    mutable bool mNameSet ;
     const InternalFileHierarchyStorage::DirEntry& mDe ;
 };
 
+bool InternalFileHierarchyStorage::isHashedFile(DirectoryStorage::EntryIndex indx) const
+{
+	if(indx >= mNodeTypes.size() || mNodeTypes[indx] != FileStorageNode::TYPE_FILE)
+		return false;
+
+	auto it = mFileHashes.find(mFileHashList[mNodeSlots[indx]]);
+	return it != mFileHashes.end() && it->second == indx;
+}
+
+bool InternalFileHierarchyStorage::evalFile(
+        RsRegularExpression::Expression* exp,
+        DirectoryStorage::EntryIndex indx ) const
+{
+	uint32_t slot = mNodeSlots[indx];
+	DirectoryStorage::EntryIndex parent = mFileParents[slot];
+
+	if( parent >= mNodeTypes.size() ||
+	        mNodeTypes[parent] != FileStorageNode::TYPE_DIR )
+		return false;
+
+	return exp->eval(
+	            DirectoryStorageExprFileEntry(
+	                mFileNameArena.data()+mFileNameOffsets[slot],
+	                mFileNameSizes[slot], mFileSizes[slot],
+	                mFileModTimes[slot], mFileHashList[slot],
+	                dirEntry(parent) ) );
+}
+
+bool InternalFileHierarchyStorage::fileNameContainsAny(
+        uint32_t slot, const std::list<std::string>& terms ) const
+{
+	const char* nameBegin = mFileNameArena.data()+mFileNameOffsets[slot];
+	const char* nameEnd = nameBegin + mFileNameSizes[slot];
+
+	/* Most file will just have file name stored, but single file shared
+	 * without a shared dir will contain full path instead of just the
+	 * name, so only search in the last component */
+	for(const char* c = nameEnd; c != nameBegin; --c)
+		if(*(c-1) == '/') { nameBegin = c; break; }
+
+	for(auto& termIt : std::as_const(terms))
+	{
+		/* always ignore case */
+		if(nameEnd != std::search(
+		            nameBegin, nameEnd,
+		            termIt.begin(), termIt.end(),
+		            RsRegularExpression::CompareCharIC() ))
+			return true;
+	}
+	return false;
+}
+
 int InternalFileHierarchyStorage::searchBoolExp(
         RsRegularExpression::Expression* exp,
         std::list<DirectoryStorage::EntryIndex>& results ) const
 {
+	/* When the expression requires the name to contain some strings, only
+	 * the files that the name index returns for them need to be evaluated.
+	 * Candidates are checked against the hash table so that each hash is
+	 * reported once, like in the full scan below. */
+
+	std::list<std::string> terms;
+	std::vector<DirectoryStorage::EntryIndex> candidates;
+
+	if( exp->nameTerms(terms) &&
+	        mNameIndex.getCandidates(terms, candidates) )
+	{
+		for(DirectoryStorage::EntryIndex e : candidates)
+			if(isHashedFile(e) && evalFile(exp, e))
+				results.push_back(e);
+
+		return 0;
+	}
+
 	for(auto& it: std::as_const(mFileHashes))
-		if(mNodes[it.second])
-			if(exp->eval(
-			            DirectoryStorageExprFileEntry(
-			                *static_cast<const FileEntry*>(mNodes[it.second]),
-			                *static_cast<const DirEntry*>(mNodes[mNodes[it.second]->parent_index])
-			                                      ) ))
+		if( it.second < mNodeTypes.size() &&
+		        mNodeTypes[it.second] == FileStorageNode::TYPE_FILE &&
+		        evalFile(exp, it.second) )
 			results.push_back(it.second);
 
     return 0;
@@ -821,41 +1192,29 @@ int InternalFileHierarchyStorage::searchTerms(
         const std::list<std::string>& terms,
         std::list<DirectoryStorage::EntryIndex>& results ) const
 {
-	/* most entries are likely to be files, so we could do a linear search over
-	 * the entries tab. Instead we go through the table of hashes.*/
+	std::vector<DirectoryStorage::EntryIndex> candidates;
+
+	if(mNameIndex.getCandidates(terms, candidates))
+	{
+		for(DirectoryStorage::EntryIndex e : candidates)
+			if( isHashedFile(e) &&
+			        fileNameContainsAny(mNodeSlots[e], terms) )
+				results.push_back(e);
+
+		return 0;
+	}
+
+	/* Some terms are too short for the name index. Most entries are likely to
+	 * be files, so we could do a linear search over the entries tab. Instead we
+	 * go through the table of hashes.*/
 
 	for(auto& it : std::as_const(mFileHashes))
 	{
 		// node may be null for some hash waiting to be deleted
-		if(mNodes[it.second])
-		{
-			rs_view_ptr<FileEntry> tFileEntry =
-			        static_cast<FileEntry*>(mNodes[it.second]);
-
-			/* Most file will just have file name stored, but single file shared
-			 * without a shared dir will contain full path instead of just the
-			 * name, so purify it to perform the search */
-			std::string tFilename = tFileEntry->file_name;
-			if(tFileEntry->file_name.find("/") != std::string::npos)
-			{
-				std::string _tParentDir;
-				RsDirUtil::splitDirFromFile(
-				            tFileEntry->file_name, _tParentDir, tFilename );
-			}
-
-			for(auto& termIt : std::as_const(terms))
-			{
-				/* always ignore case */
-				if(tFilename.end() != std::search(
-				            tFilename.begin(), tFilename.end(),
-				            termIt.begin(), termIt.end(),
-				            RsRegularExpression::CompareCharIC() ))
-				{
-					results.push_back(it.second);
-					break;
-				}
-			}
-		}
+		if( it.second < mNodeTypes.size() &&
+		        mNodeTypes[it.second] == FileStorageNode::TYPE_FILE &&
+		        fileNameContainsAny(mNodeSlots[it.second], terms) )
+			results.push_back(it.second);
 	}
 	return 0;
 }
@@ -871,63 +1230,61 @@ bool InternalFileHierarchyStorage::check(std::string& error_string) // checks co
     bool bFileDouble = false;
     bool bOrphean = false;
 
-    std::vector<uint32_t> hits(mNodes.size(),0) ;	// count hits of children. Should be 1 for all in the end. Otherwise there's an error.
+    std::vector<uint32_t> hits(mNodeTypes.size(),0) ;	// count hits of children. Should be 1 for all in the end. Otherwise there's an error.
     hits[0] = 1 ;	// because 0 is never the child of anyone
 
     mFreeNodes.clear();
 
-    for(uint32_t i=0;i<mNodes.size();++i)
-        if(mNodes[i] != NULL && mNodes[i]->type() == FileStorageNode::TYPE_DIR)
+    for(uint32_t i=0;i<mNodeTypes.size();++i)
+        if(mNodeTypes[i] == FileStorageNode::TYPE_DIR)
         {
             // stamp the kids
-            DirEntry& de = *static_cast<DirEntry*>(mNodes[i]) ;
+            DirEntry& de(dirEntry(i)) ;
+
+            std::vector<DirectoryStorage::EntryIndex> subdirs ;
+            std::vector<DirectoryStorage::EntryIndex> subfiles ;
 
-            for(uint32_t j=0;j<de.subdirs.size();)
+            for(DirectoryStorage::EntryIndex e : subDirs(de))
             {
-                if(de.subdirs[j] >= mNodes.size())
+                if(e >= mNodeTypes.size() || mNodeTypes[e] != FileStorageNode::TYPE_DIR)
                 {
                     if(!bDirOut){ error_string += " - Node child dir out of tab!"; bDirOut = true;}
-                    de.subdirs[j] = de.subdirs.back() ;
-                    de.subdirs.pop_back();
                 }
-                else if(hits[de.subdirs[j]] != 0)
+                else if(hits[e] != 0)
                 {
                     if(!bDirDouble){ error_string += " - Double hit on a single node dir."; bDirDouble = true;}
-                    de.subdirs[j] = de.subdirs.back() ;
-                    de.subdirs.pop_back();
                 }
                 else
                 {
-                    hits[de.subdirs[j]] = 1;
-                    ++j ;
+                    hits[e] = 1;
+                    subdirs.push_back(e) ;
                 }
             }
-            for(uint32_t j=0;j<de.subfiles.size();)
+            for(DirectoryStorage::EntryIndex e : subFiles(de))
             {
-                if(de.subfiles[j] >= mNodes.size())
+                if(e >= mNodeTypes.size() || mNodeTypes[e] != FileStorageNode::TYPE_FILE)
                 {
                     if(!bFileOut){ error_string += " - Node child file out of tab!"; bFileOut = true;}
-                    de.subfiles[j] = de.subfiles.back() ;
-                    de.subfiles.pop_back();
                 }
-                else if(hits[de.subfiles[j]] != 0)
+                else if(hits[e] != 0)
                 {
                     if(!bFileDouble){ error_string += " - Double hit on a single node file."; bFileDouble = true;}
-                    de.subfiles[j] = de.subfiles.back() ;
-                    de.subfiles.pop_back();
                 }
                 else
                 {
-                    hits[de.subfiles[j]] = 1;
-                    ++j ;
+                    hits[e] = 1;
+                    subfiles.push_back(e) ;
                 }
             }
+
+            if(subdirs.size() != de.subdirs_count || subfiles.size() != de.subfiles_count)
+                setChildren(de,subdirs,subfiles) ;
         }
-        else if( mNodes[i] == NULL )
+        else if( mNodeTypes[i] == FileStorageNode::TYPE_UNKNOWN )
             mFreeNodes.push_back(i) ;
 
     for(uint32_t i=0;i<hits.size();++i)
-        if(hits[i] == 0 && mNodes[i] != NULL)
+        if(hits[i] == 0 && mNodeTypes[i] != FileStorageNode::TYPE_UNKNOWN)
         {
             if(!bOrphean){ error_string += " - Orphean node!"; bOrphean = true;}
 
@@ -944,20 +1301,20 @@ void InternalFileHierarchyStorage::print() const
     int nempty = 0 ;
     int nunknown = 0;
 
-    for(uint32_t i=0;i<mNodes.size();++i)
-        if(mNodes[i] == NULL)
+    for(uint32_t i=0;i<mNodeTypes.size();++i)
+        if(mNodeTypes[i] == FileStorageNode::TYPE_UNKNOWN)
         {
             //std::cerr << "  Node " << i << ": empty " << std::endl;
             ++nempty ;
         }
-        else if(mNodes[i]->type() == FileStorageNode::TYPE_DIR)
+        else if(mNodeTypes[i] == FileStorageNode::TYPE_DIR)
         {
-            std::cerr << "  Node " << i << ": type=" << mNodes[i]->type() << std::endl;
+            std::cerr << "  Node " << i << ": type=" << (int)mNodeTypes[i] << std::endl;
             ++ndirs;
         }
-        else if(mNodes[i]->type() == FileStorageNode::TYPE_FILE)
+        else if(mNodeTypes[i] == FileStorageNode::TYPE_FILE)
         {
-            std::cerr << "  Node " << i << ": type=" << mNodes[i]->type() << std::endl;
+            std::cerr << "  Node " << i << ": type=" << (int)mNodeTypes[i] << std::endl;
             ++nfiles;
         }
         else
@@ -966,46 +1323,47 @@ void InternalFileHierarchyStorage::print() const
             std::cerr << "(EE) Error: unknown type node found!" << std::endl;
         }
 
-    std::cerr << "Total nodes: " << mNodes.size() << " (" << nfiles << " files, " << ndirs << " dirs, " << nempty << " empty slots";
+    std::cerr << "Total nodes: " << mNodeTypes.size() << " (" << nfiles << " files, " << ndirs << " dirs, " << nempty << " empty slots";
     if (nunknown > 0) std::cerr << ", " << nunknown << " unknown";
     std::cerr << ")" << std::endl;
+    std::cerr << "Memory usage: " << memoryUsage() << " bytes" << std::endl;
 
 
     recursPrint(0,DirectoryStorage::EntryIndex(0));
 
     std::cerr << "Known dir hashes: " << std::endl;
-    for(std::map<RsFileHash,DirectoryStorage::EntryIndex>::const_iterator  it(mDirHashes.begin());it!=mDirHashes.end();++it)
+    for(auto it(mDirHashes.begin());it!=mDirHashes.end();++it)
         std::cerr << "  " << it->first << " at index " << it->second << std::endl;
 
     std::cerr << "Known file hashes: " << std::endl;
-    for(std::map<RsFileHash,DirectoryStorage::EntryIndex>::const_iterator  it(mFileHashes.begin());it!=mFileHashes.end();++it)
+    for(auto it(mFileHashes.begin());it!=mFileHashes.end();++it)
         std::cerr << "  " << it->first << " at index " << it->second << std::endl;
 }
 void InternalFileHierarchyStorage::recursPrint(int depth,DirectoryStorage::EntryIndex node) const
 {
     std::string indent(2*depth,' ');
 
-    if(mNodes[node] == NULL)
+    if(node >= mNodeTypes.size() || mNodeTypes[node] != FileStorageNode::TYPE_DIR)
     {
         std::cerr << "EMPTY NODE !!" << std::endl;
         return ;
     }
-    DirEntry& d(*static_cast<DirEntry*>(mNodes[node]));
+    const DirEntry& d(dirEntry(node));
 
     std::cerr << indent << "dir hash=" << d.dir_hash << ". name:" << d.dir_name << ", parent_path:" << d.dir_parent_path << ", modf time: " << d.dir_modtime << ", recurs_last_modf_time: " << d.dir_most_recent_time << ", parent: " << d.parent_index << ", row: " << d.row << ", subdirs: " ;
 
-    for(uint32_t i=0;i<d.subdirs.size();++i)
-        std::cerr << d.subdirs[i] << " " ;
+    for(DirectoryStorage::EntryIndex e : subDirs(d))
+        std::cerr << e << " " ;
     std::cerr << std::endl;
 
-    for(uint32_t i=0;i<d.subdirs.size();++i)
-        recursPrint(depth+1,d.subdirs[i]) ;
+    for(DirectoryStorage::EntryIndex e : subDirs(d))
+        recursPrint(depth+1,e) ;
 
-    for(uint32_t i=0;i<d.subfiles.size();++i)
-        if(mNodes[d.subfiles[i]] != NULL)
+    for(DirectoryStorage::EntryIndex e : subFiles(d))
+        if(mNodeTypes[e] == FileStorageNode::TYPE_FILE)
         {
-            FileEntry& f(*static_cast<FileEntry*>(mNodes[d.subfiles[i]]));
-            std::cerr << indent << "  hash:" << f.file_hash << " ts:" << (uint64_t)f.file_modtime << "  " << f.file_size << "  " << f.file_name << ", parent: " << f.parent_index << ", row: " << f.row << std::endl;
+            uint32_t slot = mNodeSlots[e] ;
+            std::cerr << indent << "  hash:" << mFileHashList[slot] << " ts:" << (uint64_t)mFileModTimes[slot] << "  " << mFileSizes[slot] << "  " << fileName(slot) << ", parent: " << mFileParents[slot] << ", row: " << mFileRows[slot] << std::endl;
         }
 }
 
@@ -1020,15 +1378,16 @@ bool InternalFileHierarchyStorage::nodeAccessError(const std::string& s)
 
 bool InternalFileHierarchyStorage::recursRemoveDirectory(DirectoryStorage::EntryIndex dir)
 {
-    DirEntry& d(*static_cast<DirEntry*>(mNodes[dir])) ;
+    const DirEntry& d(dirEntry(dir)) ;
 
     RsFileHash hash = d.dir_hash ;
 
-    for(uint32_t i=0;i<d.subdirs.size();++i)
-        recursRemoveDirectory(d.subdirs[i]);
+    for(DirectoryStorage::EntryIndex e : subDirs(d))
+        if(mNodeTypes[e] == FileStorageNode::TYPE_DIR)
+            recursRemoveDirectory(e);
 
-    for(uint32_t i=0;i<d.subfiles.size();++i)
-        deleteFileNode(d.subfiles[i]);
+    for(DirectoryStorage::EntryIndex e : subFiles(d))
+        deleteFileNode(e);
 
     deleteNode(dir) ;
 
@@ -1055,14 +1414,15 @@ bool InternalFileHierarchyStorage::save(const std::string& fname)
         // Write some header
 
         if(!FileListIO::writeField(buffer,buffer_size,buffer_offset,FILE_LIST_IO_TAG_LOCAL_DIRECTORY_VERSION,(uint32_t) FILE_LIST_IO_LOCAL_DIRECTORY_STORAGE_VERSION_0001)) throw std::runtime_error("Write error") ;
-        if(!FileListIO::writeField(buffer,buffer_size,buffer_offset,FILE_LIST_IO_TAG_RAW_NUMBER,(uint32_t) mNodes.size())) throw std::runtime_error("Write error") ;
+        if(!FileListIO::writeField(buffer,buffer_size,buffer_offset,FILE_LIST_IO_TAG_RAW_NUMBER,(uint32_t) mNodeTypes.size())) throw std::runtime_error("Write error") ;
 
         // Write all file/dir entries
 
-        for(uint32_t i=0;i<mNodes.size();++i)
-            if(mNodes[i] != NULL && mNodes[i]->type() == FileStorageNode::TYPE_FILE)
+        for(uint32_t i=0;i<mNodeTypes.size();++i)
+            if(mNodeTypes[i] == FileStorageNode::TYPE_FILE)
             {
-                const FileEntry& fe(*static_cast<const FileEntry*>(mNodes[i])) ;
+                FileEntry fe ;
+                getFileEntry(i,fe) ;
 
                 uint32_t file_section_offset = 0 ;
 
@@ -1076,9 +1436,9 @@ bool InternalFileHierarchyStorage::save(const std::string& fname)
 
                 if(!FileListIO::writeField(buffer,buffer_size,buffer_offset,FILE_LIST_IO_TAG_LOCAL_FILE_ENTRY,tmp_section_data,file_section_offset)) throw std::runtime_error("Write error") ;
             }
-            else if(mNodes[i] != NULL && mNodes[i]->type() == FileStorageNode::TYPE_DIR)
+            else if(mNodeTypes[i] == FileStorageNode::TYPE_DIR)
             {
-                const DirEntry& de(*static_cast<const DirEntry*>(mNodes[i])) ;
+                const DirEntry& de(dirEntry(i)) ;
 
                 uint32_t dir_section_offset = 0 ;
 
@@ -1092,15 +1452,15 @@ bool InternalFileHierarchyStorage::save(const std::string& fname)
                 if(!FileListIO::writeField(tmp_section_data,tmp_section_size,dir_section_offset,FILE_LIST_IO_TAG_UPDATE_TS      ,(uint32_t)de.dir_update_time   )) throw std::runtime_error("Write error") ;
                 if(!FileListIO::writeField(tmp_section_data,tmp_section_size,dir_section_offset,FILE_LIST_IO_TAG_RECURS_MODIF_TS,(uint32_t)de.dir_most_recent_time  )) throw std::runtime_error("Write error") ;
 
-                if(!FileListIO::writeField(tmp_section_data,tmp_section_size,dir_section_offset,FILE_LIST_IO_TAG_RAW_NUMBER,(uint32_t)de.subdirs.size())) throw std::runtime_error("Write error") ;
+                if(!FileListIO::writeField(tmp_section_data,tmp_section_size,dir_section_offset,FILE_LIST_IO_TAG_RAW_NUMBER,(uint32_t)de.subdirs_count)) throw std::runtime_error("Write error") ;
 
-                for(uint32_t j=0;j<de.subdirs.size();++j)
-                    if(!FileListIO::writeField(tmp_section_data,tmp_section_size,dir_section_offset,FILE_LIST_IO_TAG_RAW_NUMBER,(uint32_t)de.subdirs[j])) throw std::runtime_error("Write error") ;
+                for(DirectoryStorage::EntryIndex e : subDirs(de))
+                    if(!FileListIO::writeField(tmp_section_data,tmp_section_size,dir_section_offset,FILE_LIST_IO_TAG_RAW_NUMBER,(uint32_t)e)) throw std::runtime_error("Write error") ;
 
-                if(!FileListIO::writeField(tmp_section_data,tmp_section_size,dir_section_offset,FILE_LIST_IO_TAG_RAW_NUMBER,(uint32_t)de.subfiles.size())) throw std::runtime_error("Write error") ;
+                if(!FileListIO::writeField(tmp_section_data,tmp_section_size,dir_section_offset,FILE_LIST_IO_TAG_RAW_NUMBER,(uint32_t)de.subfiles_count)) throw std::runtime_error("Write error") ;
 
-                for(uint32_t j=0;j<de.subfiles.size();++j)
-                    if(!FileListIO::writeField(tmp_section_data,tmp_section_size,dir_section_offset,FILE_LIST_IO_TAG_RAW_NUMBER,(uint32_t)de.subfiles[j])) throw std::runtime_error("Write error") ;
+                for(DirectoryStorage::EntryIndex e : subFiles(de))
+                    if(!FileListIO::writeField(tmp_section_data,tmp_section_size,dir_section_offset,FILE_LIST_IO_TAG_RAW_NUMBER,(uint32_t)e)) throw std::runtime_error("Write error") ;
 
                 if(!FileListIO::writeField(buffer,buffer_size,buffer_offset,FILE_LIST_IO_TAG_LOCAL_DIR_ENTRY,tmp_section_data,dir_section_offset)) throw std::runtime_error("Write error") ;
             }
@@ -1152,14 +1512,29 @@ bool InternalFileHierarchyStorage::load(const std::string& fname)
 
         // Write all file/dir entries
 
-        for(uint32_t i=0;i<mNodes.size();++i)
-            if(mNodes[i])
-                delete mNodes[i] ;
-
-        mNodes.clear();
-        mNodes.resize(n_nodes,NULL) ;
-
-        for(uint32_t i=0;i<mNodes.size() && buffer_offset < buffer_size;++i)	// only the 2nd condition really is needed. The first one ensures that the loop wont go forever.
+        mNodeTypes.assign(n_nodes,FileStorageNode::TYPE_UNKNOWN) ;
+        mNodeSlots.assign(n_nodes,0) ;
+
+        mFileParents.clear() ;
+        mFileRows.clear() ;
+        mFileNameOffsets.clear() ;
+        mFileNameSizes.clear() ;
+        mFileSizes.clear() ;
+        mFileModTimes.clear() ;
+        mFileHashList.clear() ;
+        mFreeFileSlots.clear() ;
+        mFileNameArena.clear() ;
+        mFileNameGarbage = 0 ;
+
+        mDirs.clear() ;
+        mFreeDirSlots.clear() ;
+        mChildren.clear() ;
+        mChildrenGarbage = 0 ;
+
+        mFileHashes.clear() ;
+        mDirHashes.clear() ;
+
+        for(uint32_t i=0;i<mNodeTypes.size() && buffer_offset < buffer_size;++i)	// only the 2nd condition really is needed. The first one ensures that the loop wont go forever.
         {
             unsigned char *node_section_data = NULL ;
             uint32_t node_section_size = 0 ;
@@ -1186,16 +1561,19 @@ bool InternalFileHierarchyStorage::load(const std::string& fname)
                 if(!FileListIO::readField(node_section_data,node_section_size,node_section_offset,FILE_LIST_IO_TAG_FILE_SHA1_HASH,file_hash   )) throw read_error(node_section_data,node_section_size,node_section_offset,FILE_LIST_IO_TAG_FILE_SHA1_HASH) ;
                 if(!FileListIO::readField(node_section_data,node_section_size,node_section_offset,FILE_LIST_IO_TAG_MODIF_TS      ,file_modtime)) throw read_error(node_section_data,node_section_size,node_section_offset,FILE_LIST_IO_TAG_MODIF_TS      ) ;
 
-                if(node_index >= mNodes.size())
-                    mNodes.resize(node_index+1,NULL) ;
+                if(node_index >= mNodeTypes.size())
+                {
+                    mNodeTypes.resize(node_index+1,FileStorageNode::TYPE_UNKNOWN) ;
+                    mNodeSlots.resize(node_index+1,0) ;
+                }
+                deleteNode(node_index) ;	// in case of duplicate entries
 
-                FileEntry *fe = new FileEntry(file_name,file_size,file_modtime,file_hash);
+                setFileNode(node_index,file_name,file_size,file_modtime,file_hash) ;
 
-                fe->parent_index = parent_index ;
-                fe->row = row ;
+                mFileParents[mNodeSlots[node_index]] = parent_index ;
+                mFileRows[mNodeSlots[node_index]] = row ;
 
-                mNodes[node_index] = fe ;
-                mFileHashes[fe->file_hash] = node_index ;
+                mFileHashes[file_hash] = node_index ;
 
                 mTotalFiles++ ;
                 mTotalSize += file_size ;
@@ -1222,19 +1600,15 @@ bool InternalFileHierarchyStorage::load(const std::string& fname)
                 if(!FileListIO::readField(node_section_data,node_section_size,node_section_offset,FILE_LIST_IO_TAG_UPDATE_TS      ,dir_update_time      )) throw read_error(node_section_data,node_section_size,node_section_offset,FILE_LIST_IO_TAG_UPDATE_TS      ) ;
                 if(!FileListIO::readField(node_section_data,node_section_size,node_section_offset,FILE_LIST_IO_TAG_RECURS_MODIF_TS,dir_most_recent_time )) throw read_error(node_section_data,node_section_size,node_section_offset,FILE_LIST_IO_TAG_RECURS_MODIF_TS) ;
 
-                if(node_index >= mNodes.size())
-                    mNodes.resize(node_index+1,NULL) ;
-
-                DirEntry *de = new DirEntry(dir_name) ;
-                de->dir_name         = dir_name ;
-                de->dir_parent_path  = dir_parent_path ;
-                de->dir_hash         = dir_hash ;
-                de->dir_modtime      = dir_modtime ;
-                de->dir_update_time  = dir_update_time ;
-                de->dir_most_recent_time = dir_most_recent_time ;
+                if(node_index >= mNodeTypes.size())
+                {
+                    mNodeTypes.resize(node_index+1,FileStorageNode::TYPE_UNKNOWN) ;
+                    mNodeSlots.resize(node_index+1,0) ;
+                }
+                deleteNode(node_index) ;	// in case of duplicate entries
 
-                de->parent_index = parent_index ;
-                de->row = row ;
+                std::vector<DirectoryStorage::EntryIndex> subdirs ;
+                std::vector<DirectoryStorage::EntryIndex> subfiles ;
 
                 uint32_t n_subdirs = 0 ;
                 uint32_t n_subfiles = 0 ;
@@ -1245,7 +1619,7 @@ bool InternalFileHierarchyStorage::load(const std::string& fname)
                 {
                     uint32_t di = 0 ;
                     if(!FileListIO::readField(node_section_data,node_section_size,node_section_offset,FILE_LIST_IO_TAG_RAW_NUMBER,di)) throw read_error(node_section_data,node_section_size,node_section_offset,FILE_LIST_IO_TAG_RAW_NUMBER) ;
-                    de->subdirs.push_back(di) ;
+                    subdirs.push_back(di) ;
                 }
 
                 if(!FileListIO::readField(node_section_data,node_section_size,node_section_offset,FILE_LIST_IO_TAG_RAW_NUMBER,n_subfiles)) throw read_error(node_section_data,node_section_size,node_section_offset,FILE_LIST_IO_TAG_RAW_NUMBER) ;
@@ -1254,10 +1628,24 @@ bool InternalFileHierarchyStorage::load(const std::string& fname)
                 {
                     uint32_t fi = 0 ;
                     if(!FileListIO::readField(node_section_data,node_section_size,node_section_offset,FILE_LIST_IO_TAG_RAW_NUMBER,fi)) throw read_error(node_section_data,node_section_size,node_section_offset,FILE_LIST_IO_TAG_RAW_NUMBER) ;
-                    de->subfiles.push_back(fi) ;
+                    subfiles.push_back(fi) ;
                 }
-                mNodes[node_index] = de ;
-                mDirHashes[de->dir_hash] = node_index ;
+                setDirNode(node_index,dir_name) ;
+
+                DirEntry& de(dirEntry(node_index)) ;
+
+                de.dir_parent_path  = dir_parent_path ;
+                de.dir_hash         = dir_hash ;
+                de.dir_modtime      = dir_modtime ;
+                de.dir_update_time  = dir_update_time ;
+                de.dir_most_recent_time = dir_most_recent_time ;
+
+                de.parent_index = parent_index ;
+                de.row = row ;
+
+                setChildren(de,subdirs,subfiles) ;
+
+                mDirHashes[dir_hash] = node_index ;
             }
             else
                 throw read_error(buffer,buffer_size,buffer_offset,FILE_LIST_IO_TAG_LOCAL_FILE_ENTRY) ;
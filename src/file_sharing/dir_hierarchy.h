@@ -26,7 +26,21 @@
 #include <stdlib.h>
 
 #include "directory_storage.h"
-
+#include "util/rssha1hashtable.h"
+#include "file_name_index.h"
+
+/**
+ * File hierarchy storage.
+ * Nodes are addressed by their EntryIndex in a table that only keeps the node
+ * type and the position of the node in the table of its type. File nodes,
+ * which are by far the most numerous, are stored as parallel arrays (name,
+ * size, modification time, hash, parent), with all file names packed in a
+ * single string arena. Directories are stored contiguously, and the children
+ * of all directories are packed in a single index array, each directory
+ * owning a range of it (subdirs first, then subfiles).
+ * This avoids one heap allocation per node, and keeps browsing and searching
+ * large friend lists mostly sequential in memory.
+ */
 class InternalFileHierarchyStorage
 {
 public:
@@ -36,37 +50,33 @@ public:
         static const uint32_t TYPE_UNKNOWN = 0x0000 ;
         static const uint32_t TYPE_FILE    = 0x0001 ;
         static const uint32_t TYPE_DIR     = 0x0002 ;
+    };
 
-        virtual ~FileStorageNode() {}
-        virtual uint32_t type() const =0;
+    // Value type used to pass file information in and out of the storage. Files are not stored as FileEntry objects.
 
-        DirectoryStorage::EntryIndex parent_index;
-        uint32_t row ;
-    };
-    class FileEntry: public FileStorageNode
+    class FileEntry
     {
     public:
-        FileEntry() : file_size(0), file_modtime(0) {}
-        FileEntry(const std::string& name,uint64_t size,rstime_t modtime) : file_name(name),file_size(size),file_modtime(modtime) {}
-        FileEntry(const std::string& name,uint64_t size,rstime_t modtime,const RsFileHash& hash) : file_name(name),file_size(size),file_modtime(modtime),file_hash(hash) {}
+        FileEntry() : parent_index(0), row(0), file_size(0), file_modtime(0) {}
+        FileEntry(const std::string& name,uint64_t size,rstime_t modtime) : parent_index(0),row(0),file_name(name),file_size(size),file_modtime(modtime) {}
+        FileEntry(const std::string& name,uint64_t size,rstime_t modtime,const RsFileHash& hash) : parent_index(0),row(0),file_name(name),file_size(size),file_modtime(modtime),file_hash(hash) {}
 
-        virtual uint32_t type() const { return FileStorageNode::TYPE_FILE ; }
-        virtual ~FileEntry() {}
+        DirectoryStorage::EntryIndex parent_index;
+        uint32_t row ;
 
-        // local stuff
         std::string file_name ;
         uint64_t    file_size ;
         rstime_t      file_modtime;
         RsFileHash  file_hash ;
     };
 
-    class DirEntry: public FileStorageNode
+    class DirEntry
     {
     public:
-        explicit DirEntry(const std::string& name) : dir_name(name), dir_cumulated_size(0), dir_modtime(0),dir_most_recent_time(0),dir_update_time(0) {}
-        virtual ~DirEntry() {}
+        explicit DirEntry(const std::string& name) : parent_index(0), row(0), dir_name(name), dir_cumulated_size(0), children_offset(0), children_capacity(0), subdirs_count(0), subfiles_count(0), dir_modtime(0),dir_most_recent_time(0),dir_update_time(0) {}
 
-        virtual uint32_t type() const { return FileStorageNode::TYPE_DIR ; }
+        DirectoryStorage::EntryIndex parent_index;
+        uint32_t row ;
 
         // local stuff
         std::string dir_name ;
@@ -74,14 +84,35 @@ public:
         RsFileHash  dir_hash ;
         uint64_t    dir_cumulated_size;
 
-        std::vector<DirectoryStorage::EntryIndex> subdirs ;
-        std::vector<DirectoryStorage::EntryIndex> subfiles ;
+        // range of mChildren owned by this directory. Use subDirs()/subFiles() to access it.
+        uint32_t children_offset ;
+        uint32_t children_capacity ;
+        uint32_t subdirs_count ;
+        uint32_t subfiles_count ;
 
         rstime_t dir_modtime;
         rstime_t dir_most_recent_time;// recursive most recent modification time, including files and subdirs in the entire hierarchy below.
         rstime_t dir_update_time;		// last time the information was updated for that directory. Includes subdirs indexes and subfile info.
     };
 
+    // Read-only view on the subdirs or subfiles of a directory. Invalidated by any modification of the hierarchy.
+
+    class IndexRange
+    {
+    public:
+        IndexRange(const DirectoryStorage::EntryIndex *b,uint32_t n) : mBegin(b),mSize(n) {}
+
+        uint32_t size() const { return mSize ; }
+        bool empty() const { return mSize == 0 ; }
+        DirectoryStorage::EntryIndex operator[](uint32_t i) const { return mBegin[i] ; }
+        const DirectoryStorage::EntryIndex *begin() const { return mBegin ; }
+        const DirectoryStorage::EntryIndex *end() const { return mBegin+mSize ; }
+
+    private:
+        const DirectoryStorage::EntryIndex *mBegin ;
+        uint32_t mSize ;
+    };
+
     // class stuff
     InternalFileHierarchyStorage() ;
 
@@ -119,32 +150,29 @@ public:
     bool getIndexFromDirHash(const RsFileHash& hash,DirectoryStorage::EntryIndex& index) ;
     bool getIndexFromFileHash(const RsFileHash& hash,DirectoryStorage::EntryIndex& index) ;
 
-    // file/dir access and modification
-    bool findSubDirectory(DirectoryStorage::EntryIndex e,const std::string& s) const ;	// returns true when s is the name of a sub-directory in the given entry e
-
     uint32_t mRoot ;
     std::list<uint32_t > mFreeNodes ;	// keeps a list of free nodes in order to make insert effcieint
-    std::vector<FileStorageNode*> mNodes;// uses pointers to keep information about valid/invalid objects.
-
-    void compress() ;					// use empty space in the vector, mostly due to deleted entries. This is a complicated operation, mostly due to
-                                            // all the indirections used. Nodes need to be moved, renamed, etc. The operation discards all file entries that
-                                            // are not referenced.
 
     friend class DirectoryStorage ;		// only class that can use this.
     friend class LocalDirectoryStorage ;		// only class that can use this.
 
     // Low level stuff. Should normally not be used externally.
 
-    const FileStorageNode *getNode(DirectoryStorage::EntryIndex indx) const;
-    const DirEntry *getDirEntry(DirectoryStorage::EntryIndex indx) const;
-    const FileEntry *getFileEntry(DirectoryStorage::EntryIndex indx) const;
+    const DirEntry *getDirEntry(DirectoryStorage::EntryIndex indx) const;	// pointer is invalidated by any modification of the hierarchy
+    bool getFileEntry(DirectoryStorage::EntryIndex indx,FileEntry& fe) const;
+    DirectoryStorage::EntryIndex getParentIndex(DirectoryStorage::EntryIndex indx) const;
     uint32_t getType(DirectoryStorage::EntryIndex indx) const;
-    DirectoryStorage::EntryIndex getSubFileIndex(DirectoryStorage::EntryIndex parent_index,uint32_t file_tab_index);
-    DirectoryStorage::EntryIndex getSubDirIndex(DirectoryStorage::EntryIndex parent_index,uint32_t dir_tab_index);
+    DirectoryStorage::EntryIndex getSubFileIndex(DirectoryStorage::EntryIndex parent_index,uint32_t file_tab_index) const;
+    DirectoryStorage::EntryIndex getSubDirIndex(DirectoryStorage::EntryIndex parent_index,uint32_t dir_tab_index) const;
+
+    IndexRange subDirs(const DirEntry& d) const { return IndexRange(mChildren.data()+d.children_offset,d.subdirs_count) ; }
+    IndexRange subFiles(const DirEntry& d) const { return IndexRange(mChildren.data()+d.children_offset+d.subdirs_count,d.subfiles_count) ; }
 
-    // search. SearchHash is logarithmic. The other two are linear.
+    // search. SearchHash is constant time. The other two look up name terms in the trigram index when they can, and
+    // are linear otherwise.
 
     bool searchHash(const RsFileHash& hash, DirectoryStorage::EntryIndex &result);
+    void getFileHashes(std::vector<RsFileHash>& hashes) const ;	// appends the hashes searchHash() can find
     int searchBoolExp(RsRegularExpression::Expression * exp, std::list<DirectoryStorage::EntryIndex> &results) const ;
     int searchTerms(const std::list<std::string>& terms, std::list<DirectoryStorage::EntryIndex> &results) const ;		// does a logical OR between items of the list of terms
 
@@ -156,16 +184,25 @@ public:
 
     void getStatistics(SharedDirStats& stats) const ;
 
+    // approximate memory used by the hierarchy, in bytes
+
+    size_t memoryUsage() const ;
+
 private:
     void recursPrint(int depth,DirectoryStorage::EntryIndex node) const;
     static bool nodeAccessError(const std::string& s);
     static RsFileHash createDirHash(const std::string& dir_name, const RsFileHash &dir_parent_hash, const RsFileHash &random_hash_salt) ;
 
-    // Allocates a new entry in mNodes, possible re-using an empty slot and returns its index.
+    // Allocates a new entry in the node table, possible re-using an empty slot and returns its index.
 
     DirectoryStorage::EntryIndex allocateNewIndex();
 
-    // Deletes an existing entry in mNodes, and keeps record of the indices that get freed.
+    // Binds the free node indx to a new file (resp. dir) slot.
+
+    void setFileNode(DirectoryStorage::EntryIndex indx,const std::string& name,uint64_t size,rstime_t modtime,const RsFileHash& hash);
+    void setDirNode(DirectoryStorage::EntryIndex indx,const std::string& name);
+
+    // Deletes an existing entry in the node table, and keeps record of the indices that get freed.
 
     void deleteNode(DirectoryStorage::EntryIndex);
     void deleteFileNode(DirectoryStorage::EntryIndex);
@@ -175,12 +212,65 @@ private:
 
     bool recursRemoveDirectory(DirectoryStorage::EntryIndex dir);
 
+    // Direct access to nodes whose type has already been checked.
+
+    DirEntry& dirEntry(DirectoryStorage::EntryIndex indx) { return mDirs[mNodeSlots[indx]] ; }
+    const DirEntry& dirEntry(DirectoryStorage::EntryIndex indx) const { return mDirs[mNodeSlots[indx]] ; }
+    std::string fileName(uint32_t slot) const { return std::string(mFileNameArena.data()+mFileNameOffsets[slot],mFileNameSizes[slot]) ; }
+    void setFileName(DirectoryStorage::EntryIndex indx,const std::string& name);
+
+    // File name search helpers. isHashedFile() tells whether indx is a file that the hash table points to, which
+    // is what the searches report. The other two expect a valid file node.
+
+    bool isHashedFile(DirectoryStorage::EntryIndex indx) const;
+    bool fileNameContainsAny(uint32_t slot,const std::list<std::string>& terms) const;
+    bool evalFile(RsRegularExpression::Expression *exp,DirectoryStorage::EntryIndex indx) const;
+    void rebuildNameIndex();
+
+    // Replaces the children of directory d, re-using its range of mChildren when it is large enough.
+
+    void setChildren(DirEntry& d,const std::vector<DirectoryStorage::EntryIndex>& subdirs,const std::vector<DirectoryStorage::EntryIndex>& subfiles);
+    void releaseChildren(DirEntry& d);
+    void compactChildren();
+    void compactFileNames();
+
+    // Node table. mNodeSlots gives the position of the node in the file columns or in mDirs, depending on its type.
+
+    std::vector<uint8_t>  mNodeTypes ;
+    std::vector<uint32_t> mNodeSlots ;
+
+    // File columns, indexed by file slot. Free slots have NO_INDEX as parent.
+
+    std::vector<DirectoryStorage::EntryIndex> mFileParents ;
+    std::vector<uint32_t>   mFileRows ;
+    std::vector<uint32_t>   mFileNameOffsets ;
+    std::vector<uint32_t>   mFileNameSizes ;
+    std::vector<uint64_t>   mFileSizes ;
+    std::vector<rstime_t>   mFileModTimes ;
+    std::vector<RsFileHash> mFileHashList ;
+    std::vector<uint32_t>   mFreeFileSlots ;
+
+    // All file names, packed. Renamed and deleted files leave garbage that is reclaimed by compactFileNames().
+
+    std::vector<char> mFileNameArena ;
+    size_t mFileNameGarbage ;
+
+    // Trigram index over the names in mFileNameArena, keyed by node index.
+
+    FileNameIndex mNameIndex ;
+
+    // Directories, and the packed children lists of all directories.
+
+    std::vector<DirEntry> mDirs ;
+    std::vector<uint32_t> mFreeDirSlots ;
+    std::vector<DirectoryStorage::EntryIndex> mChildren ;
+    size_t mChildrenGarbage ;
+
     // Map of the hash of all files. The file hashes are the sha1sum of the file data.
     // is used for fast search access for FT.
-    // Note: We should try something faster than std::map. hash_map??
     // Unlike directories, multiple files may have the same hash. So this cannot be used for anything else than FT.
 
-    std::map<RsFileHash,DirectoryStorage::EntryIndex> mFileHashes ;
+    RsSha1HashTable<DirectoryStorage::EntryIndex> mFileHashes ;
 
     // The directory hashes are the sha1sum of the
     // full public path to the directory.
@@ -189,7 +279,7 @@ private:
     // This is kept separate from mFileHashes because the two are used
     // in very different ways.
     //
-    std::map<RsFileHash,DirectoryStorage::EntryIndex> mDirHashes ;
+    RsSha1HashTable<DirectoryStorage::EntryIndex> mDirHashes ;
 
     // high level statistics on the full hierarchy. Should be kept up to date.
 
@@ -79,10 +79,18 @@ DirectoryStorage::EntryIndex DirectoryStorage::DirIterator::operator*() const
 DirectoryStorage::FileIterator::operator bool() const { return **this != DirectoryStorage::NO_INDEX; }
 DirectoryStorage::DirIterator ::operator bool() const { return **this != DirectoryStorage::NO_INDEX; }
 
-RsFileHash  DirectoryStorage::FileIterator::hash()     const { const InternalFileHierarchyStorage::FileEntry *f = mStorage->getFileEntry(**this) ; return f?(f->file_hash):RsFileHash(); }
-uint64_t    DirectoryStorage::FileIterator::size()     const { const InternalFileHierarchyStorage::FileEntry *f = mStorage->getFileEntry(**this) ; return f?(f->file_size):0; }
-std::string DirectoryStorage::FileIterator::name()     const { const InternalFileHierarchyStorage::FileEntry *f = mStorage->getFileEntry(**this) ; return f?(f->file_name):std::string(); }
-rstime_t      DirectoryStorage::FileIterator::modtime()  const { const InternalFileHierarchyStorage::FileEntry *f = mStorage->getFileEntry(**this) ; return f?(f->file_modtime):0; }
+// Each accessor reads its own column, rather than building a whole FileEntry.
+
+uint32_t DirectoryStorage::FileIterator::fileSlot() const
+{
+    EntryIndex indx = **this ;
+    return mStorage->checkIndex(indx,InternalFileHierarchyStorage::FileStorageNode::TYPE_FILE)?(mStorage->mNodeSlots[indx]):DirectoryStorage::NO_INDEX ;
+}
+
+RsFileHash  DirectoryStorage::FileIterator::hash()     const { uint32_t s = fileSlot() ; return (s != NO_INDEX)?(mStorage->mFileHashList[s]):RsFileHash(); }
+uint64_t    DirectoryStorage::FileIterator::size()     const { uint32_t s = fileSlot() ; return (s != NO_INDEX)?(mStorage->mFileSizes[s]):0; }
+std::string DirectoryStorage::FileIterator::name()     const { uint32_t s = fileSlot() ; return (s != NO_INDEX)?(mStorage->fileName(s)):std::string(); }
+rstime_t      DirectoryStorage::FileIterator::modtime()  const { uint32_t s = fileSlot() ; return (s != NO_INDEX)?(mStorage->mFileModTimes[s]):0; }
 
 std::string DirectoryStorage::DirIterator::name()      const { const InternalFileHierarchyStorage::DirEntry *d = mStorage->getDirEntry(**this) ; return d?(d->dir_name):std::string(); }
 
@@ -91,7 +99,7 @@ std::string DirectoryStorage::DirIterator::name()      const { const InternalFil
 /******************************************************************************************************************/
 
 DirectoryStorage::DirectoryStorage(const RsPeerId &pid,const std::string& fname)
-    : mPeerId(pid), mDirStorageMtx("Directory storage "+pid.toStdString()),mLastSavedTime(0),mChanged(false),mFileName(fname)
+    : mPeerId(pid), mDirStorageMtx("Directory storage "+pid.toStdString()),mLastSavedTime(0),mChanged(false),mHashesGeneration(0),mFileName(fname)
 {
 	{
 		RS_STACK_MUTEX(mDirStorageMtx) ;
@@ -152,6 +160,7 @@ bool DirectoryStorage::updateSubFilesList(
     RS_STACK_MUTEX(mDirStorageMtx) ;
     bool res = mFileHierarchy->updateSubFilesList(indx,subfiles,new_files) ;
     mChanged = true ;
+    ++mHashesGeneration ;
     return res ;
 }
 bool DirectoryStorage::removeDirectory(const EntryIndex& indx)
@@ -159,9 +168,15 @@ bool DirectoryStorage::removeDirectory(const EntryIndex& indx)
     RS_STACK_MUTEX(mDirStorageMtx) ;
     bool res = mFileHierarchy->removeDirectory(indx);
     mChanged = true ;
+    ++mHashesGeneration ;
 
     return res ;
 }
+uint32_t DirectoryStorage::hashesGeneration() const
+{
+    RS_STACK_MUTEX(mDirStorageMtx) ;
+    return mHashesGeneration ;
+}
 
 void DirectoryStorage::locked_check()
 {
@@ -180,6 +195,7 @@ bool DirectoryStorage::load(const std::string& local_file_name)
 {
     RS_STACK_MUTEX(mDirStorageMtx) ;
     mChanged = false ;
+    ++mHashesGeneration ;
     return mFileHierarchy->load(local_file_name);
 }
 void DirectoryStorage::save(const std::string& local_file_name)
@@ -258,17 +274,18 @@ bool DirectoryStorage::extractData(const EntryIndex& indx,DirDetails& d)
     }
     else if(type == InternalFileHierarchyStorage::FileStorageNode::TYPE_FILE)
     {
-        const InternalFileHierarchyStorage::FileEntry *file_entry = mFileHierarchy->getFileEntry(indx) ;
+        InternalFileHierarchyStorage::FileEntry file_entry ;
+        mFileHierarchy->getFileEntry(indx,file_entry) ;
 
         d.type    = DIR_TYPE_FILE;
-        d.size   = file_entry->file_size;
-        d.max_mtime = file_entry->file_modtime ;
-        d.name    = file_entry->file_name;
-        d.hash    = file_entry->file_hash;
-        d.mtime     = file_entry->file_modtime;
-        d.parent  = (void*)(intptr_t)file_entry->parent_index ;
+        d.size   = file_entry.file_size;
+        d.max_mtime = file_entry.file_modtime ;
+        d.name    = file_entry.file_name;
+        d.hash    = file_entry.file_hash;
+        d.mtime     = file_entry.file_modtime;
+        d.parent  = (void*)(intptr_t)file_entry.parent_index ;
 
-        const InternalFileHierarchyStorage::DirEntry *parent_dir_entry = mFileHierarchy->getDirEntry(file_entry->parent_index);
+        const InternalFileHierarchyStorage::DirEntry *parent_dir_entry = mFileHierarchy->getDirEntry(file_entry.parent_index);
 
         if(parent_dir_entry != NULL)
 			d.path = RsDirUtil::makePath(parent_dir_entry->dir_parent_path, parent_dir_entry->dir_name) ;
@@ -356,6 +373,16 @@ int LocalDirectoryStorage::searchHash(const RsFileHash& hash, RsFileHash& real_h
     return false ;
 }
 
+void LocalDirectoryStorage::getFileHashes(std::vector<RsFileHash>& hashes) const
+{
+    RS_STACK_MUTEX(mDirStorageMtx) ;
+
+    mFileHierarchy->getFileHashes(hashes) ;
+
+    for(std::map<RsFileHash,RsFileHash>::const_iterator it(mEncryptedHashes.begin());it!=mEncryptedHashes.end();++it)
+        hashes.push_back(it->first) ;
+}
+
 void LocalDirectoryStorage::setSharedDirectoryList(
         const std::list<SharedDirInfo>& lst )
 {
@@ -533,6 +560,7 @@ bool LocalDirectoryStorage::updateHash(
 
 		mEncryptedHashes[makeEncryptedHash(hash)] = hash ;
 		mChanged = true ;
+		++mHashesGeneration ;
 
 #ifdef DEBUG_LOCAL_DIRECTORY_STORAGE
 		std::cerr << "Updating index of hash " << hash << " update_internal="
@@ -639,11 +667,10 @@ bool LocalDirectoryStorage::locked_getFileSharingPermissions(
 	 * clearing outputs */
 	if(!indx) return true;
 
-	using FileStorageNode = InternalFileHierarchyStorage::FileStorageNode;
 	using EntryIndex = DirectoryStorage::EntryIndex;
 
-	rs_view_ptr<const FileStorageNode> n = mFileHierarchy->getNode(indx);
-	if(!n)
+	EntryIndex parentIndex = mFileHierarchy->getParentIndex(indx);
+	if(parentIndex == DirectoryStorage::NO_INDEX)
 	{
 		RS_ERR("Node for index: ", indx, "not found");
 		print_stacktrace();
@@ -652,26 +679,38 @@ bool LocalDirectoryStorage::locked_getFileSharingPermissions(
 
 	// Climb down node tree up to root + 1
 	EntryIndex curIndex = indx;
-	while (n->parent_index)
+	while (parentIndex)
 	{
-		curIndex = n->parent_index;
-		n = mFileHierarchy->getNode(curIndex);
+		curIndex = parentIndex;
+		parentIndex = mFileHierarchy->getParentIndex(curIndex);
+
+		if(parentIndex == DirectoryStorage::NO_INDEX)
+		{
+			RS_ERR("Node for index: ", curIndex, "not found");
+			print_stacktrace();
+			return false;
+		}
 	}
 
 	// Retrieve base name
 	std::string tBaseName;
-	switch (n->type())
+	uint32_t tType = mFileHierarchy->getType(curIndex);
+	switch (tType)
 	{
 	// Handle single file shared case
 	case InternalFileHierarchyStorage::FileStorageNode::TYPE_FILE:
-		tBaseName = mFileHierarchy->getFileEntry(curIndex)->file_name;
+	{
+		InternalFileHierarchyStorage::FileEntry tFileEntry;
+		mFileHierarchy->getFileEntry(curIndex, tFileEntry);
+		tBaseName = tFileEntry.file_name;
 		break;
+	}
 	// Handle shared directory case
 	case InternalFileHierarchyStorage::FileStorageNode::TYPE_DIR:
 		tBaseName = mFileHierarchy->getDirEntry(curIndex)->dir_name;
 		break;
 	default:
-		RS_ERR("Got unhandled node type: ", n->type());
+		RS_ERR("Got unhandled node type: ", tType);
 		print_stacktrace();
 		return false;
 	}
@@ -765,6 +804,11 @@ bool LocalDirectoryStorage::serialiseDirEntry(
 		return false;
 	}
 
+	const InternalFileHierarchyStorage::IndexRange subdirs =
+	        mFileHierarchy->subDirs(*dir);
+	const InternalFileHierarchyStorage::IndexRange subfiles =
+	        mFileHierarchy->subFiles(*dir);
+
 	// compute list of allowed subdirs
 	std::vector<RsFileHash> allowed_subdirs;
 	FileStorageFlags node_flags;
@@ -774,31 +818,31 @@ bool LocalDirectoryStorage::serialiseDirEntry(
 	 * compute the mask that result from these flags for the particular peer
 	 * supplied in parameter */
 
-	for(uint32_t i=0;i<dir->subdirs.size();++i)
+	for(uint32_t i=0;i<subdirs.size();++i)
 		if(indx != 0 || (
 		            locked_getFileSharingPermissions(
-		                dir->subdirs[i], node_flags, node_groups ) &&
+		                subdirs[i], node_flags, node_groups ) &&
 		            ( rsPeers->computePeerPermissionFlags(
 		                  client_id, node_flags, node_groups ) &
 		              RS_FILE_HINTS_BROWSABLE ) ))
 		{
 			RsFileHash hash;
-			if(!mFileHierarchy->getDirHashFromIndex(dir->subdirs[i],hash))
+			if(!mFileHierarchy->getDirHashFromIndex(subdirs[i],hash))
 			{
 				RS_ERR( "Cannot get hash from subdir index: ",
-				        dir->subdirs[i], ". Weird bug." );
+				        subdirs[i], ". Weird bug." );
 				print_stacktrace();
 				return false;
 			}
 			allowed_subdirs.push_back(hash);
 
 #ifdef DEBUG_LOCAL_DIRECTORY_STORAGE
-            std::cerr << "  pushing subdir " << hash << ", array position=" << i << " indx=" << dir->subdirs[i] << std::endl;
+            std::cerr << "  pushing subdir " << hash << ", array position=" << i << " indx=" << subdirs[i] << std::endl;
 #endif
 		}
 #ifdef DEBUG_LOCAL_DIRECTORY_STORAGE
         else
-            std::cerr << "  not pushing subdir " << hash << ", array position=" << i << " indx=" << dir->subdirs[i] << ": permission denied for this peer." << std::endl;
+            std::cerr << "  not pushing subdir " << hash << ", array position=" << i << " indx=" << subdirs[i] << ": permission denied for this peer." << std::endl;
 #endif
 
 	/* now count the files that do not have a null hash (meaning the hash has
@@ -806,14 +850,14 @@ bool LocalDirectoryStorage::serialiseDirEntry(
 	 * a shared directory) so they are child of root check browsability
 	 * permission */
 	uint32_t allowed_subfiles = 0;
-	for(uint32_t i=0; i<dir->subfiles.size(); ++i)
+	for(uint32_t i=0; i<subfiles.size(); ++i)
 	{
-		const InternalFileHierarchyStorage::FileEntry* file =
-		        mFileHierarchy->getFileEntry(dir->subfiles[i]);
-		if(file != nullptr && !file->file_hash.isNull()
+		InternalFileHierarchyStorage::FileEntry file;
+		if( mFileHierarchy->getFileEntry(subfiles[i], file)
+		        && !file.file_hash.isNull()
 		        && ( indx !=0 || (
 		                 locked_getFileSharingPermissions(
-		                     dir->subfiles[i], node_flags, node_groups ) &&
+		                     subfiles[i], node_flags, node_groups ) &&
 		                 rsPeers->computePeerPermissionFlags(
 		                     client_id, node_flags, node_groups ) &
 		                 RS_FILE_HINTS_BROWSABLE ) ))
@@ -880,27 +924,27 @@ bool LocalDirectoryStorage::serialiseDirEntry(
 
 	uint32_t file_section_size = FL_BASE_TMP_SECTION_SIZE;
 
-	for(uint32_t i=0; i<dir->subfiles.size(); ++i)
+	for(uint32_t i=0; i<subfiles.size(); ++i)
 	{
 		uint32_t file_section_offset = 0;
 
-		const InternalFileHierarchyStorage::FileEntry* file =
-		        mFileHierarchy->getFileEntry(dir->subfiles[i]);
+		InternalFileHierarchyStorage::FileEntry file;
 
-		if(file == nullptr || file->file_hash.isNull())
+		if( !mFileHierarchy->getFileEntry(subfiles[i], file)
+		        || file.file_hash.isNull() )
 		{
 			RS_INFO( "skipping unhashed or Null file entry ",
-			         dir->subfiles[i], " to get/send file info." );
+			         subfiles[i], " to get/send file info." );
 			continue;
 		}
 
 		if(indx == 0)
 		{
 			if(!locked_getFileSharingPermissions(
-			            dir->subfiles[i], node_flags, node_groups ))
+			            subfiles[i], node_flags, node_groups ))
 			{
 				RS_ERR( "Failure getting sharing permission for single file: ",
-				        dir->subfiles[i] );
+				        subfiles[i] );
 				print_stacktrace();
 				continue;
 			}
@@ -917,19 +961,19 @@ bool LocalDirectoryStorage::serialiseDirEntry(
 
 		if(!FileListIO::writeField(
 		            file_section_data, file_section_size, file_section_offset,
-		            FILE_LIST_IO_TAG_FILE_NAME, file->file_name ))
+		            FILE_LIST_IO_TAG_FILE_NAME, file.file_name ))
 		{ free(section_data); free(file_section_data); return false; }
 		if(!FileListIO::writeField(
 		            file_section_data, file_section_size, file_section_offset,
-		            FILE_LIST_IO_TAG_FILE_SIZE, file->file_size ))
+		            FILE_LIST_IO_TAG_FILE_SIZE, file.file_size ))
 		{ free(section_data); free(file_section_data); return false; }
 		if(!FileListIO::writeField(
 		            file_section_data, file_section_size, file_section_offset,
-		            FILE_LIST_IO_TAG_FILE_SHA1_HASH, file->file_hash ))
+		            FILE_LIST_IO_TAG_FILE_SHA1_HASH, file.file_hash ))
 		{ free(section_data); free(file_section_data); return false; }
 		if(!FileListIO::writeField(
 		            file_section_data, file_section_size, file_section_offset,
-		            FILE_LIST_IO_TAG_MODIF_TS, (uint32_t)file->file_modtime ))
+		            FILE_LIST_IO_TAG_MODIF_TS, (uint32_t)file.file_modtime ))
 		{ free(section_data); free(file_section_data); return false; }
 
 		// now write the whole string into a single section in the file
@@ -940,7 +984,7 @@ bool LocalDirectoryStorage::serialiseDirEntry(
 		{ free(section_data); free(file_section_data); return false; }
 
 #ifdef DEBUG_LOCAL_DIRECTORY_STORAGE
-        std::cerr << "  pushing subfile " << file->hash << ", array position=" << i << " indx=" << dir->subfiles[i] << std::endl;
+        std::cerr << "  pushing subfile " << file.file_hash << ", array position=" << i << " indx=" << subfiles[i] << std::endl;
 #endif
 	}
 	free(file_section_data);
@@ -110,6 +110,8 @@ class DirectoryStorage
                 rstime_t modtime() const ;
 
             private:
+                uint32_t fileSlot() const ;		// slot of the current file in the file columns of the hierarchy, or NO_INDEX.
+
                 EntryIndex mParentIndex ;		// index of the parent dir.
                 uint32_t   mFileTabIndex ;		// index in the vector of subdirs.
                 InternalFileHierarchyStorage *mStorage ;
@@ -133,6 +135,11 @@ class DirectoryStorage
         bool updateSubFilesList(const EntryIndex& indx, const std::map<std::string, FileTS> &subfiles, std::map<std::string, FileTS> &new_files) ;
         bool removeDirectory(const EntryIndex& indx) ;
 
+        // Incremented each time files, and therefore hashes, may have been added or removed. Used to know when lists of hashes built from
+        // this storage are outdated.
+
+        uint32_t hashesGeneration() const ;
+
         // Returns the hash of the directory at the given index and reverse. This hash is set as random the first time it is used (when updating directories). It will be
         // used by the sync system to designate the directory without referring to index (index could be used to figure out the existance of hidden directories)
 
@@ -174,6 +181,7 @@ class DirectoryStorage
 
 		rstime_t mLastSavedTime ;
 		bool mChanged ;
+		uint32_t mHashesGeneration ;
 		std::string mFileName;
 };
 
@@ -247,6 +255,12 @@ public:
      */
     virtual int searchHash(const RsFileHash& hash, RsFileHash &real_hash, EntryIndex &results) const ;
 
+    /*!
+     * \brief getFileHashes
+     * 				Appends all the hashes searchHash() can find: the hashes of shared files, and the hashes of these hashes.
+     */
+    void getFileHashes(std::vector<RsFileHash>& hashes) const ;
+
     /*!
      * \brief updateTimeStamps
      * 			Checks recursive TS and update the if needed.
@@ -0,0 +1,135 @@
+/*******************************************************************************
+ * libretroshare/src/file_sharing: file_name_index.cc                          *
+ *                                                                             *
+ * libretroshare: retroshare core library                                      *
+ *                                                                             *
+ * Copyright (C) 2026  RetroShare Team <contact@retroshare.cc>                 *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Lesser General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ ******************************************************************************/
+#include <algorithm>
+#include <ctype.h>
+
+#include "file_name_index.h"
+
+// Removed entries are only cleaned up once there are more of them than live entries, and at least this many.
+
+static const uint64_t NAME_INDEX_MIN_STALE_ENTRIES = 64*1024 ;
+
+FileNameIndex::FileNameIndex() : mLiveEntries(0), mStaleEntries(0) {}
+
+void FileNameIndex::trigrams(const char *s,uint32_t size,std::vector<uint32_t>& res)
+{
+	res.clear() ;
+
+	if(size < TRIGRAM_SIZE)
+		return ;
+
+	res.reserve(size - TRIGRAM_SIZE + 1) ;
+
+	// Same case folding as RsRegularExpression::CompareCharIC, so that the index agrees with the search functions.
+
+	uint32_t t = (tolower((unsigned char)s[0]) << 8) | tolower((unsigned char)s[1]) ;
+
+	for(uint32_t i=TRIGRAM_SIZE-1;i<size;++i)
+	{
+		t = ((t << 8) | tolower((unsigned char)s[i])) & 0xffffff ;
+		res.push_back(t) ;
+	}
+
+	std::sort(res.begin(),res.end()) ;
+	res.erase(std::unique(res.begin(),res.end()),res.end()) ;
+}
+
+void FileNameIndex::insert(EntryIndex e,const char *name,uint32_t size)
+{
+	std::vector<uint32_t> tg ;
+	trigrams(name,size,tg) ;
+
+	for(uint32_t i=0;i<tg.size();++i)
+		mPostings[tg[i]].push_back(e) ;
+
+	mLiveEntries += tg.size() ;
+}
+
+void FileNameIndex::remove(const char *name,uint32_t size)
+{
+	std::vector<uint32_t> tg ;
+	trigrams(name,size,tg) ;
+
+	mLiveEntries -= std::min(mLiveEntries,(uint64_t)tg.size()) ;
+	mStaleEntries += tg.size() ;
+}
+
+void FileNameIndex::clear()
+{
+	mPostings.clear() ;
+	mLiveEntries = 0 ;
+	mStaleEntries = 0 ;
+}
+
+bool FileNameIndex::needsRebuild() const
+{
+	return mStaleEntries > NAME_INDEX_MIN_STALE_ENTRIES && mStaleEntries > mLiveEntries ;
+}
+
+bool FileNameIndex::getCandidates(const std::list<std::string>& terms,std::vector<EntryIndex>& candidates) const
+{
+	candidates.clear() ;
+	std::vector<uint32_t> tg ;
+
+	for(std::list<std::string>::const_iterator it(terms.begin());it!=terms.end();++it)
+	{
+		trigrams(it->data(),it->size(),tg) ;
+
+		if(tg.empty())
+			return false ;
+
+		// Any name that contains the term contains all its trigrams, so the shortest posting list is enough.
+
+		const std::vector<EntryIndex> *best = NULL ;
+
+		for(uint32_t i=0;i<tg.size();++i)
+		{
+			std::unordered_map<uint32_t,std::vector<EntryIndex> >::const_iterator pit = mPostings.find(tg[i]) ;
+
+			if(pit == mPostings.end())
+			{
+				best = NULL ;
+				break ;
+			}
+			if(best == NULL || pit->second.size() < best->size())
+				best = &pit->second ;
+		}
+
+		if(best != NULL)
+			candidates.insert(candidates.end(),best->begin(),best->end()) ;
+	}
+
+	std::sort(candidates.begin(),candidates.end()) ;
+	candidates.erase(std::unique(candidates.begin(),candidates.end()),candidates.end()) ;
+
+	return true ;
+}
+
+size_t FileNameIndex::memoryUsage() const
+{
+	size_t res = mPostings.bucket_count() * sizeof(void*) ;
+
+	for(std::unordered_map<uint32_t,std::vector<EntryIndex> >::const_iterator it(mPostings.begin());it!=mPostings.end();++it)
+		res += sizeof(*it) + sizeof(void*) + it->second.capacity() * sizeof(EntryIndex) ;
+
+	return res ;
+}
@@ -0,0 +1,82 @@
+/*******************************************************************************
+ * libretroshare/src/file_sharing: file_name_index.h                           *
+ *                                                                             *
+ * libretroshare: retroshare core library                                      *
+ *                                                                             *
+ * Copyright (C) 2026  RetroShare Team <contact@retroshare.cc>                 *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Lesser General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ ******************************************************************************/
+#pragma once
+
+#include <list>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <stdint.h>
+
+/*!
+ * \brief The FileNameIndex class
+ * 		Trigram index over file names, used to answer name searches without going through every file. Each group of
+ * 		three consecutive characters of a name, lower cased, maps to the list of entries whose name contains it.
+ *
+ * 		Removed names are not taken out of the posting lists. They are only counted, and the owner is expected to
+ * 		rebuild the index from scratch when needsRebuild() says so. As a consequence, candidates returned by the
+ * 		index are a superset of the actual matches and must be checked against the real names.
+ *
+ * 		This class is not thread safe. It lives in InternalFileHierarchyStorage, which is protected by the
+ * 		mutex of its DirectoryStorage.
+ */
+class FileNameIndex
+{
+public:
+	typedef uint32_t EntryIndex ;
+
+	FileNameIndex() ;
+
+	// Adds (resp. forgets) the name of entry e. The name does not need to be null terminated.
+
+	void insert(EntryIndex e,const char *name,uint32_t size) ;
+	void remove(const char *name,uint32_t size) ;
+
+	void clear() ;
+
+	// true when the posting lists contain more removed entries than live ones.
+
+	bool needsRebuild() const ;
+
+	/*!
+	 * \brief getCandidates
+	 * 		Collects the entries whose name may contain at least one of the terms, case ignored.
+	 * \param candidates  sorted list of entries, without duplicates.
+	 * \return false if some term is too short to be looked up in the index. The caller must then go through all
+	 * 		entries.
+	 */
+	bool getCandidates(const std::list<std::string>& terms,std::vector<EntryIndex>& candidates) const ;
+
+	size_t memoryUsage() const ;
+
+	static const uint32_t TRIGRAM_SIZE = 3 ;
+
+private:
+	// Sorted list of the distinct trigrams of a string.
+
+	static void trigrams(const char *s,uint32_t size,std::vector<uint32_t>& res) ;
+
+	std::unordered_map<uint32_t,std::vector<EntryIndex> > mPostings ;
+
+	uint64_t mLiveEntries ;
+	uint64_t mStaleEntries ;
+};
@@ -41,6 +41,8 @@ static const std::string IGNORED_PREFIXES_SS                    = "IGNORED_PREFI
 static const std::string IGNORED_SUFFIXES_SS                    = "IGNORED_SUFFIXES"; 	 	             // ignore file suffixes
 static const std::string IGNORE_LIST_FLAGS_SS                   = "IGNORED_FLAGS"; 	 	 	             // ignore file flags
 static const std::string MAX_SHARE_DEPTH                        = "MAX_SHARE_DEPTH"; 	 	             // maximum depth of shared directories
+static const std::string HASHING_THREADS_SS                     = "HASHING_THREADS"; 	 	             // number of files hashed in parallel
+static const std::string MAX_HASHING_SPEED_SS                   = "MAX_HASHING_SPEED"; 	 	             // hashing speed limit in MB/s
 
 static const std::string FILE_SHARING_DIR_NAME       = "file_sharing" ;			 // hard-coded directory name to store friend file lists, hash cache, etc.
 static const std::string HASH_CACHE_FILE_NAME        = "hash_cache.bin" ;		 // hard-coded directory name to store encrypted hash cache.
@@ -52,6 +54,9 @@ static const uint32_t MIN_TIME_AFTER_LAST_MODIFICATION             = 10 ;    //
 
 static const uint32_t MAX_DIR_SYNC_RESPONSE_DATA_SIZE              = 20000 ; // Maximum RsItem data size in bytes for serialised directory transmission
 static const uint32_t DEFAULT_HASH_STORAGE_DURATION_DAYS           = 30 ;    // remember deleted/inaccessible files for 30 days
+static const uint32_t DEFAULT_HASHING_THREADS                      = 2 ;     // number of files hashed in parallel
+static const uint32_t MAX_HASHING_THREADS                          = 16 ;    // upper bound for the number of hashing threads
+static const uint32_t HASHING_READ_BUFFER_SIZE                     = 8*1024*1024 ; // size of each read while hashing. One buffer per hashing thread.
 
 static const uint32_t NB_FRIEND_INDEX_BITS_32BITS                    = 10 ;			// Do not change this!
 static const uint32_t NB_ENTRY_INDEX_BITS_32BITS                     = 22 ;			// Do not change this!
@@ -70,6 +70,9 @@ bool FileListIO::readField (const unsigned char *buff,uint32_t  buff_size,uint32
     if(!readSectionHeader(buff,buff_size,offset,check_section_tag,local_size))
         return false;
 
+    if(local_size > buff_size - offset)		// truncated section
+        return false;
+
     if(!checkSectionSize(val,size,0,local_size))	// allocate val if needed to handle local_size bytes.
         return false;
 
@@ -19,7 +19,13 @@
  * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
  *                                                                             *
  ******************************************************************************/
+#include <openssl/sha.h>
+#ifdef WINDOWS_SYS
+#include <malloc.h>
+#endif
+
 #include "util/rsdir.h"
+#include "util/rsmemory.h"
 #include "util/rsprint.h"
 #include "util/rstime.h"
 #include "rsserver/p3face.h"
@@ -33,9 +39,40 @@
 
 static const uint32_t DEFAULT_INACTIVITY_SLEEP_TIME = 50*1000;
 static const uint32_t     MAX_INACTIVITY_SLEEP_TIME = 2*1000*1000;
+static const uint32_t     MIN_TIME_STAMP_UPDATE_DELAY = 24*3600;	// avoids re-writing all the cache entries at each directory sweep
+static const uint32_t    HASHING_THREADS_CHECK_TIME = 200*1000;	// how often the main thread checks hashing threads while files are being hashed
+static const uint32_t           PAUSED_SLEEP_TIME = 500*1000;
+static const uint32_t         HASH_BUFFER_ALIGNMENT = 4096;
+
+/*!
+ * \brief The HashStorage::HashingThread class
+ * 		Hashes files from the HashStorage queue until the queue is empty, hashing is paused, or the thread is not needed anymore.
+ */
+class HashStorage::HashingThread: public RsThread
+{
+public:
+	HashingThread(HashStorage& storage,uint32_t index) : mStorage(storage),mIndex(index) {}
+
+protected:
+	void run() override { mStorage.hashingThreadLoop(mIndex,this) ; }
+
+private:
+	HashStorage& mStorage ;
+	uint32_t mIndex ;
+};
+
+static std::string hash_cache_index_base_name(const std::string& save_file_name)
+{
+    std::string::size_type pos = save_file_name.rfind(".bin") ;
+
+    if(pos != std::string::npos && pos + 4 == save_file_name.length())
+        return save_file_name.substr(0,pos) ;
+
+    return save_file_name ;
+}
 
 HashStorage::HashStorage(const std::string& save_file_name)
-    : mFilePath(save_file_name), mHashMtx("Hash Storage mutex")
+    : mFilePath(save_file_name), mIndex(hash_cache_index_base_name(save_file_name)), mHashMtx("Hash Storage mutex")
 {
     mInactivitySleepTime = DEFAULT_INACTIVITY_SLEEP_TIME;
     mRunning = false ;
@@ -47,15 +84,54 @@ HashStorage::HashStorage(const std::string& save_file_name)
 	mHashingProcessPaused = false;
 	mHashedBytes = 0 ;
 	mHashingTime = 0 ;
+	mJobsInProgress = 0 ;
+	mMaxHashingThreads = DEFAULT_HASHING_THREADS ;
+	mMaxHashingSpeed = 0 ;
+	mThrottleBudget = 0 ;
+	mThrottleLastTime = 0 ;
+	mHashCounter = 0 ;
+	mTotalHashedSize = 0 ;
+
+	for(uint32_t i=0;i<MAX_HASHING_THREADS;++i)
+		mHashingThreads.push_back(new HashingThread(*this,i)) ;
 
     {
         RS_STACK_MUTEX(mHashMtx) ;
 
-        if(!locked_load())
-            try_load_import_old_hash_cache();
+        if(!mIndex.load())
+        {
+            // No hash cache index yet. Import the former hash cache, if any, so that files are not re-hashed.
+
+            std::map<std::string, HashStorageInfo> files ;
+
+            if(locked_load_old_hash_cache(files) || try_load_import_old_hash_cache(files))
+                locked_import(files) ;
+        }
+        mChanged = false ;
     }
 }
 
+HashStorage::~HashStorage()
+{
+	fullstop() ;
+	stopHashingThreads() ;
+
+	for(uint32_t i=0;i<mHashingThreads.size();++i)
+		delete mHashingThreads[i] ;
+}
+
+void HashStorage::clear()
+{
+	RS_STACK_MUTEX(mHashMtx) ;
+	mIndex.clear() ;
+}
+
+bool HashStorage::empty()
+{
+	RS_STACK_MUTEX(mHashMtx) ;
+	return mIndex.empty() ;
+}
+
 void HashStorage::togglePauseHashingProcess()
 {
 	RS_STACK_MUTEX(mHashMtx) ;
@@ -67,6 +143,53 @@ bool HashStorage::hashingProcessPaused()
 	return mHashingProcessPaused;
 }
 
+void HashStorage::setHashingThreads(uint32_t n)
+{
+	RS_STACK_MUTEX(mHashMtx) ;
+	mMaxHashingThreads = std::max(1u,std::min(n,MAX_HASHING_THREADS)) ;	// threads above this number stop after their current file
+}
+uint32_t HashStorage::hashingThreads()
+{
+	RS_STACK_MUTEX(mHashMtx) ;
+	return mMaxHashingThreads ;
+}
+void HashStorage::setMaxHashingSpeed(uint32_t mb_per_sec)
+{
+	RS_STACK_MUTEX(mHashMtx) ;
+	mMaxHashingSpeed = mb_per_sec ;
+	mThrottleBudget = 0 ;
+}
+uint32_t HashStorage::maxHashingSpeed()
+{
+	RS_STACK_MUTEX(mHashMtx) ;
+	return mMaxHashingSpeed ;
+}
+
+void HashStorage::onStopRequested()
+{
+	// Only ask: the hashing threads check this between two reads. Must not lock mHashMtx since stopHashThread() holds it.
+
+	for(uint32_t i=0;i<mHashingThreads.size();++i)
+		if(mHashingThreads[i]->isRunning())
+			mHashingThreads[i]->askForStop() ;
+}
+
+void HashStorage::stopHashingThreads()
+{
+	for(uint32_t i=0;i<mHashingThreads.size();++i)
+		if(mHashingThreads[i]->isRunning())
+			mHashingThreads[i]->fullstop() ;
+
+	RS_STACK_MUTEX(mHashMtx) ;
+
+	if(mChanged)
+	{
+		locked_save();
+		mLastSaveTime = time(NULL) ;
+		mChanged = false ;
+	}
+}
+
 static std::string friendlyUnit(uint64_t val)
 {
     const std::string units[6] = {"B","KB","MB","GB","TB","PB"};
@@ -89,162 +212,332 @@ static std::string friendlyUnit(uint64_t val)
 
 void HashStorage::threadTick()
 {
-    FileHashJob job;
-    RsFileHash hash;
-    uint64_t size = 0;
+    // This thread only saves the cache and drives the hashing threads. Files are hashed in HashingThread.
 
+    bool empty ;
+    uint32_t st ;
 
     {
-        bool empty ;
-        uint32_t st ;
+        RS_STACK_MUTEX(mHashMtx) ;
 
+        if(mChanged && mLastSaveTime + MIN_INTERVAL_BETWEEN_HASH_CACHE_SAVE < time(NULL))
+        {
+            locked_save();
+            mLastSaveTime = time(NULL) ;
+            mChanged = false ;
+        }
+    }
+
+    {
+        RS_STACK_MUTEX(mHashMtx) ;
+
+        empty = mFilesToHash.empty() && mJobsInProgress == 0;
+        st = mInactivitySleepTime ;
+    }
+
+    // sleep off mutex!
+    if(empty)
+    {
+#ifdef HASHSTORAGE_DEBUG
+        std::cerr << "nothing to hash. Sleeping for " << st << " us" << std::endl;
+#endif
+
+        rstime::rs_usleep(st);	// when no files to hash, just wait for 2 secs. This avoids a dramatic loop.
+
+        if(st > MAX_INACTIVITY_SLEEP_TIME)
         {
             RS_STACK_MUTEX(mHashMtx) ;
 
-            if(mChanged && mLastSaveTime + MIN_INTERVAL_BETWEEN_HASH_CACHE_SAVE < time(NULL))
+            mInactivitySleepTime = MAX_INACTIVITY_SLEEP_TIME;
+            mCurrentHashingSpeed = 0 ;
+
+            if(!mChanged)	// otherwise it might prevent from saving the hash cache
             {
-                locked_save();
-                mLastSaveTime = time(NULL) ;
-                mChanged = false ;
+                stopHashThread();
             }
+
+            if(rsEvents)
+            {
+                auto ev = std::make_shared<RsSharedDirectoriesEvent>();
+                ev->mEventCode = RsSharedDirectoriesEventCode::DIRECTORY_SWEEP_ENDED;
+                rsEvents->postEvent(ev);
+            }
+            //RsServer::notify()->notifyHashingInfo(NOTIFY_HASHTYPE_FINISH, "") ;
+        }
+        else
+        {
+            RS_STACK_MUTEX(mHashMtx) ;
+            mInactivitySleepTime = 2*st ;
+        }
+
+        return ;
+    }
+
+    {
+        RS_STACK_MUTEX(mHashMtx) ;
+
+        mInactivitySleepTime = DEFAULT_INACTIVITY_SLEEP_TIME;
+
+        // (re)start the hashing threads that are needed. Threads stop by themselves when there is nothing left to hash,
+        // when hashing is paused, or when their index is above the max number of threads.
+
+        if(!mHashingProcessPaused)
+        {
+            uint32_t needed = std::min((uint64_t)mMaxHashingThreads,(uint64_t)(mFilesToHash.size() + mJobsInProgress)) ;
+
+            for(uint32_t i=0;i<needed;++i)
+                if(!mHashingThreads[i]->isRunning())
+                {
+                    std::string name = "fs hash " ;
+                    rs_sprintf_append(name,"%u",i) ;
+
+                    mHashingThreads[i]->start(name) ;
+                }
         }
 
+        // Update the global hashing speed, from the bytes read by all hashing threads.
+
+        double now = rstime::RsScopeTimer::currentTime() ;
+
+        if(mHashingTime == 0)
+            mHashingTime = now ;
+        else if(now > mHashingTime + 3)
+        {
+            mCurrentHashingSpeed = (uint32_t)(mHashedBytes / (now - mHashingTime) / (1024*1024)) ;
+            mHashingTime = now ;
+            mHashedBytes = 0 ;
+        }
+    }
+
+    rstime::rs_usleep(HASHING_THREADS_CHECK_TIME) ;
+}
+
+void HashStorage::hashingThreadLoop(uint32_t thread_index,RsThread *thread)
+{
+    // One aligned buffer per thread, reused for all files. This bounds the memory used for reading to
+    // HASHING_READ_BUFFER_SIZE times the number of threads.
+
+    void *buffer = NULL ;
+
+#ifdef WINDOWS_SYS
+    buffer = _aligned_malloc(HASHING_READ_BUFFER_SIZE,HASH_BUFFER_ALIGNMENT) ;
+#else
+    if(posix_memalign(&buffer,HASH_BUFFER_ALIGNMENT,HASHING_READ_BUFFER_SIZE) != 0)
+        buffer = NULL ;
+#endif
+    if(!buffer)
+    {
+        RS_ERR("Cannot allocate hashing buffer of size ", HASHING_READ_BUFFER_SIZE);
+        return ;
+    }
+
+    while(!thread->shouldStop())
+    {
+        FileHashJob job ;
+        std::string tmpout;
+
         {
             RS_STACK_MUTEX(mHashMtx) ;
 
-            empty = mFilesToHash.empty();
-            st = mInactivitySleepTime ;
+            if(mFilesToHash.empty() || mHashingProcessPaused || thread_index >= mMaxHashingThreads)
+                break ;
+
+            job = mFilesToHash.begin()->second ;
+            mFilesToHash.erase(mFilesToHash.begin()) ;
+            ++mJobsInProgress ;
+
+            if(mCurrentHashingSpeed > 0)
+                rs_sprintf(tmpout, "%lu/%lu (%s - %d%%, %d MB/s) : %s", (unsigned long int)mHashCounter+1, (unsigned long int)mTotalFilesToHash, friendlyUnit(mTotalHashedSize).c_str(), int(mTotalHashedSize/double(mTotalSizeToHash)*100.0), mCurrentHashingSpeed,job.full_path.c_str()) ;
+            else
+                rs_sprintf(tmpout, "%lu/%lu (%s - %d%%) : %s", (unsigned long int)mHashCounter+1, (unsigned long int)mTotalFilesToHash, friendlyUnit(mTotalHashedSize).c_str(), int(mTotalHashedSize/double(mTotalSizeToHash)*100.0), job.full_path.c_str()) ;
         }
 
-        // sleep off mutex!
-        if(empty)
+        RsFileHash hash;
+        uint64_t size = 0;
+        bool confirmed = job.client->hash_confirm(job.client_param) ;
+
+        if(confirmed)
         {
 #ifdef HASHSTORAGE_DEBUG
-            std::cerr << "nothing to hash. Sleeping for " << st << " us" << std::endl;
+            std::cerr << "Hashing file " << job.full_path << "..." ; std::cerr.flush();
 #endif
+            if(rsEvents)
+            {
+                /* Emit deprecated event only for retrocompatibility
+                 * TODO: create a proper event with structured data instead of a
+                 * formatted string */
+                auto ev = std::make_shared<RsSharedDirectoriesEvent>();
+                ev->mEventCode = RsSharedDirectoriesEventCode::HASHING_FILE;
+                ev->mMessage = tmpout;
+                rsEvents->postEvent(ev);
+            }
 
-            rstime::rs_usleep(st);	// when no files to hash, just wait for 2 secs. This avoids a dramatic loop.
-
-            if(st > MAX_INACTIVITY_SLEEP_TIME)
+            if(hashFile(job.full_path, hash, size, static_cast<uint8_t*>(buffer), thread))
             {
+                // store the result
+
+#ifdef HASHSTORAGE_DEBUG
+                std::cerr << "done."<< std::endl;
+#endif
+
                 RS_STACK_MUTEX(mHashMtx) ;
+                HashCacheIndex::Entry info ;
 
-                mInactivitySleepTime = MAX_INACTIVITY_SLEEP_TIME;
+                info.size = size ;
+                info.modf_stamp = job.ts ;
+                info.time_stamp = time(NULL);
+                info.hash = hash;
 
-                if(!mChanged)	// otherwise it might prevent from saving the hash cache
-                {
-                    stopHashThread();
-                }
+                mIndex.update(mIndex.pathKey(job.real_path),info) ;
 
-                if(rsEvents)
-                {
-                    auto ev = std::make_shared<RsSharedDirectoriesEvent>();
-                    ev->mEventCode = RsSharedDirectoriesEventCode::DIRECTORY_SWEEP_ENDED;
-                    rsEvents->postEvent(ev);
-                }
-                //RsServer::notify()->notifyHashingInfo(NOTIFY_HASHTYPE_FINISH, "") ;
+                mChanged = true ;
+                mTotalHashedSize += size ;
             }
             else
             {
-                RS_STACK_MUTEX(mHashMtx) ;
-                mInactivitySleepTime = 2*st ;
-            }
+                hash.clear() ;
 
-            return ;
+                if(!thread->shouldStop())
+                    RS_ERR("Failure hashing file: ", job.full_path);
+            }
         }
-        mInactivitySleepTime = DEFAULT_INACTIVITY_SLEEP_TIME;
 
-		bool paused = false ;
-        {
-            RS_STACK_MUTEX(mHashMtx) ;
-			paused = mHashingProcessPaused ;
-		}
-
-		if(paused)	// we need to wait off mutex!!
-		{
-			rstime::rs_usleep(MAX_INACTIVITY_SLEEP_TIME) ;
-			std::cerr << "Hashing process currently paused." << std::endl;
-			return;
-		}
-		else
+        auto ev = std::make_shared<RsFileHashingCompletedEvent>();
+
         {
             RS_STACK_MUTEX(mHashMtx) ;
 
-            job = mFilesToHash.begin()->second ;
-            mFilesToHash.erase(mFilesToHash.begin()) ;
+            --mJobsInProgress ;
+
+            if(confirmed)
+                ++mHashCounter ;
+
+            ev->mHashingSpeed = mCurrentHashingSpeed;
+            ev->mHashedFiles = mHashCounter ;
+            ev->mFilesToHash = mTotalFilesToHash ;
+            ev->mHashedBytes = mTotalHashedSize ;
+            ev->mBytesToHash = mTotalSizeToHash ;
         }
 
-        if(job.client->hash_confirm(job.client_param))
-        {
-#ifdef HASHSTORAGE_DEBUG
-            std::cerr << "Hashing file " << job.full_path << "..." ; std::cerr.flush();
+        // call the client
+        if(!hash.isNull())
+            job.client->hash_callback(job.client_param, job.full_path, hash, size);
+
+        /* Notify we completed hashing a file */
+        ev->mFilePath = job.full_path;
+        ev->mFileHash = hash;
+
+        if(rsEvents)
+            rsEvents->postEvent(ev);
+    }
+
+#ifdef WINDOWS_SYS
+    _aligned_free(buffer) ;
+#else
+    free(buffer) ;
 #endif
+}
 
-            std::string tmpout;
+bool HashStorage::hashFile(const std::string& full_path, RsFileHash& hash, uint64_t& size, uint8_t *buffer, RsThread *thread)
+{
+    FILE *fd = RsDirUtil::rs_fopen(full_path.c_str(), "rb") ;
 
-			if(mCurrentHashingSpeed > 0)
-				rs_sprintf(tmpout, "%lu/%lu (%s - %d%%, %d MB/s) : %s", (unsigned long int)mHashCounter+1, (unsigned long int)mTotalFilesToHash, friendlyUnit(mTotalHashedSize).c_str(), int(mTotalHashedSize/double(mTotalSizeToHash)*100.0), mCurrentHashingSpeed,job.full_path.c_str()) ;
-			else
-				rs_sprintf(tmpout, "%lu/%lu (%s - %d%%) : %s", (unsigned long int)mHashCounter+1, (unsigned long int)mTotalFilesToHash, friendlyUnit(mTotalHashedSize).c_str(), int(mTotalHashedSize/double(mTotalSizeToHash)*100.0), job.full_path.c_str()) ;
+    if(!fd)
+        return false;
 
-			{
-				/* Emit deprecated event only for retrocompatibility
-				 * TODO: create a proper event with structured data instead of a
-				 * formatted string */
-				auto ev = std::make_shared<RsSharedDirectoriesEvent>();
-				ev->mEventCode = RsSharedDirectoriesEventCode::HASHING_FILE;
-				ev->mMessage = tmpout;
-				rsEvents->postEvent(ev);
-			}
+    // Reads go straight to the aligned buffer, without being copied in the stdio buffer.
 
-			double seconds_origin = rstime::RsScopeTimer::currentTime() ;
+    setvbuf(fd, NULL, _IONBF, 0) ;
 
-			if(RsDirUtil::getFileHash(job.full_path, hash, size, this))
-			{
-				// store the result
+    fseeko64(fd, 0, SEEK_END);
+    size = ftello64(fd);
+    fseeko64(fd, 0, SEEK_SET);
 
-#ifdef HASHSTORAGE_DEBUG
-				std::cerr << "done."<< std::endl;
+#ifdef POSIX_FADV_SEQUENTIAL
+    // Hint the kernel for a large read-ahead. Files are read only once, so pages that were hashed are dropped below,
+    // so that hashing a large library does not flush the page cache.
+
+    int fno = fileno(fd) ;
+    posix_fadvise(fno, 0, 0, POSIX_FADV_SEQUENTIAL) ;
+    posix_fadvise(fno, 0, std::min(size,(uint64_t)2*HASHING_READ_BUFFER_SIZE), POSIX_FADV_WILLNEED) ;
 #endif
 
-				RS_STACK_MUTEX(mHashMtx) ;
-				HashStorageInfo& info(mFiles[job.real_path]);
+    SHA_CTX sha_ctx ;
+    SHA1_Init(&sha_ctx);
 
-				info.filename = job.real_path ;
-				info.size = size ;
-				info.modf_stamp = job.ts ;
-				info.time_stamp = time(NULL);
-				info.hash = hash;
+    uint64_t offset = 0 ;
+    size_t len ;
 
-				mChanged = true ;
-				mTotalHashedSize += size ;
-			}
-			else RS_ERR("Failure hashing file: ", job.full_path);
+    while((len = fread(buffer, 1, HASHING_READ_BUFFER_SIZE, fd)) > 0)
+    {
+#ifdef POSIX_FADV_SEQUENTIAL
+        posix_fadvise(fno, offset + HASHING_READ_BUFFER_SIZE, HASHING_READ_BUFFER_SIZE, POSIX_FADV_WILLNEED) ;
+#endif
+        SHA1_Update(&sha_ctx, buffer, len);
 
-			mHashingTime += rstime::RsScopeTimer::currentTime() - seconds_origin ;
-			mHashedBytes += size ;
+#ifdef POSIX_FADV_DONTNEED
+        posix_fadvise(fno, offset, len, POSIX_FADV_DONTNEED) ;
+#endif
+        offset += len ;
 
-			if(mHashingTime > 3)
-			{
-				mCurrentHashingSpeed = (int)(mHashedBytes / mHashingTime ) / (1024*1024) ;
-				mHashingTime = 0 ;
-				mHashedBytes = 0 ;
-			}
+        accountHashedBytes(len) ;
 
-            ++mHashCounter ;
+        // wait here while paused, so that a large file does not keep the disk busy
+
+        while(hashingProcessPaused() && !thread->shouldStop())
+            rstime::rs_usleep(PAUSED_SLEEP_TIME) ;
+
+        if(thread->shouldStop())
+        {
+            fclose(fd);
+            return false;
         }
-	}
+    }
+
+    /* reading failed for some reason */
+    if(ferror(fd))
+    {
+        fclose(fd);
+        return false;
+    }
+    fclose(fd);
 
-	// call the client
-	if(!hash.isNull())
-		job.client->hash_callback(job.client_param, job.full_path, hash, size);
+    unsigned char sha_buf[SHA_DIGEST_LENGTH];
+    SHA1_Final(&sha_buf[0], &sha_ctx);
 
-	/* Notify we completed hashing a file */
-	auto ev = std::make_shared<RsFileHashingCompletedEvent>();
-	ev->mFilePath = job.full_path;
-	ev->mHashingSpeed = mCurrentHashingSpeed;
-	ev->mFileHash = hash;
-	rsEvents->postEvent(ev);
+    hash = Sha1CheckSum(sha_buf);
+    return true ;
+}
+
+void HashStorage::accountHashedBytes(uint32_t bytes)
+{
+    double wait_time = 0 ;
+
+    {
+        RS_STACK_MUTEX(mHashMtx) ;
+
+        mHashedBytes += bytes ;
+
+        if(mMaxHashingSpeed == 0)
+            return ;
+
+        // Token bucket shared by all hashing threads: the budget grows at the max speed, up to one second of reads.
+
+        double now = rstime::RsScopeTimer::currentTime() ;
+        double rate = mMaxHashingSpeed * 1024.0 * 1024.0 ;
+
+        if(mThrottleLastTime > 0)
+            mThrottleBudget = std::min(rate, mThrottleBudget + (now - mThrottleLastTime) * rate) ;
+
+        mThrottleLastTime = now ;
+        mThrottleBudget -= bytes ;
+
+        if(mThrottleBudget < 0)
+            wait_time = -mThrottleBudget / rate ;
+    }
+
+    if(wait_time > 0)
+        rstime::rs_usleep((uint32_t)(wait_time * 1000000)) ;
 }
 
 bool HashStorage::requestHash(const std::string& full_path,uint64_t size,rstime_t mod_time,RsFileHash& known_hash,HashStorageClient *c,uint32_t client_param)
@@ -259,34 +552,41 @@ bool HashStorage::requestHash(const std::string& full_path,uint64_t size,rstime_
 	std::string real_path = RsDirUtil::removeSymLinks(full_path) ;
 
     rstime_t now = time(NULL) ;
-    std::map<std::string,HashStorageInfo>::iterator it = mFiles.find(real_path) ;
+    HashCacheIndex::PathKey key = mIndex.pathKey(real_path) ;
+    HashCacheIndex::Entry entry ;
 
     // On windows we compare the time up to +/- 3600 seconds. This avoids re-hashing files in case of daylight saving change.
     //
     // See:
     //		 https://support.microsoft.com/en-us/kb/190315
     //
-    if(it != mFiles.end()
+    if(mIndex.find(key,entry)
 #ifdef WINDOWS_SYS
-            && ( (uint64_t)mod_time == it->second.modf_stamp || (uint64_t)mod_time+3600 == it->second.modf_stamp ||(uint64_t)mod_time == it->second.modf_stamp+3600)
+            && ( (uint64_t)mod_time == entry.modf_stamp || (uint64_t)mod_time+3600 == entry.modf_stamp ||(uint64_t)mod_time == entry.modf_stamp+3600)
 #else
-            && (uint64_t)mod_time == it->second.modf_stamp
+            && (uint64_t)mod_time == entry.modf_stamp
 #endif
-            && size == it->second.size)
+            && size == entry.size)
     {
-        it->second.time_stamp = now ;
-
 #ifdef WINDOWS_SYS
-        if(it->second.modf_stamp != (uint64_t)mod_time)
+        if(entry.modf_stamp != (uint64_t)mod_time)
         {
             std::cerr << "(WW) detected a 1 hour shift in file modification time. This normally happens to many files at once, when daylight saving time shifts (file=\"" << full_path << "\")." << std::endl;
-            it->second.modf_stamp = (uint64_t)mod_time;
+            entry.modf_stamp = (uint64_t)mod_time;
+            entry.time_stamp = now ;
+            mIndex.update(key,entry) ;
             mChanged = true;
             startHashThread();
         }
+        else
 #endif
+        if((uint64_t)entry.time_stamp + MIN_TIME_STAMP_UPDATE_DELAY < (uint64_t)now)
+        {
+            mIndex.touch(key,now) ;
+            mChanged = true;
+        }
 
-        known_hash = it->second.hash;
+        known_hash = entry.hash;
 #ifdef HASHSTORAGE_DEBUG
         std::cerr << "Found in cache." << std::endl ;
 #endif
@@ -331,6 +631,8 @@ void HashStorage::startHashThread()
         std::cerr << "Starting hashing thread." << std::endl;
         mHashCounter = 0;
         mTotalHashedSize = 0;
+        mHashedBytes = 0;
+        mHashingTime = 0;
 
         start("fs hash cache") ;
     }
@@ -361,36 +663,32 @@ void HashStorage::clean()
     std::cerr << "Cleaning hash cache." << std::endl ;
 #endif
 
-    for(std::map<std::string,HashStorageInfo>::iterator it(mFiles.begin());it!=mFiles.end();)
-		if((uint64_t)(it->second.time_stamp + duration) < (uint64_t)now)
-        {
-#ifdef HASHSTORAGE_DEBUG
-            std::cerr << "  Entry too old: " << it->first << ", ts=" << it->second.time_stamp << std::endl ;
-#endif
-            std::map<std::string,HashStorageInfo>::iterator tmp(it) ;
-            ++tmp ;
-            mFiles.erase(it) ;
-            it=tmp ;
-            mChanged = true ;
-        }
-        else
-            ++it ;
+    // Entries that are too old are dropped while writing the new index.
+
+    if(now > duration)
+        mIndex.compact(now - duration) ;
 
 #ifdef HASHSTORAGE_DEBUG
     std::cerr << "Done." << std::endl;
 #endif
 }
 
-bool HashStorage::locked_load()
+bool HashStorage::locked_load_old_hash_cache(std::map<std::string,HashStorageInfo>& files)
 {
     unsigned char *data = NULL ;
     uint32_t data_size=0;
 
-    if(!FileListIO::loadEncryptedDataFromFile(mFilePath,data,data_size))
-    {
-        std::cerr << "(EE) Cannot read hash cache." << std::endl;
+    if(!RsDirUtil::fileExists(mFilePath) || !FileListIO::loadEncryptedDataFromFile(mFilePath,data,data_size))
         return false;
-    }
+
+    parseOldHashCache(data,data_size,files) ;
+
+    free(data) ;
+    return true ;
+}
+
+bool HashStorage::parseOldHashCache(const unsigned char *data,uint32_t data_size,std::map<std::string,HashStorageInfo>& files)
+{
     uint32_t offset = 0 ;
     HashStorageInfo info ;
 #ifdef HASHSTORAGE_DEBUG
@@ -398,48 +696,65 @@ bool HashStorage::locked_load()
 #endif
 
     while(offset < data_size)
+    {
+       uint32_t previous_offset = offset ;
+
        if(readHashStorageInfo(data,data_size,offset,info))
        {
 #ifdef HASHSTORAGE_DEBUG
           std::cerr << info << std::endl;
           ++n ;
 #endif
-          mFiles[info.filename] = info ;
+          files[info.filename] = info ;
        }
+       else if(offset == previous_offset)	// nothing could be read: the end of the file is garbage
+          return false ;
+    }
 
-    free(data) ;
 #ifdef HASHSTORAGE_DEBUG
     std::cerr << n << " entries loaded." << std::endl ;
 #endif
     return true ;
 }
 
-void HashStorage::locked_save()
+bool HashStorage::importIntoIndex(const std::map<std::string,HashStorageInfo>& files,HashCacheIndex& index)
 {
-#ifdef HASHSTORAGE_DEBUG
-    std::cerr << "Saving Hash Cache to file " << mFilePath << "..." << std::endl ;
-#endif
+    for(std::map<std::string,HashStorageInfo>::const_iterator it(files.begin());it!=files.end();++it)
+    {
+        HashCacheIndex::Entry entry ;
 
-    unsigned char *data = NULL ;
-    uint32_t offset = 0 ;
-    uint32_t total_size = 0;
+        entry.size       = it->second.size ;
+        entry.time_stamp = it->second.time_stamp ;
+        entry.modf_stamp = it->second.modf_stamp ;
+        entry.hash       = it->second.hash ;
 
-    for(std::map<std::string,HashStorageInfo>::const_iterator it(mFiles.begin());it!=mFiles.end();++it)
-        writeHashStorageInfo(data,total_size,offset,it->second) ;
+        index.update(index.pathKey(it->first),entry) ;
+    }
 
-    if(!FileListIO::saveEncryptedDataToFile(mFilePath,data,offset))
-    {
-        std::cerr << "(EE) Cannot save hash cache data." << std::endl;
-        free(data) ;
+    return index.compact() ;
+}
+
+void HashStorage::locked_import(const std::map<std::string,HashStorageInfo>& files)
+{
+    if(!importIntoIndex(files,mIndex))
         return ;
-    }
 
-    std::cerr << mFiles.size() << " entries saved in hash cache." << std::endl;
+    std::cerr << "(II) Imported " << files.size() << " entries into the new hash cache. Removing former hash cache file " << mFilePath << std::endl;
 
-    free(data) ;
+    RsDirUtil::removeFile(mFilePath) ;
+}
+
+void HashStorage::locked_save()
+{
+#ifdef HASHSTORAGE_DEBUG
+    std::cerr << "Saving Hash Cache..." << std::endl ;
+#endif
+
+    if(!mIndex.save())
+        std::cerr << "(EE) Cannot save hash cache data." << std::endl;
 }
 
-bool HashStorage::readHashStorageInfo(const unsigned char *data,uint32_t total_size,uint32_t& offset,HashStorageInfo& info) const
+bool HashStorage::readHashStorageInfo(const unsigned char *data,uint32_t total_size,uint32_t& offset,HashStorageInfo& info)
 {
     unsigned char *section_data = (unsigned char *)rs_malloc(FL_BASE_TMP_SECTION_SIZE) ;
 
@@ -468,7 +783,7 @@ bool HashStorage::readHashStorageInfo(const unsigned char *data,uint32_t total_s
     return true;
 }
 
-bool HashStorage::writeHashStorageInfo(unsigned char *& data,uint32_t&  total_size,uint32_t& offset,const HashStorageInfo& info) const
+bool HashStorage::writeHashStorageInfo(unsigned char *& data,uint32_t&  total_size,uint32_t& offset,const HashStorageInfo& info)
 {
     unsigned char *section_data = (unsigned char *)rs_malloc(FL_BASE_TMP_SECTION_SIZE) ;
 
@@ -511,7 +826,7 @@ std::ostream& operator<<(std::ostream& o,const HashStorage::HashStorageInfo& inf
 #include "rsserver/rsaccounts.h"
 #include <sstream>
 
-bool HashStorage::try_load_import_old_hash_cache()
+bool HashStorage::try_load_import_old_hash_cache(std::map<std::string,HashStorageInfo>& tmp_files)
 {
     // compute file name
 
@@ -573,8 +888,6 @@ bool HashStorage::try_load_import_old_hash_cache()
     std::cerr << "Importing hashCache from file " << old_cache_filename << std::endl ;
     int n=0 ;
 
-    std::map<std::string, HashStorageInfo> tmp_files ;	// stored as (full_path, hash_info)
-
     while(!f->eof())
     {
         HashStorageInfo info ;
@@ -605,9 +918,6 @@ bool HashStorage::try_load_import_old_hash_cache()
 
     RsDirUtil::renameFile(old_cache_filename,old_cache_filename+".bak") ;
 
-    mFiles = tmp_files ;
-    locked_save() ;		// this is called explicitly here because the ticking thread is not active.
-
     return true;
 }
 /********************************************************************************************************************************/
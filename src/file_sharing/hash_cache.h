@@ -24,9 +24,11 @@
 #pragma once
 
 #include <map>
+#include <vector>
 #include "util/rsthreads.h"
 #include "retroshare/rsfiles.h"
 #include "util/rstime.h"
+#include "hash_cache_index.h"
 
 /*!
  * \brief The HashStorageClient class
@@ -53,6 +55,7 @@ class HashStorage: public RsTickingThread
 {
 public:
     explicit HashStorage(const std::string& save_file_name) ;
+    ~HashStorage() override;
 
     /*!
      * \brief requestHash  Requests the hash for the given file, assuming size and mod_time are the same.
@@ -80,14 +83,32 @@ public:
     // interaction with GUI, called from p3FileLists
     void setRememberHashFilesDuration(uint32_t days) { mMaxStorageDurationDays = days ; }		// duration for which the hash is kept even if the file is not shared anymore
     uint32_t rememberHashFilesDuration() const { return mMaxStorageDurationDays ; }
-    void clear() { mFiles.clear(); mChanged=true; }												// drop all known hashes. Not something to do, except if you want to rehash the entire database
-    bool empty() const { return mFiles.empty() ; }
+    void clear() ;																				// drop all known hashes. Not something to do, except if you want to rehash the entire database
+    bool empty() ;
 	void togglePauseHashingProcess() ;
 	bool hashingProcessPaused();
 
+	// number of files hashed in parallel. Each hashing thread reads a single file at a time.
+	void setHashingThreads(uint32_t n) ;
+	uint32_t hashingThreads() ;
+
+	// maximum hashing speed summed over all hashing threads, in MB/s. 0 means no limit.
+	void setMaxHashingSpeed(uint32_t mb_per_sec) ;
+	uint32_t maxHashingSpeed() ;
+
+	// waits for the hashing threads to stop, then saves what they hashed. Call it once the main thread is stopped.
+	void stopHashingThreads() ;
+
 	void threadTick() override; /// @see RsTickingThread
 
     friend std::ostream& operator<<(std::ostream& o,const HashStorageInfo& info) ;
+
+    // Former hash cache format, once decrypted, and its import into a hash cache index.
+
+    static bool parseOldHashCache(const unsigned char *data,uint32_t data_size,std::map<std::string, HashStorageInfo>& files) ;
+    static bool importIntoIndex(const std::map<std::string, HashStorageInfo>& files,HashCacheIndex& index) ;
+    static bool writeHashStorageInfo(unsigned char *& data,uint32_t&  total_size,uint32_t& offset,const HashStorageInfo& info) ;
+
 private:
     /*!
      * \brief clean
@@ -98,20 +119,32 @@ private:
     void startHashThread();
     void stopHashThread();
 
-    // loading/saving the entire hash database to a file
+    class HashingThread ;
+
+    // hashing loop of each hashing thread, @see HashingThread
+    void hashingThreadLoop(uint32_t thread_index, RsThread *thread) ;
+    bool hashFile(const std::string& full_path, RsFileHash& hash, uint64_t& size, uint8_t *buffer, RsThread *thread) ;
+    void accountHashedBytes(uint32_t bytes) ;
+
+    void onStopRequested() override; /// @see RsThread
+
+    // saving the hash database. Only the changes since last save are written.
 
     void locked_save() ;
-    bool locked_load() ;
-    bool try_load_import_old_hash_cache();
 
-    bool readHashStorageInfo(const unsigned char *data,uint32_t total_size,uint32_t& offset,HashStorageInfo& info) const;
-    bool writeHashStorageInfo(unsigned char *& data,uint32_t&  total_size,uint32_t& offset,const HashStorageInfo& info) const;
+    // import of former hash cache formats into mIndex
+
+    bool locked_load_old_hash_cache(std::map<std::string, HashStorageInfo>& files) ;
+    bool try_load_import_old_hash_cache(std::map<std::string, HashStorageInfo>& files);
+    void locked_import(const std::map<std::string, HashStorageInfo>& files) ;
+
+    static bool readHashStorageInfo(const unsigned char *data,uint32_t total_size,uint32_t& offset,HashStorageInfo& info) ;
 
     // Local configuration and storage
 
     uint32_t mMaxStorageDurationDays ; 				// maximum duration of un-requested cache entries
-    std::map<std::string, HashStorageInfo> mFiles ;	// stored as (full_path, hash_info)
-    std::string mFilePath ;							// file where the hash database is stored
+    std::string mFilePath ;							// former hash database file. The new files are named after it.
+    HashCacheIndex mIndex ;							// stored as (path key, hash_info)
     bool mChanged ;
 	bool mHashingProcessPaused ;
 
@@ -145,5 +178,17 @@ private:
 	double mHashingTime ;
 	uint64_t mHashedBytes ;
 	uint32_t mCurrentHashingSpeed ; // in MB/s
+
+	// Hashing threads. They are started by the main thread when files are waiting to be hashed, and stop when there are
+	// no more files to hash. The number of reads in flight is bounded by the number of threads.
+
+	std::vector<HashingThread*> mHashingThreads ;	// created once, only the first mMaxHashingThreads are used
+	uint32_t mMaxHashingThreads ;
+	uint32_t mJobsInProgress ;
+
+	// throttling
+	uint32_t mMaxHashingSpeed ; // in MB/s
+	double mThrottleBudget ;	// bytes that can be read without waiting
+	double mThrottleLastTime ;
 };
 
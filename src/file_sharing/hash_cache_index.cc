@@ -0,0 +1,583 @@
+/*******************************************************************************
+ * libretroshare/src/file_sharing: hash_cache_index.cc                         *
+ *                                                                             *
+ * libretroshare: retroshare core library                                      *
+ *                                                                             *
+ * Copyright (C) 2026  RetroShare Team <contact@retroshare.cc>                 *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Lesser General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ ******************************************************************************/
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <iostream>
+
+#ifndef WINDOWS_SYS
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#else
+#include <io.h>
+#endif
+
+#include "crypto/chacha20.h"
+#include "util/rsdir.h"
+#include "util/rsmemory.h"
+#include "util/rsrandom.h"
+#include "filelist_io.h"
+#include "hash_cache_index.h"
+
+//#define HASHCACHEINDEX_DEBUG 1
+
+// Index file layout:
+//
+//   header:  [magic 8B] [version 4B] [record size 4B] [record count 8B] [reserved 8B]
+//   records: sorted by path key
+//
+// Record layout (the log file is a plain sequence of records):
+//
+//   [path key 20B] [nonce 4B] [ encrypted: size 8B, time stamp 4B, modif time stamp 4B, hash 20B ]
+//
+// All integers are little endian.
+
+static const uint8_t  HASH_CACHE_INDEX_MAGIC[8]      = { 'R','S','H','C','I','D','X',0 } ;
+static const uint32_t HASH_CACHE_INDEX_VERSION       = 1 ;
+
+static const uint32_t RECORD_KEY_OFFSET              = 0 ;
+static const uint32_t RECORD_NONCE_OFFSET            = 20 ;
+static const uint32_t RECORD_PAYLOAD_OFFSET          = 24 ;
+static const uint32_t RECORD_PAYLOAD_SIZE            = 36 ;
+
+static const uint32_t MIN_UPDATES_BEFORE_COMPACTION  = 4096 ;	// compact when the log holds more than this, and more than 1/8 of the index
+
+const uint32_t HashCacheIndex::RECORD_SIZE           = RECORD_PAYLOAD_OFFSET + RECORD_PAYLOAD_SIZE ;
+const uint32_t HashCacheIndex::INDEX_HEADER_SIZE     = 32 ;
+
+static void write_le(uint8_t *p,uint64_t v,uint32_t n) { for(uint32_t i=0;i<n;++i) p[i] = (v >> (8*i)) & 0xff ; }
+static uint64_t read_le(const uint8_t *p,uint32_t n) { uint64_t v=0 ; for(uint32_t i=0;i<n;++i) v |= uint64_t(p[i]) << (8*i) ; return v ; }
+
+HashCacheIndex::HashCacheIndex(const std::string& base_name)
+    : mKeyFile(base_name + ".key"), mIndexFile(base_name + ".idx"), mLogFile(base_name + ".log"),
+      mHasSecret(false), mData(NULL), mDataSize(0), mRecordCount(0), mIndexModifiedInMemory(false)
+{
+	memset(mSecret,0,32) ;
+}
+
+HashCacheIndex::~HashCacheIndex()
+{
+	unmapIndex() ;
+	memset(mSecret,0,32) ;
+}
+
+bool HashCacheIndex::load()
+{
+	mHasSecret = loadSecret() ;
+
+	if(mHasSecret && mapIndex())
+	{
+		// A log that ends with a partially written record cannot be appended to. Its records go to the index instead.
+
+		if(!replayLog())
+			compact() ;
+
+		std::cerr << "(II) Hash cache index loaded: " << mRecordCount << " entries, " << mUpdates.size() << " updates in log." << std::endl;
+		return true ;
+	}
+
+	// No usable cache: start a new one, with a new secret so that nothing can be matched with former files.
+
+	unmapIndex() ;
+	mUpdates.clear() ;
+	mPendingLog.clear() ;
+
+	RsRandom::random_bytes(mSecret,32) ;
+	mHasSecret = true ;
+
+	if(!saveSecret())
+		std::cerr << "(EE) Cannot save hash cache key. Hashes will be lost at next restart." << std::endl;
+
+	if(RsDirUtil::fileExists(mLogFile))
+		RsDirUtil::removeFile(mLogFile) ;
+	writeEmptyIndex() ;
+	mapIndex() ;
+
+	return false ;
+}
+
+bool HashCacheIndex::loadSecret()
+{
+	unsigned char *data = NULL ;
+	uint32_t data_size = 0 ;
+
+	if(!RsDirUtil::fileExists(mKeyFile) || !FileListIO::loadEncryptedDataFromFile(mKeyFile,data,data_size))
+		return false ;
+
+	if(data_size != 32)
+	{
+		std::cerr << "(EE) Hash cache key has wrong size " << data_size << ". Dropping the hash cache." << std::endl;
+		free(data) ;
+		return false ;
+	}
+
+	memcpy(mSecret,data,32) ;
+	memset(data,0,32) ;
+	free(data) ;
+
+	return true ;
+}
+
+bool HashCacheIndex::saveSecret()
+{
+	return FileListIO::saveEncryptedDataToFile(mKeyFile,mSecret,32) ;
+}
+
+// Flushes the file down to the disc, so that it can safely replace the previous version of the file.
+
+static bool syncFile(FILE *f)
+{
+	if(fflush(f) != 0)
+		return false ;
+#ifndef WINDOWS_SYS
+	return fsync(fileno(f)) == 0 ;
+#else
+	return _commit(_fileno(f)) == 0 ;
+#endif
+}
+
+// Makes the renames and removals of files in the directory of the given file durable. Windows does not need it.
+
+static bool syncDirectoryOf(const std::string& file)
+{
+#ifndef WINDOWS_SYS
+	std::string dir = RsDirUtil::getDirectory(file) ;
+	int fd = open(dir.empty() ? "." : dir.c_str(),O_RDONLY) ;
+
+	if(fd < 0)
+		return false ;
+
+	bool ok = fsync(fd) == 0 ;
+	close(fd) ;
+
+	return ok ;
+#else
+	(void) file ;
+	return true ;
+#endif
+}
+
+bool HashCacheIndex::writeEmptyIndex()
+{
+	FILE *f = RsDirUtil::rs_fopen(mIndexFile.c_str(),"wb") ;
+
+	if(!f)
+	{
+		std::cerr << "(EE) Cannot write hash cache index " << mIndexFile << std::endl;
+		return false ;
+	}
+	uint8_t header[INDEX_HEADER_SIZE] ;
+	memset(header,0,INDEX_HEADER_SIZE) ;
+	memcpy(header,HASH_CACHE_INDEX_MAGIC,8) ;
+	write_le(header+ 8,HASH_CACHE_INDEX_VERSION,4) ;
+	write_le(header+12,RECORD_SIZE,4) ;
+
+	bool ok = fwrite(header,1,INDEX_HEADER_SIZE,f) == INDEX_HEADER_SIZE ;
+	fclose(f) ;
+
+	return ok ;
+}
+
+bool HashCacheIndex::mapIndex()
+{
+	unmapIndex() ;
+
+	uint64_t file_size = 0 ;
+
+	if(!RsDirUtil::checkFile(mIndexFile,file_size) || file_size < INDEX_HEADER_SIZE)
+		return false ;
+
+#ifndef WINDOWS_SYS
+	int fd = open(mIndexFile.c_str(),O_RDWR) ;
+
+	if(fd < 0)
+	{
+		std::cerr << "(EE) Cannot open hash cache index " << mIndexFile << std::endl;
+		return false ;
+	}
+	void *mem = mmap(NULL,file_size,PROT_READ | PROT_WRITE,MAP_SHARED,fd,0) ;
+	close(fd) ;	// the mapping keeps the file referenced
+
+	if(mem == MAP_FAILED)
+	{
+		std::cerr << "(EE) Cannot map hash cache index " << mIndexFile << std::endl;
+		return false ;
+	}
+	mData = static_cast<uint8_t*>(mem) ;
+
+	// lookups are random
+	madvise(mData,file_size,MADV_RANDOM) ;
+#else
+	// No mmap here: read the index in memory. Lookups still avoid decoding all the entries.
+
+	mData = static_cast<uint8_t*>(rs_malloc(file_size)) ;
+
+	if(!mData)
+		return false ;
+
+	FILE *f = RsDirUtil::rs_fopen(mIndexFile.c_str(),"rb") ;
+
+	if(!f || fread(mData,1,file_size,f) != file_size)
+	{
+		std::cerr << "(EE) Cannot read hash cache index " << mIndexFile << std::endl;
+		if(f) fclose(f) ;
+		free(mData) ;
+		mData = NULL ;
+		return false ;
+	}
+	fclose(f) ;
+#endif
+	mDataSize = file_size ;
+
+	uint64_t count = read_le(mData+16,8) ;
+
+	if(memcmp(mData,HASH_CACHE_INDEX_MAGIC,8) || read_le(mData+8,4) != HASH_CACHE_INDEX_VERSION || read_le(mData+12,4) != RECORD_SIZE
+	        || count > (file_size - INDEX_HEADER_SIZE) / RECORD_SIZE)
+	{
+		std::cerr << "(EE) Hash cache index " << mIndexFile << " is corrupted or has an unknown version." << std::endl;
+		unmapIndex() ;
+		return false ;
+	}
+	mRecordCount = count ;
+
+	return true ;
+}
+
+void HashCacheIndex::unmapIndex()
+{
+	if(mData)
+	{
+#ifndef WINDOWS_SYS
+		munmap(mData,mDataSize) ;
+#else
+		free(mData) ;
+#endif
+	}
+	mData = NULL ;
+	mDataSize = 0 ;
+	mRecordCount = 0 ;
+	mIndexModifiedInMemory = false ;
+}
+
+bool HashCacheIndex::replayLog()
+{
+	uint64_t file_size = 0 ;
+
+	if(!RsDirUtil::checkFile(mLogFile,file_size,true))
+		return true ;
+
+	FILE *f = RsDirUtil::rs_fopen(mLogFile.c_str(),"rb") ;
+
+	if(!f)
+		return false ;
+
+	Record rec(RECORD_SIZE) ;
+
+	// A partially written record at the end of the log is ignored.
+
+	while(fread(rec.data(),1,RECORD_SIZE,f) == RECORD_SIZE)
+		mUpdates[PathKey::fromBufferUnsafe(rec.data()+RECORD_KEY_OFFSET)] = rec ;
+
+	fclose(f) ;
+
+	if(file_size % RECORD_SIZE != 0)
+	{
+		std::cerr << "(WW) Hash cache log " << mLogFile << " ends with a truncated record. Dropping it." << std::endl;
+		return false ;
+	}
+	return true ;
+}
+
+HashCacheIndex::PathKey HashCacheIndex::pathKey(const std::string& path) const
+{
+	// The secret is a prefix of the hashed data, so that keys cannot be computed from known paths.
+
+	std::vector<uint8_t> buf(32 + path.size()) ;
+	memcpy(buf.data(),mSecret,32) ;
+	memcpy(buf.data()+32,path.c_str(),path.size()) ;
+
+	PathKey key = RsDirUtil::sha1sum(buf.data(),buf.size()) ;
+	memset(buf.data(),0,32) ;
+
+	return key ;
+}
+
+void HashCacheIndex::encodeRecord(const PathKey& key,const Entry& entry,uint8_t *record) const
+{
+	memcpy(record+RECORD_KEY_OFFSET,key.toByteArray(),PathKey::SIZE_IN_BYTES) ;
+
+	// A new nonce for each write, so that the cipher stream is never reused for the same key.
+
+	uint32_t n = RsRandom::random_u32() ;
+	write_le(record+RECORD_NONCE_OFFSET,n,4) ;
+
+	uint8_t *payload = record+RECORD_PAYLOAD_OFFSET ;
+
+	write_le(payload   ,entry.size,8) ;
+	write_le(payload+ 8,entry.time_stamp,4) ;
+	write_le(payload+12,entry.modf_stamp,4) ;
+	memcpy(payload+16,entry.hash.toByteArray(),RsFileHash::SIZE_IN_BYTES) ;
+
+	uint8_t nonce[12] ;
+	memcpy(nonce,record+RECORD_KEY_OFFSET,8) ;
+	memcpy(nonce+8,record+RECORD_NONCE_OFFSET,4) ;
+
+	librs::crypto::chacha20_encrypt(const_cast<uint8_t*>(mSecret),0,nonce,payload,RECORD_PAYLOAD_SIZE) ;
+}
+
+bool HashCacheIndex::decodeRecord(const uint8_t *record,Entry& entry) const
+{
+	uint8_t payload[RECORD_PAYLOAD_SIZE] ;
+	memcpy(payload,record+RECORD_PAYLOAD_OFFSET,RECORD_PAYLOAD_SIZE) ;
+
+	uint8_t nonce[12] ;
+	memcpy(nonce,record+RECORD_KEY_OFFSET,8) ;
+	memcpy(nonce+8,record+RECORD_NONCE_OFFSET,4) ;
+
+	librs::crypto::chacha20_encrypt(const_cast<uint8_t*>(mSecret),0,nonce,payload,RECORD_PAYLOAD_SIZE) ;
+
+	entry.size       = read_le(payload   ,8) ;
+	entry.time_stamp = read_le(payload+ 8,4) ;
+	entry.modf_stamp = read_le(payload+12,4) ;
+	entry.hash       = RsFileHash::fromBufferUnsafe(payload+16) ;
+
+	return true ;
+}
+
+bool HashCacheIndex::findInIndex(const PathKey& key,uint64_t& index) const
+{
+	uint64_t lo = 0, hi = mRecordCount ;
+
+	while(lo < hi)
+	{
+		uint64_t mid = lo + (hi - lo)/2 ;
+		int c = memcmp(indexRecord(mid)+RECORD_KEY_OFFSET,key.toByteArray(),PathKey::SIZE_IN_BYTES) ;
+
+		if(c == 0)
+		{
+			index = mid ;
+			return true ;
+		}
+		if(c < 0)
+			lo = mid+1 ;
+		else
+			hi = mid ;
+	}
+	return false ;
+}
+
+bool HashCacheIndex::find(const PathKey& key,Entry& entry) const
+{
+	std::map<PathKey,Record>::const_iterator it = mUpdates.find(key) ;
+
+	if(it != mUpdates.end())
+		return decodeRecord(it->second.data(),entry) ;
+
+	uint64_t index ;
+
+	if(findInIndex(key,index))
+		return decodeRecord(indexRecord(index),entry) ;
+
+	return false ;
+}
+
+void HashCacheIndex::update(const PathKey& key,const Entry& entry)
+{
+	Record& rec(mUpdates[key]) ;
+	rec.resize(RECORD_SIZE) ;
+	encodeRecord(key,entry,rec.data()) ;
+
+	mPendingLog.insert(mPendingLog.end(),rec.begin(),rec.end()) ;
+}
+
+void HashCacheIndex::touch(const PathKey& key,uint32_t time_stamp)
+{
+	Entry entry ;
+	uint64_t index ;
+
+	if(mUpdates.find(key) == mUpdates.end() && findInIndex(key,index))
+	{
+		// Rewrite the record in place. The system writes it back to the index file.
+
+		uint8_t *record = mData + INDEX_HEADER_SIZE + index*RECORD_SIZE ;
+		decodeRecord(record,entry) ;
+		entry.time_stamp = time_stamp ;
+		encodeRecord(key,entry,record) ;
+#ifdef WINDOWS_SYS
+		mIndexModifiedInMemory = true ;
+#endif
+		return ;
+	}
+
+	if(find(key,entry))
+	{
+		entry.time_stamp = time_stamp ;
+		update(key,entry) ;
+	}
+}
+
+uint64_t HashCacheIndex::size() const
+{
+	return mRecordCount + mUpdates.size() ;
+}
+
+bool HashCacheIndex::save()
+{
+	if(!mPendingLog.empty())
+	{
+		FILE *f = RsDirUtil::rs_fopen(mLogFile.c_str(),"ab") ;
+
+		if(!f)
+		{
+			std::cerr << "(EE) Cannot open hash cache log " << mLogFile << std::endl;
+			return false ;
+		}
+		bool ok = fwrite(mPendingLog.data(),1,mPendingLog.size(),f) == mPendingLog.size() ;
+		fclose(f) ;
+
+		if(!ok)
+		{
+			std::cerr << "(EE) Cannot write hash cache log " << mLogFile << ". Out of disc space??" << std::endl;
+			return false ;
+		}
+		mPendingLog.clear() ;
+	}
+
+	if(mIndexModifiedInMemory || (mUpdates.size() > MIN_UPDATES_BEFORE_COMPACTION && mUpdates.size() > mRecordCount/8))
+		return compact() ;
+
+#ifndef WINDOWS_SYS
+	if(mData)
+		msync(mData,mDataSize,MS_ASYNC) ;
+#endif
+	return true ;
+}
+
+bool HashCacheIndex::compact(uint32_t min_time_stamp)
+{
+	std::string tmp_file = mIndexFile + ".tmp" ;
+	FILE *f = RsDirUtil::rs_fopen(tmp_file.c_str(),"wb") ;
+
+	if(!f)
+	{
+		std::cerr << "(EE) Cannot write hash cache index " << tmp_file << std::endl;
+		return false ;
+	}
+
+	uint8_t header[INDEX_HEADER_SIZE] ;
+	memset(header,0,INDEX_HEADER_SIZE) ;
+	bool ok = fwrite(header,1,INDEX_HEADER_SIZE,f) == INDEX_HEADER_SIZE ;	// rewritten once the count is known
+
+	uint64_t count = 0 ;
+	uint64_t i = 0 ;
+	std::map<PathKey,Record>::const_iterator it = mUpdates.begin() ;
+	Entry entry ;
+
+	// Merge the sorted index with the sorted updates. Updated entries replace the ones of the index.
+
+	while(ok && (i < mRecordCount || it != mUpdates.end()))
+	{
+		const uint8_t *record ;
+
+		if(it == mUpdates.end())
+			record = indexRecord(i++) ;
+		else if(i == mRecordCount)
+			record = (it++)->second.data() ;
+		else
+		{
+			int c = memcmp(indexRecord(i)+RECORD_KEY_OFFSET,it->first.toByteArray(),PathKey::SIZE_IN_BYTES) ;
+
+			if(c < 0)
+				record = indexRecord(i++) ;
+			else
+			{
+				if(c == 0)
+					++i ;
+				record = (it++)->second.data() ;
+			}
+		}
+
+		if(min_time_stamp > 0 && decodeRecord(record,entry) && entry.time_stamp < min_time_stamp)
+			continue ;
+
+		ok = fwrite(record,1,RECORD_SIZE,f) == RECORD_SIZE ;
+		++count ;
+	}
+
+	memcpy(header,HASH_CACHE_INDEX_MAGIC,8) ;
+	write_le(header+ 8,HASH_CACHE_INDEX_VERSION,4) ;
+	write_le(header+12,RECORD_SIZE,4) ;
+	write_le(header+16,count,8) ;
+
+	ok = ok && fseek(f,0,SEEK_SET) == 0 && fwrite(header,1,INDEX_HEADER_SIZE,f) == INDEX_HEADER_SIZE ;
+
+	// The new index must be on disc before it replaces the old one, or a crash could leave an empty index behind.
+
+	ok = ok && syncFile(f) ;
+	ok = (fclose(f) == 0) && ok ;
+
+	if(!ok)
+	{
+		std::cerr << "(EE) Cannot write hash cache index " << tmp_file << ". Out of disc space??" << std::endl;
+		RsDirUtil::removeFile(tmp_file) ;
+		return false ;
+	}
+
+	unmapIndex() ;
+
+	if(!RsDirUtil::renameFile(tmp_file,mIndexFile))
+	{
+		std::cerr << "(EE) Cannot rename " << tmp_file << " into " << mIndexFile << std::endl;
+		mapIndex() ;
+		return false ;
+	}
+
+	// All updates are now in the index: empty the log. The rename is made durable first, otherwise a crash could
+	// bring back the old index without the log.
+
+	if(!syncDirectoryOf(mIndexFile))
+		std::cerr << "(WW) Cannot sync the directory of " << mIndexFile << ". Keeping the hash cache log." << std::endl;
+	else if(RsDirUtil::fileExists(mLogFile))
+		RsDirUtil::removeFile(mLogFile) ;
+
+	mUpdates.clear() ;
+	mPendingLog.clear() ;
+
+#ifdef HASHCACHEINDEX_DEBUG
+	std::cerr << "Hash cache index compacted: " << count << " entries." << std::endl;
+#endif
+	return mapIndex() ;
+}
+
+void HashCacheIndex::clear()
+{
+	unmapIndex() ;
+	mUpdates.clear() ;
+	mPendingLog.clear() ;
+
+	if(RsDirUtil::fileExists(mLogFile))
+		RsDirUtil::removeFile(mLogFile) ;
+	writeEmptyIndex() ;
+	mapIndex() ;
+}
@@ -0,0 +1,142 @@
+/*******************************************************************************
+ * libretroshare/src/file_sharing: hash_cache_index.h                          *
+ *                                                                             *
+ * libretroshare: retroshare core library                                      *
+ *                                                                             *
+ * Copyright (C) 2026  RetroShare Team <contact@retroshare.cc>                 *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Lesser General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ ******************************************************************************/
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#include "retroshare/rstypes.h"
+
+/*!
+ * \brief The HashCacheIndex class
+ * 		On disk storage of the hash cache, made of fixed width records sorted by path key. The index file is mapped
+ * 		in memory and binary searched on demand, so that nothing but the header is read at startup.
+ *
+ * 		Paths are never written on disk: each path is interned as a SHA1 digest keyed with a secret, and the rest of
+ * 		the record is encrypted with chacha20, using the same secret and a per-record nonce. The secret itself is
+ * 		stored encrypted with the node key, like the former hash cache file.
+ *
+ * 		New and updated entries are kept in memory and appended to a log file, which is replayed at startup. Once
+ * 		the log gets too large, it is merged with the index into a new index file (see compact()).
+ *
+ * 		This class is not thread safe. HashStorage calls it under its own mutex.
+ */
+class HashCacheIndex
+{
+public:
+	typedef Sha1CheckSum PathKey ;
+
+	struct Entry
+	{
+		uint64_t size ;
+		uint32_t time_stamp ;		// last time the hash was tested/requested
+		uint32_t modf_stamp ;
+		RsFileHash hash ;
+	};
+
+	/*!
+	 * \param base_name  path of the cache files without extension. The index, log and key files are created next to it.
+	 */
+	explicit HashCacheIndex(const std::string& base_name) ;
+	virtual ~HashCacheIndex() ;
+
+	/*!
+	 * \brief load
+	 * 		Maps the index and replays the log. Creates a new secret and empty files if the cache does not exist yet.
+	 * \return false if there was no usable cache on disk, meaning that it should be imported from somewhere else.
+	 */
+	bool load() ;
+
+	/*!
+	 * \brief save
+	 * 		Appends the pending updates to the log, and compacts the cache if the log is too large.
+	 */
+	bool save() ;
+
+	/*!
+	 * \brief compact
+	 * 		Writes a new index made of the current index merged with all updates, and empties the log.
+	 * \param min_time_stamp entries with a time stamp below this value are dropped.
+	 */
+	bool compact(uint32_t min_time_stamp = 0) ;
+
+	PathKey pathKey(const std::string& path) const ;
+
+	bool find(const PathKey& key,Entry& entry) const ;
+	void update(const PathKey& key,const Entry& entry) ;
+
+	/*!
+	 * \brief touch
+	 * 		Updates the time stamp of an existing entry. Entries of the index are updated in place.
+	 */
+	void touch(const PathKey& key,uint32_t time_stamp) ;
+
+	void clear() ;
+	bool empty() const { return mRecordCount == 0 && mUpdates.empty() ; }
+	uint64_t size() const ;		// approximate, entries both in the index and in the updates are counted twice
+
+	static const uint32_t RECORD_SIZE ;
+
+protected:
+	// Storage of the secret. It is encrypted with the node key, which tests may not have.
+
+	virtual bool loadSecret() ;
+	virtual bool saveSecret() ;
+
+	std::string mKeyFile ;
+	uint8_t mSecret[32] ;
+
+private:
+	typedef std::vector<uint8_t> Record ;	// encrypted record, RECORD_SIZE bytes
+
+	void encodeRecord(const PathKey& key,const Entry& entry,uint8_t *record) const ;
+	bool decodeRecord(const uint8_t *record,Entry& entry) const ;
+
+	const uint8_t *indexRecord(uint64_t i) const { return mData + INDEX_HEADER_SIZE + i*RECORD_SIZE ; }
+	bool findInIndex(const PathKey& key,uint64_t& index) const ;
+
+	bool mapIndex() ;
+	void unmapIndex() ;
+	bool replayLog() ;
+	bool writeEmptyIndex() ;
+
+	static const uint32_t INDEX_HEADER_SIZE ;
+
+	std::string mIndexFile ;
+	std::string mLogFile ;
+
+	bool mHasSecret ;
+
+	// mapped index. On systems without mmap the index is read in memory instead.
+
+	uint8_t *mData ;
+	uint64_t mDataSize ;
+	uint64_t mRecordCount ;
+	bool mIndexModifiedInMemory ;	// in place updates that are not written back by the system
+
+	// updates since the index was written, by path key. Also stored in the log.
+
+	std::map<PathKey,Record> mUpdates ;
+	std::vector<uint8_t> mPendingLog ;	// records not written in the log yet
+};
@@ -147,9 +147,9 @@ p3FileDatabase::~p3FileDatabase()
 
     mRemoteDirectories.clear(); // just a precaution, not to leave deleted pointers around.
 
+    delete mHashCache ;	// first, since the hashing threads call the dir watcher and the shared dirs
     delete mLocalSharedDirs ;
     delete mLocalDirWatcher ;
-    delete mHashCache ;
 }
 
 const std::string FILE_DB_APP_NAME = "file_database";
@@ -274,6 +274,7 @@ void p3FileDatabase::stopThreads()
     P3FILELISTS_DEBUG() << "Stopping hash cache thread..." ; std::cerr.flush() ;
 #endif
     mHashCache->fullstop();
+    mHashCache->stopHashingThreads();
 #ifdef DEBUG_P3FILELISTS
     P3FILELISTS_DEBUG() << "Done." << std::endl;
     P3FILELISTS_DEBUG() << "Stopping directory watcher thread..." ; std::cerr.flush() ;
@@ -341,6 +342,28 @@ cleanup = true;
         rskv->tlvkvs.pairs.push_back(kv);
     }
 
+    {
+        std::string s ;
+        rs_sprintf(s, "%u", mHashCache->hashingThreads()) ;
+
+        RsTlvKeyValue kv;
+
+        kv.key = HASHING_THREADS_SS;
+        kv.value = s ;
+
+        rskv->tlvkvs.pairs.push_back(kv);
+    }
+    {
+        std::string s ;
+        rs_sprintf(s, "%u", mHashCache->maxHashingSpeed()) ;
+
+        RsTlvKeyValue kv;
+
+        kv.key = MAX_HASHING_SPEED_SS;
+        kv.value = s ;
+
+        rskv->tlvkvs.pairs.push_back(kv);
+    }
     {
         std::string s ;
         rs_sprintf(s, "%d", watchPeriod()) ;
@@ -473,6 +496,18 @@ bool p3FileDatabase::loadList(std::list<RsItem *>& load)
                 if(sscanf(kit->value.c_str(),"%u",&t) == 1)
                     mHashCache->setRememberHashFilesDuration(t);
             }
+            else if(kit->key == HASHING_THREADS_SS)
+            {
+                uint32_t t=0 ;
+                if(sscanf(kit->value.c_str(),"%u",&t) == 1)
+                    mHashCache->setHashingThreads(t);
+            }
+            else if(kit->key == MAX_HASHING_SPEED_SS)
+            {
+                uint32_t t=0 ;
+                if(sscanf(kit->value.c_str(),"%u",&t) == 1)
+                    mHashCache->setMaxHashingSpeed(t);
+            }
             else if(kit->key == WATCH_FILE_DURATION_SS)
             {
                 int t=0 ;
@@ -1259,6 +1294,24 @@ bool p3FileDatabase::hashingProcessPaused()
     RS_STACK_MUTEX(mFLSMtx) ;
     return  mLocalDirWatcher->hashingProcessPaused();
 }
+void p3FileDatabase::setHashingThreads(uint32_t n)
+{
+    mHashCache->setHashingThreads(n) ;
+    IndicateConfigChanged(RsConfigMgr::CheckPriority::SAVE_OFTEN);
+}
+uint32_t p3FileDatabase::hashingThreads()
+{
+    return mHashCache->hashingThreads() ;
+}
+void p3FileDatabase::setMaxHashingSpeed(uint32_t mb_per_sec)
+{
+    mHashCache->setMaxHashingSpeed(mb_per_sec) ;
+    IndicateConfigChanged(RsConfigMgr::CheckPriority::SAVE_OFTEN);
+}
+uint32_t p3FileDatabase::maxHashingSpeed()
+{
+    return mHashCache->maxHashingSpeed() ;
+}
 bool p3FileDatabase::inDirectoryCheck()
 {
     RS_STACK_MUTEX(mFLSMtx) ;
@@ -1492,6 +1545,20 @@ bool p3FileDatabase::search(
     return false;
 }
 
+void p3FileDatabase::getLocalFileHashes(std::vector<RsFileHash>& hashes) const
+{
+	RS_STACK_MUTEX(mFLSMtx);
+
+	mExtraFiles->getFileHashes(hashes);
+	mLocalSharedDirs->getFileHashes(hashes);
+}
+
+uint32_t p3FileDatabase::localHashesGeneration() const
+{
+	RS_STACK_MUTEX(mFLSMtx);
+	return mLocalSharedDirs->hashesGeneration();
+}
+
 int p3FileDatabase::filterResults(
         const std::list<void*>& firesults, std::list<DirDetails>& results,
         FileSearchFlags flags, const RsPeerId& peer_id ) const
@@ -2079,6 +2146,7 @@ bool p3FileDatabase::banFile(const RsFileHash& real_file_hash, const std::string
 #ifdef DEBUG_CONTENT_FILTERING
     P3FILELISTS_DEBUG() << "  setting file \"" << filename << "\" size=" << file_size << " hash=" << real_file_hash << " as banned." << std::endl;
 #endif
+    RsFileListsBannedHashesConfigItem item ;	// journal record holding the single entry
 	{
 		RS_STACK_MUTEX(mFLSMtx) ;
 		BannedFileEntry& entry(mPrimaryBanList[real_file_hash]) ;	// primary list (user controlled) of files banned from FT search and forwarding. map<real hash, BannedFileEntry>
@@ -2098,9 +2166,10 @@ bool p3FileDatabase::banFile(const RsFileHash& real_file_hash, const std::string
 			mLastPrimaryBanListChangeTimeStamp = time(NULL);
             mBannedFileListNeedsUpdate = true ;
 		}
+		item.primary_banned_files_list[real_file_hash] = entry ;
 	}
 
-    IndicateConfigChanged(RsConfigMgr::CheckPriority::SAVE_NOW);
+    journalAddItem(&item, RsConfigMgr::CheckPriority::SAVE_NOW);
 	return true;
 }
 bool p3FileDatabase::unbanFile(const RsFileHash& real_file_hash)
@@ -2115,10 +2184,37 @@ bool p3FileDatabase::unbanFile(const RsFileHash& real_file_hash)
         mBannedFileListNeedsUpdate = true ;
     }
 
-    IndicateConfigChanged(RsConfigMgr::CheckPriority::SAVE_NOW);
+    RsFileListsBannedHashesConfigItem item ;
+    item.primary_banned_files_list[real_file_hash] = BannedFileEntry() ;
+
+    journalRemoveItem(&item, RsConfigMgr::CheckPriority::SAVE_NOW);
     return true;
 }
 
+void p3FileDatabase::loadJournalItem(RsItem *item, bool removed)
+{
+    // Only ban list changes are journalled. Records hold the banned (resp. unbanned) entries, which are merged
+    // into the list loaded from the config file, rather than replacing it as loadList() does.
+
+    RsFileListsBannedHashesConfigItem *fb = dynamic_cast<RsFileListsBannedHashesConfigItem*>(item) ;
+
+    if(fb)
+    {
+		RS_STACK_MUTEX(mFLSMtx) ;
+
+        for(std::map<RsFileHash,BannedFileEntry>::const_iterator it(fb->primary_banned_files_list.begin());it!=fb->primary_banned_files_list.end();++it)
+            if(removed)
+                mPrimaryBanList.erase(it->first) ;
+            else
+                mPrimaryBanList[it->first] = it->second ;
+
+        mBannedFileListNeedsUpdate = true;
+        mLastPrimaryBanListChangeTimeStamp = time(NULL);
+    }
+
+    delete item ;
+}
+
 bool p3FileDatabase::isFileBanned(const RsFileHash& hash)
 {
 	RS_STACK_MUTEX(mFLSMtx) ;
@@ -121,6 +121,12 @@ class p3FileDatabase: public p3Service, public p3Config, public ftSearch //, pub
 
         // ftSearch
         virtual bool search(const RsFileHash &hash, FileSearchFlags hintflags, FileInfo &info) const;
+
+        // Appends all the hashes search() can find with RS_FILE_HINTS_LOCAL | RS_FILE_HINTS_EXTRA, including hashes of hashes.
+        void getLocalFileHashes(std::vector<RsFileHash>& hashes) const ;
+
+        // Changes when the shared files may have been hashed or removed, @see DirectoryStorage::hashesGeneration()
+        uint32_t localHashesGeneration() const ;
         virtual int  SearchKeywords(const std::list<std::string>& keywords, std::list<DirDetails>& results,FileSearchFlags flags,const RsPeerId& peer_id) ;
         virtual int  SearchBoolExp(RsRegularExpression::Expression *exp, std::list<DirDetails>& results,FileSearchFlags flags,const RsPeerId& peer_id) const ;
 
@@ -187,6 +193,10 @@ class p3FileDatabase: public p3Service, public p3Config, public ftSearch //, pub
 		bool inDirectoryCheck();
 		void togglePauseHashingProcess();
 		bool hashingProcessPaused();
+		void setHashingThreads(uint32_t n);
+		uint32_t hashingThreads();
+		void setMaxHashingSpeed(uint32_t mb_per_sec);
+		uint32_t maxHashingSpeed();
 
     protected:
 		void getExtraFilesDirDetails(void *ref,DirectoryStorage::EntryIndex e,DirDetails& d) const;
@@ -198,6 +208,7 @@ class p3FileDatabase: public p3Service, public p3Config, public ftSearch //, pub
         //
         virtual bool loadList(std::list<RsItem *>& items);
         virtual bool saveList(bool &cleanup, std::list<RsItem *>&);
+        virtual void loadJournalItem(RsItem *item, bool removed);
         virtual RsSerialiser *setupSerialiser() ;
 
         void cleanup();
@@ -514,3 +514,14 @@ void ftExtraList::getExtraFileList(std::vector<FileInfo>& files) const
     for(auto it(mFiles.begin());it!=mFiles.end();++it)
         files.push_back(it->second.info);
 }
+
+void ftExtraList::getFileHashes(std::vector<RsFileHash>& hashes) const
+{
+	RS_STACK_MUTEX(extMutex);
+
+    for(auto it(mFiles.begin());it!=mFiles.end();++it)
+        hashes.push_back(it->first);
+
+    for(auto it(mHashOfHash.begin());it!=mHashOfHash.end();++it)
+        hashes.push_back(it->first);
+}
@@ -151,6 +151,12 @@ public:
      */
     void getExtraFileList(std::vector<FileInfo>& files) const ;
 
+    /*!
+     * \brief getFileHashes
+     * 				Appends the hashes search() can find: the hashes of extra files, and the hashes of these hashes.
+     */
+    void getFileHashes(std::vector<RsFileHash>& hashes) const ;
+
 	void threadTick() override; /// @see RsTickingThread
 
 	/***
@@ -109,7 +109,7 @@ ftServer::ftServer(p3PeerMgr *pm, p3ServiceControl *sc):
       mPeerMgr(pm), mServiceCtrl(sc),
       mFileDatabase(NULL),
       mFtController(NULL), mFtExtra(NULL),
-      mFtDataplex(NULL), mFtSearch(NULL), srvMutex("ftServer"),
+      mFtDataplex(NULL), mTurtleRouter(NULL), mFtSearch(NULL), mLocalHashesGeneration(0), srvMutex("ftServer"),
       mSearchCallbacksMapMutex("ftServer callbacks map")
 {
 	addSerialType(new RsFileTransferSerialiser()) ;
@@ -412,6 +412,10 @@ bool ftServer::activateTunnels(const RsFileHash& hash,uint32_t encryption_policy
 
 	if(onoff)
 	{
+		// The file can now be swarmed, so tunnel requests for it should reach us.
+
+		mTurtleRouter->invalidateTunnelRequestFilter(this) ;
+
 #ifdef SERVER_DEBUG
 		FTSERVER_DEBUG() << "Activating tunnels for hash " << hash << std::endl;
 #endif
@@ -720,6 +724,33 @@ void ftServer::removeVirtualPeer(const TurtleFileHash& hash,const TurtleVirtualP
 	mEncryptedPeerIds.erase(virtual_peer_id) ;
 }
 
+bool ftServer::buildTunnelRequestFilter(RsBloomFilter& filter)
+{
+	// Same sources as handleTunnelRequest(): shared and extra files, and files being downloaded,
+	// each with the hash of its hash. tick() invalidates the filter when shared files are hashed or removed.
+
+	std::vector<RsFileHash> hashes ;
+	mFileDatabase->getLocalFileHashes(hashes) ;
+
+	std::list<RsFileHash> downloads ;
+	mFtController->FileDownloads(downloads) ;
+
+	RS_STACK_MUTEX(srvMutex) ;
+
+	filter.reset(hashes.size() + downloads.size() + mEncryptedHashes.size()) ;
+
+	for(uint32_t i=0;i<hashes.size();++i)
+		filter.insert(hashes[i]) ;
+
+	for(std::list<RsFileHash>::const_iterator it(downloads.begin());it!=downloads.end();++it)
+		filter.insert(*it) ;
+
+	for(std::map<RsFileHash,RsFileHash>::const_iterator it(mEncryptedHashes.begin());it!=mEncryptedHashes.end();++it)
+		filter.insert(it->first) ;
+
+	return true ;
+}
+
 bool ftServer::handleTunnelRequest(const RsFileHash& hash,const RsPeerId& peer_id)
 {
 	FileInfo info ;
@@ -815,7 +846,11 @@ bool ftServer::handleTunnelRequest(const RsFileHash& hash,const RsPeerId& peer_i
 
 bool  ftServer::ExtraFileAdd(std::string fname, const RsFileHash& hash, uint64_t size, uint32_t period, TransferRequestFlags flags)
 {
-	return mFtExtra->addExtraFile(fname, hash, size, period, flags);
+	if(!mFtExtra->addExtraFile(fname, hash, size, period, flags))
+		return false;
+
+	mTurtleRouter->invalidateTunnelRequestFilter(this);
+	return true;
 }
 
 bool ftServer::ExtraFileRemove(const RsFileHash& hash)
@@ -1021,6 +1056,10 @@ void ftServer::setMaxShareDepth(int depth)         { mFileDatabase->setMaxShareD
 
 void ftServer::togglePauseHashingProcess()  { mFileDatabase->togglePauseHashingProcess() ; }
 bool ftServer::hashingProcessPaused() { return mFileDatabase->hashingProcessPaused() ; }
+void ftServer::setHashingThreads(uint32_t n)          { mFileDatabase->setHashingThreads(n) ; }
+uint32_t ftServer::hashingThreads()                   { return mFileDatabase->hashingThreads() ; }
+void ftServer::setMaxHashingSpeed(uint32_t mb_per_sec) { mFileDatabase->setMaxHashingSpeed(mb_per_sec) ; }
+uint32_t ftServer::maxHashingSpeed()                  { return mFileDatabase->maxHashingSpeed() ; }
 
 bool ftServer::getShareDownloadDirectory()
 {
@@ -1794,6 +1833,19 @@ int	ftServer::tick()
 		cleanTimedOutSearches();
 	}
 
+	// Shared files hashed or removed since the last invalidation are missing from (resp. still in) the tunnel request filter.
+
+	if(mFileDatabase && mTurtleRouter)
+	{
+		uint32_t generation = mFileDatabase->localHashesGeneration() ;
+
+		if(generation != mLocalHashesGeneration)
+		{
+			mLocalHashesGeneration = generation ;
+			mTurtleRouter->invalidateTunnelRequestFilter(this) ;
+		}
+	}
+
 	return moreToTick;
 }
 
@@ -144,6 +144,7 @@ public:
 
     uint16_t serviceId() const { return RS_SERVICE_TYPE_FILE_TRANSFER ; }
     virtual bool handleTunnelRequest(const RsFileHash& hash,const RsPeerId& peer_id) ;
+    virtual bool buildTunnelRequestFilter(RsBloomFilter& filter) ;
     virtual void receiveTurtleData(const RsTurtleGenericTunnelItem *item,const RsFileHash& hash,const RsPeerId& virtual_peer_id,RsTurtleGenericTunnelItem::Direction direction) ;
 
 	/// We keep this for retro-compatibility @see RsTurtleClientService
@@ -334,6 +335,10 @@ public:
 	virtual void setFollowSymLinks(bool b);
 	virtual void togglePauseHashingProcess();
 	virtual bool hashingProcessPaused();
+	virtual void setHashingThreads(uint32_t n);
+	virtual uint32_t hashingThreads();
+	virtual void setMaxHashingSpeed(uint32_t mb_per_sec);
+	virtual uint32_t maxHashingSpeed();
 
 	virtual void setMaxShareDepth(int depth) ;
 	virtual int  maxShareDepth() const;
@@ -410,6 +415,8 @@ private:
     p3turtle         *mTurtleRouter ;
     ftFileSearch     *mFtSearch;
 
+    uint32_t mLocalHashesGeneration ;	// of the shared files when the tunnel request filter was last invalidated
+
     RsMutex srvMutex;
     std::string mConfigPath;
     std::string mDownloadPath;
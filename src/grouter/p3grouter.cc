@@ -336,6 +336,9 @@ bool p3GRouter::registerKey(const RsGxsId& authentication_key,const GRouterServi
 
     Sha1CheckSum hash = makeTunnelHash(authentication_key,client_id) ;
 
+    if(_owned_key_ids.find(hash) == _owned_key_ids.end() && mTurtle != nullptr)
+        mTurtle->invalidateTunnelRequestFilter(this) ;
+
     _owned_key_ids[hash] = info ;
 #ifdef GROUTER_DEBUG
     grouter_debug() << "Registered the following key: " << std::endl;
@@ -445,6 +448,18 @@ bool p3GRouter::handleTunnelRequest(const RsFileHash& hash,const RsPeerId& /*pee
     return true ;
 }
 
+bool p3GRouter::buildTunnelRequestFilter(RsBloomFilter& filter)
+{
+    RS_STACK_MUTEX(grMtx) ;
+
+    filter.reset(_owned_key_ids.size()) ;
+
+    for(std::map<Sha1CheckSum,GRouterPublishedKeyInfo>::const_iterator it(_owned_key_ids.begin());it!=_owned_key_ids.end();++it)
+        filter.insert(it->first) ;
+
+    return true ;
+}
+
 void p3GRouter::handleLowLevelTransactionChunkItem(RsGRouterTransactionChunkItem *chunk_item)
 {
 #ifdef GROUTER_DEBUG
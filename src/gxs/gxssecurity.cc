@@ -20,10 +20,14 @@
  * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
  *                                                                             *
  *******************************************************************************/
+#include <list>
+#include <map>
+
 #include "gxssecurity.h"
 #include "pqi/authgpg.h"
 #include "util/rsdir.h"
 #include "util/rsmemory.h"
+#include "util/rsthreads.h"
 //#include "retroshare/rspeers.h"
 
 /****
@@ -117,6 +121,130 @@ static RSA *extractPublicKey(const RsTlvPublicRSAKey& key)
 
         return rsakey;
 }
+/*!
+ * Parsed keys used for signature validation. During a sync the same few author
+ * and publish keys are used to check thousands of messages, and decoding the
+ * key costs about as much as checking the signature itself. Entries are keyed
+ * by key id and type, and the raw key data is compared on every hit so that a
+ * different key sent with the same id is never validated with the cached one.
+ */
+class GxsSecurityKeyCache
+{
+public:
+	GxsSecurityKeyCache() : mKeyCacheMtx("GxsSecurityKeyCache"), mHits(0), mMisses(0) {}
+
+	/*!
+	 * @return a new reference on the parsed key, to be released with
+	 * EVP_PKEY_free(), or NULL if the key data is invalid
+	 */
+	EVP_PKEY *getKey(const RsTlvPublicRSAKey& key)
+	{
+		const bool full = key.keyFlags & RSTLV_KEY_TYPE_FULL ;
+		const std::string data((const char*)key.keyData.bin_data, key.keyData.bin_len) ;
+		const CacheKey ckey(key.keyId, full) ;
+
+		{
+			RS_STACK_MUTEX(mKeyCacheMtx) ;
+
+			std::map<CacheKey,Entry>::iterator it = mKeys.find(ckey) ;
+
+			if(it != mKeys.end() && it->second.keyData == data)
+			{
+				++mHits ;
+				mLru.splice(mLru.begin(), mLru, it->second.lru) ;
+				upRef(it->second.pkey) ;
+				return it->second.pkey ;
+			}
+			++mMisses ;
+		}
+
+		// parse out of the lock, that's the expensive part
+
+		const unsigned char *keyptr = (const unsigned char *) key.keyData.bin_data;
+		long keylen = key.keyData.bin_len;
+
+		RSA *rsakey = full ? d2i_RSAPrivateKey(NULL, &keyptr, keylen) : d2i_RSAPublicKey(NULL, &keyptr, keylen) ;
+
+		if(!rsakey)
+			return NULL ;
+
+		EVP_PKEY *pkey = EVP_PKEY_new();
+		EVP_PKEY_assign_RSA(pkey, rsakey);
+
+		RS_STACK_MUTEX(mKeyCacheMtx) ;
+
+		std::map<CacheKey,Entry>::iterator it = mKeys.find(ckey) ;
+
+		if(it != mKeys.end())	// stale key for this id, or added by another thread in the meantime
+		{
+			EVP_PKEY_free(it->second.pkey) ;
+			mLru.erase(it->second.lru) ;
+			mKeys.erase(it) ;
+		}
+		else if(mKeys.size() >= KEY_CACHE_SIZE)
+		{
+			std::map<CacheKey,Entry>::iterator oit = mKeys.find(mLru.back()) ;
+
+			EVP_PKEY_free(oit->second.pkey) ;
+			mKeys.erase(oit) ;
+			mLru.pop_back() ;
+		}
+
+		mLru.push_front(ckey) ;
+
+		Entry& e(mKeys[ckey]) ;
+		e.keyData = data ;
+		e.pkey = pkey ;
+		e.lru = mLru.begin() ;
+
+		upRef(pkey) ;	// one reference for the cache, one for the caller
+		return pkey ;
+	}
+
+	void getStatistics(uint64_t& hits, uint64_t& misses, uint32_t& size)
+	{
+		RS_STACK_MUTEX(mKeyCacheMtx) ;
+
+		hits = mHits ;
+		misses = mMisses ;
+		size = mKeys.size() ;
+	}
+
+private:
+	static void upRef(EVP_PKEY *pkey)
+	{
+#if OPENSSL_VERSION_NUMBER < 0x10100000L || defined(LIBRESSL_VERSION_NUMBER)
+		CRYPTO_add(&pkey->references, 1, CRYPTO_LOCK_EVP_PKEY) ;
+#else
+		EVP_PKEY_up_ref(pkey) ;
+#endif
+	}
+
+	typedef std::pair<RsGxsId,bool> CacheKey ;	// key id, full key
+
+	struct Entry
+	{
+		std::string keyData ;
+		EVP_PKEY *pkey ;
+		std::list<CacheKey>::iterator lru ;
+	};
+
+	static const uint32_t KEY_CACHE_SIZE = 2048 ;
+
+	RsMutex mKeyCacheMtx ;
+	std::map<CacheKey,Entry> mKeys ;
+	std::list<CacheKey> mLru ;	// most recently used first
+	uint64_t mHits ;
+	uint64_t mMisses ;
+};
+
+// Never deleted: keys must not be freed after OpenSSL has been cleaned up at exit.
+static GxsSecurityKeyCache& keyCache()
+{
+	static GxsSecurityKeyCache *cache = new GxsSecurityKeyCache ;
+	return *cache ;
+}
+
 static void setRSAPublicKeyData(RsTlvPublicRSAKey& key, RSA *rsa_pub)
 {
     assert(!(key.keyFlags & RSTLV_KEY_TYPE_FULL)) ;
@@ -375,16 +503,14 @@ bool GxsSecurity::validateSignature(const char *data, uint32_t data_len, const R
 {
     assert(!(key.keyFlags & RSTLV_KEY_TYPE_FULL)) ;
         
-	RSA *rsakey = ::extractPublicKey(key) ;
+	EVP_PKEY *signKey = keyCache().getKey(key) ;
 
-	if(!rsakey)
+	if(!signKey)
 	{
 		std::cerr << "GxsSecurity::validateSignature(): Cannot validate signature. Keydata is incomplete." << std::endl;
 		key.print(std::cerr,0) ;
 		return false ;
 	}
-	EVP_PKEY *signKey = EVP_PKEY_new();
-	EVP_PKEY_assign_RSA(signKey, rsakey);
 
 	/* calc and check signature */
 	EVP_MD_CTX *mdctx = EVP_MD_CTX_create();
@@ -436,22 +562,20 @@ bool GxsSecurity::validateNxsMsg(const RsNxsMsg& msg, const RsTlvKeySignature& s
 			}
 
             /* decode key */
-            const unsigned char *keyptr = (const unsigned char *) key.keyData.bin_data;
-            long keylen = key.keyData.bin_len;
             unsigned int siglen = sign.signData.bin_len;
             unsigned char *sigbuf = (unsigned char *) sign.signData.bin_data;
 
     #ifdef DISTRIB_DEBUG
             std::cerr << "GxsSecurity::validateNxsMsg() Decode Key";
-            std::cerr << " keylen: " << keylen << " siglen: " << siglen;
+            std::cerr << " keylen: " << key.keyData.bin_len << " siglen: " << siglen;
             std::cerr << std::endl;
     #endif
 
             /* extract admin key */
 
-            RSA *rsakey = (key.keyFlags & RSTLV_KEY_TYPE_FULL)?  (d2i_RSAPrivateKey(NULL, &(keyptr), keylen)) : (d2i_RSAPublicKey(NULL, &(keyptr), keylen));
+            EVP_PKEY *signKey = keyCache().getKey(key) ;
 
-            if (!rsakey)
+            if (!signKey)
             {
     #ifdef GXS_SECURITY_DEBUG
                     std::cerr << "GxsSecurity::validateNxsMsg()";
@@ -460,6 +584,7 @@ bool GxsSecurity::validateNxsMsg(const RsNxsMsg& msg, const RsTlvKeySignature& s
 
                     key.print(std::cerr, 10);
     #endif
+                    return false;
             }
 
 
@@ -476,8 +601,6 @@ bool GxsSecurity::validateNxsMsg(const RsNxsMsg& msg, const RsTlvKeySignature& s
 	    int signOk = 0 ;
 
 	{
-		EVP_PKEY *signKey = EVP_PKEY_new();
-		EVP_PKEY_assign_RSA(signKey, rsakey);
 		EVP_MD_CTX *mdctx = EVP_MD_CTX_create();
 
 		uint32_t metaDataLen = msgMeta.serial_size();
@@ -487,7 +610,11 @@ bool GxsSecurity::validateNxsMsg(const RsNxsMsg& msg, const RsTlvKeySignature& s
 		RsTemporaryMemory allMsgData(allMsgDataLen) ;
 
 		if(!metaData || !allMsgData)
+		{
+			EVP_PKEY_free(signKey);
+			EVP_MD_CTX_destroy(mdctx);
 			return false ;
+		}
 		
 		msgMeta.serialise(metaData, &metaDataLen);
 
@@ -1082,21 +1209,19 @@ bool GxsSecurity::validateNxsGrp(const RsNxsGrp& grp, const RsTlvKeySignature& s
     }
 
 	/* decode key */
-	const unsigned char *keyptr = (const unsigned char *) key.keyData.bin_data;
-	long keylen = key.keyData.bin_len;
 	unsigned int siglen = sign.signData.bin_len;
 	unsigned char *sigbuf = (unsigned char *) sign.signData.bin_data;
 
 #ifdef DISTRIB_DEBUG
 	std::cerr << "GxsSecurity::validateNxsMsg() Decode Key";
-	std::cerr << " keylen: " << keylen << " siglen: " << siglen;
+	std::cerr << " keylen: " << key.keyData.bin_len << " siglen: " << siglen;
 	std::cerr << std::endl;
 #endif
 
 	/* extract admin key */
-	RSA *rsakey = d2i_RSAPublicKey(NULL, &(keyptr), keylen);
+	EVP_PKEY *signKey = keyCache().getKey(key);
 
-	if (!rsakey)
+	if (!signKey)
 	{
 #ifdef GXS_SECURITY_DEBUG
 		std::cerr << "GxsSecurity::validateNxsGrp()";
@@ -1105,6 +1230,7 @@ bool GxsSecurity::validateNxsGrp(const RsNxsGrp& grp, const RsTlvKeySignature& s
 
 		key.print(std::cerr, 10);
 #endif
+		return false;
 	}
 
 	std::vector<uint32_t> api_versions_to_check ;
@@ -1115,8 +1241,6 @@ bool GxsSecurity::validateNxsGrp(const RsNxsGrp& grp, const RsTlvKeySignature& s
 	grpMeta.signSet.TlvClear();
     
 	int signOk =0;
-	EVP_PKEY *signKey = EVP_PKEY_new();
-	EVP_PKEY_assign_RSA(signKey, rsakey);
 
 
 	for(uint32_t i=0;i<api_versions_to_check.size() && 0==signOk;++i)
@@ -1171,6 +1295,11 @@ bool GxsSecurity::validateNxsGrp(const RsNxsGrp& grp, const RsTlvKeySignature& s
 	return false;
 }
 
+void GxsSecurity::getKeyCacheStatistics(uint64_t& hits, uint64_t& misses, uint32_t& size)
+{
+	keyCache().getStatistics(hits, misses, size) ;
+}
+
 void GxsSecurity::createPublicKeysFromPrivateKeys(RsTlvSecurityKeySet& keyset)
 {
     for( std::map<RsGxsId, RsTlvPrivateRSAKey>::const_iterator it = keyset.private_keys.begin(); it != keyset.private_keys.end() ; ++it)
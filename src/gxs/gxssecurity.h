@@ -124,6 +124,15 @@ class GxsSecurity
         static bool checkPublicKey(const RsTlvPublicRSAKey &key);
         static bool checkPrivateKey(const RsTlvPrivateRSAKey &key);
 	static bool checkFingerprint(const RsTlvPublicRSAKey& key);	// helper function to only check the fingerprint
+
+        /*!
+         * Keys used to validate signatures are parsed once and kept in a
+         * bounded cache shared by all GXS services.
+         * @param hits number of validations which found the parsed key in the cache
+         * @param misses number of validations which had to parse the key
+         * @param size number of keys currently in the cache
+         */
+        static void getKeyCacheStatistics(uint64_t& hits, uint64_t& misses, uint32_t& size) ;
         
         /*!
          * Adds possibly missing public keys when private keys are present.
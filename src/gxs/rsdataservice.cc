@@ -45,6 +45,10 @@
 #define GRP_LAST_POST_UPDATE_TRIGGER std::string("LAST_POST_UPDATE")
 
 #define MSG_INDEX_GRPID std::string("INDEX_MESSAGES_GRPID")
+#define MSG_INDEX_THREADID std::string("INDEX_MESSAGES_THREADID")
+#define MSG_INDEX_PARENTID std::string("INDEX_MESSAGES_PARENTID")
+#define MSG_INDEX_ORIGMSGID std::string("INDEX_MESSAGES_ORIGMSGID")
+#define MSG_INDEX_TIME_STAMP std::string("INDEX_MESSAGES_TIME_STAMP")
 
 // generic
 #define KEY_NXS_DATA        std::string("nxsData")
@@ -110,6 +114,10 @@ const std::string RsGeneralDataService::MSG_META_STATUS = KEY_MSG_STATUS;
 
 const uint32_t RsGeneralDataService::GXS_MAX_ITEM_SIZE = 1572864; // 1.5 Mbytes
 
+// Memory budget of the meta caches of each data store. About 50k msg metas
+// fit in it, which is more than most groups hold.
+static const uint32_t DEFAULT_META_CACHE_SIZE = 32*1024*1024;
+
 static int addColumn(std::list<std::string> &list, const std::string &attribute)
 {
     list.push_back(attribute);
@@ -118,7 +126,8 @@ static int addColumn(std::list<std::string> &list, const std::string &attribute)
 
 RsDataService::RsDataService(const std::string &serviceDir, const std::string &dbName, uint16_t serviceType,
                              RsGxsSearchModule * /* mod */, const std::string& key)
-    : RsGeneralDataService(), mDbMutex("RsDataService"), mServiceDir(serviceDir), mDbName(dbName), mDbPath(mServiceDir + "/" + dbName), mServType(serviceType), mDb(NULL)
+    : RsGeneralDataService(), mDbMutex("RsDataService"), mServiceDir(serviceDir), mDbName(dbName), mDbPath(mServiceDir + "/" + dbName), mServType(serviceType), mDb(NULL),
+      mCacheSize(DEFAULT_META_CACHE_SIZE), mCacheAccessCount(0), mCacheHits(0), mCacheMisses(0), mCacheEvictions(0)
 {
     bool isNewDatabase = !RsDirUtil::fileExists(mDbPath);
 
@@ -288,9 +297,58 @@ static bool moveDataFromFileToDatabase(RetroDb *db, const std::string serviceDir
     return ok;
 }
 
+// Indexes used by the filtered retrieval of msg metas. They all start with the
+// group id, since every query is restricted to a group.
+static bool createMsgMetaIndexes(RetroDb *db)
+{
+    bool ok = true;
+
+    ok = ok && db->execSQL("CREATE INDEX IF NOT EXISTS " + MSG_INDEX_THREADID + " ON " + MSG_TABLE_NAME + "(" + KEY_GRP_ID + "," + KEY_MSG_THREAD_ID + ");");
+    ok = ok && db->execSQL("CREATE INDEX IF NOT EXISTS " + MSG_INDEX_PARENTID + " ON " + MSG_TABLE_NAME + "(" + KEY_GRP_ID + "," + KEY_MSG_PARENT_ID + ");");
+    ok = ok && db->execSQL("CREATE INDEX IF NOT EXISTS " + MSG_INDEX_ORIGMSGID + " ON " + MSG_TABLE_NAME + "(" + KEY_GRP_ID + "," + KEY_ORIG_MSG_ID + ");");
+    ok = ok && db->execSQL("CREATE INDEX IF NOT EXISTS " + MSG_INDEX_TIME_STAMP + " ON " + MSG_TABLE_NAME + "(" + KEY_GRP_ID + "," + KEY_TIME_STAMP + ");");
+
+    return ok;
+}
+
+// SQL condition selecting the msgs of a group matching the filter. Ids are
+// hex strings and masks are integers, so nothing needs escaping.
+static std::string msgMetaFilterSelection(const RsGxsGroupId& grpId, const RsGxsMsgMetaFilter& filter)
+{
+    std::string sel = KEY_GRP_ID + "='" + grpId.toStdString() + "'";
+
+    if(!filter.mThreadId.isNull())
+        sel += " AND " + KEY_MSG_THREAD_ID + "='" + filter.mThreadId.toStdString() + "'";
+
+    if(!filter.mParentId.isNull())
+        sel += " AND " + KEY_MSG_PARENT_ID + "='" + filter.mParentId.toStdString() + "'";
+    else if(filter.mOnlyThreadHeads)
+        sel += " AND " + KEY_MSG_PARENT_ID + " IN ('','" + RsGxsMessageId().toStdString() + "')";
+
+    if(!filter.mOrigMsgId.isNull())
+        sel += " AND " + KEY_ORIG_MSG_ID + "='" + filter.mOrigMsgId.toStdString() + "'";
+
+    // Status and flags are stored as signed 32 bits integers
+    if(filter.mStatusMask)
+        sel += " AND (" + KEY_MSG_STATUS + " & " + std::to_string((int32_t)filter.mStatusMask) + ")="
+                + std::to_string((int32_t)(filter.mStatusFilter & filter.mStatusMask));
+
+    if(filter.mMsgFlagMask)
+        sel += " AND (" + KEY_NXS_FLAGS + " & " + std::to_string((int32_t)filter.mMsgFlagMask) + ")="
+                + std::to_string((int32_t)(filter.mMsgFlagFilter & filter.mMsgFlagMask));
+
+    if(filter.mPublishedAfter)
+        sel += " AND " + KEY_TIME_STAMP + ">=" + std::to_string((int32_t)filter.mPublishedAfter);
+
+    if(filter.mPublishedBefore)
+        sel += " AND " + KEY_TIME_STAMP + "<=" + std::to_string((int32_t)filter.mPublishedBefore);
+
+    return sel;
+}
+
 void RsDataService::initialise(bool isNewDatabase)
 {
-    const int databaseRelease = 1;
+    const int databaseRelease = 2;
     int currentDatabaseRelease = 0;
     bool ok = true;
 
@@ -365,6 +423,7 @@ void RsDataService::initialise(bool isNewDatabase)
                 + std::string("END;"));
 
         mDb->execSQL("CREATE INDEX " + MSG_INDEX_GRPID + " ON " + MSG_TABLE_NAME + "(" + KEY_GRP_ID +  ");");
+        createMsgMetaIndexes(mDb);
 
         // Insert release, no need to upgrade
         ContentValue cv;
@@ -440,6 +499,19 @@ void RsDataService::initialise(bool isNewDatabase)
                 currentDatabaseRelease = newRelease;
             }
         }
+
+        // Release 2
+        newRelease = 2;
+        if (ok && currentDatabaseRelease < newRelease) {
+            // Index the columns msg metas are filtered on
+            ok = startReleaseUpdate(newRelease);
+            ok = ok && createMsgMetaIndexes(mDb);
+
+            ok = finishReleaseUpdate(newRelease, ok);
+            if (ok) {
+                currentDatabaseRelease = newRelease;
+            }
+        }
     }
 
     if (ok) {
@@ -506,13 +578,13 @@ std::shared_ptr<RsGxsGrpMetaData> RsDataService::locked_getGrpMeta(RetroCursor&
     if(grpId.isNull())			// not in the DB!
         return nullptr;
 
-    if(mUseCache)
-        grpMeta = mGrpMetaDataCache.getOrCreateMeta(grpId);
-	else
-        grpMeta = std::make_shared<RsGxsGrpMetaData>();
-
-    if(!grpMeta->mGroupId.isNull())	// the grpMeta is already initialized because it comes from the cache
+    if(mUseCache && (grpMeta = mGrpMetaDataCache.getMeta(grpId)))	// the grpMeta is already initialized because it comes from the cache
+    {
+        ++mCacheHits;
         return grpMeta;
+    }
+
+    grpMeta = std::make_shared<RsGxsGrpMetaData>();
 
     grpMeta->mGroupId = RsGxsGroupId(tempId);
     c.getString(mColGrpMeta_NxsIdentity + colOffset, tempId);
@@ -594,10 +666,16 @@ std::shared_ptr<RsGxsGrpMetaData> RsDataService::locked_getGrpMeta(RetroCursor&
 		grpMeta->mSubscribeFlags &= ~GXS_SERV::GROUP_SUBSCRIBE_PUBLISH;
 	}
 
-    if(ok)
-        return grpMeta;
-    else
+    if(!ok)
 		return NULL;
+
+    if(mUseCache)
+    {
+        mGrpMetaDataCache.updateMeta(grpId, grpMeta);
+        ++mCacheMisses;
+    }
+
+    return grpMeta;
 }
 
 RsNxsGrp* RsDataService::locked_getGroup(RetroCursor &c)
@@ -665,13 +743,13 @@ std::shared_ptr<RsGxsMsgMetaData> RsDataService::locked_getMsgMeta(RetroCursor &
 
     std::shared_ptr<RsGxsMsgMetaData> msgMeta;
 
-    if(mUseCache)
-        msgMeta = mMsgMetaDataCache[group_id].getOrCreateMeta(msg_id);
-	else
-        msgMeta = std::make_shared<RsGxsMsgMetaData>();
-
-    if(!msgMeta->mGroupId.isNull())	// we cannot do that because the cursor needs to advance. Is there a method to skip some data in the db?
+    if(mUseCache && (msgMeta = locked_msgMetaCache(group_id).getMeta(msg_id)))	// we cannot do that because the cursor needs to advance. Is there a method to skip some data in the db?
+    {
+        ++mCacheHits;
         return msgMeta;
+    }
+
+    msgMeta = std::make_shared<RsGxsMsgMetaData>();
 
 	msgMeta->mGroupId = group_id;
 	msgMeta->mMsgId = msg_id;
@@ -706,10 +784,16 @@ std::shared_ptr<RsGxsMsgMetaData> RsDataService::locked_getMsgMeta(RetroCursor &
     msgMeta->mMsgStatus = c.getInt32(mColMsgMeta_MsgStatus + colOffset);
     msgMeta->mChildTs = c.getInt32(mColMsgMeta_ChildTs + colOffset);
 
-    if(ok)
-        return msgMeta;
+    if(!ok)
+        return nullptr;
 
-    return nullptr;
+    if(mUseCache)
+    {
+        locked_msgMetaCache(group_id).updateMeta(msg_id, msgMeta);
+        ++mCacheMisses;
+    }
+
+    return msgMeta;
 }
 
 
@@ -761,6 +845,9 @@ int RsDataService::storeMessage(const std::list<RsNxsMsg*>& msg)
     // start a transaction
     mDb->beginTransaction();
 
+    // rows are inserted all at once, so the insert statement is prepared once
+    std::list<ContentValue> cvs;
+
     for(std::list<RsNxsMsg*>::const_iterator mit = msg.begin(); mit != msg.end(); ++mit)
     {
         RsNxsMsg* msgPtr = *mit;
@@ -783,7 +870,8 @@ int RsDataService::storeMessage(const std::list<RsNxsMsg*>& msg)
             continue;
         }
 
-        ContentValue cv;
+        cvs.push_back(ContentValue());
+        ContentValue& cv = cvs.back();
 
         uint32_t dataLen = msgPtr->msg.TlvSize();
         char msgData[dataLen];
@@ -823,27 +911,25 @@ int RsDataService::storeMessage(const std::list<RsNxsMsg*>& msg)
         cv.put(KEY_MSG_STATUS, (int32_t)msgMetaPtr->mMsgStatus);
         cv.put(KEY_CHILD_TS, (int32_t)msgMetaPtr->mChildTs);
 
-        if (!mDb->sqlInsert(MSG_TABLE_NAME, "", cv))
-        {
-            std::cerr << "RsDataService::storeMessage() sqlInsert Failed";
-            std::cerr << std::endl;
-            std::cerr << "\t For GroupId: " << msgMetaPtr->mGroupId.toStdString();
-            std::cerr << std::endl;
-            std::cerr << "\t & MessageId: " << msgMetaPtr->mMsgId.toStdString();
-            std::cerr << std::endl;
-        }
-
         // This is needed so that mLastPost is correctly updated in the group meta when it is re-loaded.
 
         if(mUseCache)
-                mMsgMetaDataCache[msgMetaPtr->mGroupId].updateMeta(msgMetaPtr->mMsgId,*msgMetaPtr);
+                locked_msgMetaCache(msgMetaPtr->mGroupId).updateMeta(msgMetaPtr->mMsgId,*msgMetaPtr);
 
         delete *mit;
     }
 
+    if (!mDb->sqlInsertBulk(MSG_TABLE_NAME, "", cvs))
+    {
+        std::cerr << "RsDataService::storeMessage() sqlInsertBulk Failed for some messages";
+        std::cerr << std::endl;
+    }
+
     // finish transaction
     bool ret = mDb->commitTransaction();
 
+    locked_checkCacheSize();
+
     return ret;
 }
 
@@ -863,6 +949,8 @@ int RsDataService::storeGroup(const std::list<RsNxsGrp*>& grp)
     // begin transaction
     mDb->beginTransaction();
 
+    std::list<ContentValue> cvs;
+
     for(std::list<RsNxsGrp*>::const_iterator sit = grp.begin();sit != grp.end(); ++sit)
 	{
 		RsNxsGrp* grpPtr = *sit;
@@ -886,7 +974,8 @@ int RsDataService::storeGroup(const std::list<RsNxsGrp*>& grp)
 		 * id signature, admin signatue, key set, last posting ts
 		 * and meta data
 		 **/
-		ContentValue cv;
+		cvs.push_back(ContentValue());
+		ContentValue& cv = cvs.back();
 
 		uint32_t dataLen = grpPtr->grp.TlvSize();
 		char grpData[dataLen];
@@ -932,16 +1021,14 @@ int RsDataService::storeGroup(const std::list<RsNxsGrp*>& grp)
 
 		mGrpMetaDataCache.updateMeta(grpMetaPtr->mGroupId,*grpMetaPtr);
 
-		if (!mDb->sqlInsert(GRP_TABLE_NAME, "", cv))
-		{
-			std::cerr << "RsDataService::storeGroup() sqlInsert Failed";
-			std::cerr << std::endl;
-			std::cerr << "\t For GroupId: " << grpMetaPtr->mGroupId.toStdString();
-			std::cerr << std::endl;
-		}
-
         delete *sit;
 	}
+
+	if (!mDb->sqlInsertBulk(GRP_TABLE_NAME, "", cvs))
+	{
+		std::cerr << "RsDataService::storeGroup() sqlInsertBulk Failed for some groups";
+		std::cerr << std::endl;
+	}
     // finish transaction
     bool ret = mDb->commitTransaction();
 
@@ -1224,6 +1311,12 @@ int RsDataService::retrieveNxsMsgs(const GxsMsgReq &reqIds, GxsMsgResult &msg,
         msgSet.clear();
     }
 
+    if(withMeta)
+    {
+        RS_STACK_MUTEX(mDbMutex);
+        locked_checkCacheSize();
+    }
+
 #ifdef RS_DATA_SERVICE_DEBUG_TIME
     std::cerr << "RsDataService::retrieveNxsMsgs() " << mDbName << ", Requests: " << reqIds.size() << ", Results: " << resultCount << ", Time: " << timer.duration() << std::endl;
 #endif
@@ -1269,12 +1362,15 @@ int RsDataService::retrieveGxsMsgMetaData(const GxsMsgReq& reqIds, GxsMsgMetaRes
         // if vector empty then request all messages
 
         // The pointer here is a trick to not initialize a new cache entry when cache is disabled, while keeping the unique variable all along.
-        t_MetaDataCache<RsGxsMessageId,RsGxsMsgMetaData> *cache(mUseCache? (&mMsgMetaDataCache[grpId]) : nullptr);
+        t_MetaDataCache<RsGxsMessageId,RsGxsMsgMetaData> *cache(mUseCache? (&locked_msgMetaCache(grpId)) : nullptr);
 
         if(msgIdV.empty())
         {
             if(mUseCache && cache->isCacheUpToDate())
+            {
                 cache->getFullMetaList(msgMeta[grpId]);
+                mCacheHits += cache->size();
+            }
             else
 			{
 				RetroCursor* c = mDb->sqlQuery(MSG_TABLE_NAME, mMsgMetaColumns, KEY_GRP_ID+ "='" + grpId.toStdString() + "'", "");
@@ -1304,7 +1400,10 @@ int RsDataService::retrieveGxsMsgMetaData(const GxsMsgReq& reqIds, GxsMsgMetaRes
                 auto meta = mUseCache?cache->getMeta(msgId): (std::shared_ptr<RsGxsMsgMetaData>());
 
                 if(meta)
+                {
                     metaSet.push_back(meta);
+                    ++mCacheHits;
+                }
                 else
 				{
 					RetroCursor* c = mDb->sqlQuery(MSG_TABLE_NAME, mMsgMetaColumns, KEY_GRP_ID+ "='" + grpId.toStdString() + "' AND " + KEY_MSG_ID + "='" + msgId.toStdString() + "'", "");
@@ -1313,12 +1412,7 @@ int RsDataService::retrieveGxsMsgMetaData(const GxsMsgReq& reqIds, GxsMsgMetaRes
                     auto meta = locked_getMsgMeta(*c, 0);
 
                     if(meta)
-                    {
-                        metaSet.push_back(meta);
-
-                        if(mUseCache)
-                            mMsgMetaDataCache[grpId].updateMeta(msgId,meta);
-                    }
+                        metaSet.push_back(meta);	// also cached by locked_getMsgMeta()
 
                     delete c;
 				}
@@ -1329,6 +1423,8 @@ int RsDataService::retrieveGxsMsgMetaData(const GxsMsgReq& reqIds, GxsMsgMetaRes
         }
     }
 
+    locked_checkCacheSize();
+
 #ifdef RS_DATA_SERVICE_DEBUG_TIME
     if(mDbName==std::string("gxsforums_db"))
     std::cerr << "RsDataService::retrieveGxsMsgMetaData() " << mDbName << ", Requests: " << reqIds.size() << ", Results: " << resultCount << ", Time: " << timer.duration() << std::endl;
@@ -1337,6 +1433,49 @@ int RsDataService::retrieveGxsMsgMetaData(const GxsMsgReq& reqIds, GxsMsgMetaRes
     return 1;
 }
 
+int RsDataService::retrieveFilteredMsgMetaData(const GxsMsgReq& reqIds, GxsMsgMetaResult& msgMeta, const RsGxsMsgMetaFilter& filter)
+{
+    if(filter.empty())
+        return retrieveGxsMsgMetaData(reqIds, msgMeta);
+
+    GxsMsgReq remainingIds;
+
+    {
+        RsStackMutex stack(mDbMutex);
+
+        for(auto mit(reqIds.begin()); mit != reqIds.end(); ++mit)
+        {
+            const RsGxsGroupId& grpId = mit->first;
+
+            // Explicit msg ids are looked up one by one anyway, and metas of a
+            // fully cached group are already in memory: both are filtered below,
+            // where the cache is marked as used.
+
+            auto cit = mMsgMetaDataCache.find(grpId);
+
+            if(!mit->second.empty() || (mUseCache && cit != mMsgMetaDataCache.end() && cit->second.isCacheUpToDate()))
+            {
+                remainingIds.insert(*mit);
+                continue;
+            }
+
+            RetroCursor* c = mDb->sqlQuery(MSG_TABLE_NAME, mMsgMetaColumns, msgMetaFilterSelection(grpId, filter), "");
+
+            if(c)
+                locked_retrieveMsgMetaList(c, msgMeta[grpId]);
+
+            delete c;
+        }
+
+        locked_checkCacheSize();
+    }
+
+    if(!remainingIds.empty())
+        RsGeneralDataService::retrieveFilteredMsgMetaData(remainingIds, msgMeta, filter);
+
+    return 1;
+}
+
 void RsDataService::locked_retrieveGrpMetaList(RetroCursor *c, std::map<RsGxsGroupId,std::shared_ptr<RsGxsGrpMetaData> >& grpMeta)
 {
 	if(!c)
@@ -1402,6 +1541,7 @@ int RsDataService::retrieveGxsGrpMetaData(std::map<RsGxsGroupId,std::shared_ptr<
 #endif
 
 			mGrpMetaDataCache.getFullMetaList(grp) ;
+			mCacheHits += grp.size();
         }
         else
 		{
@@ -1433,7 +1573,10 @@ int RsDataService::retrieveGxsGrpMetaData(std::map<RsGxsGroupId,std::shared_ptr<
             auto meta = mUseCache?mGrpMetaDataCache.getMeta(mit->first): (std::shared_ptr<RsGxsGrpMetaData>()) ;
 
 			if(meta)
+			{
 				mit->second = meta;
+				++mCacheHits;
+			}
 			else
 			{
 #ifdef RS_DATA_SERVICE_DEBUG_CACHE
@@ -1448,12 +1591,7 @@ int RsDataService::retrieveGxsGrpMetaData(std::map<RsGxsGroupId,std::shared_ptr<
                 auto meta = locked_getGrpMeta(*c, 0);
 
                 if(meta)
-                {
-                    mit->second = meta;
-
-                    if(mUseCache)
-                        mGrpMetaDataCache.updateMeta(grpId,meta);
-                }
+                    mit->second = meta;	// also cached by locked_getGrpMeta()
 
 #ifdef RS_DATA_SERVICE_DEBUG_TIME
 				++resultCount;
@@ -1570,9 +1708,11 @@ int RsDataService::updateMessageMetaData(const MsgLocMetaData& metaData)
             mUseCache=true;
 
             if(meta)
-                mMsgMetaDataCache[grpId].updateMeta(msgId,meta);
+                locked_msgMetaCache(grpId).updateMeta(msgId,meta);
 
             delete c;
+
+            locked_checkCacheSize();
         }
 
         return 1;
@@ -1735,12 +1875,79 @@ bool RsDataService::locked_removeGroupEntries(const std::vector<RsGxsGroupId>& g
 }
 
 uint32_t RsDataService::cacheSize() const {
-    return 0;
+    return mCacheSize;
 }
 
-int RsDataService::setCacheSize(uint32_t /* size */)
+int RsDataService::setCacheSize(uint32_t size)
 {
-    return 0;
+    RS_STACK_MUTEX(mDbMutex);
+
+    mCacheSize = size;
+    locked_checkCacheSize();
+
+    return 1;
+}
+
+t_MetaDataCache<RsGxsMessageId,RsGxsMsgMetaData>& RsDataService::locked_msgMetaCache(const RsGxsGroupId& grpId)
+{
+    auto& cache(mMsgMetaDataCache[grpId]);
+    cache.setLastAccess(++mCacheAccessCount);
+
+    return cache;
+}
+
+void RsDataService::locked_checkCacheSize()
+{
+    uint64_t total = mGrpMetaDataCache.memoryUsage();
+
+    for(auto& it:mMsgMetaDataCache)
+        total += it.second.memoryUsage();
+
+    if(total <= mCacheSize)
+        return;
+
+    // Drop the msg metas of the least recently used groups. Group metas are
+    // always needed as a whole, so they are kept, and so is the last used group
+    // so that browsing a group larger than the budget still hits the cache.
+
+    std::vector<std::pair<uint64_t,RsGxsGroupId> > lru;
+
+    for(auto& it:mMsgMetaDataCache)
+        lru.push_back(std::make_pair(it.second.lastAccess(), it.first));
+
+    std::sort(lru.begin(), lru.end());
+
+    for(size_t i = 0; i + 1 < lru.size() && total > mCacheSize; ++i)
+    {
+        auto it = mMsgMetaDataCache.find(lru[i].second);
+
+        total -= it->second.memoryUsage();
+        mCacheEvictions += it->second.size();
+
+#ifdef RS_DATA_SERVICE_DEBUG_CACHE
+        std::cerr << mDbName << ": evicting " << it->second.size() << " msg metas of group " << it->first << " from cache" << std::endl;
+#endif
+        mMsgMetaDataCache.erase(it);
+    }
+}
+
+void RsDataService::getMetaCacheStatistic(GxsMetaCacheStatistic& stats)
+{
+    RS_STACK_MUTEX(mDbMutex);
+
+    stats.mHits = mCacheHits;
+    stats.mMisses = mCacheMisses;
+    stats.mEvictions = mCacheEvictions;
+    stats.mNumGrps = mGrpMetaDataCache.size();
+    stats.mNumMsgs = 0;
+    stats.mSize = mGrpMetaDataCache.memoryUsage();
+    stats.mMaxSize = mCacheSize;
+
+    for(auto& it:mMsgMetaDataCache)
+    {
+        stats.mNumMsgs += it.second.size();
+        stats.mSize += it.second.memoryUsage();
+    }
 }
 
 void RsDataService::debug_printCacheSize()
@@ -35,75 +35,66 @@ public:
 	ContentValue cv;
 };
 
+/*!
+ * Cache of the metas of a data store table, for one group in the case of
+ * messages. Each entry is accounted with an estimate of the memory it uses, so
+ * that the data store can keep its caches in a memory budget, dropping the
+ * least recently used ones.
+ */
 template<class ID, class MetaDataClass> class t_MetaDataCache
 {
 public:
     t_MetaDataCache()
-        : mCache_ContainsAllMetas(false)
+        : mCache_ContainsAllMetas(false), mMemoryUsage(0), mLastAccess(0)
     {}
     virtual ~t_MetaDataCache() = default;
 
     bool isCacheUpToDate() const { return mCache_ContainsAllMetas ; }
     void setCacheUpToDate(bool b) { mCache_ContainsAllMetas = b; }
 
-    void getFullMetaList(std::map<ID,std::shared_ptr<MetaDataClass> >& mp) const { mp = mMetas ; }
-    void getFullMetaList(std::vector<std::shared_ptr<MetaDataClass> >& mp) const { for(auto& m:mMetas) mp.push_back(m.second) ; }
+    void getFullMetaList(std::map<ID,std::shared_ptr<MetaDataClass> >& mp) const { mp.clear(); for(auto& m:mMetas) mp[m.first] = m.second.meta ; }
+    void getFullMetaList(std::vector<std::shared_ptr<MetaDataClass> >& mp) const { for(auto& m:mMetas) mp.push_back(m.second.meta) ; }
 
     std::shared_ptr<MetaDataClass> getMeta(const ID& id)
     {
 		auto itt = mMetas.find(id);
 
 		if(itt != mMetas.end())
-			return itt->second ;
+			return itt->second.meta ;
         else
             return nullptr;
     }
 
-    std::shared_ptr<MetaDataClass> getOrCreateMeta(const ID& id)
-    {
-		auto it = mMetas.find(id) ;
-
-		if(it != mMetas.end())
-		{
-#ifdef RS_DATA_SERVICE_DEBUG
-			RsDbg() << __PRETTY_FUNCTION__ << ": getting group meta " << grpId << " from cache." << std::endl;
-#endif
-            return it->second ;
-		}
-		else
-		{
-#ifdef RS_DATA_SERVICE_DEBUG
-			RsDbg() << __PRETTY_FUNCTION__ << ": group meta " << grpId << " not in cache. Loading it from DB..." << std::endl;
-#endif
-            return (mMetas[id] = std::make_shared<MetaDataClass>());
-        }
-    }
-
     void updateMeta(const ID& id,const MetaDataClass& meta)
     {
-        mMetas[id] = std::make_shared<MetaDataClass>(meta);     // create a new shared_ptr to possibly replace the previous one
+        updateMeta(id, std::make_shared<MetaDataClass>(meta));     // create a new shared_ptr to possibly replace the previous one
     }
 
     void updateMeta(const ID& id,const std::shared_ptr<MetaDataClass>& meta)
 	{
-        mMetas[id] = meta;     // create a new shared_ptr to possibly replace the previous one
+        Entry& e(mMetas[id]);
+
+        mMemoryUsage -= e.size;
+
+        e.meta = meta;     // create a new shared_ptr to possibly replace the previous one
+        e.size = entrySize(*meta);
+
+        mMemoryUsage += e.size;
 	}
 
     void clear(const ID& id)
 	{
 		auto it = mMetas.find(id) ;
 
-		// We dont actually delete the item, because it might be used by a calling client.
-		// In this case, the memory will not be used for long, so we keep it into a list for a safe amount
-		// of time and delete it later. Using smart pointers here would be more elegant, but that would need
-		// to be implemented thread safe, which is difficult in this case.
+		// The meta itself is not deleted here if a calling client still holds
+		// it, since it is a shared pointer.
 
 		if(it != mMetas.end())
 		{
 #ifdef RS_DATA_SERVICE_DEBUG
-			std::cerr << "(II) moving database cache entry " << (void*)(*it).second << " to dead list." << std::endl;
+			std::cerr << "(II) removing database cache entry " << id << std::endl;
 #endif
-
+			mMemoryUsage -= it->second.size;
 			mMetas.erase(it) ;
 
             // No need to modify  mCache_ContainsAllMetas since, assuming that the cache always contains
@@ -112,19 +103,43 @@ public:
         }
 	}
 
+    /*! Number of cached metas */
+    size_t size() const { return mMetas.size(); }
+
+    /*! Estimate of the memory used by the cached metas, in bytes */
+    uint64_t memoryUsage() const { return mMemoryUsage; }
+
+    /*! Stamp of the last use of the cache, only compared to other stamps */
+    uint64_t lastAccess() const { return mLastAccess; }
+    void setLastAccess(uint64_t stamp) { mLastAccess = stamp; }
+
     void debug_computeSize(uint32_t& nb_items, uint64_t& total_size) const
     {
         nb_items = mMetas.size();
         total_size = 0;
 
-        for(auto it:mMetas) total_size += it.second->serial_size();
+        for(auto& it:mMetas) total_size += it.second.meta->serial_size();
     }
 private:
-    std::map<ID,std::shared_ptr<MetaDataClass> > mMetas;
+    struct Entry
+    {
+        Entry() : size(0) {}
+
+        std::shared_ptr<MetaDataClass> meta;
+        uint32_t size;  // accounted size, metas may change after they are cached
+    };
 
-	static const uint32_t CACHE_ENTRY_GRACE_PERIOD = 600 ; // Unused items are deleted 10 minutes after last usage.
+    // The serial size stands for the strings, keys and signatures held by the
+    // meta, on top of which come the object itself, the shared pointer control
+    // block and the map node.
+    static uint32_t entrySize(const MetaDataClass& meta)
+    { return sizeof(MetaDataClass) + sizeof(Entry) + 64 + meta.serial_size(); }
+
+    std::map<ID,Entry> mMetas;
 
     bool mCache_ContainsAllMetas ;
+    uint64_t mMemoryUsage;
+    uint64_t mLastAccess;
 };
 
 class RsDataService : public RsGeneralDataService
@@ -168,6 +183,18 @@ public:
      */
     int retrieveGxsMsgMetaData(const GxsMsgReq& reqIds, GxsMsgMetaResult& msgMeta) override;
 
+    /*!
+     * Retrieves the meta data of messages matching a filter. Unless the whole
+     * group is in the cache, the filter is applied by the database, so that only
+     * the matching rows are read.
+     * @param reqIds grpIds and msgIds to look into, empty msgId sets meaning all msgs of the group
+     * @param msgMeta meta data result as map of grpIds to array of metadata for that grpId
+     * @param filter conditions the returned metas satisfy
+     * @return error code
+     */
+    int retrieveFilteredMsgMetaData( const GxsMsgReq& reqIds, GxsMsgMetaResult& msgMeta,
+                                     const RsGxsMsgMetaFilter& filter ) override;
+
     /*!
      * remove msgs in data store
      * @param grpId group Id of message to be removed
@@ -267,6 +294,12 @@ public:
 
     int updateGroupKeys(const RsGxsGroupId& grpId,const RsTlvSecurityKeySet& keys, uint32_t subscribe_flags)  override;
 
+    /*!
+     * Usage of the meta caches since the data store was created
+     * @param stats hits, misses and evictions of metas, and memory used
+     */
+    void getMetaCacheStatistic(GxsMetaCacheStatistic& stats) override;
+
     void debug_printCacheSize() ;
 
 private:
@@ -450,10 +483,28 @@ private:
     void locked_clearGrpMetaCache(const RsGxsGroupId& gid);
 	void locked_updateGrpMetaCache(const RsGxsGrpMetaData& meta);
 
+    /*!
+     * Msg meta cache of a group, marked as the most recently used one
+     */
+    t_MetaDataCache<RsGxsMessageId,RsGxsMsgMetaData>& locked_msgMetaCache(const RsGxsGroupId& grpId);
+
+    /*!
+     * Drop the msg metas of the least recently used groups until the caches
+     * fit in their memory budget. Caches of groups are removed, so references
+     * to them must not be kept across calls.
+     */
+    void locked_checkCacheSize();
+
     t_MetaDataCache<RsGxsGroupId,RsGxsGrpMetaData> mGrpMetaDataCache;
     std::map<RsGxsGroupId,t_MetaDataCache<RsGxsMessageId,RsGxsMsgMetaData> > mMsgMetaDataCache;
 
     bool mUseCache;
+
+    uint32_t mCacheSize;	// memory budget of the caches, in bytes
+    uint64_t mCacheAccessCount;
+    uint64_t mCacheHits;
+    uint64_t mCacheMisses;
+    uint64_t mCacheEvictions;
 };
 
 #endif // RSDATASERVICE_H
@@ -22,6 +22,7 @@
 
 #pragma once
 
+#include <algorithm>
 #include <set>
 #include <map>
 #include <string>
@@ -86,6 +87,55 @@ struct RsGroupNetworkStats
 	rstime_t   mLastGroupModificationTS;
 };
 
+/*!
+ * Conditions on message meta data, that a data store can check while reading
+ * the metas instead of having all the metas of a group loaded and filtered
+ * afterwards. Null ids, null masks and null time stamps mean no condition.
+ */
+struct RsGxsMsgMetaFilter
+{
+	RsGxsMsgMetaFilter() :
+	    mOnlyThreadHeads(false), mStatusMask(0), mStatusFilter(0),
+	    mMsgFlagMask(0), mMsgFlagFilter(0), mPublishedAfter(0),
+	    mPublishedBefore(0) {}
+
+	bool empty() const
+	{
+		return mThreadId.isNull() && mParentId.isNull() && mOrigMsgId.isNull()
+		        && !mOnlyThreadHeads && !mStatusMask && !mMsgFlagMask
+		        && !mPublishedAfter && !mPublishedBefore;
+	}
+
+	bool matches(const RsGxsMsgMetaData& meta) const
+	{
+		if(!mThreadId.isNull() && meta.mThreadId != mThreadId) return false;
+		if(!mParentId.isNull() && meta.mParentId != mParentId) return false;
+		if(!mOrigMsgId.isNull() && meta.mOrigMsgId != mOrigMsgId) return false;
+		if(mOnlyThreadHeads && !meta.mParentId.isNull()) return false;
+
+		if((meta.mMsgStatus & mStatusMask) != (mStatusFilter & mStatusMask))
+			return false;
+		if((meta.mMsgFlags & mMsgFlagMask) != (mMsgFlagFilter & mMsgFlagMask))
+			return false;
+
+		if(mPublishedAfter && meta.mPublishTs < mPublishedAfter) return false;
+		if(mPublishedBefore && meta.mPublishTs > mPublishedBefore) return false;
+
+		return true;
+	}
+
+	RsGxsMessageId mThreadId;
+	RsGxsMessageId mParentId;
+	RsGxsMessageId mOrigMsgId;
+	bool mOnlyThreadHeads;
+
+	uint32_t mStatusMask, mStatusFilter;   // status & mask == filter & mask
+	uint32_t mMsgFlagMask, mMsgFlagFilter; // flags & mask == filter & mask
+
+	rstime_t mPublishedAfter;              // inclusive bounds
+	rstime_t mPublishedBefore;
+};
+
 typedef std::map<RsGxsGroupId,      std::vector<RsNxsMsg*> > NxsMsgDataResult;
 typedef std::map<RsGxsGrpMsgIdPair, std::vector<RsNxsMsg*> > NxsMsgRelatedDataResult;
 typedef std::map<RsGxsGroupId,      std::vector<RsNxsMsg*> > GxsMsgResult; // <grpId, msgs>
@@ -172,6 +222,29 @@ public:
      */
     virtual int retrieveGxsMsgMetaData(const GxsMsgReq& msgIds, GxsMsgMetaResult& msgMeta) = 0;
 
+    /*!
+     * Same as retrieveGxsMsgMetaData(), only returning the metas matching the
+     * filter. Stores able to apply the filter while reading should override
+     * this, the default retrieves all the metas and drops the others.
+     * @param msgIds grpIds and msgIds to look into, empty msgId sets meaning all msgs of the group
+     * @param msgMeta meta data result as map of grpIds to array of metadata for that grpId
+     * @param filter conditions the returned metas satisfy
+     * @return error code
+     */
+    virtual int retrieveFilteredMsgMetaData( const GxsMsgReq& msgIds, GxsMsgMetaResult& msgMeta,
+                                             const RsGxsMsgMetaFilter& filter )
+    {
+        int res = retrieveGxsMsgMetaData(msgIds, msgMeta);
+
+        if(!filter.empty())
+            for(auto& it: msgMeta)
+                it.second.erase( std::remove_if( it.second.begin(), it.second.end(),
+                                     [&filter](const std::shared_ptr<RsGxsMsgMetaData>& m)
+                                     { return !filter.matches(*m); } ),
+                                 it.second.end() );
+        return res;
+    }
+
     /*!
      * remove msgs in data store listed in msgIds param
      * @param msgIds ids of messages to be removed
@@ -218,6 +291,12 @@ public:
      */
     virtual int setCacheSize(uint32_t size) = 0;
 
+    /*!
+     * @param stats usage of the meta data caches, left untouched by stores
+     *              without caches
+     */
+    virtual void getMetaCacheStatistic(GxsMetaCacheStatistic& /* stats */) {}
+
     /*!
      * Stores a list of signed messages into data store
      * @param msg map of message and decoded meta data information
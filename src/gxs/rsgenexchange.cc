@@ -42,6 +42,7 @@
 #include "retroshare/rsevents.h"
 #include "util/radix64.h"
 #include "util/cxx17retrocompat.h"
+#include "util/rsexecutor.h"
 
 #define PUB_GRP_MASK     0x000f
 #define RESTR_GRP_MASK   0x00f0
@@ -63,6 +64,7 @@ static const uint32_t INDEX_AUTHEN_ADMIN        = 0x00000040; // admin key
 
 static const uint32_t MSG_CLEANUP_PERIOD     = 60*59; // 59 minutes
 static const uint32_t INTEGRITY_CHECK_PERIOD = 60*31; // 31 minutes
+static const uint32_t MIN_VALIDATIONS_PER_THREAD = 8;     // below this, posting a helper job costs more than it saves
 
 #define GXS_MASK "GXS_MASK_HACK"
 
@@ -195,6 +197,9 @@ RsGenExchange::RsGenExchange(
   VALIDATE_MAX_WAITING_TIME(60)
 {
     mDataAccess = new RsGxsDataAccess(gds);
+
+    // when running on the executor there is no thread waiting for requests
+    mDataAccess->setNewRequestsCallback([this]() { wakeTick(); });
 }
 
 void RsGenExchange::setNetworkExchangeService(RsNetworkExchangeService *ns)
@@ -233,12 +238,17 @@ bool RsGenExchange::getGroupServerUpdateTS(const RsGxsGroupId& gid, rstime_t& gr
 
 void RsGenExchange::threadTick()
 {
-	static const double timeDelta = 0.1; // slow tick in sec
-
 	tick();
-	rstime::rs_usleep((int) (timeDelta * 1000 *1000)); // timeDelta sec
+
+	// sleep until next tick, but process client requests as soon as they come
+	mDataAccess->waitForNewRequests(tickPeriod());
 }
 
+void RsGenExchange::executorTick() { tick(); }
+
+std::chrono::milliseconds RsGenExchange::tickPeriod() const
+{ return std::chrono::milliseconds(100); } // slow tick
+
 void RsGenExchange::tick()
 {
 	// Meta Changes should happen first.
@@ -3053,6 +3063,13 @@ void RsGenExchange::shareGroupPublishKey(const RsGxsGroupId& grpId,const std::se
     mNetService->sharePublishKey(grpId,peers) ;
 }
 
+std::atomic<uint32_t> RsGenExchange::sValidationThreads(0);
+
+void RsGenExchange::setValidationThreadCount(uint32_t threads)
+{
+	sValidationThreads = threads;
+}
+
 void RsGenExchange::processRecvdData()
 {
     processRecvdGroups();
@@ -3139,9 +3156,13 @@ void RsGenExchange::processRecvdMessages()
 	    std::cerr << "  updating received messages:" << std::endl;
 #endif
 
-		// 3 - Validate each message
+		// 3 - Validate each message. Signature checks do not depend on each other, so they are spread over
+		//     several threads, then the results are applied in the same order as the pending list.
 
-	    for(NxsMsgPendingVect::iterator pend_it = mMsgPendingValidate.begin();pend_it != mMsgPendingValidate.end();)
+	    std::vector<NxsMsgPendingVect::iterator> to_validate;
+	    std::vector<const RsGxsGrpMetaData*> to_validate_grp_metas;
+
+	    for(NxsMsgPendingVect::iterator pend_it = mMsgPendingValidate.begin();pend_it != mMsgPendingValidate.end();++pend_it)
 	    {
 		    RsNxsMsg* msg = pend_it->second.mItem;
 
@@ -3162,28 +3183,42 @@ void RsGenExchange::processRecvdMessages()
 #endif
             auto mit = grpMetas.find(msg->grpId);
 
-#ifdef GEN_EXCH_DEBUG
-			    std::cerr << "    msg info         : grp id=" << msg->grpId << ", msg id=" << msg->msgId << std::endl;
-#endif
-			// validate msg
-
 			if(mit == grpMetas.end())
 			{
 				std::cerr << "RsGenExchange::processRecvdMessages(): impossible situation: grp meta " << msg->grpId << " not available." << std::endl;
-				++pend_it ;
 				continue ;
 			}
 
-            const auto& grpMeta = mit->second;
+			to_validate.push_back(pend_it);
+			to_validate_grp_metas.push_back(mit->second.get());
+	    }
+
+	    std::vector<int> validate_results(to_validate.size(), VALIDATE_FAIL_TRY_LATER);
+
+	    uint32_t n_helpers = std::min<uint32_t>(sValidationThreads, to_validate.size() / MIN_VALIDATIONS_PER_THREAD);
+
+	    RsExecutor::runParallel(to_validate.size(), n_helpers, [&](uint32_t i)
+	    {
+		    RsNxsMsg* msg = to_validate[i]->second.mItem;
+		    const RsGxsGrpMetaData* grpMeta = to_validate_grp_metas[i];
+
 			RsTlvSecurityKeySet keys = grpMeta->keys ;
 
 			GxsSecurity::createPublicKeysFromPrivateKeys(keys);	// make sure we have the public keys that correspond to the private ones, as it happens. Most of the time this call does nothing.
 
-			int validateReturn = validateMsg(msg, grpMeta->mGroupFlags, grpMeta->mSignFlags, keys);
+			validate_results[i] = validateMsg(msg, grpMeta->mGroupFlags, grpMeta->mSignFlags, keys);
+	    });
+
+	    for(uint32_t i=0;i<to_validate.size();++i)
+	    {
+		    NxsMsgPendingVect::iterator pend_it = to_validate[i];
+		    RsNxsMsg* msg = pend_it->second.mItem;
+		    int validateReturn = validate_results[i];
 
 #ifdef GEN_EXCH_DEBUG
-			std::cerr << "    grpMeta.mSignFlags: " << std::hex << grpMeta->mSignFlags << std::dec << std::endl;
-			std::cerr << "    grpMeta.mAuthFlags: " << std::hex << grpMeta->mAuthenFlags << std::dec << std::endl;
+			std::cerr << "    msg info         : grp id=" << msg->grpId << ", msg id=" << msg->msgId << std::endl;
+			std::cerr << "    grpMeta.mSignFlags: " << std::hex << to_validate_grp_metas[i]->mSignFlags << std::dec << std::endl;
+			std::cerr << "    grpMeta.mAuthFlags: " << std::hex << to_validate_grp_metas[i]->mAuthenFlags << std::dec << std::endl;
 			std::cerr << "    message validation result: " << (int)validateReturn << std::endl;
 #endif
 
@@ -3221,17 +3256,12 @@ void RsGenExchange::processRecvdMessages()
 				delete msg ;
 			}
 			else if(validateReturn == VALIDATE_FAIL_TRY_LATER)
-			{
-				++pend_it ;
 				continue;
-			}
 
 			// Remove the entry from mMsgPendingValidate, but do not delete msg since it's either pushed into msg_to_store or deleted in the FAIL case!
+			// Erasing from the map does not invalidate the other iterators in to_validate.
 
-			NxsMsgPendingVect::iterator tmp = pend_it ;
-			++tmp ;
 			mMsgPendingValidate.erase(pend_it) ;
-			pend_it = tmp ;
 	    }
 
 	    if(!msgIds.empty())
@@ -3660,18 +3690,9 @@ bool RsGenExchange::exportGroupBase64(
 	uint32_t token;
 	mDataAccess->requestGroupInfo( token, RS_TOKREQ_ANSTYPE_DATA, opts, groupIds);
 
-    // provide a sync response: actually wait for the token.
-    std::chrono::milliseconds maxWait = std::chrono::milliseconds(10000);
-    std::chrono::milliseconds checkEvery = std::chrono::milliseconds(100);
-
-	auto timeout = std::chrono::steady_clock::now() + maxWait;	// wait for 10 secs at most
-	auto st = mDataAccess->requestStatus(token);
-
-	while( !(st == RsTokenService::FAILED || st >= RsTokenService::COMPLETE) && std::chrono::steady_clock::now() < timeout )
-	{
-		std::this_thread::sleep_for(checkEvery);
-		st = mDataAccess->requestStatus(token);
-	}
+    // provide a sync response: actually wait for the token, 10 secs at most.
+	auto st = mDataAccess->waitRequestStatus(
+	            token, std::chrono::milliseconds(10000) );
 	if(st != RsTokenService::COMPLETE)
 		return failure( "waitToken(...) failed with: " + std::to_string(st) );
 
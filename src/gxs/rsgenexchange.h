@@ -23,6 +23,7 @@
 #define RSGENEXCHANGE_H
 
 #include <queue>
+#include <atomic>
 #include "util/rstime.h"
 
 #include "rsgxs.h"
@@ -179,6 +180,8 @@ public:
     RsTokenService* getTokenService();
 
 	void threadTick() override; /// @see RsTickingThread
+	void executorTick() override; /// @see RsTickingThread
+	std::chrono::milliseconds tickPeriod() const override; /// @see RsTickingThread
 
     /*!
      * Policy bit pattern portion
@@ -196,6 +199,16 @@ public:
      */
     static bool setAuthenPolicyFlag(const uint8_t& flag, uint32_t& authenFlag, const PrivacyBitPos& pos);
 
+    /*!
+     * Set how many executor jobs may help the service thread to check the
+     * signatures of received messages. Must be called at startup, and has no
+     * effect if the executor is disabled
+     * @see RsConfigOptions::gxsValidationThreads
+     * @see RsExecutor
+     * @param threads 0 checks everything on the service thread
+     */
+    static void setValidationThreadCount(uint32_t threads);
+
 public:
 
     /** data access functions **/
@@ -1009,6 +1022,8 @@ private:
 
     std::map<RsGxsId,std::set<RsPeerId> > mRoutingClues ;
 
+    static std::atomic<uint32_t> sValidationThreads;
+
     friend class RsGxsCleanUp;
 };
 
@@ -21,6 +21,7 @@
  *******************************************************************************/
 
 #include "util/rstime.h"
+#include "util/rsthreads.h"
 
 #include "rsgxsutil.h"
 #include "rsgxsdataaccess.h"
@@ -73,19 +74,31 @@ static const std::vector<std::string> tokenStatusString( {
 
 #endif
 
-bool operator<(const std::pair<uint32_t,GxsRequest*>& p1,const std::pair<uint32_t,GxsRequest*>& p2)
-{
-    return p1.second->Options.mPriority <= p2.second->Options.mPriority ;	// <= so that new elements with same priority are inserted before
-}
-
 RsGxsDataAccess::RsGxsDataAccess(RsGeneralDataService* ds) :
-    mDataStore(ds), mDataMutex("RsGxsDataAccess"), mNextToken(0) {}
+    mDataStore(ds), mDataMutex("RsGxsDataAccess"), mNextToken(0),
+    mActiveReaders(0), mStopReaders(false),
+    mStatusGeneration(0), mNewRequests(false) {}
 
 
 RsGxsDataAccess::~RsGxsDataAccess()
 {
+	// reader threads use this object. Wait for them to finish their current request.
+	for(;;)
+	{
+		{
+			RS_STACK_MUTEX(mDataMutex);
+			mStopReaders = true;
+
+			if(mActiveReaders == 0)
+				break;
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+
     for(auto& it:mRequestQueue)
 		delete it.second;
+    for(auto& it:mCompletedRequests)
+		delete it.second;
 }
 bool RsGxsDataAccess::requestGroupInfo( uint32_t &token, uint32_t ansType, const RsTokReqOptions &opts, const std::list<RsGxsGroupId> &groupIds )
 {
@@ -349,20 +362,82 @@ void RsGxsDataAccess::setReq(GxsRequest* req, uint32_t token, uint32_t ansType,
 }
 void RsGxsDataAccess::storeRequest(GxsRequest* req)
 {
-	RS_STACK_MUTEX(mDataMutex);
-	req->status = PENDING;
-	req->reqTime = time(nullptr);
+	{
+		RS_STACK_MUTEX(mDataMutex);
+		req->status = PENDING;
+		req->reqTime = time(nullptr);
+
+		mRequestQueue.insert(std::make_pair(req->Options.mPriority,req));	// after requests of same priority
+		mPublicToken[req->token] = PENDING;
 
-	mRequestQueue.insert(std::make_pair(req->token,req));
-    mPublicToken[req->token] = PENDING;
+		if(isSummaryRequest(req))
+			locked_startReaders();	// don't wait for the service thread, that may be busy with some large request
 
 #ifdef DATA_DEBUG
-    GXSDATADEBUG << "Stored request token=" << req->token << " priority = " << static_cast<int>(req->Options.mPriority) << " Current request Queue is:" ;
-    for(auto it(mRequestQueue.begin());it!=mRequestQueue.end();++it)
-        GXSDATADEBUG << it->first << " (p=" << static_cast<int>(req->Options.mPriority) << ") ";
-    GXSDATADEBUG << std::endl;
-    GXSDATADEBUG << "PublicToken size: " << mPublicToken.size() << " Completed requests waiting for client: " << mCompletedRequests.size() << std::endl;
+		GXSDATADEBUG << "Stored request token=" << req->token << " priority = " << static_cast<int>(req->Options.mPriority) << " Current request Queue is:" ;
+		for(auto it(mRequestQueue.begin());it!=mRequestQueue.end();++it)
+			GXSDATADEBUG << it->second->token << " (p=" << static_cast<int>(it->first) << ") ";
+		GXSDATADEBUG << std::endl;
+		GXSDATADEBUG << "PublicToken size: " << mPublicToken.size() << " Completed requests waiting for client: " << mCompletedRequests.size() << std::endl;
 #endif
+	}
+
+	// wake up the service thread, so that the request is processed right away
+
+	{
+		std::lock_guard<std::mutex> lock(mStatusMtx);
+		mNewRequests = true;
+		mNewRequestsCv.notify_one();
+	}
+
+	if(mNewRequestsCallback) mNewRequestsCallback();
+}
+
+bool RsGxsDataAccess::waitForNewRequests(std::chrono::milliseconds maxWait)
+{
+	std::unique_lock<std::mutex> lock(mStatusMtx);
+
+	mNewRequestsCv.wait_for(lock, maxWait, [this]() { return mNewRequests; });
+
+	bool res = mNewRequests;
+	mNewRequests = false;
+	return res;
+}
+
+void RsGxsDataAccess::notifyStatusChange()
+{
+	std::lock_guard<std::mutex> lock(mStatusMtx);
+	++mStatusGeneration;
+	mStatusCv.notify_all();
+}
+
+RsTokenService::GxsRequestStatus RsGxsDataAccess::waitRequestStatus(
+        uint32_t token, std::chrono::milliseconds maxWait )
+{
+	auto timeout = std::chrono::steady_clock::now() + maxWait;
+	std::unique_lock<std::mutex> lock(mStatusMtx);
+
+	for(;;)
+	{
+		/* Read the generation before the status: a change happening after the
+		 * status check necessarily bumps it, and ends the wait below. */
+		uint64_t generation = mStatusGeneration;
+		lock.unlock();
+
+		GxsRequestStatus st = requestStatus(token);
+
+		if(st == FAILED || st >= COMPLETE)
+			return st;
+
+		lock.lock();
+
+		if(!mStatusCv.wait_until( lock, timeout, [&]()
+		                          { return generation != mStatusGeneration; } ))
+		{
+			lock.unlock();
+			return requestStatus(token);
+		}
+	}
 }
 
 RsTokenService::GxsRequestStatus RsGxsDataAccess::requestStatus(uint32_t token)
@@ -380,23 +455,30 @@ RsTokenService::GxsRequestStatus RsGxsDataAccess::requestStatus(uint32_t token)
 
 bool RsGxsDataAccess::cancelRequest(const uint32_t& token)
 {
-	RsStackMutex stack(mDataMutex); /****** LOCKED *****/
-
-    GxsRequest* req = locked_retrieveCompletedRequest(token);
-	if (!req)
 	{
-		return false;
-	}
+		RsStackMutex stack(mDataMutex); /****** LOCKED *****/
 
-	req->status = CANCELLED;
+		GxsRequest* req = locked_retrieveCompletedRequest(token);
+		if (!req)
+			return false;
+
+		req->status = CANCELLED;
+	}
 
+	notifyStatusChange();
 	return true;
 }
 
 bool RsGxsDataAccess::clearRequest(const uint32_t& token)
 {
-	RS_STACK_MUTEX(mDataMutex);
-    return locked_clearRequest(token);
+	bool res;
+	{
+		RS_STACK_MUTEX(mDataMutex);
+		res = locked_clearRequest(token);
+	}
+
+	if(res) notifyStatusChange();
+	return res;
 }
 
 bool RsGxsDataAccess::locked_clearRequest(const uint32_t& token)
@@ -749,153 +831,237 @@ GxsRequest* RsGxsDataAccess::locked_retrieveCompletedRequest(const uint32_t& tok
 
 #define MAX_REQUEST_AGE 120 // 2 minutes
 
-void RsGxsDataAccess::processRequests()
+// Maximum number of threads serving summary requests for a given service, next to the service thread.
+static const uint32_t MAX_CONCURRENT_READERS = 2;
+
+bool RsGxsDataAccess::isSummaryRequest(const GxsRequest* req)
 {
-	// process requests
+	return dynamic_cast<const GroupMetaReq*>(req) != nullptr
+	        || dynamic_cast<const GroupIdReq*>(req) != nullptr
+	        || dynamic_cast<const MsgMetaReq*>(req) != nullptr
+	        || dynamic_cast<const MsgIdReq*>(req) != nullptr
+	        || dynamic_cast<const GroupStatisticRequest*>(req) != nullptr
+	        || dynamic_cast<const ServiceStatisticRequest*>(req) != nullptr;
+}
+
+GxsRequest* RsGxsDataAccess::locked_popRequest(bool summaries, bool& expired)
+{
+	rstime_t now = time(nullptr);
 
-	while (!mRequestQueue.empty())
+	for(auto it(mRequestQueue.begin());it!=mRequestQueue.end();)
 	{
-#ifdef DATA_DEBUG
-        dumpTokenQueues();
-#endif
-        // Extract the first elements from the request queue. cleanup all other elements marked at terminated.
+		GxsRequest* req = it->second;
 
-		GxsRequest* req = nullptr;
+		if(now > req->reqTime + MAX_REQUEST_AGE)
 		{
-			RsStackMutex stack(mDataMutex); /******* LOCKED *******/
-			rstime_t now = time(nullptr); // this is ok while in the loop below
+			mPublicToken[req->token] = CANCELLED;
+			delete req;
+			it = mRequestQueue.erase(it);
+			expired = true;
+			continue;
+		}
 
-			while(!mRequestQueue.empty() && req == nullptr)
+		switch(req->status)
+		{
+		case PARTIAL:
+			RsErr() << "Found partial request in mRequestQueue. This is a bug." << std::endl;	// fallthrough
+		case COMPLETE:
+		case DONE:
+		case FAILED:
+		case CANCELLED:
+#ifdef DATA_DEBUG
+			GXSDATADEBUG << "  Service " << std::hex << mDataStore->serviceType() << std::dec << ": request " << req->token << ": status = " << req->status << ": removing from the RequestQueue" << std::endl;
+#endif
+			delete req;
+			it = mRequestQueue.erase(it);
+			continue;
+
+		case PENDING:
+			if(isSummaryRequest(req) != summaries)
 			{
-				if(now > mRequestQueue.begin()->second->reqTime + MAX_REQUEST_AGE)
-				{
-					mPublicToken[mRequestQueue.begin()->second->token] = CANCELLED;
-					delete mRequestQueue.begin()->second;
-					mRequestQueue.erase(mRequestQueue.begin());
-					continue;
-				}
+				++it;
+				continue;
+			}
+			req->status = PARTIAL;
+			mRequestQueue.erase(it); // remove it right away from the waiting queue.
+			return req;
+		}
+	}
+	return nullptr;
+}
 
-				switch( mRequestQueue.begin()->second->status )
-				{
-					case PARTIAL:
-						RsErr() << "Found partial request in mRequestQueue. This is a bug." << std::endl;	// fallthrough
-					case COMPLETE:
-					case DONE:
-					case FAILED:
-					case CANCELLED:
+void RsGxsDataAccess::processRequests()
+{
+	{
+		RS_STACK_MUTEX(mDataMutex);
+		locked_startReaders();
+	}
+
+	for(;;)
+	{
 #ifdef DATA_DEBUG
-                        GXSDATADEBUG << "  Service " << std::hex << mDataStore->serviceType() << std::dec << ": request " << mRequestQueue.begin()->second->token << ": status = " << mRequestQueue.begin()->second->status << ": removing from the RequestQueue" << std::endl;
+        dumpTokenQueues();
 #endif
-						delete mRequestQueue.begin()->second;
-						mRequestQueue.erase(mRequestQueue.begin());
-					continue;
-					break;
-					case PENDING:
-						req = mRequestQueue.begin()->second;
-						req->status = PARTIAL;
-						mRequestQueue.erase(mRequestQueue.begin()); // remove it right away from the waiting queue.
-					break;
-				}
+		GxsRequest* req;
+		bool expired = false;
+		{
+			RS_STACK_MUTEX(mDataMutex);
+			req = locked_popRequest(false,expired);
+		}
 
-			}
-		} // END OF MUTEX.
+		if(expired)
+			notifyStatusChange();
 
 		if (!req)
 			break;
 
-		GroupMetaReq* gmr;
-		GroupDataReq* gdr;
-		GroupIdReq* gir;
+		processRequest(req);
+	}
+}
+
+void RsGxsDataAccess::locked_startReaders()
+{
+	/* Summary requests (metadata, id lists, statistics) are cheap and often
+	 * waited for by the UI, so they are served by up to
+	 * MAX_CONCURRENT_READERS reader threads. They don't have to wait for
+	 * bulk data requests, which are processed one at a time on the service
+	 * thread. Both read from mDataStore, which is thread safe. */
+
+	uint32_t pending_summaries = 0;
+	for(auto& it: mRequestQueue)
+		if(it.second->status == PENDING && isSummaryRequest(it.second))
+			++pending_summaries;
+
+	while(!mStopReaders && mActiveReaders < MAX_CONCURRENT_READERS && mActiveReaders < pending_summaries)
+	{
+		++mActiveReaders;
+		RsThread::async([this]() { processSummaryRequests(); });
+	}
+}
 
-		MsgMetaReq* mmr;
-		MsgDataReq* mdr;
-		MsgIdReq* mir;
-		MsgRelatedInfoReq* mri;
-		GroupStatisticRequest* gsr;
-		GroupSerializedDataReq* grr;
-		ServiceStatisticRequest* ssr;
+void RsGxsDataAccess::processSummaryRequests()
+{
+	for(;;)
+	{
+		GxsRequest* req = nullptr;
+		bool expired = false;
+		{
+			RS_STACK_MUTEX(mDataMutex);
+
+			if(!mStopReaders)
+				req = locked_popRequest(true,expired);
+
+			/* Leave only once expired requests have been notified, as the
+			 * destructor may free this as soon as mActiveReaders drops to 0.
+			 * Decrement under the mutex, so that processRequests() knows that
+			 * new requests need a new reader. */
+			if(!req && !expired)
+			{
+				--mActiveReaders;
+				return;
+			}
+		}
+
+		if(expired)
+			notifyStatusChange();
+
+		if(req)
+			processRequest(req);
+	}
+}
+
+void RsGxsDataAccess::processRequest(GxsRequest* req)
+{
+	GroupMetaReq* gmr;
+	GroupDataReq* gdr;
+	GroupIdReq* gir;
+
+	MsgMetaReq* mmr;
+	MsgDataReq* mdr;
+	MsgIdReq* mir;
+	MsgRelatedInfoReq* mri;
+	GroupStatisticRequest* gsr;
+	GroupSerializedDataReq* grr;
+	ServiceStatisticRequest* ssr;
 
 #ifdef DATA_DEBUG
         GXSDATADEBUG << "Service " << std::hex << mDataStore->serviceType() << std::dec << ": Processing request: " << req->token << " Status: " << req->status << " ReqType: " << req->reqType << " Age: " << time(nullptr) - req->reqTime << std::endl;
 #endif
 
-		/* PROCESS REQUEST! */
-		bool ok = false;
+	/* PROCESS REQUEST! */
+	bool ok = false;
 
-		if((gmr = dynamic_cast<GroupMetaReq*>(req)) != nullptr)
-		{
-			ok = getGroupSummary(gmr);
-		}
-		else if((gdr = dynamic_cast<GroupDataReq*>(req)) != nullptr)
-		{
-			ok = getGroupData(gdr);
-		}
-		else if((gir = dynamic_cast<GroupIdReq*>(req)) != nullptr)
-		{
-			ok = getGroupList(gir);
-		}
-		else if((mmr = dynamic_cast<MsgMetaReq*>(req)) != nullptr)
-		{
-			ok = getMsgSummary(mmr);
-		}
-		else if((mdr = dynamic_cast<MsgDataReq*>(req)) != nullptr)
-		{
-			ok = getMsgData(mdr);
-		}
-		else if((mir = dynamic_cast<MsgIdReq*>(req)) != nullptr)
-		{
-			ok = getMsgIdList(mir);
-		}
-		else if((mri = dynamic_cast<MsgRelatedInfoReq*>(req)) != nullptr)
-		{
-			ok = getMsgRelatedInfo(mri);
-		}
-		else if((gsr = dynamic_cast<GroupStatisticRequest*>(req)) != nullptr)
-		{
-			ok = getGroupStatistic(gsr);
-		}
-		else if((ssr = dynamic_cast<ServiceStatisticRequest*>(req)) != nullptr)
-		{
-			ok = getServiceStatistic(ssr);
-		}
-		else if((grr = dynamic_cast<GroupSerializedDataReq*>(req)) != nullptr)
-		{
-			ok = getGroupSerializedData(grr);
-		}
-		else
-			RsErr() << __PRETTY_FUNCTION__ << " Failed to process request, token: " << req->token << std::endl;
+	if((gmr = dynamic_cast<GroupMetaReq*>(req)) != nullptr)
+	{
+		ok = getGroupSummary(gmr);
+	}
+	else if((gdr = dynamic_cast<GroupDataReq*>(req)) != nullptr)
+	{
+		ok = getGroupData(gdr);
+	}
+	else if((gir = dynamic_cast<GroupIdReq*>(req)) != nullptr)
+	{
+		ok = getGroupList(gir);
+	}
+	else if((mmr = dynamic_cast<MsgMetaReq*>(req)) != nullptr)
+	{
+		ok = getMsgSummary(mmr);
+	}
+	else if((mdr = dynamic_cast<MsgDataReq*>(req)) != nullptr)
+	{
+		ok = getMsgData(mdr);
+	}
+	else if((mir = dynamic_cast<MsgIdReq*>(req)) != nullptr)
+	{
+		ok = getMsgIdList(mir);
+	}
+	else if((mri = dynamic_cast<MsgRelatedInfoReq*>(req)) != nullptr)
+	{
+		ok = getMsgRelatedInfo(mri);
+	}
+	else if((gsr = dynamic_cast<GroupStatisticRequest*>(req)) != nullptr)
+	{
+		ok = getGroupStatistic(gsr);
+	}
+	else if((ssr = dynamic_cast<ServiceStatisticRequest*>(req)) != nullptr)
+	{
+		ok = getServiceStatistic(ssr);
+	}
+	else if((grr = dynamic_cast<GroupSerializedDataReq*>(req)) != nullptr)
+	{
+		ok = getGroupSerializedData(grr);
+	}
+	else
+		RsErr() << __PRETTY_FUNCTION__ << " Failed to process request, token: " << req->token << std::endl;
 
-		// We cannot easily remove the request here because the queue may have more elements now and mRequestQueue.begin() is not necessarily the same element.
-		// but we mark it as COMPLETE/FAILED so that it will be removed in the next loop.
-		{
-			RsStackMutex stack(mDataMutex); /******* LOCKED *******/
+	{
+		RsStackMutex stack(mDataMutex); /******* LOCKED *******/
 
-			if(ok)
-			{
-				// When the request is complete, we move it to the complete list, so that the caller can easily retrieve the request data
+		if(ok)
+		{
+			// When the request is complete, we move it to the complete list, so that the caller can easily retrieve the request data
 
 #ifdef DATA_DEBUG
                 GXSDATADEBUG << "  Service " << std::hex << mDataStore->serviceType() << std::dec << ": Request completed successfully. Marking as COMPLETE." << std::endl;
 #endif
-				req->status = COMPLETE ;
-				mCompletedRequests[req->token] = req;
-				mPublicToken[req->token] = COMPLETE;
-			}
-			else
-			{
-				mPublicToken[req->token] = FAILED;
-				delete req;//req belongs to no one now
+			req->status = COMPLETE ;
+			mCompletedRequests[req->token] = req;
+			mPublicToken[req->token] = COMPLETE;
+		}
+		else
+		{
+			mPublicToken[req->token] = FAILED;
+			delete req;//req belongs to no one now
 #ifdef DATA_DEBUG
                 GXSDATADEBUG << "  Service " << std::hex << mDataStore->serviceType() << std::dec << ": Request failed. Marking as FAILED." << std::endl;
 #endif
-			}
-		} // END OF MUTEX.
+		}
+	} // END OF MUTEX.
 
-	}
+	notifyStatusChange();
 }
 
 
-
 bool RsGxsDataAccess::getGroupSerializedData(GroupSerializedDataReq* req)
 {
 	std::map<RsGxsGroupId, RsNxsGrp*> grpData;
@@ -1027,11 +1193,40 @@ bool RsGxsDataAccess::getMsgSummary(MsgMetaReq* req)
 	return true;
 }
 
+/* Part of the request options that can be checked on each msg meta alone.
+ * Thread heads can be selected before looking for the latest versions, since
+ * all the versions of a message have the same parent. Status, flags and
+ * publish time differ between versions, so when only the latest versions are
+ * requested they go to versionFilter, to be checked once the older versions
+ * are dropped. Otherwise an old version could be kept because its newer
+ * version did not match. */
+static RsGxsMsgMetaFilter msgMetaFilter(const RsTokReqOptions& opts, RsGxsMsgMetaFilter& versionFilter)
+{
+    RsGxsMsgMetaFilter filter;
+
+    filter.mOnlyThreadHeads = !!(opts.mOptions & RS_TOKREQOPT_MSG_THREAD);
+
+    bool onlyLatestMsgs = !(opts.mOptions & RS_TOKREQOPT_MSG_ORIGMSG) && (opts.mOptions & RS_TOKREQOPT_MSG_LATEST);
+    RsGxsMsgMetaFilter& f(onlyLatestMsgs ? versionFilter : filter);
+
+    f.mStatusMask = opts.mStatusMask;
+    f.mStatusFilter = opts.mStatusFilter;
+    f.mMsgFlagMask = opts.mMsgFlagMask;
+    f.mMsgFlagFilter = opts.mMsgFlagFilter;
+    f.mPublishedAfter = opts.mAfter;
+    f.mPublishedBefore = opts.mBefore;
+
+    return filter;
+}
+
 bool RsGxsDataAccess::getMsgMetaDataList( const GxsMsgReq& msgIds, const RsTokReqOptions& opts, GxsMsgMetaResult& result )
 {
-    // First get all message metas, then filter out the ones we want to keep.
+    // Conditions on single messages are checked by the data store while reading
+    // the metas, the ones involving several messages are applied afterwards.
+    RsGxsMsgMetaFilter versionFilter;
+
     result.clear();
-    mDataStore->retrieveGxsMsgMetaData(msgIds, result);
+    mDataStore->retrieveFilteredMsgMetaData(msgIds, result, msgMetaFilter(opts, versionFilter));
 
     /* CASEs this handles.
      * Input is groupList + Flags.
@@ -1188,6 +1383,12 @@ bool RsGxsDataAccess::getMsgMetaDataList( const GxsMsgReq& msgIds, const RsTokRe
 						metaV[i] = nullptr;
 						continue;
 					}
+
+					if (!versionFilter.empty() && !versionFilter.matches(*msgMeta))
+					{
+						metaV[i] = nullptr;
+						continue;
+					}
 				}
     }
 
@@ -1333,27 +1534,21 @@ bool RsGxsDataAccess::getMsgRelatedInfo(MsgRelatedInfoReq *req)
 
         const RsGxsGrpMsgIdPair& grpMsgIdPair = *vit_msgIds;
 
-        // get meta data for all in group
-        GxsMsgMetaResult result;
-        GxsMsgReq msgIds;
-        msgIds.insert(std::make_pair(grpMsgIdPair.first, std::set<RsGxsMessageId>()));
-        mDataStore->retrieveGxsMsgMetaData(msgIds, result);
-        auto& metaV = result[grpMsgIdPair.first];
-
         // msg id to relate to
         const RsGxsMessageId& msgId = grpMsgIdPair.second;
         const RsGxsGroupId& grpId = grpMsgIdPair.first;
 
         std::set<RsGxsMessageId> outMsgIds;
 
+        GxsMsgMetaResult origResult;
+        GxsMsgReq msgIds;
+        msgIds[grpId].insert(msgId);
+        mDataStore->retrieveGxsMsgMetaData(msgIds, origResult);
+
         std::shared_ptr<RsGxsMsgMetaData> origMeta;
 
-        for(auto vit_meta = metaV.begin(); vit_meta != metaV.end(); ++vit_meta)
-            if(msgId == (*vit_meta)->mMsgId)
-            {
-                origMeta = *vit_meta;
-                break;
-            }
+        if(!origResult[grpId].empty())
+            origMeta = origResult[grpId].front();
 
 		if(!origMeta)
 		{
@@ -1361,7 +1556,23 @@ bool RsGxsDataAccess::getMsgRelatedInfo(MsgRelatedInfoReq *req)
 			return false;
 		}
 
-        const RsGxsMessageId& origMsgId = origMeta->mOrigMsgId;
+        const RsGxsMessageId origMsgId = origMeta->mOrigMsgId;
+
+        // get meta data of the related msgs only. The loops below still check
+        // the relation, since null ids are not turned into conditions.
+        RsGxsMsgMetaFilter relation;
+
+        if (onlyChildMsgs)
+            relation.mParentId = origMsgId;
+        else if (onlyThreadMsgs)
+            relation.mThreadId = msgId;
+        else
+            relation.mOrigMsgId = origMsgId;
+
+        GxsMsgMetaResult result;
+        msgIds[grpId].clear();
+        mDataStore->retrieveFilteredMsgMetaData(msgIds, result, relation);
+        auto& metaV = result[grpId];
         auto& metaMap = filterMap[grpId];
 
         if (onlyLatestMsgs)
@@ -1596,29 +1807,15 @@ bool RsGxsDataAccess::getServiceStatistic(ServiceStatisticRequest *req)
 
     req->mServiceStatistic.mSizeStore = req->mServiceStatistic.mSizeOfGrps + req->mServiceStatistic.mSizeOfMsgs;
 
+    mDataStore->getMetaCacheStatistic(req->mServiceStatistic.mMetaCache);
+
     return true;
 }
 
 bool RsGxsDataAccess::getMsgIdList(MsgIdReq* req)
 {
-
-    GxsMsgMetaResult result;
-    mDataStore->retrieveGxsMsgMetaData(req->mMsgIds, result);
-
-    for(auto mit = result.begin(); mit != result.end(); ++mit)
-    {
-        const RsGxsGroupId grpId = mit->first;
-        auto& metaV = mit->second;
-
-        for(auto vit=metaV.begin(); vit != metaV.end(); ++vit)
-            req->mMsgIdResult[grpId].insert((*vit)->mMsgId);
-    }
-
-    GxsMsgReq msgIdOut;
-
-    // filter based on options
-    getMsgIdList(req->mMsgIdResult, req->Options, msgIdOut);
-    req->mMsgIdResult = msgIdOut;
+    // filter based on options, while retrieving the metas
+    getMsgIdList(req->mMsgIds, req->Options, req->mMsgIdResult);
 
     return true;
 }
@@ -1812,38 +2009,42 @@ uint32_t RsGxsDataAccess::generatePublicToken()
 
 bool RsGxsDataAccess::updatePublicRequestStatus( uint32_t token, RsTokenService::GxsRequestStatus status )
 {
-	RS_STACK_MUTEX(mDataMutex);
+	{
+		RS_STACK_MUTEX(mDataMutex);
 
-	auto mit = mPublicToken.find(token);
+		auto mit = mPublicToken.find(token);
 
-	if(mit != mPublicToken.end())
-    {
-        mit->second = status;
+		if(mit == mPublicToken.end())
+			return false;
+
+		mit->second = status;
 #ifdef DATA_DEBUG
         GXSDATADEBUG << "Service " << std::hex << mDataStore->serviceType() << std::dec << ": updating public token " << token << " to state  " << tokenStatusString[status] << std::endl;
 #endif
-        return true;
-    }
-	else
-        return false;
+	}
+
+	notifyStatusChange();
+	return true;
 }
 
 
 
 bool RsGxsDataAccess::disposeOfPublicToken(uint32_t token)
 {
-	RS_STACK_MUTEX(mDataMutex);
-	auto mit = mPublicToken.find(token);
-	if(mit != mPublicToken.end())
 	{
+		RS_STACK_MUTEX(mDataMutex);
+		auto mit = mPublicToken.find(token);
+		if(mit == mPublicToken.end())
+			return false;
+
 		mPublicToken.erase(mit);
 #ifdef DATA_DEBUG
         GXSDATADEBUG << "Service " << std::hex << mDataStore->serviceType() << std::dec << ": Deleting public token " << token << ". Completed tokens: " << mCompletedRequests.size() << " Size of mPublicToken: " << mPublicToken.size() << std::endl;
 #endif
-        return true;
 	}
-	else
-        return false;
+
+	notifyStatusChange();
+	return true;
 }
 
 #ifdef DATA_DEBUG
@@ -1860,7 +2061,7 @@ void RsGxsDataAccess::dumpTokenQueues()
         GXSDATADEBUG << "    Completed Tokens: " << tokenpair.first << std::endl;
 
     for(auto tokenpair:mRequestQueue)
-        GXSDATADEBUG << "    RequestQueue: " << tokenpair.first << " status " << tokenStatusString[tokenpair.second->status] << std::endl;
+        GXSDATADEBUG << "    RequestQueue: " << tokenpair.second->token << " status " << tokenStatusString[tokenpair.second->status] << std::endl;
 
     GXSDATADEBUG << std::endl;
 }
@@ -1971,3 +2172,4 @@ bool RsGxsDataAccess::checkMsgFilter(const RsTokReqOptions& opts, const std::sha
 
 GxsGroupStatistic::~GxsGroupStatistic() = default;
 GxsServiceStatistic::~GxsServiceStatistic() = default;
+GxsMetaCacheStatistic::~GxsMetaCacheStatistic() = default;
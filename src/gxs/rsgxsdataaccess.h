@@ -23,6 +23,9 @@
 #define RSGXSDATAACCESS_H
 
 #include <queue>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
 #include "retroshare/rstokenservice.h"
 #include "rsgxsrequesttypes.h"
 #include "rsgds.h"
@@ -31,8 +34,6 @@
 typedef std::map< RsGxsGroupId, std::map<RsGxsMessageId, std::shared_ptr<RsGxsMsgMetaData> > > MsgMetaFilter;
 typedef std::map< RsGxsGroupId, std::shared_ptr<RsGxsGrpMetaData> > GrpMetaFilter;
 
-bool operator<(const std::pair<uint32_t,GxsRequest*>& p1,const std::pair<uint32_t,GxsRequest*>& p2);
-
 class RsGxsDataAccess : public RsTokenService
 {
 public:
@@ -125,6 +126,10 @@ public:
     /* Poll */
 	GxsRequestStatus requestStatus(uint32_t token);
 
+	/* Wait */
+	GxsRequestStatus waitRequestStatus(
+	        uint32_t token, std::chrono::milliseconds maxWait ) override;
+
     /* Cancel Request */
     bool cancelRequest(const uint32_t &token);
 
@@ -171,10 +176,28 @@ public:
 
 
     /*!
-     * This must be called periodically to progress requests
+     * This must be called periodically to progress requests. Data requests are
+     * processed by the calling thread, while summary requests are handed to
+     * reader threads.
      */
     void processRequests();
 
+    /*!
+     * Blocks the caller until a new request is queued, or until maxWait
+     * elapsed. Lets the owning service thread sleep between ticks while still
+     * serving requests without delay.
+     * @return true if a request was queued since the previous call
+     */
+    bool waitForNewRequests(std::chrono::milliseconds maxWait);
+
+    /*!
+     * Set a function to call when a request is queued, for owners which do
+     * not wait in waitForNewRequests(). Must be set before any request is
+     * queued.
+     */
+    void setNewRequestsCallback(const std::function<void()>& callback)
+    { mNewRequestsCallback = callback; }
+
     /*!
      * @param token
      * @param grpStatistic
@@ -503,6 +526,26 @@ private:
 private:
     bool locked_clearRequest(const uint32_t &token);
 
+    /// Wakes up the threads blocked in waitRequestStatus(). Call it without
+    /// mDataMutex held, after changing the status of some request.
+    void notifyStatusChange();
+
+    /// Takes the first pending request of the given kind out of the queue,
+    /// cleaning up expired and terminated requests on the way.
+    /// @param expired set to true if some requests expired
+    GxsRequest* locked_popRequest(bool summaries, bool& expired);
+
+    /// Serves the request, and makes its result available to the client.
+    void processRequest(GxsRequest* req);
+
+    /// Starts reader threads for pending summary requests, if allowed.
+    void locked_startReaders();
+
+    /// Reader thread loop: serves summary requests until there is none left.
+    void processSummaryRequests();
+
+    static bool isSummaryRequest(const GxsRequest* req);
+
     RsGeneralDataService* mDataStore;
 
     RsMutex mDataMutex; /* protecting below */
@@ -510,10 +553,23 @@ private:
     uint32_t mNextToken;
 	std::map<uint32_t, GxsRequestStatus> mPublicToken;
 
-    std::set<std::pair<uint32_t,GxsRequest*> > mRequestQueue;
+    std::multimap<GxsRequestPriority,GxsRequest*> mRequestQueue;	// FIFO for a given priority
+    uint32_t mActiveReaders;
+    bool mStopReaders;
     std::map<uint32_t, GxsRequest*> mCompletedRequests;
 
     bool mUseMetaCache;
+
+    /* Status change signaling. mStatusGeneration is bumped on every status
+     * change, so that waiters cannot miss a change that happens between
+     * their status check and their wait. */
+    std::mutex mStatusMtx;
+    std::condition_variable mStatusCv;
+    uint64_t mStatusGeneration;
+
+    std::condition_variable mNewRequestsCv;	/* also protected by mStatusMtx */
+    bool mNewRequests;
+    std::function<void()> mNewRequestsCallback;
 };
 
 #endif // RSGXSDATAACCESS_H
@@ -309,6 +309,7 @@ static const uint32_t GROUP_STATS_UPDATE_NB_PEERS             =            2; //
 static const uint32_t MAX_ALLOWED_GXS_MESSAGE_SIZE            =       199000; // 200,000 bytes including signature and headers
 static const uint32_t MIN_DELAY_BETWEEN_GROUP_SEARCH          =           40; // dont search same group more than every 40 secs.
 static const uint32_t SAFETY_DELAY_FOR_UNSUCCESSFUL_UPDATE    =            0; // avoid re-sending the same msg list to a peer who asks twice for the same update in less than this time
+static const uint32_t MAX_RECONCILIATION_CELLS                =         2048; // about 90KB. Larger differences are sent as plain msg lists.
 
 static const uint32_t RS_NXS_ITEM_ENCRYPTION_STATUS_UNKNOWN             = 0x00 ;
 static const uint32_t RS_NXS_ITEM_ENCRYPTION_STATUS_NO_ERROR            = 0x01 ;
@@ -317,6 +318,18 @@ static const uint32_t RS_NXS_ITEM_ENCRYPTION_STATUS_ENCRYPTION_ERROR    = 0x03 ;
 static const uint32_t RS_NXS_ITEM_ENCRYPTION_STATUS_SERIALISATION_ERROR = 0x04 ;
 static const uint32_t RS_NXS_ITEM_ENCRYPTION_STATUS_GXS_KEY_MISSING     = 0x05 ;
 
+// Key of a msg in reconciliation tables, see RsNxsSyncMsgReconItem.
+
+static RsGxsMsgIblt::Key msgReconKey(const RsGxsMessageId& msgId,const RsGxsId& authorId)
+{
+    RsGxsMsgIblt::Key key ;
+
+    memcpy(key.data(),msgId.toByteArray(),RsGxsMessageId::SIZE_IN_BYTES) ;
+    memcpy(key.data()+RsGxsMessageId::SIZE_IN_BYTES,authorId.toByteArray(),RsGxsId::SIZE_IN_BYTES) ;
+
+    return key ;
+}
+
 // Debug system to allow to print only for some IDs (group, Peer, etc)
 
 #if defined(NXS_NET_DEBUG_0) || defined(NXS_NET_DEBUG_1) || defined(NXS_NET_DEBUG_2)  || defined(NXS_NET_DEBUG_3) \
@@ -701,36 +714,7 @@ std::error_condition RsGxsNetService::checkUpdatesFromPeers(
                     updateTS = cit2->second.time_stamp;
             }
 
-            // get sync params for this group
-
-            RsNxsSyncMsgReqItem* msg = new RsNxsSyncMsgReqItem(mServType);
-
-            msg->clear();
-            msg->PeerId(peerId);
-            msg->updateTS = updateTS;
-
-            int req_delay  = (int)locked_getGrpConfig(grpId).msg_req_delay ;
-            int keep_delay = (int)locked_getGrpConfig(grpId).msg_keep_delay ;
-
-            // If we store for less than we request, we request less, otherwise the posts will be deleted after being obtained.
-
-            if(keep_delay > 0 && req_delay > 0 && keep_delay < req_delay)
-                req_delay = keep_delay ;
-
-            // The last post will be set to TS 0 if the req delay is 0, which means "Indefinitly"
-
-            if(req_delay > 0)
-				msg->createdSinceTS = std::max(0,(int)time(NULL) - req_delay);
-			else
-				msg->createdSinceTS = 0 ;
-
-            if(encrypt_to_this_circle_id.isNull())
-                msg->grpId = grpId;
-            else
-            {
-                msg->grpId = hashGrpId(grpId,mNetMgr->getOwnId()) ;
-                msg->flag |= RsNxsSyncMsgReqItem::FLAG_USE_HASHED_GROUP_ID ;
-            }
+            RsNxsSyncMsgReqItem* msg = locked_createSyncMsgReqItem(peerId,grpId,updateTS,encrypt_to_this_circle_id);
 
 #ifdef NXS_NET_DEBUG_7
 	    GXSNETDEBUG_PG(*sit,grpId) << "    Service " << std::hex << ((mServiceInfo.mServiceType >> 8)& 0xffff) << std::dec << "  sending message TS of peer id: " << *sit << " ts=" << nice_time_stamp(time(NULL),updateTS) << " (secs ago) for group " << grpId << " to himself - in clear " << std::endl;
@@ -748,6 +732,48 @@ std::error_condition RsGxsNetService::checkUpdatesFromPeers(
 	return std::error_condition();
 }
 
+RsNxsSyncMsgReqItem *RsGxsNetService::locked_createSyncMsgReqItem(const RsPeerId& peerId,const RsGxsGroupId& grpId,uint32_t updateTS,const RsGxsCircleId& encrypt_to_this_circle_id)
+{
+    // get sync params for this group
+
+    RsNxsSyncMsgReqItem* msg = new RsNxsSyncMsgReqItem(mServType);
+
+    msg->clear();
+    msg->PeerId(peerId);
+    msg->updateTS = updateTS;
+
+    int req_delay  = (int)locked_getGrpConfig(grpId).msg_req_delay ;
+    int keep_delay = (int)locked_getGrpConfig(grpId).msg_keep_delay ;
+
+    // If we store for less than we request, we request less, otherwise the posts will be deleted after being obtained.
+
+    if(keep_delay > 0 && req_delay > 0 && keep_delay < req_delay)
+        req_delay = keep_delay ;
+
+    // The last post will be set to TS 0 if the req delay is 0, which means "Indefinitly"
+
+    if(req_delay > 0)
+        msg->createdSinceTS = std::max(0,(int)time(NULL) - req_delay);
+    else
+        msg->createdSinceTS = 0 ;
+
+    // Peers that know about reconciliation may answer with a table of the differences instead of the whole list of msgs. Older
+    // peers ignore the flag. Encrypted lists are still sent in full, since the table cannot be encrypted per item.
+
+    if(encrypt_to_this_circle_id.isNull())
+    {
+        msg->grpId = grpId;
+        msg->flag |= RsNxsSyncMsgReqItem::FLAG_ACCEPTS_RECONCILIATION ;
+    }
+    else
+    {
+        msg->grpId = hashGrpId(grpId,mNetMgr->getOwnId()) ;
+        msg->flag |= RsNxsSyncMsgReqItem::FLAG_USE_HASHED_GROUP_ID ;
+    }
+
+    return msg ;
+}
+
 void RsGxsNetService::generic_sendItem(rs_owner_ptr<RsItem> si)
 {
 	// check if the item is to be sent to a distant peer or not
@@ -1777,6 +1803,7 @@ void RsGxsNetService::recvNxsItemQueue()
             case RS_PKT_SUBTYPE_NXS_SYNC_MSG_REQ_ITEM:      handleRecvSyncMessage         (dynamic_cast<RsNxsSyncMsgReqItem*>(ni),item_was_encrypted) ; break ;
             case RS_PKT_SUBTYPE_NXS_GRP_PUBLISH_KEY_ITEM:   handleRecvPublishKeys         (dynamic_cast<RsNxsGroupPublishKeyItem*>(ni)) ; break ;
             case RS_PKT_SUBTYPE_NXS_SYNC_PULL_REQUEST_ITEM: handlePullRequest             (dynamic_cast<RsNxsPullRequestItem*>(ni)) ; break ;
+            case RS_PKT_SUBTYPE_NXS_SYNC_MSG_RECON_ITEM:    handleRecvSyncMsgRecon        (dynamic_cast<RsNxsSyncMsgReconItem*>(ni)) ; break ;
 
             default:
                 if(ni->PacketSubType() != RS_PKT_SUBTYPE_NXS_ENCRYPTED_DATA_ITEM)
@@ -1992,11 +2019,17 @@ bool RsGxsNetService::locked_processTransac(RsNxsTransacItem *item)
 
 void RsGxsNetService::threadTick()
 {
-    static const double timeDelta = 0.5;
-
         //Start waiting as nothing to do in runup
-        rstime::rs_usleep((int) (timeDelta * 1000 * 1000)); // timeDelta sec
+        std::this_thread::sleep_for(tickPeriod());
+
+        executorTick();
+}
+
+std::chrono::milliseconds RsGxsNetService::tickPeriod() const
+{ return std::chrono::milliseconds(500); }
 
+void RsGxsNetService::executorTick()
+{
         if(mUpdateCounter >= 120) // 60 seconds
         {
             updateServerSyncTS();
@@ -2909,11 +2942,15 @@ void RsGxsNetService::locked_genReqMsgTransaction(NxsTransaction* tr)
 
     // get grp id for this transaction
     RsNxsSyncMsgItem* item = msgItemL.front();
-    const RsGxsGroupId& grpId = item->grpId;
 
+    locked_requestMissingMsgs(item->PeerId(),item->grpId,msgItemL,msgItemL.size(),tr->mTransaction->updateTS,NULL) ;
+}
+
+void RsGxsNetService::locked_requestMissingMsgs(const RsPeerId& pid,const RsGxsGroupId& grpId,const std::list<RsNxsSyncMsgItem*>& msgItemL,
+                                                uint32_t visibleCount,rstime_t updateTS,const std::set<RsGxsMessageId> *localIds)
+{
     // store the count for the peer who sent the message list
-    uint32_t mcount = msgItemL.size() ;
-    RsPeerId pid = msgItemL.front()->PeerId() ;
+    uint32_t mcount = visibleCount ;
 
     RsGxsGrpConfig& gnsr(locked_getGrpConfig(grpId));
 
@@ -2927,8 +2964,8 @@ void RsGxsNetService::locked_genReqMsgTransaction(NxsTransaction* tr)
         mNewStatsToNotify.insert(grpId) ;
 
 #ifdef NXS_NET_DEBUG_1
-    GXSNETDEBUG_PG(item->PeerId(),grpId) << "  grpId = " << grpId << std::endl;
-    GXSNETDEBUG_PG(item->PeerId(),grpId) << "  retrieving grp mesta data..." << std::endl;
+    GXSNETDEBUG_PG(pid,grpId) << "  grpId = " << grpId << std::endl;
+    GXSNETDEBUG_PG(pid,grpId) << "  retrieving grp mesta data..." << std::endl;
 #endif
     RsGxsGrpMetaTemporaryMap grpMetaMap;
     grpMetaMap[grpId] = NULL;
@@ -2951,7 +2988,7 @@ void RsGxsNetService::locked_genReqMsgTransaction(NxsTransaction* tr)
         std::cerr << "(EE) stepping in part of the code (" << __PRETTY_FUNCTION__ << ") where we shouldn't. This is a bug." << std::endl;
 
 #ifdef TO_REMOVE
-        locked_stampPeerGroupUpdateTime(pid,grpId,tr->mTransaction->updateTS,msgItemL.size()) ;
+        locked_stampPeerGroupUpdateTime(pid,grpId,updateTS,mcount) ;
 #endif
         return ;
     }
@@ -2962,59 +2999,63 @@ void RsGxsNetService::locked_genReqMsgTransaction(NxsTransaction* tr)
         cutoff = grpMeta->mReputationCutOff;
 #endif
 
-    GxsMsgReq reqIds;
-    reqIds[grpId] = std::set<RsGxsMessageId>();
-    GxsMsgMetaResult result;
-    mDataStore->retrieveGxsMsgMetaData(reqIds, result);
-    auto& msgMetaV = result[grpId];
+    std::set<RsGxsMessageId> localMsgIdSet;
+
+    if(!localIds)
+    {
+        GxsMsgReq reqIds;
+        reqIds[grpId] = std::set<RsGxsMessageId>();
+        GxsMsgMetaResult result;
+        mDataStore->retrieveGxsMsgMetaData(reqIds, result);
+        auto& msgMetaV = result[grpId];
 
 #ifdef NXS_NET_DEBUG_1
-    GXSNETDEBUG_PG(item->PeerId(),grpId) << "  retrieving grp message list..." << std::endl;
-    GXSNETDEBUG_PG(item->PeerId(),grpId) << "  grp locally contains " << msgMetaV.size() << " messsages." << std::endl;
+        GXSNETDEBUG_PG(pid,grpId) << "  retrieving grp message list..." << std::endl;
+        GXSNETDEBUG_PG(pid,grpId) << "  grp locally contains " << msgMetaV.size() << " messsages." << std::endl;
 #endif
-    std::set<RsGxsMessageId> msgIdSet;
-
-    // put ids in set for each searching
-    for(auto vit=msgMetaV.begin(); vit != msgMetaV.end(); ++vit)
-        msgIdSet.insert((*vit)->mMsgId);
+        // put ids in set for each searching
+        for(auto vit=msgMetaV.begin(); vit != msgMetaV.end(); ++vit)
+            localMsgIdSet.insert((*vit)->mMsgId);
 
-    msgMetaV.clear();
+        localIds = &localMsgIdSet ;
+    }
+    const std::set<RsGxsMessageId>& msgIdSet(*localIds);
 
 #ifdef NXS_NET_DEBUG_1
-    GXSNETDEBUG_PG(item->PeerId(),grpId) << "  grp locally contains " << msgIdSet.size() << " unique messsages." << std::endl;
+    GXSNETDEBUG_PG(pid,grpId) << "  grp locally contains " << msgIdSet.size() << " unique messsages." << std::endl;
 #endif
     // get unique id for this transaction
     uint32_t transN = locked_getTransactionId();
 
 #ifdef NXS_NET_DEBUG_1
-    GXSNETDEBUG_PG(item->PeerId(),grpId) << "  new transaction ID: " << transN << std::endl;
+    GXSNETDEBUG_PG(pid,grpId) << "  new transaction ID: " << transN << std::endl;
 #endif
     // add msgs that you don't have to request list
-    std::list<RsNxsSyncMsgItem*>::iterator llit = msgItemL.begin();
+    std::list<RsNxsSyncMsgItem*>::const_iterator llit = msgItemL.begin();
     std::list<RsNxsItem*> reqList;
     int reqListSize = 0 ;
 
-    const RsPeerId peerFrom = tr->mTransaction->PeerId();
+    const RsPeerId peerFrom = pid;
 
     std::list<RsPeerId> peers;
-    peers.push_back(tr->mTransaction->PeerId());
+    peers.push_back(pid);
     bool reqListSizeExceeded = false ;
 
 #ifdef NXS_NET_DEBUG_1
-    GXSNETDEBUG_PG(item->PeerId(),grpId) << "  sorting items..." << std::endl;
+    GXSNETDEBUG_PG(pid,grpId) << "  sorting items..." << std::endl;
 #endif
     for(; llit != msgItemL.end(); ++llit)
     {
-        RsNxsSyncMsgItem*& syncItem = *llit;
+        const RsNxsSyncMsgItem *syncItem = *llit;
         const RsGxsMessageId& msgId = syncItem->msgId;
 
 #ifdef NXS_NET_DEBUG_1
-        GXSNETDEBUG_PG(item->PeerId(),grpId) << "  msg ID = " << msgId ;
+        GXSNETDEBUG_PG(pid,grpId) << "  msg ID = " << msgId ;
 #endif
         if(reqListSize >= (int)MAX_REQLIST_SIZE)
         {
 #ifdef NXS_NET_DEBUG_1
-            GXSNETDEBUG_PG(item->PeerId(),grpId) << ". reqlist too big. Pruning out this item for now." << std::endl;
+            GXSNETDEBUG_PG(pid,grpId) << ". reqlist too big. Pruning out this item for now." << std::endl;
 #endif
             reqListSizeExceeded = true ;
             continue ;	// we should actually break, but we need to print some debug info.
@@ -3026,14 +3067,14 @@ void RsGxsNetService::locked_genReqMsgTransaction(NxsTransaction* tr)
             bool noAuthor = syncItem->authorId.isNull();
 
 #ifdef NXS_NET_DEBUG_1
-            GXSNETDEBUG_PG(item->PeerId(),grpId) << ", reqlist size=" << reqListSize << ", message not present." ;
+            GXSNETDEBUG_PG(pid,grpId) << ", reqlist size=" << reqListSize << ", message not present." ;
 #endif
             // grp meta must be present if author present
 
             if(!noAuthor && grpMeta == NULL)
             {
 #ifdef NXS_NET_DEBUG_1
-                GXSNETDEBUG_PG(item->PeerId(),grpId) << ", no group meta found. Givign up." << std::endl;
+                GXSNETDEBUG_PG(pid,grpId) << ", no group meta found. Givign up." << std::endl;
 #endif
                 continue;
             }
@@ -3048,7 +3089,7 @@ void RsGxsNetService::locked_genReqMsgTransaction(NxsTransaction* tr)
 			        RsReputationLevel::LOCALLY_NEGATIVE )
             {
 #ifdef NXS_NET_DEBUG_1
-                GXSNETDEBUG_PG(item->PeerId(),grpId) << ", Identity " << syncItem->authorId << " is banned. Not requesting message!" << std::endl;
+                GXSNETDEBUG_PG(pid,grpId) << ", Identity " << syncItem->authorId << " is banned. Not requesting message!" << std::endl;
 #endif
                 continue ;
             }
@@ -3056,13 +3097,13 @@ void RsGxsNetService::locked_genReqMsgTransaction(NxsTransaction* tr)
             if(mRejectedMessages.find(msgId) != mRejectedMessages.end())
             {
 #ifdef NXS_NET_DEBUG_1
-                GXSNETDEBUG_PG(item->PeerId(),grpId) << ", message has been recently rejected. Not requesting message!" << std::endl;
+                GXSNETDEBUG_PG(pid,grpId) << ", message has been recently rejected. Not requesting message!" << std::endl;
 #endif
                 continue ;
             }
 
 #ifdef NXS_NET_DEBUG_1
-			GXSNETDEBUG_PG(item->PeerId(),grpId) << ", passed! Adding message to req list." << std::endl;
+			GXSNETDEBUG_PG(pid,grpId) << ", passed! Adding message to req list." << std::endl;
 #endif
 			RsNxsSyncMsgItem* msgItem = new RsNxsSyncMsgItem(mServType);
 			msgItem->grpId = grpId;
@@ -3075,36 +3116,36 @@ void RsGxsNetService::locked_genReqMsgTransaction(NxsTransaction* tr)
         }
 #ifdef NXS_NET_DEBUG_1
         else
-            GXSNETDEBUG_PG(item->PeerId(),grpId) << ". already here." << std::endl;
+            GXSNETDEBUG_PG(pid,grpId) << ". already here." << std::endl;
 #endif
     }
 
     if(!reqList.empty())
     {
 #ifdef NXS_NET_DEBUG_1
-        GXSNETDEBUG_PG(item->PeerId(),grpId) << "  Request list: " << reqList.size() << " elements." << std::endl;
+        GXSNETDEBUG_PG(pid,grpId) << "  Request list: " << reqList.size() << " elements." << std::endl;
 #endif
-        locked_pushMsgTransactionFromList(reqList, tr->mTransaction->PeerId(), transN);
+        locked_pushMsgTransactionFromList(reqList, pid, transN);
 
         if(reqListSizeExceeded)
         {
 #ifdef NXS_NET_DEBUG_1
-            GXSNETDEBUG_PG(item->PeerId(),grpId) << "  Marking update operation as unfinished." << std::endl;
+            GXSNETDEBUG_PG(pid,grpId) << "  Marking update operation as unfinished." << std::endl;
 #endif
-            mPartialMsgUpdates[tr->mTransaction->PeerId()].insert(item->grpId) ;
+            mPartialMsgUpdates[pid].insert(grpId) ;
         }
         else
         {
 #ifdef NXS_NET_DEBUG_1
-            GXSNETDEBUG_PG(item->PeerId(),grpId) << "  Marking update operation as terminal." << std::endl;
+            GXSNETDEBUG_PG(pid,grpId) << "  Marking update operation as terminal." << std::endl;
 #endif
-            mPartialMsgUpdates[tr->mTransaction->PeerId()].erase(item->grpId) ;
+            mPartialMsgUpdates[pid].erase(grpId) ;
         }
     }
     else
     {
 #ifdef NXS_NET_DEBUG_1
-	    GXSNETDEBUG_PG(item->PeerId(),grpId) << "  Request list is empty. Not doing anything. " << std::endl;
+	    GXSNETDEBUG_PG(pid,grpId) << "  Request list is empty. Not doing anything. " << std::endl;
 #endif
 	    // The list to req is empty. That means we already have all messages that this peer can
 	    // provide. So we can stamp the group from this peer to be up to date.
@@ -3113,7 +3154,7 @@ void RsGxsNetService::locked_genReqMsgTransaction(NxsTransaction* tr)
             // - the GroupStats exchange system, which counts the messages at each peer. It could also supply TS for the messages, but it does not for the time being
             // - client TS are updated when receiving messages
 
-	    locked_stampPeerGroupUpdateTime(pid,grpId,tr->mTransaction->updateTS,msgItemL.size()) ;
+	    locked_stampPeerGroupUpdateTime(pid,grpId,updateTS,mcount) ;
     }
 }
 
@@ -4450,6 +4491,8 @@ void RsGxsNetService::handleRecvSyncMessage(RsNxsSyncMsgReqItem *item,bool item_
     uint32_t max_send_delay = locked_getGrpConfig(item->grpId).msg_req_delay;	// we should use "sync" but there's only one variable used in the GUI: the req one.
 #endif
 
+    uint32_t nb_recent_msgs = 0 ;
+
     if(canSendMsgIds(msgMetas, *grpMeta, peer, should_encrypt_to_this_circle_id))
     {
 	    for(auto vit = msgMetas.begin();vit != msgMetas.end(); ++vit)
@@ -4491,6 +4534,11 @@ void RsGxsNetService::handleRecvSyncMessage(RsNxsSyncMsgReqItem *item,bool item_
 				continue ;
 			}
 
+			// Msgs received after the peer's last update are most likely the ones it misses.
+
+			if(m->recvTS > item->updateTS)
+				++nb_recent_msgs ;
+
 			RsNxsSyncMsgItem* mItem = new RsNxsSyncMsgItem(mServType);
 			mItem->flag = RsNxsSyncGrpItem::FLAG_RESPONSE;
 			mItem->grpId = m->mGroupId;
@@ -4540,6 +4588,53 @@ void RsGxsNetService::handleRecvSyncMessage(RsNxsSyncMsgReqItem *item,bool item_
 	    GXSNETDEBUG_PG(item->PeerId(),item->grpId) << "  vetting forbids sending. Nothing will be sent." << itemL.size() << " items." << std::endl;
 #endif
 
+    // Peers who accept it get a reconciliation table instead of the list, when the table is smaller. Encrypted lists are always
+    // sent in full.
+
+    if(!itemL.empty() && should_encrypt_to_this_circle_id.isNull() && (item->flag & RsNxsSyncMsgReqItem::FLAG_ACCEPTS_RECONCILIATION))
+    {
+	    RsNxsSerialiser ser(mServType) ;
+
+	    uint32_t nb_cells  = RsGxsMsgIblt::cellsForDifference(nb_recent_msgs) ;
+	    uint32_t list_size = itemL.size() * ser.size(itemL.front()) ;
+
+	    if(nb_cells <= MAX_RECONCILIATION_CELLS && nb_cells * RsGxsMsgIblt::CELL_SIZE < list_size)
+	    {
+		    RsGxsMsgIblt table(nb_cells) ;
+
+		    for(std::list<RsNxsItem*>::const_iterator it(itemL.begin());it!=itemL.end();++it)
+		    {
+			    const RsNxsSyncMsgItem *mItem = static_cast<RsNxsSyncMsgItem*>(*it) ;
+			    table.insert(msgReconKey(mItem->msgId,mItem->authorId)) ;
+			    delete *it ;
+		    }
+
+		    std::vector<uint8_t> cells ;
+		    table.toBytes(cells) ;
+
+		    RsNxsSyncMsgReconItem *reconItem = new RsNxsSyncMsgReconItem(mServType) ;
+
+		    reconItem->PeerId(peer) ;
+		    reconItem->grpId = item->grpId ;
+		    reconItem->updateTS = mServerMsgUpdateMap[item->grpId].msgUpdateTS ;
+		    reconItem->msgCount = itemL.size() ;
+		    reconItem->cells.setBinData(cells.data(),cells.size()) ;
+
+		    // Lets the peer leave out of its own table the msgs we did not consider.
+#ifndef RS_GXS_SEND_ALL
+		    reconItem->createdSinceTS = (max_send_delay > 0) ? std::max((rstime_t)item->createdSinceTS,now - max_send_delay) : item->createdSinceTS ;
+#else
+		    reconItem->createdSinceTS = item->createdSinceTS ;
+#endif
+		    itemL.clear() ;
+
+#ifdef NXS_NET_DEBUG_0
+		    GXSNETDEBUG_PG(item->PeerId(),item->grpId) << "  sending reconciliation table of " << table.cellCount() << " cells for " << reconItem->msgCount << " msgs, " << nb_recent_msgs << " recent ones." << std::endl;
+#endif
+		    generic_sendItem(reconItem) ;
+	    }
+    }
+
     if(!itemL.empty())
     {
 #ifdef NXS_NET_DEBUG_0
@@ -4558,6 +4653,116 @@ void RsGxsNetService::handleRecvSyncMessage(RsNxsSyncMsgReqItem *item,bool item_
 	//     delete *vit;
 }
 
+void RsGxsNetService::handleRecvSyncMsgRecon(RsNxsSyncMsgReconItem *item)
+{
+    if (!item)
+	    return;
+
+    RS_STACK_MUTEX(mNxsMutex) ;
+
+    const RsPeerId& peer = item->PeerId();
+
+#ifdef NXS_NET_DEBUG_0
+    GXSNETDEBUG_PG(peer,item->grpId) << "handleRecvSyncMsgRecon(): received reconciliation table of " << item->cells.bin_len << " bytes for " << item->msgCount << " msgs" << std::endl;
+#endif
+    RsGxsMsgIblt table ;
+
+    if(!table.fromBytes((const uint8_t*)item->cells.bin_data,item->cells.bin_len,MAX_RECONCILIATION_CELLS))
+    {
+	    std::cerr << "(EE) received invalid msg reconciliation table from peer " << peer << " for group " << item->grpId << ". Dropping it." << std::endl;
+	    return ;
+    }
+
+    // The table is only sent in answer to our requests, so we check the same things as when sending them (see syncWithPeers).
+
+    RsGxsGrpMetaTemporaryMap grpMetaMap;
+    grpMetaMap[item->grpId] = NULL;
+
+    mDataStore->retrieveGxsGrpMetaData(grpMetaMap);
+    const auto& grpMeta = grpMetaMap[item->grpId];
+
+    RsGxsCircleId encrypt_to_this_circle_id ;
+
+    if(grpMeta == NULL || !(grpMeta->mSubscribeFlags & GXS_SERV::GROUP_SUBSCRIBE_SUBSCRIBED)
+            || !checkCanRecvMsgFromPeer(peer,*grpMeta,encrypt_to_this_circle_id) || !encrypt_to_this_circle_id.isNull())
+    {
+#ifdef NXS_NET_DEBUG_0
+	    GXSNETDEBUG_PG(peer,item->grpId) << "  group is unknown, unsubscribed or cannot be synced in clear with this peer. Dropping the table." << std::endl;
+#endif
+	    return ;
+    }
+
+    GxsMsgReq reqIds;
+    reqIds[item->grpId] = std::set<RsGxsMessageId>();
+    GxsMsgMetaResult result;
+    mDataStore->retrieveGxsMsgMetaData(reqIds, result);
+    const auto& msgMetaV = result[item->grpId];
+
+    // Our msgs are removed from the peer's table, which leaves the msgs we miss, and the ones the peer did not include.
+
+    std::set<RsGxsMessageId> localIds;
+    RsGxsMsgIblt ownTable(table.cellCount()) ;
+
+    for(auto vit=msgMetaV.begin(); vit != msgMetaV.end(); ++vit)
+    {
+	    localIds.insert((*vit)->mMsgId);
+
+	    if((*vit)->mPublishTs >= item->createdSinceTS)
+		    ownTable.insert(msgReconKey((*vit)->mMsgId,(*vit)->mAuthorId)) ;
+    }
+
+    table.subtract(ownTable) ;
+
+    std::vector<RsGxsMsgIblt::Key> missing, not_offered ;
+
+    if(!table.decode(missing,not_offered))
+    {
+	    // Too many differences for the table. We ask for the plain list, which the peer sends since our time stamp has not changed.
+
+#ifdef NXS_NET_DEBUG_0
+	    GXSNETDEBUG_PG(peer,item->grpId) << "  cannot decode the table. Asking for the full msg list." << std::endl;
+#endif
+	    uint32_t updateTS = 0;
+	    ClientMsgMap::const_iterator cit = mClientMsgUpdateMap.find(peer);
+
+	    if(cit != mClientMsgUpdateMap.end())
+	    {
+		    std::map<RsGxsGroupId, RsGxsMsgUpdateItem::MsgUpdateInfo>::const_iterator cit2 = cit->second.msgUpdateInfos.find(item->grpId);
+
+		    if(cit2 != cit->second.msgUpdateInfos.end())
+			    updateTS = cit2->second.time_stamp;
+	    }
+
+	    RsNxsSyncMsgReqItem *req = locked_createSyncMsgReqItem(peer,item->grpId,updateTS,encrypt_to_this_circle_id) ;
+	    req->flag &= ~RsNxsSyncMsgReqItem::FLAG_ACCEPTS_RECONCILIATION ;
+
+	    generic_sendItem(req) ;
+	    return ;
+    }
+
+#ifdef NXS_NET_DEBUG_0
+    GXSNETDEBUG_PG(peer,item->grpId) << "  decoded " << missing.size() << " missing msgs, " << not_offered.size() << " msgs not offered by the peer." << std::endl;
+#endif
+    std::list<RsNxsSyncMsgItem*> msgItemL;
+
+    for(uint32_t i=0;i<missing.size();++i)
+    {
+	    RsNxsSyncMsgItem* mItem = new RsNxsSyncMsgItem(mServType);
+	    mItem->flag = RsNxsSyncMsgItem::FLAG_RESPONSE;
+	    mItem->grpId = item->grpId;
+	    mItem->msgId = RsGxsMessageId::fromBufferUnsafe(missing[i].data());
+	    mItem->authorId = RsGxsId::fromBufferUnsafe(missing[i].data() + RsGxsMessageId::SIZE_IN_BYTES);
+	    mItem->PeerId(peer);
+
+	    msgItemL.push_back(mItem);
+    }
+
+    locked_requestMissingMsgs(peer,item->grpId,msgItemL,item->msgCount,item->updateTS,&localIds) ;
+
+    for(std::list<RsNxsSyncMsgItem*>::const_iterator it(msgItemL.begin());it!=msgItemL.end();++it)
+	    delete *it ;
+}
+
 void RsGxsNetService::locked_pushMsgRespFromList(std::list<RsNxsItem*>& itemL, const RsPeerId& sslId, const RsGxsGroupId& grp_id,const uint32_t& transN)
 {
 #ifdef NXS_NET_DEBUG_1
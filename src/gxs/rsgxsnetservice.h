@@ -248,6 +248,8 @@ public:
     int tick()override ;
 
 	void threadTick() override; /// @see RsTickingThread
+	void executorTick() override; /// @see RsTickingThread
+	std::chrono::milliseconds tickPeriod() const override; /// @see RsTickingThread
 
 
 	/// @see RsNetworkExchangeService
@@ -350,6 +352,25 @@ private:
      */
     void locked_genReqMsgTransaction(NxsTransaction* tr);
 
+    /*!
+     * Requests the msgs of a list offered by a peer that we do not have yet,
+     * or stamps the group as up to date for that peer if there are none.
+     * @param pid peer who sent the list
+     * @param msgItemL msgs offered by the peer for the group
+     * @param visibleCount number of msgs the peer offers, for statistics
+     * @param updateTS peer's time stamp of the list
+     * @param localIds msgs we already have, retrieved if NULL
+     */
+    void locked_requestMissingMsgs(const RsPeerId& pid, const RsGxsGroupId& grpId, const std::list<RsNxsSyncMsgItem*>& msgItemL,
+                                   uint32_t visibleCount, rstime_t updateTS, const std::set<RsGxsMessageId> *localIds);
+
+    /*!
+     * Creates the request for the msg list of a group
+     * @param updateTS last time stamp received from that peer for the group
+     * @param encrypt_to_this_circle_id when not null, the grp id is hashed
+     */
+    RsNxsSyncMsgReqItem *locked_createSyncMsgReqItem(const RsPeerId& peerId, const RsGxsGroupId& grpId, uint32_t updateTS, const RsGxsCircleId& encrypt_to_this_circle_id);
+
     /*!
      * Generates new transaction to send grp requests based on list
      * of grps received from peer stored in passed transaction
@@ -425,6 +446,14 @@ private:
      */
     void handleRecvSyncMessage(RsNxsSyncMsgReqItem* item,bool item_was_encrypted);
 
+    /*!
+     * Handles the reconciliation table sent in place of a msg list, and
+     * requests the msgs it holds that we do not have. Falls back to asking for
+     * the full list when the table cannot be decoded.
+     * @param item contains the table of the msgs offered by the peer
+     */
+    void handleRecvSyncMsgRecon(RsNxsSyncMsgReconItem* item);
+
     /*!
      * Handles an nxs item for group publish key
      * @param item contaims keys/grp info
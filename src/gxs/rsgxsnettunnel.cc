@@ -41,7 +41,7 @@ static const uint32_t RS_GXS_NET_TUNNEL_MAX_ALLOWED_HITS_GROUP_DATA    =   1;
 static const uint32_t RS_GXS_NET_TUNNEL_MAX_ALLOWED_HITS_GROUP_SEARCH  = 100;
 
 
-RsGxsNetTunnelService::RsGxsNetTunnelService(): mGxsNetTunnelMtx("GxsNetTunnel")
+RsGxsNetTunnelService::RsGxsNetTunnelService(): mTurtle(nullptr), mGxsNetTunnelMtx("GxsNetTunnel")
 {
 	mRandomBias.clear();
 
@@ -524,6 +524,9 @@ bool RsGxsNetTunnelService::requestDistantPeers(uint16_t service_id, const RsGxs
 	ginfo.hash         = calculateGroupHash(group_id) ;
 	ginfo.service_id   = service_id;
 
+	if(mHandledHashes.find(ginfo.hash) == mHandledHashes.end() && mTurtle != nullptr)
+		mTurtle->invalidateTunnelRequestFilter(this) ;
+
 	mHandledHashes[ginfo.hash] = group_id ;
 
 	// we dont set the group policy here. It will only be set if no peers, or too few peers are available.
@@ -545,9 +548,13 @@ bool RsGxsNetTunnelService::releaseDistantPeers(uint16_t /* service_id */,const
     ginfo.group_policy = RsGxsNetTunnelGroupInfo::RS_GXS_NET_TUNNEL_GRP_POLICY_PASSIVE;
 	ginfo.hash         = calculateGroupHash(group_id) ;
 
+	if(mHandledHashes.find(ginfo.hash) == mHandledHashes.end() && mTurtle != nullptr)
+		mTurtle->invalidateTunnelRequestFilter(this) ;
+
 	mHandledHashes[ginfo.hash] = group_id ;	// yes, we do not remove, because we're supposed to answer tunnel requests from other peers.
 
-	mTurtle->stopMonitoringTunnels(ginfo.hash) ;
+	if(mTurtle != nullptr)
+		mTurtle->stopMonitoringTunnels(ginfo.hash) ;
 
 #ifdef DEBUG_RSGXSNETTUNNEL
     GXS_NET_TUNNEL_DEBUG() << " releasing peers for group " << group_id << std::endl;
@@ -636,6 +643,18 @@ bool RsGxsNetTunnelService::handleTunnelRequest(const RsFileHash &hash,const RsP
 	return mHandledHashes.find(hash) != mHandledHashes.end();
 }
 
+bool RsGxsNetTunnelService::buildTunnelRequestFilter(RsBloomFilter& filter)
+{
+	RS_STACK_MUTEX(mGxsNetTunnelMtx);
+
+	filter.reset(mHandledHashes.size());
+
+	for(auto it(mHandledHashes.begin());it!=mHandledHashes.end();++it)
+		filter.insert(it->first);
+
+	return true;
+}
+
 void RsGxsNetTunnelService::receiveTurtleData(const RsTurtleGenericTunnelItem *item, const RsFileHash& hash, const RsPeerId& turtle_virtual_peer_id, RsTurtleGenericTunnelItem::Direction direction)
 {
 	RS_STACK_MUTEX(mGxsNetTunnelMtx);
@@ -881,6 +900,21 @@ void RsGxsNetTunnelService::generateEncryptionKey(const RsGxsGroupId& group_id,c
 //===========================================================================================================================================//
 
 void RsGxsNetTunnelService::threadTick()
+{
+	executorTick();
+
+    for(uint32_t i=0;i<2;++i)
+    {
+        if(shouldStop())
+            return;
+        rstime::rs_usleep(500*1000) ; // 1 sec
+    }
+}
+
+std::chrono::milliseconds RsGxsNetTunnelService::tickPeriod() const
+{ return std::chrono::milliseconds(1000); }
+
+void RsGxsNetTunnelService::executorTick()
 {
 	while(!mPendingTurtleItems.empty())
 	{
@@ -913,13 +947,6 @@ void RsGxsNetTunnelService::threadTick()
 		dump();
 	}
 #endif
-
-    for(uint32_t i=0;i<2;++i)
-    {
-        if(shouldStop())
-            return;
-        rstime::rs_usleep(500*1000) ; // 1 sec
-    }
 }
 
 const Bias20Bytes& RsGxsNetTunnelService::locked_randomBias()
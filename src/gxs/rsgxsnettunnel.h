@@ -216,6 +216,8 @@ public:
 
 	/// @see RsTickingThread
 	void threadTick() override;
+	void executorTick() override;
+	std::chrono::milliseconds tickPeriod() const override;
 
 	  // Overloads p3Config
 
@@ -239,6 +241,7 @@ protected:
 	  // interaction with turtle router
 
 	  virtual bool handleTunnelRequest(const RsFileHash &hash,const RsPeerId& peer_id) ;
+	  virtual bool buildTunnelRequestFilter(RsBloomFilter& filter) ;
 	  virtual void receiveTurtleData(const RsTurtleGenericTunnelItem *item,const RsFileHash& hash,const RsPeerId& virtual_peer_id,RsTurtleGenericTunnelItem::Direction direction) ;
 	  void addVirtualPeer(const TurtleFileHash&, const TurtleVirtualPeerId&,RsTurtleGenericTunnelItem::Direction dir) ;
 	  void removeVirtualPeer(const TurtleFileHash&, const TurtleVirtualPeerId&) ;
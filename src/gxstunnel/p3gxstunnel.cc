@@ -54,6 +54,8 @@ static const uint32_t RS_GXS_TUNNEL_DATA_PRINT_STORAGE_DELAY = 600 ; // store ol
 static const uint32_t GXS_TUNNEL_ENCRYPTION_HMAC_SIZE    = SHA_DIGEST_LENGTH ;
 static const uint32_t GXS_TUNNEL_ENCRYPTION_IV_SIZE      = 8 ;
 
+static const char GXS_TUNNEL_AEAD_INFO[] = "RetroShare GXS tunnel chacha20-poly1305 v1" ;	// HKDF info of the AEAD keys
+
 #ifdef DEBUG_GXS_TUNNEL
 static const uint32_t INTERVAL_BETWEEN_DEBUG_DUMP        = 10 ;
 #endif
@@ -457,6 +459,19 @@ void p3GxsTunnelService::handleRecvStatusItem(const RsGxsTunnelId& tunnel_id, Rs
     }
 	    break ;
 
+    case RS_GXS_TUNNEL_FLAG_AEAD_CHACHA20_POLY1305_V1:
+    {
+	    RS_STACK_MUTEX(mGxsTunnelMtx); /********** STACK LOCKED MTX ******/
+
+	    std::map<RsGxsTunnelId,GxsTunnelPeerInfo>::iterator it = _gxs_tunnel_contacts.find(tunnel_id) ;
+
+	    // The announce was encrypted with the keys of the current DH session, so it is about that session.
+
+	    if(it != _gxs_tunnel_contacts.end() && it->second.aead_session)
+		    it->second.peer_reads_aead = true ;
+    }
+	    break ;
+
     default:
 	    std::cerr << "(EE) unhandled tunnel status " << std::hex << cs->status << std::dec << std::endl;
 	    break ;
@@ -756,11 +771,16 @@ void p3GxsTunnelService::receiveTurtleData(const RsTurtleGenericTunnelItem *gite
         // case only.
         RsGxsTunnelDHPublicKeyItem *dhitem = dynamic_cast<RsGxsTunnelDHPublicKeyItem*>(citem) ;
         
+        // AEAD items carry their own authentication, so they do not need the AES-CBC+HMAC envelope.
+        RsGxsTunnelAEADDataItem *aitem = dynamic_cast<RsGxsTunnelAEADDataItem*>(citem) ;
+
         if(dhitem != NULL)
         {
             dhitem->PeerId(virtual_peer_id) ;
             handleRecvDHPublicKey(dhitem) ;
         }
+        else if(aitem != NULL)
+            handleAEADData(aitem,hash,virtual_peer_id,accept_fast_items) ;
         else
             std::cerr << "(EE) Deserialiased item has unexpected type." << std::endl;
 
@@ -796,71 +816,53 @@ bool p3GxsTunnelService::handleEncryptedData(const uint8_t *data_bytes,uint32_t
         uint8_t *encrypted_data = (uint8_t*)data_bytes+GXS_TUNNEL_ENCRYPTION_IV_SIZE+GXS_TUNNEL_ENCRYPTION_HMAC_SIZE;
         
         RsTemporaryMemory decrypted_data(decrypted_size);
-        uint8_t aes_key[GXS_TUNNEL_AES_KEY_SIZE] ;
         
         if(!decrypted_data)
             return false ;
 
-        std::map<TurtleVirtualPeerId,GxsTunnelDHInfo>::iterator it = _gxs_tunnel_virtual_peer_ids.find(virtual_peer_id) ;
-
-        if(it == _gxs_tunnel_virtual_peer_ids.end())
-        {
-            std::cerr << "(EE) item is not coming out of a registered tunnel. Weird. hash=" << hash << ", peer id = " << virtual_peer_id << std::endl;
-            return false ;
-        }
-
-        tunnel_id = it->second.tunnel_id ;
-        std::map<RsGxsTunnelId,GxsTunnelPeerInfo>::iterator it2 = _gxs_tunnel_contacts.find(tunnel_id) ;
-
-        if(it2 == _gxs_tunnel_contacts.end())
-        {
-            std::cerr << "(EE) no tunnel data for tunnel ID=" << tunnel_id << ". This is a bug." << std::endl;
-            return false ;
-        }
 #ifndef V07_NON_BACKWARD_COMPATIBLE_CHANGE_004
-        if(accepts_fast_items)
-        {
-            if(!it2->second.accepts_fast_turtle_items)
-                std::cerr << "(II) received probe for Fast track turtle items for tunnel VPID " << it2->second.virtual_peer_id << ": switching to Fast items mode." << std::endl;
-
-            it2->second.accepts_fast_turtle_items = true;
-        }
+        GxsTunnelPeerInfo *pinfo = locked_findReceivingTunnel(hash,virtual_peer_id,accepts_fast_items,tunnel_id) ;
+#else
+        GxsTunnelPeerInfo *pinfo = locked_findReceivingTunnel(hash,virtual_peer_id,true,tunnel_id) ;
 #endif
 
-        memcpy(aes_key,it2->second.aes_key,GXS_TUNNEL_AES_KEY_SIZE) ;
+        if(pinfo == NULL)
+            return false ;
+
+        RsAESSession& session(pinfo->cryptoSession()) ;
 
 #ifdef DEBUG_GXS_TUNNEL
         std::cerr << "   Using IV: " << std::hex << *(uint64_t*)data_bytes << std::dec << std::endl;
         std::cerr << "   Decrypted buffer size: " << decrypted_size << std::endl;
-        std::cerr << "   key  : " << RsUtil::BinToHex((unsigned char*)aes_key,GXS_TUNNEL_AES_KEY_SIZE) << std::endl;
+        std::cerr << "   key  : " << RsUtil::BinToHex((unsigned char*)pinfo->aes_key,GXS_TUNNEL_AES_KEY_SIZE) << std::endl;
         std::cerr << "   hmac : " << RsUtil::BinToHex((unsigned char*)data_bytes+GXS_TUNNEL_ENCRYPTION_IV_SIZE,GXS_TUNNEL_ENCRYPTION_HMAC_SIZE) << std::endl;
         std::cerr << "   data : " << RsUtil::BinToHex((unsigned char*)data_bytes,data_size,100) << std::endl;
 #endif
         // first, check the HMAC
         
-        unsigned char *hm = HMAC(EVP_sha1(),aes_key,GXS_TUNNEL_AES_KEY_SIZE,encrypted_data,encrypted_size,NULL,NULL) ;
+        unsigned char hm[GXS_TUNNEL_ENCRYPTION_HMAC_SIZE] ;
         
-        if(memcmp(hm,&data_bytes[GXS_TUNNEL_ENCRYPTION_IV_SIZE],GXS_TUNNEL_ENCRYPTION_HMAC_SIZE))
+        if(!session.hmac(encrypted_data,encrypted_size,hm) || memcmp(hm,&data_bytes[GXS_TUNNEL_ENCRYPTION_IV_SIZE],GXS_TUNNEL_ENCRYPTION_HMAC_SIZE))
         {
             std::cerr << "(EE) packet HMAC does not match. Computed HMAC=" << RsUtil::BinToHex((char*)hm,GXS_TUNNEL_ENCRYPTION_HMAC_SIZE) << std::endl;
             std::cerr << "(EE) resetting new DH session." << std::endl;
 
-            locked_restartDHSession(virtual_peer_id,it2->second.own_gxs_id) ;
+            locked_restartDHSession(virtual_peer_id,pinfo->own_gxs_id) ;
 
             return false ;
         }
 
-        if(!RsAES::aes_decrypt_8_16(encrypted_data,encrypted_size, aes_key,(uint8_t*)data_bytes,decrypted_data,decrypted_size))
+        if(!session.decrypt(encrypted_data,encrypted_size,data_bytes,decrypted_data,decrypted_size))
         {
             std::cerr << "(EE) packet decryption failed." << std::endl;
             std::cerr << "(EE) resetting new DH session." << std::endl;
 
-            locked_restartDHSession(virtual_peer_id,it2->second.own_gxs_id) ;
+            locked_restartDHSession(virtual_peer_id,pinfo->own_gxs_id) ;
 
             return false ;
         }
-        it2->second.status = RS_GXS_TUNNEL_STATUS_CAN_TALK ;
-        it2->second.last_contact = time(NULL) ;
+        pinfo->status = RS_GXS_TUNNEL_STATUS_CAN_TALK ;
+        pinfo->last_contact = time(NULL) ;
 
 #ifdef DEBUG_GXS_TUNNEL
         std::cerr << "(II) Decrypted data: size=" << decrypted_size << std::endl;
@@ -876,7 +878,7 @@ bool p3GxsTunnelService::handleEncryptedData(const uint8_t *data_bytes,uint32_t
             return true;
         }
 
-        it2->second.total_received += decrypted_size ;
+        pinfo->total_received += decrypted_size ;
         
         // DH key items are sent even before we know who we speak to, so the virtual peer id is used in this
         // case only.
@@ -892,6 +894,104 @@ bool p3GxsTunnelService::handleEncryptedData(const uint8_t *data_bytes,uint32_t
     return true ;
 }
 
+p3GxsTunnelService::GxsTunnelPeerInfo *p3GxsTunnelService::locked_findReceivingTunnel(const TurtleFileHash& hash,const RsPeerId& virtual_peer_id,bool accepts_fast_items,RsGxsTunnelId& tunnel_id)
+{
+    std::map<TurtleVirtualPeerId,GxsTunnelDHInfo>::iterator it = _gxs_tunnel_virtual_peer_ids.find(virtual_peer_id) ;
+
+    if(it == _gxs_tunnel_virtual_peer_ids.end())
+    {
+        std::cerr << "(EE) item is not coming out of a registered tunnel. Weird. hash=" << hash << ", peer id = " << virtual_peer_id << std::endl;
+        return NULL ;
+    }
+
+    tunnel_id = it->second.tunnel_id ;
+    std::map<RsGxsTunnelId,GxsTunnelPeerInfo>::iterator it2 = _gxs_tunnel_contacts.find(tunnel_id) ;
+
+    if(it2 == _gxs_tunnel_contacts.end())
+    {
+        std::cerr << "(EE) no tunnel data for tunnel ID=" << tunnel_id << ". This is a bug." << std::endl;
+        return NULL ;
+    }
+#ifndef V07_NON_BACKWARD_COMPATIBLE_CHANGE_004
+    if(accepts_fast_items)
+    {
+        if(!it2->second.accepts_fast_turtle_items)
+            std::cerr << "(II) received probe for Fast track turtle items for tunnel VPID " << it2->second.virtual_peer_id << ": switching to Fast items mode." << std::endl;
+
+        it2->second.accepts_fast_turtle_items = true;
+    }
+#else
+    (void) accepts_fast_items ;
+#endif
+
+    return &it2->second ;
+}
+
+bool p3GxsTunnelService::handleAEADData(RsGxsTunnelAEADDataItem *item,const TurtleFileHash& hash,const RsPeerId& virtual_peer_id,bool accepts_fast_items)
+{
+#ifdef DEBUG_GXS_TUNNEL
+    std::cerr << "p3GxsTunnelService::handleAEADData()" << std::endl;
+    std::cerr << "   mode    = " << item->mode << std::endl;
+    std::cerr << "   counter = " << item->counter << std::endl;
+    std::cerr << "   size    = " << item->data_size << std::endl;
+#endif
+
+    RsGxsTunnelItem *citem = NULL;
+    RsGxsTunnelId tunnel_id;
+
+    {
+        RS_STACK_MUTEX(mGxsTunnelMtx); /********** STACK LOCKED MTX ******/
+
+        GxsTunnelPeerInfo *pinfo = locked_findReceivingTunnel(hash,virtual_peer_id,accepts_fast_items,tunnel_id) ;
+
+        if(pinfo == NULL)
+            return false ;
+
+        // We never announce another mode, so anything else is garbage, just like a wrong tag.
+
+        if(item->mode != RS_GXS_TUNNEL_AEAD_MODE_CHACHA20_POLY1305_V1 || item->data_size < RsAEADSession::TAG_SIZE || !pinfo->aead_session)
+        {
+            std::cerr << "(EE) unexpected AEAD packet: mode=" << item->mode << ", size=" << item->data_size << std::endl;
+            std::cerr << "(EE) resetting new DH session." << std::endl;
+
+            locked_restartDHSession(virtual_peer_id,pinfo->own_gxs_id) ;
+
+            return false ;
+        }
+
+        uint32_t decrypted_size = item->data_size - RsAEADSession::TAG_SIZE ;
+
+        if(!pinfo->aead_session->decrypt(item->data,decrypted_size,item->counter,item->data+decrypted_size))
+        {
+            std::cerr << "(EE) packet authentication failed." << std::endl;
+            std::cerr << "(EE) resetting new DH session." << std::endl;
+
+            locked_restartDHSession(virtual_peer_id,pinfo->own_gxs_id) ;
+
+            return false ;
+        }
+        pinfo->status = RS_GXS_TUNNEL_STATUS_CAN_TALK ;
+        pinfo->last_contact = time(NULL) ;
+
+        // Now try deserialise the decrypted data to make an RsItem out of it.
+        //
+        citem = dynamic_cast<RsGxsTunnelItem*>(RsGxsTunnelSerialiser().deserialise(item->data,&decrypted_size)) ;
+
+        if(citem == NULL)
+        {
+            std::cerr << "(EE) item could not be de-serialized. That is an error." << std::endl;
+            return true;
+        }
+
+        pinfo->total_received += decrypted_size ;
+        citem->PeerId(virtual_peer_id) ;
+    }
+
+    handleIncomingItem(tunnel_id,citem) ; // Treats the item, and deletes it
+
+    return true ;
+}
+
 void p3GxsTunnelService::handleRecvDHPublicKey(RsGxsTunnelDHPublicKeyItem *item)
 {
     if (!item)
@@ -1029,6 +1129,14 @@ void p3GxsTunnelService::handleRecvDHPublicKey(RsGxsTunnelDHPublicKeyItem *item)
 
     assert(GXS_TUNNEL_AES_KEY_SIZE <= Sha1CheckSum::SIZE_IN_BYTES) ;
     memcpy(pinfo.aes_key, RsDirUtil::sha1sum(key_buff,size).toByteArray(),GXS_TUNNEL_AES_KEY_SIZE) ;
+    pinfo.crypto_session.reset() ;
+
+    // The AEAD keys are derived from the whole DH secret, with the tunnel id as salt. The client end of the tunnel is the
+    // initiator, so that both directions use different keys.
+
+    pinfo.aead_session = std::make_shared<RsAEADSession>( key_buff, size, tunnel_id.toByteArray(), RsGxsTunnelId::SIZE_IN_BYTES,
+                                                          GXS_TUNNEL_AEAD_INFO, it->second.direction == RsTurtleGenericTunnelItem::DIRECTION_CLIENT ) ;
+    pinfo.peer_reads_aead = false ;
     
     pinfo.last_contact = time(NULL) ;
     pinfo.last_keep_alive_sent = time(NULL) ;
@@ -1058,6 +1166,15 @@ void p3GxsTunnelService::handleRecvDHPublicKey(RsGxsTunnelDHPublicKeyItem *item)
     cs->PeerId(RsPeerId(tunnel_id)) ;
 
     pendingGxsTunnelItems.push_back(cs) ;
+
+    // Then announce that we read AEAD packets. This is a separate status, so that older peers only log it.
+
+    RsGxsTunnelStatusItem *caps = new RsGxsTunnelStatusItem ;
+
+    caps->status = RS_GXS_TUNNEL_FLAG_AEAD_CHACHA20_POLY1305_V1;
+    caps->PeerId(RsPeerId(tunnel_id)) ;
+
+    pendingGxsTunnelItems.push_back(caps) ;
 }
 
 // Note: for some obscure reason, the typedef does not work here. Looks like a compiler error. So I use the primary type.
@@ -1276,9 +1393,6 @@ bool p3GxsTunnelService::locked_sendEncryptedTunnelData(RsGxsTunnelItem *item)
 	    return false;
     }
 
-    uint8_t aes_key[GXS_TUNNEL_AES_KEY_SIZE] ;
-    uint64_t IV = 0;
-
 #ifdef DEBUG_GXS_TUNNEL
     std::cerr << "Sending encrypted data to tunnel with vpid " << item->PeerId() << std::endl;
 #endif
@@ -1305,47 +1419,95 @@ bool p3GxsTunnelService::locked_sendEncryptedTunnelData(RsGxsTunnelItem *item)
 
     it->second.total_sent += rssize ;	// counts the size of clear data that is sent
     
-    memcpy(aes_key,it->second.aes_key,GXS_TUNNEL_AES_KEY_SIZE) ;
     RsPeerId virtual_peer_id = it->second.virtual_peer_id ;
 
-    while(IV == 0) IV = RSRandom::random_u64() ; // make a random 8 bytes IV, that is not 0
+    uint32_t data_size = 0 ;
+    void *data_bytes = NULL ;
 
+    if(it->second.peer_reads_aead && it->second.aead_session)
+    {
 #ifdef DEBUG_GXS_TUNNEL
-    std::cerr << "GxsTunnelService::sendEncryptedTunnelData(): tunnel found. Encrypting data." << std::endl;
+        std::cerr << "GxsTunnelService::sendEncryptedTunnelData(): tunnel found. Encrypting data with chacha20-poly1305." << std::endl;
 #endif
+        RsGxsTunnelAEADDataItem aitem ;
 
-    // Now encrypt this data using AES.
-    //
-    uint32_t encrypted_size = RsAES::get_buffer_size(rssize);
-    RsTemporaryMemory encrypted_data(encrypted_size) ;
+        aitem.mode = RS_GXS_TUNNEL_AEAD_MODE_CHACHA20_POLY1305_V1 ;
+        aitem.data_size = rssize + RsAEADSession::TAG_SIZE ;
+        aitem.data = (unsigned char*)rs_malloc(aitem.data_size) ;
 
-    if(!RsAES::aes_crypt_8_16(buff,rssize,aes_key,(uint8_t*)&IV,encrypted_data,encrypted_size))
-    {
-        std::cerr << "(EE) packet encryption failed." << std::endl;
-        return false;
+        if(aitem.data == NULL)
+            return false ;
+
+        memcpy(aitem.data,buff,rssize) ;
+
+        if(!it->second.aead_session->encrypt(aitem.data,rssize,aitem.counter,aitem.data+rssize))
+        {
+            std::cerr << "(EE) packet encryption failed." << std::endl;
+            return false;
+        }
+
+        // The item is sent with a IV of 0, like clear data, since it is authenticated on its own.
+
+        uint32_t aitem_size = ser.size(&aitem) ;
+
+        data_size  = aitem_size + 8 ;
+        data_bytes = rs_malloc(data_size) ;
+
+        if(data_bytes == NULL)
+            return false ;
+
+        memset(data_bytes,0,8) ;
+
+        if(!ser.serialise(&aitem,&((uint8_t*)data_bytes)[8],&aitem_size))
+        {
+            std::cerr << "(EE) GxsTunnelService::sendEncryptedTunnelData(): Could not serialise AEAD item!" << std::endl;
+            free(data_bytes) ;
+            return false;
+        }
     }
+    else
+    {
+        RsAESSession& session(it->second.cryptoSession()) ;
+        uint64_t IV = 0;
 
-    // make a TurtleGenericData item out of it:
-    //
+        while(IV == 0) IV = RSRandom::random_u64() ; // make a random 8 bytes IV, that is not 0
 
-    uint32_t data_size  = encrypted_size + GXS_TUNNEL_ENCRYPTION_IV_SIZE + GXS_TUNNEL_ENCRYPTION_HMAC_SIZE ;
-    void *data_bytes = rs_malloc(data_size) ;
+#ifdef DEBUG_GXS_TUNNEL
+        std::cerr << "GxsTunnelService::sendEncryptedTunnelData(): tunnel found. Encrypting data." << std::endl;
+#endif
 
-    if(data_bytes == NULL)
-        return false ;
-    
-    memcpy(& ((uint8_t*)data_bytes)[0]                                       ,&IV,8) ;
+        // Now encrypt this data using AES.
+        //
+        uint32_t encrypted_size = RsAES::get_buffer_size(rssize);
+        RsTemporaryMemory encrypted_data(encrypted_size) ;
+
+        if(!session.encrypt(buff,rssize,(uint8_t*)&IV,encrypted_data,encrypted_size))
+        {
+            std::cerr << "(EE) packet encryption failed." << std::endl;
+            return false;
+        }
+
+        // make a TurtleGenericData item out of it:
+        //
+
+        data_size  = encrypted_size + GXS_TUNNEL_ENCRYPTION_IV_SIZE + GXS_TUNNEL_ENCRYPTION_HMAC_SIZE ;
+        data_bytes = rs_malloc(data_size) ;
+
+        if(data_bytes == NULL)
+            return false ;
+
+        memcpy(& ((uint8_t*)data_bytes)[0]                                       ,&IV,8) ;
+
+        session.hmac(encrypted_data,encrypted_size,&(((uint8_t*)data_bytes)[GXS_TUNNEL_ENCRYPTION_IV_SIZE])) ;
+
+        memcpy(& (((uint8_t*)data_bytes)[GXS_TUNNEL_ENCRYPTION_HMAC_SIZE+GXS_TUNNEL_ENCRYPTION_IV_SIZE]),encrypted_data,encrypted_size) ;
 
-    unsigned int md_len = GXS_TUNNEL_ENCRYPTION_HMAC_SIZE ;
-    HMAC(EVP_sha1(),aes_key,GXS_TUNNEL_AES_KEY_SIZE,encrypted_data,encrypted_size,&(((uint8_t*)data_bytes)[GXS_TUNNEL_ENCRYPTION_IV_SIZE]),&md_len) ;
-    
-    memcpy(& (((uint8_t*)data_bytes)[GXS_TUNNEL_ENCRYPTION_HMAC_SIZE+GXS_TUNNEL_ENCRYPTION_IV_SIZE]),encrypted_data,encrypted_size) ;
-    
 #ifdef DEBUG_GXS_TUNNEL
-    std::cerr << "   Using  IV: " << std::hex << IV << std::dec << std::endl;
-    std::cerr << "   Using Key: " << RsUtil::BinToHex((char*)aes_key,GXS_TUNNEL_AES_KEY_SIZE) ; std::cerr << std::endl;
-    std::cerr << "        hmac: " << RsUtil::BinToHex((char*)data_bytes,GXS_TUNNEL_ENCRYPTION_HMAC_SIZE) << std::endl;
+        std::cerr << "   Using  IV: " << std::hex << IV << std::dec << std::endl;
+        std::cerr << "   Using Key: " << RsUtil::BinToHex((char*)it->second.aes_key,GXS_TUNNEL_AES_KEY_SIZE) ; std::cerr << std::endl;
+        std::cerr << "        hmac: " << RsUtil::BinToHex((char*)data_bytes,GXS_TUNNEL_ENCRYPTION_HMAC_SIZE) << std::endl;
 #endif
+    }
 #ifdef DEBUG_GXS_TUNNEL
     std::cerr << "GxsTunnelService::sendEncryptedTunnelData(): Sending encrypted data to virtual peer: " << virtual_peer_id << std::endl;
     std::cerr << "   data_size = " << data_size << std::endl;
@@ -1368,7 +1530,7 @@ bool p3GxsTunnelService::locked_sendEncryptedTunnelData(RsGxsTunnelItem *item)
 
 	if(!it->second.accepts_fast_turtle_items)
 	{
-        std::cerr << "Sending old format (slow) item for packet IV=" << std::hex << IV << std::dec << " in tunnel VPID=" << it->second.virtual_peer_id << std::endl;
+        std::cerr << "Sending old format (slow) item for packet of " << data_size << " bytes in tunnel VPID=" << it->second.virtual_peer_id << std::endl;
 		gitem = new RsTurtleGenericDataItem ;
 
 		gitem->data_bytes = data_bytes;
@@ -1377,7 +1539,7 @@ bool p3GxsTunnelService::locked_sendEncryptedTunnelData(RsGxsTunnelItem *item)
 
 	if(it->second.accepts_fast_turtle_items || !it->second.already_probed_for_fast_items)
 	{
-        std::cerr << "Sending new format (fast) item for packet IV=" << std::hex << IV << std::dec << " in tunnel VPID=" << it->second.virtual_peer_id << std::endl;
+        std::cerr << "Sending new format (fast) item for packet of " << data_size << " bytes in tunnel VPID=" << it->second.virtual_peer_id << std::endl;
 		gitem2 = new RsTurtleGenericFastDataItem ;
 
         if(gitem != NULL)	// duplicate the data because it was already sent in gitem.
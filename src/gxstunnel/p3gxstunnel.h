@@ -108,10 +108,13 @@
 //                +---------------- notify client service that Peer(destination_id, tunnel_hash) is ready to talk to             |
 //                                                                                                                               -
 
+#include <memory>
+
 #include <turtle/turtleclientservice.h>
 #include <retroshare/rsgxstunnel.h>
 #include <services/p3service.h>
 #include <gxstunnel/rsgxstunnelitems.h>
+#include <crypto/rsaes.h>
 
 class RsGixs ;
 
@@ -148,8 +151,8 @@ private:
     {
     public:
         GxsTunnelPeerInfo()
-            : last_contact(0), last_keep_alive_sent(0), status(0), direction(0)
-            , total_sent(0), total_received(0)
+            : last_contact(0), last_keep_alive_sent(0), peer_reads_aead(false)
+            , status(0), direction(0), total_sent(0), total_received(0)
   #ifndef V07_NON_BACKWARD_COMPATIBLE_CHANGE_004
             , accepts_fast_turtle_items(false)
             , already_probed_for_fast_items(false)
@@ -163,6 +166,24 @@ private:
 
         unsigned char aes_key[GXS_TUNNEL_AES_KEY_SIZE] ;
 
+        // Cipher and HMAC contexts for aes_key, kept for the life of the key. Must be reset when aes_key changes.
+
+        std::shared_ptr<RsAESSession> crypto_session ;
+
+        RsAESSession& cryptoSession()
+        {
+            if(!crypto_session)
+                crypto_session = std::make_shared<RsAESSession>(aes_key) ;
+
+            return *crypto_session ;
+        }
+
+        // Keys derived once from the DH secret for RsGxsTunnelAEADDataItem. They are used to send as soon as the peer
+        // announced RS_GXS_TUNNEL_FLAG_AEAD_CHACHA20_POLY1305_V1, and AES-CBC+HMAC is used until then.
+
+        std::shared_ptr<RsAEADSession> aead_session ;
+        bool peer_reads_aead ;
+
         uint32_t status ;                                     // info: do we have a tunnel ?
         RsPeerId virtual_peer_id;                             // given by the turtle router. Identifies the tunnel.
         RsGxsId to_gxs_id;                                    // gxs id we're talking to
@@ -253,6 +274,8 @@ private:
 #else
     bool handleEncryptedData(const uint8_t *data_bytes, uint32_t data_size, const TurtleFileHash& hash, const RsPeerId& virtual_peer_id) ;
 #endif
+    bool handleAEADData(RsGxsTunnelAEADDataItem *item, const TurtleFileHash& hash, const RsPeerId& virtual_peer_id, bool accepts_fast_items) ;
+    GxsTunnelPeerInfo *locked_findReceivingTunnel(const TurtleFileHash& hash, const RsPeerId& virtual_peer_id, bool accepts_fast_items, RsGxsTunnelId& tunnel_id) ;
 
     // local data
     
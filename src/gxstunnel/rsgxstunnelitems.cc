@@ -43,6 +43,7 @@ RsItem *RsGxsTunnelSerialiser::create_item(uint16_t service,uint8_t item_subtype
     case RS_PKT_SUBTYPE_GXS_TUNNEL_DATA_ACK:      return new RsGxsTunnelDataAckItem();
     case RS_PKT_SUBTYPE_GXS_TUNNEL_DH_PUBLIC_KEY: return new RsGxsTunnelDHPublicKeyItem();
     case RS_PKT_SUBTYPE_GXS_TUNNEL_STATUS:        return new RsGxsTunnelStatusItem();
+    case RS_PKT_SUBTYPE_GXS_TUNNEL_AEAD_DATA:     return new RsGxsTunnelAEADDataItem();
     default:
         return NULL ;
     }
@@ -115,6 +116,14 @@ void RsGxsTunnelDataItem::serial_process(RsGenericSerializer::SerializeJob j,RsG
     RsTypeSerializer::TlvMemBlock_proxy mem(data,data_size) ;
     RsTypeSerializer::serial_process(j,ctx,mem,"data") ;
 }
+void RsGxsTunnelAEADDataItem::serial_process(RsGenericSerializer::SerializeJob j,RsGenericSerializer::SerializeContext& ctx)
+{
+    RsTypeSerializer::serial_process<uint32_t>(j,ctx,mode   ,"mode") ;
+    RsTypeSerializer::serial_process<uint64_t>(j,ctx,counter,"counter") ;
+
+    RsTypeSerializer::TlvMemBlock_proxy mem(data,data_size) ;
+    RsTypeSerializer::serial_process(j,ctx,mem,"data") ;
+}
 void RsGxsTunnelDataAckItem::serial_process(RsGenericSerializer::SerializeJob j,RsGenericSerializer::SerializeContext& ctx)
 {
     RsTypeSerializer::serial_process<uint64_t>(j,ctx,unique_item_counter,"unique_item_counter") ;
@@ -39,10 +39,18 @@ const uint32_t RS_GXS_TUNNEL_FLAG_CLOSING_DISTANT_CONNECTION = 0x0400;
 const uint32_t RS_GXS_TUNNEL_FLAG_ACK_DISTANT_CONNECTION     = 0x0800;
 const uint32_t RS_GXS_TUNNEL_FLAG_KEEP_ALIVE                 = 0x1000;
 
+// Capability, sent as a status of its own after the ACK: the sender reads RsGxsTunnelAEADDataItem. Peers that
+// do not know it log an unhandled status and keep sending RsGxsTunnelDataItem encrypted with AES-CBC+HMAC.
+const uint32_t RS_GXS_TUNNEL_FLAG_AEAD_CHACHA20_POLY1305_V1  = 0x2000;
+
+// Modes of RsGxsTunnelAEADDataItem
+const uint32_t RS_GXS_TUNNEL_AEAD_MODE_CHACHA20_POLY1305_V1  = 0x0001;
+
 const uint8_t RS_PKT_SUBTYPE_GXS_TUNNEL_DATA           = 0x01 ;	
 const uint8_t RS_PKT_SUBTYPE_GXS_TUNNEL_DH_PUBLIC_KEY  = 0x02 ;
 const uint8_t RS_PKT_SUBTYPE_GXS_TUNNEL_STATUS         = 0x03 ;
 const uint8_t RS_PKT_SUBTYPE_GXS_TUNNEL_DATA_ACK       = 0x04 ;
+const uint8_t RS_PKT_SUBTYPE_GXS_TUNNEL_AEAD_DATA      = 0x05 ;
 
 typedef uint64_t		GxsTunnelDHSessionId ;
 
@@ -115,6 +123,29 @@ class RsGxsTunnelDataAckItem: public RsGxsTunnelItem
 };
 
 
+// Authenticated encryption of a serialised item, sent without the AES-CBC+HMAC envelope to the peers that
+// announced RS_GXS_TUNNEL_FLAG_AEAD_CHACHA20_POLY1305_V1. The key of each direction is derived once per DH
+// session, and the counter gives the nonce, @see RsAEADSession.
+
+class RsGxsTunnelAEADDataItem: public RsGxsTunnelItem
+{
+	public:
+		RsGxsTunnelAEADDataItem() :RsGxsTunnelItem(RS_PKT_SUBTYPE_GXS_TUNNEL_AEAD_DATA), mode(0), counter(0), data_size(0), data(NULL) {}
+
+		virtual ~RsGxsTunnelAEADDataItem() { free(data) ; }
+
+		virtual void serial_process(RsGenericSerializer::SerializeJob j,RsGenericSerializer::SerializeContext& ctx);
+
+		uint32_t mode ;						// RS_GXS_TUNNEL_AEAD_MODE_*
+		uint64_t counter ;					// nonce of the data
+		uint32_t data_size ;					// encrypted data size, tag included
+		unsigned char *data ;					// encrypted data, followed by the tag
+
+	private:
+		RsGxsTunnelAEADDataItem(const RsGxsTunnelAEADDataItem&) ;
+		RsGxsTunnelAEADDataItem& operator=(const RsGxsTunnelAEADDataItem&) ;
+};
+
 // This class contains the public Diffie-Hellman parameters to be sent
 // when performing a DH agreement over a distant chat tunnel.
 //
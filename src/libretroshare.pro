@@ -43,19 +43,23 @@ CONFIG += file_lists
 file_lists {
 	HEADERS *= file_sharing/p3filelists.h \
 			file_sharing/hash_cache.h \
+			file_sharing/hash_cache_index.h \
 			file_sharing/filelist_io.h \
 			file_sharing/directory_storage.h \
 			file_sharing/directory_updater.h \
 			file_sharing/rsfilelistitems.h \
 			file_sharing/dir_hierarchy.h \
+			file_sharing/file_name_index.h \
 			file_sharing/file_sharing_defaults.h
 
 	SOURCES *= file_sharing/p3filelists.cc \
 			file_sharing/hash_cache.cc \
+			file_sharing/hash_cache_index.cc \
 			file_sharing/filelist_io.cc \
 			file_sharing/directory_storage.cc \
 			file_sharing/directory_updater.cc \
 			file_sharing/dir_hierarchy.cc \
+			file_sharing/file_name_index.cc \
 			file_sharing/file_tree.cc \
 			file_sharing/rsfilelistitems.cc
 }
@@ -369,6 +373,7 @@ HEADERS +=	pqi/authssl.h \
 			pqi/rstcpsocket.h \
 			pgp/rscertificate.h \
 			pgp/pgpauxutils.h \
+			pqi/p3cfgjournal.h \
 			pqi/p3cfgmgr.h \
 			pqi/p3peermgr.h \
 			pqi/p3linkmgr.h \
@@ -383,12 +388,14 @@ HEADERS +=	pqi/authssl.h \
 			pqi/pqihandler.h \
 			pqi/pqihash.h \
 			pqi/p3historymgr.h \
+			pqi/historystore.h \
 			pqi/pqiindic.h \
 			pqi/pqiipset.h \
 			pqi/pqilistener.h \
 			pqi/pqiloopback.h \
 			pqi/pqimonitor.h \
 			pqi/pqinetwork.h \
+			pqi/pqinetreactor.h \
 			pqi/pqiperson.h \
 			pqi/pqipersongrp.h \
 			pqi/pqiservice.h \
@@ -461,6 +468,7 @@ HEADERS +=  \
             services/rseventsservice.h \
             services/autoproxy/rsautoproxymonitor.h \
             services/p3msgservice.h \
+            services/msgstore.h \
 			services/p3service.h \
 			services/p3statusservice.h \
 			services/p3banlist.h \
@@ -501,9 +509,14 @@ HEADERS +=	util/folderiterator.h \
 			util/rsstring.h \
 			util/rsstd.h \
 			util/rsthreads.h \
+			util/rsexecutor.h \
 			util/rswin.h \
 			util/rsrandom.h \
 			util/rsmemcache.h \
+			util/rssha1hashtable.h \
+			util/rsiptrie.h \
+			util/rsbloomfilter.h \
+			util/rsiblt.h \
 			util/rstickevent.h \
 			util/rsrecogn.h \
 			util/rstime.h \
@@ -545,6 +558,7 @@ SOURCES +=	pqi/authgpg.cc \
 			pgp/pgpkeyutil.cc \
 			pgp/rscertificate.cc \
 			pgp/pgpauxutils.cc \
+			pqi/p3cfgjournal.cc \
 			pqi/p3cfgmgr.cc \
 			pqi/p3peermgr.cc \
 			pqi/p3linkmgr.cc \
@@ -556,10 +570,12 @@ SOURCES +=	pqi/authgpg.cc \
 			pqi/pqibin.cc \
 			pqi/pqihandler.cc \
 			pqi/p3historymgr.cc \
+			pqi/historystore.cc \
 			pqi/pqiipset.cc \
 			pqi/pqiloopback.cc \
 			pqi/pqimonitor.cc \
 			pqi/pqinetwork.cc \
+			pqi/pqinetreactor.cc \
 			pqi/pqiperson.cc \
 			pqi/pqipersongrp.cc \
 			pqi/pqiservice.cc \
@@ -625,6 +641,7 @@ SOURCES +=	serialiser/rsbaseserial.cc \
 SOURCES +=  services/autoproxy/rsautoproxymonitor.cc \
     services/rseventsservice.cc \
             services/p3msgservice.cc \
+            services/msgstore.cc \
 			services/p3service.cc \
 			services/p3statusservice.cc \
 			services/p3banlist.cc \
@@ -653,6 +670,7 @@ SOURCES +=	util/folderiterator.cc \
 			util/rsprint.cc \
 			util/rsstring.cc \
 			util/rsthreads.cc \
+			util/rsexecutor.cc \
 			util/rsrandom.cc \
 			util/rstickevent.cc \
 			util/rsrecogn.cc \
@@ -0,0 +1,266 @@
+/*******************************************************************************
+ * libretroshare/src/pqi: historystore.cc                                      *
+ *                                                                             *
+ * libretroshare: retroshare core library                                      *
+ *                                                                             *
+ * Copyright (C) 2026  RetroShare Team <contact@retroshare.cc>                 *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Lesser General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ ******************************************************************************/
+
+#include "pqi/historystore.h"
+#include "rsitems/rshistoryitems.h"
+#include "util/retrodb.h"
+#include "util/rsstring.h"
+
+/****
+ * #define HISTORYSTORE_DEBUG 1
+ ***/
+
+#define HISTORY_TABLE_NAME      std::string("HISTORY")
+
+#define KEY_MSG_ID              std::string("msgId")
+#define KEY_CHAT_PEER_ID        std::string("chatPeerId")
+#define KEY_INCOMING            std::string("incoming")
+#define KEY_MSG_PEER_ID         std::string("msgPeerId")
+#define KEY_PEER_NAME           std::string("peerName")
+#define KEY_SEND_TIME           std::string("sendTime")
+#define KEY_RECV_TIME           std::string("recvTime")
+#define KEY_MESSAGE             std::string("message")
+
+#define HISTORY_INDEX_CHAT      std::string("INDEX_HISTORY_CHAT")
+#define HISTORY_INDEX_RECV_TIME std::string("INDEX_HISTORY_RECV_TIME")
+
+static std::string chatSelection(const RsPeerId& chatPeerId)
+{
+	return KEY_CHAT_PEER_ID + "='" + chatPeerId.toStdString() + "'";
+}
+
+HistoryStore::HistoryStore(const std::string& dbPath, const std::string& key)
+    : mDb(new RetroDb(dbPath, RetroDb::OPEN_READWRITE_CREATE, key))
+{
+	if(!mDb->isOpen())
+	{
+		RsErr() << __PRETTY_FUNCTION__ << " cannot open history database " << dbPath;
+		return;
+	}
+
+	// The msgId primary key makes message lookups cheap. The chat index serves both the paged reads of a chat
+	// and the trimming to the save count, the reception time index serves the pruning of old messages.
+
+	if(!mDb->tableExists(HISTORY_TABLE_NAME))
+	{
+		mDb->execSQL("CREATE TABLE " + HISTORY_TABLE_NAME + "(" +
+		             KEY_MSG_ID + " INTEGER PRIMARY KEY," +
+		             KEY_CHAT_PEER_ID + " TEXT," +
+		             KEY_INCOMING + " INT," +
+		             KEY_MSG_PEER_ID + " TEXT," +
+		             KEY_PEER_NAME + " TEXT," +
+		             KEY_SEND_TIME + " INT," +
+		             KEY_RECV_TIME + " INT," +
+		             KEY_MESSAGE + " TEXT);");
+
+		mDb->execSQL("CREATE INDEX " + HISTORY_INDEX_CHAT + " ON " + HISTORY_TABLE_NAME + "(" + KEY_CHAT_PEER_ID + "," + KEY_MSG_ID + ");");
+		mDb->execSQL("CREATE INDEX " + HISTORY_INDEX_RECV_TIME + " ON " + HISTORY_TABLE_NAME + "(" + KEY_RECV_TIME + ");");
+	}
+}
+
+HistoryStore::~HistoryStore()
+{
+	delete mDb;
+}
+
+bool HistoryStore::isOpen() const
+{
+	return mDb->isOpen();
+}
+
+uint32_t HistoryStore::maxMsgId()
+{
+	if(!mDb->isOpen())
+		return 0;
+
+	std::list<std::string> columns;
+	columns.push_back("MAX(" + KEY_MSG_ID + ")");
+
+	RetroCursor *c = mDb->sqlQuery(HISTORY_TABLE_NAME, columns, "", "");
+	uint32_t res = 0;
+
+	if(c)
+	{
+		if(c->moveToFirst())
+			res = c->getInt64(0);
+
+		delete c;
+	}
+	return res;
+}
+
+bool HistoryStore::addMessages(const std::list<RsHistoryMsgItem*>& items)
+{
+	if(!mDb->isOpen())
+		return false;
+
+	std::list<ContentValue> cvs;
+
+	for(std::list<RsHistoryMsgItem*>::const_iterator it(items.begin());it!=items.end();++it)
+	{
+		cvs.push_back(ContentValue());
+		ContentValue& cv(cvs.back());
+
+		cv.put(KEY_MSG_ID, (int64_t)(*it)->msgId);
+		cv.put(KEY_CHAT_PEER_ID, (*it)->chatPeerId.toStdString());
+		cv.put(KEY_INCOMING, (*it)->incoming);
+		cv.put(KEY_MSG_PEER_ID, (*it)->msgPeerId.toStdString());
+		cv.put(KEY_PEER_NAME, (*it)->peerName);
+		cv.put(KEY_SEND_TIME, (int64_t)(*it)->sendTime);
+		cv.put(KEY_RECV_TIME, (int64_t)(*it)->recvTime);
+		cv.put(KEY_MESSAGE, (*it)->message);
+	}
+
+	return mDb->sqlInsertBulk(HISTORY_TABLE_NAME, "", cvs);
+}
+
+bool HistoryStore::readMessages(const std::string& selection, const std::string& orderBy, std::list<RsHistoryMsgItem*>& items)
+{
+	if(!mDb->isOpen())
+		return false;
+
+	std::list<std::string> columns;
+	columns.push_back(KEY_MSG_ID);
+	columns.push_back(KEY_CHAT_PEER_ID);
+	columns.push_back(KEY_INCOMING);
+	columns.push_back(KEY_MSG_PEER_ID);
+	columns.push_back(KEY_PEER_NAME);
+	columns.push_back(KEY_SEND_TIME);
+	columns.push_back(KEY_RECV_TIME);
+	columns.push_back(KEY_MESSAGE);
+
+	RetroCursor *c = mDb->sqlQuery(HISTORY_TABLE_NAME, columns, selection, orderBy);
+
+	if(!c)
+		return false;
+
+	// Rows come newest first. Pushing them in front gives the messages in chronological order.
+
+	for(bool valid = c->moveToFirst();valid;valid = c->moveToNext())
+	{
+		RsHistoryMsgItem *item = new RsHistoryMsgItem;
+
+		item->msgId = c->getInt64(0);
+		c->getStringT<RsPeerId>(1, item->chatPeerId);
+		item->incoming = c->getBool(2);
+		c->getStringT<RsPeerId>(3, item->msgPeerId);
+		c->getString(4, item->peerName);
+		item->sendTime = c->getInt64(5);
+		item->recvTime = c->getInt64(6);
+		c->getString(7, item->message);
+
+		items.push_front(item);
+	}
+
+	delete c;
+	return true;
+}
+
+bool HistoryStore::getMessages(const RsPeerId& chatPeerId, uint32_t count, std::list<RsHistoryMsgItem*>& items)
+{
+	std::string orderBy = KEY_MSG_ID + " DESC";
+
+	if(count > 0)
+		rs_sprintf_append(orderBy, " LIMIT %u", count);
+
+	return readMessages(chatSelection(chatPeerId), orderBy, items);
+}
+
+RsHistoryMsgItem *HistoryStore::getMessage(uint32_t msgId)
+{
+	std::list<RsHistoryMsgItem*> items;
+	std::string selection;
+	rs_sprintf(selection, "%s=%u", KEY_MSG_ID.c_str(), msgId);
+
+	if(!readMessages(selection, "", items) || items.empty())
+		return NULL;
+
+	return items.front();
+}
+
+bool HistoryStore::removeMessages(const std::list<uint32_t>& msgIds, std::list<uint32_t>& removedIds)
+{
+	removedIds.clear();
+
+	if(!mDb->isOpen() || msgIds.empty())
+		return false;
+
+	std::string selection = KEY_MSG_ID + " IN (";
+
+	for(std::list<uint32_t>::const_iterator it(msgIds.begin());it!=msgIds.end();++it)
+		rs_sprintf_append(selection, it == msgIds.begin() ? "%u" : ",%u", *it);
+
+	selection += ")";
+
+	std::list<std::string> columns;
+	columns.push_back(KEY_MSG_ID);
+
+	RetroCursor *c = mDb->sqlQuery(HISTORY_TABLE_NAME, columns, selection, "");
+
+	if(c)
+	{
+		for(bool valid = c->moveToFirst();valid;valid = c->moveToNext())
+			removedIds.push_back(c->getInt64(0));
+
+		delete c;
+	}
+
+	if(removedIds.empty())
+		return true;
+
+	return mDb->sqlDelete(HISTORY_TABLE_NAME, selection, "");
+}
+
+bool HistoryStore::trimChat(const RsPeerId& chatPeerId, uint32_t keepCount)
+{
+	if(!mDb->isOpen())
+		return false;
+
+	std::string selection = chatSelection(chatPeerId) + " AND " + KEY_MSG_ID + " NOT IN (SELECT " + KEY_MSG_ID + " FROM " + HISTORY_TABLE_NAME
+	        + " WHERE " + chatSelection(chatPeerId) + " ORDER BY " + KEY_MSG_ID + " DESC";
+	rs_sprintf_append(selection, " LIMIT %u)", keepCount);
+
+	return mDb->sqlDelete(HISTORY_TABLE_NAME, selection, "");
+}
+
+bool HistoryStore::clearChat(const RsPeerId& chatPeerId)
+{
+	if(!mDb->isOpen())
+		return false;
+
+	return mDb->sqlDelete(HISTORY_TABLE_NAME, chatSelection(chatPeerId), "");
+}
+
+bool HistoryStore::removeOlderThan(rstime_t recvTime)
+{
+	if(!mDb->isOpen())
+		return false;
+
+	std::string selection;
+	rs_sprintf(selection, "%s<%lld", KEY_RECV_TIME.c_str(), (long long)recvTime);
+
+#ifdef HISTORYSTORE_DEBUG
+	std::cerr << "HistoryStore: removing messages received before " << recvTime << std::endl;
+#endif
+
+	return mDb->sqlDelete(HISTORY_TABLE_NAME, selection, "");
+}
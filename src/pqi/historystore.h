@@ -0,0 +1,91 @@
+/*******************************************************************************
+ * libretroshare/src/pqi: historystore.h                                       *
+ *                                                                             *
+ * libretroshare: retroshare core library                                      *
+ *                                                                             *
+ * Copyright (C) 2026  RetroShare Team <contact@retroshare.cc>                 *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Lesser General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ ******************************************************************************/
+#pragma once
+
+#include <list>
+#include <string>
+
+#include "util/rstime.h"
+#include "retroshare/rstypes.h"
+
+class RetroDb;
+class RsHistoryMsgItem;
+
+/*!
+ * \brief The HistoryStore class
+ * 		Chat history on disk, in a RetroDb database. Messages are indexed by chat and by reception time, so that
+ * 		the last messages of a chat can be read page by page, and old messages can be pruned, without going
+ * 		through the whole history.
+ *
+ * 		Chats are identified by the virtual peer id computed by p3HistoryMgr::chatIdToVirtualPeerId().
+ * 		Message ids are given by the caller and are unique over all chats.
+ *
+ * 		This class is not thread safe. It is owned by p3HistoryMgr, which protects it with its own mutex.
+ */
+class HistoryStore
+{
+public:
+	HistoryStore(const std::string& dbPath, const std::string& key);
+	~HistoryStore();
+
+	bool isOpen() const;
+
+	// Largest message id in the store, 0 when empty.
+
+	uint32_t maxMsgId();
+
+	// Stores the given messages, in a single transaction. Messages must have their msgId set.
+
+	bool addMessages(const std::list<RsHistoryMsgItem*>& items);
+
+	/*!
+	 * \brief getMessages
+	 * 		Gets the last messages of a chat, oldest first.
+	 * \param chatPeerId	virtual peer id of the chat
+	 * \param count			maximum number of messages, 0 means all of them
+	 * \param items			newly allocated items, that belong to the caller
+	 */
+	bool getMessages(const RsPeerId& chatPeerId, uint32_t count, std::list<RsHistoryMsgItem*>& items);
+
+	// Returns a newly allocated item, or NULL if no such message.
+
+	RsHistoryMsgItem *getMessage(uint32_t msgId);
+
+	// Removes the given messages. removedIds receives the ids that were actually in the store.
+
+	bool removeMessages(const std::list<uint32_t>& msgIds, std::list<uint32_t>& removedIds);
+
+	// Removes all messages of a chat, but the last keepCount ones.
+
+	bool trimChat(const RsPeerId& chatPeerId, uint32_t keepCount);
+
+	bool clearChat(const RsPeerId& chatPeerId);
+
+	// Removes all messages received before the given time.
+
+	bool removeOlderThan(rstime_t recvTime);
+
+private:
+	bool readMessages(const std::string& selection, const std::string& orderBy, std::list<RsHistoryMsgItem*>& items);
+
+	RetroDb *mDb;
+};
@@ -0,0 +1,257 @@
+/*******************************************************************************
+ * libretroshare/src/pqi: p3cfgjournal.cc                                      *
+ *                                                                             *
+ * libretroshare: retroshare core library                                      *
+ *                                                                             *
+ * Copyright (C) 2026  RetroShare Team <contact@retroshare.cc>                 *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Lesser General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ *******************************************************************************/
+#include <cstring>
+
+#include "pqi/p3cfgjournal.h"
+#include "crypto/chacha20.h"
+#include "serialiser/rsbaseserial.h"
+#include "util/rsdebug.h"
+#include "util/rsdir.h"
+#include "util/rsrandom.h"
+
+const uint32_t p3ConfigJournal::MAGIC;
+const uint32_t p3ConfigJournal::TAG_SIZE;
+const uint32_t p3ConfigJournal::MAX_RECORD_SIZE;
+
+p3ConfigJournal::p3ConfigJournal(KeyStore& keys) :
+    mKeys(keys), mFile(NULL), mCounter(0), mSize(0)
+{
+	memset(mKey,0,32);
+}
+
+p3ConfigJournal::~p3ConfigJournal()
+{
+	close();
+}
+
+void p3ConfigJournal::recordNonce(uint64_t counter,uint8_t nonce[12])
+{
+	memset(nonce,0,12);
+
+	for(uint32_t i=0;i<8;++i)
+		nonce[4+i] = (counter >> (8*i)) & 0xff;
+}
+
+bool p3ConfigJournal::create(const std::string& fname, const RsFileHash& configHash)
+{
+	close();
+
+	RsRandom::random_bytes(mKey,32);
+
+	std::vector<uint8_t> wrapped;
+
+	if(!mKeys.wrapKey(mKey,wrapped) || wrapped.empty() || wrapped.size() > MAX_RECORD_SIZE)
+	{
+		RsErr() << __PRETTY_FUNCTION__ << " cannot wrap key of journal " << fname;
+		memset(mKey,0,32);
+		return false;
+	}
+
+	std::vector<uint8_t> header(4 + RsFileHash::SIZE_IN_BYTES + 4 + wrapped.size());
+	uint32_t offset = 0;
+
+	setRawUInt32(header.data(),header.size(),&offset,MAGIC);
+	memcpy(&header[offset],configHash.toByteArray(),RsFileHash::SIZE_IN_BYTES);
+	offset += RsFileHash::SIZE_IN_BYTES;
+	setRawUInt32(header.data(),header.size(),&offset,wrapped.size());
+	memcpy(&header[offset],wrapped.data(),wrapped.size());
+
+	std::vector<uint8_t> signature;
+
+	if(!mKeys.sign(header,signature) || signature.empty() || signature.size() > MAX_RECORD_SIZE)
+	{
+		RsErr() << __PRETTY_FUNCTION__ << " cannot sign header of journal " << fname;
+		memset(mKey,0,32);
+		return false;
+	}
+
+	uint8_t sigLen[4];
+	offset = 0;
+	setRawUInt32(sigLen,4,&offset,signature.size());
+
+	FILE *f = RsDirUtil::rs_fopen(fname.c_str(),"wb");
+
+	if(!f)
+	{
+		RsErr() << __PRETTY_FUNCTION__ << " cannot open journal " << fname << " for writing";
+		memset(mKey,0,32);
+		return false;
+	}
+
+	if(fwrite(header.data(),1,header.size(),f) != header.size() || fwrite(sigLen,1,4,f) != 4
+	        || fwrite(signature.data(),1,signature.size(),f) != signature.size() || fflush(f) != 0)
+	{
+		RsErr() << __PRETTY_FUNCTION__ << " cannot write journal " << fname << ". Out of disc space?";
+		fclose(f);
+		RsDirUtil::removeFile(fname);
+		memset(mKey,0,32);
+		return false;
+	}
+
+	mFile = f;
+	mCounter = 0;
+	mSize = header.size() + 4 + signature.size();
+
+	return true;
+}
+
+bool p3ConfigJournal::open( const std::string& fname, const RsFileHash& configHash,
+                            std::list<std::vector<uint8_t> >& payloads )
+{
+	close();
+
+	FILE *f = RsDirUtil::rs_fopen(fname.c_str(),"r+b");
+
+	if(!f)
+		return false;
+
+	// Check that the journal follows the given config file, and that we wrote it.
+
+	uint8_t buf[4 + RsFileHash::SIZE_IN_BYTES + 4];
+	uint32_t offset = 0;
+	uint32_t magic = 0;
+	uint32_t wrappedLen = 0;
+	uint32_t sigLen = 0;
+	bool ok = fread(buf,1,sizeof(buf),f) == sizeof(buf);
+
+	ok = ok && getRawUInt32(buf,sizeof(buf),&offset,&magic) && magic == MAGIC;
+	ok = ok && RsFileHash(&buf[offset]) == configHash;
+	offset += RsFileHash::SIZE_IN_BYTES;
+	ok = ok && getRawUInt32(buf,sizeof(buf),&offset,&wrappedLen) && wrappedLen > 0 && wrappedLen <= MAX_RECORD_SIZE;
+
+	std::vector<uint8_t> header;
+
+	if(ok)
+	{
+		header.resize(sizeof(buf) + wrappedLen);
+		memcpy(header.data(),buf,sizeof(buf));
+		ok = fread(&header[sizeof(buf)],1,wrappedLen,f) == wrappedLen;
+	}
+
+	offset = 0;
+	ok = ok && fread(buf,1,4,f) == 4 && getRawUInt32(buf,4,&offset,&sigLen) && sigLen > 0 && sigLen <= MAX_RECORD_SIZE;
+
+	std::vector<uint8_t> signature(ok ? sigLen : 0);
+	ok = ok && fread(signature.data(),1,sigLen,f) == sigLen;
+	ok = ok && mKeys.verify(header,signature);
+
+	ok = ok && mKeys.unwrapKey(std::vector<uint8_t>(header.begin() + sizeof(buf),header.end()),mKey);
+
+	if(!ok)
+	{
+		fclose(f);
+		close();
+		return false;
+	}
+
+	mCounter = 0;
+	mSize = header.size() + 4 + sigLen;
+
+	for(;;)
+	{
+		uint8_t sizeBuf[4];
+		uint32_t payloadSize = 0;
+		offset = 0;
+
+		if(fread(sizeBuf,1,4,f) != 4)
+			break;
+
+		if(!getRawUInt32(sizeBuf,4,&offset,&payloadSize) || payloadSize < 1 || payloadSize > MAX_RECORD_SIZE)
+		{
+			RsErr() << "Journal " << fname << ": corrupted record " << mCounter << ". Dropping the end of the journal.";
+			break;
+		}
+
+		std::vector<uint8_t> payload(payloadSize + TAG_SIZE);
+
+		if(fread(payload.data(),1,payload.size(),f) != payload.size())
+			break;	// interrupted write
+
+		uint8_t nonce[12];
+		recordNonce(mCounter,nonce);
+
+		if(!librs::crypto::AEAD_chacha20_poly1305(mKey,nonce,payload.data(),payloadSize,sizeBuf,4,&payload[payloadSize],false))
+		{
+			RsErr() << "Journal " << fname << ": record " << mCounter << " does not authenticate. Dropping the end of the journal.";
+			break;
+		}
+
+		payload.resize(payloadSize);
+		payloads.push_back(payload);
+
+		++mCounter;
+		mSize += 4 + payloadSize + TAG_SIZE;
+	}
+
+	// New records are appended after the last valid one, overwriting a possibly truncated record. What is left of it
+	// afterwards does not authenticate with the next nonce.
+
+	if(fseek(f,mSize,SEEK_SET) != 0)
+	{
+		fclose(f);
+		close();
+		return false;
+	}
+
+	mFile = f;
+	return true;
+}
+
+bool p3ConfigJournal::append(const std::vector<uint8_t>& payload)
+{
+	if(!mFile || payload.empty() || payload.size() > MAX_RECORD_SIZE)
+		return false;
+
+	std::vector<uint8_t> record(4 + payload.size() + TAG_SIZE);
+	uint32_t offset = 0;
+
+	setRawUInt32(record.data(),4,&offset,payload.size());
+	memcpy(&record[4],payload.data(),payload.size());
+
+	uint8_t nonce[12];
+	recordNonce(mCounter,nonce);
+
+	librs::crypto::AEAD_chacha20_poly1305(mKey,nonce,&record[4],payload.size(),&record[0],4,&record[4+payload.size()],true);
+
+	if(fwrite(record.data(),1,record.size(),mFile) != record.size() || fflush(mFile) != 0)
+	{
+		RsErr() << __PRETTY_FUNCTION__ << " cannot write to journal. Out of disc space?";
+		close();
+		return false;
+	}
+
+	++mCounter;
+	mSize += record.size();
+
+	return true;
+}
+
+void p3ConfigJournal::close()
+{
+	if(mFile)
+		fclose(mFile);
+
+	mFile = NULL;
+	mCounter = 0;
+	mSize = 0;
+	memset(mKey,0,32);
+}
@@ -0,0 +1,97 @@
+/*******************************************************************************
+ * libretroshare/src/pqi: p3cfgjournal.h                                       *
+ *                                                                             *
+ * libretroshare: retroshare core library                                      *
+ *                                                                             *
+ * Copyright (C) 2026  RetroShare Team <contact@retroshare.cc>                 *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Lesser General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ *******************************************************************************/
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <list>
+#include <string>
+#include <vector>
+
+#include "retroshare/rstypes.h"
+
+/**
+ * Append-only journal file of a p3Config, @see p3Config::journalAddItem().
+ *
+ * Layout:
+ *    header:  [magic 4B] [hash of the config file 20B] [key size 4B] [wrapped key] [signature size 4B] [signature of all the above]
+ *    records: [payload size 4B] [encrypted payload] [poly1305 tag 16B]
+ *
+ * Records are encrypted with chacha20-poly1305 under a random key, using the
+ * record number as nonce and the payload size as additional data, so that
+ * records cannot be modified, re-ordered or moved across journals. The key is
+ * wrapped, and the header signed, by a KeyStore. p3Config uses the node key.
+ */
+class p3ConfigJournal
+{
+public:
+	/// Protects the journal key and authenticates the journal header
+	class KeyStore
+	{
+	public:
+		virtual ~KeyStore() {}
+
+		virtual bool wrapKey(const uint8_t key[32], std::vector<uint8_t>& wrapped) = 0;
+		virtual bool unwrapKey(const std::vector<uint8_t>& wrapped, uint8_t key[32]) = 0;
+		virtual bool sign(const std::vector<uint8_t>& data, std::vector<uint8_t>& signature) = 0;
+		virtual bool verify(const std::vector<uint8_t>& data, const std::vector<uint8_t>& signature) = 0;
+	};
+
+	static const uint32_t MAGIC           = 0x524a4e4c;	// "RJNL"
+	static const uint32_t TAG_SIZE        = 16;
+	static const uint32_t MAX_RECORD_SIZE = 16*1024*1024;
+
+	explicit p3ConfigJournal(KeyStore& keys);
+	~p3ConfigJournal();
+
+	/// Starts a new journal, following the config file of the given hash. Replaces any existing file.
+	bool create(const std::string& fname, const RsFileHash& configHash);
+
+	/**
+	 * Opens an existing journal for appending, after reading its records into
+	 * payloads. Fails if the header is not authentic or does not follow the
+	 * config file of the given hash. Reading stops at the first record that is
+	 * truncated or does not authenticate, and new records are written over it.
+	 */
+	bool open( const std::string& fname, const RsFileHash& configHash,
+	           std::list<std::vector<uint8_t> >& payloads );
+
+	/// Appends a record. On failure the journal is closed, since its end is garbage.
+	bool append(const std::vector<uint8_t>& payload);
+
+	void close();
+
+	bool isOpen() const { return mFile != NULL; }
+	uint64_t size() const { return mSize; }	// in bytes, header included
+	uint64_t recordCount() const { return mCounter; }
+
+	/// Nonce of the given record
+	static void recordNonce(uint64_t counter, uint8_t nonce[12]);
+
+private:
+	KeyStore& mKeys;
+
+	FILE *mFile;
+	uint8_t mKey[32];
+	uint64_t mCounter;	// number of records, used as nonce
+	uint64_t mSize;
+};
@@ -29,6 +29,7 @@
 #include <rsserver/p3face.h>
 #include <util/rsdiscspace.h>
 #include "util/rsstring.h"
+#include "util/rsprint.h"
 
 #include "rsitems/rsconfigitems.h"
 
@@ -37,6 +38,66 @@
 */
 #define BACKEDUP_SAVE
 
+// Journal records are [op 1B] [serialised item], @see p3ConfigJournal for the file format.
+
+static const uint64_t JOURNAL_MIN_COMPACTION_SIZE = 64*1024 ;
+static const uint8_t  JOURNAL_OP_ADD              = 0x01 ;
+static const uint8_t  JOURNAL_OP_REMOVE           = 0x02 ;
+
+/* Journal keys are encrypted for, and journal headers signed by, the own node key */
+class p3ConfigJournalNodeKeys: public p3ConfigJournal::KeyStore
+{
+public:
+	bool wrapKey(const uint8_t key[32], std::vector<uint8_t>& wrapped) override
+	{
+		void *out = NULL;
+		int outlen = 0;
+
+		if(!AuthSSL::getAuthSSL()->encrypt(out,outlen,key,32,AuthSSL::getAuthSSL()->OwnId()))
+			return false;
+
+		wrapped.assign((uint8_t*)out,(uint8_t*)out + outlen);
+		free(out);
+		return true;
+	}
+
+	bool unwrapKey(const std::vector<uint8_t>& wrapped, uint8_t key[32]) override
+	{
+		void *out = NULL;
+		int outlen = 0;
+
+		bool ok = AuthSSL::getAuthSSL()->decrypt(out,outlen,wrapped.data(),wrapped.size()) && outlen == 32;
+
+		if(ok)
+			memcpy(key,out,32);
+
+		if(out)
+		{
+			memset(out,0,outlen);
+			free(out);
+		}
+		return ok;
+	}
+
+	bool sign(const std::vector<uint8_t>& data, std::vector<uint8_t>& signature) override
+	{
+		std::string hex;
+
+		if(!AuthSSL::getAuthSSL()->SignData(data.data(),data.size(),hex) || hex.length() < 2)
+			return false;
+
+		signature.resize(hex.length()/2);
+		return RsUtil::HexToBin(hex,signature.data(),signature.size());
+	}
+
+	bool verify(const std::vector<uint8_t>& data, const std::vector<uint8_t>& signature) override
+	{
+		std::vector<uint8_t> sig(signature);	// VerifyOwnSignBin() does not take const data
+		return AuthSSL::getAuthSSL()->VerifyOwnSignBin(data.data(),data.size(),sig.data(),sig.size());
+	}
+};
+
+static p3ConfigJournalNodeKeys journalNodeKeys;
 
 p3ConfigMgr::p3ConfigMgr(std::string dir)
         :basedir(dir), cfgMtx("p3ConfigMgr"),
@@ -169,9 +230,18 @@ void    p3ConfigMgr::completeConfiguration()
 
 
 p3Config::p3Config()
-	:pqiConfig()
+	:pqiConfig(), mJournalMtx("p3Config journal"), mJournal(journalNodeKeys), mSnapshotSize(0),
+	  mJournalSuspended(false), mJournalDisabled(false), mJournalLoading(false), mJournalReplaying(false),
+	  mJournalSerialiser(NULL)
 {
-	return;
+}
+
+p3Config::~p3Config()
+{
+	RS_STACK_MUTEX(mJournalMtx);
+
+	mJournal.close();
+	delete mJournalSerialiser;
 }
 
 
@@ -239,7 +309,22 @@ bool p3Config::loadConfig()
 
 
 	if(pass)
+	{
+		uint64_t size = 0;
+		RsDirUtil::checkFile(cfgFname,size) || RsDirUtil::checkFile(cfgFnameBackup,size);
+
+		{
+			RS_STACK_MUTEX(mJournalMtx);
+			mSnapshotSize = size;
+			mJournalLoading = true;
+		}
 		loadList(load);
+		replayJournal();
+		{
+			RS_STACK_MUTEX(mJournalMtx);
+			mJournalLoading = false;
+		}
+	}
 	else
 		return false;
 
@@ -312,6 +397,13 @@ bool p3Config::saveConfiguration()
 
 bool p3Config::saveConfig()
 {
+	// From now on, journal records may or may not be part of the new config file. They are kept aside to be written
+	// in the journal of the new file.
+	{
+		RS_STACK_MUTEX(mJournalMtx);
+		mJournalSuspended = true;
+	}
+
 	bool cleanup = true;
 	std::list<RsItem *> toSave;
 	saveList(cleanup, toSave);
@@ -345,6 +437,10 @@ bool p3Config::saveConfig()
 
 	/* store the hash */
 	setHash(cfg_bio->gethash());
+	uint64_t snapshot_size = cfg_bio->bytecount();
+
+	// The backup files are missing on first save, which makes written false although the new file is in place.
+	bool replaced = written;
 
 	// bio is taken care of in stream's destructor, also forces file to close
 	delete stream;
@@ -385,16 +481,193 @@ bool p3Config::saveConfig()
 	#endif
 
 				written = false;
+				replaced = false;
 			}
 
 
 
 	saveDone(); // callback to inherited class to unlock any Mutexes protecting saveList() data
 
+	bool journal_lost = false;
+	{
+		RS_STACK_MUTEX(mJournalMtx);
+
+		mJournalSuspended = false;
+
+		if(replaced)
+		{
+			// The journal is now part of the new config file.
+
+			mJournal.close();
+			mJournalDisabled = false;
+			mSnapshotSize = snapshot_size;
+
+			std::string jnlFname = cfgFname + ".jnl";
+
+			if(RsDirUtil::fileExists(jnlFname))
+				RsDirUtil::removeFile(jnlFname);
+
+			for(std::list<std::vector<uint8_t> >::iterator it(mPendingJournalRecords.begin());it!=mPendingJournalRecords.end() && !journal_lost;++it)
+				journal_lost = !locked_appendJournal(*it);
+		}
+		else
+		{
+			// We cannot tell which config file is on disk anymore, so the journal cannot be trusted to follow it.
+
+			mJournal.close();
+			mJournalDisabled = true;
+			journal_lost = !mPendingJournalRecords.empty();
+		}
+		mPendingJournalRecords.clear();
+	}
+	if(journal_lost)
+		IndicateConfigChanged(RsConfigMgr::CheckPriority::SAVE_OFTEN);
+
 	return written;
 
 }
 
+void p3Config::journalAddItem(RsItem *item, RsConfigMgr::CheckPriority t)
+{
+	journalItem(item,false,t);
+}
+
+void p3Config::journalRemoveItem(RsItem *item, RsConfigMgr::CheckPriority t)
+{
+	journalItem(item,true,t);
+}
+
+void p3Config::loadJournalItem(RsItem *item, bool removed)
+{
+	if(removed)
+	{
+		RsErr() << __PRETTY_FUNCTION__ << " removal record in journal of " << Filename() << " is not handled by the service. Dropping it.";
+		delete item;
+		return;
+	}
+
+	std::list<RsItem *> load;
+	load.push_back(item);
+
+	loadList(load);
+}
+
+void p3Config::journalItem(RsItem *item, bool removed, RsConfigMgr::CheckPriority t)
+{
+	bool written = false;
+	bool compact = false;
+	{
+		RS_STACK_MUTEX(mJournalMtx);
+
+		if(mJournalReplaying)
+			return;	// the change comes from the journal itself
+
+		// While loading, the journal of the loaded file is not open yet, and must not be replaced.
+
+		if(!mJournalDisabled && !mJournalLoading)
+		{
+			if(!mJournalSerialiser)
+				mJournalSerialiser = setupSerialiser();
+
+			uint32_t size = mJournalSerialiser->size(item);
+			std::vector<uint8_t> payload(1 + size);
+			payload[0] = removed ? JOURNAL_OP_REMOVE : JOURNAL_OP_ADD;
+
+			if(size == 0 || size >= p3ConfigJournal::MAX_RECORD_SIZE || !mJournalSerialiser->serialise(item,&payload[1],&size))
+				RsErr() << __PRETTY_FUNCTION__ << " cannot serialise item for journal of " << Filename();
+			else if(mJournalSuspended)
+			{
+				mPendingJournalRecords.push_back(payload);
+				return;
+			}
+			else
+				written = locked_appendJournal(payload);
+
+			compact = written && mJournal.size() > std::max(JOURNAL_MIN_COMPACTION_SIZE,mSnapshotSize);
+		}
+	}
+
+	if(!written)
+		IndicateConfigChanged(t);
+	else if(compact)
+		IndicateConfigChanged(RsConfigMgr::CheckPriority::SAVE_OFTEN);
+}
+
+bool p3Config::locked_appendJournal(const std::vector<uint8_t>& payload)
+{
+	if(mJournalDisabled)
+		return false;
+
+	if(!mJournal.isOpen())
+	{
+		RsFileHash snapshotHash(Hash());
+
+		if(snapshotHash.isNull())	// no config file to follow yet. A full save is needed first.
+			return false;
+
+		if(!mJournal.create(Filename() + ".jnl",snapshotHash))
+			return false;
+	}
+
+	if(!mJournal.append(payload))
+	{
+		// The end of the journal is now garbage. Stop using it until the next full save.
+
+		RsErr() << __PRETTY_FUNCTION__ << " cannot write to journal of " << Filename();
+		mJournalDisabled = true;
+		return false;
+	}
+	return true;
+}
+
+void p3Config::replayJournal()
+{
+	std::string jnlFname = Filename() + ".jnl";
+	std::list<std::pair<RsItem*,bool> > items;
+	{
+		RS_STACK_MUTEX(mJournalMtx);
+
+		mJournal.close();
+
+		if(!RsDirUtil::fileExists(jnlFname))
+			return;
+
+		std::list<std::vector<uint8_t> > payloads;
+
+		if(!mJournal.open(jnlFname,Hash(),payloads))
+		{
+			// Most likely the journal of a config file that was replaced by a full save before the journal got removed.
+
+			RsInfo() << "Journal " << jnlFname << " does not match config file. Discarding it.";
+			RsDirUtil::removeFile(jnlFname);
+			return;
+		}
+
+		if(!mJournalSerialiser)
+			mJournalSerialiser = setupSerialiser();
+
+		for(std::list<std::vector<uint8_t> >::iterator it(payloads.begin());it!=payloads.end();++it)
+		{
+			uint32_t itemSize = it->size() - 1;
+			RsItem *item = mJournalSerialiser->deserialise(&(*it)[1],&itemSize);
+
+			if(item)
+				items.push_back(std::make_pair(item,(*it)[0] == JOURNAL_OP_REMOVE));
+			else
+				RsErr() << "Journal " << jnlFname << ": cannot deserialise record. Skipping it.";
+		}
+
+		RsInfo() << "Replaying " << mJournal.recordCount() << " records from journal " << jnlFname;
+		mJournalReplaying = true;
+	}
+
+	for(std::list<std::pair<RsItem*,bool> >::iterator it(items.begin());it!=items.end();++it)
+		loadJournalItem(it->first,it->second);
+
+	RS_STACK_MUTEX(mJournalMtx);
+	mJournalReplaying = false;
+}
+
 
 /**************************** CONFIGURATION CLASSES ********************/
 
@@ -446,7 +719,13 @@ void            p3GeneralConfig::setSetting(const std::string &opt, const std::s
 		settings[opt] = val;
 	}
 	/* outside mutex */
-	IndicateConfigChanged();
+	RsConfigKeyValueSet item;
+	RsTlvKeyValue kv;
+	kv.key = opt;
+	kv.value = val;
+	item.tlvkvs.pairs.push_back(kv);
+
+	journalAddItem(&item, RsConfigMgr::CheckPriority::SAVE_WHEN_CLOSING);
 
 	return;
 }
@@ -25,8 +25,11 @@
 #include <string>
 #include <map>
 #include <set>
+#include <list>
+#include <vector>
 
 #include "pqi/pqi_base.h"
+#include "pqi/p3cfgjournal.h"
 #include "pqi/pqiindic.h"
 #include "pqi/pqinetwork.h"
 #include "util/rsthreads.h"
@@ -214,11 +217,22 @@ class p3ConfigMgr: public RsConfigMgr
  * @brief Abstract class for configuration saving.
  * Aimed at rs services that uses RsItem config data, provide a way for RS
  * services to save and load particular configurations as items.
+ *
+ * Services that change their configuration often can avoid rewriting the
+ * whole file on every change by recording each change in a journal, using
+ * journalAddItem() and journalRemoveItem(). The journal is a file next to the
+ * configuration file, where records are appended and authenticated with a key
+ * that is itself encrypted and signed with the node key. It is tied to the
+ * hash of the configuration file it follows, and is replayed on top of it at
+ * load time. Once it grows larger than the configuration file, a full save is
+ * requested, which compacts the journal into a new configuration file.
+ * Services that do not call the journal functions behave as before.
  */
 class p3Config : public pqiConfig
 {
 public:
 	p3Config();
+	virtual ~p3Config();
 
 	virtual bool loadConfiguration(RsFileHash &loadHash);
 	virtual bool saveConfiguration();
@@ -250,6 +264,28 @@ protected:
 	 */
 	virtual void saveDone() {}
 
+	/**
+	 * Records the addition (resp. removal) of an item in the journal. The
+	 * item is only serialised, and still belongs to the caller. Records must
+	 * be idempotent (e.g. "set key to value", "remove key"), since a record
+	 * appended while a full save is running may be both in the new
+	 * configuration file and in the journal. Must not be called with cfgMtx
+	 * locked. When the journal cannot be written, falls back to
+	 * IndicateConfigChanged(t).
+	 */
+	void journalAddItem(RsItem *item, RsConfigMgr::CheckPriority t = RsConfigMgr::CheckPriority::SAVE_OFTEN);
+	void journalRemoveItem(RsItem *item, RsConfigMgr::CheckPriority t = RsConfigMgr::CheckPriority::SAVE_OFTEN);
+
+	/**
+	 * Called at load time for each journal record, after loadList() was called
+	 * with the content of the configuration file. The item belongs to the
+	 * callee. Default passes added items to loadList() and drops removals, so
+	 * services that journal removals, or whose loadList() expects the whole
+	 * configuration, must overload it. Changes made meanwhile are not
+	 * journalled again.
+	 */
+	virtual void loadJournalItem(RsItem *item, bool removed);
+
 private:
 
 	bool loadConfig();
@@ -257,6 +293,29 @@ private:
 
 	bool loadAttempt( const std::string&, const std::string&,
 	                  std::list<RsItem *>& load );
+
+	void journalItem(RsItem *item, bool removed, RsConfigMgr::CheckPriority t);
+	void replayJournal();
+
+	bool locked_appendJournal(const std::vector<uint8_t>& payload);
+
+	RsMutex mJournalMtx; /* below is protected */
+
+	p3ConfigJournal mJournal;
+	uint64_t mSnapshotSize;		// size of the config file, used to decide when to compact the journal
+
+	// While a full save is running, records are kept here and written to the journal of the new config file.
+	bool mJournalSuspended;
+	std::list<std::vector<uint8_t> > mPendingJournalRecords;
+
+	// Set when the journal cannot be trusted to follow the config file. Changes then go through a full save.
+	bool mJournalDisabled;
+
+	// Set while loading, when changes go through a full save, and while replaying, when they are dropped.
+	bool mJournalLoading;
+	bool mJournalReplaying;
+
+	RsSerialiser *mJournalSerialiser;
 }; // end of p3Config
 
 
@@ -22,6 +22,7 @@
 #include "util/rstime.h"
 
 #include "p3historymgr.h"
+#include "pqi/historystore.h"
 #include "rsitems/rshistoryitems.h"
 #include "rsitems/rsconfigitems.h"
 #include "retroshare/rsiface.h"
@@ -38,21 +39,41 @@
 //
 #define MSG_HISTORY_CLEANING_PERIOD  300
 
+// number of messages of each chat that stay in memory
+//
+#define MSG_HISTORY_RECENT_WINDOW    100
+
 RsHistory *rsHistory = NULL;
 
-p3HistoryMgr::p3HistoryMgr()
+p3HistoryMgr::p3HistoryMgr(const std::string& dbPath, const std::string& key)
     : p3Config()
     , nextMsgId(1)
+    , mStore(new HistoryStore(dbPath, key))
     , mPublicEnable(false), mLobbyEnable(true), mPrivateEnable(true), mDistantEnable(true)
     , mPublicSaveCount(0), mLobbySaveCount(0), mPrivateSaveCount(0), mDistantSaveCount(0)
     , mMaxStorageDurationSeconds(10*86400) // store for 10 days at most.
     , mLastCleanTime(0)
     , mHistoryMtx("p3HistoryMgr")
 {
+	nextMsgId = mStore->maxMsgId() + 1;
 }
 
 p3HistoryMgr::~p3HistoryMgr()
 {
+	for(std::map<RsPeerId, RecentWindow>::iterator mit = mRecent.begin(); mit != mRecent.end(); ++mit)
+		for(std::map<uint32_t, RsHistoryMsgItem*>::iterator lit = mit->second.msgs.begin(); lit != mit->second.msgs.end(); ++lit)
+			delete lit->second;
+
+	delete mStore;
+}
+
+void p3HistoryMgr::trimWindow(RecentWindow& w, uint32_t size)
+{
+	while (w.msgs.size() > size) {
+		delete(w.msgs.begin()->second);
+		w.msgs.erase(w.msgs.begin());
+		w.complete = false;
+	}
 }
 
 /***** p3HistoryMgr *****/
@@ -130,38 +151,43 @@ void p3HistoryMgr::addMessage(const ChatMessage& cm)
 		item->message = cm.msg ;
 		//librs::util::ConvertUtf16ToUtf8(chatItem->message, item->message);
 
-		std::map<RsPeerId, std::map<uint32_t, RsHistoryMsgItem*> >::iterator mit = mMessages.find(item->chatPeerId);
-		if (mit != mMessages.end()) {
-			item->msgId = nextMsgId++;
-			mit->second.insert(std::make_pair(item->msgId, item));
-			addMsgId = item->msgId;
-
-			// check the limit
-			uint32_t limit;
-			if (chatPeerId.isNull()) 
-				limit = mPublicSaveCount;
-			else if (cm.chat_id.isLobbyId())
-				limit = mLobbySaveCount;
-			else 
-				limit = mPrivateSaveCount;
-
-			if (limit) {
-				while (mit->second.size() > limit) {
-					delete(mit->second.begin()->second);
-					mit->second.erase(mit->second.begin());
-				}
+		item->msgId = nextMsgId++;
+		addMsgId = item->msgId;
+
+		// When the history store could not be opened, the windows hold the whole history, which goes
+		// to the config file as it did before the store existed.
+
+		bool stored = mStore->isOpen();
+
+		if (stored)
+			mStore->addMessages(std::list<RsHistoryMsgItem*>(1, item));
+
+		RecentWindow& w = mRecent[chatPeerId];
+		w.msgs.insert(std::make_pair(item->msgId, item));
+
+		// check the limit
+		uint32_t limit;
+		if (chatPeerId.isNull()) 
+			limit = mPublicSaveCount;
+		else if (cm.chat_id.isLobbyId())
+			limit = mLobbySaveCount;
+		else 
+			limit = mPrivateSaveCount;
+
+		if (limit) {
+			if (stored)
+				mStore->trimChat(chatPeerId, limit);
+
+			if (w.msgs.size() >= limit) {
+				trimWindow(w, limit);
+				w.complete = true;
 			}
-		} else {
-			std::map<uint32_t, RsHistoryMsgItem*> msgs;
-			item->msgId = nextMsgId++;
-			msgs.insert(std::make_pair(item->msgId, item));
-			mMessages.insert(std::make_pair(item->chatPeerId, msgs));
-			addMsgId = item->msgId;
-
-			// no need to check the limit
 		}
 
-		IndicateConfigChanged();
+		if (stored)
+			trimWindow(w, MSG_HISTORY_RECENT_WINDOW);
+		else
+			IndicateConfigChanged();
 	}
 
 	if (addMsgId) {
@@ -173,53 +199,42 @@ void p3HistoryMgr::cleanOldMessages()
 {
 	RsStackMutex stack(mHistoryMtx); /********** STACK LOCKED MTX ******/
 
+	if (mMaxStorageDurationSeconds == 0)
+		return;
+
 #ifdef HISTMGR_DEBUG
 	std::cerr << "****** cleaning old messages." << std::endl;
 #endif
 	rstime_t now = time(NULL) ;
-	bool changed = false ;
-
-	for(std::map<RsPeerId, std::map<uint32_t, RsHistoryMsgItem*> >::iterator mit = mMessages.begin(); mit != mMessages.end();) 
-	{
-		if (mMaxStorageDurationSeconds > 0)
-		{
-			for(std::map<uint32_t, RsHistoryMsgItem*>::iterator lit = mit->second.begin();lit!=mit->second.end();)
-				if(lit->second->recvTime + mMaxStorageDurationSeconds < now)
-				{
-					std::map<uint32_t, RsHistoryMsgItem*>::iterator lit2 = lit ;
-					++lit2 ;
 
-#ifdef HISTMGR_DEBUG
-					std::cerr << "   removing msg id " << lit->first << ", for peer id " << mit->first << std::endl;
-#endif
-					delete lit->second ;
+	mStore->removeOlderThan(now - mMaxStorageDurationSeconds) ;
 
-					mit->second.erase(lit) ;
-					lit = lit2 ;
+	// The same messages go away from the windows, so that they still match the store.
 
-					changed = true ;
-				}
-				else
-					++lit ;
-		}
+	bool changed = false ;
 
-		if(mit->second.empty())
-		{
-			std::map<RsPeerId, std::map<uint32_t, RsHistoryMsgItem*> >::iterator mit2 = mit ;
-			++mit2 ;
+	for(std::map<RsPeerId, RecentWindow>::iterator mit = mRecent.begin(); mit != mRecent.end();) 
+	{
+		for(std::map<uint32_t, RsHistoryMsgItem*>::iterator lit = mit->second.msgs.begin();lit!=mit->second.msgs.end();)
+			if(lit->second->recvTime + mMaxStorageDurationSeconds < now)
+			{
 #ifdef HISTMGR_DEBUG
-			std::cerr << "   removing peer id " << mit->first << ", since it has no messages" << std::endl;
+				std::cerr << "   removing msg id " << lit->first << ", for peer id " << mit->first << std::endl;
 #endif
-			mMessages.erase(mit) ;
-			mit = mit2 ;
+				delete lit->second ;
+				lit = mit->second.msgs.erase(lit) ;
+				changed = true ;
+			}
+			else
+				++lit ;
 
-			changed = true ;
-		}
+		if(mit->second.msgs.empty())
+			mit = mRecent.erase(mit) ;
 		else
 			++mit ;
 	}
 
-	if(changed)
+	if(changed && !mStore->isOpen())
 		IndicateConfigChanged() ;
 }
 
@@ -240,15 +255,13 @@ bool p3HistoryMgr::saveList(bool& cleanup, std::list<RsItem*>& saveData)
 
 	mHistoryMtx.lock(); /********** STACK LOCKED MTX ******/
 
-	std::map<RsPeerId, std::map<uint32_t, RsHistoryMsgItem*> >::iterator mit;
-	std::map<uint32_t, RsHistoryMsgItem*>::iterator lit;
-	for (mit = mMessages.begin(); mit != mMessages.end(); ++mit) {
-		for (lit = mit->second.begin(); lit != mit->second.end(); ++lit) {
-			if (lit->second->saveToDisc) {
-				saveData.push_back(lit->second);
-			}
-		}
-	}
+	// messages are in the history store, only settings go to the config file, unless the store could not be opened
+
+	if (!mStore->isOpen())
+		for (std::map<RsPeerId, RecentWindow>::iterator mit = mRecent.begin(); mit != mRecent.end(); ++mit)
+			for (std::map<uint32_t, RsHistoryMsgItem*>::iterator lit = mit->second.msgs.begin(); lit != mit->second.msgs.end(); ++lit)
+				if (lit->second->saveToDisc)
+					saveData.push_back(lit->second);
 
 	RsConfigKeyValueSet *vitem = new RsConfigKeyValueSet;
 
@@ -315,28 +328,16 @@ bool p3HistoryMgr::loadList(std::list<RsItem*>& load)
 
 	RsHistoryMsgItem *msgItem;
 	std::list<RsItem*>::iterator it;
+	std::list<RsHistoryMsgItem*> oldMsgs;
 
 	for (it = load.begin(); it != load.end(); ++it) 
    	 {
 		if (NULL != (msgItem = dynamic_cast<RsHistoryMsgItem*>(*it))) {
 
-			std::map<RsPeerId, std::map<uint32_t, RsHistoryMsgItem*> >::iterator mit = mMessages.find(msgItem->chatPeerId);
-			msgItem->msgId = nextMsgId++;
-
-#ifdef HISTMGR_DEBUG
-			std::cerr << "Loading msg history item: peer id=" << msgItem->chatPeerId << "), msg id =" << msgItem->msgId  << std::endl;
-#endif
-
-			if (mit != mMessages.end()) {
-				mit->second.insert(std::make_pair(msgItem->msgId, msgItem));
-			} else {
-				std::map<uint32_t, RsHistoryMsgItem*> msgs;
-				msgs.insert(std::make_pair(msgItem->msgId, msgItem));
-				mMessages.insert(std::make_pair(msgItem->chatPeerId, msgs));
-			}
-
-			// don't delete the item !!
+			// messages saved in the config file by older versions, or while the store could not be
+			// opened. They are moved to the history store below, when it is open.
 
+			oldMsgs.push_back(msgItem);
 			continue;
 		}
 
@@ -401,6 +402,37 @@ bool p3HistoryMgr::loadList(std::list<RsItem*>& load)
 	}
 
     load.clear() ;
+
+	if (!oldMsgs.empty() && !mStore->isOpen()) {
+		// keep them in memory, they are saved again in the config file
+
+		for (std::list<RsHistoryMsgItem*>::iterator mit = oldMsgs.begin(); mit != oldMsgs.end(); ++mit) {
+			(*mit)->msgId = nextMsgId++;
+
+			RecentWindow& w = mRecent[(*mit)->chatPeerId];
+			w.msgs.insert(std::make_pair((*mit)->msgId, *mit));
+			w.complete = true;
+		}
+	}
+	else if (!oldMsgs.empty()) {
+		// If the store already has messages, these were imported before but the config file was not saved since.
+
+		if (mStore->maxMsgId() == 0) {
+			for (std::list<RsHistoryMsgItem*>::iterator mit = oldMsgs.begin(); mit != oldMsgs.end(); ++mit)
+				(*mit)->msgId = nextMsgId++;
+
+#ifdef HISTMGR_DEBUG
+			std::cerr << "Moving " << oldMsgs.size() << " msg history items to the history store" << std::endl;
+#endif
+			mStore->addMessages(oldMsgs);
+		}
+
+		for (std::list<RsHistoryMsgItem*>::iterator mit = oldMsgs.begin(); mit != oldMsgs.end(); ++mit)
+			delete (*mit);
+
+		IndicateConfigChanged();
+	}
+
 	return true;
 }
 
@@ -481,15 +513,39 @@ bool p3HistoryMgr::getMessages(const ChatId &chatId, std::list<HistoryMsg> &msgs
     std::cerr << "Getting history for virtual peer " << chatPeerId << std::endl;
 #endif
 
-	uint32_t foundCount = 0;
+	RecentWindow& w = mRecent[chatPeerId];
 
-	std::map<RsPeerId, std::map<uint32_t, RsHistoryMsgItem*> >::iterator mit = mMessages.find(chatPeerId);
+	if (!w.complete && (loadCount == 0 || loadCount > w.msgs.size()) && mStore->isOpen())
+	{
+		// not enough messages in memory, read them from the store and keep the last ones
+
+		std::list<RsHistoryMsgItem*> items;
+		mStore->getMessages(chatPeerId, loadCount, items);
+
+		trimWindow(w, 0);
+		w.complete = (loadCount == 0 || items.size() < loadCount) && items.size() <= MSG_HISTORY_RECENT_WINDOW;
 
-	if (mit != mMessages.end()) 
+		uint32_t skip = items.size() > MSG_HISTORY_RECENT_WINDOW ? items.size() - MSG_HISTORY_RECENT_WINDOW : 0;
+
+		for (std::list<RsHistoryMsgItem*>::iterator lit = items.begin(); lit != items.end(); ++lit)
+		{
+			HistoryMsg msg;
+			convertMsg(*lit, msg);
+			msgs.push_back(msg);
+
+			if (skip > 0) {
+				--skip;
+				delete (*lit);
+			} else
+				w.msgs.insert(std::make_pair((*lit)->msgId, *lit));
+		}
+	}
+	else
 	{
+		uint32_t foundCount = 0;
 		std::map<uint32_t, RsHistoryMsgItem*>::reverse_iterator lit;
 
-		for (lit = mit->second.rbegin(); lit != mit->second.rend(); ++lit)
+		for (lit = w.msgs.rbegin(); lit != w.msgs.rend(); ++lit)
 		{
 			HistoryMsg msg;
 			convertMsg(lit->second, msg);
@@ -511,16 +567,23 @@ bool p3HistoryMgr::getMessage(uint32_t msgId, HistoryMsg &msg)
 {
 	RsStackMutex stack(mHistoryMtx); /********** STACK LOCKED MTX ******/
 
-	std::map<RsPeerId, std::map<uint32_t, RsHistoryMsgItem*> >::iterator mit;
-	for (mit = mMessages.begin(); mit != mMessages.end(); ++mit) {
-		std::map<uint32_t, RsHistoryMsgItem*>::iterator lit = mit->second.find(msgId);
-		if (lit != mit->second.end()) {
+	std::map<RsPeerId, RecentWindow>::iterator mit;
+	for (mit = mRecent.begin(); mit != mRecent.end(); ++mit) {
+		std::map<uint32_t, RsHistoryMsgItem*>::iterator lit = mit->second.msgs.find(msgId);
+		if (lit != mit->second.msgs.end()) {
 			convertMsg(lit->second, msg);
 			return true;
 		}
 	}
 
-	return false;
+	RsHistoryMsgItem *item = mStore->getMessage(msgId);
+	if (item == NULL)
+		return false;
+
+	convertMsg(item, msg);
+	delete item;
+
+	return true;
 }
 
 void p3HistoryMgr::clear(const ChatId &chatId)
@@ -536,19 +599,16 @@ void p3HistoryMgr::clear(const ChatId &chatId)
         std::cerr << "********** p3History::clear()called for virtual peer id " << chatPeerId << std::endl;
 #endif
 
-		std::map<RsPeerId, std::map<uint32_t, RsHistoryMsgItem*> >::iterator mit = mMessages.find(chatPeerId);
-		if (mit == mMessages.end()) {
-			return;
-		}
+		mStore->clearChat(chatPeerId);
 
-		std::map<uint32_t, RsHistoryMsgItem*>::iterator lit;
-		for (lit = mit->second.begin(); lit != mit->second.end(); ++lit) {
-			delete(lit->second);
+		std::map<RsPeerId, RecentWindow>::iterator mit = mRecent.find(chatPeerId);
+		if (mit != mRecent.end()) {
+			trimWindow(mit->second, 0);
+			mRecent.erase(mit);
 		}
-		mit->second.clear();
-		mMessages.erase(mit);
 
-		IndicateConfigChanged();
+		if (!mStore->isOpen())
+			IndicateConfigChanged();
 	}
 
 	RsServer::notify()->notifyHistoryChanged(0, NOTIFY_TYPE_MOD);
@@ -556,9 +616,8 @@ void p3HistoryMgr::clear(const ChatId &chatId)
 
 void p3HistoryMgr::removeMessages(const std::list<uint32_t> &msgIds)
 {
-	std::list<uint32_t> ids = msgIds;
 	std::list<uint32_t> removedIds;
-	std::list<uint32_t>::iterator iit;
+	std::list<uint32_t>::const_iterator iit;
 
 #ifdef HISTMGR_DEBUG
 	std::cerr << "********** p3History::removeMessages called()" << std::endl;
@@ -566,36 +625,34 @@ void p3HistoryMgr::removeMessages(const std::list<uint32_t> &msgIds)
 	{
 		RsStackMutex stack(mHistoryMtx); /********** STACK LOCKED MTX ******/
 
-		std::map<RsPeerId, std::map<uint32_t, RsHistoryMsgItem*> >::iterator mit;
-		for (mit = mMessages.begin(); mit != mMessages.end(); ++mit)
+		mStore->removeMessages(msgIds, removedIds);
+
+		std::map<RsPeerId, RecentWindow>::iterator mit;
+		for (mit = mRecent.begin(); mit != mRecent.end(); ++mit)
 		{
-			iit = ids.begin();
-			while ( !ids.empty() || (iit != ids.end()) )
+			for (iit = msgIds.begin(); iit != msgIds.end(); ++iit)
 			{
-				std::map<uint32_t, RsHistoryMsgItem*>::iterator lit = mit->second.find(*iit);
-				if (lit != mit->second.end())
+				std::map<uint32_t, RsHistoryMsgItem*>::iterator lit = mit->second.msgs.find(*iit);
+				if (lit != mit->second.msgs.end())
 				{
 #ifdef HISTMGR_DEBUG
 					std::cerr << "**** Removing " << mit->first << " msg id = " << lit->first << std::endl;
 #endif
 
 					delete(lit->second);
-					mit->second.erase(lit);
+					mit->second.msgs.erase(lit);
 
-					removedIds.push_back(*iit);
-					iit = ids.erase(iit);
-
-					continue;
+					if (!mStore->isOpen())
+						removedIds.push_back(*iit);
 				}
-
-				++iit;
 			}
 		}
 	}
 
 	if (!removedIds.empty())
 	{
-		IndicateConfigChanged();
+		if (!mStore->isOpen())
+			IndicateConfigChanged();
 
 		for (iit = removedIds.begin(); iit != removedIds.end(); ++iit)
 			RsServer::notify()->notifyHistoryChanged(*iit, NOTIFY_TYPE_DEL);
@@ -31,16 +31,21 @@
 
 class RsChatMsgItem;
 class ChatMessage;
+class HistoryStore;
 
 //! handles history
 /*!
  * The is a retroshare service which allows peers
  * to store the history of the chat messages
+ *
+ * Messages are stored in a HistoryStore database. Only the last messages of
+ * the chats that were asked for are kept in memory. The configuration file
+ * only holds the settings.
  */
 class p3HistoryMgr: public p3Config
 {
 public:
-	p3HistoryMgr();
+	p3HistoryMgr(const std::string& dbPath, const std::string& key);
 	virtual ~p3HistoryMgr();
 
 	/******** p3HistoryMgr *********/
@@ -71,8 +76,23 @@ public:
 	static bool chatIdToVirtualPeerId(const ChatId& chat_id, RsPeerId& peer_id);
 
 private:
+	// Last messages of a chat. The window holds all stored messages of the chat from its first one on, and
+	// complete is true when there are no older messages in the store. When the store could not be opened, the
+	// windows are not trimmed and hold the whole history.
+	struct RecentWindow
+	{
+		RecentWindow() : complete(false) {}
+
+		std::map<uint32_t, RsHistoryMsgItem*> msgs;
+		bool complete;
+	};
+
+	// Drops the oldest messages of the window, so that it holds at most size messages.
+	static void trimWindow(RecentWindow& w, uint32_t size);
+
 	uint32_t nextMsgId;
-	std::map<RsPeerId, std::map<uint32_t, RsHistoryMsgItem*> > mMessages;
+	std::map<RsPeerId, RecentWindow> mRecent;
+	HistoryStore *mStore;
 
 	// Removes messages stored for more than mMaxMsgStorageDurationSeconds seconds.
 	// This avoids the stored list to grow crazy with time.
@@ -306,6 +306,12 @@ public:
 	virtual bool moretoread(uint32_t usec) = 0;
 	virtual bool cansend(uint32_t usec) = 0;
 
+	/**
+	 * Kernel file descriptor which an event loop can watch for readiness.
+	 * @return the descriptor or -1 if the interface is not backed by one
+	 */
+	virtual int pollableFd() { return -1; }
+
 	/**
 	 *  method for streamer to shutdown bininterface
 	 **/
@@ -0,0 +1,508 @@
+/*******************************************************************************
+ * libretroshare/src/pqi: pqinetreactor.cc                                     *
+ *                                                                             *
+ * libretroshare: retroshare core library                                      *
+ *                                                                             *
+ * Copyright (C) 2026  RetroShare Team <contact@retroshare.cc>                 *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Lesser General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ *******************************************************************************/
+
+#include <chrono>
+#include <thread>
+#include <limits>
+
+#ifdef __linux__
+#	include <sys/epoll.h>
+#	include <sys/eventfd.h>
+#	include <cerrno>
+#	include <cstring>
+#endif
+
+#include "pqi/pqinetreactor.h"
+#include "pqi/pqithreadstreamer.h"
+#include "util/rsdebug.h"
+#include "util/stacktrace.h"
+
+//#define DEBUG_PQINETREACTOR 1
+
+/// Max reactor threads, more than this is surely a configuration mistake
+static const uint32_t PQI_REACTOR_MAX_THREADS = 64;
+
+/// Retry period after an epoll failure, same as pqithreadstreamer sleep
+static const int PQI_REACTOR_BUSY_TIMEOUT_MS = 30;
+
+/// Max sleep while no work is pending, keeps rate statistics updated
+static const int PQI_REACTOR_IDLE_TIMEOUT_MS = 1000;
+
+static const int PQI_REACTOR_MAX_EVENTS = 64;
+
+std::atomic<uint32_t> pqiNetReactor::sThreadCount(0);
+std::atomic<pqiNetReactor*> pqiNetReactor::sInstance(nullptr);
+RsMutex pqiNetReactor::sInstanceMtx("pqiNetReactor::sInstanceMtx");
+
+#ifdef __linux__
+
+class pqiNetReactor::Worker: public RsTickingThread
+{
+public:
+	Worker() : mEpollFd(-1), mWakeFd(-1), mOpsMtx("pqiNetReactor::Worker"),
+	    mOpsQueued(0), mOpsApplied(0), mIdle(false)
+	{
+		mEpollFd = epoll_create1(EPOLL_CLOEXEC);
+		mWakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+		if(mEpollFd < 0 || mWakeFd < 0)
+		{
+			RsErr() << __PRETTY_FUNCTION__ << " failure creating epoll/eventfd: "
+			        << strerror(errno) << std::endl;
+			return;
+		}
+
+		epoll_event ev;
+		memset(&ev, 0, sizeof(ev));
+		ev.events = EPOLLIN;
+		ev.data.ptr = nullptr; // nullptr marks the wake up descriptor
+		epoll_ctl(mEpollFd, EPOLL_CTL_ADD, mWakeFd, &ev);
+	}
+
+	~Worker() override
+	{
+		if(mEpollFd >= 0) close(mEpollFd);
+		if(mWakeFd >= 0) close(mWakeFd);
+	}
+
+	bool isValid() const { return mEpollFd >= 0 && mWakeFd >= 0; }
+
+	/// @return ticket to be passed to waitApplied()
+	uint64_t queueOp(pqithreadstreamer* streamer, bool attach)
+	{
+		uint64_t ticket;
+		{
+			RS_STACK_MUTEX(mOpsMtx);
+			mOps.push_back(std::make_pair(streamer, attach));
+			ticket = ++mOpsQueued;
+		}
+		wakeUp();
+		return ticket;
+	}
+
+	void waitApplied(uint64_t ticket)
+	{
+		if(sCurrentWorker == this)
+		{
+			RsErr() << __PRETTY_FUNCTION__ << " called by reactor thread. This "
+			        << "should never happen!" << std::endl;
+			print_stacktrace();
+			return;
+		}
+
+		while(mOpsApplied < ticket && isRunning())
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+
+	void wakeUp()
+	{
+		uint64_t one = 1;
+		if(write(mWakeFd, &one, sizeof(one)) < 0 && errno != EAGAIN)
+			RsErr() << __PRETTY_FUNCTION__ << " " << strerror(errno)
+			        << std::endl;
+	}
+
+	/// Only pay the syscall if the worker is in a long sleep
+	void wakeUpIfIdle() { if(mIdle.exchange(false)) wakeUp(); }
+
+protected:
+	void threadTick() override
+	{
+		using namespace std::chrono;
+
+		sCurrentWorker = this;
+
+		applyPendingOps();
+
+		/* Each streamer is ticked at most once per its own tick interval, like
+		 * on its own thread, so its incoming rate limit keeps working. Socket
+		 * readiness in between is only recorded, and the socket disarmed until
+		 * the next tick, so a peer with pending data cannot keep us spinning */
+		auto now = steady_clock::now();
+		int timeout = PQI_REACTOR_IDLE_TIMEOUT_MS;
+		bool busy = false;
+		for(auto& it: mEntries)
+		{
+			const Entry& e(it.second);
+			if(!e.readable && !e.pending && !e.kicked) continue;
+
+			busy = true;
+			if(e.nextTick <= now) timeout = 0;
+			else
+			{
+				// Round up, waking up early would just loop once more
+				auto delay = duration_cast<milliseconds>(
+				            e.nextTick - now + milliseconds(1) ).count();
+				if(delay < timeout) timeout = static_cast<int>(delay);
+			}
+		}
+
+		if(!busy)
+		{
+			/* Publish we are going to sleep for long before checking again for
+			 * pending operations so notifyOutgoing() and queueOp() cannot be
+			 * missed */
+			mIdle = true;
+			RS_STACK_MUTEX(mOpsMtx);
+			if(!mOps.empty()) timeout = 0;
+		}
+
+		epoll_event events[PQI_REACTOR_MAX_EVENTS];
+		int nEvents = epoll_wait(
+		            mEpollFd, events, PQI_REACTOR_MAX_EVENTS, timeout );
+		mIdle = false;
+
+		if(nEvents < 0 && errno != EINTR)
+		{
+			RsErr() << __PRETTY_FUNCTION__ << " epoll_wait failed: "
+			        << strerror(errno) << std::endl;
+			std::this_thread::sleep_for(
+			            std::chrono::milliseconds(PQI_REACTOR_BUSY_TIMEOUT_MS) );
+			return;
+		}
+
+		for(int i = 0; i < nEvents; ++i)
+		{
+			if(!events[i].data.ptr)
+			{
+				uint64_t val;
+				while(read(mWakeFd, &val, sizeof(val)) > 0);
+
+				// Outgoing data may have been queued on any streamer
+				for(auto& it: mEntries) it.second.kicked = true;
+				continue;
+			}
+
+			/* EPOLLONESHOT disarmed the socket, it is armed again once the
+			 * streamer has been ticked */
+			Entry* e = static_cast<Entry*>(events[i].data.ptr);
+			e->readable = true;
+			e->armed = false;
+		}
+
+		now = steady_clock::now();
+		for(auto& it: mEntries)
+		{
+			Entry& e(it.second);
+			syncFd(e);
+			if(now < e.nextTick) continue;
+
+			bool pollable = e.fd >= 0;
+			e.pending = e.streamer->reactorTick(e.readable, pollable);
+			e.readable = false;
+			e.kicked = false;
+			e.nextTick = now + e.streamer->reactorTickInterval();
+			arm(e);
+		}
+	}
+
+	void onStopRequested() override { wakeUp(); }
+
+private:
+	struct Entry
+	{
+		Entry() : streamer(nullptr), fd(-1), armed(false), readable(false),
+		    pending(false), kicked(false) {}
+
+		pqithreadstreamer* streamer;
+		int fd;
+		bool armed;    /// fd is registered and not yet reported readable
+		bool readable; /// fd became readable since last tick
+		bool pending;  /// last tick left work to do
+		bool kicked;   /// woken up since last tick, outgoing data may wait
+		std::chrono::steady_clock::time_point nextTick;
+	};
+
+	void applyPendingOps()
+	{
+		std::list<std::pair<pqithreadstreamer*, bool>> ops;
+		uint64_t applied;
+		{
+			RS_STACK_MUTEX(mOpsMtx);
+			ops.swap(mOps);
+			applied = mOpsQueued;
+		}
+
+		for(auto& op: ops)
+		{
+			pqithreadstreamer* streamer = op.first;
+			auto it = mEntries.find(streamer);
+
+			if(op.second)
+			{
+				if(it != mEntries.end()) continue;
+				Entry& e(mEntries[streamer]);
+				e.streamer = streamer;
+				e.pending = true; // give the new streamer a first tick ASAP
+			}
+			else if(it != mEntries.end())
+			{
+				unwatch(it->second);
+				mEntries.erase(it);
+			}
+		}
+
+		mOpsApplied = applied;
+	}
+
+	/** The descriptor may change or be closed on reconnection, keep epoll
+	 * registration in sync with what the streamer is currently using */
+	void syncFd(Entry& e)
+	{
+		int fd = e.streamer->reactorFd();
+		if(fd == e.fd) return;
+
+		unwatch(e);
+		if(fd < 0) return;
+
+		epoll_event ev;
+		memset(&ev, 0, sizeof(ev));
+		ev.events = EPOLLIN | EPOLLONESHOT;
+		ev.data.ptr = &e;
+		if(epoll_ctl(mEpollFd, EPOLL_CTL_ADD, fd, &ev) == 0 ||
+		        (errno == EEXIST &&
+		         epoll_ctl(mEpollFd, EPOLL_CTL_MOD, fd, &ev) == 0) )
+		{
+			e.fd = fd;
+			e.armed = true;
+			e.readable = true; // don't miss data arrived before registration
+		}
+		else
+			RsWarn() << __PRETTY_FUNCTION__ << " cannot watch fd: " << fd
+			         << " " << strerror(errno) << std::endl;
+	}
+
+	/// Watch again a socket disarmed by EPOLLONESHOT
+	void arm(Entry& e)
+	{
+		if(e.fd < 0 || e.armed) return;
+
+		epoll_event ev;
+		memset(&ev, 0, sizeof(ev));
+		ev.events = EPOLLIN | EPOLLONESHOT;
+		ev.data.ptr = &e;
+		if(epoll_ctl(mEpollFd, EPOLL_CTL_MOD, e.fd, &ev) == 0) e.armed = true;
+		else
+		{
+			RsWarn() << __PRETTY_FUNCTION__ << " cannot watch fd: " << e.fd
+			         << " " << strerror(errno) << std::endl;
+			e.fd = -1; // syncFd() will try to register it again
+		}
+	}
+
+	void unwatch(Entry& e)
+	{
+		/* Closed descriptors are automatically removed from epoll, so failure
+		 * here is expected and harmless */
+		if(e.fd >= 0) epoll_ctl(mEpollFd, EPOLL_CTL_DEL, e.fd, nullptr);
+		e.fd = -1;
+		e.armed = false;
+	}
+
+	int mEpollFd;
+	int mWakeFd;
+
+	RsMutex mOpsMtx;
+	std::list<std::pair<pqithreadstreamer*, bool>> mOps;
+	uint64_t mOpsQueued;
+	std::atomic<uint64_t> mOpsApplied;
+
+	/// Only accessed by the worker thread, entries addresses must be stable
+	std::map<pqithreadstreamer*, Entry> mEntries;
+
+	std::atomic<bool> mIdle;
+
+	static thread_local Worker* sCurrentWorker;
+};
+
+thread_local pqiNetReactor::Worker* pqiNetReactor::Worker::sCurrentWorker =
+        nullptr;
+
+#else // def __linux__
+
+/* Just enough to compile, the reactor is never instanced on platforms without
+ * epoll @see pqiNetReactor::instance() */
+class pqiNetReactor::Worker: public RsTickingThread
+{
+public:
+	bool isValid() const { return false; }
+	uint64_t queueOp(pqithreadstreamer*, bool) { return 0; }
+	void waitApplied(uint64_t) {}
+	void wakeUpIfIdle() {}
+
+protected:
+	void threadTick() override {}
+};
+
+#endif // def __linux__
+
+/*static*/ void pqiNetReactor::setThreadCount(uint32_t threads)
+{
+	if(threads > PQI_REACTOR_MAX_THREADS)
+	{
+		RsWarn() << __PRETTY_FUNCTION__ << " " << threads << " reactor threads "
+		         << "requested, limiting to " << PQI_REACTOR_MAX_THREADS
+		         << std::endl;
+		threads = PQI_REACTOR_MAX_THREADS;
+	}
+
+	sThreadCount = threads;
+}
+
+/*static*/ bool pqiNetReactor::enabled()
+{
+#ifdef __linux__
+	return sThreadCount > 0;
+#else
+	return false;
+#endif
+}
+
+/*static*/ pqiNetReactor* pqiNetReactor::instance()
+{
+	if(!enabled()) return nullptr;
+
+	pqiNetReactor* reactor = sInstance;
+	if(reactor) return reactor;
+
+	RS_STACK_MUTEX(sInstanceMtx);
+	if(!sInstance) sInstance = new pqiNetReactor(sThreadCount);
+	return sInstance;
+}
+
+/*static*/ void pqiNetReactor::shutdown()
+{
+	RS_STACK_MUTEX(sInstanceMtx);
+	pqiNetReactor* reactor = sInstance.exchange(nullptr);
+
+	/* Streamers may still reference the reactor, so just stop the threads
+	 * without deleting it */
+	if(reactor)
+		for(Worker* w: reactor->mWorkers) w->fullstop();
+
+	sThreadCount = 0;
+}
+
+pqiNetReactor::pqiNetReactor(uint32_t threads) :
+    mReactorMtx("pqiNetReactor")
+{
+	for(uint32_t i = 0; i < threads; ++i)
+	{
+		Worker* w = new Worker();
+		if(!w->isValid())
+		{
+			delete w;
+			continue;
+		}
+
+		w->start("pqi reactor " + std::to_string(i));
+		mWorkers.push_back(w);
+	}
+
+	RsInfo() << __PRETTY_FUNCTION__ << " started " << mWorkers.size()
+	         << " network reactor threads" << std::endl;
+}
+
+pqiNetReactor::~pqiNetReactor()
+{
+	for(Worker* w: mWorkers)
+	{
+		w->fullstop();
+		delete w;
+	}
+}
+
+bool pqiNetReactor::attach(pqithreadstreamer* streamer)
+{
+	RS_STACK_MUTEX(mReactorMtx);
+
+	Worker* worker = nullptr;
+	auto it = mAssigned.find(streamer);
+	if(it != mAssigned.end()) worker = it->second;
+	else
+	{
+		// Pick the least loaded worker
+		std::map<Worker*, size_t> load;
+		for(Worker* w: mWorkers) load[w] = 0;
+		for(auto& a: mAssigned) ++load[a.second];
+
+		size_t minLoad = std::numeric_limits<size_t>::max();
+		for(Worker* w: mWorkers)
+			if(w->isRunning() && load[w] < minLoad)
+			{
+				minLoad = load[w];
+				worker = w;
+			}
+
+		if(!worker) return false;
+		mAssigned[streamer] = worker;
+	}
+
+	if(!worker->isRunning()) return false;
+
+#ifdef DEBUG_PQINETREACTOR
+	RsDbg() << __PRETTY_FUNCTION__ << " streamer: " << streamer
+	        << " worker: " << worker << std::endl;
+#endif
+
+	worker->queueOp(streamer, true);
+	return true;
+}
+
+void pqiNetReactor::detach(pqithreadstreamer* streamer)
+{
+	RS_STACK_MUTEX(mReactorMtx);
+	auto it = mAssigned.find(streamer);
+	if(it != mAssigned.end()) it->second->queueOp(streamer, false);
+}
+
+void pqiNetReactor::detachAndWait(pqithreadstreamer* streamer)
+{
+	Worker* worker = nullptr;
+	uint64_t ticket = 0;
+	{
+		RS_STACK_MUTEX(mReactorMtx);
+		auto it = mAssigned.find(streamer);
+		if(it == mAssigned.end()) return;
+		worker = it->second;
+		ticket = worker->queueOp(streamer, false);
+	}
+
+	worker->waitApplied(ticket);
+}
+
+void pqiNetReactor::forget(pqithreadstreamer* streamer)
+{
+	detachAndWait(streamer);
+
+	RS_STACK_MUTEX(mReactorMtx);
+	mAssigned.erase(streamer);
+}
+
+void pqiNetReactor::notifyOutgoing(pqithreadstreamer* /*streamer*/)
+{
+	/* This is called for every outgoing item so avoid taking mReactorMtx,
+	 * mWorkers doesn't change after construction. Waking up an idle worker
+	 * which doesn't own the streamer costs just one empty round, while busy
+	 * workers are not bothered at all. */
+	for(Worker* w: mWorkers) w->wakeUpIfIdle();
+}
@@ -0,0 +1,116 @@
+/*******************************************************************************
+ * libretroshare/src/pqi: pqinetreactor.h                                      *
+ *                                                                             *
+ * libretroshare: retroshare core library                                      *
+ *                                                                             *
+ * Copyright (C) 2026  RetroShare Team <contact@retroshare.cc>                 *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Lesser General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ *******************************************************************************/
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <map>
+#include <vector>
+
+#include "util/rsthreads.h"
+
+class pqithreadstreamer;
+
+/**
+ * Event driven alternative to the thread-per-peer pqithreadstreamer model.
+ * A small fixed pool of reactor threads owns the sockets of all the connected
+ * peers, sleeps in epoll_wait() and ticks pqistreamer receive and send paths
+ * only when the socket is readable, outgoing data has been queued or some
+ * previous work is still pending. Each streamer is ticked at most once per
+ * @see pqithreadstreamer::reactorTickInterval(), the pace of its own thread,
+ * so bandwidth limits keep working.
+ * Interfaces which are not backed by a kernel file descriptor (like pqissludp
+ * which runs on top of the userspace tcponudp stack) are still supported, they
+ * are polled at the same pace of the threaded streamer.
+ * The reactor is available only on Linux (and Android), on other platforms
+ * pqithreadstreamer keeps using one thread per peer.
+ */
+class pqiNetReactor
+{
+public:
+	/**
+	 * Set the number of reactor threads, must be called before any peer get
+	 * connected, usually at startup @see RsConfigOptions::netReactorThreads
+	 * @param threads number of reactor threads, 0 disable the reactor and keep
+	 *	the thread-per-peer model
+	 */
+	static void setThreadCount(uint32_t threads);
+
+	/** @return true if streamers should be driven by the reactor */
+	static bool enabled();
+
+	/** @return the reactor instance, nullptr if not enabled */
+	static pqiNetReactor* instance();
+
+	/** Stop all reactor threads, called at shutdown */
+	static void shutdown();
+
+	/**
+	 * Start driving the given streamer, the streamer must not be running its
+	 * own thread.
+	 * @return false if the reactor could not take the streamer
+	 */
+	bool attach(pqithreadstreamer* streamer);
+
+	/**
+	 * Asyncronously stop driving the given streamer, the real detach happens
+	 * on the owning reactor thread, like RsThread::askForStop()
+	 */
+	void detach(pqithreadstreamer* streamer);
+
+	/**
+	 * Stop driving the given streamer and wait until the owning reactor thread
+	 * has released it, like RsThread::fullstop(). Must not be called from a
+	 * reactor thread.
+	 */
+	void detachAndWait(pqithreadstreamer* streamer);
+
+	/**
+	 * Detach the given streamer and drop any bookkeeping about it, must be
+	 * called before the streamer is deleted
+	 */
+	void forget(pqithreadstreamer* streamer);
+
+	/**
+	 * Notify that outgoing data has been queued on the given streamer, wake up
+	 * the owning reactor thread if it is sleeping for long
+	 */
+	void notifyOutgoing(pqithreadstreamer* streamer);
+
+private:
+	explicit pqiNetReactor(uint32_t threads);
+	~pqiNetReactor();
+
+	class Worker;
+
+	RsMutex mReactorMtx;
+	std::vector<Worker*> mWorkers;
+
+	/** Streamers stick to the same worker across reconnections so detach and
+	 * attach requests are always processed in order */
+	std::map<const pqithreadstreamer*, Worker*> mAssigned;
+
+	static std::atomic<uint32_t> sThreadCount;
+	static std::atomic<pqiNetReactor*> sInstance;
+	static RsMutex sInstanceMtx;
+};
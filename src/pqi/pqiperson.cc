@@ -344,7 +344,7 @@ int pqiperson::handleNotifyEvent_locked(NetInterface *ni, int newState,
 			inConnectAttempt = false;
 
 			// STARTUP THREAD
-			activepqi->start("pqi " + PeerId().toStdString().substr(0, 11));
+			activepqi->startStreaming("pqi " + PeerId().toStdString().substr(0, 11));
 
 			// reset all other children (clear up long UDP attempt)
 			for(it = kids.begin(); it != kids.end(); ++it)
@@ -366,7 +366,7 @@ int pqiperson::handleNotifyEvent_locked(NetInterface *ni, int newState,
 					  << " CONNECT_FAILED->marking so!" << std::endl;
 #endif
 
-			activepqi->askForStop(); // STOP THREAD.
+			activepqi->stopStreaming(); // STOP THREAD.
 			active = false;
 			activepqi = nullptr;
 		}
@@ -406,7 +406,7 @@ int pqiperson::reset_locked()
 	std::map<uint32_t, pqiconnect *>::iterator it;
 	for(it = kids.begin(); it != kids.end(); ++it)
 	{
-		it->second->askForStop(); // STOP THREAD.
+		it->second->stopStreaming(); // STOP THREAD.
 		(it->second) -> reset();
 	}
 
@@ -428,7 +428,7 @@ int pqiperson::fullstopthreads()
 
 	std::map<uint32_t, pqiconnect *>::iterator it;
 	for(it = kids.begin(); it != kids.end(); ++it)
-		(it->second)->fullstop(); // WAIT FOR THREAD TO STOP.
+		(it->second)->fullstopStreaming(); // WAIT FOR THREAD TO STOP.
 
 	activepqi = NULL;
 	active = false;
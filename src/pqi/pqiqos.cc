@@ -51,11 +51,10 @@ for(int i=((int)nb_levels)-1;i>=0;--i,c *= alpha)
 
 void pqiQoS::clear()
 {
-	void *item ;
+	// Item buffers are released when the last slice referencing them is gone
 
 	for(uint32_t i=0;i<_item_queues.size();++i)
-		while( (item = _item_queues[i].pop()) != NULL)
-			free(item) ;
+		_item_queues[i]._items.clear() ;
 
 	_nb_items = 0 ;
 }
@@ -109,12 +108,12 @@ void pqiQoS::in_rsItem(void *ptr,int size,int priority)
 // }
 
 
-void *pqiQoS::out_rsItem(uint32_t max_slice_size, uint32_t& size, bool& starts, bool& ends, uint32_t& packet_id) 
+bool pqiQoS::out_rsItem(uint32_t max_slice_size, pqiOutSlice& slice, bool& starts, bool& ends, uint32_t& packet_id) 
 {
 	// Go through the queues. Increment counters.
 
 	if(_nb_items == 0)
-		return NULL ;
+		return false ;
 
 	float inc = 1.0f ;
 	int i = _item_queues.size()-1 ;
@@ -139,7 +138,7 @@ void *pqiQoS::out_rsItem(uint32_t max_slice_size, uint32_t& size, bool& starts,
         
         	// now chop a slice of this item
         
-        	void *res = _item_queues[last].slice(max_slice_size,size,starts,ends,packet_id) ;
+        	bool res = _item_queues[last].slice(max_slice_size,slice,starts,ends,packet_id) ;
             
             	if(ends)
 			--_nb_items ;
@@ -147,7 +146,7 @@ void *pqiQoS::out_rsItem(uint32_t max_slice_size, uint32_t& size, bool& starts,
 		return res ;
 	}
 	else
-		return NULL ;
+		return false ;
 }
 
 
@@ -37,17 +37,40 @@
 #include <iostream>
 #include <vector>
 #include <list>
+#include <memory>
 
 #include <util/rsmemory.h>
 
+// View over a slice of a serialized item waiting in an output queue. The item
+// buffer is reference counted, so that the slice stays valid until it has been
+// written, even if the queue has dropped the item in the meanwhile. This allows
+// slicing large items without copying them.
+//
+struct pqiOutSlice
+{
+	pqiOutSlice() : offset(0), size(0) {}
+
+	const uint8_t *data() const { return buffer.get() + offset ; }
+
+	std::shared_ptr<uint8_t> buffer ;
+	uint32_t offset ;
+	uint32_t size ;
+};
+
 class pqiQoS
 {
 public:
 	pqiQoS(uint32_t max_levels,float alpha) ;
 
+	// Takes ownership of a serialized item allocated with malloc()
+	static std::shared_ptr<uint8_t> makeSharedItem(void *item)
+	{
+		return std::shared_ptr<uint8_t>(static_cast<uint8_t*>(item),free) ;
+	}
+
 	struct ItemRecord
 	{
-		void *data ;
+		std::shared_ptr<uint8_t> data ;
 		uint32_t current_offset ;
 		uint32_t size ;
 		uint32_t id ;
@@ -61,21 +84,24 @@ public:
 		  , _counter(0.0)
 		  , _inc(0.0)
 		{}
-		void *pop() 
+		bool pop(pqiOutSlice& slice) 
 		{
 			if(_items.empty())
-				return NULL ;
+				return false ;
 
-			void *item = _items.front().data ;
+			ItemRecord& rec(_items.front()) ;
+			slice.buffer.swap(rec.data) ;
+			slice.offset = rec.current_offset ;
+			slice.size = rec.size - rec.current_offset ;
 			_items.pop_front() ;
 
-			return item ;
+			return true ;
 		}
 
-		void *slice(uint32_t max_size,uint32_t& size,bool& starts,bool& ends,uint32_t& packet_id) 
+		bool slice(uint32_t max_size,pqiOutSlice& slice,bool& starts,bool& ends,uint32_t& packet_id) 
 		{
 			if(_items.empty())
-				return NULL ;
+				return false ;
 
 			ItemRecord& rec(_items.front()) ;
 			packet_id = rec.id ;
@@ -86,9 +112,8 @@ public:
 			{
 				starts = true ;
 				ends = true ;
-				size = rec.size ;
 
-				return pop() ;
+				return pop(slice) ;
 			}
 			starts = (rec.current_offset == 0) ;
 			ends   = (rec.current_offset + max_size >= rec.size) ;
@@ -96,38 +121,29 @@ public:
 			if(rec.size <= rec.current_offset)
 			{
 				std::cerr << "(EE) severe error in slicing in QoS." << std::endl;
-				pop() ;
-				return NULL ;
+				_items.pop_front() ;
+				return false ;
 			}
 
-			size = std::min(max_size, uint32_t((int)rec.size - (int)rec.current_offset)) ;
-			void *mem = rs_malloc(size) ;
+			// No copy here: the slice shares the item buffer
 
-			if(!mem)
-			{
-				std::cerr << "(EE) memory allocation error in QoS." << std::endl;
-				pop() ;
-				return NULL ;
-			}
-
-			memcpy(mem,&((unsigned char*)rec.data)[rec.current_offset],size) ;
+			slice.buffer = rec.data ;
+			slice.offset = rec.current_offset ;
+			slice.size = std::min(max_size, rec.size - rec.current_offset) ;
 
 			if(ends)	// we're taking the whole stuff. So we can delete the entry.
-			{
-				free(rec.data) ;
 				_items.pop_front() ;
-			}
 			else
-				rec.current_offset += size ;	// by construction, !ends  implies  rec.current_offset < rec.size
+				rec.current_offset += slice.size ;	// by construction, !ends  implies  rec.current_offset < rec.size
 
-			return mem ;
+			return true ;
 		}
 
 		void push(void *item,uint32_t size,uint32_t id) 
 		{
 			ItemRecord rec ;
 
-			rec.data = item ;
+			rec.data = makeSharedItem(item) ;
 			rec.current_offset = 0 ;
 			rec.size = size ;
 			rec.id = id ;
@@ -144,11 +160,13 @@ public:
 		std::list<ItemRecord> _items ;
 	};
 
-	// This function pops items from the queue, y order of priority
+	// This function pops items from the queue, y order of priority. The returned slice
+	// points into the queued item buffer, no copy is made.
 	//
-	void *out_rsItem(uint32_t max_slice_size,uint32_t& size,bool& starts,bool& ends,uint32_t& packet_id) ;
+	bool out_rsItem(uint32_t max_slice_size,pqiOutSlice& slice,bool& starts,bool& ends,uint32_t& packet_id) ;
 
-	// This function is used to queue items.
+	// This function is used to queue items. The queue takes ownership of the
+	// malloc()ed item.
 	//
 	void in_rsItem(void *item, int size, int priority) ;
 
@@ -68,13 +68,13 @@ void pqiQoSstreamer::locked_clear_out_queue()
 	_total_item_count = 0 ;
 }
 
-void *pqiQoSstreamer::locked_pop_out_data(uint32_t max_slice_size, uint32_t& size, bool& starts, bool& ends, uint32_t& packet_id)
+bool pqiQoSstreamer::locked_pop_out_data(uint32_t max_slice_size, pqiOutSlice& slice, bool& starts, bool& ends, uint32_t& packet_id)
 {
-	void *out = pqiQoS::out_rsItem(max_slice_size,size,starts,ends,packet_id) ;
+	bool out = pqiQoS::out_rsItem(max_slice_size,slice,starts,ends,packet_id) ;
 
-	if(out != NULL) 
+	if(out) 
 	{
-		_total_item_size -= size ;
+		_total_item_size -= slice.size ;
         
         	if(ends)
 			--_total_item_count ;
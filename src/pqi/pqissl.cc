@@ -1789,6 +1789,12 @@ bool 	pqissl::moretoread(uint32_t usec)
 
 }
 
+int 	pqissl::pollableFd()
+{
+	RsStackMutex stack(mSslMtx); /**** LOCKED MUTEX ****/
+	return active ? sockfd : -1;
+}
+
 bool 	pqissl::cansend(uint32_t usec)
 {
 	RsStackMutex stack(mSslMtx); /**** LOCKED MUTEX ****/
@@ -170,6 +170,7 @@ virtual int netstatus();
 virtual int isactive();
 virtual bool moretoread(uint32_t usec);
 virtual bool cansend(uint32_t usec);
+virtual int pollableFd();
 
 virtual int close(); /* BinInterface version of reset() */
 virtual RsFileHash gethash(); /* not used here */
@@ -53,6 +53,8 @@ public:
 	// These are reimplemented.	
 	virtual bool moretoread(uint32_t usec);
 	virtual bool cansend(uint32_t usec);
+	/* tou sockets live in userspace, they cannot be watched by epoll */
+	virtual int pollableFd() { return -1; }
 	/* UDP always through firewalls -> always bandwidth Limited */
 	virtual bool bandwidthLimited() { return true; }
 
@@ -51,6 +51,7 @@ static const float PQISTREAM_AVG_FRAC   			= 0.8; 		// for bandpass filter over
 static const float PQISTREAM_AVG_DT_FRAC                        = 0.99;         // for low pass filter over elapsed time
 
 static const int   PQISTREAM_OPTIMAL_PACKET_SIZE  		= 512;		// It is believed that this value should be lower than TCP slices and large enough as compare to encryption padding.
+static const uint32_t PQISTREAM_MAX_KEPT_WBUFFER_SIZE 		= 64*1024;	// packing buffer larger than this is released after use
 										// most importantly, it should be constant, so as to allow correct QoS.
 static const int   PQISTREAM_SLICE_FLAG_STARTS			= 0x01;		// 
 static const int   PQISTREAM_SLICE_FLAG_ENDS 			= 0x02;		// these flags should be kept in the range 0x01-0x08
@@ -337,6 +338,12 @@ int 	pqistreamer::tick_send(uint32_t timeout)
 	return 1;
 }
 
+bool	pqistreamer::hasPendingOutgoing()
+{
+	RsStackMutex stack(mStreamerMtx); /**** LOCKED MUTEX ****/
+	return mPkt_wpending != NULL || locked_out_queue_size() > 0;
+}
+
 int	pqistreamer::status()
 {
 	RsStackMutex stack(mStreamerMtx); /**** LOCKED MUTEX ****/
@@ -530,12 +537,7 @@ int	pqistreamer::handleoutgoing_locked()
         	mAcceptsPacketSlicing = false ;
 
 	    /* also remove the pending packets */
-	    if (mPkt_wpending)
-	    {
-		    free(mPkt_wpending);
-		    mPkt_wpending = NULL;
-		    	mPkt_wpending_size = 0 ;
-	    }
+	    free_wpending();
 
 	    return 0;
     }
@@ -564,8 +566,7 @@ int	pqistreamer::handleoutgoing_locked()
         
 	    if (!mPkt_wpending)
 	{
-		void *dta;
-		mPkt_wpending_size = 0 ;
+		mPkt_wbuffer.clear() ;
 		int k=0;
 
         	// Checks for inserting a packet slicing probe. We do that to send the other peer the information that packet slicing can be used.
@@ -578,14 +579,12 @@ int	pqistreamer::handleoutgoing_locked()
                 	std::cerr << "(II) Inserting packet slicing probe in traffic" << std::endl;
 #endif
                     
-                    	mPkt_wpending_size = 8 ;
-                    	mPkt_wpending = rs_malloc(8) ;
-                        memcpy(mPkt_wpending,PACKET_SLICING_PROBE_BYTES,8) ;
+                        mPkt_wbuffer.insert(mPkt_wbuffer.end(),PACKET_SLICING_PROBE_BYTES,PACKET_SLICING_PROBE_BYTES+8) ;
                         
                 	mLastSentPacketSlicingProbe = now ;
         	}
             
-        	uint32_t slice_size=0;
+		pqiOutSlice slice ;
 		bool slice_starts=true ;
 		bool slice_ends=true ;
 		uint32_t slice_packet_id=0 ;
@@ -594,59 +593,73 @@ int	pqistreamer::handleoutgoing_locked()
 		{
             		int desired_packet_size = mAcceptsPacketSlicing?PQISTREAM_OPTIMAL_PACKET_SIZE:(getRsPktMaxSize());
                     
-			dta = locked_pop_out_data(desired_packet_size,slice_size,slice_starts,slice_ends,slice_packet_id) ;
-
-			if(!dta)
+			if(!locked_pop_out_data(desired_packet_size,slice,slice_starts,slice_ends,slice_packet_id))
 				break ;
 
 			if(slice_starts && slice_ends)	// good old method. Send the packet as is, since it's a full packet.
 			{
 #ifdef DEBUG_PACKET_SLICING
-				std::cerr << "sending full slice, old style. Size=" << slice_size << std::endl;
+				std::cerr << "sending full slice, old style. Size=" << slice.size << std::endl;
 #endif
-				mPkt_wpending = realloc(mPkt_wpending,slice_size+mPkt_wpending_size) ;
-				memcpy( &((char*)mPkt_wpending)[mPkt_wpending_size],dta,slice_size) ;
-				free(dta);
-				mPkt_wpending_size += slice_size ;
+				// A large item alone does not need packing: it is written straight from the
+				// queued item buffer, which is kept alive until it has been sent.
+
+				if(mPkt_wbuffer.empty() && slice.size >= (uint32_t)PQISTREAM_OPTIMAL_PACKET_SIZE)
+				{
+					mPkt_wdirect = slice ;
+					++k ;
+					break ;
+				}
+				mPkt_wbuffer.insert(mPkt_wbuffer.end(),slice.data(),slice.data()+slice.size) ;
 				++k ;
 			}
 			else	// partial packet. We make a special header for it and insert it in the stream
 			{
-				if(slice_size > 0xffff || !mAcceptsPacketSlicing)
+				if(slice.size > 0xffff || !mAcceptsPacketSlicing)
 				{
 					std::cerr << "(EE) protocol error in pqitreamer: slice size is too large and cannot be encoded." ;
-					free(mPkt_wpending) ;
-					mPkt_wpending_size = 0;
+					free_wpending() ;
 					return -1 ;
 				}
 #ifdef DEBUG_PACKET_SLICING
-				std::cerr << "sending partial slice, packet ID=" << std::hex << slice_packet_id << std::dec << ", size=" << slice_size << std::endl;
+				std::cerr << "sending partial slice, packet ID=" << std::hex << slice_packet_id << std::dec << ", size=" << slice.size << std::endl;
 #endif
 
-				mPkt_wpending = realloc(mPkt_wpending,slice_size+mPkt_wpending_size+PQISTREAM_PARTIAL_PACKET_HEADER_SIZE) ;
-				memcpy( &((char*)mPkt_wpending)[mPkt_wpending_size+PQISTREAM_PARTIAL_PACKET_HEADER_SIZE],dta,slice_size) ;
-				free(dta);
-
 				// New2: pp ff xxxxxxxx ssss  [data, sss bytes] => [flags 1B] [protocol version 1B] [2^32 packet count] [2^16 size]
 
 				uint8_t partial_flags = 0 ;
 				if(slice_starts) partial_flags |= PQISTREAM_SLICE_FLAG_STARTS  ;
 				if(slice_ends  ) partial_flags |= PQISTREAM_SLICE_FLAG_ENDS  ;
 
-				((char*)mPkt_wpending)[mPkt_wpending_size+0x00] = PQISTREAM_SLICE_PROTOCOL_VERSION_ID_01 ;
-				((char*)mPkt_wpending)[mPkt_wpending_size+0x01] = partial_flags ;
-				((char*)mPkt_wpending)[mPkt_wpending_size+0x02] = uint8_t(slice_packet_id >> 24) & 0xff ;
-				((char*)mPkt_wpending)[mPkt_wpending_size+0x03] = uint8_t(slice_packet_id >> 16) & 0xff ;
-				((char*)mPkt_wpending)[mPkt_wpending_size+0x04] = uint8_t(slice_packet_id >>  8) & 0xff ;
-				((char*)mPkt_wpending)[mPkt_wpending_size+0x05] = uint8_t(slice_packet_id >>  0) & 0xff ;	
-				((char*)mPkt_wpending)[mPkt_wpending_size+0x06] = uint8_t(slice_size      >>  8) & 0xff ;
-				((char*)mPkt_wpending)[mPkt_wpending_size+0x07] = uint8_t(slice_size      >>  0) & 0xff ;
+				uint8_t header[PQISTREAM_PARTIAL_PACKET_HEADER_SIZE] ;
+
+				header[0x00] = PQISTREAM_SLICE_PROTOCOL_VERSION_ID_01 ;
+				header[0x01] = partial_flags ;
+				header[0x02] = uint8_t(slice_packet_id >> 24) & 0xff ;
+				header[0x03] = uint8_t(slice_packet_id >> 16) & 0xff ;
+				header[0x04] = uint8_t(slice_packet_id >>  8) & 0xff ;
+				header[0x05] = uint8_t(slice_packet_id >>  0) & 0xff ;	
+				header[0x06] = uint8_t(slice.size      >>  8) & 0xff ;
+				header[0x07] = uint8_t(slice.size      >>  0) & 0xff ;
 
-				mPkt_wpending_size += slice_size + PQISTREAM_PARTIAL_PACKET_HEADER_SIZE;
+				mPkt_wbuffer.insert(mPkt_wbuffer.end(),header,header+PQISTREAM_PARTIAL_PACKET_HEADER_SIZE) ;
+				mPkt_wbuffer.insert(mPkt_wbuffer.end(),slice.data(),slice.data()+slice.size) ;
 				++k ;
 			}
+			slice = pqiOutSlice() ;	// release our reference on the item buffer
 		} 
-                 while(mPkt_wpending_size < (uint32_t)maxbytes && mPkt_wpending_size < PQISTREAM_OPTIMAL_PACKET_SIZE && !DISABLE_PACKET_GROUPING) ;
+                 while(mPkt_wbuffer.size() < (uint32_t)maxbytes && mPkt_wbuffer.size() < PQISTREAM_OPTIMAL_PACKET_SIZE && !DISABLE_PACKET_GROUPING) ;
+
+		if(mPkt_wdirect.buffer)
+		{
+			mPkt_wpending = mPkt_wdirect.data() ;
+			mPkt_wpending_size = mPkt_wdirect.size ;
+		}
+		else if(!mPkt_wbuffer.empty())
+		{
+			mPkt_wpending = mPkt_wbuffer.data() ;
+			mPkt_wpending_size = mPkt_wbuffer.size() ;
+		}
              
 #ifdef DEBUG_PQISTREAMER
 		if(k > 1)
@@ -662,7 +675,7 @@ int	pqistreamer::handleoutgoing_locked()
 #endif
             		int ss=0;
 
-		    if (mPkt_wpending_size != (uint32_t)(ss = mBio->senddata(mPkt_wpending, mPkt_wpending_size)))
+		    if (mPkt_wpending_size != (uint32_t)(ss = mBio->senddata(const_cast<uint8_t*>(mPkt_wpending), mPkt_wpending_size)))
 		    {
 #ifdef DEBUG_PQISTREAMER
 			    std::string out;
@@ -692,9 +705,7 @@ int	pqistreamer::handleoutgoing_locked()
 
 		    sentbytes += mPkt_wpending_size;
             
-		    free(mPkt_wpending);
-		    mPkt_wpending = NULL;
-		    mPkt_wpending_size = 0 ;
+		    free_wpending();
 
             sent = true;
 	    }
@@ -1308,15 +1319,11 @@ void pqistreamer::free_pend()
 	}
 	mPkt_rpend_size = 0;
 
-	if (mPkt_wpending)
-	{
 #ifdef DEBUG_PQISTREAMER
+	if (mPkt_wpending)
         		std::cerr << "pqistreamer::free_pend(): pending output packet buffer" << std::endl;
 #endif
-		free(mPkt_wpending);
-		mPkt_wpending = NULL;
-	}
-	mPkt_wpending_size = 0 ;
+	free_wpending();
 
 #ifdef DEBUG_PQISTREAMER
     if(!mPartialPackets.empty())
@@ -1332,6 +1339,20 @@ void pqistreamer::free_pend()
 	locked_clear_out_queue() ;
 }
 
+void pqistreamer::free_wpending()
+{
+	mPkt_wpending = NULL;
+	mPkt_wpending_size = 0 ;
+
+	// keep the packing buffer allocated, unless a burst made it grow too much
+
+	mPkt_wbuffer.clear() ;
+	if(mPkt_wbuffer.capacity() > PQISTREAM_MAX_KEPT_WBUFFER_SIZE)
+		std::vector<uint8_t>().swap(mPkt_wbuffer) ;
+
+	mPkt_wdirect = pqiOutSlice() ;
+}
+
 int     pqistreamer::gatherStatistics(std::list<RSTrafficClue>& outqueue_lst,std::list<RSTrafficClue>& inqueue_lst)
 {
     RsStackMutex stack(mStreamerMtx); /**** LOCKED MUTEX ****/
@@ -1423,28 +1444,27 @@ int pqistreamer::locked_gatherStatistics(std::list<RSTrafficClue>& out_lst,std::
 }
 
 // this method is overloaded by pqiqosstreamer
-void *pqistreamer::locked_pop_out_data(uint32_t /*max_slice_size*/, uint32_t &size, bool &starts, bool &ends, uint32_t &packet_id)
+bool pqistreamer::locked_pop_out_data(uint32_t /*max_slice_size*/, pqiOutSlice& slice, bool &starts, bool &ends, uint32_t &packet_id)
 {
-    size = 0 ;
     starts = true ;
     ends = true ;
     packet_id = 0 ;
     
-	void *res = NULL ;
+	if (mOutPkts.empty())
+		return false ;
 
-	if (!mOutPkts.empty())
-	{
-		res = *(mOutPkts.begin()); 
-		mOutPkts.pop_front();
+	void *res = *(mOutPkts.begin()); 
+	mOutPkts.pop_front();
 
-        // In pqistreamer, we do not split outgoing packets. For now only pqiQoSStreamer supports packet slicing.
-        size = getRsItemSize(res);
+	// In pqistreamer, we do not split outgoing packets. For now only pqiQoSStreamer supports packet slicing.
+	slice.buffer = pqiQoS::makeSharedItem(res) ;
+	slice.offset = 0 ;
+	slice.size = getRsItemSize(res);
 
 #ifdef DEBUG_TRANSFERS
-        std::cerr << "pqistreamer::locked_pop_out_data() getting next pkt " << std::hex << res << std::dec << " from mOutPkts queue";
-		std::cerr << std::endl;
+	std::cerr << "pqistreamer::locked_pop_out_data() getting next pkt " << std::hex << res << std::dec << " from mOutPkts queue";
+	std::cerr << std::endl;
 #endif
-	}
-	return res ;
+	return true ;
 }
 
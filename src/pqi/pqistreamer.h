@@ -27,8 +27,10 @@
 #include <iostream>               // for operator<<, basic_ostream, cerr, endl
 #include <list>                   // for list
 #include <map>                    // for map
+#include <vector>                 // for vector
 
 #include "pqi/pqi_base.h"         // for BinInterface (ptr only), PQInterface
+#include "pqi/pqiqos.h"           // for pqiOutSlice
 #include "retroshare/rsconfig.h"  // for RSTrafficClue
 #include "retroshare/rstypes.h"   // for RsPeerId
 #include "util/rsthreads.h"       // for RsMutex
@@ -87,6 +89,9 @@ class pqistreamer: public PQInterface
 		int tick_send(uint32_t timeout);
 		int tick_recv(uint32_t timeout);
 
+		/// @return true if there is outgoing data waiting to be sent
+		bool hasPendingOutgoing();
+
 		/* Implementation */
 
 		// These methods are redefined in pqiQoSstreamer
@@ -95,7 +100,7 @@ class pqistreamer: public PQInterface
 		virtual int locked_out_queue_size() const ;
 		virtual void locked_clear_out_queue() ;
 		virtual int locked_compute_out_pkt_size() const ;
-		virtual void *locked_pop_out_data(uint32_t max_slice_size,uint32_t& size,bool& starts,bool& ends,uint32_t& packet_id);
+		virtual bool locked_pop_out_data(uint32_t max_slice_size,pqiOutSlice& slice,bool& starts,bool& ends,uint32_t& packet_id);
 		virtual int   locked_gatherStatistics(std::list<RSTrafficClue>& outqueue_stats,std::list<RSTrafficClue>& inqueue_stats); // extracting data.
 
         	void updateRates() ;
@@ -127,12 +132,15 @@ class pqistreamer: public PQInterface
 
         		// cleans up everything that's pending / half finished.
 		void free_pend();
+		void free_wpending();
 
 		// RsSerialiser - determines which packets can be serialised.
 		RsSerialiser *mRsSerialiser;
 
-		void *mPkt_wpending; // storage for pending packet to write.
+		const uint8_t *mPkt_wpending; // pending packet to write, points either to mPkt_wbuffer or mPkt_wdirect.
         	uint32_t mPkt_wpending_size; // ... and its size.
+		std::vector<uint8_t> mPkt_wbuffer; // packing buffer for small items and slices, reused across packets.
+		pqiOutSlice mPkt_wdirect; // large item sent as is, without copying it to mPkt_wbuffer.
 
 		void allocate_rpend(); // use these two functions to allocate/free the buffer below
         
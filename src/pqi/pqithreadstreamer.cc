@@ -21,7 +21,9 @@
  *******************************************************************************/
 #include "util/rstime.h"
 #include "pqi/pqithreadstreamer.h"
+#include "pqi/pqinetreactor.h"
 #include <unistd.h>
+#include <algorithm>
 
 #define DEFAULT_STREAMER_TIMEOUT	  10000 // 10 ms
 #define DEFAULT_STREAMER_SLEEP		  30000 // 30 ms
@@ -30,17 +32,125 @@
 // #define PQISTREAMER_DEBUG
 
 pqithreadstreamer::pqithreadstreamer(PQInterface *parent, RsSerialiser *rss, const RsPeerId& id, BinInterface *bio_in, int bio_flags_in)
-:pqistreamer(rss, id, bio_in, bio_flags_in), mParent(parent), mTimeout(0), mThreadMutex("pqithreadstreamer")
+:pqistreamer(rss, id, bio_in, bio_flags_in), mParent(parent), mTimeout(0), mThreadMutex("pqithreadstreamer"),
+  mReactorDriven(false), mRecvPending(false)
 {
 	mTimeout = DEFAULT_STREAMER_TIMEOUT;
 	mSleepPeriod = DEFAULT_STREAMER_SLEEP;
 }
 
+pqithreadstreamer::~pqithreadstreamer()
+{
+	// Make sure no reactor thread is still holding a pointer to us
+	if(pqiNetReactor* reactor = pqiNetReactor::instance())
+		reactor->forget(this);
+}
+
 bool pqithreadstreamer::RecvItem(RsItem *item)
 {
 	return mParent->RecvItem(item);
 }
 
+int pqithreadstreamer::SendItem(RsItem *item, uint32_t& serialized_size)
+{
+	int ret = pqistreamer::SendItem(item, serialized_size);
+
+	if(mReactorDriven)
+		if(pqiNetReactor* reactor = pqiNetReactor::instance())
+			reactor->notifyOutgoing(this);
+
+	return ret;
+}
+
+void pqithreadstreamer::startStreaming(const std::string& name)
+{
+	pqiNetReactor* reactor = pqiNetReactor::instance();
+	if(reactor)
+	{
+		mReactorDriven = true;
+		if(reactor->attach(this)) return;
+		mReactorDriven = false;
+	}
+
+	start(name);
+}
+
+void pqithreadstreamer::stopStreaming()
+{
+	if(mReactorDriven.exchange(false))
+	{
+		if(pqiNetReactor* reactor = pqiNetReactor::instance())
+			reactor->detach(this);
+		return;
+	}
+
+	askForStop();
+}
+
+void pqithreadstreamer::fullstopStreaming()
+{
+	pqiNetReactor* reactor = pqiNetReactor::instance();
+	if(reactor)
+	{
+		/* Wait also if we have been asked to stop already but the reactor
+		 * thread may still be ticking us */
+		mReactorDriven = false;
+		reactor->detachAndWait(this);
+	}
+
+	fullstop();
+}
+
+bool pqithreadstreamer::reactorTick(bool readable, bool pollable)
+{
+	bool isactive = false;
+	{
+		RsStackMutex stack(mStreamerMtx);
+		isactive = mBio->isactive();
+	}
+
+	// update the connection rates
+	updateRates() ;
+
+	// nothing to do until the connection is up again
+	if (!isactive)
+	{
+		mRecvPending = false;
+		return false;
+	}
+
+	/* Sockets which cannot be watched by the reactor are polled at each round,
+	 * after a readiness notification do one more round as SSL may have
+	 * buffered more records than what we have been allowed to read */
+	if (readable || mRecvPending || !pollable)
+	{
+		RsStackMutex stack(mThreadMutex);
+		tick_recv(0);
+	}
+	mRecvPending = readable;
+
+	// move items to appropriate service queue or shortcut  to fast service
+	RsItem *incoming = NULL;
+	while((incoming = GetItem()))
+	{
+		RecvItem(incoming);
+	}
+
+	if (hasPendingOutgoing())
+	{
+		RsStackMutex stack(mThreadMutex);
+		tick_send(0);
+	}
+
+	return mRecvPending || !pollable || hasPendingOutgoing();
+}
+
+std::chrono::microseconds pqithreadstreamer::reactorTickInterval()
+{
+	RsStackMutex stack(mStreamerMtx);
+	return std::chrono::microseconds(std::max(mSleepPeriod, mTimeout));
+}
+
 int	pqithreadstreamer::tick()
 {
 	// pqithreadstreamer mutex lock is not needed here
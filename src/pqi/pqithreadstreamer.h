@@ -22,6 +22,9 @@
 #ifndef MRK_PQI_THREAD_STREAMER_HEADER
 #define MRK_PQI_THREAD_STREAMER_HEADER
 
+#include <atomic>
+#include <chrono>
+
 #include "pqi/pqistreamer.h"
 #include "util/rsthreads.h"
 
@@ -29,11 +32,42 @@ class pqithreadstreamer: public pqistreamer, public RsTickingThread
 {
 public:
     pqithreadstreamer(PQInterface *parent, RsSerialiser *rss, const RsPeerId& peerid, BinInterface *bio_in, int bio_flagsin);
+    virtual ~pqithreadstreamer();
 
     // from pqistreamer
     virtual bool RecvItem(RsItem *item) override;
+    using pqistreamer::SendItem;
+    virtual int  SendItem(RsItem *item, uint32_t& serialized_size) override;
     virtual int  tick() override;
 
+    /**
+     * Start streaming, either on a dedicated thread or on a pqiNetReactor
+     * thread if the reactor has been enabled at startup.
+     * @param name thread name used in thread-per-peer mode
+     */
+    void startStreaming(const std::string& name);
+
+    /// Asyncronously stop streaming, @see RsThread::askForStop()
+    void stopStreaming();
+
+    /// Stop streaming and wait it is really stopped, @see RsThread::fullstop()
+    void fullstopStreaming();
+
+    /**
+     * Perform one round of receiving and sending on behalf of pqiNetReactor
+     * @param readable true if the reactor detected the socket is readable
+     * @param pollable true if the reactor is watching the socket readiness
+     * @return true if more work is pending and the streamer should be ticked
+     *	again soon, false if it can wait for the next socket event
+     */
+    bool reactorTick(bool readable, bool pollable);
+
+    /// @return file descriptor the reactor should watch, -1 if none
+    int reactorFd() { return mBio->pollableFd(); }
+
+    /// Minimum delay between two reactorTick(), the pace of the own thread
+    std::chrono::microseconds reactorTickInterval();
+
 protected:
 	void threadTick() override; /// @see RsTickingThread
 
@@ -44,6 +78,12 @@ protected:
 private:
     /* thread variables */
     RsMutex mThreadMutex;
+
+    /// True when driven by pqiNetReactor instead of own thread
+    std::atomic<bool> mReactorDriven;
+
+    /// Data may still be buffered in SSL after last readiness notification
+    bool mRecvPending;
 };
 
 #endif //MRK_PQI_THREAD_STREAMER_HEADER
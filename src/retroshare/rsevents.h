@@ -27,6 +27,8 @@
 #include <cstdint>
 #include <chrono>
 #include <functional>
+#include <string>
+#include <vector>
 
 #include "util/rsmemory.h"
 #include "util/rsurl.h"
@@ -199,16 +201,71 @@ public:
 		mTimePoint = std::chrono::system_clock::from_time_t(mTime);
 	}
 
+	/**
+	 * Events posted with @see RsEvents::postEvent which have the same type
+	 * and the same non empty coalescing key are merged while they wait to be
+	 * handled, only the last one is passed to the handlers. Derived types can
+	 * return a key made of all their fields, so that only events which would
+	 * be handled the same way are merged.
+	 * @return coalescing key, empty if the event must never be merged
+	 */
+	virtual std::string coalescingKey() const { return std::string(); }
+
 	~RsEvent() override;
 };
 
 typedef uint32_t RsEventsHandlerId_t;
 
+/** @see RsEvents::getEventsHandlersStatistics */
+struct RsEventsHandlerStatistic : RsSerializable
+{
+	RsEventsHandlerStatistic() :
+	    mHandlerId(0), mEventType(RsEventType::__NONE), mQueueDepth(0),
+	    mMaxQueueDepth(0), mHandledEvents(0), mCoalescedEvents(0),
+	    mDroppedEvents(0), mTotalLatencyUs(0), mMaxLatencyUs(0),
+	    mTotalRunTimeUs(0), mMaxRunTimeUs(0) {}
+
+	RsEventsHandlerId_t mHandlerId;
+	RsEventType mEventType;      /// __NONE for handlers of every event
+	uint32_t mQueueDepth;        /// events waiting to be handled
+	uint32_t mMaxQueueDepth;     /// most events which waited at once
+	uint64_t mHandledEvents;
+	uint64_t mCoalescedEvents;   /// merged with an event already waiting
+	uint64_t mDroppedEvents;     /// dropped because the queue was full
+	uint64_t mTotalLatencyUs;    /// time spent waiting in the queue
+	uint64_t mMaxLatencyUs;
+	uint64_t mTotalRunTimeUs;    /// time spent in the handler
+	uint64_t mMaxRunTimeUs;
+
+	/// @see RsSerializable
+	void serial_process( RsGenericSerializer::SerializeJob j,
+	                     RsGenericSerializer::SerializeContext& ctx ) override
+	{
+		RS_SERIAL_PROCESS(mHandlerId);
+		RS_SERIAL_PROCESS(mEventType);
+		RS_SERIAL_PROCESS(mQueueDepth);
+		RS_SERIAL_PROCESS(mMaxQueueDepth);
+		RS_SERIAL_PROCESS(mHandledEvents);
+		RS_SERIAL_PROCESS(mCoalescedEvents);
+		RS_SERIAL_PROCESS(mDroppedEvents);
+		RS_SERIAL_PROCESS(mTotalLatencyUs);
+		RS_SERIAL_PROCESS(mMaxLatencyUs);
+		RS_SERIAL_PROCESS(mTotalRunTimeUs);
+		RS_SERIAL_PROCESS(mMaxRunTimeUs);
+	}
+
+	~RsEventsHandlerStatistic() override;
+};
+
 class RsEvents
 {
 public:
 	/**
 	 * @brief Post event to the event queue.
+	 * Each handler has its own queue, handled in order on a pool of threads,
+	 * so a slow handler does not delay the others. Events waiting in the
+	 * queue of a handler may be merged with later ones
+	 * @see RsEvent::coalescingKey
 	 * @param[in] event
 	 * @return Success or error details.
 	 */
@@ -234,8 +291,10 @@ public:
 	 * @brief Register events handler
 	 * Every time an event is dispatced the registered events handlers will get
 	 * their method handleEvent called with the event passed as paramether.
-	 * @attention Callbacks must not fiddle internally with methods of this
-	 * class otherwise a deadlock will happen.
+	 * A callback is never called concurrently with itself, but different
+	 * callbacks may be called at the same time on different threads.
+	 * @attention Callbacks should use postEvent instead of sendEvent, two
+	 * callbacks sending events to each other would deadlock.
 	 * @jsonapi{development,manualwrapper}
 	 * @param multiCallback     Function that will be called each time an event
 	 *                          is dispatched.
@@ -256,11 +315,22 @@ public:
 
 	/**
 	 * @brief Unregister event handler
+	 * Once this returns the handler is not called anymore, if it was being
+	 * called on another thread this waits for the call to be over.
 	 * @param[in] hId Id of the event handler to unregister
 	 * @return Success or error details.
 	 */
 	virtual std::error_condition unregisterEventsHandler(
 	        RsEventsHandlerId_t hId ) = 0;
 
+	/**
+	 * @brief Get queue depth and latency statistics of the events handlers
+	 * @jsonapi{development}
+	 * @param[out] stats storage for the statistics, one per handler
+	 * @return Success or error details.
+	 */
+	virtual std::error_condition getEventsHandlersStatistics(
+	        std::vector<RsEventsHandlerStatistic>& stats ) = 0;
+
 	virtual ~RsEvents();
 };
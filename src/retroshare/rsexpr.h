@@ -129,6 +129,14 @@ public:
 
     virtual void linearize(LinearizedExpression& e) const = 0 ;
 	virtual std::string toStdString() const = 0 ;
+
+	/*!
+	 * \brief nameTerms
+	 * 		Lists strings such that every file matching the expression has at least one of them in its name, case
+	 * 		ignored. File lists use it to pick candidates from their name index before calling eval().
+	 * \return false if the expression gives no such guarantee, in which case all files need to be evaluated.
+	 */
+	virtual bool nameTerms(std::list<std::string>& /*terms*/) const { return false; }
 };
 
 class CompoundExpression : public Expression 
@@ -170,6 +178,7 @@ public:
 	}
 
     virtual void linearize(LinearizedExpression& e) const ;
+	virtual bool nameTerms(std::list<std::string>& terms) const ;
 private:
     Expression *Lexp;
     Expression *Rexp;
@@ -187,6 +196,9 @@ public:
 protected:
     bool evalStr(const std::string &str);
 
+	// Strings one of which is contained in any string accepted by evalStr().
+	bool containedTerms(std::list<std::string>& res) const;
+
     enum StringOperator Op;
     std::list<std::string> terms;
     bool IgnoreCase;
@@ -278,6 +290,7 @@ public:
     bool eval(const ExpFileEntry& file);
 
 	virtual std::string toStdString() const { return StringExpression::toStdStringWithParam("NAME"); }
+	virtual bool nameTerms(std::list<std::string>& t) const { return containedTerms(t); }
 
     virtual void linearize(LinearizedExpression& e) const
     {
@@ -308,6 +321,7 @@ public:
     bool eval(const ExpFileEntry& file);
 
 	virtual std::string toStdString()const { return StringExpression::toStdStringWithParam("EXTENSION"); }
+	virtual bool nameTerms(std::list<std::string>& t) const { return containedTerms(t); }	// the extension is part of the name
 
     virtual void linearize(LinearizedExpression& e) const
     {
@@ -216,7 +216,8 @@ RsSharedDirectoriesEvent: RsEvent
 struct RsFileHashingCompletedEvent: RsEvent
 {
 	RsFileHashingCompletedEvent():
-	    RsEvent(RsEventType::FILE_HASHING_COMPLETED), mHashingSpeed(0) {}
+	    RsEvent(RsEventType::FILE_HASHING_COMPLETED), mHashingSpeed(0),
+	    mHashedFiles(0), mFilesToHash(0), mHashedBytes(0), mBytesToHash(0) {}
 
 	///* @see RsEvent @see RsSerializable
 	void serial_process( RsGenericSerializer::SerializeJob j,
@@ -226,6 +227,10 @@ struct RsFileHashingCompletedEvent: RsEvent
 		RS_SERIAL_PROCESS(mFilePath);
 		RS_SERIAL_PROCESS(mFileHash);
 		RS_SERIAL_PROCESS(mHashingSpeed);
+		RS_SERIAL_PROCESS(mHashedFiles);
+		RS_SERIAL_PROCESS(mFilesToHash);
+		RS_SERIAL_PROCESS(mHashedBytes);
+		RS_SERIAL_PROCESS(mBytesToHash);
 	}
 
 	/// Complete path of the file being hashed
@@ -236,6 +241,19 @@ struct RsFileHashingCompletedEvent: RsEvent
 
 	/// Hashing speed in MB/s
 	double mHashingSpeed;
+
+	/// Number of files hashed since the hashing process started, over all
+	/// hashing threads
+	uint64_t mHashedFiles;
+
+	/// Number of files queued for hashing since the hashing process started
+	uint64_t mFilesToHash;
+
+	/// Bytes hashed since the hashing process started
+	uint64_t mHashedBytes;
+
+	/// Total size of the files queued for hashing
+	uint64_t mBytesToHash;
 };
 
 struct RsFileTransferEvent: RsEvent
@@ -291,6 +309,7 @@ struct SharedDirStats
 {
     uint32_t total_number_of_files ;
     uint64_t total_shared_size ;
+    uint64_t total_memory_usage ;	// approximate memory used to store the file list, in bytes
 };
 
 /** This class represents a tree of directories and files, only with their names
@@ -1008,6 +1027,10 @@ public:
         virtual void setFollowSymLinks(bool b)=0 ;
 		virtual void togglePauseHashingProcess() =0;		// pauses/resumes the hashing process.
 		virtual bool hashingProcessPaused() =0;
+		virtual void setHashingThreads(uint32_t n) =0;		// number of files hashed in parallel
+		virtual uint32_t hashingThreads() =0;
+		virtual void setMaxHashingSpeed(uint32_t mb_per_sec) =0;	// limits the disk bandwidth used for hashing. 0 means no limit.
+		virtual uint32_t maxHashingSpeed() =0;
 
 		virtual bool	getShareDownloadDirectory() = 0;
 		virtual bool 	shareDownloadDirectory(bool share) = 0;
@@ -141,6 +141,15 @@ struct RsGxsChannelEvent: RsEvent
 		RS_SERIAL_PROCESS(mChannelGroupId);
 		RS_SERIAL_PROCESS(mChannelMsgId);
 	}
+
+	/// @see RsEvent
+	std::string coalescingKey() const override
+	{
+		return std::to_string(static_cast<int>(mChannelEventCode)) + ":" +
+		        mChannelGroupId.toStdString() + ":" +
+		        mChannelMsgId.toStdString() + ":" +
+		        mChannelThreadId.toStdString();
+	}
 };
 
 // This event is used to factor multiple search results notifications in a single event.
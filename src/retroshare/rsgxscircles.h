@@ -272,6 +272,13 @@ struct RsGxsCircleEvent: RsEvent
 		RS_SERIAL_PROCESS(mGxsId);
 	}
 
+	/// @see RsEvent
+	std::string coalescingKey() const override
+	{
+		return std::to_string(static_cast<int>(mCircleEventType)) + ":" +
+		        mCircleId.toStdString() + ":" + mGxsId.toStdString();
+	}
+
 	~RsGxsCircleEvent() override;
 };
 
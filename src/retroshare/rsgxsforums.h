@@ -149,6 +149,16 @@ struct RsGxsForumEvent: RsEvent
 		RS_SERIAL_PROCESS(mModeratorsRemoved);
 	}
 
+	/// @see RsEvent, moderator changes are never merged
+	std::string coalescingKey() const override
+	{
+		if(!mModeratorsAdded.empty() || !mModeratorsRemoved.empty())
+			return std::string();
+
+		return std::to_string(static_cast<int>(mForumEventCode)) + ":" +
+		        mForumGroupId.toStdString() + ":" + mForumMsgId.toStdString();
+	}
+
 	~RsGxsForumEvent() override;
 };
 
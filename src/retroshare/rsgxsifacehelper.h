@@ -24,6 +24,7 @@
 #pragma once
 
 #include <chrono>
+#include <algorithm>
 #include <thread>
 
 #include "retroshare/rsgxsiface.h"
@@ -297,7 +298,7 @@ public:
 
 		cancelActiveRequestTokens(token_request_type);
 
-		if( mTokenService.requestGroupInfo(token, 0, opts, groupIds))
+		if( mTokenService.requestGroupInfo(token, 0, interactive(opts), groupIds))
         {
 			RS_STACK_MUTEX(mMtx);
 			mActiveTokens[token]=high_priority_request? (TokenRequestType::NO_KILL_TYPE) : token_request_type;
@@ -328,7 +329,7 @@ public:
 		cancelActiveRequestTokens(token_request_type);
 
 
-		if(  mTokenService.requestGroupInfo(token, 0, opts))
+		if(  mTokenService.requestGroupInfo(token, 0, interactive(opts)))
         {
 			RS_STACK_MUTEX(mMtx);
 			mActiveTokens[token]=high_priority_request? (TokenRequestType::NO_KILL_TYPE) : token_request_type;
@@ -344,7 +345,7 @@ public:
 	/// @see RsTokenService::requestMsgInfo
 	bool requestMsgInfo( uint32_t& token, const RsTokReqOptions& opts, const GxsMsgReq& msgIds )
 	{
-        if(mTokenService.requestMsgInfo(token, 0, opts, msgIds))
+        if(mTokenService.requestMsgInfo(token, 0, interactive(opts), msgIds))
         {
 			RS_STACK_MUTEX(mMtx);
 
@@ -361,7 +362,7 @@ public:
 	/// @see RsTokenService::requestMsgInfo
 	bool requestMsgInfo( uint32_t& token, const RsTokReqOptions& opts, const std::list<RsGxsGroupId>& grpIds )
     {
-        if(mTokenService.requestMsgInfo(token, 0, opts, grpIds))
+        if(mTokenService.requestMsgInfo(token, 0, interactive(opts), grpIds))
         {
 			RS_STACK_MUTEX(mMtx);
 			mActiveTokens[token]=TokenRequestType::ALL_POSTS;
@@ -379,7 +380,7 @@ public:
 	        uint32_t& token, const RsTokReqOptions& opts,
 	        const std::vector<RsGxsGrpMsgIdPair>& msgIds )
 	{
-        if( mTokenService.requestMsgRelatedInfo(token, 0, opts, msgIds))
+        if( mTokenService.requestMsgRelatedInfo(token, 0, interactive(opts), msgIds))
         {
 			RS_STACK_MUTEX(mMtx);
 			mActiveTokens[token]=TokenRequestType::MSG_RELATED_INFO;
@@ -405,7 +406,7 @@ public:
         RsTokReqOptions opts;
         opts.mReqType = GXS_REQUEST_TYPE_SERVICE_STATS;
 
-        mTokenService.requestServiceStatistic(token,opts);
+        mTokenService.requestServiceStatistic(token,interactive(opts));
 
 		RS_STACK_MUTEX(mMtx);
 		mActiveTokens[token]=TokenRequestType::SERVICE_STATISTICS;
@@ -422,7 +423,7 @@ public:
         RsTokReqOptions opts;
         opts.mReqType = GXS_REQUEST_TYPE_GROUP_STATS;
 
-		mTokenService.requestGroupStatistic(token, grpId,opts);
+		mTokenService.requestGroupStatistic(token, grpId,interactive(opts));
 
 		RS_STACK_MUTEX(mMtx);
 		mActiveTokens[token]=TokenRequestType::GROUP_STATISTICS;
@@ -470,7 +471,9 @@ protected:
 	 * Useful for blocking API implementation.
 	 * @param[in] token token associated to the request caller is waiting for
 	 * @param[in] maxWait maximum waiting time in milliseconds
-	 * @param[in] checkEvery time in millisecond between status checks
+	 * @param[in] checkEvery time in millisecond between status checks. The
+	 *	caller is woken up as soon as the request is processed, so this only
+	 *	matters for requests whose status changes without notification.
 	 * @param[in] auto_delete_if_unsuccessful delete the request when it fails. This avoid leaving useless pending requests in the queue that would slow down additional calls.
 	 */
 	RsTokenService::GxsRequestStatus waitToken(
@@ -490,8 +493,10 @@ LLwaitTokenBeginLabel:
 		while( !(st == RsTokenService::FAILED || st >= RsTokenService::COMPLETE)
 		       && std::chrono::steady_clock::now() < timeout )
 		{
-			std::this_thread::sleep_for(checkEvery);
-			st = requestStatus(token);
+			auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+			            timeout - std::chrono::steady_clock::now() );
+			st = mTokenService.waitRequestStatus(
+			            token, std::min(checkEvery, left) );
 		}
 		if(st != RsTokenService::COMPLETE && auto_delete_if_unsuccessful)
 			cancelRequest(token);
@@ -529,6 +534,17 @@ LLwaitTokenBeginLabel:
 	}
 
 private:
+	/* Requests made through this helper usually have a client (UI, JSON API)
+	 * waiting for them. Unless told otherwise, let them go before the
+	 * background requests that services make on their own. */
+	static RsTokReqOptions interactive(const RsTokReqOptions& opts)
+	{
+		RsTokReqOptions res(opts);
+		if(res.mPriority == GxsRequestPriority::NORMAL)
+			res.mPriority = GxsRequestPriority::HIGH;
+		return res;
+	}
+
 	RsGxsIface& mGxs;
 	RsTokenService& mTokenService;
 	RsMutex mMtx;
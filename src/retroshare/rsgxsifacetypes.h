@@ -232,6 +232,37 @@ struct GxsGroupStatistic : RsSerializable
 	~GxsGroupStatistic() override;
 };
 
+/// Usage of the meta data caches of a GXS service data store
+struct GxsMetaCacheStatistic : RsSerializable
+{
+	GxsMetaCacheStatistic() :
+	    mHits(0), mMisses(0), mEvictions(0), mNumGrps(0), mNumMsgs(0),
+	    mSize(0), mMaxSize(0) {}
+
+	uint64_t mHits;      /// metas served from the caches
+	uint64_t mMisses;    /// metas read from the database
+	uint64_t mEvictions; /// msg metas dropped to stay in the memory budget
+	uint32_t mNumGrps;   /// group metas in the cache
+	uint32_t mNumMsgs;   /// msg metas in the caches
+	uint64_t mSize;      /// estimate of the memory used, in bytes
+	uint64_t mMaxSize;   /// memory budget, in bytes
+
+	/// @see RsSerializable
+	void serial_process( RsGenericSerializer::SerializeJob j,
+	                     RsGenericSerializer::SerializeContext& ctx ) override
+	{
+		RS_SERIAL_PROCESS(mHits);
+		RS_SERIAL_PROCESS(mMisses);
+		RS_SERIAL_PROCESS(mEvictions);
+		RS_SERIAL_PROCESS(mNumGrps);
+		RS_SERIAL_PROCESS(mNumMsgs);
+		RS_SERIAL_PROCESS(mSize);
+		RS_SERIAL_PROCESS(mMaxSize);
+	}
+
+	~GxsMetaCacheStatistic() override;
+};
+
 struct GxsServiceStatistic : RsSerializable
 {
 	GxsServiceStatistic() :
@@ -249,6 +280,7 @@ struct GxsServiceStatistic : RsSerializable
 	uint32_t mNumChildMsgsNew;
 	uint32_t mNumChildMsgsUnread;
 	uint32_t mSizeStore;
+	GxsMetaCacheStatistic mMetaCache;
 
 	/// @see RsSerializable
 	void serial_process( RsGenericSerializer::SerializeJob j,
@@ -264,6 +296,7 @@ struct GxsServiceStatistic : RsSerializable
 		RS_SERIAL_PROCESS(mNumChildMsgsNew);
 		RS_SERIAL_PROCESS(mNumChildMsgsUnread);
 		RS_SERIAL_PROCESS(mSizeStore);
+		RS_SERIAL_PROCESS(mMetaCache);
 	}
 
 	~GxsServiceStatistic() override;
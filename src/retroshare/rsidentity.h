@@ -338,6 +338,13 @@ struct RsGxsIdentityEvent: public RsEvent
 		RS_SERIAL_PROCESS(mIdentityId);
 	}
 
+	/// @see RsEvent
+	std::string coalescingKey() const override
+	{
+		return std::to_string(static_cast<int>(mIdentityEventCode)) + ":" +
+		        mIdentityId.toStdString();
+	}
+
 	~RsGxsIdentityEvent() override = default;
 };
 
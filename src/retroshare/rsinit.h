@@ -145,6 +145,10 @@ struct RsConfigOptions
 
 	uint16_t    jsonApiPort;		/* port to use fo Json API */
 	std::string jsonApiBindAddress; /* bind address for Json API */
+
+	uint32_t netReactorThreads;     /* epoll network reactor threads, 0 means one thread per peer */
+	uint32_t executorThreads;       /* threads shared by the GXS services, 0 means one thread per service */
+	uint32_t gxsValidationThreads;  /* executor jobs helping to check received GXS messages signatures, 0 means none */
 };
 
 
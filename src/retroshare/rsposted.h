@@ -155,6 +155,15 @@ struct RsGxsPostedEvent: RsEvent
 		RS_SERIAL_PROCESS(mPostedThreadId);
 	}
 
+	/// @see RsEvent
+	std::string coalescingKey() const override
+	{
+		return std::to_string(static_cast<int>(mPostedEventCode)) + ":" +
+		        mPostedGroupId.toStdString() + ":" +
+		        mPostedMsgId.toStdString() + ":" +
+		        mPostedThreadId.toStdString();
+	}
+
 	~RsGxsPostedEvent() override;
 };
 
@@ -26,6 +26,7 @@
 #include <inttypes.h>
 #include <string>
 #include <list>
+#include <chrono>
 
 #include "retroshare/rsgxsifacetypes.h"
 #include "util/rsdeprecate.h"
@@ -215,6 +216,17 @@ public:
      */
 	virtual GxsRequestStatus requestStatus(const uint32_t token) = 0;
 
+	/*!
+	 * Block caller until the request is over (completed, failed or
+	 * cancelled), or until maxWait elapsed. Unlike polling requestStatus(),
+	 * this returns as soon as the request has been processed.
+	 * @param token value of token to wait for
+	 * @param maxWait maximum waiting time
+	 * @return the status of the request when returning
+	 */
+	virtual GxsRequestStatus waitRequestStatus(
+	        uint32_t token, std::chrono::milliseconds maxWait ) = 0;
+
 	/*!
 	 * @brief Cancel Request
 	 * If this function returns false, it may be that the request has completed
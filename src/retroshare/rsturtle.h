@@ -94,6 +94,11 @@ class TurtleTrafficStatisticsInfo
 		float total_dn_Bps ;			// turtle network management bitrate (in Bytes per sec.)
 
 		std::vector<float> forward_probabilities ;	// probability to forward a TR as a function of depth.
+
+		uint32_t tr_filter_size ;				// memory used by the tunnel request filters of client services (in Bytes)
+		uint64_t tr_filter_rejected ;			// tunnel requests discarded by a filter, without asking its service
+		uint64_t tr_filter_passed ;			// tunnel requests that matched a filter, and were passed to its service
+		uint64_t tr_filter_false_positives ;	// tunnel requests that matched a filter, but were refused by its service
 };
 
 // Interface class for turtle hopping.
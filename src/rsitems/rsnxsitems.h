@@ -34,6 +34,7 @@
 #include "serialiser/rstlvitem.h"
 #include "serialiser/rstlvkeys.h"
 #include "gxs/rsgxsdata.h"
+#include "util/rsiblt.h"
 
 // These items have "flag type" numbers, but this is not used.
 // TODO: refactor as C++11 enum class
@@ -49,6 +50,7 @@ const uint8_t RS_PKT_SUBTYPE_NXS_MSG_ITEM             = 0x20;
 const uint8_t RS_PKT_SUBTYPE_NXS_TRANSAC_ITEM         = 0x40;
 const uint8_t RS_PKT_SUBTYPE_NXS_GRP_PUBLISH_KEY_ITEM = 0x80;
 const uint8_t RS_PKT_SUBTYPE_NXS_SYNC_PULL_REQUEST_ITEM = 0x90;
+const uint8_t RS_PKT_SUBTYPE_NXS_SYNC_MSG_RECON_ITEM    = 0xa0;
 
 
 #ifdef RS_DEAD_CODE
@@ -325,6 +327,7 @@ public:
     static const uint8_t FLAG_USE_SYNC_HASH;
 #endif
     static const uint8_t FLAG_USE_HASHED_GROUP_ID;
+    static const uint8_t FLAG_ACCEPTS_RECONCILIATION; // the msg list may be answered with a RsNxsSyncMsgReconItem
 
     explicit RsNxsSyncMsgReqItem(uint16_t servtype) : RsNxsItem(servtype, RS_PKT_SUBTYPE_NXS_SYNC_MSG_REQ_ITEM) { clear(); }
 
@@ -363,6 +366,37 @@ public:
 
 };
 
+/// Keys are the msg id followed by the author id, which the requester needs
+/// to decide whether to ask for the msg.
+typedef RsIblt<RsGxsMessageId::SIZE_IN_BYTES + RsGxsId::SIZE_IN_BYTES> RsGxsMsgIblt;
+
+/*!
+ * Answers a RsNxsSyncMsgReqItem with FLAG_ACCEPTS_RECONCILIATION instead of the
+ * list of msg ids. It holds an invertible Bloom lookup table of the msgs the
+ * peer offers for the group, sized for the expected difference with the
+ * requester's msgs, who subtracts its own msgs and decodes what it misses.
+ */
+class RsNxsSyncMsgReconItem : public RsNxsItem
+{
+public:
+    explicit RsNxsSyncMsgReconItem(uint16_t servtype)
+        : RsNxsItem(servtype, RS_PKT_SUBTYPE_NXS_SYNC_MSG_RECON_ITEM), cells(servtype)
+    {
+        cells.tlvtype = TLV_TYPE_BIN_GENERIC ;
+        clear();
+    }
+
+    virtual void clear() override;
+
+	virtual void serial_process(RsGenericSerializer::SerializeJob j,RsGenericSerializer::SerializeContext& ctx) override;
+
+    RsGxsGroupId grpId;
+    uint32_t updateTS;      // time of last update, as in the msg list transaction
+    uint32_t createdSinceTS;// msgs published before are not in the table
+    uint32_t msgCount;      // number of msgs in the table
+    RsTlvBinaryData cells;  // see RsGxsMsgIblt
+};
+
 /*!
  * Used to request to a peer pull updates from us ASAP without waiting GXS sync
  * timer */
@@ -38,6 +38,8 @@
 
 #include "pqi/p3peermgr.h"
 #include "pqi/p3netmgr.h"
+#include "pqi/pqinetreactor.h"
+#include "util/rsexecutor.h"
 
 
 // TO SHUTDOWN THREADS.
@@ -75,7 +77,7 @@ void RsServer::ConfigFinalSave()
 
 void RsServer::startServiceThread(RsTickingThread *t, const std::string &threadName)
 {
-    t->start(threadName) ;
+    t->startTicking(threadName) ;
     mRegisteredServiceThreads.push_back(t) ;
 }
 
@@ -99,6 +101,9 @@ void RsServer::rsGlobalShutDown()
 		// kill all registered service threads
 		for(RsTickingThread* service: mRegisteredServiceThreads)
 			service->fullstop();
+
+		pqiNetReactor::shutdown();
+		RsExecutor::shutdown();
 	}
 
 	fullstop();
@@ -51,6 +51,11 @@
 #include "retroshare/rsversion.h"
 #include "rsserver/rsloginhandler.h"
 #include "rsserver/rsaccounts.h"
+#include "pqi/pqinetreactor.h"
+#include "util/rsexecutor.h"
+#ifdef RS_ENABLE_GXS
+#include "gxs/rsgenexchange.h"
+#endif
 
 #ifdef RS_EMBEDED_FRIEND_SERVER
 #include "friend_server/fsmanager.h"
@@ -135,6 +140,9 @@ RsConfigOptions::RsConfigOptions()
           ,jsonApiPort(0)					// JSonAPI server is enabled in each main()
           ,jsonApiBindAddress("127.0.0.1")
 #endif
+          ,netReactorThreads(0)
+          ,executorThreads(0)
+          ,gxsValidationThreads(0)
 {
 }
 
@@ -313,6 +321,12 @@ int RsInit::InitRetroShare(const RsConfigOptions& conf)
     rsInitConfig->jsonApiBindAddress = conf.jsonApiBindAddress;
     rsInitConfig->mainExecutablePath = conf.main_executable_path;
 
+	pqiNetReactor::setThreadCount(conf.netReactorThreads);
+	RsExecutor::setThreadCount(conf.executorThreads);
+#ifdef RS_ENABLE_GXS
+	RsGenExchange::setValidationThreadCount(conf.gxsValidationThreads);
+#endif
+
 #ifdef PTW32_STATIC_LIB
 	// for static PThreads under windows... we need to init the library...
 	pthread_win32_process_attach_np();
@@ -905,7 +919,7 @@ int RsServer::StartupRetroShare()
 	std::cerr << "setup classes / structures" << std::endl;
 
 	/* History Manager */
-	mHistoryMgr = new p3HistoryMgr();
+	mHistoryMgr = new p3HistoryMgr(RsAccounts::AccountDirectory() + "/history_db", rsInitConfig->gxs_passwd);
 	mPeerMgr = new p3PeerMgrIMPL( AuthSSL::getAuthSSL()->OwnId(),
                 AuthPGP::getPgpOwnId(),
                 AuthPGP::getPgpOwnName(),
@@ -1448,16 +1462,19 @@ int RsServer::StartupRetroShare()
 	pqih->addService(gxstrans_ns, true);
 #	endif // RS_GXS_TRANS
 
-	// remove pword from memory
-	rsInitConfig->gxs_passwd = "";
-
 #endif // RS_ENABLE_GXS.
 
 	/* create Services */
 	p3ServiceInfo *serviceInfo = new p3ServiceInfo(serviceCtrl);
 	mDisc = new p3discovery2(mPeerMgr, mLinkMgr, mNetMgr, serviceCtrl,mGxsIdService);
 	mHeart = new p3heartbeat(serviceCtrl, pqih);
-	msgSrv = new p3MsgService( serviceCtrl, mGxsIdService, *mGxsTrans );
+	msgSrv = new p3MsgService( serviceCtrl, mGxsIdService, *mGxsTrans,
+	                           RsAccounts::AccountDirectory() + "/msgs_db",
+	                           rsInitConfig->gxs_passwd );
+
+	// remove pword from memory
+	rsInitConfig->gxs_passwd = "";
+
 	chatSrv = new p3ChatService( serviceCtrl,mGxsIdService, mLinkMgr,
 	                             mHistoryMgr, *mGxsTrans );
 	mStatusSrv = new p3StatusService(serviceCtrl);
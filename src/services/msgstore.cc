@@ -0,0 +1,288 @@
+/*******************************************************************************
+ * libretroshare/src/services: msgstore.cc                                     *
+ *                                                                             *
+ * libretroshare: retroshare core library                                      *
+ *                                                                             *
+ * Copyright (C) 2026  RetroShare Team <contact@retroshare.cc>                 *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Lesser General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ ******************************************************************************/
+
+#include <vector>
+
+#include "services/msgstore.h"
+#include "rsitems/rsmsgitems.h"
+#include "util/retrodb.h"
+#include "util/rsstring.h"
+
+/****
+ * #define MSGSTORE_DEBUG 1
+ ***/
+
+#define MSG_TABLE_NAME          std::string("MESSAGES")
+
+#define KEY_MSG_ID              std::string("msgId")
+#define KEY_OUTGOING            std::string("outgoing")
+#define KEY_MSG_FLAGS           std::string("msgFlags")
+#define KEY_PEER_ID             std::string("peerId")
+#define KEY_SRC_ID              std::string("srcId")
+#define KEY_PARENT_ID           std::string("parentId")
+#define KEY_HEAD                std::string("head")
+#define KEY_BODY                std::string("body")
+
+#define MSG_INDEX_OUTGOING      std::string("INDEX_MESSAGES_OUTGOING")
+
+static std::string msgSelection(uint32_t msgId)
+{
+	std::string selection;
+	rs_sprintf(selection, "%s=%u", KEY_MSG_ID.c_str(), msgId);
+	return selection;
+}
+
+MsgStore::MsgStore(const std::string& dbPath, const std::string& key)
+    : mDb(new RetroDb(dbPath, RetroDb::OPEN_READWRITE_CREATE, key)),
+      mSerialiser(new RsMsgSerialiser(RsSerializationFlags::CONFIG))
+{
+	if(!mDb->isOpen())
+	{
+		RsErr() << __PRETTY_FUNCTION__ << " cannot open message database " << dbPath;
+		return;
+	}
+
+	if(!mDb->tableExists(MSG_TABLE_NAME))
+	{
+		mDb->execSQL("CREATE TABLE " + MSG_TABLE_NAME + "(" +
+		             KEY_MSG_ID + " INTEGER PRIMARY KEY," +
+		             KEY_OUTGOING + " INT," +
+		             KEY_MSG_FLAGS + " INT," +
+		             KEY_PEER_ID + " TEXT," +
+		             KEY_SRC_ID + " TEXT," +
+		             KEY_PARENT_ID + " INT," +
+		             KEY_HEAD + " BLOB," +
+		             KEY_BODY + " TEXT);");
+
+		// outgoing messages are loaded with their body
+		mDb->execSQL("CREATE INDEX " + MSG_INDEX_OUTGOING + " ON " + MSG_TABLE_NAME + "(" + KEY_OUTGOING + ");");
+	}
+}
+
+MsgStore::~MsgStore()
+{
+	delete mDb;
+	delete mSerialiser;
+}
+
+bool MsgStore::isOpen() const
+{
+	return mDb->isOpen();
+}
+
+bool MsgStore::storeMsgs(const std::list<Entry>& entries)
+{
+	if(!mDb->isOpen())
+		return false;
+
+	std::list<ContentValue> cvs;
+
+	for(std::list<Entry>::const_iterator it(entries.begin());it!=entries.end();++it)
+	{
+		RsMsgItem *msg = it->msg;
+
+		// The body is taken out of the item while serialising the head.
+
+		std::string body;
+		body.swap(msg->message);
+
+		uint32_t size = mSerialiser->size(msg);
+		std::vector<char> head(size);
+		bool ok = mSerialiser->serialise(msg, head.data(), &size);
+
+		body.swap(msg->message);
+
+		if(!ok)
+		{
+			RsErr() << __PRETTY_FUNCTION__ << " cannot serialise message " << msg->msgId;
+			continue;
+		}
+
+		cvs.push_back(ContentValue());
+		ContentValue& cv(cvs.back());
+
+		cv.put(KEY_MSG_ID, (int64_t)msg->msgId);
+		cv.put(KEY_OUTGOING, it->outgoing);
+		cv.put(KEY_MSG_FLAGS, (int64_t)msg->msgFlags);
+		cv.put(KEY_PEER_ID, msg->PeerId().toStdString());
+		cv.put(KEY_SRC_ID, it->srcId.isNull() ? std::string() : it->srcId.toStdString());
+		cv.put(KEY_PARENT_ID, (int64_t)it->parentId);
+		cv.put(KEY_HEAD, size, head.data());
+		cv.put(KEY_BODY, msg->message);
+	}
+
+	bool ownTransaction = mDb->beginTransaction();
+
+	for(std::list<ContentValue>::const_iterator it(cvs.begin());it!=cvs.end();++it)
+	{
+		int64_t msgId = 0;
+		it->getAsInt64(KEY_MSG_ID, msgId);
+		mDb->sqlDelete(MSG_TABLE_NAME, msgSelection(msgId), "");
+	}
+
+	bool ok = mDb->sqlInsertBulk(MSG_TABLE_NAME, "", cvs);
+
+	if(ownTransaction)
+		ok = mDb->commitTransaction() && ok;
+
+	return ok && cvs.size() == entries.size();
+}
+
+bool MsgStore::removeMsg(uint32_t msgId)
+{
+	if(!mDb->isOpen())
+		return false;
+
+	return mDb->sqlDelete(MSG_TABLE_NAME, msgSelection(msgId), "");
+}
+
+bool MsgStore::update(uint32_t msgId, const ContentValue& cv)
+{
+	if(!mDb->isOpen())
+		return false;
+
+	return mDb->sqlUpdate(MSG_TABLE_NAME, msgSelection(msgId), cv);
+}
+
+bool MsgStore::updateFlags(uint32_t msgId, uint32_t msgFlags)
+{
+	ContentValue cv;
+	cv.put(KEY_MSG_FLAGS, (int64_t)msgFlags);
+	return update(msgId, cv);
+}
+
+bool MsgStore::updateParentId(uint32_t msgId, uint32_t parentId)
+{
+	ContentValue cv;
+	cv.put(KEY_PARENT_ID, (int64_t)parentId);
+	return update(msgId, cv);
+}
+
+bool MsgStore::loadMsgs(std::list<Entry>& entries)
+{
+	if(!mDb->isOpen())
+		return false;
+
+	std::list<std::string> columns;
+	columns.push_back(KEY_MSG_ID);
+	columns.push_back(KEY_OUTGOING);
+	columns.push_back(KEY_MSG_FLAGS);
+	columns.push_back(KEY_PEER_ID);
+	columns.push_back(KEY_SRC_ID);
+	columns.push_back(KEY_PARENT_ID);
+	columns.push_back(KEY_HEAD);
+
+	RetroCursor *c = mDb->sqlQuery(MSG_TABLE_NAME, columns, "", KEY_MSG_ID);
+
+	if(!c)
+		return false;
+
+	for(bool valid = c->moveToFirst();valid;valid = c->moveToNext())
+	{
+		uint32_t size = 0;
+		const void *head = c->getData(6, size);
+		uint32_t msgId = c->getInt64(0);
+
+		RsMsgItem *msg = head ? dynamic_cast<RsMsgItem*>(mSerialiser->deserialise(const_cast<void*>(head), &size)) : NULL;
+
+		if(!msg)
+		{
+			RsErr() << __PRETTY_FUNCTION__ << " cannot deserialise message " << msgId << ". Skipping it.";
+			continue;
+		}
+
+		Entry e;
+		e.msg = msg;
+		e.outgoing = c->getBool(1);
+
+		std::string peerId, srcId;
+		c->getString(3, peerId);
+		c->getString(4, srcId);
+
+		msg->msgId = msgId;
+		msg->msgFlags = c->getInt64(2);
+		msg->PeerId(RsPeerId(peerId));
+
+		if(!srcId.empty())
+			e.srcId = RsPeerId(srcId);
+
+		e.parentId = c->getInt64(5);
+
+		entries.push_back(e);
+	}
+	delete c;
+
+	// Outgoing messages are still to be sent, so they need their body.
+
+	columns.clear();
+	columns.push_back(KEY_MSG_ID);
+	columns.push_back(KEY_BODY);
+
+	c = mDb->sqlQuery(MSG_TABLE_NAME, columns, KEY_OUTGOING + "=1", KEY_MSG_ID);
+
+	if(c)
+	{
+		std::list<Entry>::iterator it = entries.begin();
+
+		for(bool valid = c->moveToFirst();valid;valid = c->moveToNext())
+		{
+			uint32_t msgId = c->getInt64(0);
+
+			while(it != entries.end() && it->msg->msgId < msgId)
+				++it;
+
+			if(it != entries.end() && it->msg->msgId == msgId)
+				c->getString(1, it->msg->message);
+		}
+		delete c;
+	}
+
+#ifdef MSGSTORE_DEBUG
+	std::cerr << "MsgStore: loaded " << entries.size() << " messages" << std::endl;
+#endif
+
+	return true;
+}
+
+bool MsgStore::getBody(uint32_t msgId, std::string& body)
+{
+	body.clear();
+
+	if(!mDb->isOpen())
+		return false;
+
+	std::list<std::string> columns;
+	columns.push_back(KEY_BODY);
+
+	RetroCursor *c = mDb->sqlQuery(MSG_TABLE_NAME, columns, msgSelection(msgId), "");
+
+	if(!c)
+		return false;
+
+	bool found = c->moveToFirst();
+
+	if(found)
+		c->getString(0, body);
+
+	delete c;
+	return found;
+}
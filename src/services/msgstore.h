@@ -0,0 +1,87 @@
+/*******************************************************************************
+ * libretroshare/src/services: msgstore.h                                      *
+ *                                                                             *
+ * libretroshare: retroshare core library                                      *
+ *                                                                             *
+ * Copyright (C) 2026  RetroShare Team <contact@retroshare.cc>                 *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Lesser General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ ******************************************************************************/
+#pragma once
+
+#include <list>
+#include <string>
+
+#include "retroshare/rstypes.h"
+
+class RetroDb;
+class ContentValue;
+class RsMsgItem;
+class RsMsgSerialiser;
+
+/*!
+ * \brief The MsgStore class
+ * 		Mailbox of p3MsgService, in a RetroDb database. Each message is one row, where the text of the message
+ * 		(the body) is kept apart from the rest of the item (the head). Heads are small, so that the whole mailbox
+ * 		can be listed at startup without reading any body. Bodies are read one by one when a message is opened.
+ *
+ * 		Flags and parent ids have their own columns, so that changing them does not rewrite the
+ * 		message. At load time, they take precedence over the values serialised in the head.
+ *
+ * 		This class is not thread safe. It is owned by p3MsgService, which protects it with its own mutex.
+ */
+class MsgStore
+{
+public:
+	struct Entry
+	{
+		Entry() : msg(NULL), outgoing(false), parentId(0) {}
+
+		RsMsgItem *msg;
+		bool outgoing;		// true for messages of p3MsgService::msgOutgoing
+		RsPeerId srcId;		// null when the message has no RsMsgSrcId
+		uint32_t parentId;	// 0 when the message has no RsMsgParentId
+	};
+
+	MsgStore(const std::string& dbPath, const std::string& key);
+	~MsgStore();
+
+	bool isOpen() const;
+
+	// Writes the given messages, replacing previous versions, in a single transaction.
+
+	bool storeMsgs(const std::list<Entry>& entries);
+
+	bool removeMsg(uint32_t msgId);
+
+	bool updateFlags(uint32_t msgId, uint32_t msgFlags);
+	bool updateParentId(uint32_t msgId, uint32_t parentId);
+
+	/*!
+	 * \brief loadMsgs
+	 * 		Reads all messages. Messages have their body only when they are outgoing. Other bodies are read with
+	 * 		getBody().
+	 * \param entries	newly allocated items, that belong to the caller
+	 */
+	bool loadMsgs(std::list<Entry>& entries);
+
+	bool getBody(uint32_t msgId, std::string& body);
+
+private:
+	bool update(uint32_t msgId, const ContentValue& cv);
+
+	RetroDb *mDb;
+	RsMsgSerialiser *mSerialiser;
+};
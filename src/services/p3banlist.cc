@@ -60,7 +60,8 @@ RsBanList *rsBanList = NULL ;
 
 p3BanList::p3BanList(p3ServiceControl *sc, p3NetMgr */*nm*/)
   : p3Service(), mBanMtx("p3BanList"), mServiceCtrl(sc)
-  , mSentListTime(0), mLastDhtInfoRequest(0)
+  , mSentListTime(0), mFilter(std::make_shared<BanListFilter>())
+  , mLastDhtInfoRequest(0)
   // default number of IPs in same range to trigger a complete IP /24 filter.
   , mAutoRangeLimit(2), mAutoRangeIps(true)
   , mIPFilteringEnabled(true)
@@ -85,12 +86,27 @@ RsServiceInfo p3BanList::getServiceInfo()
 }
 
 bool p3BanList::ipFilteringEnabled() { return mIPFilteringEnabled ; }
-void p3BanList::enableIPFiltering(bool b) { mIPFilteringEnabled = b ; }
-void p3BanList::enableIPsFromFriends(bool b) { mIPFriendGatheringEnabled = b; mLastDhtInfoRequest=0;}
-void p3BanList::enableIPsFromDHT(bool b)
+void p3BanList::enableIPFiltering(bool b)
 {
-    mIPDHTGatheringEnabled = b;
+    RS_STACK_MUTEX(mBanMtx) ;
+    mIPFilteringEnabled = b ;
+    updateFilter_locked() ;
+}
+void p3BanList::enableIPsFromFriends(bool b)
+{
+    RS_STACK_MUTEX(mBanMtx) ;
+    mIPFriendGatheringEnabled = b;
     mLastDhtInfoRequest=0;
+    updateFilter_locked() ;
+}
+void p3BanList::enableIPsFromDHT(bool b)
+{
+    {
+        RS_STACK_MUTEX(mBanMtx) ;
+        mIPDHTGatheringEnabled = b;
+        mLastDhtInfoRequest=0;
+        updateFilter_locked() ;
+    }
 
     IndicateConfigChanged();
 }
@@ -214,7 +230,11 @@ void p3BanList::autoFigureOutBanRanges()
 
     IndicateConfigChanged();
 
-	if(!mAutoRangeIps) return;
+	if(!mAutoRangeIps)
+	{
+		updateFilter_locked();
+		return;
+	}
 
 #ifdef DEBUG_BANLIST
     std::cerr << "Automatically figuring out IP ranges from banned IPs." << std::endl;
@@ -319,27 +339,15 @@ bool p3BanList::isAddressAccepted(
 	if(sockaddr_storage_isLoopbackNet(addr)) return true;
 
 
-	RS_STACK_MUTEX(mBanMtx);
+	std::shared_ptr<const BanListFilter> filter = std::atomic_load(&mFilter);
 
-	if(!mIPFilteringEnabled) return true;
+	if(!filter->mEnabled) return true;
 
 #ifdef DEBUG_BANLIST
     std::cerr << "isAddressAccepted(): tested addr=" << sockaddr_storage_iptostring(addr) << ", checking flags=" << checking_flags ;
 #endif
 
-    // we should normally work this including entire ranges of IPs. For now, just check the exact IPs.
-
-    sockaddr_storage addr_32 = makeBitsRange(addr,0) ;	// this is necessay because it cleans the address
-    sockaddr_storage addr_24 = makeBitsRange(addr,1) ;
-    sockaddr_storage addr_16 = makeBitsRange(addr,2) ;
-
-    bool white_list_found = false ;
-
-    white_list_found = white_list_found || (mWhiteListedRanges.find(addr_16) != mWhiteListedRanges.end()) ;
-    white_list_found = white_list_found || (mWhiteListedRanges.find(addr_24) != mWhiteListedRanges.end()) ;
-    white_list_found = white_list_found || (mWhiteListedRanges.find(addr_32) != mWhiteListedRanges.end()) ;
-
-    if(white_list_found)
+    if(filter->mWhiteList.longestMatch(addr))
 	{
 		check_result = RSBANLIST_CHECK_RESULT_ACCEPTED;
 #ifdef DEBUG_BANLIST
@@ -366,43 +374,17 @@ bool p3BanList::isAddressAccepted(
         return true;
     }
 
-    std::map<sockaddr_storage,BanListPeer>::iterator it ;
+    // Ban ranges and banned addresses share the same trie. The most specific
+    // one is the one that gets the connection attempt.
 
-    if(((it=mBanRanges.find(addr_16)) != mBanRanges.end()) && acceptedBanRanges_locked(it->second))
-    {
-        ++it->second.connect_attempts;
-#ifdef DEBUG_BANLIST
-      std::cerr << " found in blacklisted range " << sockaddr_storage_iptostring(it->first) << "/16. returning false. attempts=" << it->second.connect_attempts << std::endl;
-#endif
-	    check_result = RSBANLIST_CHECK_RESULT_BLACKLISTED;
-      return false ;
-  }
+    uint32_t prefix_len = 0 ;
+    const BanListFilter::Entry *entry = filter->mBlackList.longestMatch(addr,&prefix_len) ;
 
-  if(((it=mBanRanges.find(addr_24)) != mBanRanges.end()) && acceptedBanRanges_locked(it->second))
-  {
-      ++it->second.connect_attempts;
-#ifdef DEBUG_BANLIST
-      std::cerr << " found in blacklisted range " << sockaddr_storage_iptostring(it->first) << "/24.  returning false. attempts=" << it->second.connect_attempts << std::endl;
-#endif
-	    check_result = RSBANLIST_CHECK_RESULT_BLACKLISTED;
-      return false ;
-  }
-
-  if(((it=mBanRanges.find(addr_32)) != mBanRanges.end()) && acceptedBanRanges_locked(it->second))
-  {
-      ++it->second.connect_attempts;
-#ifdef DEBUG_BANLIST
-      std::cerr << " found in blacklisted range " << sockaddr_storage_iptostring(it->first) << "/32.  returning false. attempts=" << it->second.connect_attempts << std::endl;
-#endif
-	    check_result = RSBANLIST_CHECK_RESULT_BLACKLISTED;
-        return false ;
-    }
-
-    if((it=mBanSet.find(addr_32)) != mBanSet.end() && acceptedBanSet_locked(it->second))
+    if(entry)
     {
-        ++it->second.connect_attempts;
+        countConnectAttempt(*entry) ;
 #ifdef DEBUG_BANLIST
-      std::cerr << "found as blacklisted address " << sockaddr_storage_iptostring(it->first) << ".  returning false. attempts=" << it->second.connect_attempts << std::endl;
+      std::cerr << " found in blacklist " << sockaddr_storage_iptostring(entry->mKey) << "/" << prefix_len << ". returning false." << std::endl;
 #endif
 	    check_result = RSBANLIST_CHECK_RESULT_BLACKLISTED;
       return false ;
@@ -415,6 +397,53 @@ bool p3BanList::isAddressAccepted(
     return true ;
 }
 
+void p3BanList::countConnectAttempt(const BanListFilter::Entry& entry)
+{
+    RS_STACK_MUTEX(mBanMtx) ;
+
+    std::map<sockaddr_storage,BanListPeer>& banlist(entry.mRange ? mBanRanges : mBanSet) ;
+    std::map<sockaddr_storage,BanListPeer>::iterator it = banlist.find(entry.mKey) ;
+
+    // the entry may have been removed since the filter was built
+    if(it != banlist.end())
+        ++it->second.connect_attempts;
+}
+
+void p3BanList::updateFilter_locked()
+{
+    std::shared_ptr<BanListFilter> filter = std::make_shared<BanListFilter>() ;
+
+    filter->mEnabled = mIPFilteringEnabled ;
+
+    // Ranges are stored with their host bits set, so the prefix length only
+    // depends on the number of masked bytes.
+
+    for(std::map<sockaddr_storage,BanListPeer>::const_iterator it(mWhiteListedRanges.begin());it!=mWhiteListedRanges.end();++it)
+        filter->mWhiteList.insert(it->first, 32 - 8*it->second.masked_bytes, 1) ;
+
+    BanListFilter::Entry entry ;
+
+    entry.mRange = false ;
+    for(std::map<sockaddr_storage,BanListPeer>::const_iterator it(mBanSet.begin());it!=mBanSet.end();++it)
+        if(acceptedBanSet_locked(it->second))
+        {
+            entry.mKey = it->first ;
+            filter->mBlackList.insert(it->first, 32, entry) ;
+        }
+
+    // inserted last, so that a user range wins over a banned address of same prefix
+
+    entry.mRange = true ;
+    for(std::map<sockaddr_storage,BanListPeer>::const_iterator it(mBanRanges.begin());it!=mBanRanges.end();++it)
+        if(acceptedBanRanges_locked(it->second))
+        {
+            entry.mKey = it->first ;
+            filter->mBlackList.insert(it->first, 32 - 8*it->second.masked_bytes, entry) ;
+        }
+
+    std::atomic_store(&mFilter, std::shared_ptr<const BanListFilter>(filter)) ;
+}
+
 void p3BanList::getWhiteListedIps(std::list<BanListPeer> &lst)
 {
     RS_STACK_MUTEX(mBanMtx) ;
@@ -906,6 +935,7 @@ bool p3BanList::loadList(std::list<RsItem*>& load)
     }
 
     load.clear() ;
+    updateFilter_locked() ;
     return true ;
 }
 
@@ -1139,6 +1169,8 @@ int p3BanList::condenseBanSources_locked()
 	printBanSet_locked(std::cerr);
 #endif
 
+	updateFilter_locked();
+
 	return true ;
 }
 
@@ -25,10 +25,12 @@
 #include <string>
 #include <list>
 #include <map>
+#include <memory>
 
 #include "rsitems/rsbanlistitems.h"
 #include "services/p3service.h"
 #include "retroshare/rsbanlist.h"
+#include "util/rsiptrie.h"
 
 class p3ServiceControl;
 class p3NetMgr;
@@ -42,6 +44,28 @@ class BanList
 	std::map<struct sockaddr_storage, BanListPeer> mBanPeers;
 };
 
+/**
+ * Read only view of the white list and of the ban ranges and addresses that are
+ * currently enforced, indexed for address lookups. A new one is built each time
+ * the lists or the filtering options change, and published atomically, so that
+ * isAddressAccepted() never waits for the ban list mutex.
+ */
+struct BanListFilter
+{
+	BanListFilter() : mEnabled(true) {}
+
+	/* Key of the ban entry in p3BanList::mBanRanges or p3BanList::mBanSet */
+	struct Entry
+	{
+		sockaddr_storage mKey;
+		bool mRange;
+	};
+
+	bool mEnabled;
+	RsIpPrefixTrie<uint8_t> mWhiteList;
+	RsIpPrefixTrie<Entry> mBlackList;
+};
+
 /**
  * The RS BanList service.
  * Exchange list of Banned IPv4 addresses with peers.
@@ -143,6 +167,8 @@ private:
     int printBanSources_locked(std::ostream &out);
     int printBanSet_locked(std::ostream &out);
     bool isWhiteListed_locked(const sockaddr_storage &addr);
+    void updateFilter_locked();
+    void countConnectAttempt(const BanListFilter::Entry& entry);
 
     p3ServiceControl *mServiceCtrl;
     //p3NetMgr *mNetMgr;
@@ -152,6 +178,9 @@ private:
     std::map<struct sockaddr_storage, BanListPeer> mBanRanges;
     std::map<struct sockaddr_storage, BanListPeer> mWhiteListedRanges;
 
+    // only accessed through std::atomic_load/std::atomic_store
+    std::shared_ptr<const BanListFilter> mFilter;
+
     rstime_t mLastDhtInfoRequest ;
 
     uint32_t mAutoRangeLimit ;
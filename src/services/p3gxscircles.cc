@@ -1641,17 +1641,9 @@ bool p3GxsCircles::locked_setGroupUnprocessedStatus(RsGxsCircleCache& cache,bool
 
     RsThread::async([token2,this]()
     {
-        std::chrono::milliseconds maxWait = std::chrono::milliseconds(10000);
-        std::chrono::milliseconds checkEvery = std::chrono::milliseconds(100);
-
-        auto timeout = std::chrono::steady_clock::now() + maxWait;	// wait for 10 secs at most
-        auto st = requestStatus(token2);
-
-        while( !(st == RsTokenService::FAILED || st >= RsTokenService::COMPLETE) && std::chrono::steady_clock::now() < timeout )
-        {
-            std::this_thread::sleep_for(checkEvery);
-            st = requestStatus(token2);
-        }
+        // wait for 10 secs at most
+        waitToken( token2, std::chrono::milliseconds(10000),
+                   std::chrono::milliseconds(100), false );
 
         RsGxsGroupId grpId;
         acknowledgeGrp(token2,grpId);
@@ -1670,17 +1662,9 @@ bool p3GxsCircles::locked_subscribeToCircle(const RsGxsCircleId &grpId, bool sub
 
     RsThread::async([token,this]()
     {
-        std::chrono::milliseconds maxWait = std::chrono::milliseconds(10000);
-        std::chrono::milliseconds checkEvery = std::chrono::milliseconds(100);
-
-        auto timeout = std::chrono::steady_clock::now() + maxWait;	// wait for 10 secs at most
-        auto st = requestStatus(token);
-
-        while( !(st == RsTokenService::FAILED || st >= RsTokenService::COMPLETE) && std::chrono::steady_clock::now() < timeout )
-        {
-            std::this_thread::sleep_for(checkEvery);
-            st = requestStatus(token);
-        }
+        // wait for 10 secs at most
+        waitToken( token, std::chrono::milliseconds(10000),
+                   std::chrono::milliseconds(100), false );
 
         RsGxsGroupId grpId;
         acknowledgeGrp(token,grpId);
@@ -2103,17 +2087,9 @@ bool p3GxsCircles::pushCircleMembershipRequest( const RsGxsId& own_gxsid, const
 
     RsThread::async( [this,token]()
     {
-        std::chrono::milliseconds maxWait = std::chrono::milliseconds(10000);
-        std::chrono::milliseconds checkEvery = std::chrono::milliseconds(100);
-
-        auto timeout = std::chrono::steady_clock::now() + maxWait;	// wait for 10 secs at most
-        auto st = requestStatus(token);
-
-        while( !(st == RsTokenService::FAILED || st >= RsTokenService::COMPLETE) && std::chrono::steady_clock::now() < timeout )
-        {
-            std::this_thread::sleep_for(checkEvery);
-            st = requestStatus(token);
-        }
+        // wait for 10 secs at most
+        waitToken( token, std::chrono::milliseconds(10000),
+                   std::chrono::milliseconds(100), false );
 
         std::pair<RsGxsGroupId,RsGxsMessageId> grpmsgId;
         acknowledgeMsg(token,grpmsgId);
@@ -1028,6 +1028,19 @@ bool p3GxsReputation::getOwnOpinion(
     return true;
 }
 
+static void fillReputationSetItem(const RsGxsId& id, const Reputation& reputation, RsGxsReputationSetItem& item)
+{
+	item.mGxsId = id;
+	item.mOwnOpinion = reputation.mOwnOpinion;
+	item.mOwnOpinionTS = reputation.mOwnOpinionTs;
+	item.mIdentityFlags = reputation.mIdentityFlags;
+	item.mOwnerNodeId = reputation.mOwnerNode;
+	item.mLastUsedTS = reputation.mLastUsedTS;
+
+	for(std::map<RsPeerId, RsOpinion>::const_iterator oit = reputation.mOpinions.begin(); oit != reputation.mOpinions.end(); ++oit)
+		item.mOpinions[oit->first] = (uint32_t)oit->second;	// should be already limited.
+}
+
 bool p3GxsReputation::setOwnOpinion(
         const RsGxsId& gxsid, RsOpinion opinion )
 {
@@ -1040,6 +1053,11 @@ bool p3GxsReputation::setOwnOpinion(
         return false ;
     }
 
+	// Own opinions change rarely and are worth keeping, so they are journaled. Opinions received
+	// from friends go through the periodic save instead.
+
+	RsGxsReputationSetItem item;
+	{
 	RS_STACK_MUTEX(mReputationMtx);
 
 	std::map<RsGxsId, Reputation>::iterator rit;
@@ -1086,8 +1104,10 @@ bool p3GxsReputation::setOwnOpinion(
 	mReputationsUpdated = true;	
 	mLastBannedNodesUpdate = 0 ;	// for update of banned nodes
     
-	// Switched to periodic save due to scale of data.
-	IndicateConfigChanged();		
+	fillReputationSetItem(gxsid, reputation, item);
+	}
+
+	journalAddItem(&item);	// done off-mutex, since it writes to disk
     
 	return true;
 }
@@ -1136,19 +1156,7 @@ bool p3GxsReputation::saveList(bool& cleanup, std::list<RsItem*> &savelist)
 	for(rit = mReputations.begin(); rit != mReputations.end(); ++rit, count++)
 	{
 		RsGxsReputationSetItem *item = new RsGxsReputationSetItem();
-		item->mGxsId = rit->first;
-		item->mOwnOpinion = rit->second.mOwnOpinion;
-		item->mOwnOpinionTS = rit->second.mOwnOpinionTs;
-		item->mIdentityFlags = rit->second.mIdentityFlags;
-        item->mOwnerNodeId = rit->second.mOwnerNode;
-        item->mLastUsedTS = rit->second.mLastUsedTS;
-
-		std::map<RsPeerId, RsOpinion>::iterator oit;
-		for(oit = rit->second.mOpinions.begin(); oit != rit->second.mOpinions.end(); ++oit)
-		{
-			// should be already limited.
-			item->mOpinions[oit->first] = (uint32_t)oit->second;
-		}
+		fillReputationSetItem(rit->first, rit->second, *item);
 
 		savelist.push_back(item);
 		count++;
@@ -1290,6 +1298,49 @@ bool p3GxsReputation::loadList(std::list<RsItem *>& loadList)
     loadList.clear() ;
     return true;
 }
+void p3GxsReputation::loadJournalItem(RsItem *item, bool removed)
+{
+	RsGxsReputationSetItem *set = dynamic_cast<RsGxsReputationSetItem *>(item);
+
+	if(!set)
+	{
+		p3Config::loadJournalItem(item, removed);
+		return;
+	}
+
+	std::set<RsPeerId> peerSet;
+	{
+		RsStackMutex stack(mReputationMtx); /****** LOCKED MUTEX *******/
+
+		// Records replace the whole entry, so drop the current one first.
+
+		std::map<RsGxsId, Reputation>::iterator rit = mReputations.find(set->mGxsId);
+
+		if(rit != mReputations.end())
+		{
+			std::multimap<rstime_t, RsGxsId>::iterator uit = mUpdated.lower_bound(rit->second.mOwnOpinionTs);
+			std::multimap<rstime_t, RsGxsId>::iterator euit = mUpdated.upper_bound(rit->second.mOwnOpinionTs);
+
+			for(; uit != euit; ++uit)
+				if(uit->second == set->mGxsId)
+				{
+					mUpdated.erase(uit);
+					break;
+				}
+
+			mReputations.erase(rit);
+		}
+
+		for(std::map<RsPeerId, ReputationConfig>::const_iterator it = mConfig.begin(); it != mConfig.end(); ++it)
+			peerSet.insert(it->first);
+	}
+
+	if(!removed)
+		loadReputationSet(set, peerSet);
+
+	delete item;
+}
+
 #ifdef TO_REMOVE
 bool p3GxsReputation::loadReputationSet_deprecated3(RsGxsReputationSetItem_deprecated3 *item, const std::set<RsPeerId> &peerSet)
 {
@@ -141,6 +141,7 @@ public:
     virtual bool saveList(bool& cleanup, std::list<RsItem*>&) ;
     virtual void saveDone();
     virtual bool loadList(std::list<RsItem*>& load) ;
+    virtual void loadJournalItem(RsItem *item, bool removed);
 
 private:
 	bool getIdentityFlagsAndOwnerId(const RsGxsId& gxsid, uint32_t& identity_flags, RsPgpId &owner_id);
@@ -33,6 +33,7 @@
 
 #include "services/p3idservice.h"
 #include "services/p3msgservice.h"
+#include "services/msgstore.h"
 
 #include "pgp/pgpkeyutil.h"
 #include "rsserver/p3face.h"
@@ -52,6 +53,7 @@
 #include "util/rsthreads.h"
 
 #include <unistd.h>
+#include <algorithm>
 #include <iomanip>
 #include <map>
 #include <sstream>
@@ -73,12 +75,13 @@ static constexpr uint32_t RS_MSG_DISTANT_MESSAGE_HASH_KEEP_TIME = 2*30*86400;
  */
 
 p3MsgService::p3MsgService( p3ServiceControl *sc, p3IdService *id_serv,
-                            p3GxsTrans& gxsMS )
+                            p3GxsTrans& gxsMS, const std::string& dbPath,
+                            const std::string& key )
     : p3Service(), p3Config(),
       gxsOngoingMutex("p3MsgService Gxs Outgoing Mutex"), mIdService(id_serv),
       mServiceCtrl(sc), mMsgMtx("p3MsgService"), mMsgUniqueId(0),
       recentlyReceivedMutex("p3MsgService recently received hash mutex"),
-      mGxsTransServ(gxsMS)
+      mStore(new MsgStore(dbPath, key)), mGxsTransServ(gxsMS)
 {
 	/* this serialiser is used for services. It's not the same than the one
 	 * returned by setupSerialiser(). We need both!! */
@@ -89,6 +92,11 @@ p3MsgService::p3MsgService( p3ServiceControl *sc, p3IdService *id_serv,
 	 * As such, thay do not need to be different at friends nodes. */
 	mMsgUniqueId = 1;
 
+	{
+		RS_STACK_MUTEX(mMsgMtx);
+		locked_loadStoredMsgs();
+	}
+
 	mShouldEnableDistantMessaging = true;
 	mDistantMessagingEnabled = false;
 	mDistantMessagePermissions = RS_DISTANT_MESSAGING_CONTACT_PERMISSION_FLAG_FILTER_NONE;
@@ -127,6 +135,8 @@ p3MsgService::~p3MsgService()
     for(auto mout:msgOutgoing)   delete mout.second;
 
     for(auto mpend:_pendingPartialMessages) delete mpend.second;
+
+    delete mStore;
 }
 
 uint32_t p3MsgService::getNewUniqueMsgId()
@@ -204,7 +214,9 @@ void p3MsgService::processIncomingMsg(RsMsgItem *mi)
 		msi->srcId = mi->PeerId();
 		mSrcIds.insert(std::pair<uint32_t, RsMsgSrcId*>(msi->msgId, msi));
 
-		IndicateConfigChanged(RsConfigMgr::CheckPriority::SAVE_NOW); /**** INDICATE MSG CONFIG CHANGED! *****/
+		/* attachments are needed below, so the body is the only thing
+		 * dropped from memory by storing the message */
+		locked_storeMsg(mi, false);
 
 		/**** STACK UNLOCKED ***/
 	}
@@ -401,6 +413,7 @@ int p3MsgService::checkOutgoingMessages()
 					          << std::endl;
 #endif
 					mit->second->msgFlags |= RS_MSG_FLAGS_ROUTED;
+					locked_storeMsgFlags(mit->second);
 				}
 			}
 #ifdef DEBUG_DISTANT_MSG
@@ -415,6 +428,8 @@ int p3MsgService::checkOutgoingMessages()
 			mit = msgOutgoing.find(*it);
 			if ( mit != msgOutgoing.end() ) msgOutgoing.erase(mit);
 
+			locked_removeStoredMsg(*it);
+
 			std::map<uint32_t, RsMsgSrcId*>::iterator srcIt = mSrcIds.find(*it);
 			if (srcIt != mSrcIds.end())
 			{
@@ -423,7 +438,6 @@ int p3MsgService::checkOutgoingMessages()
 			}
 		}
 
-		if (toErase.size() > 0) IndicateConfigChanged(RsConfigMgr::CheckPriority::SAVE_NOW);
 	}
 
 	for( std::list<RsMsgItem*>::const_iterator it(output_queue.begin());
@@ -458,15 +472,22 @@ bool p3MsgService::saveList(bool& cleanup, std::list<RsItem*>& itemList)
 
 	mMsgMtx.lock();
 
-	for(mit = imsg.begin(); mit != imsg.end(); ++mit)
-        itemList.push_back(new RsMsgItem(*mit->second));
+	// Messages, with their source and parent ids, are saved in mStore as
+	// they change. They only go to the config file when it could not be opened.
 
-	for(lit = mSrcIds.begin(); lit != mSrcIds.end(); ++lit)
-        itemList.push_back(new RsMsgSrcId(*lit->second));
+	bool saveMsgs = !mStore->isOpen();
 
+	if(saveMsgs)
+	{
+		for(mit = imsg.begin(); mit != imsg.end(); ++mit)
+			itemList.push_back(new RsMsgItem(*mit->second));
 
-	for(mit = msgOutgoing.begin(); mit != msgOutgoing.end(); ++mit)
-        itemList.push_back(new RsMsgItem(*mit->second)) ;
+		for(lit = mSrcIds.begin(); lit != mSrcIds.end(); ++lit)
+			itemList.push_back(new RsMsgSrcId(*lit->second));
+
+		for(mit = msgOutgoing.begin(); mit != msgOutgoing.end(); ++mit)
+			itemList.push_back(new RsMsgItem(*mit->second)) ;
+	}
 
 	for(mit2 = mTags.begin();  mit2 != mTags.end(); ++mit2)
         itemList.push_back(new RsMsgTagType(*mit2->second));
@@ -474,8 +495,9 @@ bool p3MsgService::saveList(bool& cleanup, std::list<RsItem*>& itemList)
 	for(mit3 = mMsgTags.begin();  mit3 != mMsgTags.end(); ++mit3)
         itemList.push_back(new RsMsgTags(*mit3->second));
 
-	for(mit4 = mParentId.begin();  mit4 != mParentId.end(); ++mit4)
-        itemList.push_back(new RsMsgParentId(*mit4->second));
+	if(saveMsgs)
+		for(mit4 = mParentId.begin();  mit4 != mParentId.end(); ++mit4)
+			itemList.push_back(new RsMsgParentId(*mit4->second));
 
     RsMsgGRouterMap *grmap = new RsMsgGRouterMap ;
     grmap->ongoing_msgs = _ongoing_messages ;
@@ -510,6 +532,98 @@ void p3MsgService::saveDone()
 	mMsgMtx.unlock();
 }
 
+void p3MsgService::locked_storeMsg(RsMsgItem *msg, bool outgoing)
+{
+	if(!mStore->isOpen())
+	{
+		IndicateConfigChanged(RsConfigMgr::CheckPriority::SAVE_NOW); /**** INDICATE MSG CONFIG CHANGED! *****/
+		return;
+	}
+
+	MsgStore::Entry e;
+	e.msg = msg;
+	e.outgoing = outgoing;
+
+	std::map<uint32_t, RsMsgSrcId*>::const_iterator srcIt = mSrcIds.find(msg->msgId);
+	if(srcIt != mSrcIds.end())
+		e.srcId = srcIt->second->srcId;
+
+	std::map<uint32_t, RsMsgParentId*>::const_iterator parentIt = mParentId.find(msg->msgId);
+	if(parentIt != mParentId.end())
+		e.parentId = parentIt->second->msgParentId;
+
+	if(!mStore->storeMsgs(std::list<MsgStore::Entry>(1, e)))
+	{
+		RsErr() << __PRETTY_FUNCTION__ << " cannot store message " << msg->msgId << std::endl;
+		return;
+	}
+
+	// Outgoing messages still have to be sent. Other bodies are read from the
+	// store when the message is opened.
+
+	if(!outgoing)
+		std::string().swap(msg->message);
+}
+
+void p3MsgService::locked_storeMsgFlags(const RsMsgItem *msg)
+{
+	if(!mStore->isOpen())
+	{
+		IndicateConfigChanged(RsConfigMgr::CheckPriority::SAVE_NOW); /**** INDICATE MSG CONFIG CHANGED! *****/
+		return;
+	}
+
+	mStore->updateFlags(msg->msgId, msg->msgFlags);
+}
+
+void p3MsgService::locked_removeStoredMsg(uint32_t msgId)
+{
+	if(!mStore->isOpen())
+	{
+		IndicateConfigChanged(RsConfigMgr::CheckPriority::SAVE_NOW); /**** INDICATE MSG CONFIG CHANGED! *****/
+		return;
+	}
+
+	mStore->removeMsg(msgId);
+}
+
+void p3MsgService::locked_loadStoredMsgs()
+{
+	std::list<MsgStore::Entry> entries;
+
+	if(!mStore->loadMsgs(entries))
+		return;
+
+	for(std::list<MsgStore::Entry>::const_iterator it(entries.begin());it!=entries.end();++it)
+	{
+		RsMsgItem *msg = it->msg;
+
+		if(it->outgoing)
+			msgOutgoing[msg->msgId] = msg;
+		else
+			imsg[msg->msgId] = msg;
+
+		if(!it->srcId.isNull())
+		{
+			RsMsgSrcId* msi = new RsMsgSrcId();
+			msi->msgId = msg->msgId;
+			msi->srcId = it->srcId;
+			mSrcIds[msi->msgId] = msi;
+		}
+
+		if(it->parentId)
+		{
+			RsMsgParentId* msp = new RsMsgParentId();
+			msp->msgId = msg->msgId;
+			msp->msgParentId = it->parentId;
+			mParentId[msp->msgId] = msp;
+		}
+
+		if(msg->msgId >= mMsgUniqueId)
+			mMsgUniqueId = msg->msgId + 1;
+	}
+}
+
 RsSerialiser* p3MsgService::setupSerialiser()	// this serialiser is used for config. So it adds somemore info in the serialised items
 {
 	RsSerialiser *rss = new RsSerialiser ;
@@ -589,10 +703,25 @@ bool p3MsgService::loadList(std::list<RsItem*>& load)
     std::map<uint32_t, RsPeerId>::iterator srcIt;
 
     uint32_t max_msg_id = 0 ;
-    
+
+    // When messages were loaded from mStore, the ones of the config file are
+    // left overs of a time the store could not be opened, and are dropped.
+
+    bool msgsInStore = false;
+    {
+        RS_STACK_MUTEX(mMsgMtx);
+        msgsInStore = !imsg.empty() || !msgOutgoing.empty();
+    }
+
     // load items and calculate next unique msgId
 	for(it = load.begin(); it != load.end(); ++it)
     {
+		if(msgsInStore && ( dynamic_cast<RsMsgItem*>(*it) || dynamic_cast<RsMsgSrcId*>(*it) || dynamic_cast<RsMsgParentId*>(*it) ))
+		{
+			delete *it;
+			continue;
+		}
+
 		if (NULL != (mitem = dynamic_cast<RsMsgItem *>(*it)))
 	    {
 		    /* STORE MsgID */
@@ -691,7 +820,8 @@ bool p3MsgService::loadList(std::list<RsItem*>& load)
 		    continue ;
 	    }
     }
-    mMsgUniqueId = max_msg_id + 1;	// make it unique with respect to what was loaded. Not totally safe, but works 99.9999% of the cases.
+    // make it unique with respect to what was loaded. Not totally safe, but works 99.9999% of the cases.
+    mMsgUniqueId = std::max(mMsgUniqueId, max_msg_id + 1);
     load.clear() ;
 
     // sort items into lists
@@ -756,6 +886,40 @@ bool p3MsgService::loadList(std::list<RsItem*>& load)
 	    ++mit;
     }
 
+    /* move messages of older config files to mStore */
+    if(!items.empty() && mStore->isOpen())
+    {
+	    std::list<MsgStore::Entry> entries;
+
+	    for (msgIt = items.begin(); msgIt != items.end(); ++msgIt)
+	    {
+		    MsgStore::Entry e;
+		    e.msg = *msgIt;
+		    e.outgoing = msgOutgoing.find((*msgIt)->msgId) != msgOutgoing.end();
+
+		    std::map<uint32_t, RsMsgSrcId*>::const_iterator sit = mSrcIds.find(e.msg->msgId);
+		    if(sit != mSrcIds.end())
+			    e.srcId = sit->second->srcId;
+
+		    std::map<uint32_t, RsMsgParentId*>::const_iterator pit = mParentId.find(e.msg->msgId);
+		    if(pit != mParentId.end())
+			    e.parentId = pit->second->msgParentId;
+
+		    entries.push_back(e);
+	    }
+
+	    if(mStore->storeMsgs(entries))
+	    {
+		    for(std::list<MsgStore::Entry>::const_iterator eit(entries.begin());eit!=entries.end();++eit)
+			    if(!eit->outgoing)
+				    std::string().swap(eit->msg->message);
+
+		    IndicateConfigChanged(RsConfigMgr::CheckPriority::SAVE_NOW); // rewrite config without messages
+	    }
+	    else
+		    RsErr() << __PRETTY_FUNCTION__ << " cannot move " << entries.size() << " messages to the message database" << std::endl;
+    }
+
     return true;
 }
 
@@ -783,7 +947,7 @@ void p3MsgService::loadWelcomeMsg()
 
 	imsg[msg->msgId] = msg;
 
-	IndicateConfigChanged(RsConfigMgr::CheckPriority::SAVE_NOW);
+	locked_storeMsg(msg, false);
 }
 
 
@@ -827,6 +991,8 @@ bool p3MsgService::getMessage(const std::string &mId, MessageInfo &msg)
 
 	RsStackMutex stack(mMsgMtx); /********** STACK LOCKED MTX ******/
 
+	bool outgoing = false;
+
 	mit = imsg.find(msgId);
 	if (mit == imsg.end())
 	{
@@ -835,11 +1001,16 @@ bool p3MsgService::getMessage(const std::string &mId, MessageInfo &msg)
 		{
 			return false;
 		}
+		outgoing = true;
 	}
 
 	/* mit valid */
 	initRsMI(mit->second, msg);
 
+	// bodies of received, sent and draft messages are only kept in mStore
+	if(!outgoing && msg.msg.empty() && mStore->isOpen())
+		mStore->getBody(msgId, msg.msg);
+
 	std::map<uint32_t, RsMsgSrcId*>::const_iterator it = mSrcIds.find(msgId) ;
 	if(it != mSrcIds.end())
 		msg.rsgxsid_srcId = RsGxsId(it->second->srcId) ;	// (cyril) this is a hack. Not good. I'm not removing it because it may have consequences, but I dont like this.
@@ -935,11 +1106,12 @@ bool    p3MsgService::removeMsgId(const std::string &mid)
 			mSrcIds.erase(srcIt);
 			pEvent->mChangedMsgIds.insert(mid);
 		}
+
+		if(changed)
+			locked_removeStoredMsg(msgId);
 	}
 
 	if(changed) {
-		IndicateConfigChanged(RsConfigMgr::CheckPriority::SAVE_NOW); /**** INDICATE MSG CONFIG CHANGED! *****/
-
 		setMessageTag(mid, 0, false);
 		setMsgParentId(msgId, 0);
 	}
@@ -977,7 +1149,7 @@ bool    p3MsgService::markMsgIdRead(const std::string &mid, bool unreadByUser)
 
 			if (mi->msgFlags != msgFlags)
 			{
-				IndicateConfigChanged(RsConfigMgr::CheckPriority::SAVE_NOW); /**** INDICATE MSG CONFIG CHANGED! *****/
+				locked_storeMsgFlags(mi);
 
 				auto pEvent = std::make_shared<RsMailStatusEvent>();
 				pEvent->mMailStatusEventCode = RsMailStatusEventCode::MESSAGE_CHANGED;
@@ -1016,7 +1188,7 @@ bool    p3MsgService::setMsgFlag(const std::string &mid, uint32_t flag, uint32_t
 		mit->second->msgFlags |= flag;
 
 		if (mit->second->msgFlags != oldFlag) {
-			IndicateConfigChanged(RsConfigMgr::CheckPriority::SAVE_NOW); /**** INDICATE MSG CONFIG CHANGED! *****/
+			locked_storeMsgFlags(mit->second);
 
 			auto pEvent = std::make_shared<RsMailStatusEvent>();
 			pEvent->mMailStatusEventCode = RsMailStatusEventCode::MESSAGE_CHANGED;
@@ -1077,11 +1249,14 @@ bool    p3MsgService::setMsgParentId(uint32_t msgId, uint32_t msgParentId)
 				changed = true;
 			}
 		}
-	} /* UNLOCKED */
 
-	if (changed) {
-		IndicateConfigChanged(RsConfigMgr::CheckPriority::SAVE_NOW); /**** INDICATE MSG CONFIG CHANGED! *****/
-	}
+		if (changed) {
+			if (mStore->isOpen())
+				mStore->updateParentId(msgId, msgParentId);
+			else
+				IndicateConfigChanged(RsConfigMgr::CheckPriority::SAVE_NOW); /**** INDICATE MSG CONFIG CHANGED! *****/
+		}
+	} /* UNLOCKED */
 
 	return true;
 }
@@ -1116,9 +1291,9 @@ uint32_t p3MsgService::sendMessage(RsMsgItem* item)
 		    msi->srcId = mServiceCtrl->getOwnId();	
 		    mSrcIds.insert(std::pair<uint32_t, RsMsgSrcId*>(msi->msgId, msi));
 	    }
-    }
 
-    IndicateConfigChanged(RsConfigMgr::CheckPriority::SAVE_NOW); /**** INDICATE MSG CONFIG CHANGED! *****/
+	    locked_storeMsg(item, true);
+    }
 
 	auto pEvent = std::make_shared<RsMailStatusEvent>();
 	pEvent->mMailStatusEventCode = RsMailStatusEventCode::MESSAGE_SENT;
@@ -1157,9 +1332,9 @@ uint32_t p3MsgService::sendDistantMessage(RsMsgItem *item, const RsGxsId& from)
 			msi->srcId = RsPeerId(from);
 			mSrcIds.insert(std::pair<uint32_t, RsMsgSrcId*>(msi->msgId, msi));
 		}
-	}
 
-	IndicateConfigChanged(RsConfigMgr::CheckPriority::SAVE_NOW); /**** INDICATE MSG CONFIG CHANGED! *****/
+		locked_storeMsg(item, true);
+	}
 
 	auto pEvent = std::make_shared<RsMailStatusEvent>();
 	pEvent->mMailStatusEventCode = RsMailStatusEventCode::MESSAGE_SENT;
@@ -1194,11 +1369,14 @@ bool 	p3MsgService::MessageSend(MessageInfo &info)
 
 		msg->msgFlags |= RS_MSG_OUTGOING;
 
-		imsg[msg->msgId] = msg;
-
 		// Update info for caller
 		info.msgId = std::to_string(msg->msgId);
 		info .msgflags = msg->msgFlags;
+
+		RS_STACK_MUTEX(mMsgMtx);
+
+		imsg[msg->msgId] = msg;
+		locked_storeMsg(msg, false);
 	}
 
     auto pEvent = std::make_shared<RsMailStatusEvent>();
@@ -1399,12 +1577,12 @@ bool p3MsgService::MessageToDraft(MessageInfo &info, const std::string &msgParen
 
             // return new message id
             rs_sprintf(info.msgId, "%lu", msg->msgId);
+
+            locked_storeMsg(msg, false);
         }
 
         setMsgParentId(msg->msgId, atoi(msgParentId.c_str()));
 
-        IndicateConfigChanged(RsConfigMgr::CheckPriority::SAVE_NOW); /**** INDICATE MSG CONFIG CHANGED! *****/
-
     auto pEvent = std::make_shared<RsMailStatusEvent>();
     pEvent->mMailStatusEventCode = RsMailStatusEventCode::MESSAGE_SENT;
     pEvent->mChangedMsgIds.insert(std::to_string(msg->msgId));
@@ -1722,12 +1900,13 @@ bool p3MsgService::MessageToTrash(const std::string &mid, bool bTrash)
                     pEvent->mChangedMsgIds.insert(std::to_string(mi->msgId));
                 }
             }
+
+            if (!pEvent->mChangedMsgIds.empty())
+                locked_storeMsgFlags(mi);
         }
     }
 
     if (!pEvent->mChangedMsgIds.empty()) {
-        IndicateConfigChanged(RsConfigMgr::CheckPriority::SAVE_NOW); /**** INDICATE MSG CONFIG CHANGED! *****/
-
         checkOutgoingMessages();
 
         if(rsEvents) {
@@ -2075,6 +2254,7 @@ void p3MsgService::notifyDataStatus( const GRouterMsgPropagationId& id,
 
 			// clear the routed flag so that the message is requested again
 			mit->second->msgFlags &= ~RS_MSG_FLAGS_ROUTED;
+			locked_storeMsgFlags(mit->second);
 		}
 
 		return;
@@ -2114,9 +2294,9 @@ void p3MsgService::notifyDataStatus( const GRouterMsgPropagationId& id,
 		it2->second->msgFlags &= ~RS_MSG_FLAGS_PENDING;
 		imsg[msg_id] = it2->second;
 		msgOutgoing.erase(it2);
-#endif
 
-		IndicateConfigChanged(RsConfigMgr::CheckPriority::SAVE_NOW);
+		locked_storeMsg(imsg[msg_id], false);
+#endif
 
 		if(rsEvents)
 		{
@@ -2265,12 +2445,12 @@ bool p3MsgService::notifyGxsTransSendStatus( RsGxsTransId mailId,
 				it2->second->msgFlags &= ~RS_MSG_FLAGS_PENDING;
 				imsg[msg_id] = it2->second;
 				msgOutgoing.erase(it2);
+
+				locked_storeMsg(imsg[msg_id], false);
 #endif
 				pEvent->mChangedMsgIds.insert(std::to_string(msg_id));
 			}
 		}
-
-		IndicateConfigChanged(RsConfigMgr::CheckPriority::SAVE_NOW);
 	}
 	else if( status >= GxsTransSendStatus::FAILED_RECEIPT_SIGNATURE )
 	{
@@ -2312,6 +2492,7 @@ bool p3MsgService::notifyGxsTransSendStatus( RsGxsTransId mailId,
 				          << "requested again" << std::endl;
 				// clear the routed flag so that the message is requested again
 				mit->second->msgFlags &= ~RS_MSG_FLAGS_ROUTED;
+				locked_storeMsgFlags(mit->second);
 
 				pEvent->mChangedMsgIds.insert(std::to_string(msg_id));
 			}
@@ -48,6 +48,7 @@
 
 class p3LinkMgr;
 class p3IdService;
+class MsgStore;
 
 // Temp tweak to test grouter
 class p3MsgService :
@@ -55,7 +56,8 @@ class p3MsgService :
         GxsTransClient
 {
 public:
-	p3MsgService(p3ServiceControl *sc, p3IdService *id_service, p3GxsTrans& gxsMS);
+	p3MsgService( p3ServiceControl *sc, p3IdService *id_service, p3GxsTrans& gxsMS,
+	              const std::string& dbPath, const std::string& key );
     virtual ~p3MsgService();
 
 	virtual RsServiceInfo getServiceInfo();
@@ -200,6 +202,15 @@ private:
 
     void    initStandardTagTypes();
 
+    /* Messages are saved one by one in mStore. Bodies of the messages in imsg
+     * are only kept there, and are read when the message is opened. When the
+     * store cannot be opened, these fall back to saving the whole config. */
+
+    void    locked_storeMsg(RsMsgItem *msg, bool outgoing);
+    void    locked_storeMsgFlags(const RsMsgItem *msg);
+    void    locked_removeStoredMsg(uint32_t msgId);
+    void    locked_loadStoredMsgs();
+
     p3IdService *mIdService ;
     p3ServiceControl *mServiceCtrl;
     p3GRouter *mGRouter ;
@@ -234,6 +245,8 @@ private:
     // save the parent of the messages in draft for replied and forwarded
     std::map<uint32_t, RsMsgParentId*> mParentId;
 
+    MsgStore *mStore;
+
     std::string config_dir;
 
     bool mDistantMessagingEnabled ;
@@ -24,6 +24,7 @@
 
 #include <string>
 #include <thread>
+#include <utility>
 
 #include "services/rseventsservice.h"
 
@@ -32,6 +33,7 @@
 
 RsEvent::~RsEvent() = default;
 RsEvents::~RsEvents() = default;
+RsEventsHandlerStatistic::~RsEventsHandlerStatistic() = default;
 
 /*static*/ const RsEventsErrorCategory RsEventsErrorCategory::instance;
 
@@ -50,6 +52,74 @@ const noexcept
 	}
 }
 
+struct RsEventsService::Handler
+{
+	Handler( RsEventsHandlerId_t id, RsEventType eventType,
+	         const std::function<void(std::shared_ptr<const RsEvent>)>& cb ) :
+	    mCallback(cb), mNextSeq(0), mScheduled(false), mRunning(false),
+	    mRemoved(false)
+	{
+		mStats.mHandlerId = id;
+		mStats.mEventType = eventType;
+	}
+
+	struct QueuedEvent
+	{
+		std::shared_ptr<const RsEvent> mEvent;
+		std::string mKey; /// @see RsEvent::coalescingKey
+		std::chrono::steady_clock::time_point mQueuedAt;
+		uint64_t mSeq;
+	};
+
+	QueuedEvent popFront_locked()
+	{
+		QueuedEvent qe = std::move(mQueue.front());
+		mQueue.pop_front();
+		if(!qe.mKey.empty())
+			mCoalescable.erase(std::make_pair(qe.mEvent->mType, qe.mKey));
+		mStats.mQueueDepth = static_cast<uint32_t>(mQueue.size());
+		return qe;
+	}
+
+	const std::function<void(std::shared_ptr<const RsEvent>)> mCallback;
+
+	std::mutex mMtx;
+	std::condition_variable mIdleCv; /// notified when a call is over
+
+	/* Sequence numbers of queued events are contiguous, so the position of an
+	 * event in the queue is its sequence number minus the front one */
+	std::deque<QueuedEvent> mQueue;
+	uint64_t mNextSeq;
+
+	/// Sequence number of the queued events which can be coalesced, by key
+	std::map<std::pair<RsEventType, std::string>, uint64_t> mCoalescable;
+
+	bool mScheduled; /// in mReadyHandlers or held by a dispatch thread
+	bool mRunning;   /// being called on mRunningThread
+	std::thread::id mRunningThread;
+	bool mRemoved;
+
+	RsEventsHandlerStatistic mStats;
+};
+
+class RsEventsService::DispatchThread: public RsThread
+{
+public:
+	explicit DispatchThread(RsEventsService& service) : mService(service) {}
+
+protected:
+	void run() override { mService.dispatchLoop(); }
+
+private:
+	RsEventsService& mService;
+};
+
+RsEventsService::RsEventsService() :
+    mHandlerMapMtx("RsEventsService::mHandlerMapMtx"), mLastHandlerId(1),
+    mDispatchStopped(false) {}
+
+RsEventsService::~RsEventsService() { stopDispatchThreads(true); }
+
 std::error_condition RsEventsService::isEventTypeInvalid(RsEventType eventType)
 {
 	if(eventType == RsEventType::__NONE)
@@ -74,8 +144,11 @@ std::error_condition RsEventsService::postEvent(
 {
 	if(std::error_condition ec = isEventInvalid(event)) return ec;
 
-	RS_STACK_MUTEX(mEventQueueMtx);
-	mEventQueue.push_back(event);
+	{
+		std::lock_guard<std::mutex> lock(mEventQueueMtx);
+		mEventQueue.push_back(event);
+	}
+	mEventQueueCv.notify_one();
 	return std::error_condition();
 }
 
@@ -103,72 +176,149 @@ std::error_condition RsEventsService::registerEventsHandler(
         std::function<void(std::shared_ptr<const RsEvent>)> multiCallback,
         RsEventsHandlerId_t& hId, RsEventType eventType )
 {
-	RS_STACK_MUTEX(mHandlerMapMtx);
+	HandlerPtr replaced;
 
-	if(eventType != RsEventType::__NONE)
-		if(std::error_condition ec = isEventTypeInvalid(eventType))
-			return ec;
+	{
+		RS_STACK_MUTEX(mHandlerMapMtx);
+
+		if(eventType != RsEventType::__NONE)
+			if(std::error_condition ec = isEventTypeInvalid(eventType))
+				return ec;
+
+		if(!hId) hId = generateUniqueHandlerId_unlocked();
+		else if (hId > mLastHandlerId)
+		{
+			print_stacktrace();
+			return RsEventsErrorNum::INVALID_HANDLER_ID;
+		}
+
+		HandlerPtr& handler = mHandlerMaps[static_cast<std::size_t>(eventType)][hId];
+		replaced = std::move(handler);
+		handler = std::make_shared<Handler>(hId, eventType, multiCallback);
+	}
 
-	if(!hId) hId = generateUniqueHandlerId_unlocked();
-	else if (hId > mLastHandlerId)
+	/* Events queued for the replaced callback are dropped */
+	if(replaced)
 	{
-		print_stacktrace();
-		return RsEventsErrorNum::INVALID_HANDLER_ID;
+		std::lock_guard<std::mutex> lock(replaced->mMtx);
+		replaced->mRemoved = true;
+		replaced->mQueue.clear();
+		replaced->mCoalescable.clear();
 	}
 
-	mHandlerMaps[static_cast<std::size_t>(eventType)][hId] = multiCallback;
 	return std::error_condition();
 }
 
 std::error_condition RsEventsService::unregisterEventsHandler(
         RsEventsHandlerId_t hId )
 {
-	RS_STACK_MUTEX(mHandlerMapMtx);
+	HandlerPtr handler;
 
-	for(uint32_t i=0; i<mHandlerMaps.size(); ++i)
 	{
-		auto it = mHandlerMaps[i].find(hId);
-		if(it != mHandlerMaps[i].end())
+		RS_STACK_MUTEX(mHandlerMapMtx);
+
+		for(uint32_t i=0; i<mHandlerMaps.size() && !handler; ++i)
 		{
-			mHandlerMaps[i].erase(it);
-			return std::error_condition();
+			auto it = mHandlerMaps[i].find(hId);
+			if(it != mHandlerMaps[i].end())
+			{
+				handler = std::move(it->second);
+				mHandlerMaps[i].erase(it);
+			}
 		}
 	}
-	return RsEventsErrorNum::INVALID_HANDLER_ID;
+
+	if(!handler) return RsEventsErrorNum::INVALID_HANDLER_ID;
+
+	std::unique_lock<std::mutex> lock(handler->mMtx);
+	handler->mRemoved = true;
+	handler->mQueue.clear();
+	handler->mCoalescable.clear();
+	handler->mIdleCv.notify_all();
+
+	/* Once this returns the callback must not be running anymore, so the
+	 * caller can safely destroy whatever it captured. When called from the
+	 * callback itself waiting would deadlock, but it is not called again. */
+	if(!handler->mRunning ||
+	        handler->mRunningThread != std::this_thread::get_id())
+		handler->mIdleCv.wait(lock, [&]() { return !handler->mRunning; });
+
+	return std::error_condition();
+}
+
+std::error_condition RsEventsService::getEventsHandlersStatistics(
+        std::vector<RsEventsHandlerStatistic>& stats )
+{
+	std::vector<HandlerPtr> handlers;
+
+	{
+		RS_STACK_MUTEX(mHandlerMapMtx);
+		for(auto& handlerMap: mHandlerMaps)
+			for(auto& hit: handlerMap) handlers.push_back(hit.second);
+	}
+
+	stats.clear();
+	for(const HandlerPtr& handler: handlers)
+	{
+		std::lock_guard<std::mutex> lock(handler->mMtx);
+		stats.push_back(handler->mStats);
+	}
+
+	return std::error_condition();
 }
 
 void RsEventsService::threadTick()
 {
+	startDispatchThreads();
+
 	auto nextRunAt = std::chrono::system_clock::now() +
 	        std::chrono::milliseconds(200);
 
-	std::shared_ptr<const RsEvent> eventPtr(nullptr);
-	size_t futureEventsCounter = 0;
+	std::deque< std::shared_ptr<const RsEvent> > dueEvents;
 
-dispatchEventFromQueueLock:
-	mEventQueueMtx.lock();
-	if(mEventQueue.size() > futureEventsCounter)
 	{
-		eventPtr = mEventQueue.front();
-		mEventQueue.pop_front();
-
-		if(eventPtr->mTimePoint >= nextRunAt)
-		{
-			mEventQueue.push_back(eventPtr);
-			++futureEventsCounter;
-		}
+		std::unique_lock<std::mutex> lock(mEventQueueMtx);
+
+		/* Events with a time point in the future stay in the queue */
+		std::deque< std::shared_ptr<const RsEvent> > queue;
+		queue.swap(mEventQueue);
+		for(auto& event: queue)
+			if(event->mTimePoint >= nextRunAt)
+				mEventQueue.push_back(std::move(event));
+			else dueEvents.push_back(std::move(event));
+
+		const std::size_t futureEvents = mEventQueue.size();
+		if(dueEvents.empty())
+			mEventQueueCv.wait_until(lock, nextRunAt, [&]()
+			{ return mEventQueue.size() > futureEvents || shouldStop(); });
 	}
-	mEventQueueMtx.unlock();
 
-	if(eventPtr)
-	{
-		/* It is relevant that this stays out of mEventQueueMtx */
-		handleEvent(eventPtr);
-		eventPtr = nullptr; // ensure refcounter is decremented before sleep
-		goto dispatchEventFromQueueLock;
-	}
+	/* It is relevant that this stays out of mEventQueueMtx */
+	for(auto& event: dueEvents) dispatchEvent(event);
+}
+
+void RsEventsService::onStopRequested()
+{
+	{ std::lock_guard<std::mutex> lock(mEventQueueMtx); }
+	mEventQueueCv.notify_all();
+
+	stopDispatchThreads(false);
+	RsTickingThread::onStopRequested();
+}
+
+void RsEventsService::getHandlers(
+        std::shared_ptr<const RsEvent> event, std::vector<HandlerPtr>& handlers )
+{
+	RS_STACK_MUTEX(mHandlerMapMtx);
 
-	std::this_thread::sleep_until(nextRunAt);
+	// All clients that registered a callback for this event type
+	for(auto& hit: mHandlerMaps[static_cast<uint32_t>(event->mType)])
+		handlers.push_back(hit.second);
+
+	/* Also all clients that registered with NONE, meaning that they expect
+	 * all events */
+	for(auto& hit: mHandlerMaps[static_cast<uint32_t>(RsEventType::__NONE)])
+		handlers.push_back(hit.second);
 }
 
 void RsEventsService::handleEvent(std::shared_ptr<const RsEvent> event)
@@ -180,18 +330,194 @@ void RsEventsService::handleEvent(std::shared_ptr<const RsEvent> event)
 		return;
 	}
 
-	RS_STACK_MUTEX(mHandlerMapMtx);
-	/* It is important to also call the callback under mutex protection to
-	 * ensure they are not unregistered in the meanwhile.
-	 * If a callback try to fiddle with registering/unregistering it will
-	 * deadlock */
-
-	// Call all clients that registered a callback for this event type
-	for(auto cbit: mHandlerMaps[static_cast<uint32_t>(event->mType)])
-		cbit.second(event);
-
-	/* Also call all clients that registered with NONE, meaning that they
-	 * expect all events */
-	for(auto cbit: mHandlerMaps[static_cast<uint32_t>(RsEventType::__NONE)])
-		cbit.second(event);
+	std::vector<HandlerPtr> handlers;
+	getHandlers(event, handlers);
+
+	const auto now = std::chrono::steady_clock::now();
+	for(const HandlerPtr& handler: handlers) callHandler(*handler, event, now);
+}
+
+void RsEventsService::dispatchEvent(std::shared_ptr<const RsEvent> event)
+{
+	std::vector<HandlerPtr> handlers;
+	getHandlers(event, handlers);
+	if(handlers.empty()) return;
+
+	const std::string key = event->coalescingKey();
+	const auto coalescingId = std::make_pair(event->mType, key);
+	const auto now = std::chrono::steady_clock::now();
+
+	for(const HandlerPtr& handler: handlers)
+	{
+		Handler& h(*handler);
+		bool schedule = false;
+
+		{
+			std::lock_guard<std::mutex> lock(h.mMtx);
+			if(h.mRemoved) continue;
+
+			/* An equivalent event is still waiting, take its place */
+			auto cit = key.empty() ?
+			            h.mCoalescable.end() : h.mCoalescable.find(coalescingId);
+			if(cit != h.mCoalescable.end())
+			{
+				h.mQueue[cit->second - h.mQueue.front().mSeq].mEvent = event;
+				++h.mStats.mCoalescedEvents;
+				continue;
+			}
+
+			if(h.mQueue.size() >= MAX_HANDLER_QUEUE)
+			{
+				h.popFront_locked();
+				if(!h.mStats.mDroppedEvents++)
+					RS_WARN( "handler: ", h.mStats.mHandlerId,
+					         " is too slow, dropping its oldest events" );
+			}
+
+			h.mQueue.push_back({event, key, now, h.mNextSeq});
+			if(!key.empty()) h.mCoalescable[coalescingId] = h.mNextSeq;
+			++h.mNextSeq;
+
+			h.mStats.mQueueDepth = static_cast<uint32_t>(h.mQueue.size());
+			if(h.mStats.mQueueDepth > h.mStats.mMaxQueueDepth)
+				h.mStats.mMaxQueueDepth = h.mStats.mQueueDepth;
+
+			if(!h.mScheduled) schedule = h.mScheduled = true;
+		}
+
+		if(schedule)
+		{
+			{
+				std::lock_guard<std::mutex> lock(mDispatchMtx);
+				mReadyHandlers.push_back(handler);
+			}
+			mDispatchCv.notify_one();
+		}
+	}
+}
+
+void RsEventsService::callHandler(
+        Handler& h, const std::shared_ptr<const RsEvent>& event,
+        std::chrono::steady_clock::time_point queuedAt )
+{
+	const std::thread::id self = std::this_thread::get_id();
+	bool nested;
+
+	{
+		std::unique_lock<std::mutex> lock(h.mMtx);
+
+		/* A callback is never called concurrently with itself, but may send
+		 * an event it handles to itself */
+		nested = h.mRunning && h.mRunningThread == self;
+		if(!nested)
+			h.mIdleCv.wait(lock, [&]() { return !h.mRunning || h.mRemoved; });
+
+		if(h.mRemoved) return;
+		h.mRunning = true;
+		h.mRunningThread = self;
+	}
+
+	const auto start = std::chrono::steady_clock::now();
+	h.mCallback(event);
+	const auto end = std::chrono::steady_clock::now();
+
+	{
+		std::lock_guard<std::mutex> lock(h.mMtx);
+		if(!nested) h.mRunning = false;
+
+		using std::chrono::duration_cast;
+		using std::chrono::microseconds;
+		const uint64_t latency = static_cast<uint64_t>(
+		            duration_cast<microseconds>(start - queuedAt).count() );
+		const uint64_t runTime = static_cast<uint64_t>(
+		            duration_cast<microseconds>(end - start).count() );
+
+		++h.mStats.mHandledEvents;
+		h.mStats.mTotalLatencyUs += latency;
+		if(latency > h.mStats.mMaxLatencyUs) h.mStats.mMaxLatencyUs = latency;
+		h.mStats.mTotalRunTimeUs += runTime;
+		if(runTime > h.mStats.mMaxRunTimeUs) h.mStats.mMaxRunTimeUs = runTime;
+	}
+
+	if(!nested) h.mIdleCv.notify_all();
+}
+
+void RsEventsService::dispatchLoop()
+{
+	while(true)
+	{
+		HandlerPtr handler;
+
+		{
+			std::unique_lock<std::mutex> lock(mDispatchMtx);
+			mDispatchCv.wait(lock, [&]()
+			{ return mDispatchStopped || !mReadyHandlers.empty(); });
+
+			if(mDispatchStopped) return;
+			handler = std::move(mReadyHandlers.front());
+			mReadyHandlers.pop_front();
+		}
+
+		/* Handle a batch of events, then give the other handlers a chance */
+		for(uint32_t i = 0; i < DISPATCH_BATCH; ++i)
+		{
+			Handler::QueuedEvent qe;
+
+			{
+				std::lock_guard<std::mutex> lock(handler->mMtx);
+				if(handler->mRemoved || handler->mQueue.empty()) break;
+				qe = handler->popFront_locked();
+			}
+
+			callHandler(*handler, qe.mEvent, qe.mQueuedAt);
+		}
+
+		bool more;
+		{
+			std::lock_guard<std::mutex> lock(handler->mMtx);
+			more = !handler->mRemoved && !handler->mQueue.empty();
+			handler->mScheduled = more;
+		}
+
+		if(more)
+		{
+			{
+				std::lock_guard<std::mutex> lock(mDispatchMtx);
+				mReadyHandlers.push_back(std::move(handler));
+			}
+			mDispatchCv.notify_one();
+		}
+	}
+}
+
+void RsEventsService::startDispatchThreads()
+{
+	std::lock_guard<std::mutex> lock(mDispatchMtx);
+	if(mDispatchStopped || !mDispatchThreads.empty()) return;
+
+	for(uint32_t i = 0; i < DISPATCH_THREADS; ++i)
+	{
+		DispatchThread* thread = new DispatchThread(*this);
+		thread->start("rs events " + std::to_string(i));
+		mDispatchThreads.push_back(thread);
+	}
+}
+
+void RsEventsService::stopDispatchThreads(bool wait)
+{
+	std::vector<DispatchThread*> threads;
+
+	{
+		std::lock_guard<std::mutex> lock(mDispatchMtx);
+		mDispatchStopped = true;
+		mReadyHandlers.clear();
+		if(wait) threads.swap(mDispatchThreads);
+	}
+	mDispatchCv.notify_all();
+
+	for(DispatchThread* thread: threads)
+	{
+		thread->fullstop();
+		delete thread;
+	}
 }
@@ -26,18 +26,27 @@
 #include <cstdint>
 #include <deque>
 #include <array>
+#include <map>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
 
 #include "retroshare/rsevents.h"
 #include "util/rsthreads.h"
 #include "util/rsdebug.h"
 
+/**
+ * Posted events are fanned out to a bounded queue per handler, the queues are
+ * handled by a small pool of dispatch threads. Each handler is handled by one
+ * dispatch thread at a time so it gets its events in order, while a slow
+ * handler only delays its own queue.
+ */
 class RsEventsService :
         public RsEvents, public RsTickingThread
 {
 public:
-	RsEventsService():
-	    mHandlerMapMtx("RsEventsService::mHandlerMapMtx"), mLastHandlerId(1),
-	    mEventQueueMtx("RsEventsService::mEventQueueMtx") {}
+	RsEventsService();
+	~RsEventsService() override;
 
 	/// @see RsEvents
 	std::error_condition postEvent(
@@ -60,7 +69,23 @@ public:
 	std::error_condition unregisterEventsHandler(
 	        RsEventsHandlerId_t hId ) override;
 
+	/// @see RsEvents
+	std::error_condition getEventsHandlersStatistics(
+	        std::vector<RsEventsHandlerStatistic>& stats ) override;
+
+	/// Most events waiting in the queue of a handler, the oldest are dropped
+	static constexpr uint32_t MAX_HANDLER_QUEUE = 2048;
+
+	/// Events handled in a row before giving a dispatch thread to others
+	static constexpr uint32_t DISPATCH_BATCH = 16;
+
+	static constexpr uint32_t DISPATCH_THREADS = 4;
+
 protected:
+	struct Handler;
+	typedef std::shared_ptr<Handler> HandlerPtr;
+	class DispatchThread;
+
 	std::error_condition isEventTypeInvalid(RsEventType eventType);
 	std::error_condition isEventInvalid(std::shared_ptr<const RsEvent> event);
 
@@ -70,18 +95,44 @@ protected:
 	/** Storage for event handlers, keep 10 extra types for plugins that might
 	 * be released indipendently */
 	std::array<
-	    std::map<
-	        RsEventsHandlerId_t,
-	        std::function<void(std::shared_ptr<const RsEvent>)> >,
+	    std::map<RsEventsHandlerId_t, HandlerPtr>,
 	    static_cast<std::size_t>(RsEventType::__MAX) + 10
 	> mHandlerMaps;
 
-	RsMutex mEventQueueMtx;
+	std::mutex mEventQueueMtx;
+	std::condition_variable mEventQueueCv;
 	std::deque< std::shared_ptr<const RsEvent> > mEventQueue;
 
+	/* Handlers with queued events, waiting for a dispatch thread */
+	std::mutex mDispatchMtx;
+	std::condition_variable mDispatchCv;
+	std::deque<HandlerPtr> mReadyHandlers;
+	std::vector<DispatchThread*> mDispatchThreads;
+	bool mDispatchStopped;
+
 	void threadTick() override; /// @see RsTickingThread
+	void onStopRequested() override; /// @see RsThread
+
+	/// Get the handlers which should be called for the given event
+	void getHandlers(
+	        std::shared_ptr<const RsEvent> event,
+	        std::vector<HandlerPtr>& handlers );
 
+	/// Call handlers on the caller thread, @see sendEvent
 	void handleEvent(std::shared_ptr<const RsEvent> event);
+
+	/// Queue the event to each handler, @see postEvent
+	void dispatchEvent(std::shared_ptr<const RsEvent> event);
+
+	/// Call the handler unless it has been unregistered meanwhile
+	void callHandler(
+	        Handler& handler, const std::shared_ptr<const RsEvent>& event,
+	        std::chrono::steady_clock::time_point queuedAt );
+
+	void dispatchLoop();
+	void startDispatchThreads();
+	void stopDispatchThreads(bool wait);
+
 	RsEventsHandlerId_t generateUniqueHandlerId_unlocked();
 
 	RS_SET_CONTEXT_DEBUG_LEVEL(3)
@@ -87,6 +87,8 @@ static const rstime_t EMPTY_TUNNELS_DIGGING_TIME               =  50 ; /// look
 static const rstime_t TUNNEL_SPEED_ESTIMATE_LAPSE              =   5 ; /// estimate tunnel speed every 5 seconds
 static const rstime_t TUNNEL_CLEANING_LAPS_TIME                =  10 ; /// clean tunnels every 10 secs
 static const rstime_t TIME_BETWEEN_TUNNEL_MANAGEMENT_CALLS     =   2 ; /// Tunnel management calls every 2 secs.
+static const rstime_t TUNNEL_REQUEST_FILTER_CHECK_TIME         =   5 ; /// rebuild missing/invalidated tunnel request filters every 5 secs.
+static const rstime_t TUNNEL_REQUEST_FILTER_REBUILD_TIME       =  60 ; /// rebuild all tunnel request filters every minute.
 static const uint32_t MAX_TUNNEL_REQS_PER_SECOND               =   1 ; /// maximum number of tunnel requests issued per second. Was 0.5 before
 static const uint32_t MAX_ALLOWED_SR_IN_CACHE                  = 120 ; /// maximum number of search requests allowed in cache. That makes 2 per sec.
 static const uint32_t TURTLE_SEARCH_RESULT_MAX_HITS_FILES      =5000 ; /// maximum number of search results forwarded back to the source.
@@ -126,6 +128,11 @@ p3turtle::p3turtle(p3ServiceControl *sc,p3LinkMgr *lm)
 	_last_tunnel_management_time = 0 ;
 	_last_tunnel_campaign_time = 0 ;
 	_last_tunnel_speed_estimate_time = 0 ;
+	_last_tunnel_request_filter_update_time = 0 ;
+
+	_tr_filter_rejected = 0 ;
+	_tr_filter_passed = 0 ;
+	_tr_filter_false_positives = 0 ;
 
 	_traffic_info.reset() ;
 	_max_tr_up_rate = MAX_TR_FORWARD_PER_SEC ;
@@ -220,12 +227,13 @@ int p3turtle::tick()
 	last_now = now ;
 #endif
 
-	bool should_autowash,should_estimatespeed ;
+	bool should_autowash,should_estimatespeed,should_updatefilters ;
 	{
 		RsStackMutex stack(mTurtleMtx); /********** STACK LOCKED MTX ******/
 
 		should_autowash 			= now > TUNNEL_CLEANING_LAPS_TIME+_last_clean_time ;
 		should_estimatespeed 	= now >= TUNNEL_SPEED_ESTIMATE_LAPSE + _last_tunnel_speed_estimate_time ;
+		should_updatefilters 	= now >= TUNNEL_REQUEST_FILTER_CHECK_TIME + _last_tunnel_request_filter_update_time ;
 	}
 
 	// Tunnel management:
@@ -274,6 +282,14 @@ int p3turtle::tick()
 		_last_tunnel_speed_estimate_time = now ;
 	}
 
+	if(should_updatefilters)
+	{
+		updateTunnelRequestFilters() ;
+
+		RsStackMutex stack(mTurtleMtx); /********** STACK LOCKED MTX ******/
+		_last_tunnel_request_filter_update_time = now ;
+	}
+
 #ifdef TUNNEL_STATISTICS
 	// Dump state for debugging, every 20 sec.
 	//
@@ -332,12 +348,12 @@ void p3turtle::getSourceVirtualPeersList(const TurtleFileHash& hash,std::list<pq
 
 	list.clear() ;
 
-	std::map<TurtleFileHash,TurtleHashInfo>::const_iterator it = _incoming_file_hashes.find(hash) ;
+	TurtleHashTable::const_iterator it = _incoming_file_hashes.find(hash) ;
 
 	if(it != _incoming_file_hashes.end())
 		for(uint32_t i=0;i<it->second.tunnels.size();++i)
 		{
-			std::map<TurtleTunnelId,TurtleTunnel>::const_iterator it2 = _local_tunnels.find( it->second.tunnels[i] ) ;
+			TurtleTunnelTable::const_iterator it2 = _local_tunnels.find( it->second.tunnels[i] ) ;
 
 			if(it2 != _local_tunnels.end())
 			{
@@ -385,13 +401,18 @@ void p3turtle::manageTunnels()
 
 		// digg new tunnels if no tunnels are available and force digg new tunnels at regular (large) interval
 		//
-		for(std::map<TurtleFileHash,TurtleHashInfo>::const_iterator it(_incoming_file_hashes.begin());it!=_incoming_file_hashes.end();++it)
+		for(TurtleHashTable::const_iterator it(_incoming_file_hashes.begin());it!=_incoming_file_hashes.end();++it)
         {
 			// get total tunnel speed.
 			//
 			uint32_t total_speed = 0 ;
 			for(uint32_t i=0;i<it->second.tunnels.size();++i)
-				total_speed += _local_tunnels[it->second.tunnels[i]].speed_Bps ;
+			{
+				TurtleTunnelTable::const_iterator it2 = _local_tunnels.find(it->second.tunnels[i]) ;
+
+				if(it2 != _local_tunnels.end())
+					total_speed += it2->second.speed_Bps ;
+			}
 
 			static const float grow_speed = 1.0f ;	// speed at which the time increases.
 
@@ -430,7 +451,7 @@ void p3turtle::estimateTunnelSpeeds()
 {
 	RsStackMutex stack(mTurtleMtx) ;
 
-	for(std::map<TurtleTunnelId,TurtleTunnel>::iterator it(_local_tunnels.begin());it!=_local_tunnels.end();++it)
+	for(TurtleTunnelTable::iterator it(_local_tunnels.begin());it!=_local_tunnels.end();++it)
 	{
 		TurtleTunnel& tunnel(it->second) ;
 
@@ -455,7 +476,7 @@ void p3turtle::autoWash()
 
         for(std::set<RsFileHash>::const_iterator hit(_hashes_to_remove.begin());hit!=_hashes_to_remove.end();++hit)
 		{
-            std::map<TurtleFileHash,TurtleHashInfo>::iterator it(_incoming_file_hashes.find(*hit)) ;
+            TurtleHashTable::iterator it(_incoming_file_hashes.find(*hit)) ;
 
 			if(it == _incoming_file_hashes.end())
 			{
@@ -540,7 +561,7 @@ void p3turtle::autoWash()
 
 		std::vector<TurtleTunnelId> tunnels_to_close ;
 
-		for(std::map<TurtleTunnelId,TurtleTunnel>::iterator it(_local_tunnels.begin());it!=_local_tunnels.end();++it)
+		for(TurtleTunnelTable::iterator it(_local_tunnels.begin());it!=_local_tunnels.end();++it)
 			if(now > (rstime_t)(it->second.time_stamp + MAXIMUM_TUNNEL_IDLE_TIME))
 			{
 #ifdef P3TURTLE_DEBUG
@@ -587,7 +608,7 @@ void p3turtle::locked_closeTunnel(TurtleTunnelId tid,std::vector<std::pair<RsTur
 	// tunnel closing commands. In our case, this is not necessary, because if a tunnel is closed somewhere, its
 	// source is not going to be used and the tunnel will eventually disappear.
 	//
-	std::map<TurtleTunnelId,TurtleTunnel>::iterator it(_local_tunnels.find(tid)) ;
+	TurtleTunnelTable::iterator it(_local_tunnels.find(tid)) ;
 
 	if(it == _local_tunnels.end())
 	{
@@ -620,7 +641,7 @@ void p3turtle::locked_closeTunnel(TurtleTunnelId tid,std::vector<std::pair<RsTur
 		if(_virtual_peers.find(vpid) != _virtual_peers.end())
 			_virtual_peers.erase(_virtual_peers.find(vpid)) ;
 
-		std::map<TurtleFileHash,TurtleHashInfo>::iterator it(_incoming_file_hashes.find(hash)) ;
+		TurtleHashTable::iterator it(_incoming_file_hashes.find(hash)) ;
 
 		if(it != _incoming_file_hashes.end())
 		{
@@ -647,7 +668,7 @@ void p3turtle::locked_closeTunnel(TurtleTunnelId tid,std::vector<std::pair<RsTur
 #ifdef P3TURTLE_DEBUG
 		std::cerr << "    Tunnel is a ending point. Also removing associated outgoing hash." ;
 #endif
-        std::map<TurtleTunnelId,RsTurtleClientService*>::iterator itHash = _outgoing_tunnel_client_services.find(tid);
+        TurtleTunnelServiceTable::iterator itHash = _outgoing_tunnel_client_services.find(tid);
 
         if(itHash != _outgoing_tunnel_client_services.end())
 		{
@@ -1280,12 +1301,18 @@ void p3turtle::routeGenericTunnelItem(RsTurtleGenericTunnelItem *item)
 	item->print(std::cerr,1) ;
 #endif
 
+	// Sized before locking, so that the mutex is only held for the table
+	// lookup and the tunnel accounting. Forwarded items are sent off-mutex.
+
+	uint32_t item_size = RsTurtleSerialiser().size(item) ;
+	bool forward = false ;
+
 	{
 		RsStackMutex stack(mTurtleMtx); /********** STACK LOCKED MTX ******/
 
 		// look for the tunnel id.
 		//
-		std::map<TurtleTunnelId,TurtleTunnel>::iterator it(_local_tunnels.find(item->tunnelId())) ;
+		TurtleTunnelTable::iterator it(_local_tunnels.find(item->tunnelId())) ;
 
 		if(it == _local_tunnels.end())
 		{
@@ -1302,7 +1329,7 @@ void p3turtle::routeGenericTunnelItem(RsTurtleGenericTunnelItem *item)
 		if(item->shouldStampTunnel())
 			tunnel.time_stamp = time(NULL) ;
 
-		tunnel.transfered_bytes += RsTurtleSerialiser().size(item);
+		tunnel.transfered_bytes += item_size ;
 
 		if(item->PeerId() == tunnel.local_dst)
 			item->setTravelingDirection(RsTurtleGenericTunnelItem::DIRECTION_CLIENT) ;
@@ -1328,35 +1355,36 @@ void p3turtle::routeGenericTunnelItem(RsTurtleGenericTunnelItem *item)
 #endif
 			item->PeerId(tunnel.local_src) ;
 
-			_traffic_info_buffer.unknown_updn_Bps += RsTurtleSerialiser().size(item) ;
+			_traffic_info_buffer.unknown_updn_Bps += item_size ;
 
 			// This has been disabled for compilation reasons. Not sure we actually need it.
 			//
 			//if(dynamic_cast<RsTurtleFileDataItem*>(item) != NULL)
 			//	item->setPriorityLevel(QOS_PRIORITY_RS_TURTLE_FORWARD_FILE_DATA) ;
 
-			sendItem(item) ;
-			return ;
+			forward = true ;
 		}
-
-		if(item->PeerId() == tunnel.local_src && tunnel.local_dst != _own_id) //direction == RsTurtleGenericTunnelItem::DIRECTION_SERVER &&
+		else if(item->PeerId() == tunnel.local_src && tunnel.local_dst != _own_id) //direction == RsTurtleGenericTunnelItem::DIRECTION_SERVER &&
 		{
 #ifdef P3TURTLE_DEBUG
 			std::cerr << "  Forwarding generic item to peer " << tunnel.local_dst << std::endl ;
 #endif
 			item->PeerId(tunnel.local_dst) ;
 
-			_traffic_info_buffer.unknown_updn_Bps += RsTurtleSerialiser().size(item);
+			_traffic_info_buffer.unknown_updn_Bps += item_size ;
 
-			sendItem(item) ;
-			return ;
+			forward = true ;
         }
-
-        // item is for us. Use the locked region to record the data.
-
-        _traffic_info_buffer.data_dn_Bps += RsTurtleSerialiser().size(item);
+        else // item is for us. Use the locked region to record the data.
+            _traffic_info_buffer.data_dn_Bps += item_size ;
     }
 
+	if(forward)
+	{
+		sendItem(item) ;
+		return ;
+	}
+
 	// The packet was not forwarded, so it is for us. Let's treat it.
 	// This is done off-mutex, to avoid various deadlocks
 	//
@@ -1386,7 +1414,7 @@ bool p3turtle::getTunnelServiceInfo(TurtleTunnelId tunnel_id,RsPeerId& vpid,RsFi
 {
 	RsStackMutex stack(mTurtleMtx); /********** STACK LOCKED MTX ******/
 
-	std::map<TurtleTunnelId,TurtleTunnel>::iterator it2(_local_tunnels.find(tunnel_id)) ;
+	TurtleTunnelTable::iterator it2(_local_tunnels.find(tunnel_id)) ;
 
 	if(it2 == _local_tunnels.end())
 	{
@@ -1414,7 +1442,7 @@ bool p3turtle::getTunnelServiceInfo(TurtleTunnelId tunnel_id,RsPeerId& vpid,RsFi
 	//
 	if(tunnel.local_src == _own_id)
 	{
-		std::map<TurtleFileHash,TurtleHashInfo>::const_iterator it = _incoming_file_hashes.find(hash) ;
+		TurtleHashTable::const_iterator it = _incoming_file_hashes.find(hash) ;
 
 		if(it == _incoming_file_hashes.end())
 		{
@@ -1428,7 +1456,7 @@ bool p3turtle::getTunnelServiceInfo(TurtleTunnelId tunnel_id,RsPeerId& vpid,RsFi
 	}
 	else if(tunnel.local_dst == _own_id)
 	{
-        std::map<TurtleTunnelId,RsTurtleClientService*>::const_iterator it = _outgoing_tunnel_client_services.find(tunnel_id) ;
+        TurtleTunnelServiceTable::const_iterator it = _outgoing_tunnel_client_services.find(tunnel_id) ;
 
         if(it == _outgoing_tunnel_client_services.end())
 		{
@@ -1452,61 +1480,66 @@ bool p3turtle::getTunnelServiceInfo(TurtleTunnelId tunnel_id,RsPeerId& vpid,RsFi
 //
 void p3turtle::sendTurtleData(const RsPeerId& virtual_peer_id,RsTurtleGenericTunnelItem *item)
 {
-	RsStackMutex stack(mTurtleMtx); /********** STACK LOCKED MTX ******/
+	// The tunnel id has a fixed size, so the item can be sized before it is known.
 
-	// get the proper tunnel for this file hash and peer id.
-	std::map<TurtleVirtualPeerId,TurtleTunnelId>::const_iterator it(_virtual_peers.find(virtual_peer_id)) ;
+	uint32_t ss = RsTurtleSerialiser().size(item);
 
-	if(it == _virtual_peers.end())
 	{
+		RsStackMutex stack(mTurtleMtx); /********** STACK LOCKED MTX ******/
+
+		// get the proper tunnel for this file hash and peer id.
+		TurtleVirtualPeerTable::const_iterator it(_virtual_peers.find(virtual_peer_id)) ;
+
+		if(it == _virtual_peers.end())
+		{
 #ifdef P3TURTLE_DEBUG
-		std::cerr << "p3turtle::senddataRequest: cannot find virtual peer " << virtual_peer_id << " in VP list." << std::endl ;
+			std::cerr << "p3turtle::senddataRequest: cannot find virtual peer " << virtual_peer_id << " in VP list." << std::endl ;
 #endif
-		delete item ;
-		return ;
-	}
-	TurtleTunnelId tunnel_id = it->second ;
-	std::map<TurtleTunnelId,TurtleTunnel>::iterator it2( _local_tunnels.find(tunnel_id) ) ;
-
-	if(it2 == _local_tunnels.end())
-	{
-		std::cerr << "p3turtle::client asked to send a packet through tunnel that has previously been deleted. Not a big issue unless it happens in masses." << std::endl;
-		delete item ;
-		return ;
-	}
-	TurtleTunnel& tunnel(it2->second) ;
+			delete item ;
+			return ;
+		}
+		TurtleTunnelId tunnel_id = it->second ;
+		TurtleTunnelTable::iterator it2( _local_tunnels.find(tunnel_id) ) ;
 
-	item->tunnel_id = tunnel_id ;	// we should randomly select a tunnel, or something more clever.
+		if(it2 == _local_tunnels.end())
+		{
+			std::cerr << "p3turtle::client asked to send a packet through tunnel that has previously been deleted. Not a big issue unless it happens in masses." << std::endl;
+			delete item ;
+			return ;
+		}
+		TurtleTunnel& tunnel(it2->second) ;
 
-	uint32_t ss = RsTurtleSerialiser().size(item);
+		item->tunnel_id = tunnel_id ;	// we should randomly select a tunnel, or something more clever.
 
-	if(item->shouldStampTunnel())
-		tunnel.time_stamp = time(NULL) ;
+		if(item->shouldStampTunnel())
+			tunnel.time_stamp = time(NULL) ;
 
-	tunnel.transfered_bytes += ss ;
+		tunnel.transfered_bytes += ss ;
 
-	if(tunnel.local_src == _own_id)
-	{
-		item->setTravelingDirection(RsTurtleGenericTunnelItem::DIRECTION_SERVER) ;
-		item->PeerId(tunnel.local_dst) ;
-		_traffic_info_buffer.data_dn_Bps += ss ;
-	}
-	else if(tunnel.local_dst == _own_id)
-	{
-		item->setTravelingDirection(RsTurtleGenericTunnelItem::DIRECTION_CLIENT) ;
-		item->PeerId(tunnel.local_src) ;
-		_traffic_info_buffer.data_up_Bps += ss ;
-	}
-	else
-	{
-		std::cerr << "p3Turtle::sendTurtleData(): asked to send a packet into a tunnel that is not registered. Dropping packet." << std::endl ;
-		delete item ;
-		return ;
-	}
+		if(tunnel.local_src == _own_id)
+		{
+			item->setTravelingDirection(RsTurtleGenericTunnelItem::DIRECTION_SERVER) ;
+			item->PeerId(tunnel.local_dst) ;
+			_traffic_info_buffer.data_dn_Bps += ss ;
+		}
+		else if(tunnel.local_dst == _own_id)
+		{
+			item->setTravelingDirection(RsTurtleGenericTunnelItem::DIRECTION_CLIENT) ;
+			item->PeerId(tunnel.local_src) ;
+			_traffic_info_buffer.data_up_Bps += ss ;
+		}
+		else
+		{
+			std::cerr << "p3Turtle::sendTurtleData(): asked to send a packet into a tunnel that is not registered. Dropping packet." << std::endl ;
+			delete item ;
+			return ;
+		}
 
 #ifdef P3TURTLE_DEBUG
-	std::cerr << "p3turtle: sending service packet to virtual peer id " << virtual_peer_id << ", hash=0x" << tunnel.hash << ", tunnel = " << HEX_PRINT(item->tunnel_id) << ", next peer=" << tunnel.local_dst << std::endl ;
+		std::cerr << "p3turtle: sending service packet to virtual peer id " << virtual_peer_id << ", hash=0x" << tunnel.hash << ", tunnel = " << HEX_PRINT(item->tunnel_id) << ", next peer=" << item->PeerId() << std::endl ;
 #endif
+	}
+
 	sendItem(item) ;
 }
 
@@ -1521,10 +1554,12 @@ RsPeerId p3turtle::getTurtlePeerId(TurtleTunnelId tid) const
 {
 	RsStackMutex stack(mTurtleMtx); /********** STACK LOCKED MTX ******/
 
-	std::map<TurtleTunnelId,TurtleTunnel>::const_iterator it( _local_tunnels.find(tid) ) ;
+	TurtleTunnelTable::const_iterator it( _local_tunnels.find(tid) ) ;
+
+	if(it == _local_tunnels.end())
+		return RsPeerId() ;
 
 #ifdef P3TURTLE_DEBUG
-	assert(it!=_local_tunnels.end()) ;
 	assert(!it->second.vpid.isNull()) ;
 #endif
 
@@ -1918,7 +1953,7 @@ void p3turtle::handleTunnelResult(RsTurtleTunnelOkItem *item)
 #ifdef P3TURTLE_DEBUG
 			bool ext_found = false ;
 #endif
-			for(std::map<TurtleFileHash,TurtleHashInfo>::iterator it(_incoming_file_hashes.begin());it!=_incoming_file_hashes.end();++it)
+			for(TurtleHashTable::iterator it(_incoming_file_hashes.begin());it!=_incoming_file_hashes.end();++it)
 				if(it->second.last_request == item->request_id)
 				{
 #ifdef P3TURTLE_DEBUG
@@ -2205,7 +2240,10 @@ void p3turtle::monitorTunnels(const RsFileHash& hash,RsTurtleClientService *clie
 //
 bool p3turtle::performLocalHashSearch(const TurtleFileHash& hash,const RsPeerId& peer_id,RsTurtleClientService *& service)
 {
-    std::map<uint16_t,RsTurtleClientService*> client_map ;
+	// Services to ask, and whether they passed a filter. Services whose filter does not
+	// contain the hash are not asked at all, which saves the lookups in their own structures.
+
+	std::vector<std::pair<RsTurtleClientService*,bool> > candidates ;
 	{
 		RsStackMutex stack(mTurtleMtx); /********** STACK LOCKED MTX ******/
 
@@ -2215,17 +2253,97 @@ bool p3turtle::performLocalHashSearch(const TurtleFileHash& hash,const RsPeerId&
             return false ;
         }
 
-		client_map = _registered_services ;
+		for(auto it(_registered_services.begin());it!=_registered_services.end();++it)
+		{
+			auto fit = _tunnel_request_filters.find(it->first) ;
+			const RsBloomFilter *filter = (fit == _tunnel_request_filters.end())? nullptr : fit->second.filter.get() ;
+
+			if(filter != nullptr && !filter->mayContain(hash))
+			{
+				++_tr_filter_rejected ;
+				continue ;
+			}
+			if(filter != nullptr)
+				++_tr_filter_passed ;
+
+			candidates.push_back(std::make_pair(it->second,filter != nullptr)) ;
+		}
 	}
 
-	for(auto it(client_map.begin());it!=client_map.end();++it)
-		if( (*it).second->handleTunnelRequest(hash,peer_id))
+	bool found = false ;
+	uint32_t false_positives = 0 ;
+
+	for(auto it(candidates.begin());it!=candidates.end() && !found;++it)
+		if(it->first->handleTunnelRequest(hash,peer_id))
+		{
+			service = it->first ;
+			found = true ;
+		}
+		else if(it->second)
+			++false_positives ;
+
+	if(false_positives > 0)
+	{
+		RsStackMutex stack(mTurtleMtx); /********** STACK LOCKED MTX ******/
+		_tr_filter_false_positives += false_positives ;
+	}
+
+	return found ;
+}
+
+void p3turtle::invalidateTunnelRequestFilter(const RsTurtleClientService *service)
+{
+	RsStackMutex stack(mTurtleMtx); /********** STACK LOCKED MTX ******/
+
+	TurtleTunnelRequestFilter& f(_tunnel_request_filters[service->serviceId()]) ;
+
+	f.filter = nullptr ;
+	++f.generation ;
+}
+
+/// Warning: this function should never be called while the turtle mutex is locked,
+/// because services lock their own mutex to list their hashes.
+//
+void p3turtle::updateTunnelRequestFilters()
+{
+	rstime_t now = time(NULL) ;
+
+	// Services whose filter is due, with the generation of the filter when starting.
+
+	std::vector<std::pair<RsTurtleClientService*,uint32_t> > to_build ;
+	{
+		RsStackMutex stack(mTurtleMtx); /********** STACK LOCKED MTX ******/
+
+		for(auto it(_registered_services.begin());it!=_registered_services.end();++it)
 		{
-			service = it->second ;
-			return true ;
+			const TurtleTunnelRequestFilter& f(_tunnel_request_filters[it->first]) ;
+
+			// Missing filters are retried often, so that invalidated filters come back quickly.
+
+			if(now >= f.last_build_time + (f.filter? TUNNEL_REQUEST_FILTER_REBUILD_TIME : TUNNEL_REQUEST_FILTER_CHECK_TIME))
+				to_build.push_back(std::make_pair(it->second,f.generation)) ;
 		}
+	}
+
+	for(auto it(to_build.begin());it!=to_build.end();++it)
+	{
+		std::shared_ptr<RsBloomFilter> filter = std::make_shared<RsBloomFilter>() ;
+		bool ok = it->first->buildTunnelRequestFilter(*filter) ;
+
+		RsStackMutex stack(mTurtleMtx); /********** STACK LOCKED MTX ******/
+
+		TurtleTunnelRequestFilter& f(_tunnel_request_filters[it->first->serviceId()]) ;
+		f.last_build_time = now ;
+
+		// If the service was invalidated meanwhile, the new filter may miss its latest hashes.
 
-	return false ;
+		if(f.generation == it->second)
+			f.filter = ok? filter : nullptr ;
+
+#ifdef P3TURTLE_DEBUG
+		std::cerr << "p3turtle: rebuilt tunnel request filter for service " << std::hex << it->first->serviceId() << std::dec << ": " << (ok? filter->count() : 0) << " hashes" << std::endl;
+#endif
+	}
 }
 
 
@@ -2283,6 +2401,16 @@ void p3turtle::getTrafficStatistics(TurtleTrafficStatisticsInfo& info) const
 	RsStackMutex stack(mTurtleMtx); /********** STACK LOCKED MTX ******/
 	info = _traffic_info ;
 
+	info.tr_filter_size = 0 ;
+
+	for(auto it(_tunnel_request_filters.begin());it!=_tunnel_request_filters.end();++it)
+		if(it->second.filter)
+			info.tr_filter_size += it->second.filter->memoryUsage() ;
+
+	info.tr_filter_rejected = _tr_filter_rejected ;
+	info.tr_filter_passed = _tr_filter_passed ;
+	info.tr_filter_false_positives = _tr_filter_false_positives ;
+
 	float distance_to_maximum	= std::min(100.0f,info.tr_up_Bps/(float)(TUNNEL_REQUEST_PACKET_SIZE*_max_tr_up_rate)) ;
 	info.forward_probabilities.clear() ;
 
@@ -2312,10 +2440,10 @@ std::string p3turtle::getPeerNameForVirtualPeerId(const RsPeerId& virtual_peer_i
 {
 	RsStackMutex stack(mTurtleMtx); /********** STACK LOCKED MTX ******/
 	std::string name = "unknown";
-	std::map<TurtleVirtualPeerId,TurtleTunnelId>::const_iterator it(_virtual_peers.find(virtual_peer_id)) ;
+	TurtleVirtualPeerTable::const_iterator it(_virtual_peers.find(virtual_peer_id)) ;
 	if(it != _virtual_peers.end())
 	{
-		std::map<TurtleTunnelId,TurtleTunnel>::iterator it2( _local_tunnels.find(it->second) ) ;
+		TurtleTunnelTable::iterator it2( _local_tunnels.find(it->second) ) ;
 		if(it2 != _local_tunnels.end())
 		{
 			if(it2->second.local_src == _own_id)
@@ -2360,7 +2488,7 @@ void p3turtle::getInfo(	std::vector<std::vector<std::string> >& hashes_info,
 
 	hashes_info.clear() ;
 
-	for(std::map<TurtleFileHash,TurtleHashInfo>::const_iterator it(_incoming_file_hashes.begin());it!=_incoming_file_hashes.end();++it)
+	for(TurtleHashTable::const_iterator it(_incoming_file_hashes.begin());it!=_incoming_file_hashes.end();++it)
 	{
 		hashes_info.push_back(std::vector<std::string>()) ;
 
@@ -2375,7 +2503,7 @@ void p3turtle::getInfo(	std::vector<std::vector<std::string> >& hashes_info,
 
 	tunnels_info.clear();
 
-	for(std::map<TurtleTunnelId,TurtleTunnel>::const_iterator it(_local_tunnels.begin());it!=_local_tunnels.end();++it)
+	for(TurtleTunnelTable::const_iterator it(_local_tunnels.begin());it!=_local_tunnels.end();++it)
 	{
 		tunnels_info.push_back(std::vector<std::string>()) ;
 		std::vector<std::string>& tunnel(tunnels_info.back()) ;
@@ -2439,7 +2567,7 @@ void p3turtle::dumpState()
 	std::cerr << std::endl ;
 	std::cerr << "********************** Turtle router dump ******************" << std::endl ;
 	std::cerr << "  Active incoming file hashes: " << _incoming_file_hashes.size() << std::endl ;
-	for(std::map<TurtleFileHash,TurtleHashInfo>::const_iterator it(_incoming_file_hashes.begin());it!=_incoming_file_hashes.end();++it)
+	for(TurtleHashTable::const_iterator it(_incoming_file_hashes.begin());it!=_incoming_file_hashes.end();++it)
 	{
 		std::cerr << "    hash=0x" << it->first << ", tunnel ids =" ;
 		for(std::vector<TurtleTunnelId>::const_iterator it2(it->second.tunnels.begin());it2!=it->second.tunnels.end();++it2)
@@ -2447,11 +2575,11 @@ void p3turtle::dumpState()
 		//std::cerr << ", last_req=" << (void*)it->second.last_request << ", time_stamp = " << it->second.time_stamp << "(" << now-it->second.time_stamp << " secs ago)" << std::endl ;
 	}
 	std::cerr << "  Active outgoing file hashes: " << _outgoing_tunnel_client_services.size() << std::endl ;
-    for(std::map<TurtleTunnelId,RsTurtleClientService*>::const_iterator it(_outgoing_tunnel_client_services.begin());it!=_outgoing_tunnel_client_services.end();++it)
+    for(TurtleTunnelServiceTable::const_iterator it(_outgoing_tunnel_client_services.begin());it!=_outgoing_tunnel_client_services.end();++it)
         std::cerr << "    TID=0x" << it->first << std::endl ;
 
 	std::cerr << "  Local tunnels:" << std::endl ;
-	for(std::map<TurtleTunnelId,TurtleTunnel>::const_iterator it(_local_tunnels.begin());it!=_local_tunnels.end();++it)
+	for(TurtleTunnelTable::const_iterator it(_local_tunnels.begin());it!=_local_tunnels.end();++it)
 		std::cerr << "    " << HEX_PRINT(it->first) << ": from="
 					<< it->second.local_src << ", to=" << it->second.local_dst
 					<< ", hash=0x" << it->second.hash << ", ts=" << it->second.time_stamp << " (" << now-it->second.time_stamp << " secs ago)"
@@ -2473,7 +2601,7 @@ void p3turtle::dumpState()
 						<< " secs ago)" << std::endl ;
 
 	std::cerr << "  Virtual peers:" << std::endl ;
-	for(std::map<TurtleVirtualPeerId,TurtleTunnelId>::const_iterator it(_virtual_peers.begin());it!=_virtual_peers.end();++it)
+	for(TurtleVirtualPeerTable::const_iterator it(_virtual_peers.begin());it!=_virtual_peers.end();++it)
 		std::cerr << "    id=" << it->first << ", tunnel=" << HEX_PRINT(it->second) << std::endl ;
 	std::cerr << "  Online peers: " << std::endl ;
 //	for(std::list<pqipeer>::const_iterator it(_online_peers.begin());it!=_online_peers.end();++it)
@@ -134,6 +134,8 @@
 #include <string>
 #include <list>
 #include <set>
+#include <memory>
+#include <unordered_map>
 
 #include "pqi/pqinetwork.h"
 #include "pqi/pqi.h"
@@ -146,6 +148,7 @@
 #include "rsturtleitem.h"
 #include "turtleclientservice.h"
 #include "turtlestatistics.h"
+#include "util/rssha1hashtable.h"
 
 //#define TUNNEL_STATISTICS
 
@@ -209,6 +212,40 @@ class TurtleHashInfo
         bool use_aggressive_mode ;			// allow to re-digg tunnels even when some are already available
 };
 
+// Filter of the hashes a client service can serve, used to discard tunnel requests without asking the service.
+// The filter is shared with the request handling code, and replaced as a whole when rebuilt.
+//
+class TurtleTunnelRequestFilter
+{
+	public:
+		TurtleTunnelRequestFilter() : generation(0), last_build_time(0) {}
+
+		std::shared_ptr<const RsBloomFilter> filter ;	// null when the service provides no filter, or when it is outdated
+		uint32_t generation ;						// incremented when the service invalidates its filter
+		rstime_t last_build_time ;
+};
+
+// Virtual peer ids are made of the tunnel id followed by zeros (see
+// p3turtle::locked_addDistantPeer()), so their first bytes are enough to hash them.
+//
+struct TurtleVirtualPeerIdHash
+{
+	size_t operator()(const TurtleVirtualPeerId& id) const
+	{
+		uint64_t h ;
+		memcpy(&h,id.toByteArray(),sizeof(h)) ;
+		return static_cast<size_t>(h) ;
+	}
+};
+
+// Routing tables. These are looked up for every item going through a tunnel,
+// so they are hash tables rather than ordered maps.
+//
+typedef std::unordered_map<TurtleTunnelId,TurtleTunnel>                                   TurtleTunnelTable ;
+typedef std::unordered_map<TurtleVirtualPeerId,TurtleTunnelId,TurtleVirtualPeerIdHash>   TurtleVirtualPeerTable ;
+typedef std::unordered_map<TurtleTunnelId,RsTurtleClientService*>                         TurtleTunnelServiceTable ;
+typedef RsSha1HashTable<TurtleHashInfo>                                                   TurtleHashTable ;
+
 // Subclassing:
 //
 //		Class      | Brings what      | Usage
@@ -285,6 +322,12 @@ class p3turtle: public p3Service, public RsTurtle, public p3Config
 		///
 		virtual void registerTunnelService(RsTurtleClientService *service) ;
 
+		/// To be called by client services when they can serve new hashes. Tunnel requests
+		/// are not filtered for this service anymore, until its filter is rebuilt.
+		/// Never locks the mutex of the service, so it can be called from any of them.
+		///
+		void invalidateTunnelRequestFilter(const RsTurtleClientService *service) ;
+
 		virtual std::string getPeerNameForVirtualPeerId(const RsPeerId& virtual_peer_id);
 		
 		/// get info about tunnels
@@ -363,6 +406,9 @@ class p3turtle: public p3Service, public RsTurtle, public p3Config
 		/// estimates the speed of the traffic into tunnels.
 		void estimateTunnelSpeeds() ;
 
+		/// rebuilds the tunnel request filters of client services that are outdated.
+		void updateTunnelRequestFilters() ;
+
 		//----------------------------- Routing functions ----------------------------//
 		
 		/// Handle tunnel digging for current file hashes
@@ -417,16 +463,16 @@ class p3turtle: public p3Service, public RsTurtle, public p3Config
 		std::map<TurtleTunnelRequestId,TurtleTunnelRequestInfo> 	_tunnel_requests_origins ;
 
 		/// stores adequate tunnels for each file hash locally managed
-		std::map<TurtleFileHash,TurtleHashInfo>			   	_incoming_file_hashes ;
+		TurtleHashTable										_incoming_file_hashes ;
 
 		/// stores file info for each file we provide.
-        std::map<TurtleTunnelId,RsTurtleClientService *>	_outgoing_tunnel_client_services ;
+		TurtleTunnelServiceTable							_outgoing_tunnel_client_services ;
 
 		/// local tunnels, stored by ids (Either transiting or ending).
-		std::map<TurtleTunnelId,TurtleTunnel > 				_local_tunnels ;				
+		TurtleTunnelTable									_local_tunnels ;
 
 		/// Peers corresponding to each tunnel.
-		std::map<TurtleVirtualPeerId,TurtleTunnelId>			_virtual_peers ;				
+		TurtleVirtualPeerTable								_virtual_peers ;
 
 		/// Hashes marked to be deleted.
         std::set<TurtleFileHash>								_hashes_to_remove ;
@@ -434,10 +480,20 @@ class p3turtle: public p3Service, public RsTurtle, public p3Config
 		/// List of client services that have regitered.
 		std::map<uint16_t,RsTurtleClientService*>						_registered_services ;
 
+		/// Filters of the hashes each registered service can serve, by service id.
+		std::map<uint16_t,TurtleTunnelRequestFilter>					_tunnel_request_filters ;
+
+		/// Number of tunnel requests rejected/passed by the filters, and of requests
+		/// that passed but were refused by the service.
+		uint64_t _tr_filter_rejected ;
+		uint64_t _tr_filter_passed ;
+		uint64_t _tr_filter_false_positives ;
+
 		rstime_t _last_clean_time ;
 		rstime_t _last_tunnel_management_time ;
 		rstime_t _last_tunnel_campaign_time ;
 		rstime_t _last_tunnel_speed_estimate_time ;
+		rstime_t _last_tunnel_request_filter_update_time ;
 
 		std::list<pqipeer> _online_peers;
 
@@ -27,6 +27,7 @@
 #include "serialiser/rsserial.h"
 #include "turtle/rsturtleitem.h"
 #include "util/rsdebug.h"
+#include "util/rsbloomfilter.h"
 
 struct RsItem;
 class p3turtle ;
@@ -62,6 +63,19 @@ class RsTurtleClientService
 		 * \return true if the service
 		 */
 		virtual bool handleTunnelRequest(const RsFileHash& /*hash*/,const RsPeerId& /*peer_id*/) { return false ; }
+
+		/*!
+		 * \brief buildTunnelRequestFilter
+		 *           Fills the filter with every hash for which handleTunnelRequest() may return true. The turtle router calls this
+		 *           from time to time, and then only passes to handleTunnelRequest() the requests that match the filter, so that
+		 *           the many requests for hashes the service does not have cost no lookup in the service.
+		 *           The filter must be sized with reset() before being filled. When the set of hashes grows, the service should call
+		 *           p3turtle::invalidateTunnelRequestFilter(), so that requests are not filtered out until the next build.
+		 *           Never called with the turtle mutex locked.
+		 *
+		 * \return false if the service cannot list its hashes. All requests are then passed to handleTunnelRequest().
+		 */
+		virtual bool buildTunnelRequestFilter(RsBloomFilter& /*filter*/) { return false ; }
 		
 	    /*!
 		 * \brief receiveTurtleData
@@ -17,6 +17,11 @@ class TurtleTrafficStatisticsInfoOp: public TurtleTrafficStatisticsInfo
 			tr_dn_Bps = 0.0f ;
 			total_up_Bps = 0.0f ;
 			total_dn_Bps = 0.0f ;
+
+			tr_filter_size = 0 ;
+			tr_filter_rejected = 0 ;
+			tr_filter_passed = 0 ;
+			tr_filter_false_positives = 0 ;
 		}
 
 		TurtleTrafficStatisticsInfoOp operator*(float f) const
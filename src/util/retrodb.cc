@@ -39,8 +39,12 @@ const int RetroDb::OPEN_READONLY = SQLITE_OPEN_READONLY;
 const int RetroDb::OPEN_READWRITE = SQLITE_OPEN_READWRITE;
 const int RetroDb::OPEN_READWRITE_CREATE = SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE;
 
+// Only insert templates are cached, and GXS meta inserts use a few distinct
+// column sets.
+const uint32_t RetroDb::STATEMENT_CACHE_SIZE = 16;
+
 RetroDb::RetroDb(const std::string& dbPath, int flags, const std::string& key):
-    mDb(nullptr), mKey(key)
+    mDb(nullptr), mKey(key), mStmtCacheHits(0)
 {
 	bool alreadyExists = RsDirUtil::fileExists(dbPath);
 
@@ -154,6 +158,9 @@ RetroDb::~RetroDb() { closeDb(); }
 
 void RetroDb::closeDb()
 {
+	// cached statements must be finalised or sqlite3_close fails
+	clearStatementCache();
+
 	// no-op if mDb is nullptr (https://www.sqlite.org/c3ref/close.html)
 	int rc = sqlite3_close(mDb);
 	mDb = nullptr;
@@ -308,7 +315,8 @@ bool RetroDb::sqlInsert(const std::string &table, const std::string& /* nullColu
     // complete insertion query
     std::string sqlQuery = "INSERT INTO " + qColumns + " " + qValues;
 
-    bool ok = execSQL_bind(sqlQuery, paramBindings);
+    // the query only depends on the columns, so it is worth caching
+    bool ok = execSQL_bind(sqlQuery, paramBindings, true);
 
 #ifdef RETRODB_DEBUG
     std::cerr << "RetroDb::sqlInsert(): " << sqlQuery << std::endl;
@@ -317,6 +325,40 @@ bool RetroDb::sqlInsert(const std::string &table, const std::string& /* nullColu
     return ok;
 }
 
+bool RetroDb::sqlInsertBulk(const std::string &table, const std::string &nullColumnHack, const std::list<ContentValue> &cvs)
+{
+    if (!isOpen()) {
+        return false;
+    }
+
+    // do not nest transactions, the caller may already have started one
+    bool ownTransaction = sqlite3_get_autocommit(mDb) != 0;
+
+    if(ownTransaction && !beginTransaction())
+        return false;
+
+    bool ok = true;
+    uint32_t row = 0;
+
+    for(std::list<ContentValue>::const_iterator cit = cvs.begin(); cit != cvs.end(); ++cit, ++row)
+    {
+        if(!sqlInsert(table, nullColumnHack, *cit))
+        {
+            std::cerr << "RetroDb::sqlInsertBulk(): insertion of row " << row
+                      << " in " << table << " failed" << std::endl;
+            ok = false;
+        }
+    }
+
+    if(ownTransaction && !commitTransaction())
+    {
+        rollbackTransaction();
+        return false;
+    }
+
+    return ok;
+}
+
 std::string RetroDb::getKey() const
 {
 	return mKey;
@@ -348,25 +390,92 @@ bool RetroDb::rollbackTransaction()
     return execSQL("ROLLBACK;");
 }
 
-bool RetroDb::execSQL_bind(const std::string &query, std::list<RetroBind*> &paramBindings){
+sqlite3_stmt* RetroDb::getCachedStatement(const std::string &query){
+
+    std::map<std::string, StatementLru::iterator>::iterator mit = mStmtCache.find(query);
+
+    if(mit != mStmtCache.end()){
+        // move to front of the lru list
+        mStmtLru.splice(mStmtLru.begin(), mStmtLru, mit->second);
+        ++mStmtCacheHits;
+        return mit->second->second;
+    }
 
-    // prepare statement
     sqlite3_stmt* stm = NULL;
+    int rc = sqlite3_prepare_v2(mDb, query.c_str(), query.length(), &stm, NULL);
+
+    // check if there are any errors
+    if(rc != SQLITE_OK){
+        std::cerr << "RetroDb::getCachedStatement(): Error preparing statement\n";
+        std::cerr << "Error code: " <<  sqlite3_errmsg(mDb)
+                  << std::endl;
+        sqlite3_finalize(stm);
+        return NULL;
+    }
+
+    if(mStmtLru.size() >= STATEMENT_CACHE_SIZE){
+        sqlite3_finalize(mStmtLru.back().second);
+        mStmtCache.erase(mStmtLru.back().first);
+        mStmtLru.pop_back();
+    }
+
+    mStmtLru.push_front(std::make_pair(query, stm));
+    mStmtCache[query] = mStmtLru.begin();
+
+    return stm;
+}
+
+void RetroDb::releaseCachedStatement(sqlite3_stmt *stm){
+
+    // errors of the last step are reported again by reset, those have
+    // already been handled by the caller
+    sqlite3_reset(stm);
+    sqlite3_clear_bindings(stm);
+}
+
+void RetroDb::clearStatementCache(){
+
+    for(StatementLru::iterator lit = mStmtLru.begin(); lit != mStmtLru.end(); ++lit)
+        sqlite3_finalize(lit->second);
+
+    mStmtLru.clear();
+    mStmtCache.clear();
+}
+
+void RetroDb::getStatementCacheStatistics(uint32_t &cached, uint64_t &hits) const{
+
+    cached = mStmtLru.size();
+    hits = mStmtCacheHits;
+}
+
+bool RetroDb::execSQL_bind(const std::string &query, std::list<RetroBind*> &paramBindings, bool cacheStatement){
 
 #ifdef RETRODB_DEBUG
     std::cerr << "Query: " << query << std::endl;
 #endif
 
-    int rc = sqlite3_prepare_v2(mDb, query.c_str(), query.length(), &stm, NULL);
+    sqlite3_stmt* stm = NULL;
 
-    // check if there are any errors
-    if(rc != SQLITE_OK){
+    if(cacheStatement){
+        // prepared statements are reused, only the bindings change
+        stm = getCachedStatement(query);
+    }else if(sqlite3_prepare_v2(mDb, query.c_str(), query.length(), &stm, NULL) != SQLITE_OK){
         std::cerr << "RetroDb::execSQL_bind(): Error preparing statement\n";
         std::cerr << "Error code: " <<  sqlite3_errmsg(mDb)
                   << std::endl;
+        sqlite3_finalize(stm);
+        stm = NULL;
+    }
+
+    if(!stm){
+        for(std::list<RetroBind*>::iterator lit = paramBindings.begin(); lit != paramBindings.end(); ++lit)
+            delete *lit;
+
         return false;
     }
 
+    int rc = SQLITE_OK;
+
     std::list<RetroBind*>::iterator lit = paramBindings.begin();
 
     for(; lit != paramBindings.end(); ++lit){
@@ -424,8 +533,12 @@ bool RetroDb::execSQL_bind(const std::string &query, std::list<RetroBind*> &para
         }
     }
 
-    // finalise statement or else db cannot be closed
-    sqlite3_finalize(stm);
+    // keep statement for next use, or finalise it
+    if(cacheStatement)
+        releaseCachedStatement(stm);
+    else
+        sqlite3_finalize(stm);
+
     return ok;
 }
 
@@ -611,8 +724,8 @@ bool RetroDb::sqlUpdate(const std::string &tableName, std::string whereClause, c
         sqlQuery += ";";
     }
 
-    // execute query
-    return execSQL_bind(sqlQuery, paramBindings);
+    // execute query, not cached as the where clause holds literal ids
+    return execSQL_bind(sqlQuery, paramBindings, false);
 }
 
 bool RetroDb::tableExists(const std::string &tableName)
@@ -128,6 +128,19 @@ public:
      */
     bool sqlInsert(const std::string& table,const  std::string& nullColumnHack, const ContentValue& cv);
 
+    /*!
+     * inserts many rows in a database table, inside a single transaction \n
+     * if none is already open. Rows with the same columns share the same \n
+     * prepared statement, so this is much faster than many sqlInsert calls
+     * @param table table you want to insert content values into
+     * @param nullColumnHack  SQL doesn't allow inserting a completely \n
+     *        empty row without naming at least one column name
+     * @param cvs entries to insert, one per row
+     * @return true if all rows were inserted, false otherwise, rows which \n
+     *        failed are skipped and the others still get inserted
+     */
+    bool sqlInsertBulk(const std::string& table, const std::string& nullColumnHack, const std::list<ContentValue>& cvs);
+
     /*!
      * update row in a database table
      * @param tableName the table on which to apply the UPDATE
@@ -172,6 +185,13 @@ public:
      */
     bool tableExists(const std::string& tableName);
 
+    /*!
+     * Statistics of the prepared statement cache
+     * @param cached number of statements currently in the cache
+     * @param hits number of queries which reused a cached statement
+     */
+    void getStatementCacheStatistics(uint32_t& cached, uint64_t& hits) const;
+
 public:
 
     static const int OPEN_READONLY;
@@ -180,7 +200,30 @@ public:
 
 private:
 
-    bool execSQL_bind(const std::string &query, std::list<RetroBind*>& blobs);
+    /*!
+     * @param cacheStatement keep the prepared statement in the statement \n
+     *        cache. Only for queries which do not embed literal values, \n
+     *        as those would evict the reusable ones
+     */
+    bool execSQL_bind(const std::string &query, std::list<RetroBind*>& blobs, bool cacheStatement);
+
+    /*!
+     * Get a prepared statement for the given query from the statement cache, \n
+     * preparing it if needed. The least recently used statement is finalised \n
+     * when the cache is full
+     * @return nullptr if the statement could not be prepared
+     */
+    sqlite3_stmt* getCachedStatement(const std::string& query);
+
+    /*!
+     * Reset the statement and clear its bindings so it can be reused
+     */
+    void releaseCachedStatement(sqlite3_stmt* stm);
+
+    /*!
+     * Finalise all cached statements, must be done before closing the db
+     */
+    void clearStatementCache();
 
     /*!
      * Build the "VALUE" part of an insertiong sql query
@@ -203,6 +246,14 @@ private:
     sqlite3* mDb;
     const std::string mKey;
 
+    /* prepared statements cache, keyed by query, most recently used first */
+    typedef std::list<std::pair<std::string, sqlite3_stmt*> > StatementLru;
+    StatementLru mStmtLru;
+    std::map<std::string, StatementLru::iterator> mStmtCache;
+    uint64_t mStmtCacheHits;
+
+    static const uint32_t STATEMENT_CACHE_SIZE;
+
 	RS_SET_CONTEXT_DEBUG_LEVEL(3)
 };
 
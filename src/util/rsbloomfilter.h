@@ -0,0 +1,121 @@
+/*******************************************************************************
+ * libretroshare/src/util: rsbloomfilter.h                                     *
+ *                                                                             *
+ * libretroshare: retroshare core library                                      *
+ *                                                                             *
+ * Copyright (C) 2026  RetroShare Team <contact@retroshare.cc>                 *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Lesser General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ *******************************************************************************/
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "retroshare/rstypes.h"
+
+/**
+ * Bloom filter of SHA1 hashes. It answers whether a hash may be in a set, with
+ * no false negatives and about 1% of false positives when it holds the number
+ * of hashes it was sized for.
+ * The bit array has a power of two size, and the probed bits are derived from
+ * two 64 bits words of the hash by double hashing, so a lookup costs a few
+ * shifts and memory reads and never allocates.
+ * A filter is not meant to be updated once published: build a new one when the
+ * set changes, and share it read only, possibly between threads.
+ */
+class RsBloomFilter
+{
+public:
+	RsBloomFilter() : mMask(0), mCount(0) {}
+
+	/** Empty the filter and size it for the given number of hashes. */
+	void reset(size_t expectedCount)
+	{
+		// About 10 bits per hash and 7 probes give 1% of false positives. The
+		// size is rounded up to a power of two, which only lowers that rate.
+
+		uint64_t bits = 64;
+		while(bits < 10 * static_cast<uint64_t>(expectedCount)) bits <<= 1;
+
+		mWords.assign(bits / 64, 0);
+		mMask = bits - 1;
+		mCount = 0;
+	}
+
+	void insert(const RsFileHash& hash)
+	{
+		if(mWords.empty()) reset(1);
+
+		uint64_t h1, h2; split(hash, h1, h2);
+
+		for(uint32_t i = 0; i < NB_PROBES; ++i, h1 += h2)
+			mWords[(h1 & mMask) >> 6] |= uint64_t(1) << (h1 & 63);
+
+		++mCount;
+	}
+
+	/** @return false if the hash was certainly not inserted */
+	bool mayContain(const RsFileHash& hash) const
+	{
+		if(mWords.empty()) return false;
+
+		uint64_t h1, h2; split(hash, h1, h2);
+
+		for(uint32_t i = 0; i < NB_PROBES; ++i, h1 += h2)
+			if(!(mWords[(h1 & mMask) >> 6] & (uint64_t(1) << (h1 & 63))))
+				return false;
+
+		return true;
+	}
+
+	/** Number of insertions since the last reset */
+	size_t count() const { return mCount; }
+
+	/** Size of the bit array, in bytes */
+	size_t memoryUsage() const { return mWords.size() * sizeof(uint64_t); }
+
+private:
+	static constexpr uint32_t NB_PROBES = 7;
+
+	/* Hashes are usually uniform, but some services put structured data in
+	 * them, so the words are mixed before use. The step is kept odd, so that
+	 * the probes never collapse on a single bit. */
+	static void split(const RsFileHash& hash, uint64_t& h1, uint64_t& h2)
+	{
+		const uint8_t* b = hash.toByteArray();
+		uint32_t tail;
+
+		memcpy(&h1, b, 8);
+		memcpy(&h2, b + 8, 8);
+		memcpy(&tail, b + 16, 4);
+
+		h1 = mix(h1 ^ tail);
+		h2 = mix(h2) | 1;
+	}
+
+	static uint64_t mix(uint64_t x)
+	{
+		x ^= x >> 33; x *= 0xff51afd7ed558ccdULL;
+		x ^= x >> 33; x *= 0xc4ceb9fe1a85ec53ULL;
+		x ^= x >> 33;
+		return x;
+	}
+
+	std::vector<uint64_t> mWords;
+	uint64_t mMask;
+	size_t mCount;
+};
@@ -0,0 +1,508 @@
+/*******************************************************************************
+ * libretroshare/src/util: rsexecutor.cc                                       *
+ *                                                                             *
+ * libretroshare: retroshare core library                                      *
+ *                                                                             *
+ * Copyright (C) 2026  RetroShare Team <contact@retroshare.cc>                 *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Lesser General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ *******************************************************************************/
+
+#include "util/rsexecutor.h"
+#include "util/rsdebug.h"
+
+#include <algorithm>
+#include <ctime>
+#include <deque>
+
+/* Enough to keep all the GXS services busy, more would mostly sleep */
+static const uint32_t RS_EXECUTOR_MAX_THREADS = 16;
+
+/* The timer wheel has WHEEL_SIZE slots of TIMER_RESOLUTION each, so periodic
+ * tasks are run up to 10 ms late, and tasks with periods longer than the wheel
+ * span go around it a few times before expiring. */
+static const std::chrono::milliseconds RS_EXECUTOR_TIMER_RESOLUTION(10);
+static const uint32_t RS_EXECUTOR_WHEEL_SIZE = 512;
+
+std::atomic<uint32_t> RsExecutor::sThreadCount(0);
+std::atomic<RsExecutor*> RsExecutor::sInstance(nullptr);
+RsMutex RsExecutor::sInstanceMtx("RsExecutor::sInstanceMtx");
+
+/* Set on the worker threads, so jobs queued by a job go to the queue of the
+ * worker running it */
+static thread_local const RsExecutor* tExecutor = nullptr;
+static thread_local uint32_t tWorkerIndex = 0;
+
+static uint64_t threadCpuTimeUs()
+{
+#ifdef CLOCK_THREAD_CPUTIME_ID
+	timespec ts;
+	if(!clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts))
+		return static_cast<uint64_t>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+#endif
+	return 0;
+}
+
+class RsExecutor::Worker: public RsThread
+{
+public:
+	Worker(RsExecutor& executor, uint32_t index) :
+	    mExecutor(executor), mIndex(index) {}
+
+	std::mutex mQueueMtx;
+	std::deque<std::function<void()> > mQueue;
+
+protected:
+	void run() override { mExecutor.workerLoop(mIndex); }
+
+private:
+	RsExecutor& mExecutor;
+	uint32_t mIndex;
+};
+
+class RsExecutor::TimerThread: public RsThread
+{
+public:
+	explicit TimerThread(RsExecutor& executor) : mExecutor(executor) {}
+
+protected:
+	void run() override { mExecutor.timerLoop(); }
+
+private:
+	RsExecutor& mExecutor;
+};
+
+struct RsExecutor::Task
+{
+	/* Protected by mTimerMtx. WOKEN is a running task which has been woken up
+	 * meanwhile, and must be queued again as soon as it returns. */
+	enum State : uint8_t { WAITING, QUEUED, RUNNING, WOKEN, DONE };
+
+	TaskId mId;
+	std::string mName;
+	std::chrono::milliseconds mPeriod;
+	std::function<bool()> mFn;
+
+	State mState;
+	uint32_t mSlot;
+	uint32_t mRounds;
+	std::list<TaskPtr>::iterator mWheelPos;
+
+	uint64_t mRuns;
+	uint64_t mCpuTimeUs;
+	uint64_t mWallTimeUs;
+	uint64_t mMaxWallTimeUs;
+};
+
+/*static*/ void RsExecutor::setThreadCount(uint32_t threads)
+{
+	if(threads > RS_EXECUTOR_MAX_THREADS)
+	{
+		RsWarn() << __PRETTY_FUNCTION__ << " " << threads << " executor threads "
+		         << "requested, limiting to " << RS_EXECUTOR_MAX_THREADS
+		         << std::endl;
+		threads = RS_EXECUTOR_MAX_THREADS;
+	}
+
+	sThreadCount = threads;
+}
+
+/*static*/ bool RsExecutor::enabled() { return sThreadCount > 0; }
+
+/*static*/ RsExecutor* RsExecutor::instance()
+{
+	if(!enabled()) return nullptr;
+
+	RsExecutor* executor = sInstance;
+	if(executor) return executor;
+
+	RS_STACK_MUTEX(sInstanceMtx);
+	if(!sInstance) sInstance = new RsExecutor(sThreadCount);
+	return sInstance;
+}
+
+/*static*/ void RsExecutor::shutdown()
+{
+	RS_STACK_MUTEX(sInstanceMtx);
+	RsExecutor* executor = sInstance.exchange(nullptr);
+
+	/* Services may still reference the executor, so just stop the threads
+	 * without deleting it */
+	if(executor)
+	{
+		executor->mStop = true;
+
+		{ std::lock_guard<std::mutex> lock(executor->mIdleMtx); }
+		executor->mIdleCv.notify_all();
+		{ std::lock_guard<std::mutex> lock(executor->mTimerMtx); }
+		executor->mTimerCv.notify_all();
+
+		for(Worker* w: executor->mWorkers) w->fullstop();
+		executor->mTimerThread->fullstop();
+	}
+
+	sThreadCount = 0;
+}
+
+RsExecutor::RsExecutor(uint32_t threads) :
+    mNextWorker(0), mPendingJobs(0), mStop(false), mTimerThread(nullptr),
+    mWheel(RS_EXECUTOR_WHEEL_SIZE), mWheelCursor(0),
+    mWheelCursorTime(std::chrono::steady_clock::now()), mWheelCount(0),
+    mTimerWakeTime(std::chrono::steady_clock::time_point::max()),
+    mLastTaskId(0)
+{
+	/* All the workers must exist before any of them starts stealing jobs */
+	for(uint32_t i = 0; i < threads; ++i)
+		mWorkers.push_back(new Worker(*this, i));
+
+	for(uint32_t i = 0; i < threads; ++i)
+		mWorkers[i]->start("rs executor " + std::to_string(i));
+
+	mTimerThread = new TimerThread(*this);
+	mTimerThread->start("rs exec timer");
+}
+
+RsExecutor::~RsExecutor()
+{
+	for(Worker* w: mWorkers) delete w;
+	delete mTimerThread;
+}
+
+void RsExecutor::post(const std::function<void()>& job) { pushJob(job); }
+
+void RsExecutor::runParallel( uint32_t n_jobs, uint32_t max_helpers,
+                              const std::function<void(uint32_t)>& job )
+{
+	RsExecutor* executor = instance();
+	uint32_t n_helpers = std::min(max_helpers, n_jobs);
+
+	if(executor == nullptr || n_helpers == 0)
+	{
+		for(uint32_t i=0;i<n_jobs;++i)
+			job(i);
+		return;
+	}
+
+	/* Shared with the helpers, which may outlive this call. job is only
+	 * called for an index below n_jobs, and all of them are taken before this
+	 * function waits for the helpers still running one. */
+	struct State
+	{
+		State(uint32_t n, const std::function<void(uint32_t)>& j) :
+		    mJobs(n), mJob(&j), mNextJob(0), mRunning(0) {}
+
+		const uint32_t mJobs;
+		const std::function<void(uint32_t)>* mJob;
+		std::atomic<uint32_t> mNextJob;
+		std::atomic<uint32_t> mRunning;
+		std::mutex mMtx;
+		std::condition_variable mCv;
+
+		void work()
+		{
+			++mRunning;
+
+			for(uint32_t i = mNextJob++; i < mJobs; i = mNextJob++)
+				(*mJob)(i);
+
+			if(--mRunning == 0)
+			{
+				std::lock_guard<std::mutex> lock(mMtx);
+				mCv.notify_all();
+			}
+		}
+	};
+
+	auto state = std::make_shared<State>(n_jobs, job);
+
+	for(uint32_t t=0;t<n_helpers;++t)
+		executor->post([state]() { state->work(); });
+
+	state->work();
+
+	std::unique_lock<std::mutex> lock(state->mMtx);
+	state->mCv.wait(lock, [&]() { return state->mRunning == 0; });
+}
+
+RsExecutor::TaskId RsExecutor::schedulePeriodic(
+        const std::string& name, std::chrono::milliseconds period,
+        const std::function<bool()>& task )
+{
+	TaskPtr t = std::make_shared<Task>();
+	t->mName = name;
+	t->mPeriod = period;
+	t->mFn = task;
+	t->mState = Task::DONE;
+	t->mSlot = 0;
+	t->mRounds = 0;
+	t->mRuns = t->mCpuTimeUs = t->mWallTimeUs = t->mMaxWallTimeUs = 0;
+
+	std::lock_guard<std::mutex> lock(mTimerMtx);
+
+	t->mId = ++mLastTaskId;
+	mTasks[t->mId] = t;
+
+	// first tick right away, like a thread just started
+	locked_enqueue(t);
+	return t->mId;
+}
+
+void RsExecutor::wake(TaskId id)
+{
+	std::lock_guard<std::mutex> lock(mTimerMtx);
+
+	auto it = mTasks.find(id);
+	if(it == mTasks.end()) return;
+
+	const TaskPtr& task(it->second);
+
+	switch(task->mState)
+	{
+	case Task::WAITING:
+		locked_removeFromWheel(task);
+		locked_enqueue(task);
+		break;
+	case Task::RUNNING:
+		task->mState = Task::WOKEN;
+		break;
+	default:
+		break;
+	}
+}
+
+void RsExecutor::getTaskStatistics(std::vector<TaskStatistic>& stats)
+{
+	stats.clear();
+
+	std::lock_guard<std::mutex> lock(mTimerMtx);
+
+	for(auto& it: mTasks)
+	{
+		const Task& t(*it.second);
+
+		TaskStatistic s;
+		s.mName = t.mName;
+		s.mRuns = t.mRuns;
+		s.mCpuTimeUs = t.mCpuTimeUs;
+		s.mWallTimeUs = t.mWallTimeUs;
+		s.mMaxWallTimeUs = t.mMaxWallTimeUs;
+		stats.push_back(s);
+	}
+}
+
+void RsExecutor::workerLoop(uint32_t index)
+{
+	tExecutor = this;
+	tWorkerIndex = index;
+
+	std::function<void()> job;
+
+	while(!mStop)
+	{
+		if(popJob(index, job))
+		{
+			job();
+			job = nullptr;
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(mIdleMtx);
+		mIdleCv.wait(lock, [this]() { return mPendingJobs > 0 || mStop; });
+	}
+}
+
+bool RsExecutor::popJob(uint32_t index, std::function<void()>& job)
+{
+	const uint32_t n = static_cast<uint32_t>(mWorkers.size());
+
+	/* Own queue first, then steal from the other end of the other queues, so
+	 * the owner and the thieves do not fight for the same jobs */
+	for(uint32_t i = 0; i < n; ++i)
+	{
+		Worker* w = mWorkers[(index + i) % n];
+		std::lock_guard<std::mutex> lock(w->mQueueMtx);
+
+		if(w->mQueue.empty()) continue;
+
+		if(!i)
+		{
+			job = std::move(w->mQueue.front());
+			w->mQueue.pop_front();
+		}
+		else
+		{
+			job = std::move(w->mQueue.back());
+			w->mQueue.pop_back();
+		}
+
+		--mPendingJobs;
+		return true;
+	}
+
+	return false;
+}
+
+void RsExecutor::pushJob(const std::function<void()>& job)
+{
+	const uint32_t n = static_cast<uint32_t>(mWorkers.size());
+	const uint32_t index = (tExecutor == this) ?
+	            tWorkerIndex : mNextWorker++ % n;
+
+	/* Counted before being queued, so mPendingJobs never goes below the
+	 * number of queued jobs and no worker goes to sleep with one waiting */
+	++mPendingJobs;
+
+	{
+		std::lock_guard<std::mutex> lock(mWorkers[index]->mQueueMtx);
+		mWorkers[index]->mQueue.push_back(job);
+	}
+
+	{ std::lock_guard<std::mutex> lock(mIdleMtx); }
+	mIdleCv.notify_one();
+}
+
+void RsExecutor::timerLoop()
+{
+	std::unique_lock<std::mutex> lock(mTimerMtx);
+
+	while(!mStop)
+	{
+		const auto now = std::chrono::steady_clock::now();
+
+		while(mWheelCount && mWheelCursorTime <= now)
+		{
+			std::list<TaskPtr>& slot(mWheel[mWheelCursor]);
+
+			for(auto it = slot.begin(); it != slot.end();)
+			{
+				TaskPtr task = *it;
+
+				if(task->mRounds)
+				{
+					--task->mRounds;
+					++it;
+					continue;
+				}
+
+				it = slot.erase(it);
+				--mWheelCount;
+				locked_enqueue(task);
+			}
+
+			mWheelCursor = (mWheelCursor + 1) % RS_EXECUTOR_WHEEL_SIZE;
+			mWheelCursorTime += RS_EXECUTOR_TIMER_RESOLUTION;
+		}
+
+		if(!mWheelCount)
+		{
+			mTimerWakeTime = std::chrono::steady_clock::time_point::max();
+			mTimerCv.wait(lock);
+			continue;
+		}
+
+		// Sleep until the next slot holding some task, not at every slot
+		uint32_t skip = 0;
+		while(mWheel[(mWheelCursor + skip) % RS_EXECUTOR_WHEEL_SIZE].empty())
+			++skip;
+
+		mTimerWakeTime = mWheelCursorTime + skip * RS_EXECUTOR_TIMER_RESOLUTION;
+		mTimerCv.wait_until(lock, mTimerWakeTime);
+	}
+}
+
+void RsExecutor::runTask(const TaskPtr& task)
+{
+	{
+		std::lock_guard<std::mutex> lock(mTimerMtx);
+		if(task->mState != Task::QUEUED) return;
+		task->mState = Task::RUNNING;
+	}
+
+	const uint64_t cpuStart = threadCpuTimeUs();
+	const auto wallStart = std::chrono::steady_clock::now();
+
+	const bool keep = task->mFn();
+
+	const uint64_t cpuTime = threadCpuTimeUs() - cpuStart;
+	const uint64_t wallTime = static_cast<uint64_t>(
+	            std::chrono::duration_cast<std::chrono::microseconds>(
+	                std::chrono::steady_clock::now() - wallStart ).count() );
+
+	std::lock_guard<std::mutex> lock(mTimerMtx);
+
+	++task->mRuns;
+	task->mCpuTimeUs += cpuTime;
+	task->mWallTimeUs += wallTime;
+	if(wallTime > task->mMaxWallTimeUs) task->mMaxWallTimeUs = wallTime;
+
+	if(!keep || mStop)
+	{
+		task->mState = Task::DONE;
+		mTasks.erase(task->mId);
+		return;
+	}
+
+	if(task->mState == Task::WOKEN) locked_enqueue(task);
+	else locked_addToWheel(task, task->mPeriod);
+}
+
+void RsExecutor::locked_enqueue(const TaskPtr& task)
+{
+	task->mState = Task::QUEUED;
+
+	TaskPtr t(task);
+	pushJob([this, t]() { runTask(t); });
+}
+
+void RsExecutor::locked_addToWheel(
+        const TaskPtr& task, std::chrono::milliseconds delay )
+{
+	const auto now = std::chrono::steady_clock::now();
+
+	/* The cursor stops moving while the wheel is empty */
+	if(!mWheelCount) mWheelCursorTime = now;
+
+	const auto due = now + delay;
+
+	uint64_t ticks = 0;
+	if(due > mWheelCursorTime)
+		ticks = static_cast<uint64_t>(
+		            (due - mWheelCursorTime + RS_EXECUTOR_TIMER_RESOLUTION
+		             - std::chrono::nanoseconds(1))
+		            / RS_EXECUTOR_TIMER_RESOLUTION );
+
+	task->mSlot = static_cast<uint32_t>(
+	            (mWheelCursor + ticks) % RS_EXECUTOR_WHEEL_SIZE );
+	task->mRounds = static_cast<uint32_t>(ticks / RS_EXECUTOR_WHEEL_SIZE);
+	task->mState = Task::WAITING;
+
+	std::list<TaskPtr>& slot(mWheel[task->mSlot]);
+	task->mWheelPos = slot.insert(slot.end(), task);
+	++mWheelCount;
+
+	/* Wake up the timer thread only if it would otherwise sleep past this
+	 * task, most of the time it is already due to wake up earlier */
+	if(due < mTimerWakeTime)
+	{
+		mTimerWakeTime = due;
+		mTimerCv.notify_one();
+	}
+}
+
+void RsExecutor::locked_removeFromWheel(const TaskPtr& task)
+{
+	mWheel[task->mSlot].erase(task->mWheelPos);
+	--mWheelCount;
+}
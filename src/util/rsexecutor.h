@@ -0,0 +1,174 @@
+/*******************************************************************************
+ * libretroshare/src/util: rsexecutor.h                                        *
+ *                                                                             *
+ * libretroshare: retroshare core library                                      *
+ *                                                                             *
+ * Copyright (C) 2026  RetroShare Team <contact@retroshare.cc>                 *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Lesser General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ *******************************************************************************/
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "util/rsthreads.h"
+
+/**
+ * Small pool of worker threads shared by the services which would otherwise
+ * each run an own RsTickingThread mostly sleeping between two ticks.
+ * Each worker has its own queue of jobs, and takes jobs from the queues of the
+ * other workers when its own is empty, so a service tick which takes long does
+ * not delay the ones queued behind it.
+ * Periodic tasks wait in a timer wheel, driven by a single timer thread which
+ * only wakes up when a task is due, and are queued on a worker at the end of
+ * their period. A periodic task is scheduled again only once its run is over,
+ * so it never runs concurrently with itself, like a tick on an own thread.
+ * The CPU and wall time spent in each periodic task is accounted.
+ * Jobs must not block for long, as they hold a worker meanwhile.
+ */
+class RsExecutor
+{
+public:
+	typedef uint64_t TaskId;
+
+	/**
+	 * Set the number of worker threads, must be called before any service is
+	 * started, usually at startup @see RsConfigOptions::executorThreads
+	 * @param threads number of worker threads, 0 disable the executor and
+	 *	keep one thread per service
+	 */
+	static void setThreadCount(uint32_t threads);
+
+	/** @return true if services should be run on the executor */
+	static bool enabled();
+
+	/** @return the executor instance, nullptr if not enabled */
+	static RsExecutor* instance();
+
+	/**
+	 * Stop all executor threads, called at shutdown once the services running
+	 * on the executor have been stopped. Queued jobs are dropped.
+	 */
+	static void shutdown();
+
+	/** Run the given job once, on any worker, as soon as possible */
+	void post(const std::function<void()>& job);
+
+	/**
+	 * Call job(0) ... job(n_jobs-1) on the calling thread, helped by up to
+	 * max_helpers jobs posted on the executor, and return once all of them
+	 * are done. Helpers which start late find nothing left to do, so the
+	 * calling thread never waits for a busy executor. Without executor, or
+	 * helpers, everything is done on the calling thread, in order.
+	 * @param job called once for each index, possibly concurrently
+	 */
+	static void runParallel( uint32_t n_jobs, uint32_t max_helpers,
+	                         const std::function<void(uint32_t)>& job );
+
+	/**
+	 * Run the given task on a worker every period, until it returns false.
+	 * @param name used to report the task statistics
+	 * @param period delay between the end of a run and the start of the next
+	 * @param task returns false to be dropped
+	 * @return id of the task, @see wake()
+	 */
+	TaskId schedulePeriodic(
+	        const std::string& name, std::chrono::milliseconds period,
+	        const std::function<bool()>& task );
+
+	/**
+	 * Run the given periodic task as soon as possible instead of waiting for
+	 * the end of its period. If the task is running, it runs again right
+	 * after. Does nothing if the task has been dropped.
+	 */
+	void wake(TaskId id);
+
+	struct TaskStatistic
+	{
+		std::string mName;
+		uint64_t mRuns;
+
+		/// CPU time used by the task, 0 where it cannot be measured
+		uint64_t mCpuTimeUs;
+		uint64_t mWallTimeUs;
+
+		/// Wall time of the longest run
+		uint64_t mMaxWallTimeUs;
+	};
+
+	/** Statistics of the periodic tasks which are still scheduled */
+	void getTaskStatistics(std::vector<TaskStatistic>& stats);
+
+	/** Number of worker threads */
+	uint32_t threadCount() const { return static_cast<uint32_t>(mWorkers.size()); }
+
+private:
+	explicit RsExecutor(uint32_t threads);
+	~RsExecutor();
+
+	class Worker;
+	class TimerThread;
+	struct Task;
+	typedef std::shared_ptr<Task> TaskPtr;
+
+	void workerLoop(uint32_t index);
+	bool popJob(uint32_t index, std::function<void()>& job);
+	void pushJob(const std::function<void()>& job);
+
+	void timerLoop();
+	void runTask(const TaskPtr& task);
+
+	void locked_enqueue(const TaskPtr& task);
+	void locked_addToWheel(const TaskPtr& task, std::chrono::milliseconds delay);
+	void locked_removeFromWheel(const TaskPtr& task);
+
+	std::vector<Worker*> mWorkers;
+	std::atomic<uint32_t> mNextWorker;
+
+	/// Number of queued jobs, workers sleep on mIdleCv when there is none
+	std::atomic<uint32_t> mPendingJobs;
+	std::mutex mIdleMtx;
+	std::condition_variable mIdleCv;
+
+	std::atomic<bool> mStop;
+
+	/* Timer wheel, and state of all the periodic tasks */
+	std::mutex mTimerMtx;
+	std::condition_variable mTimerCv;
+	TimerThread* mTimerThread;
+
+	std::vector<std::list<TaskPtr> > mWheel;
+	uint32_t mWheelCursor;   /// next slot to expire
+	std::chrono::steady_clock::time_point mWheelCursorTime;
+	uint32_t mWheelCount;    /// tasks in the wheel
+	std::chrono::steady_clock::time_point mTimerWakeTime;
+
+	std::map<TaskId, TaskPtr> mTasks;
+	TaskId mLastTaskId;
+
+	static std::atomic<uint32_t> sThreadCount;
+	static std::atomic<RsExecutor*> sInstance;
+	static RsMutex sInstanceMtx;
+};
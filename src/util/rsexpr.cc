@@ -181,6 +181,55 @@ bool StringExpression :: evalStr ( const std::string &str ){
     return false;
 }
 
+bool StringExpression::containedTerms(std::list<std::string>& res) const
+{
+    if(terms.empty())
+        return Op != ContainsAllStrings;	// nothing matches, or everything does
+
+    switch (Op) {
+    case ContainsAnyStrings:
+    case EqualsString:
+        res.insert(res.end(),terms.begin(),terms.end());
+        return true;
+    case ContainsAllStrings:
+        // all terms are required. Any of them will do, and the longest one is likely the most selective.
+        res.push_back(*std::max_element(terms.begin(), terms.end(),
+                      [](const std::string& a,const std::string& b) { return a.size() < b.size(); }));
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool CompoundExpression::nameTerms(std::list<std::string>& terms) const
+{
+    if (Lexp == NULL or Rexp == NULL)
+        return false;
+
+    std::list<std::string> lterms, rterms;
+    bool lok = Lexp->nameTerms(lterms);
+    bool rok = Rexp->nameTerms(rterms);
+
+    switch (Op) {
+    case AndOp:		// either side is enough. Keep the one with fewer alternatives.
+        if(lok && (!rok || lterms.size() <= rterms.size()))
+            terms.splice(terms.end(), lterms);
+        else if(rok)
+            terms.splice(terms.end(), rterms);
+        else
+            return false;
+        return true;
+    case OrOp:
+        if(!lok || !rok)
+            return false;
+        terms.splice(terms.end(), lterms);
+        terms.splice(terms.end(), rterms);
+        return true;
+    default:
+        return false;
+    }
+}
+
 /*************************************************************************
  * linearization code
  *************************************************************************/
@@ -0,0 +1,266 @@
+/*******************************************************************************
+ * libretroshare/src/util: rsiblt.h                                            *
+ *                                                                             *
+ * libretroshare: retroshare core library                                      *
+ *                                                                             *
+ * Copyright (C) 2026  RetroShare Team <contact@retroshare.cc>                 *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Lesser General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ *******************************************************************************/
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+/**
+ * Invertible Bloom lookup table of fixed size keys, used to reconcile two sets
+ * of keys held by different peers. Each side inserts its keys in a table of the
+ * same number of cells, one table is sent and subtracted from the other, and the
+ * difference of both sets is decoded from the result. The size of the tables
+ * only depends on the expected size of that difference, not on the size of the
+ * sets.
+ * Each key is added to NB_HASHES cells, one in each part of the table. A cell
+ * holds the number of keys added to it, and the xor of these keys and of their
+ * checksums, so that a cell holding a single key can be recognised and the key
+ * read from it, which is how decoding proceeds.
+ * Decoding fails, without error in the keys it returns, when the difference is
+ * too large for the table. The caller then has to fall back to sending the sets.
+ */
+template<uint32_t KEY_SIZE> class RsIblt
+{
+public:
+	typedef std::array<uint8_t, KEY_SIZE> Key;
+
+	static constexpr uint32_t NB_HASHES = 3;
+
+	/** Size of a serialised cell, in bytes */
+	static constexpr uint32_t CELL_SIZE = 8 + KEY_SIZE;
+
+	RsIblt() {}
+	explicit RsIblt(uint32_t nbCells) { reset(nbCells); }
+
+	/**
+	 * Number of cells giving a good chance of decoding a difference of the
+	 * given number of keys. Small tables need proportionally more room.
+	 */
+	static uint32_t cellsForDifference(uint32_t nbKeys)
+	{ return 2*nbKeys + 10*NB_HASHES; }
+
+	/** Empty the table and size it, rounding up to a multiple of NB_HASHES */
+	void reset(uint32_t nbCells)
+	{
+		nbCells = (nbCells + NB_HASHES - 1) / NB_HASHES * NB_HASHES;
+		if(!nbCells) nbCells = NB_HASHES;
+
+		mCells.assign(nbCells, Cell());
+	}
+
+	uint32_t cellCount() const { return static_cast<uint32_t>(mCells.size()); }
+
+	void insert(const Key& key) { update(key, 1); }
+	void erase(const Key& key) { update(key, -1); }
+
+	/**
+	 * Remove the keys of another table of the same size. This table then
+	 * holds the difference of both sets.
+	 * @return false if the sizes differ
+	 */
+	bool subtract(const RsIblt& other)
+	{
+		if(other.mCells.size() != mCells.size()) return false;
+
+		for(size_t i = 0; i < mCells.size(); ++i)
+		{
+			mCells[i].count -= other.mCells[i].count;
+			mCells[i].check ^= other.mCells[i].check;
+
+			for(uint32_t k = 0; k < KEY_SIZE; ++k)
+				mCells[i].key[k] ^= other.mCells[i].key[k];
+		}
+		return true;
+	}
+
+	/**
+	 * Extract the keys of the table, emptying it. After subtract(), they are
+	 * the keys of this set missing from the other one, and the other way round.
+	 * @param inserted keys inserted here, or only in this set
+	 * @param erased keys erased from here, or only in the subtracted set
+	 * @return false if the table could not be fully decoded, in which case the
+	 *   keys found so far are still correct but incomplete. Tables received
+	 *   from others may be forged, decoding one then stops after cellCount()
+	 *   keys, which is more than any genuine table holds, and fails.
+	 */
+	bool decode(std::vector<Key>& inserted, std::vector<Key>& erased)
+	{
+		bool progress = true;
+		uint32_t nbDecoded = 0;
+
+		while(progress)
+		{
+			progress = false;
+
+			for(uint32_t i = 0; i < cellCount(); ++i)
+			{
+				const Cell& c(mCells[i]);
+
+				if((c.count != 1 && c.count != -1) || c.check != checksum(c.key))
+					continue;
+
+				/* A key in a cell it does not hash to is garbage, peeling it
+				 * would leave the cell untouched and loop forever */
+				Key key(c.key);
+				if(!hashesTo(key, i)) continue;
+
+				if(++nbDecoded > cellCount()) return false;
+
+				int32_t sign = c.count;
+				(sign > 0 ? inserted : erased).push_back(key);
+				update(key, -sign);
+				progress = true;
+			}
+		}
+
+		for(size_t i = 0; i < mCells.size(); ++i)
+			if(!mCells[i].empty())
+				return false;
+
+		return true;
+	}
+
+	/** Serialise the cells, in a byte order independent way */
+	void toBytes(std::vector<uint8_t>& bytes) const
+	{
+		bytes.resize(mCells.size() * CELL_SIZE);
+		uint8_t* p = bytes.data();
+
+		for(size_t i = 0; i < mCells.size(); ++i, p += CELL_SIZE)
+		{
+			putU32(p, static_cast<uint32_t>(mCells[i].count));
+			putU32(p + 4, mCells[i].check);
+			memcpy(p + 8, mCells[i].key.data(), KEY_SIZE);
+		}
+	}
+
+	/**
+	 * Load cells serialised by toBytes()
+	 * @return false if the data is not a valid table of at most maxCells cells
+	 */
+	bool fromBytes(const uint8_t* data, uint32_t size, uint32_t maxCells)
+	{
+		uint32_t nbCells = size / CELL_SIZE;
+
+		if( !data || !nbCells || size % CELL_SIZE || nbCells % NB_HASHES
+		        || nbCells > maxCells )
+			return false;
+
+		mCells.resize(nbCells);
+
+		for(uint32_t i = 0; i < nbCells; ++i, data += CELL_SIZE)
+		{
+			mCells[i].count = static_cast<int32_t>(getU32(data));
+			mCells[i].check = getU32(data + 4);
+			memcpy(mCells[i].key.data(), data + 8, KEY_SIZE);
+		}
+		return true;
+	}
+
+private:
+	struct Cell
+	{
+		Cell() : count(0), check(0) { key.fill(0); }
+
+		bool empty() const
+		{
+			if(count || check) return false;
+			for(uint32_t k = 0; k < KEY_SIZE; ++k) if(key[k]) return false;
+			return true;
+		}
+
+		int32_t count;
+		uint32_t check;
+		Key key;
+	};
+
+	/** Position of the key in the given part of the table */
+	uint32_t cellIndex(uint64_t keyHash, uint32_t part) const
+	{
+		uint32_t partSize = cellCount() / NB_HASHES;
+		return part*partSize +
+		        static_cast<uint32_t>(
+		            mix(keyHash + part*0x9e3779b97f4a7c15ULL) % partSize );
+	}
+
+	bool hashesTo(const Key& key, uint32_t index) const
+	{
+		uint64_t h = hash(key);
+		uint32_t part = index / (cellCount() / NB_HASHES);
+		return cellIndex(h, part) == index;
+	}
+
+	void update(const Key& key, int32_t delta)
+	{
+		uint64_t h = hash(key);
+		uint32_t check = checksum(key);
+
+		for(uint32_t i = 0; i < NB_HASHES; ++i)
+		{
+			Cell& c(mCells[cellIndex(h, i)]);
+
+			c.count += delta;
+			c.check ^= check;
+
+			for(uint32_t k = 0; k < KEY_SIZE; ++k)
+				c.key[k] ^= key[k];
+		}
+	}
+
+	/* FNV-1a. Keys are usually hashes already, but they are mixed anyway so
+	 * that structured keys spread as well. */
+	static uint64_t hash(const Key& key)
+	{
+		uint64_t h = 0xcbf29ce484222325ULL;
+
+		for(uint32_t k = 0; k < KEY_SIZE; ++k)
+			h = (h ^ key[k]) * 0x100000001b3ULL;
+
+		return h;
+	}
+
+	/* The checksum must not depend on the cell positions, so it comes from a
+	 * different mixing of the hash. */
+	static uint32_t checksum(const Key& key)
+	{ return static_cast<uint32_t>(mix(hash(key) ^ 0x5bd1e9955bd1e995ULL) >> 32); }
+
+	static uint64_t mix(uint64_t x)
+	{
+		x ^= x >> 33; x *= 0xff51afd7ed558ccdULL;
+		x ^= x >> 33; x *= 0xc4ceb9fe1a85ec53ULL;
+		x ^= x >> 33;
+		return x;
+	}
+
+	static void putU32(uint8_t* p, uint32_t v)
+	{ p[0] = v & 0xff; p[1] = (v >> 8) & 0xff; p[2] = (v >> 16) & 0xff; p[3] = v >> 24; }
+
+	static uint32_t getU32(const uint8_t* p)
+	{
+		return uint32_t(p[0]) | (uint32_t(p[1]) << 8) | (uint32_t(p[2]) << 16)
+		        | (uint32_t(p[3]) << 24);
+	}
+
+	std::vector<Cell> mCells;
+};
@@ -0,0 +1,156 @@
+/*******************************************************************************
+ * libretroshare/src/util: rsiptrie.h                                          *
+ *                                                                             *
+ * libretroshare: retroshare core library                                      *
+ *                                                                             *
+ * Copyright (C) 2026  RetroShare Team <contact@retroshare.cc>                 *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Lesser General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ *******************************************************************************/
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "util/rsnet.h"
+
+/**
+ * Binary trie of IP prefixes, answering longest prefix match queries on IPv4
+ * and IPv6 addresses. Each family has its own root, and a prefix of any length
+ * can be stored (0 to 32 bits for IPv4, 0 to 128 bits for IPv6). Address bits
+ * past the prefix length are ignored, so ranges can be given with their host
+ * part either cleared or set.
+ * Nodes are kept in a single vector and refer to their children by index, so
+ * that the whole trie is a couple of allocations and lookups only follow
+ * indexes. There is no removal: the trie is meant to be rebuilt when the set of
+ * prefixes changes, and then only read, possibly from several threads.
+ * Values are returned by pointer, so T cannot be bool (std::vector<bool>).
+ */
+template<class T> class RsIpPrefixTrie
+{
+public:
+	RsIpPrefixTrie() { clear(); }
+
+	void clear()
+	{
+		mNodes.assign(2, Node()); // IPv4 and IPv6 roots
+		mValues.clear();
+	}
+
+	size_t size() const { return mValues.size(); }
+	bool empty() const { return mValues.empty(); }
+
+	/**
+	 * Add a prefix, replacing the value previously stored for the same prefix.
+	 * @return false if the address is neither IPv4 nor IPv6
+	 */
+	bool insert( const sockaddr_storage& addr, uint32_t prefixLen,
+	             const T& value )
+	{
+		const uint8_t* key; uint32_t keyBits; uint32_t node;
+		if(!getKey(addr, key, keyBits, node)) return false;
+
+		if(prefixLen > keyBits) prefixLen = keyBits;
+
+		for(uint32_t i = 0; i < prefixLen; ++i)
+		{
+			uint32_t b = bit(key, i);
+
+			if(!mNodes[node].child[b])
+			{
+				mNodes[node].child[b] = static_cast<uint32_t>(mNodes.size());
+				mNodes.push_back(Node());
+			}
+			node = mNodes[node].child[b];
+		}
+
+		if(mNodes[node].value == NO_VALUE)
+		{
+			mNodes[node].value = static_cast<uint32_t>(mValues.size());
+			mValues.push_back(value);
+		}
+		else mValues[mNodes[node].value] = value;
+
+		return true;
+	}
+
+	/**
+	 * Find the longest stored prefix containing the address.
+	 * @param prefixLen optional storage for the length of the matching prefix
+	 * @return the value of the matching prefix, nullptr if none
+	 */
+	const T* longestMatch( const sockaddr_storage& addr,
+	                       uint32_t* prefixLen = nullptr ) const
+	{
+		const uint8_t* key; uint32_t keyBits; uint32_t node;
+		if(!getKey(addr, key, keyBits, node)) return nullptr;
+
+		const T* res = nullptr;
+
+		for(uint32_t i = 0; ; ++i)
+		{
+			if(mNodes[node].value != NO_VALUE)
+			{
+				res = &mValues[mNodes[node].value];
+				if(prefixLen) *prefixLen = i;
+			}
+
+			if(i == keyBits) break;
+
+			node = mNodes[node].child[bit(key, i)];
+			if(!node) break;
+		}
+
+		return res;
+	}
+
+private:
+	static constexpr uint32_t NO_VALUE = ~static_cast<uint32_t>(0);
+
+	struct Node
+	{
+		Node() : value(NO_VALUE) { child[0] = child[1] = 0; }
+
+		/* Roots are never children, so index 0 means no child. */
+		uint32_t child[2];
+		uint32_t value;
+	};
+
+	static uint32_t bit(const uint8_t* key, uint32_t i)
+	{ return (key[i >> 3] >> (7 - (i & 7))) & 1; }
+
+	/* Address bytes in network order, their number of bits, and the root. */
+	static bool getKey( const sockaddr_storage& addr, const uint8_t*& key,
+	                    uint32_t& keyBits, uint32_t& root )
+	{
+		switch(addr.ss_family)
+		{
+		case AF_INET:
+			key = reinterpret_cast<const uint8_t*>(
+			            &reinterpret_cast<const sockaddr_in&>(addr).sin_addr );
+			keyBits = 32; root = 0;
+			return true;
+		case AF_INET6:
+			key = reinterpret_cast<const sockaddr_in6&>(addr).sin6_addr.s6_addr;
+			keyBits = 128; root = 1;
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	std::vector<Node> mNodes;
+	std::vector<T> mValues;
+};
@@ -0,0 +1,233 @@
+/*******************************************************************************
+ * libretroshare/src/util: rssha1hashtable.h                                   *
+ *                                                                             *
+ * libretroshare: retroshare core library                                      *
+ *                                                                             *
+ * Copyright (C) 2026  RetroShare Team <contact@retroshare.cc>                 *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Lesser General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ *******************************************************************************/
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <vector>
+
+#include "retroshare/rsids.h"
+
+/**
+ * Flat hash table indexed by SHA1 digests (file hashes, directory hashes...),
+ * meant as a drop-in replacement for std::map<Sha1CheckSum,T> where ordering
+ * is not needed.
+ * Keys are already uniformly distributed, so the first bytes of the key are
+ * used directly as the hash. Collisions are resolved with linear probing, and
+ * erase shifts the following entries back so no tombstone is ever left.
+ * Occupancy is kept in a separate byte array so that probing mostly touches a
+ * single cache line.
+ * Unlike std::map, insert and erase invalidate iterators and references, and
+ * iteration order is unspecified.
+ */
+template<class T> class RsSha1HashTable
+{
+public:
+	typedef Sha1CheckSum key_type;
+	typedef T mapped_type;
+
+	struct value_type
+	{
+		Sha1CheckSum first;
+		T second;
+	};
+
+	template<class Table, class Value> class t_iterator
+	{
+	public:
+		typedef std::forward_iterator_tag iterator_category;
+		typedef typename RsSha1HashTable::value_type value_type;
+		typedef std::ptrdiff_t difference_type;
+		typedef Value* pointer;
+		typedef Value& reference;
+
+		t_iterator() : mTable(nullptr), mPos(0) {}
+		t_iterator(Table* table, size_t pos) : mTable(table), mPos(pos)
+		{ skipEmpty(); }
+
+		/// Allow conversion from iterator to const_iterator
+		template<class T2, class V2> t_iterator(const t_iterator<T2,V2>& it) :
+		    mTable(it.mTable), mPos(it.mPos) {}
+
+		reference operator*() const { return mTable->mSlots[mPos]; }
+		pointer operator->() const { return &mTable->mSlots[mPos]; }
+
+		t_iterator& operator++() { ++mPos; skipEmpty(); return *this; }
+		t_iterator operator++(int) { t_iterator r(*this); ++*this; return r; }
+
+		bool operator==(const t_iterator& o) const { return mPos == o.mPos; }
+		bool operator!=(const t_iterator& o) const { return mPos != o.mPos; }
+
+	private:
+		void skipEmpty()
+		{
+			while(mPos < mTable->mUsed.size() && !mTable->mUsed[mPos]) ++mPos;
+		}
+
+		Table* mTable;
+		size_t mPos;
+
+		template<class T2, class V2> friend class t_iterator;
+		friend class RsSha1HashTable;
+	};
+
+	typedef t_iterator<RsSha1HashTable, value_type> iterator;
+	typedef t_iterator<const RsSha1HashTable, const value_type> const_iterator;
+
+	RsSha1HashTable() : mSize(0), mMask(0) {}
+
+	size_t size() const { return mSize; }
+	bool empty() const { return mSize == 0; }
+
+	iterator begin() { return iterator(this, 0); }
+	iterator end() { return iterator(this, mUsed.size()); }
+	const_iterator begin() const { return const_iterator(this, 0); }
+	const_iterator end() const { return const_iterator(this, mUsed.size()); }
+
+	iterator find(const Sha1CheckSum& key)
+	{ return iterator(this, findSlot(key)); }
+	const_iterator find(const Sha1CheckSum& key) const
+	{ return const_iterator(this, findSlot(key)); }
+
+	size_t count(const Sha1CheckSum& key) const
+	{ return findSlot(key) != mUsed.size(); }
+
+	T& operator[](const Sha1CheckSum& key)
+	{
+		size_t pos = findSlot(key);
+		if(pos != mUsed.size()) return mSlots[pos].second;
+
+		if((mSize + 1) * 4 > mUsed.size() * 3) grow(); // max load factor 3/4
+
+		pos = firstSlot(key);
+		while(mUsed[pos]) pos = (pos + 1) & mMask;
+
+		mUsed[pos] = 1;
+		mSlots[pos].first = key;
+		mSlots[pos].second = T();
+		++mSize;
+
+		return mSlots[pos].second;
+	}
+
+	size_t erase(const Sha1CheckSum& key)
+	{
+		size_t pos = findSlot(key);
+		if(pos == mUsed.size()) return 0;
+
+		eraseSlot(pos);
+		return 1;
+	}
+
+	void erase(const_iterator it) { eraseSlot(it.mPos); }
+
+	void clear()
+	{
+		mSlots.clear();
+		mUsed.clear();
+		mSize = 0;
+		mMask = 0;
+	}
+
+	/// Preallocate room for n entries
+	void reserve(size_t n)
+	{
+		size_t capacity = MIN_CAPACITY;
+		while(capacity * 3 < n * 4) capacity *= 2;
+		if(capacity > mUsed.size()) rehash(capacity);
+	}
+
+	/// Approximate memory used by the table, in bytes
+	size_t memoryUsage() const
+	{ return mSlots.capacity() * sizeof(value_type) + mUsed.capacity(); }
+
+private:
+	static const size_t MIN_CAPACITY = 16;
+
+	size_t firstSlot(const Sha1CheckSum& key) const
+	{
+		uint64_t h;
+		memcpy(&h, key.toByteArray(), sizeof(h));
+		return static_cast<size_t>(h) & mMask;
+	}
+
+	/// @return position of key, or mUsed.size() if not found
+	size_t findSlot(const Sha1CheckSum& key) const
+	{
+		if(!mSize) return mUsed.size();
+
+		for(size_t pos = firstSlot(key); mUsed[pos]; pos = (pos + 1) & mMask)
+			if(mSlots[pos].first == key) return pos;
+
+		return mUsed.size();
+	}
+
+	void eraseSlot(size_t pos)
+	{
+		mUsed[pos] = 0;
+		--mSize;
+
+		/* Move back the following entries of the cluster that would not be
+		 * reachable anymore from their first slot */
+		for(size_t next = (pos + 1) & mMask; mUsed[next]; next = (next + 1) & mMask)
+		{
+			size_t home = firstSlot(mSlots[next].first);
+
+			// is home cyclically outside of ]pos, next] ?
+			if( (next > pos && (home <= pos || home > next)) ||
+			        (next < pos && (home <= pos && home > next)) )
+			{
+				mSlots[pos] = std::move(mSlots[next]);
+				mUsed[pos] = 1;
+				mUsed[next] = 0;
+				pos = next;
+			}
+		}
+	}
+
+	void grow() { rehash(mUsed.empty() ? MIN_CAPACITY : 2 * mUsed.size()); }
+
+	void rehash(size_t capacity)
+	{
+		std::vector<value_type> oldSlots(capacity);
+		std::vector<uint8_t> oldUsed(capacity, 0);
+		oldSlots.swap(mSlots);
+		oldUsed.swap(mUsed);
+		mMask = capacity - 1;
+
+		for(size_t i = 0; i < oldUsed.size(); ++i)
+			if(oldUsed[i])
+			{
+				size_t pos = firstSlot(oldSlots[i].first);
+				while(mUsed[pos]) pos = (pos + 1) & mMask;
+
+				mUsed[pos] = 1;
+				mSlots[pos] = std::move(oldSlots[i]);
+			}
+	}
+
+	std::vector<value_type> mSlots;
+	std::vector<uint8_t> mUsed;
+	size_t mSize;
+	size_t mMask;
+};
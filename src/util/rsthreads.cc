@@ -25,6 +25,7 @@
 #include "rsthreads.h"
 
 #include "util/rsdebug.h"
+#include "util/rsexecutor.h"
 
 #include <chrono>
 #include <ctime>
@@ -223,6 +224,58 @@ bool RsThread::start(const std::string& threadName)
 	return false;
 }
 
+bool RsThread::markStarted(const std::string& threadName)
+{
+	if(mHasStopped.exchange(false))
+	{
+		mShouldStop = false;
+		mFullName = threadName;
+		return true;
+	}
+
+	RS_ERR("attempt to start already running thread: ", threadName);
+	print_stacktrace();
+	return false;
+}
+
+RsTickingThread::RsTickingThread() : mTaskId(0) {}
+
+bool RsTickingThread::startTicking(const std::string& threadName)
+{
+	RsExecutor* executor = RsExecutor::instance();
+	const std::chrono::milliseconds period = tickPeriod();
+
+	if(!executor || period.count() <= 0) return start(threadName);
+
+	if(!markStarted(threadName)) return false;
+
+	mTaskId = executor->schedulePeriodic(threadName, period, [this]()
+	{
+		if(shouldStop())
+		{
+			/* After markStopped() this may be deleted by whoever waits in
+			 * fullstop(), so it must be the last thing touching it */
+			mTaskId = 0;
+			markStopped();
+			return false;
+		}
+
+		executorTick();
+		return true;
+	});
+
+	return true;
+}
+
+void RsTickingThread::wakeTick()
+{
+	const uint64_t taskId = mTaskId;
+	if(!taskId) return;
+
+	RsExecutor* executor = RsExecutor::instance();
+	if(executor) executor->wake(taskId);
+}
+
 RsQueueThread::RsQueueThread(uint32_t min, uint32_t max, double relaxFactor )
     :mMinSleep(min), mMaxSleep(max), mRelaxFactor(relaxFactor)
 {
@@ -29,6 +29,7 @@
 #include <iostream>
 #include <unistd.h>
 #include <atomic>
+#include <chrono>
 #include <thread>
 #include <functional>
 
@@ -250,6 +251,18 @@ protected:
 	 * of this method, @see JsonApiServer for an usage example. */
 	virtual void onStopRequested() {}
 
+	/**
+	 * Mark the thread as started without creating a PThread, for subclasses
+	 * whose run loop is driven by someone else, @see RsTickingThread. From
+	 * there isRunning(), askForStop() and fullstop() work as usual, and
+	 * markStopped() must be called once the loop is over.
+	 * @return false if the thread is already running
+	 */
+	bool markStarted(const std::string& threadName);
+
+	/** @see markStarted() */
+	void markStopped() { mHasStopped = true; }
+
 #ifdef RS_THREAD_FORCE_STOP
 	/** Set last resort timeout to forcefully kill thread if it didn't stop
 	 * nicely, one should never use this, still we needed to introduce this
@@ -306,6 +319,7 @@ private:
 class RsTickingThread: public RsThread
 {
 public:
+	RsTickingThread();
 
 	/**
 	 * Subclasses must implement this method, it will be called in a loop once
@@ -316,9 +330,42 @@ public:
 	 */
 	virtual void threadTick() = 0;
 
+	/**
+	 * Like start(), but if the shared RsExecutor is enabled and the subclass
+	 * supports it, @see tickPeriod(), executorTick() is run as a periodic task
+	 * of the executor instead of calling threadTick() on an own thread.
+	 * Either way the ticking is stopped with askForStop() or fullstop().
+	 */
+	bool startTicking(const std::string& threadName);
+
+protected:
+	/**
+	 * Subclasses whose threadTick() is some work followed by a sleep can also
+	 * implement this with the work alone, and return the sleep duration from
+	 * tickPeriod(), to be run on the executor. It must not sleep, as it holds
+	 * one of the executor worker threads meanwhile.
+	 */
+	virtual void executorTick() {}
+
+	/** Delay between two executorTick() calls, zero if not implemented */
+	virtual std::chrono::milliseconds tickPeriod() const
+	{ return std::chrono::milliseconds(0); }
+
+	/**
+	 * When running on the executor, call executorTick() as soon as possible
+	 * instead of waiting for the end of the period. Does nothing otherwise.
+	 */
+	void wakeTick();
+
+	/// Don't wait for the end of the period to notice the stop request
+	void onStopRequested() override { wakeTick(); }
+
 private:
 	/// Implement the run loop and continuously call threadTick() in it
 	void run() override { while(!shouldStop()) threadTick(); }
+
+	/// Id of the executor task, 0 when not running on the executor
+	std::atomic<uint64_t> mTaskId;
 };
 
 // TODO: Used just one time, is this really an useful abstraction?
@@ -0,0 +1,172 @@
+/*******************************************************************************
+ * unittests/libretroshare/crypto/rsaes_test.cc                                *
+ *                                                                             *
+ * Copyright (C) 2026  RetroShare Team <contact@retroshare.cc>                 *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Affero General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <string.h>
+#include <vector>
+#include <openssl/hmac.h>
+
+// from libretroshare
+
+#include "crypto/rsaes.h"
+
+TEST(libretroshare_crypto, RsAESSession)
+{
+	uint8_t key[16];
+	for(int i=0;i<16;++i) key[i] = 17*i+3;
+
+	RsAESSession session(key);
+
+	// The session must give the same output as the stateless functions, packet after packet.
+
+	for(uint32_t n=0;n<300;n+=37)
+	{
+		std::vector<uint8_t> clear(n);
+		for(uint32_t i=0;i<n;++i) clear[i] = i*7+n;
+
+		uint8_t salt[8];
+		for(int i=0;i<8;++i) salt[i] = n+i;
+
+		uint32_t ref_size = RsAES::get_buffer_size(n);
+		uint32_t enc_size = ref_size;
+		std::vector<uint8_t> ref(ref_size), enc(enc_size);
+
+		ASSERT_TRUE(RsAES::aes_crypt_8_16(clear.data(), n, key, salt, ref.data(), ref_size));
+		ASSERT_TRUE(session.encrypt(clear.data(), n, salt, enc.data(), enc_size));
+		ASSERT_EQ(enc_size, ref_size);
+		EXPECT_EQ(memcmp(enc.data(), ref.data(), enc_size), 0);
+
+		uint32_t dec_size = RsAES::get_buffer_size(enc_size);
+		std::vector<uint8_t> dec(dec_size);
+
+		ASSERT_TRUE(session.decrypt(enc.data(), enc_size, salt, dec.data(), dec_size));
+		ASSERT_EQ(dec_size, n);
+		EXPECT_EQ(memcmp(dec.data(), clear.data(), n), 0);
+
+		uint8_t md[20], ref_md[20];
+		unsigned int md_len = 20;
+
+		ASSERT_TRUE(session.hmac(enc.data(), enc_size, md));
+		HMAC(EVP_sha1(), key, 16, enc.data(), enc_size, ref_md, &md_len);
+		EXPECT_EQ(memcmp(md, ref_md, 20), 0);
+	}
+
+	// too small output buffer
+
+	uint8_t salt[8] = {0};
+	uint8_t buf[64];
+	uint32_t size = 16;
+	EXPECT_FALSE(session.encrypt(buf, 32, salt, buf, size));
+}
+
+TEST(libretroshare_crypto, HKDF_SHA256)
+{
+	// RFC 5869, test cases 1 and 3
+
+	uint8_t ikm[22];
+	memset(ikm, 0x0b, 22);
+
+	uint8_t salt[13];
+	for(int i=0;i<13;++i) salt[i] = i;
+
+	uint8_t info[10];
+	for(int i=0;i<10;++i) info[i] = 0xf0 + i;
+
+	const uint8_t okm1[42] = {
+	    0x3c,0xb2,0x5f,0x25,0xfa,0xac,0xd5,0x7a,0x90,0x43,0x4f,0x64,0xd0,0x36,0x2f,0x2a,
+	    0x2d,0x2d,0x0a,0x90,0xcf,0x1a,0x5a,0x4c,0x5d,0xb0,0x2d,0x56,0xec,0xc4,0xc5,0xbf,
+	    0x34,0x00,0x72,0x08,0xd5,0xb8,0x87,0x18,0x58,0x65 };
+	const uint8_t okm3[42] = {
+	    0x8d,0xa4,0xe7,0x75,0xa5,0x63,0xc1,0x8f,0x71,0x5f,0x80,0x2a,0x06,0x3c,0x5a,0x31,
+	    0xb8,0xa1,0x1f,0x5c,0x5e,0xe1,0x87,0x9e,0xc3,0x45,0x4e,0x5f,0x3c,0x73,0x8d,0x2d,
+	    0x9d,0x20,0x13,0x95,0xfa,0xa4,0xb6,0x1a,0x96,0xc8 };
+
+	uint8_t okm[42];
+
+	ASSERT_TRUE(RsAEADSession::hkdf_sha256(ikm, 22, salt, 13, info, 10, okm, 42));
+	EXPECT_EQ(memcmp(okm, okm1, 42), 0);
+
+	ASSERT_TRUE(RsAEADSession::hkdf_sha256(ikm, 22, NULL, 0, NULL, 0, okm, 42));
+	EXPECT_EQ(memcmp(okm, okm3, 42), 0);
+
+	EXPECT_FALSE(RsAEADSession::hkdf_sha256(ikm, 22, salt, 13, info, 10, okm, 255*32+1));
+}
+
+TEST(libretroshare_crypto, RsAEADSession)
+{
+	uint8_t secret[128];
+	for(int i=0;i<128;++i) secret[i] = 13*i+5;
+
+	uint8_t salt[16];
+	for(int i=0;i<16;++i) salt[i] = i;
+
+	RsAEADSession client(secret, 128, salt, 16, "test", true);
+	RsAEADSession server(secret, 128, salt, 16, "test", false);
+
+	for(uint32_t n=1;n<300;n+=37)
+	{
+		std::vector<uint8_t> clear(n);
+		for(uint32_t i=0;i<n;++i) clear[i] = i*7+n;
+
+		std::vector<uint8_t> data(clear);
+		uint8_t tag[RsAEADSession::TAG_SIZE];
+		uint64_t counter = 0;
+
+		ASSERT_TRUE(client.encrypt(data.data(), n, counter, tag));
+		EXPECT_EQ(counter, n/37);
+
+		// each end sends under its own key
+
+		std::vector<uint8_t> copy(data);
+		EXPECT_FALSE(client.decrypt(copy.data(), n, counter, tag));
+
+		// a wrong counter does not authenticate
+
+		copy = data;
+		EXPECT_FALSE(server.decrypt(copy.data(), n, counter+1, tag));
+
+		copy = data;
+		copy[n/2] ^= 1;
+		EXPECT_FALSE(server.decrypt(copy.data(), n, counter, tag));
+
+		ASSERT_TRUE(server.decrypt(data.data(), n, counter, tag));
+		EXPECT_EQ(data, clear);
+	}
+
+	// and the other way round
+
+	std::vector<uint8_t> data(100, 0x42);
+	uint8_t tag[RsAEADSession::TAG_SIZE];
+	uint64_t counter = 1;
+
+	ASSERT_TRUE(server.encrypt(data.data(), 100, counter, tag));
+	EXPECT_EQ(counter, 0u);
+	EXPECT_NE(data, std::vector<uint8_t>(100, 0x42));
+	ASSERT_TRUE(client.decrypt(data.data(), 100, counter, tag));
+	EXPECT_EQ(data, std::vector<uint8_t>(100, 0x42));
+
+	// another salt gives other keys
+
+	RsAEADSession other(secret, 128, salt, 15, "test", false);
+
+	ASSERT_TRUE(client.encrypt(data.data(), 100, counter, tag));
+	EXPECT_FALSE(other.decrypt(data.data(), 100, counter, tag));
+}
@@ -0,0 +1,181 @@
+/*******************************************************************************
+ * unittests/libretroshare/dbase/retrodb_test.cc                               *
+ *                                                                             *
+ * Copyright (C) 2026  RetroShare Team <contact@retroshare.cc>                 *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Affero General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <stdio.h>
+
+// from libretroshare
+
+#include "util/retrodb.h"
+
+#define RETRODB_TEST_DB "retrodb_test_db"
+
+static void createTable(RetroDb& db)
+{
+	ASSERT_TRUE(db.isOpen());
+	ASSERT_TRUE(db.execSQL("CREATE TABLE items (id INT PRIMARY KEY, name TEXT, value INT);"));
+}
+
+static ContentValue makeRow(int32_t id)
+{
+	ContentValue cv;
+	cv.put("id", id);
+	cv.put("name", "item " + std::to_string(id));
+	cv.put("value", id * 10);
+
+	return cv;
+}
+
+static int32_t countRows(RetroDb& db, const std::string& selection)
+{
+	std::list<std::string> columns;
+	columns.push_back("id");
+
+	RetroCursor* c = db.sqlQuery("items", columns, selection, "");
+	int32_t count = 0;
+
+	if(c && c->moveToFirst())
+	{
+		do
+			++count;
+		while(c->moveToNext());
+	}
+
+	delete c;
+	return count;
+}
+
+TEST(libretroshare_dbase, RetroDb_InsertBulk)
+{
+	remove(RETRODB_TEST_DB);
+
+	{
+		RetroDb db(RETRODB_TEST_DB, RetroDb::OPEN_READWRITE_CREATE);
+		createTable(db);
+
+		std::list<ContentValue> rows;
+
+		for(int32_t i=0;i<100;++i)
+			rows.push_back(makeRow(i));
+
+		EXPECT_TRUE(db.sqlInsertBulk("items", "", rows));
+		EXPECT_EQ(countRows(db, ""), 100);
+
+		// a failing row is skipped, the others are still inserted
+
+		rows.clear();
+		rows.push_back(makeRow(100));
+		rows.push_back(makeRow(0));		// duplicate primary key
+		rows.push_back(makeRow(101));
+
+		EXPECT_FALSE(db.sqlInsertBulk("items", "", rows));
+		EXPECT_EQ(countRows(db, ""), 102);
+
+		// the transaction of the caller is used, not committed
+
+		rows.clear();
+		rows.push_back(makeRow(200));
+
+		ASSERT_TRUE(db.beginTransaction());
+		EXPECT_TRUE(db.sqlInsertBulk("items", "", rows));
+		EXPECT_TRUE(db.rollbackTransaction());
+		EXPECT_EQ(countRows(db, "id=200"), 0);
+	}
+
+	// rows are on disc
+
+	{
+		RetroDb db(RETRODB_TEST_DB, RetroDb::OPEN_READWRITE);
+		ASSERT_TRUE(db.isOpen());
+		EXPECT_EQ(countRows(db, ""), 102);
+		EXPECT_EQ(countRows(db, "name='item 101' AND value=1010"), 1);
+	}
+
+	remove(RETRODB_TEST_DB);
+}
+
+TEST(libretroshare_dbase, RetroDb_StatementCache)
+{
+	remove(RETRODB_TEST_DB);
+
+	RetroDb db(RETRODB_TEST_DB, RetroDb::OPEN_READWRITE_CREATE);
+	createTable(db);
+
+	uint32_t cached = 0;
+	uint64_t hits = 0;
+
+	// inserts of the same columns share one statement
+
+	for(int32_t i=0;i<50;++i)
+		EXPECT_TRUE(db.sqlInsert("items", "", makeRow(i)));
+
+	db.getStatementCacheStatistics(cached, hits);
+	EXPECT_EQ(cached, 1u);
+	EXPECT_EQ(hits, 49u);
+
+	// updates embed the id in the where clause, they do not enter the cache
+
+	for(int32_t i=0;i<50;++i)
+	{
+		ContentValue cv;
+		cv.put("value", i + 1000);
+		EXPECT_TRUE(db.sqlUpdate("items", "id=" + std::to_string(i), cv));
+	}
+
+	EXPECT_EQ(countRows(db, "value>=1000"), 50);
+
+	for(int32_t i=0;i<10;++i)
+		EXPECT_TRUE(db.sqlDelete("items", "id=" + std::to_string(i), ""));
+
+	EXPECT_EQ(countRows(db, ""), 40);
+
+	db.getStatementCacheStatistics(cached, hits);
+	EXPECT_EQ(cached, 1u);
+	EXPECT_EQ(hits, 49u);
+
+	// so the insert statement is still there
+
+	EXPECT_TRUE(db.sqlInsert("items", "", makeRow(50)));
+
+	db.getStatementCacheStatistics(cached, hits);
+	EXPECT_EQ(cached, 1u);
+	EXPECT_EQ(hits, 50u);
+
+	// other columns get their own statement
+
+	ContentValue cv;
+	cv.put("id", (int32_t)51);
+	EXPECT_TRUE(db.sqlInsert("items", "", cv));
+	EXPECT_TRUE(db.sqlInsert("items", "", makeRow(52)));
+
+	db.getStatementCacheStatistics(cached, hits);
+	EXPECT_EQ(cached, 2u);
+	EXPECT_EQ(hits, 51u);
+
+	// cached statements do not prevent closing
+
+	db.closeDb();
+	EXPECT_FALSE(db.isOpen());
+	db.getStatementCacheStatistics(cached, hits);
+	EXPECT_EQ(cached, 0u);
+
+	remove(RETRODB_TEST_DB);
+}
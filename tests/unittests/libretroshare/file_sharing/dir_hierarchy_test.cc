@@ -0,0 +1,195 @@
+/*******************************************************************************
+ * unittests/libretroshare/file_sharing/dir_hierarchy_test.cc                  *
+ *                                                                             *
+ * Copyright (C) 2026  RetroShare Team <contact@retroshare.cc>                 *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Affero General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <iostream>
+
+// from libretroshare
+
+#include "file_sharing/dir_hierarchy.h"
+#include "util/rsdir.h"
+
+typedef InternalFileHierarchyStorage::FileStorageNode FileStorageNode;
+typedef DirectoryStorage::EntryIndex EntryIndex;
+
+static RsFileHash makeHash(const std::string& s)
+{ return RsDirUtil::sha1sum((const unsigned char*)s.data(), s.size()); }
+
+TEST(libretroshare_file_sharing, InternalFileHierarchyStorage)
+{
+	InternalFileHierarchyStorage st;
+	RsFileHash salt = makeHash("salt");
+	std::string err;
+
+	std::set<std::string> dirs = { "a", "b", "c" };
+	EXPECT_TRUE(st.updateSubDirectoryList(0, dirs, salt));
+
+	const InternalFileHierarchyStorage::DirEntry* root = st.getDirEntry(0);
+	ASSERT_TRUE(root != nullptr);
+	ASSERT_EQ(st.subDirs(*root).size(), 3u);
+
+	// fill each dir with files, and hash them
+	std::map<std::string,DirectoryStorage::FileTS> files, new_files;
+	for(int i=0;i<100;++i)
+	{
+		files["file_" + std::to_string(i) + ".txt"].size = i;
+		files["file_" + std::to_string(i) + ".txt"].modtime = 1000 + i;
+	}
+
+	std::vector<EntryIndex> subdirs(
+	            st.subDirs(*st.getDirEntry(0)).begin(),
+	            st.subDirs(*st.getDirEntry(0)).end() );
+	for(EntryIndex d : subdirs)
+	{
+		EXPECT_TRUE(st.updateSubFilesList(d, files, new_files));
+		EXPECT_EQ(new_files.size(), files.size());
+
+		const InternalFileHierarchyStorage::DirEntry* de = st.getDirEntry(d);
+		ASSERT_TRUE(de != nullptr);
+		ASSERT_EQ(st.subFiles(*de).size(), files.size());
+
+		std::vector<EntryIndex> subfiles(
+		            st.subFiles(*de).begin(), st.subFiles(*de).end() );
+		for(EntryIndex f : subfiles)
+		{
+			InternalFileHierarchyStorage::FileEntry fe;
+			ASSERT_TRUE(st.getFileEntry(f, fe));
+			EXPECT_EQ(fe.parent_index, d);
+			EXPECT_TRUE(files.count(fe.file_name));
+			EXPECT_TRUE(st.updateHash(f, makeHash(de->dir_name + fe.file_name)));
+		}
+	}
+
+	SharedDirStats stats;
+	st.getStatistics(stats);
+	EXPECT_EQ(stats.total_number_of_files, 300u);
+	EXPECT_EQ(stats.total_shared_size, 3u*4950u);
+	EXPECT_GT(stats.total_memory_usage, 0u);
+
+	// unchanged files are not reported as new
+	EXPECT_TRUE(st.updateSubFilesList(subdirs[0], files, new_files));
+	EXPECT_TRUE(new_files.empty());
+
+	// lookups by hash
+	EntryIndex idx;
+	EXPECT_TRUE(st.searchHash(makeHash("bfile_42.txt"), idx));
+	InternalFileHierarchyStorage::FileEntry fe;
+	ASSERT_TRUE(st.getFileEntry(idx, fe));
+	EXPECT_EQ(fe.file_name, "file_42.txt");
+	EXPECT_EQ(fe.file_size, 42u);
+	EXPECT_EQ(st.getDirEntry(fe.parent_index)->dir_name, "b");
+
+	// search, case insensitive
+	std::list<EntryIndex> results;
+	st.searchTerms({ "FILE_42." }, results);
+	EXPECT_EQ(results.size(), 3u);
+
+	// remove half the files of a dir many times, so that the name arena and
+	// children array get compacted
+	for(int n=0;n<50;++n)
+	{
+		std::map<std::string,DirectoryStorage::FileTS> some_files;
+		for(auto& it : files)
+			if(rand() & 1) some_files[it.first + std::to_string(n)] = it.second;
+
+		EXPECT_TRUE(st.updateSubFilesList(subdirs[2], some_files, new_files));
+		EXPECT_EQ(st.subFiles(*st.getDirEntry(subdirs[2])).size(), some_files.size());
+
+		for(EntryIndex f : st.subFiles(*st.getDirEntry(subdirs[2])))
+		{
+			ASSERT_TRUE(st.getFileEntry(f, fe));
+			EXPECT_TRUE(some_files.count(fe.file_name));
+		}
+	}
+	EXPECT_TRUE(st.check(err)) << err;
+
+	// remove a directory and its files
+	dirs.erase("a");
+	EXPECT_TRUE(st.updateSubDirectoryList(0, dirs, salt));
+	EXPECT_EQ(st.subDirs(*st.getDirEntry(0)).size(), 2u);
+	EXPECT_EQ(st.getType(subdirs[0]), (uint32_t)FileStorageNode::TYPE_UNKNOWN);
+	EXPECT_FALSE(st.searchHash(makeHash("afile_42.txt"), idx));
+	EXPECT_TRUE(st.check(err)) << err;
+
+	// save and reload
+	std::string fname = "dir_hierarchy_test.bin";
+	EXPECT_TRUE(st.save(fname));
+
+	InternalFileHierarchyStorage st2;
+	EXPECT_TRUE(st2.load(fname));
+	EXPECT_TRUE(st2.check(err)) << err;
+	RsDirUtil::removeFile(fname);
+
+	SharedDirStats stats2;
+	st.getStatistics(stats);
+	st2.getStatistics(stats2);
+	EXPECT_EQ(stats.total_number_of_files, stats2.total_number_of_files);
+	EXPECT_EQ(stats.total_shared_size, stats2.total_shared_size);
+
+	EXPECT_TRUE(st2.searchHash(makeHash("bfile_42.txt"), idx));
+	ASSERT_TRUE(st2.getFileEntry(idx, fe));
+	EXPECT_EQ(fe.file_name, "file_42.txt");
+}
+
+TEST(libretroshare_file_sharing, InternalFileHierarchyStorage_remote)
+{
+	InternalFileHierarchyStorage st;
+
+	std::vector<RsFileHash> subdirs_hashes = { makeHash("d1"), makeHash("d2") };
+	std::vector<InternalFileHierarchyStorage::FileEntry> subfiles;
+	for(int i=0;i<10;++i)
+		subfiles.push_back(InternalFileHierarchyStorage::FileEntry(
+		            "f" + std::to_string(i), i, 1000, makeHash("f" + std::to_string(i)) ));
+
+	EXPECT_TRUE(st.updateDirEntry(0, "", 1000, 1000, subdirs_hashes, subfiles));
+
+	const InternalFileHierarchyStorage::DirEntry* root = st.getDirEntry(0);
+	ASSERT_EQ(st.subDirs(*root).size(), 2u);
+	ASSERT_EQ(st.subFiles(*root).size(), 10u);
+
+	EntryIndex d1;
+	EXPECT_TRUE(st.getIndexFromDirHash(makeHash("d1"), d1));
+	EXPECT_EQ(st.getDirEntry(d1)->parent_index, 0u);
+
+	EntryIndex c;
+	EXPECT_TRUE(st.getChildIndex(0, 2, c));
+	EXPECT_EQ(st.getType(c), (uint32_t)FileStorageNode::TYPE_FILE);
+	EXPECT_EQ(st.parentRow(c), 0);
+
+	// second update drops a subdir and renames a file
+	subdirs_hashes.pop_back();
+	subfiles[3].file_name = "renamed";
+	EXPECT_TRUE(st.updateDirEntry(0, "", 1001, 1001, subdirs_hashes, subfiles));
+
+	EXPECT_EQ(st.subDirs(*st.getDirEntry(0)).size(), 1u);
+	EXPECT_EQ(st.subFiles(*st.getDirEntry(0)).size(), 10u);
+	EXPECT_FALSE(st.getIndexFromDirHash(makeHash("d2"), d1));
+
+	std::list<EntryIndex> results;
+	st.searchTerms({ "renamed" }, results);
+	EXPECT_EQ(results.size(), 1u);
+
+	std::string err;
+	EXPECT_TRUE(st.check(err)) << err;
+
+	std::cerr << "Memory usage for " << subfiles.size() << " files: "
+	          << st.memoryUsage() << " bytes" << std::endl;
+}
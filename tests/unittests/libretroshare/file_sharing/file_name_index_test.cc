@@ -0,0 +1,145 @@
+/*******************************************************************************
+ * unittests/libretroshare/file_sharing/file_name_index_test.cc                *
+ *                                                                             *
+ * Copyright (C) 2026  RetroShare Team <contact@retroshare.cc>                 *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Affero General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+// from libretroshare
+
+#include "file_sharing/file_name_index.h"
+#include "file_sharing/dir_hierarchy.h"
+#include "retroshare/rsexpr.h"
+#include "util/rsdir.h"
+
+typedef DirectoryStorage::EntryIndex EntryIndex;
+
+static void addName(FileNameIndex& idx, EntryIndex e, const std::string& s)
+{ idx.insert(e, s.data(), s.size()); }
+
+TEST(libretroshare_file_sharing, FileNameIndex)
+{
+	FileNameIndex idx;
+	addName(idx, 1, "Holiday_Pictures.zip");
+	addName(idx, 2, "holiday.mp4");
+	addName(idx, 3, "Report.pdf");
+
+	std::vector<EntryIndex> c;
+	EXPECT_TRUE(idx.getCandidates({ "HOLIDAY" }, c));
+	EXPECT_EQ(c, std::vector<EntryIndex>({ 1, 2 }));
+
+	EXPECT_TRUE(idx.getCandidates({ "port", "pict" }, c));
+	EXPECT_EQ(c, std::vector<EntryIndex>({ 1, 3 }));
+
+	EXPECT_TRUE(idx.getCandidates({ "nowhere" }, c));
+	EXPECT_TRUE(c.empty());
+
+	// too short to be indexed
+	EXPECT_FALSE(idx.getCandidates({ "mp" }, c));
+
+	// removed names stay as candidates until the index is rebuilt
+	idx.remove("Report.pdf", 10);
+	EXPECT_TRUE(idx.getCandidates({ "report" }, c));
+	EXPECT_FALSE(idx.needsRebuild());
+
+	idx.clear();
+	EXPECT_TRUE(idx.getCandidates({ "report" }, c));
+	EXPECT_TRUE(c.empty());
+}
+
+static RsFileHash makeHash(const std::string& s)
+{ return RsDirUtil::sha1sum((const unsigned char*)s.data(), s.size()); }
+
+TEST(libretroshare_file_sharing, InternalFileHierarchyStorage_nameSearch)
+{
+	using namespace RsRegularExpression;
+
+	InternalFileHierarchyStorage st;
+
+	std::vector<InternalFileHierarchyStorage::FileEntry> subfiles;
+	for(int i=0;i<1000;++i)
+	{
+		std::string name = "track_" + std::to_string(i) + (i%2 ? ".mp3" : ".ogg");
+		subfiles.push_back(InternalFileHierarchyStorage::FileEntry(
+		            name, i, 1000, makeHash(name) ));
+	}
+	subfiles.push_back(InternalFileHierarchyStorage::FileEntry(
+	            "/some/path/Track_42.iso", 42, 1000, makeHash("path") ));
+
+	EXPECT_TRUE(st.updateDirEntry(0, "", 1000, 1000, {}, subfiles));
+
+	// indexed terms and full scan must give the same results
+
+	std::list<EntryIndex> results;
+	st.searchTerms({ "TRACK_42." }, results);
+	EXPECT_EQ(results.size(), 2u);
+
+	results.clear();
+	st.searchTerms({ "some" }, results);	// only the last path component is searched
+	EXPECT_TRUE(results.empty());
+
+	results.clear();
+	st.searchTerms({ "_9" }, results);
+	EXPECT_EQ(results.size(), 111u);
+
+	results.clear();
+	st.searchTerms({ "_99", "k_1" }, results);
+	EXPECT_EQ(results.size(), 111u + 11u);
+
+	// bool expressions: NAME CONTAINS 42 AND EXTENSION IS mp3
+
+	CompoundExpression exp( AndOp,
+	            new NameExpression(ContainsAnyStrings, { "_42" }, true),
+	            new ExtExpression(EqualsString, { "mp3" }, true) );
+
+	std::list<std::string> terms;
+	EXPECT_TRUE(exp.nameTerms(terms));
+
+	results.clear();
+	st.searchBoolExp(&exp, results);
+	EXPECT_EQ(results.size(), 5u);		// 421, 423, ... 429
+
+	// the size predicate cannot be indexed, but does not prevent the use of the index
+	CompoundExpression exp2( OrOp,
+	            new NameExpression(ContainsAnyStrings, { "track_1" }, true),
+	            new SizeExpression(Greater, 10, 0) );
+	terms.clear();
+	EXPECT_FALSE(exp2.nameTerms(terms));
+
+	results.clear();
+	st.searchBoolExp(&exp2, results);
+	EXPECT_EQ(results.size(), 111u + 10u - 1u);
+
+	// renamed and removed files are not returned anymore
+
+	subfiles.resize(10);
+	subfiles[3].file_name = "renamed";
+	EXPECT_TRUE(st.updateDirEntry(0, "", 1001, 1001, {}, subfiles));
+
+	results.clear();
+	st.searchTerms({ "track_3" }, results);
+	EXPECT_TRUE(results.empty());
+
+	results.clear();
+	st.searchTerms({ "track_" }, results);
+	EXPECT_EQ(results.size(), 9u);
+
+	results.clear();
+	st.searchTerms({ "renamed" }, results);
+	EXPECT_EQ(results.size(), 1u);
+}
@@ -0,0 +1,277 @@
+/*******************************************************************************
+ * unittests/libretroshare/file_sharing/hash_cache_index_test.cc               *
+ *                                                                             *
+ * Copyright (C) 2026  RetroShare Team <contact@retroshare.cc>                 *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Affero General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <vector>
+
+// from libretroshare
+
+#include "file_sharing/hash_cache.h"
+#include "file_sharing/hash_cache_index.h"
+#include "util/rsdir.h"
+
+static const std::string BASE_NAME = "hash_cache_index_test";
+
+/* Keeps the secret in clear, since tests have no node key to encrypt it. */
+class PlainKeyHashCacheIndex: public HashCacheIndex
+{
+public:
+	explicit PlainKeyHashCacheIndex(const std::string& base_name) : HashCacheIndex(base_name) {}
+
+protected:
+	bool loadSecret() override
+	{
+		FILE *f = fopen(mKeyFile.c_str(),"rb");
+
+		if(!f)
+			return false;
+
+		bool ok = fread(mSecret,1,32,f) == 32;
+		fclose(f);
+		return ok;
+	}
+
+	bool saveSecret() override
+	{
+		FILE *f = fopen(mKeyFile.c_str(),"wb");
+
+		if(!f)
+			return false;
+
+		bool ok = fwrite(mSecret,1,32,f) == 32;
+		return (fclose(f) == 0) && ok;
+	}
+};
+
+static void removeCache()
+{
+	remove((BASE_NAME + ".idx").c_str());
+	remove((BASE_NAME + ".idx.tmp").c_str());
+	remove((BASE_NAME + ".log").c_str());
+	remove((BASE_NAME + ".key").c_str());
+}
+
+static void truncateFile(const std::string& name, uint64_t size)
+{
+	std::ifstream in(name, std::ios::binary);
+	std::vector<char> data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+	in.close();
+
+	data.resize(size);
+	std::ofstream(name, std::ios::binary | std::ios::trunc).write(data.data(), data.size());
+}
+
+static std::string filePath(uint32_t i)
+{
+	return "/home/user/shared/file_" + std::to_string(i) + ".bin";
+}
+
+static HashCacheIndex::Entry makeEntry(uint32_t i)
+{
+	HashCacheIndex::Entry e;
+	std::string s = std::to_string(i);
+
+	e.size = 1000 + i;
+	e.time_stamp = 2000 + i;
+	e.modf_stamp = 3000 + i;
+	e.hash = RsDirUtil::sha1sum((const unsigned char*)s.data(), s.size());
+
+	return e;
+}
+
+static void expectEntry(const HashCacheIndex& idx, uint32_t i)
+{
+	HashCacheIndex::Entry e, ref = makeEntry(i);
+
+	ASSERT_TRUE(idx.find(idx.pathKey(filePath(i)), e)) << "entry " << i;
+	EXPECT_EQ(e.size, ref.size);
+	EXPECT_EQ(e.time_stamp, ref.time_stamp);
+	EXPECT_EQ(e.modf_stamp, ref.modf_stamp);
+	EXPECT_EQ(e.hash, ref.hash);
+}
+
+TEST(libretroshare_file_sharing, HashCacheIndex_RoundTrip)
+{
+	removeCache();
+
+	{
+		PlainKeyHashCacheIndex idx(BASE_NAME);
+		EXPECT_FALSE(idx.load());	// nothing on disc yet
+		EXPECT_TRUE(idx.empty());
+
+		for(uint32_t i=0;i<100;++i)
+			idx.update(idx.pathKey(filePath(i)), makeEntry(i));
+
+		EXPECT_TRUE(idx.save());
+	}
+
+	// updates are read back from the log
+
+	{
+		PlainKeyHashCacheIndex idx(BASE_NAME);
+		EXPECT_TRUE(idx.load());
+
+		for(uint32_t i=0;i<100;++i)
+			expectEntry(idx, i);
+
+		EXPECT_TRUE(idx.compact());
+		EXPECT_FALSE(RsDirUtil::fileExists(BASE_NAME + ".log"));
+		EXPECT_FALSE(RsDirUtil::fileExists(BASE_NAME + ".idx.tmp"));
+
+		// updates on top of the index
+
+		for(uint32_t i=100;i<150;++i)
+			idx.update(idx.pathKey(filePath(i)), makeEntry(i));
+
+		EXPECT_TRUE(idx.save());
+	}
+
+	// then from both the index and the log
+
+	{
+		PlainKeyHashCacheIndex idx(BASE_NAME);
+		EXPECT_TRUE(idx.load());
+
+		for(uint32_t i=0;i<150;++i)
+			expectEntry(idx, i);
+
+		HashCacheIndex::Entry e;
+		EXPECT_FALSE(idx.find(idx.pathKey(filePath(150)), e));
+	}
+
+	// old entries are dropped on demand
+
+	{
+		PlainKeyHashCacheIndex idx(BASE_NAME);
+		EXPECT_TRUE(idx.load());
+		EXPECT_TRUE(idx.compact(2000 + 50));
+
+		HashCacheIndex::Entry e;
+		EXPECT_FALSE(idx.find(idx.pathKey(filePath(49)), e));
+		expectEntry(idx, 50);
+	}
+
+	removeCache();
+}
+
+TEST(libretroshare_file_sharing, HashCacheIndex_TruncatedLog)
+{
+	removeCache();
+
+	{
+		PlainKeyHashCacheIndex idx(BASE_NAME);
+		idx.load();
+
+		for(uint32_t i=0;i<10;++i)
+			idx.update(idx.pathKey(filePath(i)), makeEntry(i));
+
+		EXPECT_TRUE(idx.save());
+	}
+
+	// interrupted write of the last record
+
+	uint64_t size = 0;
+	ASSERT_TRUE(RsDirUtil::checkFile(BASE_NAME + ".log", size));
+	ASSERT_EQ(size, 10*HashCacheIndex::RECORD_SIZE);
+	truncateFile(BASE_NAME + ".log", size - HashCacheIndex::RECORD_SIZE/2);
+
+	{
+		PlainKeyHashCacheIndex idx(BASE_NAME);
+		EXPECT_TRUE(idx.load());
+
+		// records are logged in the order of the updates: only the last one is lost
+
+		for(uint32_t i=0;i<9;++i)
+			expectEntry(idx, i);
+
+		HashCacheIndex::Entry e;
+		EXPECT_FALSE(idx.find(idx.pathKey(filePath(9)), e));
+
+		// the truncated record is not in the way of new ones
+
+		idx.update(idx.pathKey(filePath(10)), makeEntry(10));
+		EXPECT_TRUE(idx.save());
+	}
+
+	{
+		PlainKeyHashCacheIndex idx(BASE_NAME);
+		EXPECT_TRUE(idx.load());
+		expectEntry(idx, 10);
+	}
+
+	removeCache();
+}
+
+TEST(libretroshare_file_sharing, HashCacheIndex_ImportOldHashCache)
+{
+	removeCache();
+
+	// former hash cache file, once decrypted
+
+	uint32_t total_size = 1024;
+	uint32_t offset = 0;
+	unsigned char *data = (unsigned char*)malloc(total_size);
+
+	for(uint32_t i=0;i<20;++i)
+	{
+		HashCacheIndex::Entry e = makeEntry(i);
+		HashStorage::HashStorageInfo info;
+
+		info.filename = filePath(i);
+		info.size = e.size;
+		info.time_stamp = e.time_stamp;
+		info.modf_stamp = e.modf_stamp;
+		info.hash = e.hash;
+
+		ASSERT_TRUE(HashStorage::writeHashStorageInfo(data, total_size, offset, info));
+	}
+
+	std::map<std::string, HashStorage::HashStorageInfo> files;
+	EXPECT_TRUE(HashStorage::parseOldHashCache(data, offset, files));
+	EXPECT_EQ(files.size(), 20u);
+
+	// garbage at the end is not an endless loop
+
+	EXPECT_FALSE(HashStorage::parseOldHashCache(data, offset - 3, files));
+	free(data);
+
+	{
+		PlainKeyHashCacheIndex idx(BASE_NAME);
+		EXPECT_FALSE(idx.load());
+		EXPECT_TRUE(HashStorage::importIntoIndex(files, idx));
+	}
+
+	{
+		PlainKeyHashCacheIndex idx(BASE_NAME);
+		EXPECT_TRUE(idx.load());
+		EXPECT_EQ(idx.size(), 20u);
+
+		for(uint32_t i=0;i<20;++i)
+			expectEntry(idx, i);
+	}
+
+	removeCache();
+}
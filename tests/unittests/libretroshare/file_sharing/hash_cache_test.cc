@@ -0,0 +1,290 @@
+/*******************************************************************************
+ * unittests/libretroshare/file_sharing/hash_cache_test.cc                     *
+ *                                                                             *
+ * Copyright (C) 2026  RetroShare Team <contact@retroshare.cc>                 *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Affero General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <map>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+// from libretroshare
+
+#include "file_sharing/hash_cache.h"
+#include "file_sharing/file_sharing_defaults.h"
+#include "services/rseventsservice.h"
+#include "util/rsdir.h"
+
+static const std::string BASE_NAME = "hash_cache_test";
+static const uint32_t WAIT_TIMEOUT_SECS = 60;
+
+/* Collects the hashes sent by the hashing threads. The first confirmations wait
+ * for a second hashing thread, so that files are known to be hashed in parallel. */
+class CollectingClient: public HashStorageClient
+{
+public:
+	CollectingClient() : mParallelThreads(1) {}
+
+	void hash_callback(uint32_t client_param, const std::string&, const RsFileHash& hash, uint64_t size) override
+	{
+		std::unique_lock<std::mutex> lock(mMtx);
+		mHashes[client_param] = hash;
+		mSizes[client_param] = size;
+		mCv.notify_all();
+	}
+
+	bool hash_confirm(uint32_t) override
+	{
+		std::unique_lock<std::mutex> lock(mMtx);
+		mConfirmingThreads.insert(std::this_thread::get_id());
+		mCv.notify_all();
+
+		mCv.wait_for(lock, std::chrono::seconds(WAIT_TIMEOUT_SECS),
+		             [this]() { return mConfirmingThreads.size() >= mParallelThreads; });
+		return true;
+	}
+
+	bool waitForHashes(size_t n)
+	{
+		std::unique_lock<std::mutex> lock(mMtx);
+		return mCv.wait_for(lock, std::chrono::seconds(WAIT_TIMEOUT_SECS),
+		                    [this,n]() { return mHashes.size() >= n; });
+	}
+
+	std::mutex mMtx;
+	std::condition_variable mCv;
+	size_t mParallelThreads;
+	std::set<std::thread::id> mConfirmingThreads;
+	std::map<uint32_t,RsFileHash> mHashes;
+	std::map<uint32_t,uint64_t> mSizes;
+};
+
+/* Test files with distinct contents. Sizes are around the read buffer size, so
+ * that files take one or several reads. */
+static std::string writeTestFile(const std::string& name, uint64_t size, uint8_t seed)
+{
+	std::vector<uint8_t> data(size);
+
+	for(uint64_t i=0;i<size;++i)
+		data[i] = (uint8_t)(i*31 + seed + (i >> 12));
+
+	FILE *f = fopen(name.c_str(),"wb");
+	EXPECT_TRUE(f != NULL);
+
+	if(f)
+	{
+		EXPECT_EQ(fwrite(data.data(),1,size,f), size);
+		fclose(f);
+	}
+	return name;
+}
+
+static void removeCache()
+{
+	remove((BASE_NAME + ".bin").c_str());
+	remove((BASE_NAME + ".idx").c_str());
+	remove((BASE_NAME + ".idx.tmp").c_str());
+	remove((BASE_NAME + ".log").c_str());
+	remove((BASE_NAME + ".key").c_str());
+}
+
+TEST(libretroshare_file_sharing, HashStorage_ParallelHashingAndProgress)
+{
+	removeCache();
+
+	const std::vector<uint64_t> sizes = { 1000, HASHING_READ_BUFFER_SIZE + 4096, 3*1024*1024, 0, 2*HASHING_READ_BUFFER_SIZE, 70000 };
+	std::vector<std::string> files;
+	uint64_t total_size = 0;
+
+	for(uint32_t i=0;i<sizes.size();++i)
+	{
+		files.push_back(writeTestFile("hash_cache_test_" + std::to_string(i), sizes[i], i));
+		total_size += sizes[i];
+	}
+
+	// progress is only sent as events
+
+	RsEventsService events;
+	events.start("hash test events");
+	rsEvents = &events;
+
+	std::mutex evMtx;
+	std::vector<std::shared_ptr<const RsFileHashingCompletedEvent> > completed;
+	RsEventsHandlerId_t hId = 0;
+
+	events.registerEventsHandler([&](std::shared_ptr<const RsEvent> e)
+	{
+		auto ev = std::dynamic_pointer_cast<const RsFileHashingCompletedEvent>(e);
+
+		if(ev)
+		{
+			std::lock_guard<std::mutex> lock(evMtx);
+			completed.push_back(ev);
+		}
+	}, hId, RsEventType::FILE_HASHING_COMPLETED);
+
+	CollectingClient client;
+	client.mParallelThreads = 3;
+
+	{
+		HashStorage storage(BASE_NAME + ".bin");
+		storage.setHashingThreads(3);
+		EXPECT_EQ(storage.hashingThreads(), 3u);
+
+		for(uint32_t i=0;i<files.size();++i)
+		{
+			RsFileHash known_hash;
+			EXPECT_FALSE(storage.requestHash(files[i], sizes[i], 1000+i, known_hash, &client, i));
+		}
+
+		EXPECT_TRUE(client.waitForHashes(files.size()));
+
+		// the same hashes as the single threaded hashing of RsDirUtil
+
+		for(uint32_t i=0;i<files.size();++i)
+		{
+			RsFileHash expected;
+			uint64_t size = 0;
+
+			EXPECT_TRUE(RsDirUtil::getFileHash(files[i], expected, size));
+			EXPECT_EQ(client.mHashes[i], expected) << files[i];
+			EXPECT_EQ(client.mSizes[i], sizes[i]) << files[i];
+		}
+		EXPECT_GE(client.mConfirmingThreads.size(), 3u);
+
+		// once hashed, files are known to the cache
+
+		for(uint32_t i=0;i<files.size();++i)
+		{
+			RsFileHash known_hash;
+			EXPECT_TRUE(storage.requestHash(files[i], sizes[i], 1000+i, known_hash, &client, i));
+			EXPECT_EQ(known_hash, client.mHashes[i]);
+		}
+
+		// one event per file, counting files and bytes over all threads
+
+		size_t n_completed = 0;
+
+		for(uint32_t n=0;n<100 && n_completed < files.size();++n)
+		{
+			rstime::rs_usleep(100*1000);
+
+			std::lock_guard<std::mutex> lock(evMtx);
+			n_completed = completed.size();
+		}
+
+		std::lock_guard<std::mutex> lock(evMtx);
+		EXPECT_EQ(completed.size(), files.size());
+
+		std::set<uint64_t> hashed_files;
+		std::set<std::string> paths;
+
+		for(auto& ev: completed)
+		{
+			hashed_files.insert(ev->mHashedFiles);
+			paths.insert(ev->mFilePath);
+
+			EXPECT_EQ(ev->mFilesToHash, files.size());
+			EXPECT_EQ(ev->mBytesToHash, total_size);
+			EXPECT_LE(ev->mHashedFiles, files.size());
+			EXPECT_LE(ev->mHashedBytes, total_size);
+		}
+
+		// each completion counts one more file, whatever the thread it was hashed on
+
+		EXPECT_EQ(hashed_files.size(), files.size());
+		EXPECT_EQ(hashed_files.empty() ? 0 : *hashed_files.rbegin(), files.size());
+		EXPECT_EQ(paths, std::set<std::string>(files.begin(), files.end()));
+
+		uint64_t max_hashed_bytes = 0;
+
+		for(auto& ev: completed)
+			max_hashed_bytes = std::max(max_hashed_bytes, ev->mHashedBytes);
+
+		EXPECT_EQ(max_hashed_bytes, total_size);
+	}
+
+	events.unregisterEventsHandler(hId);
+	rsEvents = nullptr;
+	events.fullstop();
+
+	for(auto& f: files)
+		remove(f.c_str());
+
+	removeCache();
+}
+
+TEST(libretroshare_file_sharing, HashStorage_MaxHashingSpeed)
+{
+	removeCache();
+
+	// 12 MB at 4 MB/s over two threads: the shared budget makes it last about 3 seconds
+
+	const uint32_t max_speed = 4;
+	const uint64_t file_size = 6*1024*1024;
+	std::vector<std::string> files;
+
+	for(uint32_t i=0;i<2;++i)
+		files.push_back(writeTestFile("hash_cache_test_throttled_" + std::to_string(i), file_size, 100+i));
+
+	CollectingClient client;
+	client.mParallelThreads = 2;
+
+	{
+		HashStorage storage(BASE_NAME + ".bin");
+		storage.setHashingThreads(2);
+		storage.setMaxHashingSpeed(max_speed);
+		EXPECT_EQ(storage.maxHashingSpeed(), max_speed);
+
+		auto start = std::chrono::steady_clock::now();
+
+		for(uint32_t i=0;i<files.size();++i)
+		{
+			RsFileHash known_hash;
+			storage.requestHash(files[i], file_size, time(NULL), known_hash, &client, i);
+		}
+
+		ASSERT_TRUE(client.waitForHashes(files.size()));
+
+		double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		double expected = files.size() * file_size / (max_speed * 1024.0 * 1024.0);
+
+		EXPECT_GE(elapsed, 0.9 * expected);
+		EXPECT_EQ(client.mConfirmingThreads.size(), 2u);
+
+		for(uint32_t i=0;i<files.size();++i)
+		{
+			RsFileHash expected_hash;
+			uint64_t size = 0;
+
+			ASSERT_TRUE(RsDirUtil::getFileHash(files[i], expected_hash, size));
+			EXPECT_EQ(client.mHashes[i], expected_hash);
+		}
+	}
+
+	for(auto& f: files)
+		remove(f.c_str());
+
+	removeCache();
+}
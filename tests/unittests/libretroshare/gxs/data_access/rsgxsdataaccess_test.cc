@@ -0,0 +1,288 @@
+/*******************************************************************************
+ * unittests/libretroshare/gxs/data_access/rsgxsdataaccess_test.cc             *
+ *                                                                             *
+ * Copyright (C) 2026  RetroShare Team <contact@retroshare.cc>                 *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Affero General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <thread>
+
+#include "gxs/rsgds.h"
+#include "gxs/rsgxsdataaccess.h"
+#include "retroshare/rsgxsflags.h"
+
+/* Data store that holds nothing, and is slow to return message data, like a
+ * database serving a large channel. */
+class SlowDataStore: public RsGeneralDataService
+{
+public:
+	explicit SlowDataStore(std::chrono::milliseconds msgDelay) :
+	    mMsgDelay(msgDelay) {}
+
+	int retrieveNxsMsgs(const GxsMsgReq&, GxsMsgResult&, bool) override
+	{ std::this_thread::sleep_for(mMsgDelay); return 1; }
+	int retrieveNxsGrps(std::map<RsGxsGroupId, RsNxsGrp*>&, bool) override { return 1; }
+	int retrieveGxsGrpMetaData(std::map<RsGxsGroupId,std::shared_ptr<RsGxsGrpMetaData> >&) override { return 1; }
+	int retrieveGxsMsgMetaData(const GxsMsgReq&, GxsMsgMetaResult&) override { return 1; }
+	int removeMsgs(const GxsMsgReq&) override { return 1; }
+	int removeGroups(const std::vector<RsGxsGroupId>&) override { return 1; }
+	int retrieveGroupIds(std::vector<RsGxsGroupId>&) override { return 1; }
+	int retrieveMsgIds(const RsGxsGroupId&, RsGxsMessageId::std_set&) override { return 1; }
+	uint32_t cacheSize() const override { return 0; }
+	int setCacheSize(uint32_t) override { return 1; }
+	int storeMessage(const std::list<RsNxsMsg*>&) override { return 1; }
+	int storeGroup(const std::list<RsNxsGrp*>&) override { return 1; }
+	int updateGroup(const std::list<RsNxsGrp*>&) override { return 1; }
+	int updateMessageMetaData(const MsgLocMetaData&) override { return 1; }
+	int updateGroupMetaData(const GrpLocMetaData&) override { return 1; }
+	int resetDataStore() override { return 1; }
+	uint16_t serviceType() const override { return 0; }
+	int updateGroupKeys(const RsGxsGroupId&, const RsTlvSecurityKeySet&, uint32_t) override { return 1; }
+	bool validSize(RsNxsMsg*) const override { return true; }
+	bool validSize(RsNxsGrp*) const override { return true; }
+
+private:
+	std::chrono::milliseconds mMsgDelay;
+};
+
+/* Runs the request processing loop of a GXS service thread */
+class DataAccessThread
+{
+public:
+	explicit DataAccessThread(RsGxsDataAccess& da) : mStop(false), mThread([&da,this]()
+	{
+		while(!mStop)
+		{
+			da.processRequests();
+			da.waitForNewRequests(std::chrono::milliseconds(100));
+		}
+	}) {}
+
+	~DataAccessThread() { mStop = true; mThread.join(); }
+
+private:
+	std::atomic<bool> mStop;
+	std::thread mThread;
+};
+
+TEST(libretroshare_gxs, RsGxsDataAccess_waitRequestStatus)
+{
+	SlowDataStore store(std::chrono::milliseconds(0));
+	RsGxsDataAccess da(&store);
+	DataAccessThread thread(da);
+
+	RsTokReqOptions opts;
+	opts.mReqType = GXS_REQUEST_TYPE_GROUP_IDS;
+
+	for(int i=0;i<20;++i)
+	{
+		uint32_t token;
+
+		ASSERT_TRUE(da.requestGroupInfo(token, 0, opts));
+		EXPECT_EQ( da.waitRequestStatus(token, std::chrono::seconds(5)),
+		           RsTokenService::COMPLETE );
+
+		std::list<RsGxsGroupId> ids;
+		EXPECT_TRUE(da.getGroupList(token, ids));
+		EXPECT_EQ(da.requestStatus(token), RsTokenService::FAILED);	// token is gone
+	}
+
+	// unknown tokens do not block
+	EXPECT_EQ( da.waitRequestStatus(12345, std::chrono::seconds(5)),
+	           RsTokenService::FAILED );
+}
+
+TEST(libretroshare_gxs, RsGxsDataAccess_summariesDoNotWaitForData)
+{
+	SlowDataStore store(std::chrono::milliseconds(1000));
+	RsGxsDataAccess da(&store);
+	DataAccessThread thread(da);
+
+	RsTokReqOptions dataOpts;
+	dataOpts.mReqType = GXS_REQUEST_TYPE_MSG_DATA;
+	uint32_t dataToken;
+	ASSERT_TRUE(da.requestMsgInfo(dataToken, 0, dataOpts, std::list<RsGxsGroupId>({ RsGxsGroupId::random() })));
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));	// data request is being processed
+
+	RsTokReqOptions metaOpts;
+	metaOpts.mReqType = GXS_REQUEST_TYPE_GROUP_META;
+	uint32_t metaToken;
+	ASSERT_TRUE(da.requestGroupInfo(metaToken, 0, metaOpts));
+
+	EXPECT_EQ( da.waitRequestStatus(metaToken, std::chrono::milliseconds(500)),
+	           RsTokenService::COMPLETE );
+	EXPECT_NE(da.requestStatus(dataToken), RsTokenService::COMPLETE);
+
+	EXPECT_EQ( da.waitRequestStatus(dataToken, std::chrono::seconds(5)),
+	           RsTokenService::COMPLETE );
+}
+
+/* Data store holding message metas in memory, and relying on the default
+ * filtering of RsGeneralDataService */
+class MetaDataStore: public SlowDataStore
+{
+public:
+	MetaDataStore() : SlowDataStore(std::chrono::milliseconds(0)) {}
+
+	int retrieveGxsMsgMetaData(const GxsMsgReq& req, GxsMsgMetaResult& res) override
+	{
+		for(auto& it: req)
+		{
+			auto& metas(res[it.first]);
+
+			for(auto& m: mMetas)
+				if( m->mGroupId == it.first &&
+				        (it.second.empty() || it.second.count(m->mMsgId)) )
+					metas.push_back(m);
+		}
+		return 1;
+	}
+
+	RsGxsMessageId addMsg( const RsGxsGroupId& grpId, const RsGxsMessageId& parentId,
+	                       uint32_t status, rstime_t publishTs )
+	{
+		auto m = std::make_shared<RsGxsMsgMetaData>();
+		m->mGroupId = grpId;
+		m->mMsgId = RsGxsMessageId::random();
+		m->mOrigMsgId = m->mMsgId;
+		m->mParentId = parentId;
+		m->mThreadId = parentId;
+		m->mMsgStatus = status;
+		m->mPublishTs = publishTs;
+
+		mMetas.push_back(m);
+		return m->mMsgId;
+	}
+
+	// New version of msg origId
+	RsGxsMessageId addVersion( const RsGxsGroupId& grpId, const RsGxsMessageId& origId,
+	                           uint32_t status, rstime_t publishTs )
+	{
+		RsGxsMessageId parentId;
+
+		for(auto& m: mMetas)
+			if(m->mMsgId == origId)
+				parentId = m->mParentId;
+
+		RsGxsMessageId id = addMsg(grpId, parentId, status, publishTs);
+		mMetas.back()->mOrigMsgId = origId;
+		return id;
+	}
+
+private:
+	std::vector<std::shared_ptr<RsGxsMsgMetaData> > mMetas;
+};
+
+static std::set<RsGxsMessageId> requestMsgIds( RsGxsDataAccess& da, RsTokReqOptions opts,
+                                               const RsGxsGroupId& grpId )
+{
+	opts.mReqType = GXS_REQUEST_TYPE_MSG_META;
+
+	uint32_t token;
+	EXPECT_TRUE(da.requestMsgInfo(token, 0, opts, std::list<RsGxsGroupId>({ grpId })));
+	EXPECT_EQ( da.waitRequestStatus(token, std::chrono::seconds(5)),
+	           RsTokenService::COMPLETE );
+
+	GxsMsgMetaResult result;
+	EXPECT_TRUE(da.getMsgSummary(token, result));
+
+	std::set<RsGxsMessageId> ids;
+	for(auto& m: result[grpId]) ids.insert(m->mMsgId);
+	return ids;
+}
+
+TEST(libretroshare_gxs, RsGxsDataAccess_msgMetaFilters)
+{
+	MetaDataStore store;
+	RsGxsDataAccess da(&store);
+	DataAccessThread thread(da);
+
+	const uint32_t UNPROCESSED = GXS_SERV::GXS_MSG_STATUS_UNPROCESSED;
+	RsGxsGroupId grpId = RsGxsGroupId::random();
+
+	RsGxsMessageId a = store.addMsg(grpId, RsGxsMessageId(), 0, 100);
+	RsGxsMessageId b = store.addMsg(grpId, RsGxsMessageId(), UNPROCESSED, 200);
+	RsGxsMessageId c = store.addMsg(grpId, a, 0, 300);
+	RsGxsMessageId d = store.addMsg(grpId, a, UNPROCESSED, 400);
+	store.addMsg(RsGxsGroupId::random(), RsGxsMessageId(), UNPROCESSED, 200);
+
+	RsTokReqOptions opts;
+	EXPECT_EQ(requestMsgIds(da, opts, grpId), std::set<RsGxsMessageId>({ a, b, c, d }));
+
+	opts.mStatusMask = opts.mStatusFilter = UNPROCESSED;
+	EXPECT_EQ(requestMsgIds(da, opts, grpId), std::set<RsGxsMessageId>({ b, d }));
+
+	opts = RsTokReqOptions();
+	opts.mOptions = RS_TOKREQOPT_MSG_THREAD | RS_TOKREQOPT_MSG_LATEST;
+	EXPECT_EQ(requestMsgIds(da, opts, grpId), std::set<RsGxsMessageId>({ a, b }));
+
+	opts = RsTokReqOptions();
+	opts.mAfter = 150;
+	opts.mBefore = 300;
+	EXPECT_EQ(requestMsgIds(da, opts, grpId), std::set<RsGxsMessageId>({ b, c }));
+
+	// msgs of a thread
+	opts = RsTokReqOptions();
+	opts.mReqType = GXS_REQUEST_TYPE_MSG_RELATED_IDS;
+	opts.mOptions = RS_TOKREQOPT_MSG_THREAD | RS_TOKREQOPT_MSG_LATEST;
+
+	uint32_t token;
+	RsGxsGrpMsgIdPair thread_head(grpId, a);
+	ASSERT_TRUE(da.requestMsgRelatedInfo(token, 0, opts, std::vector<RsGxsGrpMsgIdPair>({ thread_head })));
+	EXPECT_EQ( da.waitRequestStatus(token, std::chrono::seconds(5)),
+	           RsTokenService::COMPLETE );
+
+	MsgRelatedIdResult related;
+	EXPECT_TRUE(da.getMsgRelatedList(token, related));
+	EXPECT_EQ(related[thread_head], std::set<RsGxsMessageId>({ c, d }));
+}
+
+TEST(libretroshare_gxs, RsGxsDataAccess_latestMsgsWithStatusFilter)
+{
+	MetaDataStore store;
+	RsGxsDataAccess da(&store);
+	DataAccessThread thread(da);
+
+	const uint32_t UNPROCESSED = GXS_SERV::GXS_MSG_STATUS_UNPROCESSED;
+	RsGxsGroupId grpId = RsGxsGroupId::random();
+
+	// a was edited into a read version, b into an unprocessed one
+	RsGxsMessageId a = store.addMsg(grpId, RsGxsMessageId(), UNPROCESSED, 100);
+	RsGxsMessageId a2 = store.addVersion(grpId, a, 0, 200);
+	RsGxsMessageId b = store.addMsg(grpId, RsGxsMessageId(), 0, 100);
+	RsGxsMessageId b2 = store.addVersion(grpId, b, UNPROCESSED, 200);
+
+	RsTokReqOptions opts;
+	opts.mOptions = RS_TOKREQOPT_MSG_LATEST;
+	EXPECT_EQ(requestMsgIds(da, opts, grpId), std::set<RsGxsMessageId>({ a2, b2 }));
+
+	// The old version of a must not come back because its latest version is filtered out
+	opts.mStatusMask = opts.mStatusFilter = UNPROCESSED;
+	EXPECT_EQ(requestMsgIds(da, opts, grpId), std::set<RsGxsMessageId>({ b2 }));
+
+	opts.mStatusFilter = 0;
+	EXPECT_EQ(requestMsgIds(da, opts, grpId), std::set<RsGxsMessageId>({ a2 }));
+
+	// Same with a time condition, which only the old versions match
+	opts = RsTokReqOptions();
+	opts.mOptions = RS_TOKREQOPT_MSG_LATEST | RS_TOKREQOPT_MSG_THREAD;
+	opts.mBefore = 150;
+	EXPECT_TRUE(requestMsgIds(da, opts, grpId).empty());
+}
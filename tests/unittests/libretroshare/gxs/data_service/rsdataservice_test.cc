@@ -43,6 +43,7 @@ TEST(libretroshare_gxs, RsDataService)
 
     test_groupStoreAndRetrieve();
     test_messageStoresAndRetrieve();
+    test_cacheSize();
 }
 
 
@@ -314,6 +315,79 @@ void test_messageStoresAndRetrieve()
     tearDown();
 }
 
+/*!
+ * Fills the meta caches of two groups and checks that the least recently
+ * used group is dropped when the memory budget is lowered, and that its
+ * metas are read back from the database afterwards
+ */
+void test_cacheSize()
+{
+    setUp();
+
+    RsGxsGroupId grpId0 = RsGxsGroupId::random();
+    RsGxsGroupId grpId1 = RsGxsGroupId::random();
+
+    std::list<RsNxsMsg*> msgs; // owned by the store once stored
+    const int nMsgs = 50;
+
+    for(int i=0; i<2*nMsgs; i++)
+    {
+        RsNxsMsg* msg = new RsNxsMsg(RS_SERVICE_TYPE_PLUGIN_SIMPLE_FORUM);
+        RsGxsMsgMetaData* msgMeta = new RsGxsMsgMetaData();
+        init_item(*msg);
+        init_item(msgMeta);
+
+        msgMeta->mMsgId = msg->msgId;
+        msgMeta->mGroupId = msg->grpId = (i < nMsgs) ? grpId0 : grpId1;
+        msg->metaData = msgMeta;
+        msgs.push_back(msg);
+    }
+
+    dStore->storeMessage(msgs);
+
+    GxsMsgReq req0, req1;
+    req0[grpId0];
+    req1[grpId1];
+    GxsMsgMetaResult metaResult;
+
+    // grpId0 is used last, so grpId1 is the one to go
+    dStore->retrieveGxsMsgMetaData(req1, metaResult);
+    dStore->retrieveGxsMsgMetaData(req0, metaResult);
+
+    GxsMetaCacheStatistic stats;
+    dStore->getMetaCacheStatistic(stats);
+    EXPECT_EQ(stats.mNumMsgs, 2u*nMsgs);
+    EXPECT_EQ(stats.mMaxSize, dStore->cacheSize());
+    EXPECT_TRUE(stats.mSize > 0);
+
+    uint64_t misses = stats.mMisses;
+
+    dStore->setCacheSize(stats.mSize / 2);
+    dStore->getMetaCacheStatistic(stats);
+    EXPECT_EQ(stats.mNumMsgs, (uint32_t)nMsgs);
+    EXPECT_EQ(stats.mEvictions, (uint64_t)nMsgs);
+    EXPECT_TRUE(stats.mSize <= stats.mMaxSize);
+
+    // evicted metas come back from the database, cached ones do not
+    metaResult.clear();
+    dStore->retrieveGxsMsgMetaData(req0, metaResult);
+    dStore->getMetaCacheStatistic(stats);
+    EXPECT_EQ(stats.mMisses, misses);
+    EXPECT_EQ(metaResult[grpId0].size(), (size_t)nMsgs);
+
+    metaResult.clear();
+    dStore->retrieveGxsMsgMetaData(req1, metaResult);
+    dStore->getMetaCacheStatistic(stats);
+    EXPECT_EQ(stats.mMisses, misses + nMsgs);
+    EXPECT_EQ(metaResult[grpId1].size(), (size_t)nMsgs);
+
+    // the group just read is kept even if it alone is over budget
+    dStore->setCacheSize(0);
+    dStore->getMetaCacheStatistic(stats);
+    EXPECT_EQ(stats.mNumMsgs, (uint32_t)nMsgs);
+
+    tearDown();
+}
 
 
 void setUp(){
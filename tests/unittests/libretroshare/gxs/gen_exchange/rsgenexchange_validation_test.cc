@@ -0,0 +1,231 @@
+/*******************************************************************************
+ * unittests/libretroshare/gxs/gen_exchange/rsgenexchange_validation_test.cc   *
+ *                                                                             *
+ * Copyright (C) 2026  RetroShare Team <contact@retroshare.cc>                 *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Affero General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cstdio>
+
+// from libretroshare
+
+#include "gxs/rsdataservice.h"
+#include "gxs/rsgenexchange.h"
+#include "gxs/rsgixs.h"
+#include "gxs/rsnxs.h"
+#include "retroshare/rsgxsflags.h"
+#include "util/rsexecutor.h"
+
+static const uint16_t RS_SERVICE_TYPE_VALIDATION_TEST = 0x01;
+static const std::string VALIDATION_TEST_DB = "validation_test_db";
+
+/* Messages are only validated and stored, never turned into items */
+class NullSerialiser: public RsSerialType
+{
+public:
+	NullSerialiser() : RsSerialType(RS_PKT_VERSION_SERVICE, RS_SERVICE_TYPE_VALIDATION_TEST) {}
+
+	uint32_t size(RsItem*) override { return 0; }
+	bool serialise(RsItem*, void*, uint32_t*) override { return false; }
+	RsItem* deserialise(void*, uint32_t*) override { return nullptr; }
+};
+
+class ValidationTestService: public RsGenExchange
+{
+public:
+	ValidationTestService(RsGeneralDataService* ds, RsSerialType* serialiser, RsGixs* gixs) :
+	    RsGenExchange(ds, NULL, serialiser, RS_SERVICE_TYPE_VALIDATION_TEST, gixs, 0) {}
+
+	RsServiceInfo getServiceInfo() override { return RsServiceInfo(); }
+	void service_tick() override {}
+
+	void notifyChanges(std::vector<RsGxsNotify*>& changes) override
+	{
+		for(RsGxsNotify* c: changes)
+			delete c;
+		changes.clear();
+	}
+};
+
+/* Keeps received messages forever, so that they pass the storage time test */
+class KeepAllNetService: public RsNetworkExchangeService
+{
+public:
+	uint16_t serviceType() const override { return RS_SERVICE_TYPE_VALIDATION_TEST; }
+	void setSyncAge(const RsGxsGroupId&,uint32_t) override {}
+	void setKeepAge(const RsGxsGroupId&,uint32_t) override {}
+	uint32_t getSyncAge(const RsGxsGroupId&) override { return 0; }
+	uint32_t getKeepAge(const RsGxsGroupId&) override { return 0; }
+	void setDefaultKeepAge(uint32_t) override {}
+	void setDefaultSyncAge(uint32_t) override {}
+	uint32_t getDefaultSyncAge() override { return 0; }
+	uint32_t getDefaultKeepAge() override { return 0; }
+	bool msgAutoSync() const override { return false; }
+	bool grpAutoSync() const override { return false; }
+
+	std::error_condition distantSearchRequest(rs_owner_ptr<uint8_t>,uint32_t,RsServiceType,TurtleRequestId&) override { return std::errc::not_supported; }
+	std::error_condition handleDistantSearchRequest(rs_view_ptr<uint8_t>,uint32_t,rs_owner_ptr<uint8_t>&,uint32_t&) override { return std::errc::not_supported; }
+	std::error_condition receiveDistantSearchResult(const TurtleRequestId,rs_owner_ptr<uint8_t>&,uint32_t&) override { return std::errc::not_supported; }
+	TurtleRequestId turtleGroupRequest(const RsGxsGroupId&) override { return 0; }
+	TurtleRequestId turtleSearchRequest(const std::string&) override { return 0; }
+	void receiveTurtleSearchResults(TurtleRequestId,const std::list<RsGxsGroupSummary>&) override {}
+	void receiveTurtleSearchResults(TurtleRequestId,rs_owner_ptr<const uint8_t>,uint32_t) override {}
+	bool retrieveDistantSearchResults(TurtleRequestId,std::map<RsGxsGroupId,RsGxsGroupSearchResults>&) override { return false; }
+	bool clearDistantSearchResults(const TurtleRequestId&) override { return false; }
+	bool retrieveDistantGroupSummary(const RsGxsGroupId&,RsGxsGroupSearchResults&) override { return false; }
+	bool search(const std::string&,std::list<RsGxsGroupSummary>&) override { return false; }
+	bool search(const Sha1CheckSum&,unsigned char*&,uint32_t&) override { return false; }
+	DistantSearchGroupStatus getDistantSearchStatus(const RsGxsGroupId&) override { return DistantSearchGroupStatus::UNKNOWN; }
+
+	void pauseSynchronisation(bool) override {}
+	int requestMsg(const RsGxsGrpMsgIdPair&) override { return 0; }
+	int requestGrp(const std::list<RsGxsGroupId>&,const RsPeerId&) override { return 0; }
+	bool getGroupNetworkStats(const RsGxsGroupId&,RsGroupNetworkStats&) override { return false; }
+	void subscribeStatusChanged(const RsGxsGroupId&,bool) override {}
+	int sharePublishKey(const RsGxsGroupId&,const std::set<RsPeerId>&) override { return 0; }
+	void rejectMessage(const RsGxsMessageId&) override { ++mRejected; }
+	bool getGroupServerUpdateTS(const RsGxsGroupId&,rstime_t&,rstime_t&) override { return false; }
+	bool stampMsgServerUpdateTS(const RsGxsGroupId&) override { return false; }
+	bool isDistantPeer(const RsPeerId&) override { return false; }
+	bool removeGroups(const std::list<RsGxsGroupId>&) override { return false; }
+	std::error_condition checkUpdatesFromPeers(std::set<RsPeerId>) override { return std::errc::not_supported; }
+	std::error_condition requestPull(std::set<RsPeerId>) override { return std::errc::not_supported; }
+
+	uint32_t mRejected = 0;
+};
+
+/* Identities whose keys are missing at first, then known but unusable: messages
+ * signed by them are retried, then rejected. */
+class PendingKeysGixs: public RsGixs
+{
+public:
+	PendingKeysGixs() : mKnown(false), mRequests(0) {}
+
+	bool signData(const uint8_t*,uint32_t,const RsGxsId&,RsTlvKeySignature&,uint32_t&) override { return false; }
+	bool validateData(const uint8_t*,uint32_t,const RsTlvKeySignature&,bool,const RsIdentityUsage&,uint32_t&) override { return false; }
+	bool encryptData(const uint8_t*,uint32_t,uint8_t*&,uint32_t&,const RsGxsId&,uint32_t&,bool) override { return false; }
+	bool decryptData(const uint8_t*,uint32_t,uint8_t*&,uint32_t&,const RsGxsId&,uint32_t&,bool) override { return false; }
+	bool getOwnIds(std::list<RsGxsId>&,bool) override { return false; }
+	bool isOwnId(const RsGxsId&) override { return false; }
+	void timeStampKey(const RsGxsId&,const RsIdentityUsage&) override {}
+	bool haveKey(const RsGxsId&) override { return mKnown; }
+	bool havePrivateKey(const RsGxsId&) override { return false; }
+	bool requestKey(const RsGxsId&,const std::list<RsPeerId>&,const RsIdentityUsage&) override { ++mRequests; return true; }
+	bool requestPrivateKey(const RsGxsId&) override { return false; }
+	bool receiveNewIdentity(RsNxsGrp*) override { return false; }
+	bool retrieveNxsIdentity(const RsGxsId&,RsNxsGrp*&) override { return false; }
+	bool getKey(const RsGxsId&,RsTlvPublicRSAKey&) override { return false; }
+	bool getPrivateKey(const RsGxsId&,RsTlvPrivateRSAKey&) override { return false; }
+	bool getIdDetails(const RsGxsId&,RsIdentityDetails&) override { return false; }
+
+	std::atomic<bool> mKnown;
+	std::atomic<uint32_t> mRequests;	// validation runs on several threads
+};
+
+static RsNxsMsg* newReceivedMsg(const RsGxsGroupId& grpId, const RsGxsId& authorId)
+{
+	RsNxsMsg* msg = new RsNxsMsg(RS_SERVICE_TYPE_VALIDATION_TEST);
+	RsGxsMsgMetaData* meta = new RsGxsMsgMetaData;
+
+	msg->grpId = meta->mGroupId = grpId;
+	msg->msgId = meta->mMsgId = meta->mOrigMsgId = RsGxsMessageId::random();
+	meta->mAuthorId = authorId;
+	meta->mPublishTs = time(NULL);
+	msg->metaData = meta;
+
+	std::string data = "message " + msg->msgId.toStdString();
+	msg->msg.setBinData(data.data(), data.size());
+
+	return msg;
+}
+
+static void storedMsgIds(RsGeneralDataService* ds, const RsGxsGroupId& grpId, RsGxsMessageId::std_set& ids)
+{
+	ids.clear();
+	ds->retrieveMsgIds(grpId, ids);
+}
+
+TEST(libretroshare_gxs, RsGenExchange_ReceivedMessagesValidation)
+{
+	remove(VALIDATION_TEST_DB.c_str());
+
+	RsExecutor::setThreadCount(4);
+	RsGenExchange::setValidationThreadCount(4);
+
+	{
+		RsGeneralDataService* dataStore = new RsDataService("./", VALIDATION_TEST_DB, RS_SERVICE_TYPE_VALIDATION_TEST, NULL, "");
+		NullSerialiser serialiser;
+		PendingKeysGixs gixs;
+		KeepAllNetService* netService = new KeepAllNetService;
+		ValidationTestService service(dataStore, &serialiser, &gixs);	// deletes dataStore and netService
+		service.setNetworkExchangeService(netService);
+
+		RsNxsGrp* grp = new RsNxsGrp(RS_SERVICE_TYPE_VALIDATION_TEST);
+		grp->grpId = RsGxsGroupId::random();
+		grp->metaData = new RsGxsGrpMetaData;
+		grp->metaData->mGroupId = grp->grpId;
+		grp->metaData->mGroupFlags = GXS_SERV::FLAG_PRIVACY_PUBLIC;
+
+		RsGxsGroupId grpId = grp->grpId;
+		dataStore->storeGroup(std::list<RsNxsGrp*>(1, grp));
+
+		// enough messages to be checked on several threads, signed and unsigned ones interleaved
+
+		std::vector<RsNxsMsg*> msgs;
+		RsGxsMessageId::std_set unsignedIds, signedIds, stored;
+
+		for(uint32_t i=0;i<64;++i)
+		{
+			RsNxsMsg* msg = newReceivedMsg(grpId, (i%4 == 0) ? RsGxsId::random() : RsGxsId());
+			((i%4 == 0) ? signedIds : unsignedIds).insert(msg->msgId);
+			msgs.push_back(msg);
+		}
+
+		service.receiveNewMessages(msgs);
+		service.tick();
+
+		// each result is applied to its own message: unsigned ones are stored, the others wait for the author keys
+
+		storedMsgIds(dataStore, grpId, stored);
+		EXPECT_EQ(stored, unsignedIds);
+		EXPECT_EQ(gixs.mRequests.load(), signedIds.size());
+		EXPECT_EQ(netService->mRejected, 0u);
+
+		// keys still missing: retried on each tick
+
+		service.tick();
+		storedMsgIds(dataStore, grpId, stored);
+		EXPECT_EQ(stored, unsignedIds);
+		EXPECT_EQ(gixs.mRequests.load(), 2*signedIds.size());
+
+		// keys known, but the signatures cannot be checked: rejected, and no longer pending
+
+		gixs.mKnown = true;
+		service.tick();
+		service.tick();
+		storedMsgIds(dataStore, grpId, stored);
+		EXPECT_EQ(stored, unsignedIds);
+		EXPECT_EQ(gixs.mRequests.load(), 2*signedIds.size());
+		EXPECT_EQ(netService->mRejected, signedIds.size());
+	}
+
+	RsGenExchange::setValidationThreadCount(0);
+	RsExecutor::shutdown();
+	remove(VALIDATION_TEST_DB.c_str());
+}
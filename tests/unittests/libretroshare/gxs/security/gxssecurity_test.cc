@@ -93,3 +93,43 @@ TEST(libretroshare_gxs, GxsSecurity)
 }
 
 
+
+TEST(libretroshare_gxs, GxsSecurityKeyCache)
+{
+	RsTlvPublicRSAKey pub_key ;
+	RsTlvPrivateRSAKey priv_key ;
+
+	EXPECT_TRUE(GxsSecurity::generateKeyPair(pub_key,priv_key)) ;
+
+	uint32_t data_len = 1000 ;
+	RsTemporaryMemory data(data_len) ;
+	RSRandom::random_bytes((unsigned char *)data,data_len) ;
+
+	RsTlvKeySignature signature ;
+	EXPECT_TRUE(GxsSecurity::getSignature((char*)(unsigned char*)data,data_len,priv_key,signature) );
+
+	uint64_t hits0,misses0,hits1,misses1 ;
+	uint32_t size ;
+
+	GxsSecurity::getKeyCacheStatistics(hits0,misses0,size) ;
+
+	EXPECT_TRUE(GxsSecurity::validateSignature((char*)(unsigned char*)data,data_len,pub_key,signature) );
+	EXPECT_TRUE(GxsSecurity::validateSignature((char*)(unsigned char*)data,data_len,pub_key,signature) );
+	EXPECT_TRUE(GxsSecurity::validateSignature((char*)(unsigned char*)data,data_len,pub_key,signature) );
+
+	GxsSecurity::getKeyCacheStatistics(hits1,misses1,size) ;
+
+	EXPECT_EQ(misses0 + 1, misses1) ;
+	EXPECT_EQ(hits0 + 2, hits1) ;
+
+	// A different key sent with the same id must not be validated with the cached one
+
+	RsTlvPublicRSAKey other_pub_key ;
+	RsTlvPrivateRSAKey other_priv_key ;
+
+	EXPECT_TRUE(GxsSecurity::generateKeyPair(other_pub_key,other_priv_key)) ;
+	other_pub_key.keyId = pub_key.keyId ;
+
+	EXPECT_FALSE(GxsSecurity::validateSignature((char*)(unsigned char*)data,data_len,other_pub_key,signature) );
+	EXPECT_TRUE(GxsSecurity::validateSignature((char*)(unsigned char*)data,data_len,pub_key,signature) );
+}
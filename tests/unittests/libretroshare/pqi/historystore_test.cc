@@ -0,0 +1,113 @@
+/*******************************************************************************
+ * unittests/libretroshare/pqi/historystore_test.cc                            *
+ *                                                                             *
+ * Copyright (C) 2026  RetroShare Team <contact@retroshare.cc>                 *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Affero General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <stdio.h>
+
+// from libretroshare
+
+#include "pqi/historystore.h"
+#include "rsitems/rshistoryitems.h"
+
+#define HISTORY_DB_NAME "history_test_db"
+
+static void addMsg(HistoryStore& st, const RsPeerId& chat, uint32_t msgId, uint32_t recvTime)
+{
+	RsHistoryMsgItem item;
+	item.chatPeerId = chat;
+	item.msgPeerId = chat;
+	item.incoming = true;
+	item.peerName = "peer";
+	item.sendTime = recvTime;
+	item.recvTime = recvTime;
+	item.message = "message " + std::to_string(msgId);
+	item.msgId = msgId;
+
+	EXPECT_TRUE(st.addMessages(std::list<RsHistoryMsgItem*>(1, &item)));
+}
+
+static std::list<uint32_t> getIds(HistoryStore& st, const RsPeerId& chat, uint32_t count)
+{
+	std::list<RsHistoryMsgItem*> items;
+	std::list<uint32_t> ids;
+
+	EXPECT_TRUE(st.getMessages(chat, count, items));
+
+	for(std::list<RsHistoryMsgItem*>::iterator it(items.begin());it!=items.end();++it)
+	{
+		ids.push_back((*it)->msgId);
+		delete *it;
+	}
+	return ids;
+}
+
+TEST(libretroshare_pqi, HistoryStore)
+{
+	remove(HISTORY_DB_NAME);
+
+	RsPeerId chat1 = RsPeerId::random();
+	RsPeerId chat2 = RsPeerId::random();
+	{
+		HistoryStore st(HISTORY_DB_NAME, "");
+		ASSERT_TRUE(st.isOpen());
+		EXPECT_EQ(st.maxMsgId(), 0u);
+
+		for(uint32_t i=1;i<=10;++i)
+			addMsg(st, (i%2) ? chat1 : chat2, i, 1000 + i);
+
+		EXPECT_EQ(st.maxMsgId(), 10u);
+
+		// last messages, oldest first
+		EXPECT_EQ(getIds(st, chat1, 2), std::list<uint32_t>({ 7, 9 }));
+		EXPECT_EQ(getIds(st, chat2, 0), std::list<uint32_t>({ 2, 4, 6, 8, 10 }));
+
+		RsHistoryMsgItem *item = st.getMessage(4);
+		ASSERT_TRUE(item != NULL);
+		EXPECT_EQ(item->chatPeerId, chat2);
+		EXPECT_EQ(item->message, "message 4");
+		EXPECT_EQ(item->recvTime, 1004u);
+		delete item;
+
+		std::list<uint32_t> removed;
+		EXPECT_TRUE(st.removeMessages({ 4, 42 }, removed));
+		EXPECT_EQ(removed, std::list<uint32_t>({ 4 }));
+		EXPECT_TRUE(st.getMessage(4) == NULL);
+
+		EXPECT_TRUE(st.trimChat(chat2, 2));
+		EXPECT_EQ(getIds(st, chat2, 0), std::list<uint32_t>({ 8, 10 }));
+
+		EXPECT_TRUE(st.removeOlderThan(1005));
+		EXPECT_EQ(getIds(st, chat1, 0), std::list<uint32_t>({ 5, 7, 9 }));
+	}
+
+	// messages survive reopening the database
+	{
+		HistoryStore st(HISTORY_DB_NAME, "");
+		EXPECT_EQ(st.maxMsgId(), 10u);
+		EXPECT_EQ(getIds(st, chat1, 0), std::list<uint32_t>({ 5, 7, 9 }));
+
+		EXPECT_TRUE(st.clearChat(chat1));
+		EXPECT_TRUE(getIds(st, chat1, 0).empty());
+		EXPECT_EQ(getIds(st, chat2, 0), std::list<uint32_t>({ 8, 10 }));
+	}
+
+	remove(HISTORY_DB_NAME);
+}
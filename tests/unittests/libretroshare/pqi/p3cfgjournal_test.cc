@@ -0,0 +1,437 @@
+/*******************************************************************************
+ * unittests/libretroshare/pqi/p3cfgjournal_test.cc                            *
+ *                                                                             *
+ * Copyright (C) 2026  RetroShare Team <contact@retroshare.cc>                 *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Affero General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+#include <openssl/evp.h>
+#include <openssl/rsa.h>
+
+// from libretroshare
+
+#include "pqi/p3cfgjournal.h"
+#include "crypto/chacha20.h"
+#include "serialiser/rsbaseserial.h"
+#include "util/rsrandom.h"
+
+static const char *JOURNAL_NAME = "p3cfgjournal_test.jnl";
+
+/* Wraps journal keys with RSA-OAEP and signs headers with RSA-SHA256, like the
+ * node key does in p3Config. Remembers the last key, for the tests. */
+class RsaKeyStore: public p3ConfigJournal::KeyStore
+{
+public:
+	RsaKeyStore() : mKey(NULL)
+	{
+		EVP_PKEY_CTX *ctx = EVP_PKEY_CTX_new_id(EVP_PKEY_RSA,NULL);
+		EVP_PKEY_keygen_init(ctx);
+		EVP_PKEY_CTX_set_rsa_keygen_bits(ctx,2048);
+		EVP_PKEY_keygen(ctx,&mKey);
+		EVP_PKEY_CTX_free(ctx);
+
+		memset(lastKey,0,32);
+	}
+	~RsaKeyStore() override { EVP_PKEY_free(mKey); }
+
+	bool wrapKey(const uint8_t key[32], std::vector<uint8_t>& wrapped) override
+	{
+		memcpy(lastKey,key,32);
+		return crypt(true,std::vector<uint8_t>(key,key+32),wrapped);
+	}
+
+	bool unwrapKey(const std::vector<uint8_t>& wrapped, uint8_t key[32]) override
+	{
+		std::vector<uint8_t> out;
+
+		if(!crypt(false,wrapped,out) || out.size() != 32)
+			return false;
+
+		memcpy(key,out.data(),32);
+		return true;
+	}
+
+	bool sign(const std::vector<uint8_t>& data, std::vector<uint8_t>& signature) override
+	{
+		EVP_MD_CTX *ctx = EVP_MD_CTX_new();
+		size_t len = 0;
+
+		bool ok = EVP_DigestSignInit(ctx,NULL,EVP_sha256(),NULL,mKey) == 1
+		        && EVP_DigestSignUpdate(ctx,data.data(),data.size()) == 1
+		        && EVP_DigestSignFinal(ctx,NULL,&len) == 1;
+
+		signature.resize(len);
+		ok = ok && EVP_DigestSignFinal(ctx,signature.data(),&len) == 1;
+		signature.resize(len);
+
+		EVP_MD_CTX_free(ctx);
+		return ok;
+	}
+
+	bool verify(const std::vector<uint8_t>& data, const std::vector<uint8_t>& signature) override
+	{
+		EVP_MD_CTX *ctx = EVP_MD_CTX_new();
+
+		bool ok = EVP_DigestVerifyInit(ctx,NULL,EVP_sha256(),NULL,mKey) == 1
+		        && EVP_DigestVerifyUpdate(ctx,data.data(),data.size()) == 1
+		        && EVP_DigestVerifyFinal(ctx,signature.data(),signature.size()) == 1;
+
+		EVP_MD_CTX_free(ctx);
+		return ok;
+	}
+
+	uint8_t lastKey[32];
+
+private:
+	bool crypt(bool encrypt, const std::vector<uint8_t>& in, std::vector<uint8_t>& out)
+	{
+		EVP_PKEY_CTX *ctx = EVP_PKEY_CTX_new(mKey,NULL);
+		size_t len = 0;
+
+		bool ok = (encrypt ? EVP_PKEY_encrypt_init(ctx) : EVP_PKEY_decrypt_init(ctx)) == 1
+		        && EVP_PKEY_CTX_set_rsa_padding(ctx,RSA_PKCS1_OAEP_PADDING) == 1;
+
+		if(encrypt)
+			ok = ok && EVP_PKEY_encrypt(ctx,NULL,&len,in.data(),in.size()) == 1;
+		else
+			ok = ok && EVP_PKEY_decrypt(ctx,NULL,&len,in.data(),in.size()) == 1;
+
+		out.resize(len);
+
+		if(encrypt)
+			ok = ok && EVP_PKEY_encrypt(ctx,out.data(),&len,in.data(),in.size()) == 1;
+		else
+			ok = ok && EVP_PKEY_decrypt(ctx,out.data(),&len,in.data(),in.size()) == 1;
+
+		out.resize(len);
+		EVP_PKEY_CTX_free(ctx);
+		return ok;
+	}
+
+	EVP_PKEY *mKey;
+};
+
+static std::vector<uint8_t> readFile(const char *fname)
+{
+	std::ifstream f(fname,std::ios::binary);
+	return std::vector<uint8_t>(std::istreambuf_iterator<char>(f),std::istreambuf_iterator<char>());
+}
+
+static void writeFile(const char *fname, const std::vector<uint8_t>& data)
+{
+	std::ofstream f(fname,std::ios::binary|std::ios::trunc);
+	f.write((const char*)data.data(),data.size());
+}
+
+static std::vector<uint8_t> randomPayload(uint32_t size)
+{
+	std::vector<uint8_t> payload(size);
+	RsRandom::random_bytes(payload.data(),size);
+	return payload;
+}
+
+/* Writes a journal of the given records, and returns the offset of the first record */
+static uint64_t writeJournal( RsaKeyStore& keys, const RsFileHash& configHash,
+                              const std::vector<std::vector<uint8_t> >& records )
+{
+	p3ConfigJournal journal(keys);
+
+	EXPECT_TRUE(journal.create(JOURNAL_NAME,configHash));
+	uint64_t headerSize = journal.size();
+
+	for(auto& r: records)
+		EXPECT_TRUE(journal.append(r));
+
+	EXPECT_EQ(journal.recordCount(), records.size());
+	return headerSize;
+}
+
+static std::list<std::vector<uint8_t> > readJournal(RsaKeyStore& keys, const RsFileHash& configHash, bool& ok)
+{
+	p3ConfigJournal journal(keys);
+	std::list<std::vector<uint8_t> > payloads;
+
+	ok = journal.open(JOURNAL_NAME,configHash,payloads);
+	return payloads;
+}
+
+TEST(libretroshare_pqi, p3ConfigJournal_header)
+{
+	RsaKeyStore keys;
+	RsFileHash configHash = RsFileHash::random();
+
+	writeJournal(keys,configHash,{});
+	std::vector<uint8_t> data = readFile(JOURNAL_NAME);
+
+	uint32_t offset = 0;
+	uint32_t magic = 0;
+	uint32_t wrappedLen = 0;
+	uint32_t sigLen = 0;
+
+	ASSERT_TRUE(getRawUInt32(data.data(),data.size(),&offset,&magic));
+	EXPECT_EQ(magic, p3ConfigJournal::MAGIC);
+	EXPECT_EQ(RsFileHash(&data[offset]), configHash);
+	offset += RsFileHash::SIZE_IN_BYTES;
+
+	// the key is stored wrapped, and unwraps to the record key
+
+	ASSERT_TRUE(getRawUInt32(data.data(),data.size(),&offset,&wrappedLen));
+	ASSERT_LE(offset + wrappedLen, data.size());
+
+	std::vector<uint8_t> wrapped(data.begin() + offset,data.begin() + offset + wrappedLen);
+	uint8_t key[32];
+
+	EXPECT_EQ(wrappedLen, 256u);	// RSA 2048
+	EXPECT_EQ(std::search(wrapped.begin(),wrapped.end(),keys.lastKey,keys.lastKey+32), wrapped.end());
+	ASSERT_TRUE(keys.unwrapKey(wrapped,key));
+	EXPECT_EQ(memcmp(key,keys.lastKey,32), 0);
+	offset += wrappedLen;
+
+	// the signature covers the header
+
+	std::vector<uint8_t> header(data.begin(),data.begin() + offset);
+
+	ASSERT_TRUE(getRawUInt32(data.data(),data.size(),&offset,&sigLen));
+	ASSERT_EQ(offset + sigLen, data.size());
+	EXPECT_TRUE(keys.verify(header,std::vector<uint8_t>(data.begin() + offset,data.end())));
+
+	bool ok;
+	readJournal(keys,configHash,ok);
+	EXPECT_TRUE(ok);
+
+	// journal of another config file
+	readJournal(keys,RsFileHash::random(),ok);
+	EXPECT_FALSE(ok);
+
+	// journal signed by another key
+	RsaKeyStore otherKeys;
+	readJournal(otherKeys,configHash,ok);
+	EXPECT_FALSE(ok);
+
+	// forged config hash
+	std::vector<uint8_t> forged(data);
+	RsFileHash otherHash = RsFileHash::random();
+	memcpy(&forged[4],otherHash.toByteArray(),RsFileHash::SIZE_IN_BYTES);
+	writeFile(JOURNAL_NAME,forged);
+
+	readJournal(keys,otherHash,ok);
+	EXPECT_FALSE(ok);
+
+	// bad magic
+	forged = data;
+	forged[0] ^= 0x01;
+	writeFile(JOURNAL_NAME,forged);
+
+	readJournal(keys,configHash,ok);
+	EXPECT_FALSE(ok);
+
+	remove(JOURNAL_NAME);
+}
+
+TEST(libretroshare_pqi, p3ConfigJournal_records)
+{
+	RsaKeyStore keys;
+	RsFileHash configHash = RsFileHash::random();
+	std::vector<std::vector<uint8_t> > records = { randomPayload(1), randomPayload(100), randomPayload(5000) };
+
+	uint64_t headerSize = writeJournal(keys,configHash,records);
+	std::vector<uint8_t> data = readFile(JOURNAL_NAME);
+
+	// records are [size] [encrypted payload] [tag], the payload is not in clear
+
+	uint64_t offset = headerSize;
+
+	for(uint32_t i=0;i<records.size();++i)
+	{
+		uint32_t size = 0;
+		uint32_t o = offset;
+
+		ASSERT_TRUE(getRawUInt32(data.data(),data.size(),&o,&size));
+		ASSERT_EQ(size, records[i].size());
+
+		if(size > 16)
+			EXPECT_EQ(std::search(data.begin()+offset,data.end(),records[i].begin(),records[i].end()), data.end());
+
+		offset += 4 + size + p3ConfigJournal::TAG_SIZE;
+	}
+	EXPECT_EQ(offset, data.size());
+
+	bool ok;
+	std::list<std::vector<uint8_t> > payloads = readJournal(keys,configHash,ok);
+
+	EXPECT_TRUE(ok);
+	EXPECT_EQ(payloads, std::list<std::vector<uint8_t> >(records.begin(),records.end()));
+
+	// any change in the size, payload or tag of a record drops it and the following ones
+
+	uint64_t secondRecord = headerSize + 4 + 1 + p3ConfigJournal::TAG_SIZE;
+	uint64_t changes[] = { secondRecord + 3, secondRecord + 10, secondRecord + 4 + 100 + 5 };
+
+	for(uint64_t pos: changes)
+	{
+		std::vector<uint8_t> tampered(data);
+		tampered[pos] ^= 0x01;
+		writeFile(JOURNAL_NAME,tampered);
+
+		payloads = readJournal(keys,configHash,ok);
+		EXPECT_TRUE(ok);
+		EXPECT_EQ(payloads, std::list<std::vector<uint8_t> >(records.begin(),records.begin()+1));
+	}
+
+	remove(JOURNAL_NAME);
+}
+
+TEST(libretroshare_pqi, p3ConfigJournal_nonce)
+{
+	RsaKeyStore keys;
+	RsFileHash configHash = RsFileHash::random();
+	std::vector<std::vector<uint8_t> > records = { randomPayload(50), randomPayload(50), randomPayload(50) };
+
+	uint64_t headerSize = writeJournal(keys,configHash,records);
+	std::vector<uint8_t> data = readFile(JOURNAL_NAME);
+	uint32_t recordSize = 4 + 50 + p3ConfigJournal::TAG_SIZE;
+
+	// record i is encrypted with the nonce made from counter i
+
+	for(uint32_t i=0;i<records.size();++i)
+	{
+		std::vector<uint8_t> record(data.begin() + headerSize + i*recordSize,data.begin() + headerSize + (i+1)*recordSize);
+		uint8_t nonce[12];
+
+		p3ConfigJournal::recordNonce(i,nonce);
+		EXPECT_TRUE(librs::crypto::AEAD_chacha20_poly1305(keys.lastKey,nonce,&record[4],50,&record[0],4,&record[4+50],false));
+		EXPECT_EQ(std::vector<uint8_t>(record.begin()+4,record.begin()+4+50), records[i]);
+
+		record.assign(data.begin() + headerSize + i*recordSize,data.begin() + headerSize + (i+1)*recordSize);
+		p3ConfigJournal::recordNonce(i+1,nonce);
+		EXPECT_FALSE(librs::crypto::AEAD_chacha20_poly1305(keys.lastKey,nonce,&record[4],50,&record[0],4,&record[4+50],false));
+	}
+
+	// so records cannot be re-ordered
+
+	std::vector<uint8_t> swapped(data);
+	std::copy(data.begin() + headerSize,data.begin() + headerSize + recordSize,swapped.begin() + headerSize + recordSize);
+	std::copy(data.begin() + headerSize + recordSize,data.begin() + headerSize + 2*recordSize,swapped.begin() + headerSize);
+	writeFile(JOURNAL_NAME,swapped);
+
+	bool ok;
+	std::list<std::vector<uint8_t> > payloads = readJournal(keys,configHash,ok);
+
+	EXPECT_TRUE(ok);
+	EXPECT_TRUE(payloads.empty());
+
+	// nor be removed
+
+	std::vector<uint8_t> removed(data);
+	removed.erase(removed.begin() + headerSize,removed.begin() + headerSize + recordSize);
+	writeFile(JOURNAL_NAME,removed);
+
+	payloads = readJournal(keys,configHash,ok);
+	EXPECT_TRUE(ok);
+	EXPECT_TRUE(payloads.empty());
+
+	remove(JOURNAL_NAME);
+}
+
+TEST(libretroshare_pqi, p3ConfigJournal_replay)
+{
+	RsaKeyStore keys;
+	RsFileHash configHash = RsFileHash::random();
+	std::vector<std::vector<uint8_t> > records = { randomPayload(10), randomPayload(20) };
+
+	writeJournal(keys,configHash,records);
+
+	// re-opening goes on with the next record number
+
+	{
+		p3ConfigJournal journal(keys);
+		std::list<std::vector<uint8_t> > payloads;
+
+		ASSERT_TRUE(journal.open(JOURNAL_NAME,configHash,payloads));
+		EXPECT_EQ(payloads.size(), 2u);
+		EXPECT_EQ(journal.recordCount(), 2u);
+		EXPECT_EQ(journal.size(), readFile(JOURNAL_NAME).size());
+
+		records.push_back(randomPayload(30));
+		EXPECT_TRUE(journal.append(records.back()));
+	}
+
+	bool ok;
+	std::list<std::vector<uint8_t> > payloads = readJournal(keys,configHash,ok);
+
+	EXPECT_TRUE(ok);
+	EXPECT_EQ(payloads, std::list<std::vector<uint8_t> >(records.begin(),records.end()));
+
+	// a new journal has a new key: records of the former one do not replay in it
+
+	std::vector<uint8_t> former = readFile(JOURNAL_NAME);
+	uint64_t headerSize = writeJournal(keys,configHash,{});
+	std::vector<uint8_t> data = readFile(JOURNAL_NAME);
+
+	data.insert(data.end(),former.begin() + headerSize,former.end());
+	writeFile(JOURNAL_NAME,data);
+
+	payloads = readJournal(keys,configHash,ok);
+	EXPECT_TRUE(ok);
+	EXPECT_TRUE(payloads.empty());
+
+	remove(JOURNAL_NAME);
+}
+
+TEST(libretroshare_pqi, p3ConfigJournal_badLastRecord)
+{
+	RsaKeyStore keys;
+	RsFileHash configHash = RsFileHash::random();
+	std::vector<std::vector<uint8_t> > records = { randomPayload(10), randomPayload(20), randomPayload(30) };
+
+	writeJournal(keys,configHash,records);
+	std::vector<uint8_t> data = readFile(JOURNAL_NAME);
+
+	std::vector<uint8_t> truncated(data.begin(),data.end() - 5);
+	std::vector<uint8_t> tampered(data);
+	tampered.back() ^= 0x80;
+
+	for(auto& bad: { truncated, tampered })
+	{
+		writeFile(JOURNAL_NAME,bad);
+
+		// the last record is dropped, and the next one is written over it
+
+		{
+			p3ConfigJournal journal(keys);
+			std::list<std::vector<uint8_t> > payloads;
+
+			ASSERT_TRUE(journal.open(JOURNAL_NAME,configHash,payloads));
+			EXPECT_EQ(payloads, std::list<std::vector<uint8_t> >(records.begin(),records.begin()+2));
+			EXPECT_EQ(journal.recordCount(), 2u);
+			EXPECT_TRUE(journal.append(records[0]));
+		}
+
+		bool ok;
+		std::list<std::vector<uint8_t> > payloads = readJournal(keys,configHash,ok);
+
+		EXPECT_TRUE(ok);
+		EXPECT_EQ(payloads, std::list<std::vector<uint8_t> >({ records[0], records[1], records[0] }));
+	}
+
+	remove(JOURNAL_NAME);
+}
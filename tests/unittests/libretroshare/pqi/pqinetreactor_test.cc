@@ -0,0 +1,172 @@
+/*******************************************************************************
+ * unittests/libretroshare/pqi/pqinetreactor_test.cc                           *
+ *                                                                             *
+ * Copyright (C) 2026  RetroShare Team <contact@retroshare.cc>                 *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Affero General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#ifdef __linux__
+
+#include <atomic>
+#include <thread>
+#include <ctime>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// from libretroshare
+
+#include "pqi/pqinetreactor.h"
+#include "pqi/pqithreadstreamer.h"
+#include "rsitems/rsitem.h"
+#include "serialiser/rsserializer.h"
+
+static const uint32_t TEST_PKT_SIZE = 1024;
+
+/// Bandwidth limited socket, like pqissl without the SSL layer
+class TestSocketBin: public BinInterface
+{
+public:
+	explicit TestSocketBin(int fd) : mFd(fd) {}
+	~TestSocketBin() override { close(); }
+
+	int tick() override { return 0; }
+
+	int senddata(void* data, int len) override
+	{ return static_cast<int>(send(mFd, data, len, MSG_DONTWAIT)); }
+
+	/* pqistreamer expects either the whole len or nothing read */
+	int readdata(void* data, int len) override
+	{
+		if(recv(mFd, data, len, MSG_PEEK | MSG_DONTWAIT) < len) return 0;
+		return static_cast<int>(recv(mFd, data, len, MSG_DONTWAIT));
+	}
+
+	int netstatus() override { return 1; }
+	int isactive() override { return mFd >= 0; }
+
+	bool moretoread(uint32_t) override
+	{
+		pollfd pfd = { mFd, POLLIN, 0 };
+		return poll(&pfd, 1, 0) > 0;
+	}
+
+	bool cansend(uint32_t) override { return true; }
+	int pollableFd() override { return mFd; }
+
+	int close() override
+	{
+		if(mFd >= 0) ::close(mFd);
+		mFd = -1;
+		return 1;
+	}
+
+	RsFileHash gethash() override { return RsFileHash(); }
+	bool bandwidthLimited() override { return true; }
+
+private:
+	int mFd;
+};
+
+class TestParent: public PQInterface
+{
+public:
+	TestParent() : PQInterface(RsPeerId::random()), mItems(0) {}
+
+	int SendItem(RsItem* item) override { delete item; return 0; }
+	RsItem* GetItem() override { return nullptr; }
+	bool RecvItem(RsItem* item) override { ++mItems; delete item; return true; }
+
+	std::atomic<uint32_t> mItems;
+};
+
+static double processCpuSeconds()
+{
+	timespec ts;
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+TEST(libretroshare_pqi, pqiNetReactorThrottledPeer)
+{
+	int fds[2];
+	ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+
+	pqiNetReactor::setThreadCount(1);
+	ASSERT_TRUE(pqiNetReactor::instance() != nullptr);
+
+	TestParent parent;
+	RsSerialiser* rss = new RsSerialiser();
+	rss->addSerialType(new RsRawSerialiser());
+	pqithreadstreamer* streamer = new pqithreadstreamer(
+	            &parent, rss, parent.PeerId(), new TestSocketBin(fds[0]), 0 );
+
+	const float maxRateKBs = 64;
+	streamer->setMaxRate(true, maxRateKBs);
+
+	// The peer sends as fast as the socket lets it
+	std::atomic<bool> stop(false);
+	std::thread sender([&]()
+	{
+		std::vector<uint8_t> pkt(TEST_PKT_SIZE, 0xaa);
+		setRsItemHeader(pkt.data(), TEST_PKT_SIZE, 0x02aabb01, TEST_PKT_SIZE);
+
+		size_t offset = 0;
+		while(!stop)
+		{
+			ssize_t n = send( fds[1], pkt.data() + offset,
+			                  pkt.size() - offset, MSG_DONTWAIT );
+			if(n > 0) offset = (offset + n) % pkt.size();
+			else std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+	});
+
+	streamer->startStreaming("test streamer");
+
+	// Let the rate estimation settle before measuring
+	std::this_thread::sleep_for(std::chrono::milliseconds(500));
+
+	const uint32_t startItems = parent.mItems;
+	const double startCpu = processCpuSeconds();
+	const auto start = std::chrono::steady_clock::now();
+
+	std::this_thread::sleep_for(std::chrono::seconds(2));
+
+	const double elapsed = std::chrono::duration<double>(
+	            std::chrono::steady_clock::now() - start ).count();
+	const double cpu = processCpuSeconds() - startCpu;
+	const double receivedKB =
+	        (parent.mItems - startItems) * TEST_PKT_SIZE / 1024.0;
+
+	streamer->fullstopStreaming();
+	stop = true;
+	sender.join();
+
+	// Data flows, but not faster than allowed
+	EXPECT_GT(receivedKB, 0);
+	EXPECT_LT(receivedKB, 1.5 * maxRateKBs * elapsed + 16);
+
+	// The reactor thread does not spin on the always readable socket
+	EXPECT_LT(cpu, 0.5 * elapsed);
+
+	delete streamer;
+	::close(fds[1]);
+	pqiNetReactor::shutdown();
+}
+
+#endif // def __linux__
@@ -0,0 +1,402 @@
+/*******************************************************************************
+ * unittests/libretroshare/pqi/pqiqosstreamer_test.cc                          *
+ *                                                                             *
+ * Copyright (C) 2026  RetroShare Team <contact@retroshare.cc>                 *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Affero General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstring>
+#include <list>
+#include <vector>
+
+// from libretroshare
+
+#include "pqi/pqiqosstreamer.h"
+#include "rsitems/rsitem.h"
+#include "serialiser/rsserial.h"
+#include "serialiser/rsserializer.h"
+#include "util/rsrandom.h"
+
+typedef std::vector<uint8_t> Packet;
+
+static const uint32_t TEST_PKT_TYPE = 0x02123401;
+static const uint32_t OPTIMAL_PACKET_SIZE = 512;	// PQISTREAM_OPTIMAL_PACKET_SIZE
+static const uint8_t SLICING_PROBE[8] = { 0x02, 0xaa, 0xbb, 0xcc, 0x00, 0x00, 0x00, 0x08 };
+
+/* Every third write fails, like an SSL_write() that would block. The same
+ * buffer, with the same content, must then be written again. */
+class WriteRefusal
+{
+public:
+	WriteRefusal() : mCalls(0) {}
+	bool refuse() { return ++mCalls % 3 == 0; }
+
+private:
+	uint32_t mCalls;
+};
+
+/* Records the packets written by the streamer, and hands it a packet slicing
+ * probe to read when asked to. */
+class CaptureBin: public BinInterface
+{
+public:
+	CaptureBin() : mProbeToRead(false), mRefused(NULL) {}
+
+	int tick() override { return 0; }
+
+	int senddata(void *data, int len) override
+	{
+		if(mRefused)
+		{
+			EXPECT_EQ(data, mRefused);
+			EXPECT_EQ(Packet((uint8_t*)data, (uint8_t*)data + len), mRefusedContent);
+		}
+
+		if(mRefusal.refuse())
+		{
+			mRefused = data;
+			mRefusedContent.assign((uint8_t*)data, (uint8_t*)data + len);
+			return -1;
+		}
+
+		mRefused = NULL;
+		mPackets.push_back(Packet((uint8_t*)data, (uint8_t*)data + len));
+		return len;
+	}
+
+	int readdata(void *data, int len) override
+	{
+		if(!mProbeToRead || len != sizeof(SLICING_PROBE))
+			return 0;
+
+		memcpy(data, SLICING_PROBE, len);
+		mProbeToRead = false;
+		return len;
+	}
+
+	int netstatus() override { return 1; }
+	int isactive() override { return 1; }
+	bool moretoread(uint32_t) override { return mProbeToRead; }
+	bool cansend(uint32_t) override { return true; }
+	int close() override { return 1; }
+	RsFileHash gethash() override { return RsFileHash(); }
+	bool bandwidthLimited() override { return false; }
+
+	bool mProbeToRead;
+	std::vector<Packet> mPackets;
+
+private:
+	WriteRefusal mRefusal;
+	void *mRefused;
+	Packet mRefusedContent;
+};
+
+class TestParent: public PQInterface
+{
+public:
+	TestParent() : PQInterface(RsPeerId::random()) {}
+
+	int SendItem(RsItem *item) override { delete item; return 0; }
+	RsItem *GetItem() override { return nullptr; }
+	bool RecvItem(RsItem *item) override { delete item; return true; }
+};
+
+class TestQoSStreamer: public pqiQoSstreamer
+{
+public:
+	TestQoSStreamer(PQInterface *parent, RsSerialiser *rss, BinInterface *bio) :
+	    pqiQoSstreamer(parent, rss, parent->PeerId(), bio, 0) {}
+
+	using pqistreamer::tick_recv;
+	using pqistreamer::tick_send;
+};
+
+/* pqiQoS slicing and pqistreamer packing as they were when each slice was
+ * malloc()ed and copied out of its item, then copied again into the packet. */
+class CopyPathReference
+{
+public:
+	CopyPathReference(uint32_t nb_levels, float alpha, bool slicing) :
+	    mQueues(nb_levels), mIdCounter(0), mSlicing(slicing), mProbe(true), mPending(NULL), mPendingSize(0)
+	{
+		float c = 1.0f ;
+
+		for(int i=((int)nb_levels)-1;i>=0;--i,c *= alpha)
+		{
+			mQueues[i].threshold = c ;
+			mQueues[i].counter = 0 ;
+			mQueues[i].inc = alpha ;
+		}
+	}
+	~CopyPathReference()
+	{
+		free(mPending);
+
+		for(uint32_t i=0;i<mQueues.size();++i)
+			for(auto& rec: mQueues[i].items)
+				free(rec.data);
+	}
+
+	void push(const Packet& item, uint32_t priority)
+	{
+		Record rec;
+		rec.data = malloc(item.size());
+		memcpy(rec.data, item.data(), item.size());
+		rec.offset = 0;
+		rec.size = item.size();
+		rec.id = mIdCounter++;
+
+		mQueues[std::min<uint32_t>(priority, mQueues.size()-1)].items.push_back(rec);
+	}
+
+	// One round of pqistreamer::handleoutgoing_locked()
+	void tick()
+	{
+		for(;;)
+		{
+			if(!mPending)
+				buildPacket();
+
+			if(!mPending)
+				return;
+
+			if(mRefusal.refuse())
+				return;
+
+			mPackets.push_back(Packet((uint8_t*)mPending, (uint8_t*)mPending + mPendingSize));
+			free(mPending);
+			mPending = NULL;
+			mPendingSize = 0;
+		}
+	}
+
+	std::vector<Packet> mPackets;
+
+private:
+	struct Record
+	{
+		void *data;
+		uint32_t offset;
+		uint32_t size;
+		uint32_t id;
+	};
+	struct Queue
+	{
+		std::list<Record> items;
+		float threshold;
+		float counter;
+		float inc;
+	};
+
+	void *slice(Queue& q, uint32_t max_size, uint32_t& size, bool& starts, bool& ends, uint32_t& packet_id)
+	{
+		Record& rec(q.items.front());
+		packet_id = rec.id;
+
+		if(rec.offset == 0 && rec.size < max_size)
+		{
+			starts = ends = true;
+			size = rec.size;
+
+			void *item = rec.data;
+			q.items.pop_front();
+			return item;
+		}
+		starts = (rec.offset == 0);
+		ends = (rec.offset + max_size >= rec.size);
+
+		size = std::min(max_size, rec.size - rec.offset);
+		void *mem = malloc(size);
+		memcpy(mem, (uint8_t*)rec.data + rec.offset, size);
+
+		if(ends)
+		{
+			free(rec.data);
+			q.items.pop_front();
+		}
+		else
+			rec.offset += size;
+
+		return mem;
+	}
+
+	void *popSlice(uint32_t max_size, uint32_t& size, bool& starts, bool& ends, uint32_t& packet_id)
+	{
+		float inc = 1.0f;
+		int i = mQueues.size()-1;
+		bool empty = true;
+
+		for(uint32_t j=0;j<mQueues.size();++j)
+			empty = empty && mQueues[j].items.empty();
+
+		if(empty)
+			return NULL;
+
+		while(i > 0 && mQueues[i].items.empty())
+			--i, inc = mQueues[i].inc;
+
+		int last = i;
+
+		for(int j=i;j>=0;--j)
+			if(!mQueues[j].items.empty() && (mQueues[j].counter += inc) >= mQueues[j].threshold)
+			{
+				last = j;
+				mQueues[j].counter -= mQueues[j].threshold;
+			}
+
+		return slice(mQueues[last], max_size, size, starts, ends, packet_id);
+	}
+
+	void append(const void *data, uint32_t size)
+	{
+		mPending = realloc(mPending, mPendingSize + size);
+		memcpy((uint8_t*)mPending + mPendingSize, data, size);
+		mPendingSize += size;
+	}
+
+	void buildPacket()
+	{
+		if(mProbe)
+		{
+			append(SLICING_PROBE, sizeof(SLICING_PROBE));
+			mProbe = false;
+		}
+
+		do
+		{
+			uint32_t size, packet_id;
+			bool starts, ends;
+			void *dta = popSlice(mSlicing ? OPTIMAL_PACKET_SIZE : getRsPktMaxSize(), size, starts, ends, packet_id);
+
+			if(!dta)
+				break;
+
+			if(!(starts && ends))
+			{
+				uint8_t header[8] = { 0x10, uint8_t((starts ? 0x01 : 0) | (ends ? 0x02 : 0)),
+				                      uint8_t(packet_id >> 24), uint8_t(packet_id >> 16), uint8_t(packet_id >> 8), uint8_t(packet_id),
+				                      uint8_t(size >> 8), uint8_t(size) };
+				append(header, sizeof(header));
+			}
+			append(dta, size);
+			free(dta);
+		}
+		while(mPendingSize < OPTIMAL_PACKET_SIZE);
+	}
+
+	std::vector<Queue> mQueues;
+	uint32_t mIdCounter;
+	bool mSlicing;
+	bool mProbe;
+	WriteRefusal mRefusal;
+	void *mPending;
+	uint32_t mPendingSize;
+};
+
+static RsRawItem *newRawItem(uint32_t size, uint8_t priority, Packet& bytes)
+{
+	RsRawItem *item = new RsRawItem(TEST_PKT_TYPE, size);
+	uint8_t *data = (uint8_t*)item->getRawData();
+
+	RsRandom::random_bytes(data, size);
+	setRsItemHeader(data, size, TEST_PKT_TYPE, size);
+	item->setPriorityLevel(priority);
+
+	bytes.assign(data, data + size);
+	return item;
+}
+
+// Small, packed items, items around the slice size and large sliced items, at several priorities.
+static const uint32_t ITEM_SIZES[] = { 20, 100, 511, 512, 513, 30, 5000, 64, 1024, 40000, 300, 8, 2047, 12 };
+
+static void checkSameStream(bool slicing)
+{
+	TestParent parent;
+	RsSerialiser *rss = new RsSerialiser();
+	rss->addSerialType(new RsRawSerialiser());
+
+	CaptureBin *bio = new CaptureBin;
+	TestQoSStreamer streamer(&parent, rss, bio);
+
+	if(slicing)
+	{
+		bio->mProbeToRead = true;
+		streamer.tick_recv(0);
+		ASSERT_FALSE(bio->mProbeToRead);
+	}
+
+	CopyPathReference reference(pqiQoSstreamer::PQI_QOS_STREAMER_MAX_LEVELS, pqiQoSstreamer::PQI_QOS_STREAMER_ALPHA, slicing);
+
+	// Items are queued between the rounds, so that new ones, some of higher priority,
+	// come in while large items are being sliced and while a write is pending.
+
+	for(uint32_t round=0;round<20;++round)
+	{
+		for(uint32_t i=0;i<3;++i)
+		{
+			uint32_t size = ITEM_SIZES[(3*round + i) % (sizeof(ITEM_SIZES)/sizeof(uint32_t))];
+			uint8_t priority = (round + i) % pqiQoSstreamer::PQI_QOS_STREAMER_MAX_LEVELS;
+			Packet bytes;
+			uint32_t serialized_size;
+
+			streamer.SendItem(newRawItem(size, priority, bytes), serialized_size);
+			reference.push(bytes, priority);
+		}
+
+		streamer.tick_send(0);
+		reference.tick();
+	}
+
+	for(uint32_t round=0;round<1000 && streamer.getQueueSize(false) > 0;++round)
+	{
+		streamer.tick_send(0);
+		reference.tick();
+	}
+	streamer.tick_send(0);
+	reference.tick();
+
+	EXPECT_EQ(streamer.getQueueSize(false), 0);
+	ASSERT_EQ(bio->mPackets.size(), reference.mPackets.size());
+
+	for(uint32_t i=0;i<bio->mPackets.size();++i)
+		EXPECT_EQ(bio->mPackets[i], reference.mPackets[i]) << "packet " << i;
+
+	// large items were sliced, and only when the peer accepts slices
+
+	uint32_t slicedPackets = 0;
+
+	for(uint32_t i=1;i<bio->mPackets.size();++i)
+		if(bio->mPackets[i][0] == 0x10)
+			++slicedPackets;
+
+	if(slicing)
+		EXPECT_GT(slicedPackets, 0u);
+	else
+		EXPECT_EQ(slicedPackets, 0u);
+}
+
+TEST(libretroshare_pqi, pqiQoSstreamer_SlicedStreamMatchesCopyPath)
+{
+	checkSameStream(true);
+}
+
+TEST(libretroshare_pqi, pqiQoSstreamer_UnslicedStreamMatchesCopyPath)
+{
+	checkSameStream(false);
+}
@@ -0,0 +1,159 @@
+/*******************************************************************************
+ * unittests/libretroshare/services/events/rseventsservice_test.cc             *
+ *                                                                             *
+ * Copyright (C) 2026  RetroShare Team <contact@retroshare.cc>                 *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Affero General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <thread>
+
+// from libretroshare
+
+#include "services/rseventsservice.h"
+
+struct TestEvent: RsEvent
+{
+	TestEvent(uint32_t num, const std::string& key) :
+	    RsEvent(RsEventType::GXS_IDENTITY), mNum(num), mKey(key) {}
+
+	std::string coalescingKey() const override { return mKey; }
+
+	uint32_t mNum;
+	std::string mKey;
+};
+
+static bool waitFor(const std::function<bool()>& cond)
+{
+	for(int i = 0; i < 200 && !cond(); ++i)
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	return cond();
+}
+
+static RsEventsHandlerStatistic getStatistic(
+        RsEventsService& events, RsEventsHandlerId_t hId )
+{
+	std::vector<RsEventsHandlerStatistic> stats;
+	events.getEventsHandlersStatistics(stats);
+	for(const RsEventsHandlerStatistic& s: stats)
+		if(s.mHandlerId == hId) return s;
+	return RsEventsHandlerStatistic();
+}
+
+TEST(libretroshare_services, RsEventsService)
+{
+	RsEventsService events;
+	EXPECT_TRUE(events.start("test events"));
+
+	// a blocked handler does not delay the others
+	std::atomic<bool> release(false);
+	std::atomic<int> slowCalls(0);
+	std::vector<uint32_t> slowNums;
+	RsEventsHandlerId_t slowId = 0;
+	EXPECT_FALSE(events.registerEventsHandler(
+	                 [&](std::shared_ptr<const RsEvent> e)
+	{
+		slowNums.push_back(static_cast<const TestEvent&>(*e).mNum);
+		++slowCalls;
+		while(!release) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}, slowId, RsEventType::GXS_IDENTITY ));
+
+	std::mutex fastMtx;
+	std::vector<uint32_t> fastNums;
+	RsEventsHandlerId_t fastId = 0;
+	EXPECT_FALSE(events.registerEventsHandler(
+	                 [&](std::shared_ptr<const RsEvent> e)
+	{
+		std::lock_guard<std::mutex> lock(fastMtx);
+		fastNums.push_back(static_cast<const TestEvent&>(*e).mNum);
+	}, fastId ));
+
+	events.postEvent(std::make_shared<TestEvent>(0, ""));
+	EXPECT_TRUE(waitFor([&]() { return slowCalls == 1; }));
+
+	// events with the same key coalesce while they wait
+	for(uint32_t i = 1; i <= 5; ++i)
+		events.postEvent(std::make_shared<TestEvent>(i, "same"));
+	for(uint32_t i = 6; i < 100; ++i)
+		events.postEvent(std::make_shared<TestEvent>(i, ""));
+
+	EXPECT_TRUE(waitFor([&]()
+	{
+		std::lock_guard<std::mutex> lock(fastMtx);
+		return !fastNums.empty() && fastNums.back() == 99;
+	}));
+	EXPECT_EQ(slowCalls, 1);
+
+	RsEventsHandlerStatistic slowStats = getStatistic(events, slowId);
+	EXPECT_EQ(slowStats.mEventType, RsEventType::GXS_IDENTITY);
+	EXPECT_EQ(slowStats.mCoalescedEvents, 4u);
+	EXPECT_EQ(slowStats.mQueueDepth, 95u);
+	EXPECT_EQ(slowStats.mMaxQueueDepth, 95u);
+
+	// the fast handler got every event, in order
+	RsEventsHandlerStatistic fastStats = getStatistic(events, fastId);
+	{
+		std::lock_guard<std::mutex> lock(fastMtx);
+		EXPECT_EQ(fastNums.size() + fastStats.mCoalescedEvents, 100u);
+		for(size_t i = 1; i < fastNums.size(); ++i)
+			EXPECT_LT(fastNums[i-1], fastNums[i]);
+	}
+
+	// the coalesced event took the place of the first one, with the last value
+	release = true;
+	EXPECT_TRUE(waitFor([&]() { return slowCalls == 96; }));
+	ASSERT_EQ(slowNums.size(), 96u);
+	EXPECT_EQ(slowNums[1], 5u);
+	for(size_t i = 2; i < slowNums.size(); ++i)
+		EXPECT_EQ(slowNums[i], i + 4);
+
+	slowStats = getStatistic(events, slowId);
+	EXPECT_EQ(slowStats.mHandledEvents, 96u);
+	EXPECT_EQ(slowStats.mQueueDepth, 0u);
+	EXPECT_GT(slowStats.mMaxLatencyUs, 0u);
+	EXPECT_GT(slowStats.mMaxRunTimeUs, 0u);
+
+	// once unregister returns the handler is over and not called anymore
+	release = false;
+	events.postEvent(std::make_shared<TestEvent>(100, ""));
+	EXPECT_TRUE(waitFor([&]() { return slowCalls == 97; }));
+	events.postEvent(std::make_shared<TestEvent>(101, ""));
+
+	std::thread releaser([&]()
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+		release = true;
+	});
+	EXPECT_FALSE(events.unregisterEventsHandler(slowId));
+	EXPECT_TRUE(release);
+	releaser.join();
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	EXPECT_EQ(slowCalls, 97);
+	EXPECT_TRUE(events.unregisterEventsHandler(slowId));
+
+	// sendEvent still calls the handlers on the caller thread
+	std::thread::id callerThread;
+	RsEventsHandlerId_t syncId = 0;
+	events.registerEventsHandler([&](std::shared_ptr<const RsEvent>)
+	{ callerThread = std::this_thread::get_id(); }, syncId );
+	EXPECT_FALSE(events.sendEvent(std::make_shared<TestEvent>(102, "")));
+	EXPECT_EQ(callerThread, std::this_thread::get_id());
+
+	events.fullstop();
+}
@@ -0,0 +1,129 @@
+/*******************************************************************************
+ * unittests/libretroshare/services/msgs/msgstore_test.cc                      *
+ *                                                                             *
+ * Copyright (C) 2026  RetroShare Team <contact@retroshare.cc>                 *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Affero General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <stdio.h>
+
+// from libretroshare
+
+#include "services/msgstore.h"
+#include "rsitems/rsmsgitems.h"
+
+#define MSG_DB_NAME "msgstore_test_db"
+
+static RsMsgItem *newMsg(uint32_t msgId, const RsPeerId& peerId)
+{
+	RsMsgItem *msg = new RsMsgItem;
+	msg->msgId = msgId;
+	msg->msgFlags = RS_MSG_FLAGS_NEW;
+	msg->sendTime = 1000 + msgId;
+	msg->recvTime = 2000 + msgId;
+	msg->subject = "subject " + std::to_string(msgId);
+	msg->message = "body " + std::to_string(msgId);
+	msg->PeerId(peerId);
+	return msg;
+}
+
+static void clearEntries(std::list<MsgStore::Entry>& entries)
+{
+	for(std::list<MsgStore::Entry>::iterator it(entries.begin());it!=entries.end();++it)
+		delete it->msg;
+	entries.clear();
+}
+
+TEST(libretroshare_services, MsgStore)
+{
+	remove(MSG_DB_NAME);
+
+	RsPeerId peer = RsPeerId::random();
+	RsPeerId src = RsPeerId::random();
+	{
+		MsgStore st(MSG_DB_NAME, "");
+		ASSERT_TRUE(st.isOpen());
+
+		std::list<MsgStore::Entry> entries;
+
+		for(uint32_t i=1;i<=4;++i)
+		{
+			MsgStore::Entry e;
+			e.msg = newMsg(i, peer);
+			e.outgoing = (i == 4);
+			entries.push_back(e);
+		}
+		entries.front().srcId = src;
+		entries.back().parentId = 1;
+
+		EXPECT_TRUE(st.storeMsgs(entries));
+		clearEntries(entries);
+
+		EXPECT_TRUE(st.updateFlags(2, RS_MSG_FLAGS_TRASH));
+		EXPECT_TRUE(st.removeMsg(3));
+	}
+	{
+		MsgStore st(MSG_DB_NAME, "");
+		ASSERT_TRUE(st.isOpen());
+
+		std::list<MsgStore::Entry> entries;
+		ASSERT_TRUE(st.loadMsgs(entries));
+		ASSERT_EQ(entries.size(), 3u);
+
+		std::list<MsgStore::Entry>::const_iterator it = entries.begin();
+
+		// incoming messages come without their body
+		EXPECT_EQ(it->msg->msgId, 1u);
+		EXPECT_FALSE(it->outgoing);
+		EXPECT_EQ(it->srcId, src);
+		EXPECT_EQ(it->msg->PeerId(), peer);
+		EXPECT_EQ(it->msg->subject, "subject 1");
+		EXPECT_EQ(it->msg->recvTime, 2001u);
+		EXPECT_TRUE(it->msg->message.empty());
+
+		++it;
+		EXPECT_EQ(it->msg->msgId, 2u);
+		EXPECT_EQ(it->msg->msgFlags, (uint32_t)RS_MSG_FLAGS_TRASH);
+		EXPECT_TRUE(it->srcId.isNull());
+
+		++it;
+		EXPECT_EQ(it->msg->msgId, 4u);
+		EXPECT_TRUE(it->outgoing);
+		EXPECT_EQ(it->parentId, 1u);
+		EXPECT_EQ(it->msg->message, "body 4");
+
+		std::string body;
+		EXPECT_TRUE(st.getBody(1, body));
+		EXPECT_EQ(body, "body 1");
+		EXPECT_FALSE(st.getBody(3, body));
+
+		// storing again replaces the row
+		RsMsgItem *msg = entries.front().msg;
+		msg->message = "new body";
+		EXPECT_TRUE(st.storeMsgs(std::list<MsgStore::Entry>(1, entries.front())));
+		EXPECT_TRUE(st.getBody(1, body));
+		EXPECT_EQ(body, "new body");
+
+		clearEntries(entries);
+		ASSERT_TRUE(st.loadMsgs(entries));
+		EXPECT_EQ(entries.size(), 3u);
+		clearEntries(entries);
+	}
+
+	remove(MSG_DB_NAME);
+}
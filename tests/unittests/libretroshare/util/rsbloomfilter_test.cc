@@ -0,0 +1,83 @@
+/*******************************************************************************
+ * unittests/libretroshare/util/rsbloomfilter_test.cc                          *
+ *                                                                             *
+ * Copyright (C) 2026  RetroShare Team <contact@retroshare.cc>                 *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Affero General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <vector>
+
+// from libretroshare
+
+#include "util/rsbloomfilter.h"
+#include "util/rsrandom.h"
+
+TEST(libretroshare_util, RsBloomFilter)
+{
+	RsBloomFilter filter;
+
+	EXPECT_FALSE(filter.mayContain(RsFileHash()));
+	EXPECT_EQ(filter.memoryUsage(), 0u);
+
+	const uint32_t N = 10000;
+
+	filter.reset(N);
+	EXPECT_EQ(filter.count(), 0u);
+	EXPECT_GE(filter.memoryUsage()*8, 10*N);
+
+	std::vector<RsFileHash> keys;
+	for(uint32_t i=0;i<N;++i)
+	{
+		uint8_t buf[RsFileHash::SIZE_IN_BYTES];
+
+		// half of the hashes only differ by their last bytes
+		if(i % 2 == 0)
+		{
+			memset(buf, 0, sizeof(buf));
+			memcpy(&buf[sizeof(buf) - sizeof(i)], &i, sizeof(i));
+		}
+		else
+			RsRandom::random_bytes(buf, sizeof(buf));
+
+		keys.push_back(RsFileHash::fromBufferUnsafe(buf));
+		filter.insert(keys.back());
+	}
+	EXPECT_EQ(filter.count(), N);
+
+	// no false negatives
+	for(uint32_t i=0;i<keys.size();++i)
+		EXPECT_TRUE(filter.mayContain(keys[i]));
+
+	// about 1% of false positives, for random and structured hashes
+	uint32_t fp = 0;
+	for(uint32_t i=0;i<N;++i)
+	{
+		uint8_t buf[RsFileHash::SIZE_IN_BYTES];
+		memset(buf, 0xff, sizeof(buf));
+		memcpy(&buf[sizeof(buf) - sizeof(i)], &i, sizeof(i));
+
+		fp += filter.mayContain(RsFileHash::fromBufferUnsafe(buf));
+		fp += filter.mayContain(RsFileHash::random());
+	}
+	EXPECT_LT(fp, 2*N/50);
+
+	filter.reset(1);
+	EXPECT_EQ(filter.count(), 0u);
+	EXPECT_FALSE(filter.mayContain(keys[1]));
+}
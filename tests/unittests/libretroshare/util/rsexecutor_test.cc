@@ -0,0 +1,213 @@
+/*******************************************************************************
+ * unittests/libretroshare/util/rsexecutor_test.cc                             *
+ *                                                                             *
+ * Copyright (C) 2026  RetroShare Team <contact@retroshare.cc>                 *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Affero General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <set>
+#include <vector>
+
+// from libretroshare
+
+#include "util/rsexecutor.h"
+
+class TestTickingThread: public RsTickingThread
+{
+public:
+	TestTickingThread() : mThreadTicks(0), mExecutorTicks(0) {}
+
+	void threadTick() override
+	{
+		++mThreadTicks;
+		std::this_thread::sleep_for(tickPeriod());
+	}
+
+	void wake() { wakeTick(); }
+
+	std::atomic<int> mThreadTicks;
+	std::atomic<int> mExecutorTicks;
+
+protected:
+	void executorTick() override { ++mExecutorTicks; }
+
+	std::chrono::milliseconds tickPeriod() const override
+	{ return std::chrono::milliseconds(1000); }
+};
+
+static bool waitFor(const std::function<bool()>& cond)
+{
+	for(int i = 0; i < 200 && !cond(); ++i)
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	return cond();
+}
+
+TEST(libretroshare_util, RsExecutor)
+{
+	EXPECT_FALSE(RsExecutor::enabled());
+	EXPECT_TRUE(RsExecutor::instance() == nullptr);
+
+	// without executor ticking threads keep their own thread
+	{
+		TestTickingThread t;
+		EXPECT_TRUE(t.startTicking("test own thread"));
+		EXPECT_TRUE(waitFor([&]() { return t.mThreadTicks > 0; }));
+		t.fullstop();
+		EXPECT_EQ(t.mExecutorTicks, 0);
+	}
+
+	// without executor parallel jobs run in order on the calling thread
+	{
+		std::vector<uint32_t> order;
+		RsExecutor::runParallel(50, 4, [&](uint32_t i) { order.push_back(i); });
+		ASSERT_EQ(order.size(), 50u);
+		for(uint32_t i = 0; i < order.size(); ++i)
+			EXPECT_EQ(order[i], i);
+	}
+
+	RsExecutor::setThreadCount(4);
+	RsExecutor* executor = RsExecutor::instance();
+	ASSERT_TRUE(executor != nullptr);
+	EXPECT_EQ(executor->threadCount(), 4u);
+
+	// jobs queued by a busy worker are taken by the others
+	std::mutex mtx;
+	std::set<std::thread::id> threads;
+	std::atomic<int> done(0);
+
+	executor->post([&]()
+	{
+		for(int i = 0; i < 16; ++i)
+			executor->post([&]()
+			{
+				std::this_thread::sleep_for(std::chrono::milliseconds(20));
+				{
+					std::lock_guard<std::mutex> lock(mtx);
+					threads.insert(std::this_thread::get_id());
+				}
+				++done;
+			});
+	});
+	EXPECT_TRUE(waitFor([&]() { return done == 16; }));
+	EXPECT_GT(threads.size(), 1u);
+
+	// parallel jobs run each index once, write their results in place, and
+	// are all done when runParallel returns
+	{
+		const uint32_t N = 200;
+		std::vector<uint32_t> results(N, 0);
+		std::vector<std::atomic<int> > calls(N);
+		std::set<std::thread::id> jobThreads;
+
+		for(auto& c: calls) c = 0;
+
+		RsExecutor::runParallel(N, 3, [&](uint32_t i)
+		{
+			std::this_thread::sleep_for(std::chrono::microseconds((i * 7919) % 500));
+			{
+				std::lock_guard<std::mutex> lock(mtx);
+				jobThreads.insert(std::this_thread::get_id());
+			}
+			++calls[i];
+			results[i] = i * i;
+		});
+
+		for(uint32_t i = 0; i < N; ++i)
+		{
+			EXPECT_EQ(calls[i], 1) << "job " << i;
+			EXPECT_EQ(results[i], i * i);
+		}
+		EXPECT_GT(jobThreads.size(), 1u);
+		EXPECT_LE(jobThreads.size(), 4u);
+	}
+
+	// with all workers busy, the calling thread does everything itself
+	{
+		std::atomic<bool> release(false);
+		std::atomic<int> blocked(0);
+
+		for(int i = 0; i < 4; ++i)
+			executor->post([&]()
+			{
+				++blocked;
+				while(!release)
+					std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			});
+		EXPECT_TRUE(waitFor([&]() { return blocked == 4; }));
+
+		std::vector<uint32_t> order;
+		RsExecutor::runParallel(20, 4, [&](uint32_t i) { order.push_back(i); });
+		ASSERT_EQ(order.size(), 20u);
+		for(uint32_t i = 0; i < order.size(); ++i)
+			EXPECT_EQ(order[i], i);
+
+		// late helpers find nothing to do
+		release = true;
+	}
+
+	// periodic task, dropped when it returns false
+	std::atomic<int> runs(0);
+	RsExecutor::TaskId id = executor->schedulePeriodic(
+	            "test periodic", std::chrono::milliseconds(20),
+	            [&]() { return ++runs < 5; } );
+	EXPECT_TRUE(waitFor([&]() { return runs == 5; }));
+	std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	EXPECT_EQ(runs, 5);
+	executor->wake(id);
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	EXPECT_EQ(runs, 5);
+
+	// long periods go around the wheel, wake runs the task right away
+	std::atomic<int> slowRuns(0);
+	id = executor->schedulePeriodic(
+	            "test slow", std::chrono::milliseconds(60000),
+	            [&]() { ++slowRuns; return true; } );
+	EXPECT_TRUE(waitFor([&]() { return slowRuns == 1; }));
+	executor->wake(id);
+	EXPECT_TRUE(waitFor([&]() { return slowRuns == 2; }));
+
+	// statistics are updated once the task returns, after slowRuns
+	std::vector<RsExecutor::TaskStatistic> stats;
+	EXPECT_TRUE(waitFor([&]() {
+		executor->getTaskStatistics(stats);
+		return stats.size() == 1 && stats[0].mRuns == 2; }));
+	ASSERT_EQ(stats.size(), 1u);
+	EXPECT_EQ(stats[0].mName, "test slow");
+	EXPECT_EQ(stats[0].mRuns, 2u);
+
+	// ticking threads run on the executor, and stop without waiting a period
+	{
+		TestTickingThread t;
+		EXPECT_TRUE(t.startTicking("test executor"));
+		EXPECT_TRUE(t.isRunning());
+		EXPECT_TRUE(waitFor([&]() { return t.mExecutorTicks == 1; }));
+		t.wake();
+		EXPECT_TRUE(waitFor([&]() { return t.mExecutorTicks == 2; }));
+
+		auto start = std::chrono::steady_clock::now();
+		t.fullstop();
+		EXPECT_FALSE(t.isRunning());
+		EXPECT_LT(std::chrono::steady_clock::now() - start,
+		          std::chrono::milliseconds(900));
+		EXPECT_EQ(t.mThreadTicks, 0);
+	}
+
+	RsExecutor::shutdown();
+	EXPECT_FALSE(RsExecutor::enabled());
+	EXPECT_TRUE(RsExecutor::instance() == nullptr);
+}
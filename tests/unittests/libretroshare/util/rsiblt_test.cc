@@ -0,0 +1,138 @@
+/*******************************************************************************
+ * unittests/libretroshare/util/rsiblt_test.cc                                 *
+ *                                                                             *
+ * Copyright (C) 2026  RetroShare Team <contact@retroshare.cc>                 *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Affero General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <vector>
+
+// from libretroshare
+
+#include "util/rsiblt.h"
+#include "util/rsrandom.h"
+
+typedef RsIblt<36> TestIblt;
+
+static TestIblt::Key randomKey()
+{
+	TestIblt::Key key;
+	RsRandom::random_bytes(key.data(), key.size());
+	return key;
+}
+
+TEST(libretroshare_util, RsIblt)
+{
+	// two large sets with a small difference
+
+	std::vector<TestIblt::Key> common, onlyA, onlyB;
+
+	for(uint32_t i=0;i<5000;++i) common.push_back(randomKey());
+	for(uint32_t i=0;i<30;++i) onlyA.push_back(randomKey());
+	for(uint32_t i=0;i<20;++i) onlyB.push_back(randomKey());
+
+	const uint32_t nbCells = TestIblt::cellsForDifference(50);
+	TestIblt a(nbCells), b(nbCells);
+
+	EXPECT_EQ(a.cellCount() % TestIblt::NB_HASHES, 0u);
+	EXPECT_GE(a.cellCount(), 50u);
+
+	for(uint32_t i=0;i<common.size();++i) { a.insert(common[i]); b.insert(common[i]); }
+	for(uint32_t i=0;i<onlyA.size();++i) a.insert(onlyA[i]);
+	for(uint32_t i=0;i<onlyB.size();++i) b.insert(onlyB[i]);
+
+	// a is sent over the wire
+
+	std::vector<uint8_t> bytes;
+	a.toBytes(bytes);
+	EXPECT_EQ(bytes.size(), a.cellCount() * TestIblt::CELL_SIZE);
+
+	TestIblt received;
+	EXPECT_FALSE(received.fromBytes(bytes.data(), bytes.size() - 1, nbCells + 3));
+	EXPECT_FALSE(received.fromBytes(bytes.data(), bytes.size(), nbCells / 2));
+	ASSERT_TRUE(received.fromBytes(bytes.data(), bytes.size(), nbCells + 3));
+
+	EXPECT_FALSE(received.subtract(TestIblt(nbCells * 2)));
+	ASSERT_TRUE(received.subtract(b));
+
+	std::vector<TestIblt::Key> inserted, erased;
+	ASSERT_TRUE(received.decode(inserted, erased));
+
+	std::sort(inserted.begin(), inserted.end()); std::sort(onlyA.begin(), onlyA.end());
+	std::sort(erased.begin(), erased.end());     std::sort(onlyB.begin(), onlyB.end());
+
+	EXPECT_EQ(inserted, onlyA);
+	EXPECT_EQ(erased, onlyB);
+
+	// identical sets decode to nothing
+	inserted.clear(); erased.clear();
+	TestIblt c(nbCells);
+	for(uint32_t i=0;i<common.size();++i) c.insert(common[i]);
+	for(uint32_t i=0;i<common.size();++i) c.erase(common[i]);
+	EXPECT_TRUE(c.decode(inserted, erased));
+	EXPECT_TRUE(inserted.empty() && erased.empty());
+
+	// a difference much larger than the table is reported as such
+	TestIblt d(nbCells);
+	for(uint32_t i=0;i<common.size();++i) d.insert(common[i]);
+	EXPECT_FALSE(d.decode(inserted, erased));
+}
+
+TEST(libretroshare_util, RsIbltMalformed)
+{
+	const uint32_t cellSize = TestIblt::CELL_SIZE;
+
+	TestIblt one(TestIblt::cellsForDifference(10));
+	one.insert(randomKey());
+	const uint32_t nbCells = one.cellCount();
+
+	std::vector<uint8_t> bytes;
+	one.toBytes(bytes);
+
+	std::vector<uint32_t> used, unused;
+	for(uint32_t i = 0; i < nbCells; ++i)
+		(std::any_of( bytes.begin() + i*cellSize, bytes.begin() + (i+1)*cellSize,
+		              [](uint8_t b) { return b != 0; } ) ? used : unused).push_back(i);
+	ASSERT_EQ(used.size(), TestIblt::NB_HASHES);
+	ASSERT_FALSE(unused.empty());
+
+	// A pure looking cell holding a key which does not hash to it
+	std::vector<uint8_t> forged(bytes.size(), 0);
+	std::copy( bytes.begin() + used[0]*cellSize,
+	           bytes.begin() + (used[0]+1)*cellSize,
+	           forged.begin() + unused[0]*cellSize );
+
+	TestIblt received;
+	ASSERT_TRUE(received.fromBytes(forged.data(), forged.size(), nbCells));
+
+	std::vector<TestIblt::Key> inserted, erased;
+	EXPECT_FALSE(received.decode(inserted, erased));
+	EXPECT_TRUE(inserted.empty() && erased.empty());
+
+	// Only one of the cells of a key, peeling it fills the others which peel
+	// back into it forever, decoding stops once more keys than cells are found
+	inserted.clear(); erased.clear();
+	std::fill(forged.begin(), forged.end(), 0);
+	std::copy( bytes.begin() + used[0]*cellSize,
+	           bytes.begin() + (used[0]+1)*cellSize,
+	           forged.begin() + used[0]*cellSize );
+	ASSERT_TRUE(received.fromBytes(forged.data(), forged.size(), nbCells));
+	EXPECT_FALSE(received.decode(inserted, erased));
+	EXPECT_LE(inserted.size() + erased.size(), nbCells);
+}
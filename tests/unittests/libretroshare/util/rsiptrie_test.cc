@@ -0,0 +1,105 @@
+/*******************************************************************************
+ * unittests/libretroshare/util/rsiptrie_test.cc                               *
+ *                                                                             *
+ * Copyright (C) 2026  RetroShare Team <contact@retroshare.cc>                 *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Affero General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <cstring>
+
+// from libretroshare
+
+#include "util/rsiptrie.h"
+
+static sockaddr_storage makeAddr(const char *ip)
+{
+	sockaddr_storage addr;
+	memset(&addr, 0, sizeof(addr));
+
+	if(strchr(ip, ':'))
+	{
+		sockaddr_in6& a6 = reinterpret_cast<sockaddr_in6&>(addr);
+		a6.sin6_family = AF_INET6;
+		EXPECT_EQ(inet_pton(AF_INET6, ip, &a6.sin6_addr), 1);
+	}
+	else
+	{
+		sockaddr_in& a4 = reinterpret_cast<sockaddr_in&>(addr);
+		a4.sin_family = AF_INET;
+		EXPECT_EQ(inet_pton(AF_INET, ip, &a4.sin_addr), 1);
+	}
+	return addr;
+}
+
+static int match(const RsIpPrefixTrie<int>& trie, const char *ip, uint32_t expectedLen)
+{
+	uint32_t len = 1000;
+	const int *v = trie.longestMatch(makeAddr(ip), &len);
+
+	if(!v) return -1;
+
+	EXPECT_EQ(len, expectedLen);
+	return *v;
+}
+
+TEST(libretroshare_util, RsIpPrefixTrie)
+{
+	RsIpPrefixTrie<int> trie;
+
+	EXPECT_TRUE(trie.empty());
+	EXPECT_EQ(match(trie, "10.1.2.3", 0), -1);
+
+	// host bits are ignored, whether cleared or set
+	EXPECT_TRUE(trie.insert(makeAddr("10.1.255.255"), 16, 16));
+	EXPECT_TRUE(trie.insert(makeAddr("10.1.2.0"), 24, 24));
+	EXPECT_TRUE(trie.insert(makeAddr("10.1.2.3"), 32, 32));
+	EXPECT_TRUE(trie.insert(makeAddr("192.168.0.0"), 13, 13));
+	EXPECT_TRUE(trie.insert(makeAddr("2001:db8::"), 32, 6));
+	EXPECT_EQ(trie.size(), 5u);
+
+	EXPECT_EQ(match(trie, "10.1.2.3", 32), 32);
+	EXPECT_EQ(match(trie, "10.1.2.4", 24), 24);
+	EXPECT_EQ(match(trie, "10.1.3.4", 16), 16);
+	EXPECT_EQ(match(trie, "10.2.0.1", 0), -1);
+	EXPECT_EQ(match(trie, "192.175.1.1", 13), 13);
+	EXPECT_EQ(match(trie, "192.176.1.1", 0), -1);
+
+	// families do not mix
+	EXPECT_EQ(match(trie, "2001:db8:1::1", 32), 6);
+	EXPECT_EQ(match(trie, "2001:db9::1", 0), -1);
+	EXPECT_EQ(match(trie, "::a01:203", 0), -1);
+
+	// same prefix replaces the value
+	EXPECT_TRUE(trie.insert(makeAddr("10.1.2.99"), 24, 42));
+	EXPECT_EQ(trie.size(), 5u);
+	EXPECT_EQ(match(trie, "10.1.2.4", 24), 42);
+
+	// default route
+	EXPECT_TRUE(trie.insert(makeAddr("0.0.0.0"), 0, 0));
+	EXPECT_EQ(match(trie, "8.8.8.8", 0), 0);
+	EXPECT_EQ(match(trie, "2001:db9::1", 0), -1);
+
+	sockaddr_storage unspec;
+	memset(&unspec, 0, sizeof(unspec));
+	EXPECT_FALSE(trie.insert(unspec, 8, 1));
+	EXPECT_TRUE(trie.longestMatch(unspec) == nullptr);
+
+	trie.clear();
+	EXPECT_TRUE(trie.empty());
+	EXPECT_EQ(match(trie, "10.1.2.3", 0), -1);
+}
@@ -0,0 +1,131 @@
+/*******************************************************************************
+ * unittests/libretroshare/util/rssha1hashtable_test.cc                        *
+ *                                                                             *
+ * Copyright (C) 2026  RetroShare Team <contact@retroshare.cc>                 *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Affero General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <map>
+#include <vector>
+
+// from libretroshare
+
+#include "util/rssha1hashtable.h"
+#include "util/rsrandom.h"
+#include "util/rstime.h"
+
+TEST(libretroshare_util, RsSha1HashTable)
+{
+	RsSha1HashTable<uint32_t> table;
+	std::map<Sha1CheckSum,uint32_t> ref;
+
+	EXPECT_TRUE(table.empty());
+	EXPECT_TRUE(table.find(Sha1CheckSum()) == table.end());
+
+	// null hash is a valid key (root directory hash)
+	table[Sha1CheckSum()] = 42;
+	ref[Sha1CheckSum()] = 42;
+
+	std::vector<Sha1CheckSum> keys;
+	for(uint32_t i=0;i<20000;++i)
+	{
+		uint8_t buf[Sha1CheckSum::SIZE_IN_BYTES];
+		RsRandom::random_bytes(buf, sizeof(buf));
+
+		// force long collision chains on some keys
+		if(i % 10 == 0) memset(buf, 0, 8);
+
+		Sha1CheckSum h = Sha1CheckSum::fromBufferUnsafe(buf);
+
+		keys.push_back(h);
+		table[h] = i;
+		ref[h] = i;
+	}
+	EXPECT_EQ(table.size(), ref.size());
+
+	// erase half of the keys, then check that the remaining ones are still reachable
+	for(uint32_t i=0;i<keys.size();i+=2)
+	{
+		EXPECT_EQ(table.erase(keys[i]), 1u);
+		ref.erase(keys[i]);
+	}
+	EXPECT_EQ(table.erase(keys[0]), 0u);
+	EXPECT_EQ(table.size(), ref.size());
+
+	for(auto& it: ref)
+	{
+		auto tit = table.find(it.first);
+		ASSERT_TRUE(tit != table.end());
+		EXPECT_EQ(tit->second, it.second);
+	}
+	for(uint32_t i=0;i<keys.size();i+=2)
+		EXPECT_TRUE(table.find(keys[i]) == table.end());
+
+	size_t n = 0;
+	for(auto& it: table)
+	{
+		EXPECT_EQ(ref[it.first], it.second);
+		++n;
+	}
+	EXPECT_EQ(n, ref.size());
+
+	table.erase(table.find(Sha1CheckSum()));
+	EXPECT_EQ(table.count(Sha1CheckSum()), 0u);
+
+	table.clear();
+	EXPECT_TRUE(table.empty());
+	EXPECT_TRUE(table.begin() == table.end());
+}
+
+/* Compare with the std::map that was used before in file lists. Timings depend
+ * on the machine, so they are only printed, and the results of both containers
+ * are checked to be the same. */
+TEST(libretroshare_util, RsSha1HashTableBenchmark)
+{
+	const uint32_t N = 1000000;
+
+	std::vector<Sha1CheckSum> keys(N), missing(N);
+	for(uint32_t i=0;i<N;++i)
+	{
+		keys[i] = Sha1CheckSum::random();
+		missing[i] = Sha1CheckSum::random();
+	}
+
+	RsSha1HashTable<uint32_t> table;
+	std::map<Sha1CheckSum,uint32_t> ref;
+	uint64_t found = 0;
+
+	double t0 = rstime::RsScopeTimer::currentTime();
+	for(uint32_t i=0;i<N;++i) ref[keys[i]] = i;
+	double t1 = rstime::RsScopeTimer::currentTime();
+	for(uint32_t i=0;i<N;++i) found += ref.find(keys[N-1-i])->second;
+	for(uint32_t i=0;i<N;++i) found += ref.count(missing[i]);
+	double t2 = rstime::RsScopeTimer::currentTime();
+
+	for(uint32_t i=0;i<N;++i) table[keys[i]] = i;
+	double t3 = rstime::RsScopeTimer::currentTime();
+	for(uint32_t i=0;i<N;++i) found -= table.find(keys[N-1-i])->second;
+	for(uint32_t i=0;i<N;++i) found -= table.count(missing[i]);
+	double t4 = rstime::RsScopeTimer::currentTime();
+
+	EXPECT_EQ(found, 0u);
+
+	std::cerr << "1M SHA1 keys, std::map        : insert " << t1-t0 << " s, lookup " << t2-t1 << " s" << std::endl;
+	std::cerr << "1M SHA1 keys, RsSha1HashTable : insert " << t3-t2 << " s, lookup " << t4-t3 << " s, "
+	          << table.memoryUsage()/1024/1024 << " MB" << std::endl;
+}
@@ -293,6 +293,29 @@ SOURCES +=  unittests.cc \
 ################################## Crypto ##################################
 
 SOURCES += libretroshare/crypto/chacha20_test.cc
+SOURCES += libretroshare/crypto/rsaes_test.cc
+
+################################### Util ###################################
+
+SOURCES += libretroshare/util/rssha1hashtable_test.cc
+SOURCES += libretroshare/util/rsiptrie_test.cc
+SOURCES += libretroshare/util/rsbloomfilter_test.cc
+SOURCES += libretroshare/util/rsiblt_test.cc
+SOURCES += libretroshare/util/rsexecutor_test.cc
+
+#################################### PQI ###################################
+
+SOURCES += libretroshare/pqi/historystore_test.cc \
+	libretroshare/pqi/p3cfgjournal_test.cc \
+	libretroshare/pqi/pqinetreactor_test.cc \
+	libretroshare/pqi/pqiqosstreamer_test.cc
+
+############################### File sharing ###############################
+
+SOURCES += libretroshare/file_sharing/dir_hierarchy_test.cc \
+	libretroshare/file_sharing/file_name_index_test.cc \
+	libretroshare/file_sharing/hash_cache_index_test.cc \
+	libretroshare/file_sharing/hash_cache_test.cc
 
 ################################ Serialiser ################################
 HEADERS +=  libretroshare/serialiser/support.h \
@@ -360,11 +383,14 @@ SOURCES += libretroshare/gxs/gen_exchange/gxspublishgrouptest.cc \
 	libretroshare/gxs/gen_exchange/gxspublishmsgtest.cc \
 	libretroshare/gxs/gen_exchange/rsdummyservices.cc \
 	libretroshare/gxs/gen_exchange/rsgenexchange_test.cc \
+	libretroshare/gxs/gen_exchange/rsgenexchange_validation_test.cc \
 	libretroshare/gxs/gen_exchange/genexchangetester.cc \
 	libretroshare/gxs/gen_exchange/genexchangetestservice.cc \
 
 SOURCES += libretroshare/gxs/security/gxssecurity_test.cc
 
+SOURCES += libretroshare/gxs/data_access/rsgxsdataaccess_test.cc
+
 #	libretroshare/gxs/gen_exchange/gxsmsgrelatedtest.cc \
 
 HEADERS += libretroshare/gxs/data_service/rsdataservice_test.h \
@@ -375,6 +401,8 @@ SOURCES += libretroshare/gxs/data_service/rsdataservice_test.cc \
 
 ################################ dbase #####################################
 
+SOURCES += libretroshare/dbase/retrodb_test.cc
+
 
 #SOURCES += libretroshare/dbase/fisavetest.cc \
 #	libretroshare/dbase/fitest2.cc \
@@ -388,6 +416,10 @@ SOURCES += libretroshare/gxs/data_service/rsdataservice_test.cc \
 
 SOURCES += libretroshare/services/status/status_test.cc \
 
+SOURCES += libretroshare/services/msgs/msgstore_test.cc
+
+SOURCES += libretroshare/services/events/rseventsservice_test.cc
+
 ############################### gxs ########################################
 
 HEADERS += libretroshare/services/gxs/rsgxstestitems.h \